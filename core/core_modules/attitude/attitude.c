@@ -164,6 +164,29 @@ static void initialize_streams(
    att->master_gyro_idx = MAX_ATTACHED_PRODUCERS;
    //
    att->active_tau = 1.0f;
+   // gyr streams share one resample bank. count them first to size it
+   uint32_t num_gyr = 0;
+   for (uint32_t i=0; i<self->num_attached_producers; i++) {
+      datap_desc_type *prod = self->producer_list[i].producer;
+      imu_class_type *imu = (imu_class_type*) prod->local;
+      if ((imu->priority[IMU_GYR] >= IMU_PRI_1) &&
+            (imu->priority[IMU_GYR] <= IMU_PRI_3)) {
+         num_gyr++;
+      }
+   }
+   if (num_gyr > 0) {
+      if (resample_bank_init(&att->gyr_bank, num_gyr,
+            att->resample_history_ms) != 0) {
+         log_err(att->log, "Unable to allocate resample bank for %d "
+               "streams", num_gyr);
+         hard_exit(__func__, __LINE__);
+      }
+      log_info(att->log, "Resample bank: %d gyr streams, %d samples "
+            "(%.2f sec), %ld bytes", num_gyr, att->gyr_bank.queue_len,
+            (double) att->gyr_bank.queue_len * SAMPLE_DUR_SEC,
+            att->gyr_bank.bytes);
+   }
+   uint32_t gyr_col = 0;
    // make sure this is a supported producer type
    for (uint32_t i=0; i<self->num_attached_producers; i++) {
       datap_desc_type *prod = self->producer_list[i].producer;
@@ -178,8 +201,8 @@ static void initialize_streams(
             att->num_p1_gyr++;   // fall through
          case IMU_PRI_2:         // fall through
          case IMU_PRI_3:
-            att->gyr_stream[i] = malloc(sizeof *att->gyr_stream[i]);
-            resample_stream_init(att->gyr_stream[i], imu->priority[IMU_GYR]);
+            att->gyr_stream[i] = resample_stream_init(&att->gyr_bank,
+                  gyr_col++, imu->priority[IMU_GYR]);
             break;
          default:
             ;
@@ -340,6 +363,8 @@ static void attitude_class_post_run(
 {
 //   printf("%s in post_run\n", dp->td->obj_name);
    attitude_class_type *attitude = (attitude_class_type*) dp->local;
+   report_resample_cost(attitude, 1);
+   resample_bank_free(&attitude->gyr_bank);
    if (attitude->logfile != NULL) {
       fclose(attitude->logfile);
       attitude->logfile = NULL;
@@ -402,6 +427,9 @@ void * attitude_class_init(void *att_setup)
    // calloc implicitly initializes stream arrays, counters, and
    //    vectors to zero
    // bootstrap timer set when used
+   attitude->resample_history_ms = RESAMPLE_HISTORY_MS;
+   latency_reset(&attitude->update_cost);
+   latency_reset(&attitude->combine_cost);
    ////////////////////////////////////////
    // attitude produces data at a relatively high rate (e.g., 100Hz). don't
    //    alert consumers on every update, to reduce noise. update_interval
@@ -430,3 +458,24 @@ void set_declination(
    declination_ = decl;
 }
 
+
+
+// sets duration of gyro data kept in resample queues
+void set_attitude_history(
+      /* in out */       datap_desc_type *att_dp,
+      /* in     */ const uint32_t history_ms
+      )
+{
+   // sanity check
+   if (att_dp == NULL) {
+      fprintf(stderr, "NULL source provided to set_attitude_history\n");
+      hard_exit(__func__, __LINE__);
+   }
+   if (strcmp(att_dp->td->class_name, ATTITUDE_CLASS_NAME) != 0) {
+      fprintf(stderr, "History must be set on attitude module, not %s\n",
+            att_dp->td->class_name);
+      hard_exit(__func__, __LINE__);
+   }
+   attitude_class_type *att = (attitude_class_type*) att_dp->local;
+   att->resample_history_ms = history_ms;
+}
@@ -35,7 +35,8 @@ if (start < 0) {
    // see if there's enough rotation to estimate alignment
    const uint32_t base_idx = att->master_gyro_idx;
    const resampled_vector_stream_type *base_stream = att->gyr_stream[base_idx];
-   vector_type v = base_stream->resampled[base_stream->read_queue_idx];
+   vector_type v;
+   get_stream_value(base_stream, base_stream->read_queue_idx, &v);
 //vector_type v2 = v;
    const double sum = fabs(v.v[0]) + fabs(v.v[1]) + fabs(v.v[2]);
 //printf(" %.3f   base length: %.2f\n", now()-start, (double) sum);
@@ -61,7 +62,8 @@ if (start < 0) {
          continue;
       }
       vector_type cross;
-      vector_type sample = stream->resampled[stream->read_queue_idx];
+      vector_type sample;
+      get_stream_value(stream, stream->read_queue_idx, &sample);
       double samp_sum = fabs(sample.v[0]) + fabs(sample.v[1]) +
             fabs(sample.v[2]);
       if (samp_sum < MIN_ALIGNMENT_DPS)  {
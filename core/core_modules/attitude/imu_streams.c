@@ -16,6 +16,7 @@
 ***********************************************************************/
 #include "core_modules/support/imu_streams.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include "lin_alg.h"
@@ -34,16 +35,134 @@ static void simple_stream_init(
 }
 
 
-static void resample_stream_init(
-      /*    out */       resampled_vector_stream_type *stream,
+// allocates bank for num_streams resampled streams, keeping at least
+//    history_ms of data in each
+// returns 0 on success, -1 on error
+static int32_t resample_bank_init(
+      /*    out */       resample_bank_type *bank,
+      /* in     */ const uint32_t num_streams,
+      /* in     */ const uint32_t history_ms
+      )
+{
+   memset(bank, 0, sizeof *bank);
+   if (num_streams == 0) {
+      return -1;
+   }
+   const uint64_t min_rows = (uint64_t) history_ms * 1000 / SAMPLE_DUR_USEC;
+   uint32_t rows = RESAMPLE_MIN_ROWS;
+   while ((rows < min_rows) && (rows < RESAMPLE_MAX_ROWS)) {
+      rows <<= 1;
+   }
+   const uint32_t stride = RESAMPLE_LANES *
+         ((num_streams + RESAMPLE_LANES - 1) / RESAMPLE_LANES);
+   const size_t n = (size_t) rows * stride;
+   // values for all axes and weights are in one block
+   double *val = calloc(3 * n + stride, sizeof *val);
+   resampled_vector_stream_type *streams =
+         calloc(num_streams, sizeof *streams);
+   if ((val == NULL) || (streams == NULL)) {
+      free(val);
+      free(streams);
+      return -1;
+   }
+   bank->num_streams = num_streams;
+   bank->stride = stride;
+   bank->queue_len = rows;
+   for (uint32_t i=0; i<3; i++) {
+      bank->val[i] = &val[i * n];
+   }
+   bank->weight = &val[3 * n];
+   bank->streams = streams;
+   bank->bytes = (3 * n + stride) * sizeof *val +
+         num_streams * sizeof *streams;
+   return 0;
+}
+
+
+static void resample_bank_free(
+      /* in out */       resample_bank_type *bank
+      )
+{
+   free(bank->val[0]);
+   free(bank->streams);
+   memset(bank, 0, sizeof *bank);
+}
+
+
+// initializes stream at column col of bank and returns it
+static resampled_vector_stream_type * resample_stream_init(
+      /* in out */       resample_bank_type *bank,
+      /* in     */ const uint32_t col,
       /* in     */ const int8_t priority
       )
 {
+   resampled_vector_stream_type *stream = &bank->streams[col];
    memset(stream, 0, sizeof *stream);
+   stream->bank = bank;
+   stream->col = col;
    stream->write_sample_sec = -1.0;
    stream->priority = priority;
+   return stream;
+}
+
+////////////////////////////////////////////////
+// bank access
+
+// returns row in bank for sample ending at t
+static uint32_t resample_row(
+      /* in     */ const resample_bank_type *bank,
+      /* in     */ const microsecond_type t
+      )
+{
+   return (uint32_t) ((t.usec / SAMPLE_DUR_USEC) & (bank->queue_len - 1));
+}
+
+// stores val scaled by wt in stream's entry in row
+static void store_stream_value(
+      /* in out */       resampled_vector_stream_type *stream,
+      /* in     */ const uint32_t row,
+      /* in     */ const vector_type *val,
+      /* in     */ const double wt
+      )
+{
+   resample_bank_type *bank = stream->bank;
+   const uint32_t pos = row * bank->stride + stream->col;
+   for (uint32_t i=0; i<3; i++) {
+      bank->val[i][pos] = val->v[i] * wt;
+   }
+}
+
+// adds val scaled by wt to stream's entry in row
+static void add_stream_value(
+      /* in out */       resampled_vector_stream_type *stream,
+      /* in     */ const uint32_t row,
+      /* in     */ const vector_type *val,
+      /* in     */ const double wt
+      )
+{
+   resample_bank_type *bank = stream->bank;
+   const uint32_t pos = row * bank->stride + stream->col;
+   for (uint32_t i=0; i<3; i++) {
+      bank->val[i][pos] += val->v[i] * wt;
+   }
 }
 
+static void get_stream_value(
+      /* in     */ const resampled_vector_stream_type *stream,
+      /* in     */ const uint32_t row,
+      /*    out */       vector_type *val
+      )
+{
+   const resample_bank_type *bank = stream->bank;
+   const uint32_t pos = row * bank->stride + stream->col;
+   for (uint32_t i=0; i<3; i++) {
+      val->v[i] = bank->val[i][pos];
+   }
+}
+
+// bank access
+////////////////////////////////////////////////
+
 static void add_first_sample(
       /* in out */       resampled_vector_stream_type *stream,
       /* in     */ const vector_type *val,
@@ -69,12 +188,10 @@ static void add_first_sample(
    //    add_sample() handle publication
    double dt = t - sample_start_sec;
    double wt = dt / SAMPLE_DUR_SEC;
-   stream->read_queue_idx = 0;
-   stream->write_queue_idx = 0;
-   vector_type *data = &stream->resampled[stream->write_queue_idx];
-   for (uint32_t i=0; i<3; i++) {
-      data->v[i] = val->v[i] * wt;
-   }
+   stream->read_queue_idx = resample_row(stream->bank,
+         stream->read_sample_time);
+   stream->write_queue_idx = stream->read_queue_idx;
+   store_stream_value(stream, stream->write_queue_idx, val, wt);
    stream->write_pos_dur = dt;
 }
 
@@ -108,7 +225,7 @@ static void advance_read_position(
       )
 {
    stream->read_queue_idx =
-         (stream->read_queue_idx + 1) & (RESAMPLE_QUEUE_LEN - 1);
+         (stream->read_queue_idx + 1) & (stream->bank->queue_len - 1);
    stream->read_sample_time.usec += SAMPLE_DUR_USEC;
    stream->read_sample_sec = (double) stream->read_sample_time.usec * 1.0e-6;
 }
@@ -122,7 +239,7 @@ static void publish_sample(
 {
    // update index and sample times of write data
    uint32_t idx = stream->write_queue_idx + 1;
-   idx &= (RESAMPLE_QUEUE_LEN - 1); // wrap index around end of queue
+   idx &= (stream->bank->queue_len - 1); // wrap index around end of queue
    stream->write_queue_idx = idx;
    stream->write_sample_time.usec += SAMPLE_DUR_USEC;
    stream->write_sample_sec = (double) stream->write_sample_time.usec * 1.0e-6;
@@ -132,9 +249,9 @@ static void publish_sample(
       advance_read_position(stream);
    }
    // clear next write vector
-   vector_type *vec = &stream->resampled[idx];
+   resample_bank_type *bank = stream->bank;
    for (uint32_t i=0; i<3; i++) {
-      vec->v[i] = 0.0f;
+      bank->val[i][idx * bank->stride + stream->col] = 0.0;
    }
    stream->write_pos_dur = 0.0;
 }
@@ -150,36 +267,28 @@ static void add_sample(
       return;
    }
    while (t >= stream->write_sample_sec) {
-      vector_type *data = &stream->resampled[stream->write_queue_idx];
       if (stream->write_pos_dur > 0.0) {
          // write data is partially filled from previous sample that
          //    partially overlapped with it. fill it the rest of the
          //    way and publish
          double dt = SAMPLE_DUR_SEC - stream->write_pos_dur;
          double remainder = dt / SAMPLE_DUR_SEC;
-         for (uint32_t i=0; i<3; i++) {
-            data->v[i] += val->v[i] * remainder;
-         }
+         add_stream_value(stream, stream->write_queue_idx, val, remainder);
       } else {
          // the supplied value completely covers the next sample. fill
          //    sample and publish
-         for (uint32_t i=0; i<3; i++) {
-            data->v[i] = val->v[i];
-         }
+         store_stream_value(stream, stream->write_queue_idx, val, 1.0);
       }
       // sets write_pos_dur to 0.0 and increments write_sample_sec
       publish_sample(stream);
    }
    // all complete resampled values are filled. use what's left to
    //    partially fill the write sample
-   vector_type *data = &stream->resampled[stream->write_queue_idx];
    // get dt between sample start and data timestamp (write_sample_sec
    //    is at end of sample)
    double dt = SAMPLE_DUR_SEC - (stream->write_sample_sec - t);
    double wt = dt / SAMPLE_DUR_SEC; // weight is mult of dT
-   for (uint32_t i=0; i<3; i++) {
-      data->v[i] = val->v[i] * wt;
-   }
+   store_stream_value(stream, stream->write_queue_idx, val, wt);
    stream->write_pos_dur = dt;
 }
 
@@ -188,7 +297,7 @@ static void add_sample(
 // next_sample_time stores beginning of sample. return time at end
 //    of sample
 static microsecond_type is_sample_available(
-      /* in out */       resampled_vector_stream_type *stream
+      /* in     */ const resampled_vector_stream_type *stream
       )
 {
    if (stream->write_queue_idx == stream->read_queue_idx) {
@@ -209,15 +318,41 @@ static double get_next_sample(
    if (stream->write_queue_idx == stream->read_queue_idx) {
       return -1.0;
    }
-   vector_type *data = &stream->resampled[stream->read_queue_idx];
-   for (uint32_t i=0; i<3; i++) {
-      val->v[i] = data->v[i];
-   }
+   get_stream_value(stream, stream->read_queue_idx, val);
    double t = stream->read_sample_sec;
    advance_read_position(stream);
    return t;
 }
 
+
+// combines samples of all streams in row as a sum weighted by
+//    bank->weight. weights are not normalized
+// row is processed in RESAMPLE_LANES-wide chunks so the inner loop
+//    can be vectorized
+static void resample_bank_combine(
+      /* in     */ const resample_bank_type *bank,
+      /* in     */ const uint32_t row,
+      /*    out */       vector_type *vec
+      )
+{
+   const double * restrict wt = bank->weight;
+   const uint32_t stride = bank->stride;
+   for (uint32_t i=0; i<3; i++) {
+      const double * restrict v = &bank->val[i][row * stride];
+      double sum[RESAMPLE_LANES] = { 0.0 };
+      for (uint32_t s=0; s<stride; s+=RESAMPLE_LANES) {
+         for (uint32_t j=0; j<RESAMPLE_LANES; j++) {
+            sum[j] += wt[s+j] * v[s+j];
+         }
+      }
+      double total = 0.0;
+      for (uint32_t j=0; j<RESAMPLE_LANES; j++) {
+         total += sum[j];
+      }
+      vec->v[i] = total;
+   }
+}
+
 //
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -232,41 +367,56 @@ static uint32_t test_init(void)
    /////////////////////////////////////////////////////////////////////
    // init stream, add single value
    // make sure stream is initialized and nothing is published
-   resampled_vector_stream_type stream;
-   resample_stream_init(&stream, 1);
-   if (stream.write_sample_sec >= 0.0) {
+   resample_bank_type bank;
+   if (resample_bank_init(&bank, 1, RESAMPLE_HISTORY_MS) != 0) {
+      printf("  Failed to allocate resample bank\n");
+      errs++;
+      goto end;
+   }
+   resampled_vector_stream_type *stream = resample_stream_init(&bank, 0, 1);
+   if (stream->write_sample_sec >= 0.0) {
       printf("  Freshly initialized stream doesn't indicate no data\n");
       errs++;
    }
    vector_type a = { .v = { 0.1f, 0.2f, 0.3f } };
    double t = 100.516;
-   add_sample(&stream, &a, t);
+   add_sample(stream, &a, t);
+   if (stream->read_queue_idx !=
+         resample_row(&bank, stream->read_sample_time)) {
+      printf("  Read index %d doesn't match row of sample time (%d)\n",
+            stream->read_queue_idx,
+            resample_row(&bank, stream->read_sample_time));
+      errs++;
+   }
    double expected_start = 100.520;
    double expected_end = 100.520;
-   if (fabs(expected_start - stream.read_sample_sec) > 0.0001) {
+   if (fabs(expected_start - stream->read_sample_sec) > 0.0001) {
       printf("  Incorrect read sample time. Got %.3f, expected %.3f\n",
-            stream.read_sample_sec, expected_start);
+            stream->read_sample_sec, expected_start);
       errs++;
    }
-   if (fabs(expected_end - stream.write_sample_sec) > 0.0001) {
+   if (fabs(expected_end - stream->write_sample_sec) > 0.0001) {
       printf("  Incorrect write sample time. Got %.3f, expected %.3f\n",
-            stream.write_sample_sec, expected_end);
+            stream->write_sample_sec, expected_end);
       errs++;
    }
    // check vector value
    double x = a.v[0] * 0.6;
    double y = a.v[1] * 0.6;
    double z = a.v[2] * 0.6;
-   vector_type *data = &stream.resampled[0];
-   if ((fabs(x - data->v[0]) > 0.0001) ||
-         (fabs(y - data->v[1]) > 0.0001) ||
-         (fabs(z - data->v[2]) > 0.0001)) {
+   vector_type data;
+   get_stream_value(stream, stream->write_queue_idx, &data);
+   if ((fabs(x - data.v[0]) > 0.0001) ||
+         (fabs(y - data.v[1]) > 0.0001) ||
+         (fabs(z - data.v[2]) > 0.0001)) {
       printf("  Stored vector is of incorrect magnitude. Expected "
             "%.2f,%.2f,%.2f, got %.2f,%.2f,%.2f\n", x, y, z,
-            data->v[0], data->v[1], data->v[2]);
+            data.v[0], data.v[1], data.v[2]);
       errs++;
    }
+   resample_bank_free(&bank);
    /////////////////////////////////////////////////////////////////////
+end:
    if (errs == 0) {
       printf("    passed\n");
    } else {
@@ -280,19 +430,24 @@ static uint32_t test_add_sample(void)
    uint32_t errs = 0;
    printf("Testing add_sample\n");
    /////////////////////////////////////////////////////////////////////
-   resampled_vector_stream_type stream;
-   resample_stream_init(&stream, 1);
+   resample_bank_type bank;
+   if (resample_bank_init(&bank, 1, RESAMPLE_HISTORY_MS) != 0) {
+      printf("  Failed to allocate resample bank\n");
+      errs++;
+      goto end;
+   }
+   resampled_vector_stream_type *stream = resample_stream_init(&bank, 0, 1);
    vector_type a = { .v = { 0.1, 0.2, 0.3 } };
    vector_type b = { .v = { 0.5, 0.6, 0.7 } };
    // ab is 1/4 the way between a and b
    vector_type ab = { .v = { 0.2, 0.3, 0.4 } };
    // start sample 3/4 the way into the resampled interval
    double t = 100.5175;
-   add_sample(&stream, &a, t);
+   add_sample(stream, &a, t);
    t += SAMPLE_DUR_SEC;
-   add_sample(&stream, &a, t);
+   add_sample(stream, &a, t);
    // make sure data is published
-   microsecond_type pub_time = is_sample_available(&stream);
+   microsecond_type pub_time = is_sample_available(stream);
    if (pub_time.usec == 0) {
       printf("  First sample not published\n");
       errs++;
@@ -304,7 +459,7 @@ static uint32_t test_add_sample(void)
       errs++;
    }
    vector_type z = { .v = { 0.0, 0.0, 0.0 } };
-   double sec = get_next_sample(&stream, &z);
+   double sec = get_next_sample(stream, &z);
    double expected_sec = (double) expected_time * 1.0e-6;
    if (fabs(sec - expected_sec) > 0.000001) {
       printf("  Sample time is off. Got %.3f, expected %.3f\n", sec,
@@ -323,9 +478,9 @@ static uint32_t test_add_sample(void)
    /////////////////////////////////////////////////////////////////////
    // add 2 samples worth of data in one chunk
    t += 2.0 * SAMPLE_DUR_SEC;
-   add_sample(&stream, &b, t);
+   add_sample(stream, &b, t);
    // get and check first output sample
-   sec = get_next_sample(&stream, &z);
+   sec = get_next_sample(stream, &z);
    expected_sec += SAMPLE_DUR_SEC;
    if (fabs(sec - expected_sec) > 0.000001) {
       printf("  Sample 2 time is off. Got %.3f, expected %.3f\n", sec,
@@ -342,7 +497,7 @@ static uint32_t test_add_sample(void)
       errs++;
    }
    // get and check second output sample
-   sec = get_next_sample(&stream, &z);
+   sec = get_next_sample(stream, &z);
    expected_sec += SAMPLE_DUR_SEC;
    if (fabs(sec - expected_sec) > 0.000001) {
       printf("  Sample 3 time is off. Got %.3f, expected %.3f\n", sec,
@@ -358,7 +513,94 @@ static uint32_t test_add_sample(void)
             b.v[0], b.v[1], b.v[2], z.v[0], z.v[1], z.v[2]);
       errs++;
    }
+   resample_bank_free(&bank);
+   /////////////////////////////////////////////////////////////////////
+end:
+   if (errs == 0) {
+      printf("    passed\n");
+   } else {
+      printf("    %d errors\n", errs);
+   }
+   return errs;
+}
+
+static uint32_t test_bank(void)
+{
+   uint32_t errs = 0;
+   printf("Testing resample_bank\n");
+   /////////////////////////////////////////////////////////////////////
+   // 5 streams is padded to 8. 100ms of history needs 10 rows, which
+   //    is rounded up to 16
+   const uint32_t num_streams = 5;
+   resample_bank_type bank;
+   if (resample_bank_init(&bank, num_streams, 100) != 0) {
+      printf("  Failed to allocate resample bank\n");
+      errs++;
+      goto end;
+   }
+   if ((bank.stride != 8) || (bank.queue_len != 16)) {
+      printf("  Bank size incorrect. Got %d x %d, expected 8 x 16\n",
+            bank.stride, bank.queue_len);
+      errs++;
+   }
+   resampled_vector_stream_type *streams[5];
+   for (uint32_t i=0; i<num_streams; i++) {
+      streams[i] = resample_stream_init(&bank, i, 1);
+   }
+   // feed each stream 40 samples, more than the queue holds, w/ each
+   //    stream's sample times offset differently from the 10ms grid
+   for (uint32_t n=0; n<40; n++) {
+      for (uint32_t i=0; i<num_streams; i++) {
+         vector_type v = { .v = { (double) (i + 1), (double) n, 1.0 } };
+         double t = 200.0 + (double) n * SAMPLE_DUR_SEC +
+               (double) i * 0.0017;
+         add_sample(streams[i], &v, t);
+      }
+   }
+   // all streams should have the same read time, in the same row
+   const microsecond_type t0 = is_sample_available(streams[0]);
+   for (uint32_t i=0; i<num_streams; i++) {
+      microsecond_type t = is_sample_available(streams[i]);
+      if ((t.usec != t0.usec) ||
+            (streams[i]->read_queue_idx != resample_row(&bank, t0))) {
+         printf("  Stream %d not aligned. Time %ld (expected %ld), "
+               "row %d (expected %d)\n", i, t.usec, t0.usec,
+               streams[i]->read_queue_idx, resample_row(&bank, t0));
+         errs++;
+      }
+   }
+   // combine row w/ weights and compare against weighted sum of
+   //    individual samples
+   const uint32_t row = resample_row(&bank, t0);
+   vector_type expected = { .v = { 0.0, 0.0, 0.0 } };
+   for (uint32_t i=0; i<bank.stride; i++) {
+      bank.weight[i] = 0.0;
+   }
+   for (uint32_t i=0; i<num_streams; i++) {
+      // skip stream 2 to make sure zero-weight streams are ignored
+      if (i == 2) {
+         continue;
+      }
+      double w = (i == 0) ? 1.0 : 0.5;
+      bank.weight[i] = w;
+      vector_type v;
+      get_stream_value(streams[i], row, &v);
+      for (uint32_t j=0; j<3; j++) {
+         expected.v[j] += w * v.v[j];
+      }
+   }
+   vector_type combined;
+   resample_bank_combine(&bank, row, &combined);
+   for (uint32_t j=0; j<3; j++) {
+      if (fabs(combined.v[j] - expected.v[j]) > 1.0e-9) {
+         printf("  Combined value incorrect on axis %d. Got %.4f, "
+               "expected %.4f\n", j, combined.v[j], expected.v[j]);
+         errs++;
+      }
+   }
+   resample_bank_free(&bank);
    /////////////////////////////////////////////////////////////////////
+end:
    if (errs == 0) {
       printf("    passed\n");
    } else {
@@ -411,6 +653,7 @@ int main(int argc, char **argv)
    //
    errs += test_init();
    errs += test_add_sample();
+   errs += test_bank();
    errs += test_simple_stream();
    //
    if (errs == 0) {
@@ -17,12 +17,50 @@
 
 #include "device_align.c"
 
+// logs cost of updating and combining streams, and memory used by
+//    resample bank. logged every ATTITUDE_RESAMPLE_REPORT_SEC or
+//    when final is set
+static void report_resample_cost(
+      /* in out */       attitude_class_type *att,
+      /* in     */ const uint32_t final
+      )
+{
+   const double t = now();
+   if (att->resample_report_sec <= 0.0) {
+      att->resample_report_sec = t;
+      return;
+   }
+   if ((final == 0) &&
+         ((t - att->resample_report_sec) < ATTITUDE_RESAMPLE_REPORT_SEC)) {
+      return;
+   }
+   const resample_bank_type *bank = &att->gyr_bank;
+   double usec_per_sample = 0.0;
+   if (att->update_samples > 0) {
+      usec_per_sample = 1.0e6 * att->update_cost.sum_sec /
+            (double) att->update_samples;
+   }
+   log_info(att->log, "Resample bank: %d gyr streams (%d wide), %d "
+         "samples, %ld bytes. %ld input samples, %.2f usec/sample",
+         bank->num_streams, bank->stride, bank->queue_len, bank->bytes,
+         att->update_samples, usec_per_sample);
+   log_latency_summary(att->log, &att->update_cost, "stream update");
+   log_latency_summary(att->log, &att->combine_cost, "gyr combine");
+   latency_reset(&att->update_cost);
+   latency_reset(&att->combine_cost);
+   att->update_samples = 0;
+   att->resample_report_sec = t;
+}
+
+
 // pulls data from all producers with new content and updates vector streams
 static void update_vector_streams(
       /* in out */       datap_desc_type *self,
       /* in out */       attitude_class_type *att
       )
 {
+   const double start = now();
+   uint64_t num_samples = 0;
    for (uint32_t i=0; i<self->num_attached_producers; i++) {
       if ((self->run_state & DP_STATE_DONE) != 0) {
          break;
@@ -62,8 +100,14 @@ static void update_vector_streams(
 //log_info(att->log, "GYR at %.3f from %s", t, producer->td->obj_name);
          }
          pr->consumed_elements++;
+         num_samples++;
       }
    }
+   if (num_samples > 0) {
+      latency_add(&att->update_cost, now() - start);
+      att->update_samples += num_samples;
+   }
+   report_resample_cost(att, 0);
 }
 
 
@@ -73,102 +117,77 @@ static void update_vector_streams(
 ////////////////////////////////////////////////
 // resampled streams
 
-// pulls content of all available P1 and P2 streams into output vector
-// output vector is set as weighted average of all inputs
-static void pull_p12_data_resample(
+// combines samples at next publication time from all gyr streams
+//    into output vector. stream weights are set according to priority,
+//    w/ wt[n] being the weight for priority n (0 to exclude). output
+//    vector is the weighted average of all contributing streams
+static void pull_data_resample(
       /* in out */       attitude_class_type *att,
-      /* in out */       resampled_vector_stream_type **streams,
+      /* in out */       resample_bank_type *bank,
+      /* in     */ const double wt[IMU_PRI_NULL],
       /*    out */       vector_type *vec
       )
 {
-//printf("  p12-gyr\n");
-   zero_vector(vec); // clear output vec
-   double wt = 0.0;  // keep track of weight added to output vec
-   microsecond_type t;
-   vector_type tmp_vec;
-   for (uint32_t i=0; i<MAX_ATTACHED_PRODUCERS; i++) {
-      resampled_vector_stream_type *stream = streams[i];
-      if (stream == NULL) {
+   const double start = now();
+   double total_wt = 0.0;  // keep track of weight added to output vec
+   for (uint32_t i=0; i<bank->stride; i++) {
+      bank->weight[i] = 0.0;
+   }
+   for (uint32_t i=0; i<bank->num_streams; i++) {
+      const resampled_vector_stream_type *stream = &bank->streams[i];
+      if ((stream->priority < IMU_PRI_1) ||
+            (stream->priority >= IMU_PRI_NULL)) {
          continue;
       }
-      // add stream data to output vec as function of priority
-      switch (stream->priority) {
-         case IMU_PRI_1:
-            t = is_sample_available(stream);
-            if ((t.usec > 0) && (t.usec == att->next_publish_time.usec)) {
-               get_next_sample(stream, &tmp_vec);
-               add_weighted_vector(vec, &tmp_vec, 1.0);
-               wt += 1.0;
-            }
-            break;
-         case IMU_PRI_2:
-            t = is_sample_available(stream);
-            if ((t.usec > 0) && (t.usec == att->next_publish_time.usec)) {
-               get_next_sample(stream, &tmp_vec);
-               add_weighted_vector(vec, &tmp_vec, 0.5);
-               wt += 0.5;
-            }
-            break;
-         default:
-            ;  // do nothing
-      };
+      microsecond_type t = is_sample_available(stream);
+      if ((t.usec > 0) && (t.usec == att->next_publish_time.usec)) {
+         bank->weight[i] = wt[stream->priority];
+         total_wt += wt[stream->priority];
+      }
    }
-   if (c_assert(wt > 0.0)) {
+   if (c_assert(total_wt > 0.0)) {
       log_err(att->log, "Internal error -- No content pulled from streams");
       hard_exit(__func__, __LINE__);
    }
+   // samples for publication time are all in the same row. combine
+   //    them in one pass then advance the streams that contributed
+   resample_bank_combine(bank, resample_row(bank, att->next_publish_time),
+         vec);
+   for (uint32_t i=0; i<bank->num_streams; i++) {
+      if (bank->weight[i] > 0.0) {
+         advance_read_position(&bank->streams[i]);
+      }
+   }
    // normalize vector by added weight, making it a weighted average of
    //    values in all contributing streams
-   mult_vector_scalar(vec, 1.0/wt);
+   mult_vector_scalar(vec, 1.0/total_wt);
+   latency_add(&att->combine_cost, now() - start);
+}
+
+// pulls content of all available P1 and P2 streams into output vector
+// output vector is set as weighted average of all inputs
+static void pull_p12_data_resample(
+      /* in out */       attitude_class_type *att,
+      /* in out */       resample_bank_type *bank,
+      /*    out */       vector_type *vec
+      )
+{
+//printf("  p12-gyr\n");
+   const double wt[IMU_PRI_NULL] = { 1.0, 0.5, 0.0 };
+   pull_data_resample(att, bank, wt, vec);
 }
 
 // pulls content of all available P2 and P3 streams into output vector
 // output vector is set as weighted average of all inputs
 static void pull_p23_data_resample(
       /* in out */       attitude_class_type *att,
-      /* in out */       resampled_vector_stream_type **streams,
+      /* in out */       resample_bank_type *bank,
       /*    out */       vector_type *vec
       )
 {
 //printf("  p23-gyr\n");
-   zero_vector(vec); // clear output vec
-   double wt = 0.0;  // keep track of weight added to output vec
-   microsecond_type t;
-   vector_type tmp_vec;
-   for (uint32_t i=0; i<MAX_ATTACHED_PRODUCERS; i++) {
-      resampled_vector_stream_type *stream = streams[i];
-      if (stream == NULL) {
-         continue;
-      }
-      // add stream data to output vec as function of priority
-      switch (stream->priority) {
-         case IMU_PRI_2:
-            t = is_sample_available(stream);
-            if ((t.usec > 0) && (t.usec == att->next_publish_time.usec)) {
-               get_next_sample(stream, &tmp_vec);
-               add_weighted_vector(vec, &tmp_vec, 1.0);
-               wt += 1.0;
-            }
-            break;
-         case IMU_PRI_3:
-            t = is_sample_available(stream);
-            if ((t.usec > 0) && (t.usec == att->next_publish_time.usec)) {
-               get_next_sample(stream, &tmp_vec);
-               add_weighted_vector(vec, &tmp_vec, 1.0);
-               wt += 1.0;
-            }
-            break;
-         default:
-            ;  // do nothing
-      };
-   }
-   if (c_assert(wt > 0.0)) {
-      log_err(att->log, "Internal error -- No content pulled from streams");
-      hard_exit(__func__, __LINE__);
-   }
-   // normalize vector by added weight, making it a weighted average of
-   //    values in all contributing streams
-   mult_vector_scalar(vec, 1.0/wt);
+   const double wt[IMU_PRI_NULL] = { 0.0, 1.0, 1.0 };
+   pull_data_resample(att, bank, wt, vec);
 }
 
 ////////////////////////////////////////////////
@@ -432,7 +451,7 @@ static int publish_if_available(
    // first, peek into streams to check alignment (otherwise the streams
    //    are modified when data is pulled)
    perform_gyro_alignment(self);
-   pull_p12_data_resample(att, att->gyr_stream, &gyr);
+   pull_p12_data_resample(att, &att->gyr_bank, &gyr);
    pull_p12_data(att, att->acc_stream, timeout, &acc);
    pull_p12_data(att, att->mag_stream, timeout, &mag);
    /////////////////////////////
@@ -523,10 +542,10 @@ log_info(log_, "Case E");
    // Cases A and B are signaled by count values > 0
    if (gyr_cnt[0] > 0) {
 log_info(log_, "Case A\n");
-      pull_p12_data_resample(att, att->gyr_stream, &gyr);     // A
+      pull_p12_data_resample(att, &att->gyr_bank, &gyr);     // A
    } else if ((gyr_cnt[1] + gyr_cnt[2]) > 0) {
 log_info(log_, "Case B\n");
-      pull_p23_data_resample(att, att->gyr_stream, &gyr);     // B
+      pull_p23_data_resample(att, &att->gyr_bank, &gyr);     // B
    } else {
       log_err(att->log, "Internal error -- failed to fetch gyro data");
       hard_exit(__func__, __LINE__);
@@ -25,8 +25,10 @@
 #include <assert.h>
 #include "datap.h"
 #include "pinet.h"
+#include "pinet_reactor.h"
 #include "logger.h"
 #include "kernel.h"
+#include "timekeeper.h"
 #include "lin_alg.h"
 #include "dev_info.h"
 #include "sensor_packet.h"
@@ -84,11 +86,75 @@ err:
 }
 
 ////////////////////////////////////////////////////////////////////////
+// reads GPS data directly from socket until connection breaks
+static void pull_socket_data(
+      /* in out */       struct datap_desc *dp
+      )
+{
+   struct gps_receiver_class *gps = (struct gps_receiver_class*) dp->local;
+   uint8_t inbound[GPS_BLOCK_SIZE];
+   while ((dp->run_state & DP_STATE_DONE) == 0) {
+      ///////////////////////////////////////////////////////////////
+      // read data packet
+      if (recv_block(gps->connfd, &inbound, sizeof(inbound)) < 0) {
+         log_err(gps->log, "Read error. Breaking connection");
+         close(gps->connfd);
+         gps->connfd = -1;
+         break;
+      }
+      parse_and_publish(dp, gps, inbound);
+   }
+}
+
+// called by network reactor w/ each packet
+static int32_t reactor_packet(
+      /* in out */       void *arg,
+      /* in out */       uint8_t *packet,
+      /* in     */ const double received_sec
+      )
+{
+   (void) received_sec;
+   struct datap_desc *dp = (struct datap_desc*) arg;
+   struct gps_receiver_class *gps = (struct gps_receiver_class*) dp->local;
+   parse_and_publish(dp, gps, packet);
+   return 0;
+}
+
+// hands connection to network reactor, which passes packets to
+//    parse_and_publish() on its own thread, and waits for connection
+//    to break
+static void pull_reactor_data(
+      /* in out */       struct datap_desc *dp
+      )
+{
+   struct gps_receiver_class *gps = (struct gps_receiver_class*) dp->local;
+   const pinet_conn_handler_type handler = {
+      .packet = reactor_packet,
+      .timer = NULL,
+      .arg = dp
+   };
+   pinet_conn_type *conn = pinet_reactor_add(gps->connfd, dp->td->obj_name,
+         GPS_BLOCK_SIZE, &handler);
+   if (conn == NULL) {
+      // fall back to reading socket here
+      pull_socket_data(dp);
+      return;
+   }
+   while ((dp->run_state & DP_STATE_DONE) == 0) {
+      if (pinet_conn_wait_closed(conn, PINET_CONN_WAIT_SEC) != 0) {
+         log_err(gps->log, "Read error. Breaking connection");
+         break;
+      }
+   }
+   // reactor closes socket. no packets are delivered after this
+   pinet_reactor_remove(conn);
+   gps->connfd = -1;
+}
+
 // publishes GPS data pulled from network
 static void gps_receiver_class_run(struct datap_desc *dp)
 {
    struct gps_receiver_class *gps = (struct gps_receiver_class*) dp->local;
-   uint8_t inbound[GPS_BLOCK_SIZE];
 //printf("%s entering main loop\n", dp->td->obj_name);
    while ((dp->run_state & DP_STATE_DONE) == 0) {
       // establish server
@@ -97,16 +163,10 @@ static void gps_receiver_class_run(struct datap_desc *dp)
       // send sync packet so client has current time
       send_sync_packet(UDP_SYNC_PACKET_TIME);
       // server is up. pull data from attached client
-      while ((dp->run_state & DP_STATE_DONE) == 0) {
-         ///////////////////////////////////////////////////////////////
-         // read data packet
-         if (recv_block(gps->connfd, &inbound, sizeof(inbound)) < 0) {
-            log_err(gps->log, "Read error. Breaking connection");
-            close(gps->connfd);
-            gps->connfd = -1;
-            break;
-         }
-         parse_and_publish(dp, gps, inbound);
+      if (pinet_reactor_enabled() && (gps->connfd >= 0)) {
+         pull_reactor_data(dp);
+      } else {
+         pull_socket_data(dp);
       }
    }
 }
@@ -128,6 +188,7 @@ static void gps_receiver_class_post_run(struct datap_desc *dp)
       fclose(gps->logfile);
       gps->logfile = NULL;
    }
+   report_nmea_stats(gps, 1);
 }
 
 
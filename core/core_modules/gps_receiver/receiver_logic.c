@@ -18,32 +18,11 @@
 // see
 // https://www.rfwireless-world.com/Terminology/GPS-sentences-or-NMEA-sentences.html
 
-static char * nmea_device_[8] = {
-   "GA",     // galileo
-   "GB",     // beidou
-   "GP",     // gps
-   "GI",     // navIC
-   "GL",     // glonass
-   "GN",     // based on multiple systems
-   "GQ",     // qzss
-   NULL
-};
-
-// TODO add support for GGL and VTG
-static char * nmea_type_[8] = {
-   "GGA,",     // fix
-   "RMC,",     // fix
-   NULL
-};
-
 static char * months_[13] = {
    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec", "Unknown"
 };
 
-enum nmea_message { NMEA_GGA, NMEA_RMC, NUM_NMEA_MESSAGE_TYPES };
-typedef enum nmea_message nmea_message_type;
-
 ////////////////////////////////////////////////////////////////////////
 // network
 
@@ -110,31 +89,6 @@ void print_nmea_message(
 }
 
 
-// returns nmea message type number. if type not recognized then returns
-//    NUM_NMEA_MESSAGE_TYPES
-static nmea_message_type ident_nmea_message(
-      /* in     */ const char *sentence
-      )
-{
-   // see if it's from a recognized device
-   uint32_t ctr = 0;
-   nmea_message_type type = NUM_NMEA_MESSAGE_TYPES;
-   char *device = NULL;
-   while ((device = nmea_device_[ctr++]) != NULL) {
-      if (strncmp(sentence, device, 2) == 0) {
-         break;
-      }
-   }
-   if (device != NULL) {
-      if (strncmp(&sentence[2], nmea_type_[NMEA_GGA], 4) == 0) {
-         type = NMEA_GGA;
-      } else if (strncmp(&sentence[2], nmea_type_[NMEA_RMC], 4) == 0) {
-         type = NMEA_RMC;
-      }
-   }
-   return type;
-}
-
 /*
 GGA, from https://www.rfwireless-world.com/Terminology/GPS-sentences-or-NMEA-sentences.html
 example;
@@ -156,14 +110,13 @@ Diff. ref. station ID   0000
 */
 static void parse_gga(
       /* in out */       gps_receiver_class_type *gps,
-      /* in     */ const char *sentence,
+      /* in     */ const nmea_fields_type *fields,
       /* in out */       gps_receiver_output_type *out
       )
 {
-   int32_t idx = 6;
-   read_utc_time(sentence, &idx, gps, out);
-   read_latitude(sentence, &idx, gps, out);
-   read_longitude(sentence, &idx, gps, out);
+   read_utc_time(fields, 1, gps, out);
+   read_latitude(fields, 2, gps, out);
+   read_longitude(fields, 4, gps, out);
 }
 
 
@@ -185,18 +138,40 @@ Mode  A  A = Autonomous, D = DGPS, E =DR
 */
 static void parse_rmc(
       /* in out */       gps_receiver_class_type *gps,
-      /* in     */ const char *sentence,
+      /* in     */ const nmea_fields_type *fields,
       /* in out */       gps_receiver_output_type *out
       )
 {
-   int32_t idx = 6;
-   read_utc_time(sentence, &idx, gps, out);
-   skip_one(sentence, &idx);
-   read_latitude(sentence, &idx, gps, out);
-   read_longitude(sentence, &idx, gps, out);
-   read_sog(sentence, &idx, gps, out);
-   read_cog(sentence, &idx, gps, out);
-   read_utc_date(sentence, &idx, gps, out);
+   read_utc_time(fields, 1, gps, out);
+   // field 2 is status
+   read_latitude(fields, 3, gps, out);
+   read_longitude(fields, 5, gps, out);
+   read_sog(fields, 7, gps, out);
+   read_cog(fields, 8, gps, out);
+   read_utc_date(fields, 9, gps, out);
+}
+
+
+// logs parse stats every GPS_RECEIVER_REPORT_SEC, or now if final is set
+static void report_nmea_stats(
+      /* in out */       gps_receiver_class_type *gps,
+      /* in     */ const uint32_t final
+      )
+{
+   const double t = now();
+   if (gps->report_sec <= 0.0) {
+      gps->report_sec = t;
+      return;
+   }
+   if (!final && ((t - gps->report_sec) < GPS_RECEIVER_REPORT_SEC)) {
+      return;
+   }
+   const nmea_stats_type *stats = &gps->nmea_stats;
+   log_info(gps->log, "NMEA: %ld sentences used, %ld ignored, %ld bad "
+         "checksum, %ld bad format, %ld bad fields", stats->sentences,
+         stats->ignored, stats->bad_checksum, stats->bad_format,
+         stats->bad_fields);
+   gps->report_sec = t;
 }
 
 
@@ -207,35 +182,33 @@ static void parse_and_publish(
       /* in     */ const uint8_t inbound_data[GPS_BLOCK_SIZE]
       )
 {
-   char data[GPS_BLOCK_SIZE];
-   strncpy(data, (const char*) inbound_data, sizeof(data));
+   // block is NUL padded. sentence is parsed in place
+   const char *data = (const char*) inbound_data;
+   const char *data_end = memchr(data, 0, GPS_BLOCK_SIZE);
+   if (data_end == NULL) {
+      gps->nmea_stats.bad_format++;
+      goto end;
+   }
    if (gps->logfile) {
       fprintf(gps->logfile, "%s\n", data);
    }
-   //
-   char *save_ptr = NULL;
    // extract timestamp
-   errno = 0;
-   double t = strtod(data, &save_ptr);
-   if (errno != 0) {
-      log_err(gps->log, "Error extracting timestamp from '%s' : %s\n",
-            data, strerror(errno));
-//printf("Error extracting timestamp from '%s' : %s", data, strerror(errno));
+   char *endptr = NULL;
+   double t = strtod(data, &endptr);
+   if (endptr == data) {
+      gps->nmea_stats.bad_format++;
       goto end;
    }
-   char *sentence = strtok_r(save_ptr, "\n\r ", &save_ptr);
-   if (sentence == NULL) {
-      log_err(gps->log, "Packet at %.3f missing sentence", t);
-//printf("Packet at %.3f missing sentence\n", t);
-      goto end;
+   while (*endptr == ' ') {
+      endptr++;
    }
-   size_t len = strlen(sentence);
-   if (len < 8) {
-      log_err(gps->log, "Sentence '%s' is too short", sentence);
-//printf("Sentence '%s' is too short\n", sentence);
+   const char *sentence = endptr;
+   nmea_fields_type fields;
+   int32_t type = nmea_tokenize(sentence, (uint32_t) (data_end - sentence),
+         &fields, &gps->nmea_stats);
+   if ((type < 0) || (type == NMEA_IGNORED)) {
       goto end;
    }
-   nmea_message_type type = ident_nmea_message(sentence);
    /////////////////////
    // get data sink
    uint32_t dp_idx = (uint32_t) (self->elements_produced % self->queue_length);
@@ -243,20 +216,17 @@ static void parse_and_publish(
    self->ts[dp_idx] = t;
    gps_receiver_output_type *out = dp_get_object_at(self, dp_idx);
    memset(out, 0, sizeof *out);
-   strncpy(out->message_type, sentence, 6);
+   // address and trailing comma
+   memcpy(out->message_type, fields.field[0], 6);
    out->message_type[6] = 0;
    /////////////////////
    switch (type) {
       case NMEA_GGA:
-         parse_gga(gps, sentence, out);
+         parse_gga(gps, &fields, out);
          break;
       case NMEA_RMC:
-         parse_rmc(gps, sentence, out);
+         parse_rmc(gps, &fields, out);
          break;
-      case NUM_NMEA_MESSAGE_TYPES:
-//printf("Unsupported message type\n");
-         // unsupported message -- ignore it
-         goto end;
       default:
          log_err(gps->log, "Internal errror - invalid nmea message type %d\n",
                type);
@@ -271,6 +241,6 @@ static void parse_and_publish(
 //print_nmea_message(out);
    }
 end:
-   ;
+   report_nmea_stats(gps, 0);
 }
 
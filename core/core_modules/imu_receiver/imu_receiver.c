@@ -19,17 +19,20 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include "datap.h"
 #include "pinet.h"
+#include "pinet_reactor.h"
 #include "logger.h"
 #include "kernel.h"
 #include "lin_alg.h"
 #include "dev_info.h"
 #include "sensor_packet.h"
 #include "udp_sync.h"
+#include "timekeeper.h"
 #include "sensor_packet.h"
 
 #include "core_modules/imu_receiver.h"
@@ -105,6 +108,144 @@ err:
    hard_exit("imu_receiver::imu_class_pre_run", 1);
 }
 
+////////////////////////////////////////////////////////////////////////
+// unpacks, logs and publishes one packet of sensor data
+static void handle_packet(
+      /* in out */       struct datap_desc *dp,
+      /* in out */       struct sensor_packet_header *header,
+      /* in     */ const char serial[SP_SERIAL_LENGTH]
+      )
+{
+   struct imu_class *imu = (struct imu_class*) dp->local;
+   double timestamp;
+   uint32_t pkt_type;
+   imu_sensor_packet_type ship_vectors;
+   // retrieve and handle metadata
+   unpack_sensor_header(header, &pkt_type, &timestamp);
+   if (pkt_type != IMU_PACKET_TYPE) {
+      log_err(imu->log, "Packet type error. Expected 0x%08x, got 0x%08x",
+            IMU_PACKET_TYPE, pkt_type);
+      hard_exit("imu_receiver::imu_class_run", 1);
+   }
+   // remote log data returned in packet header
+   if (header->log_data[0] != 0) {
+      header->log_data[SENSOR_PACKET_LOG_DATA-1] = 0;
+      log_info(imu->log, "remote log: '%s'", header->log_data);
+   }
+   // convert from network to local representation and log data
+   // log data as it was received, transform sensor axes to
+   //    ship axes, and store in output buffer
+   unpack_data(timestamp, serial, &ship_vectors, imu);
+   rotate_and_log(&ship_vectors, imu);
+   // upsample data and publish
+   publish_upsample(dp, imu, &ship_vectors);
+   // report every Nth element, give or take
+   if (dp->elements_produced > imu->report_level) {
+      imu->report_level = dp->elements_produced + 100;
+      log_info(imu->log, "Published %ld'th sample at %.3f", dp->elements_produced, timestamp);
+   }
+}
+
+// reads sensor data directly from socket until connection breaks
+static void pull_socket_data(
+      /* in out */       struct datap_desc *dp
+      )
+{
+   struct imu_class *imu = (struct imu_class*) dp->local;
+   struct sensor_packet_header header;
+   char serial[SP_SERIAL_LENGTH];   // buffer for pulling serialized data
+   while ((dp->run_state & DP_STATE_DONE) == 0) {
+      // if samples are waiting to be signaled, don't block past their
+      //    latency cap
+      const double wait_sec = batch_wait_sec(dp, imu);
+      if (wait_sec >= 0.0) {
+         struct pollfd pfd = { .fd = imu->connfd, .events = POLLIN };
+         if (poll(&pfd, 1, (int) (wait_sec * 1000.0) + 1) == 0) {
+            check_batch_latency(dp, imu);
+            continue;
+         }
+      }
+      ///////////////////////////////////////////////////////////////
+      // fetch sensor data header
+      if (recv_block(imu->connfd, &header, sizeof(header)) < 0) {
+         log_err(imu->log, "Read error. Breaking connection");
+         close(imu->connfd);
+         imu->connfd = -1;
+         break;
+      }
+//printf("%s received header block\n", dp->td->obj_name); fflush(stdout);
+      ///////////////////////////////////////////////////////////////
+      // fetch sensor data
+      if (recv_block(imu->connfd, serial, SP_SERIAL_LENGTH) !=
+            SP_SERIAL_LENGTH) {
+         log_err(imu->log, "\n%s read error. Breaking connection",
+               dp->td->obj_name);
+         close(imu->connfd);
+         imu->connfd = -1;
+         break;
+      }
+      handle_packet(dp, &header, serial);
+   }
+}
+
+// called by network reactor w/ each packet
+static int32_t reactor_packet(
+      /* in out */       void *arg,
+      /* in out */       uint8_t *packet,
+      /* in     */ const double received_sec
+      )
+{
+   (void) received_sec;
+   struct datap_desc *dp = (struct datap_desc*) arg;
+   struct sensor_packet_header header;
+   memcpy(&header, packet, sizeof(header));
+   handle_packet(dp, &header, (const char*) &packet[sizeof(header)]);
+   return 0;
+}
+
+// called by network reactor after packets are delivered and when the
+//    pending batch reaches its latency cap
+static double reactor_timer(
+      /* in out */       void *arg
+      )
+{
+   struct datap_desc *dp = (struct datap_desc*) arg;
+   struct imu_class *imu = (struct imu_class*) dp->local;
+   check_batch_latency(dp, imu);
+   return batch_wait_sec(dp, imu);
+}
+
+// hands connection to network reactor, which passes packets to
+//    handle_packet() on its own thread, and waits for connection to
+//    break
+static void pull_reactor_data(
+      /* in out */       struct datap_desc *dp
+      )
+{
+   struct imu_class *imu = (struct imu_class*) dp->local;
+   const pinet_conn_handler_type handler = {
+      .packet = reactor_packet,
+      .timer = reactor_timer,
+      .arg = dp
+   };
+   pinet_conn_type *conn = pinet_reactor_add(imu->connfd, dp->td->obj_name,
+         sizeof(struct sensor_packet_header) + SP_SERIAL_LENGTH, &handler);
+   if (conn == NULL) {
+      // fall back to reading socket here
+      pull_socket_data(dp);
+      return;
+   }
+   while ((dp->run_state & DP_STATE_DONE) == 0) {
+      if (pinet_conn_wait_closed(conn, PINET_CONN_WAIT_SEC) != 0) {
+         log_err(imu->log, "Read error. Breaking connection");
+         break;
+      }
+   }
+   // reactor closes socket. no packets are delivered after this
+   pinet_reactor_remove(conn);
+   imu->connfd = -1;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // publishes sensor data received from network (primarily IMU data)
 // gyro drift and magnetic correction assumed to be done at client
@@ -117,14 +258,8 @@ static void imu_class_run(struct datap_desc *dp)
    struct imu_class *imu = (struct imu_class*) dp->local;
    log_info(imu->log, "Modality priorities (0-based): g:%d, a:%d m:%d",
       imu->priority[IMU_GYR], imu->priority[IMU_ACC], imu->priority[IMU_MAG]);
-   struct sensor_packet_header header;
-   double timestamp;
-   uint32_t pkt_type;
-   //
-   char serial[SP_SERIAL_LENGTH];   // buffer for pulling serialized data
    //
-   uint64_t report_level = 100;
-   imu_sensor_packet_type ship_vectors;
+   imu->report_level = 100;
 //printf("%s entering main loop\n", dp->td->obj_name);
    while ((dp->run_state & DP_STATE_DONE) == 0) {
       // establish server
@@ -133,51 +268,13 @@ static void imu_class_run(struct datap_desc *dp)
       // send sync packet so client has current time
       send_sync_packet(UDP_SYNC_PACKET_TIME);
       // server is up. pull data from attached client
-      while ((dp->run_state & DP_STATE_DONE) == 0) {
-         ///////////////////////////////////////////////////////////////
-         // fetch sensor data header
-         if (recv_block(imu->connfd, &header, sizeof(header)) < 0) {
-            log_err(imu->log, "Read error. Breaking connection");
-            close(imu->connfd);
-            imu->connfd = -1;
-            break;
-         }
-//printf("%s received header block\n", dp->td->obj_name); fflush(stdout);
-         // retrieve and handle metadata
-         unpack_sensor_header(&header, &pkt_type, &timestamp);
-         if (pkt_type != IMU_PACKET_TYPE) {
-            log_err(imu->log, "Packet type error. Expected 0x%08x, got 0x%08x",
-                  IMU_PACKET_TYPE, pkt_type);
-            hard_exit("imu_receiver::imu_class_run", 1);
-         }
-         // remote log data returned in packet header
-         if (header.log_data[0] != 0) {
-            header.log_data[SENSOR_PACKET_LOG_DATA-1] = 0;
-            log_info(imu->log, "remote log: '%s'", header.log_data);
-         }
-         ///////////////////////////////////////////////////////////////
-         // fetch sensor data
-         if (recv_block(imu->connfd, serial, SP_SERIAL_LENGTH) !=
-               SP_SERIAL_LENGTH) {
-            log_err(imu->log, "\n%s read error. Breaking connection",
-                  dp->td->obj_name);
-            close(imu->connfd);
-            imu->connfd = -1;
-            break;
-         }
-         // convert from network to local representation and log data
-         // log data as it was received, transform sensor axes to
-         //    ship axes, and store in output buffer
-         unpack_data(timestamp, serial, &ship_vectors, imu);
-         rotate_and_log(&ship_vectors, imu);
-         // upsample data and publish
-         publish_upsample(dp, imu, &ship_vectors);
-         // report every Nth element, give or take
-         if (dp->elements_produced > report_level) {
-            report_level = (uint32_t) (dp->elements_produced + 100);
-            log_info(imu->log, "Published %ld'th sample at %.3f", dp->elements_produced, timestamp);
-         }
+      if (pinet_reactor_enabled() && (imu->connfd >= 0)) {
+         pull_reactor_data(dp);
+      } else {
+         pull_socket_data(dp);
       }
+      // connection is down. don't hold samples until it's back
+      flush_batch(dp, imu);
    }
 //printf("%s leaving main loop\n", dp->td->obj_name); fflush(stdout);
 }
@@ -196,6 +293,11 @@ static void imu_class_post_run(struct datap_desc *dp)
       close(imu->sockfd);
       imu->sockfd = -1;
    }
+   flush_batch(dp, imu);
+   if (imu->report_start_sec > 0.0) {
+      report_batch_stats(dp, imu, now());
+   }
+   flush_log_batch(imu);
    if (imu->logfile) {
       fclose(imu->logfile);
       imu->logfile = NULL;
@@ -270,6 +372,11 @@ void * imu_class_init(void * imu_setup)
       zero_vector(&imu->recycle_value[i]);
    }
    imu->prev_publish_t.usec = 0;
+   // batched publication
+   imu->batch_samples = IMU_BATCH_SAMPLES;
+   imu->batch_latency_usec = IMU_BATCH_LATENCY_USEC;
+   imu->batch_start_sec = -1.0;
+   latency_reset(&imu->delivery);
    /////////////////////////////////////////////////////////////////////
    strcpy(imu->device_name, setup->device_name);
    if (setup->logging == 1) {
@@ -278,13 +385,19 @@ void * imu_class_init(void * imu_setup)
       // construct path
       snprintf(buf, STR_LEN, "%s%s", get_log_folder_name(), dp->td->obj_name);
       imu->logfile = fopen(buf, "w");
+      if ((imu->logfile != NULL) &&
+            (imu_log_write_header(imu->logfile) != 0)) {
+         fclose(imu->logfile);
+         imu->logfile = NULL;
+      }
       if (imu->logfile == NULL) {
          // non-fatal error. we just loose logging
          log_err(imu->log, "Unable to create data logfile for %s (%s)",
                dp->td->obj_name, buf);
       } else {
          log_info(imu->log, "%s logging data to %s", dp->td->obj_name, buf);
-         log_info(imu->log, "format: gyro (3), acc (3), mag (3), temp");
+         log_info(imu->log, "format: binary imu_log_record: time, "
+               "gyro (3), acc (3), mag (3), temp");
       }
    } else {
       imu->logfile = NULL;
@@ -296,18 +409,14 @@ void * imu_class_init(void * imu_setup)
    dp->local = imu;
    imu->sockfd = -1;
    imu->connfd = -1;
-   // data frames are read all together, so no need for each imu producer to
-   //    alert subscribers. the update signal (update_ctr -- see
-   //    datap.h) initialization should be staggered so that multiple
-   //    alerts from different IMU receivers aren't sent to subscribers
-   //    at the same time, but as receivers can fall out of sync, this
-   //    isn't directly possible.
-   // TODO consider setting the update_interval to 1 so that an
-   //    alert is set every time data is said to be available, but add
-   //    auxiliary logic to control when a signal is sent that data is
-   //    available
+   // subscribers are signaled once per batch (see publish_batch()), so
+   //    every signal should wake them. multiple IMU receivers can
+   //    still wake subscribers at about the same time, but each wakeup
+   //    now delivers several samples. set_imu_batch() with 0 samples
+   //    restores the original behavior of alerting subscribers on
+   //    every 2nd signal (update_ctr -- see datap.h)
    dp->update_ctr = 0;
-   dp->update_interval = 2;
+   dp->update_interval = 1;
    //
    dp->pre_run = imu_class_pre_run;
    dp->post_run = imu_class_post_run;
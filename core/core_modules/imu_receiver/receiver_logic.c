@@ -115,9 +115,27 @@ static void unpack_data(
 }
 
 
+// writes pending log records to logfile
+static void flush_log_batch(
+      /* in out */       imu_class_type *imu
+      )
+{
+   if (imu->logfile && (imu->log_batch_len > 0)) {
+      if (fwrite(imu->log_batch, sizeof imu->log_batch[0],
+            imu->log_batch_len, imu->logfile) != imu->log_batch_len) {
+         log_err(imu->log, "Error writing to data log. Logging "
+               "disabled");
+         fclose(imu->logfile);
+         imu->logfile = NULL;
+      }
+   }
+   imu->log_batch_len = 0;
+}
+
+
 static void rotate_and_log(
       /* in out */       imu_sensor_packet_type *data,
-      /* in     */ const imu_class_type *imu
+      /* in out */       imu_class_type *imu
       )
 {
    // make copy of data as below matrix operations cannot be done
@@ -126,19 +144,20 @@ static void rotate_and_log(
    copy_vector(&data->acc, &acc);
    copy_vector(&data->mag, &mag);
    copy_vector(&data->gyr, &gyr);
-   // log data if logging enabled
+   // log data if logging enabled. records are buffered and written
+   //    when the batch is full
    if (imu->logfile) {
-      fprintf(imu->logfile,
-            "%.3f  "
-            "%7.4f %7.4f %7.4f  "
-            "%7.4f %7.4f %7.4f  "
-            "%7.4f %7.4f %7.4f  "
-            "%5.1f\n",
-            data->timestamp,
-            (double) gyr.v[0], (double) gyr.v[1], (double) gyr.v[2],
-            (double) acc.v[0], (double) acc.v[1], (double) acc.v[2],
-            (double) mag.v[0], (double) mag.v[1], (double) mag.v[2],
-            (double) data->temp);
+      imu_log_record_type *rec = &imu->log_batch[imu->log_batch_len];
+      rec->t = data->timestamp;
+      for (uint32_t i=0; i<3; i++) {
+         rec->gyr[i] = (float) gyr.v[i];
+         rec->acc[i] = (float) acc.v[i];
+         rec->mag[i] = (float) mag.v[i];
+      }
+      rec->temp = (float) data->temp;
+      if (++imu->log_batch_len >= IMU_LOG_BATCH_RECORDS) {
+         flush_log_batch(imu);
+      }
    }
    // transform IMU data to ship-space
    mult_matrix_vector(&imu->gyr_dev2ship, &gyr, &data->gyr);
@@ -191,6 +210,134 @@ static microsecond_timestamp_type next_imu_publish_time(
 // timestamp conversion
 ////////////////////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////////////////////////////
+// batched signaling
+
+// logs subscriber wakeups and delivery latency since previous report
+static void report_batch_stats(
+      /* in out */       datap_desc_type *dp,
+      /* in out */       imu_class_type *imu,
+      /* in     */ const double t
+      )
+{
+   const double dt = t - imu->report_start_sec;
+   if (dt > 0.0) {
+      log_info(imu->log, "%s batch %d/%.1fms: %.1f wakeups/sec, "
+            "%.1f samples/sec", dp->td->obj_name, imu->batch_samples,
+            (double) imu->batch_latency_usec * 1.0e-3,
+            (double) imu->wakeups / dt,
+            (double) imu->samples_delivered / dt);
+      char label[STR_LEN];
+      snprintf(label, STR_LEN, "%s delivery", dp->td->obj_name);
+      log_latency_summary(imu->log, &imu->delivery, label);
+   }
+   imu->wakeups = 0;
+   imu->samples_delivered = 0;
+   latency_reset(&imu->delivery);
+   imu->report_start_sec = t;
+}
+
+// signals subscribers that pending samples are available. when
+//    subscribers are woken, the age of each delivered sample is recorded
+static void signal_batch(
+      /* in out */       datap_desc_type *dp,
+      /* in out */       imu_class_type *imu,
+      /* in     */ const double t
+      )
+{
+   dp_signal_data_available(dp);
+   imu->batch_signaled = dp->elements_produced;
+   imu->batch_start_sec = -1.0;
+   if (dp->update_ctr == 0) {
+      // subscribers woken
+      imu->wakeups++;
+      // samples overwritten before delivery are skipped
+      if ((dp->elements_produced - imu->batch_delivered) >
+            dp->queue_length) {
+         imu->batch_delivered = dp->elements_produced - dp->queue_length;
+      }
+      while (imu->batch_delivered < dp->elements_produced) {
+         const uint32_t idx =
+               (uint32_t) (imu->batch_delivered % dp->queue_length);
+         latency_add(&imu->delivery, t - dp->ts[idx]);
+         imu->batch_delivered++;
+         imu->samples_delivered++;
+      }
+   }
+}
+
+// signals subscribers that data is available if the pending batch is
+//    full or its oldest sample has waited too long
+static void publish_batch(
+      /* in out */       datap_desc_type *dp,
+      /* in out */       imu_class_type *imu
+      )
+{
+   const double t = now();
+   if (imu->report_start_sec <= 0.0) {
+      imu->report_start_sec = t;
+   }
+   if (imu->batch_samples > 0) {
+      const uint64_t pending = dp->elements_produced - imu->batch_signaled;
+      if (imu->batch_start_sec < 0.0) {
+         imu->batch_start_sec = t;
+      }
+      if ((pending < imu->batch_samples) &&
+            ((t - imu->batch_start_sec) * 1.0e6 <
+            (double) imu->batch_latency_usec)) {
+         goto end;
+      }
+   }
+   signal_batch(dp, imu, t);
+end:
+   if ((t - imu->report_start_sec) >= IMU_BATCH_REPORT_SEC) {
+      report_batch_stats(dp, imu, t);
+   }
+}
+
+// returns how long, in seconds, until the pending batch reaches its
+//    latency cap (0 if it already has). returns -1 if nothing is pending
+static double batch_wait_sec(
+      /* in     */ const datap_desc_type *dp,
+      /* in     */ const imu_class_type *imu
+      )
+{
+   if ((imu->batch_samples == 0) || (imu->batch_start_sec < 0.0) ||
+         (dp->elements_produced == imu->batch_signaled)) {
+      return -1.0;
+   }
+   const double wait = imu->batch_start_sec +
+         (double) imu->batch_latency_usec * 1.0e-6 - now();
+   return wait > 0.0 ? wait : 0.0;
+}
+
+// called when no packet arrived before batch_wait_sec() expired, so
+//    the latency cap holds when the sensor stalls
+static void check_batch_latency(
+      /* in out */       datap_desc_type *dp,
+      /* in out */       imu_class_type *imu
+      )
+{
+   if (batch_wait_sec(dp, imu) == 0.0) {
+      publish_batch(dp, imu);
+   }
+}
+
+// signals any pending samples regardless of batch size or age. used
+//    when the connection breaks and at shutdown
+static void flush_batch(
+      /* in out */       datap_desc_type *dp,
+      /* in out */       imu_class_type *imu
+      )
+{
+   if (dp->elements_produced != imu->batch_signaled) {
+      signal_batch(dp, imu, now());
+   }
+}
+
+// batched signaling
+////////////////////////////////////////////////////////////////////////
+
 // publish IMU data (ACC and MAG only -- no gyro flagged as present)
 static void publish_upsample_no_gyro(
       /* in out */       datap_desc_type *dp,
@@ -241,9 +388,10 @@ static void publish_upsample_no_gyro(
       imu->prev_publish_t = next_t;
       next_t.usec += IMU_PRODUCER_INTERVAL_US;
    }
-   // if a sample was pushed into the queue, notify subscribers
+   // if a sample was pushed into the queue, notify subscribers when
+   //    the batch is ready
    if (num_published > 0) {
-      dp_signal_data_available(dp);
+      publish_batch(dp, imu);
    }
 }
 
@@ -361,9 +509,10 @@ static void publish_upsample_gyro(
 //print_vec(&imu->recycle_value[IMU_GYR], "leftover rotation");
    // update gyro data timestamp
    imu->prev_gyr_data_t = data_t;
-   // if a sample was pushed into the queue, notify subscribers
+   // if a sample was pushed into the queue, notify subscribers when
+   //    the batch is ready
    if (num_published > 0) {
-      dp_signal_data_available(dp);
+      publish_batch(dp, imu);
    }
 }
 
@@ -462,3 +611,35 @@ void set_imu_priority(
    }
 }
 
+
+
+////////////////////////////////////////////////////////////////////////
+// set batch
+
+// interface to set batch size and latency cap from imu producer
+void set_imu_batch(
+      /* in out */       datap_desc_type *imu_dp,
+      /* in     */ const uint32_t max_samples,
+      /* in     */ const uint32_t max_latency_ms
+      )
+{
+   // sanity check
+   if (imu_dp == NULL) {
+      fprintf(stderr, "NULL source provided to set_imu_batch\n");
+      hard_exit(__func__, __LINE__);
+   }
+   if (strcmp(imu_dp->td->class_name, IMU_CLASS_NAME) != 0) {
+      fprintf(stderr, "Batch must be set on IMU module, not %s\n",
+            imu_dp->td->class_name);
+      hard_exit(__func__, __LINE__);
+   }
+   /////////////////////////////////////////////////////////////////////
+   imu_class_type *imu = (imu_class_type*) imu_dp->local;
+   imu->batch_samples = max_samples;
+   imu->batch_latency_usec = max_latency_ms * 1000;
+   // when batching, each signal is a complete batch so subscribers
+   //    are woken every time. otherwise use original behavior of
+   //    waking subscribers every 2nd signal
+   imu_dp->update_ctr = 0;
+   imu_dp->update_interval = (max_samples > 0) ? 1 : 2;
+}
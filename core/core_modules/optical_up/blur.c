@@ -0,0 +1,572 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "pin_types.h"
+#include "pixel_types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "datap.h"
+
+#include "core_modules/optical_up.h"
+
+// 3x3 blur of optical_up output, [1 2 1] on each axis. edge pixels
+//    are replicated (ie, clamp-to-edge), so a flat image stays flat
+//    all the way to its edges. v and y are rounded to nearest. border
+//    is all or none, so it's the OR of the 3x3 neighborhood
+//
+// source frames are interleaved pixel_cam_info records. each row is
+//    split into 16-bit planes (a sequential read of a small buffer that
+//    stays in L1) and the arithmetic runs on the planes, 8 pixels at a
+//    time using gcc vector extensions, which map to SSE on INTEL and to
+//    NEON on RPI/RPI4. the horizontal pass keeps full sums (max 4*255)
+//    and the vertical pass does the one shift and round (max 16*255),
+//    so there's no loss from truncating between passes
+//
+// with OPTICAL_UP_PLANES, the blurred planes (and radius, which is
+//    copied while the row is being split) are narrowed and stored in
+//    the output's planes as well
+
+// number of pixels processed per vector op
+#define BLUR_LANES      8
+
+static const uint32_t BORDER_CHAN_IDX = NUM_IMAGE_CHANNELS;
+
+typedef uint16_t blur_u16x8_type __attribute__ ((vector_size (16)));
+
+static inline blur_u16x8_type load_u16x8(
+      /* in     */ const uint16_t *src
+      )
+{
+   blur_u16x8_type v;
+   memcpy(&v, src, sizeof v);
+   return v;
+}
+
+static inline void store_u16x8(
+      /*    out */       uint16_t *dest,
+      /* in     */ const blur_u16x8_type v
+      )
+{
+   memcpy(dest, &v, sizeof v);
+}
+
+
+// allocates row planes for images up to max_width pixels wide
+static void init_blur_buf(
+      /*    out */       vy_blur_buf_type *buf,
+      /* in     */ const uint32_t max_width
+      )
+{
+   // source row is read at x+2 for the vector starting at x, and the
+   //    last vector can start just short of max_width
+   uint32_t stride = (max_width + 2 + BLUR_LANES - 1) & ~(BLUR_LANES - 1u);
+   stride += BLUR_LANES;
+   buf->stride = stride;
+   const uint32_t num_rows = BLUR_NUM_ROWS + 2;
+   buf->heap_ = calloc(num_rows * BLUR_NUM_PLANES * stride,
+         sizeof *buf->heap_);
+   uint16_t *row = buf->heap_;
+   for (uint32_t p=0; p<BLUR_NUM_PLANES; p++) {
+      for (uint32_t r=0; r<BLUR_NUM_ROWS; r++) {
+         buf->hsum[r][p] = row;
+         row += stride;
+      }
+      buf->src_row[p] = row;
+      row += stride;
+      buf->out_row[p] = row;
+      row += stride;
+   }
+}
+
+
+// horizontal pass. splits src row into planes and stores [1 2 1] sums
+//    of v and y, and OR of border, in hsum. if radius is not NULL
+//    then the row's radius values are copied there
+static void blur_row_horizontal(
+      /* in out */       vy_blur_buf_type *buf,
+      /* in     */ const pixel_cam_info_type *src,
+      /* in     */ const uint32_t width,
+      /*    out */       uint16_t **hsum,
+      /*    out */       uint16_t *radius
+      )
+{
+   uint16_t ** restrict row = buf->src_row;
+   for (uint32_t x=0; x<width; x++) {
+      const pixel_cam_info_type *pix = &src[x];
+      for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+         row[i][x+1] = pix->color.channel[i];
+      }
+      row[BORDER_CHAN_IDX][x+1] = pix->border;
+   }
+   if (radius != NULL) {
+      for (uint32_t x=0; x<width; x++) {
+         radius[x] = src[x].radius;
+      }
+   }
+   // replicate edge pixels
+   for (uint32_t p=0; p<BLUR_NUM_PLANES; p++) {
+      row[p][0] = row[p][1];
+      row[p][width+1] = row[p][width];
+   }
+   for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+      const uint16_t *chan = row[i];
+      uint16_t *sum = hsum[i];
+      for (uint32_t x=0; x<width; x+=BLUR_LANES) {
+         const blur_u16x8_type left = load_u16x8(&chan[x]);
+         const blur_u16x8_type center = load_u16x8(&chan[x+1]);
+         const blur_u16x8_type right = load_u16x8(&chan[x+2]);
+         store_u16x8(&sum[x], left + (center << 1) + right);
+      }
+   }
+   const uint16_t *border = row[BORDER_CHAN_IDX];
+   uint16_t *sum = hsum[BORDER_CHAN_IDX];
+   for (uint32_t x=0; x<width; x+=BLUR_LANES) {
+      const blur_u16x8_type left = load_u16x8(&border[x]);
+      const blur_u16x8_type center = load_u16x8(&border[x+1]);
+      const blur_u16x8_type right = load_u16x8(&border[x+2]);
+      store_u16x8(&sum[x], left | center | right);
+   }
+}
+
+
+// vertical pass. combines horizontal sums of rows above, at and below
+//    dest and writes result to dest. radius and cam_num are untouched.
+//    if planes is not NULL, the result is also written to the planes,
+//    starting at element 'offset'
+static void blur_row_vertical(
+      /* in out */       vy_blur_buf_type *buf,
+      /* in     */       uint16_t **top,
+      /* in     */       uint16_t **mid,
+      /* in     */       uint16_t **bot,
+      /* in     */ const uint32_t width,
+      /* in out */       pixel_cam_info_type *dest,
+      /* in out */       optical_up_planes_type *planes,
+      /* in     */ const uint32_t offset
+      )
+{
+   uint16_t ** restrict out = buf->out_row;
+   const blur_u16x8_type round = {
+         8, 8, 8, 8, 8, 8, 8, 8
+   };
+   for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+      for (uint32_t x=0; x<width; x+=BLUR_LANES) {
+         const blur_u16x8_type t = load_u16x8(&top[i][x]);
+         const blur_u16x8_type m = load_u16x8(&mid[i][x]);
+         const blur_u16x8_type b = load_u16x8(&bot[i][x]);
+         store_u16x8(&out[i][x], (t + (m << 1) + b + round) >> 4);
+      }
+   }
+   for (uint32_t x=0; x<width; x+=BLUR_LANES) {
+      const blur_u16x8_type t = load_u16x8(&top[BORDER_CHAN_IDX][x]);
+      const blur_u16x8_type m = load_u16x8(&mid[BORDER_CHAN_IDX][x]);
+      const blur_u16x8_type b = load_u16x8(&bot[BORDER_CHAN_IDX][x]);
+      store_u16x8(&out[BORDER_CHAN_IDX][x], t | m | b);
+   }
+   for (uint32_t x=0; x<width; x++) {
+      pixel_cam_info_type *pix = &dest[x];
+      for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+         pix->color.channel[i] = (uint8_t) out[i][x];
+      }
+      pix->border = (uint8_t) out[BORDER_CHAN_IDX][x];
+   }
+   if (planes != NULL) {
+      for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+         const uint16_t * restrict chan = out[i];
+         uint8_t * restrict plane = &planes->channel[i][offset];
+         for (uint32_t x=0; x<width; x++) {
+            plane[x] = (uint8_t) chan[x];
+         }
+      }
+      const uint16_t * restrict border = out[BORDER_CHAN_IDX];
+      uint8_t * restrict plane = &planes->border[offset];
+      for (uint32_t x=0; x<width; x++) {
+         plane[x] = (uint8_t) border[x];
+      }
+   }
+}
+
+
+// blurs a single image in place. if planes is not NULL, the blurred
+//    image is stored there as well
+static void blur_image_r1(
+      /* in out */       vy_blur_buf_type *buf,
+      /* in out */       pixel_cam_info_type *img,
+      /* in     */ const image_size_type size,
+      /* in out */       optical_up_planes_type *planes
+      )
+{
+   const uint32_t width = size.width;
+   const uint32_t height = size.height;
+   if ((width == 0) || (height == 0)) {
+      return;
+   }
+   assert(width + 2 + BLUR_LANES <= buf->stride);
+   // a row's horizontal sums are computed before the row above it is
+   //    overwritten, and that row's sums aren't needed after the row
+   //    below it is written, so 3 rows of sums is enough
+   uint16_t *radius = (planes != NULL) ? planes->radius : NULL;
+   blur_row_horizontal(buf, img, width, buf->hsum[0], radius);
+   if (height > 1) {
+      blur_row_horizontal(buf, &img[width], width, buf->hsum[1],
+            (radius != NULL) ? &radius[width] : NULL);
+   }
+   for (uint32_t y=0; y<height; y++) {
+      uint16_t **mid = buf->hsum[y % BLUR_NUM_ROWS];
+      uint16_t **top = (y == 0) ? mid : buf->hsum[(y-1) % BLUR_NUM_ROWS];
+      uint16_t **bot = (y+1 == height) ? mid :
+            buf->hsum[(y+1) % BLUR_NUM_ROWS];
+      blur_row_vertical(buf, top, mid, bot, width, &img[y*width],
+            planes, y*width);
+      if (y+2 < height) {
+         blur_row_horizontal(buf, &img[(y+2)*width], width,
+               buf->hsum[(y+2) % BLUR_NUM_ROWS],
+               (radius != NULL) ? &radius[(y+2)*width] : NULL);
+      }
+   }
+}
+
+
+#if OPTICAL_UP_PLANES == 1
+// allocates planes for all pyramid levels of out. size[] must be set
+static void init_output_planes(
+      /* in out */       optical_up_output_type *out,
+      /* in     */ const uint8_t cam_num
+      )
+{
+   uint32_t n_pix = 0;
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      n_pix += (uint32_t) (out->size[lev].width * out->size[lev].height);
+   }
+   out->planes_heap_ = malloc(n_pix *
+         (sizeof(uint16_t) + NUM_IMAGE_CHANNELS + 1));
+   // radius planes first so they stay 2-byte aligned
+   uint8_t *heap = out->planes_heap_;
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      const uint32_t lev_pix =
+            (uint32_t) (out->size[lev].width * out->size[lev].height);
+      out->planes[lev].radius = (uint16_t*) heap;
+      heap += lev_pix * sizeof(uint16_t);
+   }
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      const uint32_t lev_pix =
+            (uint32_t) (out->size[lev].width * out->size[lev].height);
+      optical_up_planes_type *planes = &out->planes[lev];
+      for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+         planes->channel[i] = heap;
+         heap += lev_pix;
+      }
+      planes->border = heap;
+      heap += lev_pix;
+      planes->cam_num = cam_num;
+   }
+}
+#endif   // OPTICAL_UP_PLANES
+
+
+// ideally blurring would occur in analysis planes, where algorithm there
+//    could decide appropriate blurring level. however, analysis planes
+//    read from panorama, and at the pan level images are merged and
+//    broken apart into fg and bg sections, making a blurring task much more
+//    complex and inefficient. until pan rewritten to pass on image data
+//    more directly and efficiently, do blurring here
+// all pyramid levels are blurred
+static void blur_output_r1(
+      /* in out */       optical_up_class_type *upright,
+      /* in out */       optical_up_output_type *out
+      )
+{
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+#if OPTICAL_UP_PLANES == 1
+      optical_up_planes_type *planes = &out->planes[lev];
+#else
+      optical_up_planes_type *planes = NULL;
+#endif   // OPTICAL_UP_PLANES
+      blur_image_r1(&upright->blur_buf, out->frame[lev], out->size[lev],
+            planes);
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+#if defined(TEST_BLUR)
+
+#include "timekeeper.h"
+
+// straightforward 3x3 convolution, for comparison
+static void reference_blur(
+      /* in     */ const pixel_cam_info_type *src,
+      /* in     */ const image_size_type size,
+      /*    out */       pixel_cam_info_type *dest
+      )
+{
+   const int32_t w = size.width;
+   const int32_t h = size.height;
+   const uint32_t wt[3] = { 1, 2, 1 };
+   for (int32_t y=0; y<h; y++) {
+      for (int32_t x=0; x<w; x++) {
+         uint32_t sum[NUM_IMAGE_CHANNELS] = { 0 };
+         uint8_t border = 0;
+         for (int32_t dy=-1; dy<=1; dy++) {
+            int32_t yy = y + dy;
+            yy = yy < 0 ? 0 : (yy >= h ? h-1 : yy);
+            for (int32_t dx=-1; dx<=1; dx++) {
+               int32_t xx = x + dx;
+               xx = xx < 0 ? 0 : (xx >= w ? w-1 : xx);
+               const pixel_cam_info_type *pix = &src[xx + yy*w];
+               for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+                  sum[i] += wt[dx+1] * wt[dy+1] * pix->color.channel[i];
+               }
+               border |= pix->border;
+            }
+         }
+         pixel_cam_info_type *pix = &dest[x + y*w];
+         *pix = src[x + y*w];
+         for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+            pix->color.channel[i] = (uint8_t) ((sum[i] + 8) >> 4);
+         }
+         pix->border = border;
+      }
+   }
+}
+
+
+static void fill_random(
+      /*    out */       pixel_cam_info_type *img,
+      /* in     */ const uint32_t n_pix,
+      /* in out */       uint32_t *seed
+      )
+{
+   for (uint32_t i=0; i<n_pix; i++) {
+      *seed = *seed * 1103515245u + 12345u;
+      img[i].color.v = (uint8_t) (*seed >> 16);
+      img[i].color.y = (uint8_t) (*seed >> 24);
+      img[i].radius = (uint16_t) (*seed >> 4);
+      img[i].border = ((*seed >> 9) & 15) == 0 ? 255 : 0;
+      img[i].cam_num = (uint8_t) (*seed >> 12);
+   }
+}
+
+
+static uint32_t count_mismatches(
+      /* in     */ const pixel_cam_info_type *a,
+      /* in     */ const pixel_cam_info_type *b,
+      /* in     */ const uint32_t n_pix
+      )
+{
+   uint32_t errs = 0;
+   for (uint32_t i=0; i<n_pix; i++) {
+      if (memcmp(&a[i], &b[i], sizeof a[i]) != 0) {
+         if (errs < 5) {
+            printf("    pixel %d: got %d,%d,%d expected %d,%d,%d\n", i,
+                  a[i].color.v, a[i].color.y, a[i].border,
+                  b[i].color.v, b[i].color.y, b[i].border);
+         }
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+// single bright pixel in center of 3x3 image. expected output is
+//    worked out by hand
+static uint32_t test_golden(
+      /* in out */       vy_blur_buf_type *buf
+      )
+{
+   uint32_t errs = 0;
+   printf("Testing blur of golden image\n");
+   const image_size_type size = { .width = 3, .height = 3 };
+   const uint8_t expected_y[9] = {
+         10, 20, 10,
+         20, 40, 20,
+         10, 20, 10
+   };
+   pixel_cam_info_type img[9];
+   memset(img, 0, sizeof img);
+   for (uint32_t i=0; i<9; i++) {
+      img[i].color.v = 200;
+      img[i].radius = (uint16_t) i;
+   }
+   img[4].color.y = 160;
+   img[8].border = 255;
+   blur_image_r1(buf, img, size, NULL);
+   for (uint32_t i=0; i<9; i++) {
+      // flat v channel stays flat, including at edges
+      if ((img[i].color.y != expected_y[i]) || (img[i].color.v != 200)) {
+         printf("  pixel %d: y=%d v=%d, expected y=%d v=200\n", i,
+               img[i].color.y, img[i].color.v, expected_y[i]);
+         errs++;
+      }
+      // border spreads to pixels adjacent to bottom-right corner
+      const uint8_t border = ((i == 4) || (i == 5) || (i == 7) || (i == 8))
+            ? 255 : 0;
+      if (img[i].border != border) {
+         printf("  pixel %d: border=%d, expected %d\n", i, img[i].border,
+               border);
+         errs++;
+      }
+      if (img[i].radius != i) {
+         printf("  pixel %d: radius changed\n", i);
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+// compares blur to reference on random images, including sizes that
+//    aren't a multiple of the vector width and images 1 pixel wide/high.
+//    also checks that planar output matches the blurred image
+static uint32_t test_vs_reference(
+      /* in out */       vy_blur_buf_type *buf
+      )
+{
+   uint32_t errs = 0;
+   printf("Comparing blur to reference 3x3 convolution\n");
+   const image_size_type sizes[] = {
+         { .width = 1, .height = 1 },
+         { .width = 1, .height = 7 },
+         { .width = 9, .height = 1 },
+         { .width = 2, .height = 2 },
+         { .width = 8, .height = 8 },
+         { .width = 13, .height = 9 },
+         { .width = 17, .height = 3 },
+         { .width = 820, .height = 616 },
+         { .width = 410, .height = 308 }
+   };
+   const uint32_t num_sizes = sizeof sizes / sizeof sizes[0];
+   const uint32_t max_pix = 820 * 616;
+   pixel_cam_info_type *img = malloc(max_pix * sizeof *img);
+   pixel_cam_info_type *expected = malloc(max_pix * sizeof *expected);
+   uint8_t *plane_heap = malloc(max_pix * (sizeof(uint16_t) +
+         NUM_IMAGE_CHANNELS + 1));
+   optical_up_planes_type planes;
+   planes.radius = (uint16_t*) plane_heap;
+   planes.border = &plane_heap[max_pix * sizeof(uint16_t)];
+   for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+      planes.channel[i] = &planes.border[(i+1) * max_pix];
+   }
+   uint32_t seed = 1;
+   for (uint32_t i=0; i<num_sizes; i++) {
+      const image_size_type size = sizes[i];
+      const uint32_t n_pix = (uint32_t) (size.width * size.height);
+      fill_random(img, n_pix, &seed);
+      reference_blur(img, size, expected);
+      blur_image_r1(buf, img, size, &planes);
+      uint32_t mismatch = count_mismatches(img, expected, n_pix);
+      if (mismatch > 0) {
+         printf("  %dx%d: %d pixels differ\n", size.width, size.height,
+               mismatch);
+         errs++;
+      }
+      uint32_t plane_mismatch = 0;
+      for (uint32_t j=0; j<n_pix; j++) {
+         if ((planes.channel[0][j] != img[j].color.channel[0]) ||
+               (planes.channel[1][j] != img[j].color.channel[1]) ||
+               (planes.border[j] != img[j].border) ||
+               (planes.radius[j] != img[j].radius)) {
+            plane_mismatch++;
+         }
+      }
+      if (plane_mismatch > 0) {
+         printf("  %dx%d: %d plane pixels differ\n", size.width,
+               size.height, plane_mismatch);
+         errs++;
+      }
+   }
+   free(img);
+   free(expected);
+   free(plane_heap);
+   return errs;
+}
+
+
+#define BENCH_ITERATIONS   50
+
+static void time_blur(
+      /* in out */       optical_up_class_type *upright
+      )
+{
+   printf("Timing blur_output_r1\n");
+   optical_up_output_type out;
+   memset(&out, 0, sizeof out);
+   uint32_t n_pix = 0;
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      out.size[lev].width = (uint16_t) (820 >> lev);
+      out.size[lev].height = (uint16_t) (616 >> lev);
+      n_pix += (uint32_t) (out.size[lev].width * out.size[lev].height);
+   }
+   out.pyramid_ = malloc(n_pix * sizeof *out.pyramid_);
+   uint32_t seed = 7;
+   fill_random(out.pyramid_, n_pix, &seed);
+   pixel_cam_info_type *frame = out.pyramid_;
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      out.frame[lev] = frame;
+      frame += out.size[lev].width * out.size[lev].height;
+   }
+#if OPTICAL_UP_PLANES == 1
+   init_output_planes(&out, 0);
+#endif   // OPTICAL_UP_PLANES
+   double total = 0.0;
+   double max_sec = 0.0;
+   for (uint32_t i=0; i<BENCH_ITERATIONS; i++) {
+      double t0 = system_now();
+      blur_output_r1(upright, &out);
+      double dt = system_now() - t0;
+      total += dt;
+      if (dt > max_sec) {
+         max_sec = dt;
+      }
+   }
+   printf("  %d levels, %dx%d at level 0: %.3f ms/call (max %.3f)\n",
+         NUM_PYRAMID_LEVELS, out.size[0].width, out.size[0].height,
+         1000.0 * total / BENCH_ITERATIONS, 1000.0 * max_sec);
+   free(out.pyramid_);
+#if OPTICAL_UP_PLANES == 1
+   free(out.planes_heap_);
+#endif   // OPTICAL_UP_PLANES
+}
+
+
+int main(int argc, char** argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   optical_up_class_type *upright = calloc(1, sizeof *upright);
+   init_blur_buf(&upright->blur_buf, 820);
+   errs += test_golden(&upright->blur_buf);
+   errs += test_vs_reference(&upright->blur_buf);
+   time_blur(upright);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
+#endif   // TEST_BLUR
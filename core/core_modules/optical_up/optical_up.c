@@ -26,6 +26,7 @@
 #include "pinet.h"
 #include "kernel.h"
 #include "logger.h"
+#include "timekeeper.h"
 
 #include "core_modules/optical_up.h"
 #include "core_modules/attitude.h"
@@ -124,16 +125,18 @@ static void optical_up_class_pre_run(struct datap_desc *self)
       if (lev == 0) {
          optical_up->size_horiz.degrees = (double) sz.x * dpp;
          optical_up->size_vert.degrees = (double) sz.y * dpp;
-         uint32_t n_pix = (uint32_t) (sz.x * sz.y);
 //printf("upright size: %d,%d  (%f,%f) ppd %f\n", sz.x, sz.y, (double) optical_up->size_horiz.degrees, (double) optical_up->size_vert.degrees, (double) ppd);
          // allocate blur buf here. lowest pyramid level is the largest.
          //    allocate buffer for it and it'll be large enough for the
          //    other layers
-         optical_up->blur_buf = malloc(n_pix * sizeof *optical_up->blur_buf);
+         init_blur_buf(&optical_up->blur_buf, (uint32_t) sz.x);
       }
       optical_up->accum[lev] = create_vy_accumulator(sz,
             optical_up->size_horiz, optical_up->size_vert);
+      optical_up->radius_map[lev] = create_radius_map(sz);
    }
+   latency_reset(&optical_up->blur_time);
+   optical_up->blur_report_sec = system_now();
    // set element size and queue length
    self->element_size = sizeof(optical_up_output_type);
    self->queue_length = OPTICAL_UP_QUEUE_LEN;
@@ -162,6 +165,9 @@ static void optical_up_class_pre_run(struct datap_desc *self)
          out->frame[lev] = &out->pyramid_[offset];
          offset += n_pix;
       }
+#if OPTICAL_UP_PLANES == 1
+      init_output_planes(out, optical_up->camera_num);
+#endif   // OPTICAL_UP_PLANES
    }
    //
    // make sure both image and attitude subscribers are connected
@@ -245,7 +251,19 @@ static void optical_up_class_run(
                (double) output->world_center.lon.angle32 * BAM32_TO_DEG);
 //printf("%.3f   %s image center at: lat=%f, lon=%f\n", t, self->td->obj_name, (double) output->world_center.lat, (double) output->world_center.lon);
          flatten_accumulators(optical_up, output);
+         const double blur_start = system_now();
          blur_output_r1(optical_up, output);
+         const double blur_end = system_now();
+         latency_add(&optical_up->blur_time, blur_end - blur_start);
+         if ((blur_end - optical_up->blur_report_sec) >=
+               DP_LATENCY_REPORT_SEC) {
+            char label[STR_LEN];
+            snprintf(label, STR_LEN, "%s blur", self->td->obj_name);
+            log_latency_summary(optical_up->log, &optical_up->blur_time,
+                  label);
+            latency_reset(&optical_up->blur_time);
+            optical_up->blur_report_sec = blur_end;
+         }
          if (optical_up->data_folder != NULL) {
             save_pnm_file(optical_up, t, output);
          }
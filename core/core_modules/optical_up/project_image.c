@@ -29,6 +29,7 @@
 #include "core_modules/optical_up.h"
 #include "accumulator.h"
 #include "accumulator.c"
+#include "blur.c"
 
 /* Rough derivation of 'undistorted' camera image to perspective view.
 Image returned by camera is 'undistorted' in the sense that distances
@@ -58,127 +59,6 @@ image center.
 
 */
 
-static const uint32_t BORDER_CHAN_IDX = NUM_IMAGE_CHANNELS;
-
-// ideally blurring would occur in analysis planes, where algorithm there
-//    could decide appropriate blurring level. however, analysis planes
-//    read from panorama, and at the pan level images are merged and
-//    broken apart into fg and bg sections, making a blurring task much more
-//    complex and inefficient. until pan rewritten to pass on image data
-//    more directly and efficiently, do blurring here
-static void blur_output_r1(
-      /* in out */       optical_up_class_type *upright,
-      /* in out */       optical_up_output_type *out
-      )
-{
-   vy_blur_pixel_type *buf = upright->blur_buf;
-   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
-      pixel_cam_info_type *src = out->frame[lev];
-      image_size_type size = out->size[lev];
-      //////////////////////////////////////////////////////////////////
-      // horizontal blur
-      {
-         pixel_cam_info_type left0, center, right0;
-         for (unsigned int y=0; y<size.height; y++) {
-            unsigned int ctr_idx = y * size.width;
-            ////////////////////////////////////////////////
-            // left col
-            center = src[ctr_idx];
-            right0 = src[ctr_idx+1];
-            vy_blur_pixel_type *pix = &buf[ctr_idx];
-            for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
-               pix->channel[i] = (uint8_t) ((
-                     center.color.channel[i] +
-                     right0.color.channel[i]) >> 1);
-            }
-            pix->channel[BORDER_CHAN_IDX] = center.border | right0.border;
-            ++ctr_idx;
-            ////////////////////////////////////////////////
-            // middle cols
-            for (int x=1; x<size.width-1; x++) {
-               left0 = center;
-               center = right0;
-               pix = &buf[ctr_idx];
-               for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
-                  pix->channel[i] = (uint8_t) ((
-                        left0.color.channel[i] +
-                        2*center.color.channel[i] +
-                        right0.color.channel[i]) >> 2);
-               }
-               // border is all or none, so OR values
-               pix->channel[BORDER_CHAN_IDX] =
-                     left0.border | center.border | right0.border;
-               ++ctr_idx;
-               right0 = src[ctr_idx];
-            }
-            ////////////////////////////////////////////////
-            // right col
-            left0 = center;
-            center = right0;
-            pix = &buf[ctr_idx];
-            for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
-               pix->channel[i] = (uint8_t) ((
-                     left0.color.channel[i] +
-                     center.color.channel[i]) >> 1);
-            }
-            pix->channel[BORDER_CHAN_IDX] = left0.border | center.border;
-         }
-      }
-      /////////////////////////////////////////////////////////////////////
-      // vertical blur
-      pixel_cam_info_type *dest = out->frame[lev];
-      {
-         vy_blur_pixel_type top0, center, bot0;
-         for (int x=0; x<size.width; x++) {
-            uint32_t ctr_idx = (uint32_t) x;
-            ////////////////////////////////////////////////
-            // top row
-            center = buf[ctr_idx];
-            bot0 = buf[ctr_idx+size.width];
-            pixel_cam_info_type *pix = &dest[ctr_idx];
-            for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
-               pix->color.channel[i] = (uint8_t) ((
-                     center.channel[i] +
-                     bot0.channel[i]) >> 1);
-            }
-            pix->border = center.channel[BORDER_CHAN_IDX] |
-                  bot0.channel[BORDER_CHAN_IDX];
-            ctr_idx += size.width;
-            ////////////////////////////////////////////////
-            // middle rows
-            for (int y=1; y<size.height-1; y++) {
-               top0 = center;
-               center = bot0;
-               pix = &dest[ctr_idx];
-               for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
-                  dest->color.channel[i] = (uint8_t) ((
-                        top0.channel[i] +
-                        2*center.channel[i] +
-                        bot0.channel[i]) >> 2);
-               }
-               pix->border = top0.channel[BORDER_CHAN_IDX] |
-                     center.channel[BORDER_CHAN_IDX] |
-                     bot0.channel[BORDER_CHAN_IDX];
-               ctr_idx += size.width;
-               bot0 = buf[ctr_idx];
-            }
-            ////////////////////////////////////////////////
-            // bottom row
-            top0 = center;
-            center = bot0;
-            pix = &dest[ctr_idx];
-            for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
-               pix->color.channel[i] = (uint8_t)
-                     ((top0.channel[i] + center.channel[i]) >> 1);
-            }
-            pix->border = top0.channel[BORDER_CHAN_IDX] |
-                  center.channel[BORDER_CHAN_IDX];
-         }
-      }
-   }
-}
-
-
 // pushes content from (non-normalized) accumulators to pixel arrays
 //    for v and y channels at all pyramid levels
 static void flatten_accumulators(
@@ -199,8 +79,8 @@ static void flatten_accumulators(
       vy_accumulator_type *accum = upright->accum[level];
       vy_accumulator_element_type *elements = accum->accum;
       const image_size_type img_sz = upright->size[level];
-      int32_t half_width = img_sz.x / 2;
-      int32_t half_height = img_sz.y / 2;
+      // distance from center
+      const uint16_t *radius = upright->radius_map[level];
       // sink
       pixel_cam_info_type *pix = out->frame[level];
       // copy data, setting boundary pixels to empty
@@ -219,8 +99,6 @@ static void flatten_accumulators(
             *pix = empty_pix;
             pix++;
             idx++;
-            const int dy = half_height - (int) y;
-            const int y2 = dy * dy;
             for (int32_t x=1; x<img_sz.cols-1; x++) {
                const vy_accumulator_element_type *acc = &elements[idx];
                const uint32_t scale = acc->w;
@@ -232,9 +110,7 @@ static void flatten_accumulators(
                if (scale > 0) {
                   pix->color.y = (uint8_t) (acc->y / scale);
                   pix->color.v = (uint8_t) (acc->v / scale);
-                  // estimate radius from center
-                  int dx = half_width - (int) x;
-                  pix->radius = (uint16_t) sqrt((double) (y2 + dx * dx));
+                  pix->radius = radius[idx];
                   pix->cam_num = camera_num;
                   // adjust border to be binary on/off (255/0)
                   pix->border = (acc->z != 0) ? 255 : 0;
@@ -254,6 +130,29 @@ static void flatten_accumulators(
 }
 
 
+// builds map of each output pixel's distance from image center
+//    for flatten_accumulators(). this doesn't change between frames
+static uint16_t * create_radius_map(
+      /* in     */ const image_size_type img_sz
+      )
+{
+   uint16_t *radius = malloc((uint32_t) (img_sz.x * img_sz.y) *
+         sizeof *radius);
+   int32_t half_width = img_sz.x / 2;
+   int32_t half_height = img_sz.y / 2;
+   uint32_t idx = 0;
+   for (int32_t y=0; y<img_sz.rows; y++) {
+      const int dy = half_height - (int) y;
+      const int y2 = dy * dy;
+      for (int32_t x=0; x<img_sz.cols; x++) {
+         int dx = half_width - (int) x;
+         radius[idx++] = (uint16_t) sqrt((double) (y2 + dx * dx));
+      }
+   }
+   return radius;
+}
+
+
 // extracted code from raw_image_to_accumulator. pushes image to a
 //    single accumulator
 // pushing to accumulator takes a huge %age of CPU w/ first iteration
@@ -291,13 +190,22 @@ static void push_image_to_accumulator(
       uint32_t num_cols = src_img->img_size[lev].cols;
       uint32_t idx = 0;
       //
+      const uint8_t *row_missing = src_img->row_missing[lev];
       for (uint32_t y=0; y<num_rows; y++) {
+         // rows lost in transport were filled from their neighbors. don't
+         //    push them, so they don't add weight where nothing was seen
+         if (row_missing[y]) {
+            idx += num_cols;
+            continue;
+         }
          // to keep track of where borders are, so the artifacts they
          //    produce can be kept out of edge detection algorithm,
          //    an auxiliary color channel (z) is kept, with 255 being
          //    used on border pixels. any pixel with the border channel
-         //    non-zero is omitted from edge detection
-         int yborder = ((y==0) || (y==(num_rows-1))) ? 255 : 0;
+         //    non-zero is omitted from edge detection. rows next to
+         //    missing rows are treated as border too
+         int yborder = ((y==0) || (y==(num_rows-1))
+               || row_missing[y-1] || row_missing[y+1]) ? 255 : 0;
          for (uint32_t x=0; x<num_cols; x++) {
 //printf("imt %d,%d\n", x, y);
             int xborder = ((x==0) || (x==(num_cols-1))) ? 255 : 0;
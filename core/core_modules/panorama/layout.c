@@ -98,6 +98,16 @@ void write_array_image(
 }
 
 
+// color grid values are accumulated in single-precision lanes. keep the
+//    distribution size a multiple of the vector width
+typedef float pan_f32x4_type __attribute__ ((vector_size (16)));
+#define COLOR_GRID_LANES   (sizeof(pan_f32x4_type) / sizeof(float))
+
+#if (COLOR_GRID_DIST_SIZE % 4) != 0
+#error "COLOR_GRID_DIST_SIZE must be a multiple of 4"
+#endif   // COLOR_GRID_DIST_SIZE
+
+
 // initialize color grid, setting size values and allocating memory for
 //    grid array
 static void init_color_grid(
@@ -105,13 +115,15 @@ static void init_color_grid(
       )
 {
    // calculate location of grid top and get number of rows
-   float above_deg = WORLD_HEIGHT_ABOVE_HORIZ_DEGS + GRID_BELOW_HORIZON_OFFSET;
-   float below_deg = WORLD_HEIGHT_BELOW_HORIZ_DEGS - GRID_BELOW_HORIZON_OFFSET;
+   double above_deg = WORLD_HEIGHT_ABOVE_HORIZ_DEGS +
+         (double) GRID_BELOW_HORIZON_OFFSET;
+   double below_deg = WORLD_HEIGHT_BELOW_HORIZ_DEGS -
+         (double) GRID_BELOW_HORIZON_OFFSET;
    // find integeral number of grid rows above and below offset line
    const uint32_t num_rows_above = (uint32_t)
-         (above_deg / COLOR_GRID_UNIT_HEIGHT_DEG + 0.9999f);
+         (above_deg / (double) COLOR_GRID_UNIT_HEIGHT_DEG + 0.9999);
    const uint32_t num_rows_below = (uint32_t)
-         (below_deg / COLOR_GRID_UNIT_HEIGHT_DEG + 0.9999f);
+         (below_deg / (double) COLOR_GRID_UNIT_HEIGHT_DEG + 0.9999);
    const uint32_t num_rows = num_rows_above + num_rows_below;
    grid->size.rows = (uint16_t) num_rows;
    const uint32_t num_cols = NUM_COLOR_GRIDS_HORIZ;
@@ -120,163 +132,480 @@ static void init_color_grid(
    // get top offset (virtual top of grid). offset is the number of pixels
    //    between actual top of panoramic view and where top of first grid
    //    row lies
-   float gap_deg = COLOR_GRID_UNIT_HEIGHT_DEG * (float) num_rows_above -
-         above_deg;
+   double gap_deg = (double) COLOR_GRID_UNIT_HEIGHT_DEG *
+         (double) num_rows_above - above_deg;
    for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
       grid->top_buffer[lev] = (uint32_t) (gap_deg * PIX_PER_DEG[lev]);
    }
    // allocate grid array
    uint32_t n_units = (uint32_t) (num_rows * num_cols);
    grid->grid = calloc(n_units, sizeof grid->grid[0]);
+   grid->sync_gen = 0;
 }
 
 
-// update each color grid unit with color from pixels in area that it covers
-static void push_to_color_grid(
-      /* in out */       pan_color_grid_type *grid,
-      /* in out */       frame_page_type *page
+// allocates row buffers and pixel-to-grid lookup for updating grid
+static void init_color_grid_accum(
+      /*    out */       pan_color_grid_accum_type *accum,
+      /* in     */ const pan_color_grid_type *grid
       )
 {
-   panorama_output_type *out = page->frame;
-   static const uint32_t BIN_WIDTH = 256 / COLOR_GRID_DIST_SIZE;
-printf("TAU: %.4f\n", 1.0 - COLOR_GRID_TAU);
-   //
+   const uint32_t num_cols = grid->size.cols;
+   const uint32_t num_rows = grid->size.rows;
+   const uint32_t n_units = num_cols * num_rows;
+   accum->weight = 1.0f;
    for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
-      // make shorthand copies to access values
-      image_size_type world_size = out->frame_size[lev];
-      image_size_type grid_size = grid->size;
-      uint32_t buffer = grid->top_buffer[lev];
-      overlap_pixel_type *pixels = out->world_frame[lev];
-      const float dpp = DEG_PER_PIX[lev];
-      //////////////////////////////////////////
-      // decay existing grid values before adding new
-      uint32_t n_units = (uint32_t) (grid_size.x * grid_size.y);
-      for (uint32_t i=0; i<n_units; i++) {
-         pan_color_grid_unit_type *unit = &grid->grid[i];
-         float *color_y = unit->color_y[lev];
-         float *color_v = unit->color_v[lev];
-         for (uint32_t j=0; j<COLOR_GRID_DIST_SIZE; j++) {
-            color_y[j] *= 1.0f - (float) COLOR_GRID_TAU;
+      // pixel to grid column mapping is monotonic so each grid column
+      //    is a contiguous run of pixels
+      const uint32_t width = WORLD_WIDTH_PIX[lev];
+      uint32_t *col_start = malloc((num_cols + 1) * sizeof *col_start);
+      uint32_t prev_col = 0;
+      col_start[0] = 0;
+      for (uint32_t x=0; x<width; x++) {
+         uint32_t col = (uint32_t) ((double) x * DEG_PER_PIX[lev] /
+               (double) COLOR_GRID_UNIT_WIDTH_DEG);
+         if (col >= num_cols) {
+            col = num_cols - 1;
          }
-         for (uint32_t j=0; j<COLOR_GRID_DIST_SIZE; j++) {
-            color_v[j] *= 1.0f - (float) COLOR_GRID_TAU;
+         while (prev_col < col) {
+            col_start[++prev_col] = x;
          }
       }
-      //////////////////////////////////////////
-      // loop through all panorama pixels
-      for (uint32_t y=0; y<world_size.y; y++) {
-         // get base indices for desired row
-         uint32_t row_idx = y * world_size.cols;
-         uint32_t grid_row = (uint32_t) (dpp * (float) (y + buffer) /
-               COLOR_GRID_UNIT_HEIGHT_DEG);
-         uint32_t grid_row_idx = grid_row * NUM_COLOR_GRIDS_HORIZ;
-         ///////////////
-         for (uint32_t x=0; x<world_size.x; x++) {
-            uint32_t pix_idx = (uint32_t) (x + row_idx);
-            overlap_pixel_type *pix = &pixels[pix_idx];
-            if (pix->fg.border != 0) {
-               // no content here
-               continue;
-            }
-            // get indices for pixel and grid unit
-            uint32_t grid_col = (uint32_t) ((float) x * dpp /
-                  COLOR_GRID_UNIT_WIDTH_DEG);
-            uint32_t grid_idx = (uint32_t) (grid_col + grid_row_idx);
-            pan_color_grid_unit_type *unit = &grid->grid[grid_idx];
-            float *color_y = unit->color_y[lev];
-            float *color_v = unit->color_v[lev];
-if (pix->fg.color.y == 0) {
-   printf("Pixel %d,%d has y=%d  v=%d -- expected border to be set\n", x, y, pix->fg.color.y, pix->fg.color.v);
-}
-            // update distribution
-            const uint32_t y_bin = (uint32_t) (pix->fg.color.y / BIN_WIDTH);
-            color_y[y_bin] += 1.0f;
-            const uint32_t v_bin = (uint32_t) (pix->fg.color.v / BIN_WIDTH);
-            color_v[v_bin] += 1.0f;
-if ((y == 100) && ((x & 7) == 0)) {
-   printf("PIX %d,%d  idx %d -> GRID %d,%d idx %d  yv: %d,%d  %d,%d  %.1f,%.1f\n", x, y, pix_idx, grid_col, grid_row, grid_idx, pix->fg.color.y, pix->fg.color.v, y_bin, v_bin, color_y[y_bin], color_v[v_bin]);
-}
+      while (prev_col < num_cols) {
+         col_start[++prev_col] = width;
+      }
+      accum->col_start[lev] = col_start;
+      // same for rows. pixel rows below the last grid row aren't binned
+      const uint32_t height = WORLD_HEIGHT_PIX[lev];
+      uint32_t *row_start = malloc((num_rows + 1) * sizeof *row_start);
+      uint32_t prev_row = 0;
+      uint32_t end_y = height;
+      row_start[0] = 0;
+      for (uint32_t y=0; y<height; y++) {
+         const uint32_t row = (uint32_t) (DEG_PER_PIX[lev] *
+               (double) (y + grid->top_buffer[lev]) /
+               (double) COLOR_GRID_UNIT_HEIGHT_DEG);
+         if (row >= num_rows) {
+            end_y = y;
+            break;
+         }
+         while (prev_row < row) {
+            row_start[++prev_row] = y;
          }
       }
-      //////////////////////////////////////////
-      // sum total content of distribution for each grid square
-      for (uint32_t i=0; i<n_units; i++) {
-         pan_color_grid_unit_type *unit = &grid->grid[i];
-         float *color_y = unit->color_y[lev];
-         float total = 0;
-         for (uint32_t j=0; j<COLOR_GRID_DIST_SIZE; j++) {
-            total += color_y[j];
-if ((lev == 0) && (i == 1230)) {
-   printf("%d Y    %2d    %.1f\n", i, j, (double) color_y[j]);
+      while (prev_row < num_rows) {
+         row_start[++prev_row] = end_y;
+      }
+      accum->row_start[lev] = row_start;
+      // counts are 16 bits
+      const double unit_pix = PIX_PER_DEG[lev] * PIX_PER_DEG[lev] *
+            (double) (COLOR_GRID_UNIT_WIDTH_DEG * COLOR_GRID_UNIT_HEIGHT_DEG);
+      assert(unit_pix < 65000.0);
+   }
+   accum->row_counts =
+         calloc(num_cols * 4 * COLOR_GRID_DIST_SIZE, sizeof(uint16_t));
+   accum->row_samples = calloc(num_cols, sizeof(uint32_t));
+   accum->row_weight = calloc(num_rows, sizeof(float));
+   accum->next_row = 0;
+   accum->max_rows_per_frame = COLOR_GRID_MAX_ROWS_PER_FRAME;
+   accum->dirty = calloc(n_units, sizeof(uint8_t));
+   accum->published = calloc(n_units, sizeof(pan_color_grid_unit_type));
+   accum->gen = 0;
+   accum->unit_gen = calloc(n_units, sizeof(uint32_t));
+   accum->empty_frames = 0;
+   accum->update_sec = 0.0;
+   accum->max_update_sec = 0.0;
+   accum->num_updates = 0;
 }
-         }
-if (lev == 0) {
-   printf("Total: %f\n", (double) total);
+
+
+// dst[i] += scale * src[i]. n must be a multiple of COLOR_GRID_LANES
+static inline void color_bins_add_scaled(
+      /* in out */       float *dst,
+      /* in     */ const float *src,
+      /* in     */ const float scale,
+      /* in     */ const uint32_t n
+      )
+{
+   const pan_f32x4_type s = { scale, scale, scale, scale };
+   for (uint32_t i=0; i<n; i+=COLOR_GRID_LANES) {
+      pan_f32x4_type d, v;
+      memcpy(&d, &dst[i], sizeof d);
+      memcpy(&v, &src[i], sizeof v);
+      d += s * v;
+      memcpy(&dst[i], &d, sizeof d);
+   }
 }
-         unit->num_samples[lev] = total;
-      }
+
+
+// dst[i] = a[i] + b[i] + c[i]. n must be a multiple of COLOR_GRID_LANES
+static inline void color_bins_sum3(
+      /*    out */       float *dst,
+      /* in     */ const float *a,
+      /* in     */ const float *b,
+      /* in     */ const float *c,
+      /* in     */ const uint32_t n
+      )
+{
+   for (uint32_t i=0; i<n; i+=COLOR_GRID_LANES) {
+      pan_f32x4_type va, vb, vc;
+      memcpy(&va, &a[i], sizeof va);
+      memcpy(&vb, &b[i], sizeof vb);
+      memcpy(&vc, &c[i], sizeof vc);
+      va += vb + vc;
+      memcpy(&dst[i], &va, sizeof va);
    }
 }
 
 
-// used when pulling color distribution data from master into out_unit
-static void append_color_data(
-      /* in     */ const pan_color_grid_unit_type *master_unit,
-      /* in out */       pan_color_grid_unit_type *out_unit
+// dst = a + b + c, for all levels
+static void color_unit_sum3(
+      /*    out */       pan_color_grid_unit_type *dst,
+      /* in     */ const pan_color_grid_unit_type *a,
+      /* in     */ const pan_color_grid_unit_type *b,
+      /* in     */ const pan_color_grid_unit_type *c
       )
 {
    for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
-      for (uint32_t i=0; i<COLOR_GRID_DIST_SIZE; i++) {
-         out_unit->color_y[lev][i] += master_unit->color_y[lev][i];
-         out_unit->color_v[lev][i] += master_unit->color_v[lev][i];
+      color_bins_sum3(dst->color_y[lev], a->color_y[lev], b->color_y[lev],
+            c->color_y[lev], COLOR_GRID_DIST_SIZE);
+      color_bins_sum3(dst->color_v[lev], a->color_v[lev], b->color_v[lev],
+            c->color_v[lev], COLOR_GRID_DIST_SIZE);
+      dst->num_samples[lev] =
+            a->num_samples[lev] + b->num_samples[lev] + c->num_samples[lev];
+   }
+}
+
+
+// counts pixel colors from one panorama row into the row buffers
+// pixels are walked one grid column at a time so the sample count
+//    stays in a register. real images have most v values in a few bins,
+//    so even and odd pixels are counted in separate sets of bins to
+//    break up the dependency chain on those bins. the sets are merged
+//    when the row is folded into the master grid
+static void bin_color_grid_row(
+      /* in out */       pan_color_grid_accum_type *accum,
+      /* in     */ const panorama_output_type *out,
+      /* in     */ const uint32_t lev,
+      /* in     */ const uint32_t y,
+      /* in     */ const uint32_t num_cols
+      )
+{
+   const uint32_t row_idx = y * out->frame_size[lev].x;
+   const uint32_t *col_start = accum->col_start[lev];
+#if PAN_SOA_LAYOUT == 1
+   const uint8_t *border = &out->soa[lev].fg_border[row_idx];
+   const uint8_t *chan_y = &out->soa[lev].fg_y[row_idx];
+   const uint8_t *chan_v = &out->soa[lev].fg_v[row_idx];
+#else
+   const overlap_pixel_type *pixels = &out->world_frame[lev][row_idx];
+#endif   // PAN_SOA_LAYOUT
+   for (uint32_t c=0; c<num_cols; c++) {
+      uint16_t *counts = &accum->row_counts[c * 4 * COLOR_GRID_DIST_SIZE];
+      uint32_t n = 0;
+      for (uint32_t x=col_start[c]; x<col_start[c+1]; x++) {
+#if PAN_SOA_LAYOUT == 1
+         if (border[x] != 0) {
+            // no content here
+            continue;
+         }
+         const uint32_t y_bin = (uint32_t) (chan_y[x] / COLOR_GRID_BIN_WIDTH);
+         const uint32_t v_bin = (uint32_t) (chan_v[x] / COLOR_GRID_BIN_WIDTH);
+#else
+         const pixel_cam_info_type *pix = &pixels[x].fg;
+         if (pix->border != 0) {
+            // no content here
+            continue;
+         }
+         const uint32_t y_bin =
+               (uint32_t) (pix->color.y / COLOR_GRID_BIN_WIDTH);
+         const uint32_t v_bin =
+               (uint32_t) (pix->color.v / COLOR_GRID_BIN_WIDTH);
+#endif   // PAN_SOA_LAYOUT
+         uint16_t *bins = &counts[(x & 1) * 2 * COLOR_GRID_DIST_SIZE];
+         bins[y_bin]++;
+         bins[COLOR_GRID_DIST_SIZE + v_bin]++;
+         n++;
       }
-      out_unit->num_samples[lev] += master_unit->num_samples[lev];
+      accum->row_samples[c] += n;
    }
 }
 
 
-static void build_output_color_dist(
-      /* in     */ const panorama_type *pan,
-      /* in out */       pan_color_grid_type *out_grid
+// adds counts for a grid row to the master grid, scaled by weight. only
+//    units that received pixels are touched, and those are marked dirty.
+//    row buffers are cleared on exit
+static void fold_color_grid_row(
+      /* in out */       panorama_type *pan,
+      /* in     */ const uint32_t lev,
+      /* in     */ const uint32_t row,
+      /* in     */ const float weight
       )
 {
-   const pan_color_grid_type *master = &pan->master_color_grid;
-   image_size_type size = master->size;
-   // copy values from pan's master color grid to output grid
-   // for each grid unit, copy values from the surround of that unit
-   //    in master
-   for (uint32_t r=0; r<size.rows; r++) {
-      uint32_t row_idx = (uint32_t) (r * size.cols);
-      for (uint32_t c=0; c<size.cols; c++) {
-         pan_color_grid_unit_type *unit = &out_grid->grid[row_idx+c];
-         // get column index in this row for left and right neighbors
-         uint32_t left_c = (uint32_t) (c - 1);
-         if (left_c >= size.cols) {
-            left_c = (uint32_t) (size.cols-1);
+   pan_color_grid_accum_type *accum = &pan->color_accum;
+   pan_color_grid_type *master = &pan->master_color_grid;
+   const uint32_t num_cols = master->size.cols;
+   for (uint32_t c=0; c<num_cols; c++) {
+      if (accum->row_samples[c] == 0) {
+         continue;
+      }
+      pan_color_grid_unit_type *unit = &master->grid[row * num_cols + c];
+      // merge even and odd pixel counts
+      uint16_t *counts = &accum->row_counts[c * 4 * COLOR_GRID_DIST_SIZE];
+      const uint16_t *odd_counts = &counts[2 * COLOR_GRID_DIST_SIZE];
+      float bins[2 * COLOR_GRID_DIST_SIZE];
+      for (uint32_t i=0; i<2*COLOR_GRID_DIST_SIZE; i++) {
+         bins[i] = (float) (counts[i] + odd_counts[i]);
+      }
+      color_bins_add_scaled(unit->color_y[lev], bins, weight,
+            COLOR_GRID_DIST_SIZE);
+      color_bins_add_scaled(unit->color_v[lev], &bins[COLOR_GRID_DIST_SIZE],
+            weight, COLOR_GRID_DIST_SIZE);
+      unit->num_samples[lev] += weight * (float) accum->row_samples[c];
+      accum->dirty[row * num_cols + c] = 1;
+      memset(counts, 0, 4 * COLOR_GRID_DIST_SIZE * sizeof *counts);
+      accum->row_samples[c] = 0;
+   }
+}
+
+
+// recomputes the published 3x3 neighborhood sum of each unit that has
+//    a dirty master unit in its neighborhood, and stamps it with the
+//    current update. columns wrap around. dirty flags are cleared on exit
+static void update_published_color_grid(
+      /* in out */       pan_color_grid_accum_type *accum,
+      /* in     */ const pan_color_grid_type *master
+      )
+{
+   const uint32_t num_cols = master->size.cols;
+   const uint32_t num_rows = master->size.rows;
+   const uint8_t *dirty = accum->dirty;
+   // horizontal sums of the rows above, at and below a unit. the
+   //    grid's top and bottom rows have only two
+   pan_color_grid_unit_type sums[3];
+   for (uint32_t r=0; r<num_rows; r++) {
+      const uint32_t r0 = (r > 0) ? r - 1 : r;
+      const uint32_t r1 = (r + 1 < num_rows) ? r + 1 : r;
+      // dirty flags for rows r0-r1 are contiguous
+      if (memchr(&dirty[r0 * num_cols], 1,
+            (r1 - r0 + 1) * num_cols) == NULL) {
+         continue;
+      }
+      for (uint32_t c=0; c<num_cols; c++) {
+         const uint32_t left_c = (c > 0) ? c - 1 : num_cols - 1;
+         const uint32_t right_c = (c + 1 < num_cols) ? c + 1 : 0;
+         uint32_t changed = 0;
+         for (uint32_t nr=r0; nr<=r1; nr++) {
+            const uint8_t *d = &dirty[nr * num_cols];
+            changed |= (uint32_t) (d[left_c] | d[c] | d[right_c]);
          }
-         uint32_t right_c = (uint32_t) (c + 1);
-         if (right_c >= size.cols) {
-            right_c = 0;
+         if (changed == 0) {
+            continue;
          }
-         // initialize output -- copy from unit to west
-         memcpy(unit, &master->grid[row_idx+left_c], sizeof *unit);
-         // copy data from east
-         append_color_data(&master->grid[row_idx+right_c], unit);
-         if (r > 0) {
-            // copy from above row
-            uint32_t top_row_idx = row_idx - size.cols;
-            append_color_data(&master->grid[top_row_idx+left_c], unit);
-            append_color_data(&master->grid[top_row_idx+c], unit);
-            append_color_data(&master->grid[top_row_idx+right_c], unit);
+         if (r1 - r0 < 2) {
+            memset(&sums[2], 0, sizeof sums[2]);
          }
-         if (r < (uint32_t) (size.rows-1)) {
-            // copy from row below
-            uint32_t bot_row_idx = row_idx + size.cols;
-            append_color_data(&master->grid[bot_row_idx+left_c], unit);
-            append_color_data(&master->grid[bot_row_idx+c], unit);
-            append_color_data(&master->grid[bot_row_idx+right_c], unit);
+         for (uint32_t nr=r0; nr<=r1; nr++) {
+            const pan_color_grid_unit_type *units =
+                  &master->grid[nr * num_cols];
+            color_unit_sum3(&sums[nr - r0], &units[left_c], &units[c],
+                  &units[right_c]);
          }
+         const uint32_t idx = r * num_cols + c;
+         color_unit_sum3(&accum->published[idx], &sums[0], &sums[1],
+               &sums[2]);
+         accum->unit_gen[idx] = accum->gen;
       }
    }
+   memset(accum->dirty, 0, num_rows * num_cols * sizeof *accum->dirty);
+}
+
+
+// copies published units that changed since output grid was last
+//    written. output grids belong to frame pages and are rewritten
+//    every queue-length frames, so this is usually a small part of
+//    the grid
+static void sync_output_color_grid(
+      /* in     */ const pan_color_grid_accum_type *accum,
+      /* in out */       pan_color_grid_type *out_grid
+      )
+{
+   const uint32_t n_units = (uint32_t) (out_grid->size.x * out_grid->size.y);
+   const uint32_t since = out_grid->sync_gen;
+   for (uint32_t i=0; i<n_units; i++) {
+      // signed difference so update count can wrap
+      if ((int32_t) (accum->unit_gen[i] - since) > 0) {
+         out_grid->grid[i] = accum->published[i];
+      }
+   }
+   out_grid->sync_gen = accum->gen;
+}
+
+
+// multiplies all values in unit array by scale
+static void rescale_color_units(
+      /* in out */       pan_color_grid_unit_type *units,
+      /* in     */ const uint32_t n_units,
+      /* in     */ const float scale
+      )
+{
+   const pan_f32x4_type s = { scale, scale, scale, scale };
+   for (uint32_t i=0; i<n_units; i++) {
+      pan_color_grid_unit_type *unit = &units[i];
+      for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+         float *color_y = unit->color_y[lev];
+         float *color_v = unit->color_v[lev];
+         for (uint32_t j=0; j<COLOR_GRID_DIST_SIZE; j+=COLOR_GRID_LANES) {
+            pan_f32x4_type vy, vv;
+            memcpy(&vy, &color_y[j], sizeof vy);
+            memcpy(&vv, &color_v[j], sizeof vv);
+            vy *= s;
+            vv *= s;
+            memcpy(&color_y[j], &vy, sizeof vy);
+            memcpy(&color_v[j], &vv, sizeof vv);
+         }
+         unit->num_samples[lev] *= scale;
+      }
+   }
+}
+
+
+// multiplies everything stored in grid units by scale, along with the
+//    weight of new samples. values are in arbitrary units so this
+//    doesn't change distributions, but all published units are
+//    rewritten so they're marked changed
+static void rescale_color_grid(
+      /* in out */       panorama_type *pan,
+      /* in     */ const float scale
+      )
+{
+   pan_color_grid_accum_type *accum = &pan->color_accum;
+   pan_color_grid_type *master = &pan->master_color_grid;
+   const uint32_t n_units = (uint32_t) (master->size.x * master->size.y);
+   rescale_color_units(master->grid, n_units, scale);
+   rescale_color_units(accum->published, n_units, scale);
+   for (uint32_t r=0; r<master->size.rows; r++) {
+      accum->row_weight[r] *= scale;
+   }
+   accum->weight *= scale;
+   for (uint32_t i=0; i<n_units; i++) {
+      accum->unit_gen[i] = accum->gen;
+   }
+}
+
+
+// empties master and published grids. all published units are marked
+//    changed so output grids are emptied as they're written
+static void clear_color_grid(
+      /* in out */       panorama_type *pan
+      )
+{
+   pan_color_grid_accum_type *accum = &pan->color_accum;
+   pan_color_grid_type *master = &pan->master_color_grid;
+   const uint32_t n_units = (uint32_t) (master->size.x * master->size.y);
+   memset(master->grid, 0, n_units * sizeof *master->grid);
+   memset(accum->published, 0, n_units * sizeof *accum->published);
+   memset(accum->row_weight, 0,
+         master->size.rows * sizeof *accum->row_weight);
+   accum->weight = 1.0f;
+   for (uint32_t i=0; i<n_units; i++) {
+      accum->unit_gen[i] = accum->gen;
+   }
+}
+
+
+// advances weight of new samples. this is the decay step
+static void advance_color_grid_weight(
+      /* in out */       panorama_type *pan
+      )
+{
+   pan_color_grid_accum_type *accum = &pan->color_accum;
+   accum->weight *= (float) (1.0 / (1.0 - COLOR_GRID_TAU));
+   if (accum->weight >= COLOR_GRID_RENORM_WEIGHT) {
+      rescale_color_grid(pan, 1.0f / accum->weight);
+   }
+}
+
+
+// update color grid units with color from pixels in area that they
+//    cover, and write neighborhood sums to the page's output grid
+// rather than decaying the entire grid each frame, the weight of new
+//    samples is increased. master units that aren't in view aren't
+//    touched
+// at most max_rows_per_frame grid rows are binned per frame, in turn.
+//    each row is owed the weight of every frame since it was last
+//    binned, and gets that on its next turn. only published units
+//    around master units that received samples are recomputed
+static void push_to_color_grid(
+      /* in out */       panorama_type *pan,
+      /* in out */       frame_page_type *page
+      )
+{
+   const double t0 = system_now();
+   panorama_output_type *out = page->frame;
+   pan_color_grid_accum_type *accum = &pan->color_accum;
+   pan_color_grid_type *master = &pan->master_color_grid;
+   const uint32_t num_rows = master->size.rows;
+   accum->gen++;
+   accum->empty_frames = 0;
+   for (uint32_t r=0; r<num_rows; r++) {
+      accum->row_weight[r] += accum->weight;
+   }
+   //
+   uint32_t num_update = accum->max_rows_per_frame;
+   if (num_update > num_rows) {
+      num_update = num_rows;
+   }
+   for (uint32_t i=0; i<num_update; i++) {
+      const uint32_t row = accum->next_row;
+      if (++accum->next_row >= num_rows) {
+         accum->next_row = 0;
+      }
+      for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+         const uint32_t *row_start = accum->row_start[lev];
+         for (uint32_t y=row_start[row]; y<row_start[row+1]; y++) {
+            bin_color_grid_row(accum, out, lev, y, master->size.cols);
+         }
+         fold_color_grid_row(pan, lev, row, accum->row_weight[row]);
+      }
+      accum->row_weight[row] = 0.0f;
+   }
+   advance_color_grid_weight(pan);
+   // publish
+   update_published_color_grid(accum, master);
+   sync_output_color_grid(accum, out->color_grid);
+   // cost
+   const double dt = system_now() - t0;
+   accum->update_sec += dt;
+   if (dt > accum->max_update_sec) {
+      accum->max_update_sec = dt;
+   }
+   if (++accum->num_updates >= COLOR_GRID_REPORT_INTERVAL) {
+      log_info(pan->log, "Color grid update %.3f ms/frame (max %.3f ms)",
+            1000.0 * accum->update_sec / accum->num_updates,
+            1000.0 * accum->max_update_sec);
+      accum->update_sec = 0.0;
+      accum->max_update_sec = 0.0;
+      accum->num_updates = 0;
+   }
+}
+
+
+// called for frames without camera input, in place of
+//    push_to_color_grid(). stored colors are decayed as they are on
+//    other frames. if there's been no input for COLOR_GRID_STALE_FRAMES
+//    then the grid no longer describes what's around and it's cleared
+static void age_color_grid(
+      /* in out */       panorama_type *pan
+      )
+{
+   pan_color_grid_accum_type *accum = &pan->color_accum;
+   accum->gen++;
+   advance_color_grid_weight(pan);
+   if (++accum->empty_frames == COLOR_GRID_STALE_FRAMES) {
+      clear_color_grid(pan);
+      log_info(pan->log, "No camera input for %.1f sec. Color grid "
+            "cleared", (double) COLOR_GRID_STALE_FRAMES / CAMERA_FPS);
+   }
 }
 
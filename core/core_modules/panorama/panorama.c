@@ -41,10 +41,15 @@ static const char phantom_config_file_[STR_LEN] = { 0 };
 
 #include "support.c"
 #include "frame_heap.c"
+#if PAN_SOA_LAYOUT == 1
+#include "soa_layout.c"
+#endif // PAN_SOA_LAYOUT
 #if INSERT_PHANTOM_IMAGE == 1
 #include "insert_phantom.c"
 #endif // INSERT_PHANTOM_IMAGE
-//#include "layout.c"
+#if PAN_COLOR_GRID == 1
+#include "layout.c"
+#endif   // PAN_COLOR_GRID
 
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -116,14 +121,17 @@ static void panorama_pre_run(struct datap_desc *self)
       node->frame = (panorama_output_type*) dp_get_object_at(self, i);
       node = node->_next;
    }
-//   /////////////////////////////////////////////
-//   // color grid
-//   init_color_grid(&pan->master_color_grid);
-//   pan->color_grid_heap =
-//         malloc(PANORAMA_QUEUE_LEN * sizeof *pan->color_grid_heap);
-//   for (uint32_t i=0; i<PANORAMA_QUEUE_LEN; i++) {
-//      init_color_grid(&pan->color_grid_heap[i]);
-//   }
+#if PAN_COLOR_GRID == 1
+   /////////////////////////////////////////////
+   // color grid
+   init_color_grid(&pan->master_color_grid);
+   init_color_grid_accum(&pan->color_accum, &pan->master_color_grid);
+   pan->color_grid_heap =
+         malloc(PANORAMA_QUEUE_LEN * sizeof *pan->color_grid_heap);
+   for (uint32_t i=0; i<PANORAMA_QUEUE_LEN; i++) {
+      init_color_grid(&pan->color_grid_heap[i]);
+   }
+#endif   // PAN_COLOR_GRID
    /////////////////////////////////////////////
    // output buffer
    // buffer is 1.5x the size of world at lowest pyramid level
@@ -135,12 +143,29 @@ static void panorama_pre_run(struct datap_desc *self)
    for (uint32_t i=0; i<PANORAMA_QUEUE_LEN; i++) {
       panorama_output_type *out =
             &((panorama_output_type*) self->void_queue)[i];
+#if PAN_SOA_LAYOUT == 1
+      // planes replace the interleaved buffer. all levels share one heap
+      out->pyramid_ = NULL;
+      out->soa_heap_ = malloc(n_pix * PAN_SOA_BYTES_PER_PIX);
+      uint8_t *heap = out->soa_heap_;
+      for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+         out->world_frame[lev] = NULL;
+         out->world_frame_idx[lev] = pyramid_offset[lev];
+         heap = assign_soa_planes(&out->soa[lev], heap,
+               WORLD_WIDTH_PIX[lev] * WORLD_HEIGHT_PIX[lev]);
+      }
+#else
       out->pyramid_ = malloc(n_pix * sizeof *out->pyramid_);
-//      out->color_grid = &pan->color_grid_heap[i];
       for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
          out->world_frame[lev] = &out->pyramid_[pyramid_offset[lev]];
          out->world_frame_idx[lev] = pyramid_offset[lev];
       }
+#endif   // PAN_SOA_LAYOUT
+#if PAN_COLOR_GRID == 1
+      out->color_grid = &pan->color_grid_heap[i];
+#else
+      out->color_grid = NULL;
+#endif   // PAN_COLOR_GRID
    }
    return;
 }
@@ -157,12 +182,9 @@ static void panorama_run(
    producer_record_type *prod_rec = &self->producer_list[0];
    datap_desc_type *prod = prod_rec->producer;
    panorama_class_type *pan = (panorama_class_type *) self->local;
-//   uint32_t n_grid_units = (uint32_t) (pan->master_color_grid.size.y *
-//         pan->master_color_grid.size.x);
    // this is redundant w/ elements produced and is used for auto-compaction
    //    of frame list. keep it distinct for to clearly separate logic
    uint32_t compaction_count = 0;
-//pan_color_grid_type *out_grid = NULL;
    //
    while ((self->run_state & DP_STATE_DONE) == 0) {
 //      log_info(pan->log, "Waiting for data");
@@ -185,7 +207,14 @@ static void panorama_run(
          ///////////////////////////////////////////////////////////////
          // write frames to panorama
          // clear storage buffers first
+#if PAN_SOA_LAYOUT == 1
+         for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+            clear_soa_frame(&page->frame->soa[lev],
+                  WORLD_WIDTH_PIX[lev] * WORLD_HEIGHT_PIX[lev]);
+         }
+#else
          clear_world_buffer(page->frame);
+#endif   // PAN_SOA_LAYOUT
          // get data source
          frame_sync_output_type *sync_input = (frame_sync_output_type*)
                dp_get_object_at(prod, p_idx);
@@ -206,8 +235,14 @@ static void panorama_run(
                //    if it's available
                if (frame != NULL) {
                   active_frames++;
+#if PAN_SOA_LAYOUT == 1
+                  project_frame_to_panorama_soa(frame, &frame->planes[lev],
+                        frame->size[lev], page->frame,
+                        &page->frame->soa[lev], out_sz, lev);
+#else
                   project_frame_to_panorama(frame, frame->size[lev],
                         page->frame, out_sz, lev);
+#endif   // PAN_SOA_LAYOUT
                }
             }
          }
@@ -218,16 +253,16 @@ static void panorama_run(
 #if INSERT_PHANTOM_IMAGE == 1
          project_phantom_images(pan, page->frame, t);
 #endif // INSERT_PHANTOM_IMAGE
-//         ///////////////////////////////////////
-//         // update color grid
-//         push_to_color_grid(&pan->master_color_grid, page);
-//         // copy master grid to output, and assign page pointer to that output
-//         uint32_t grid_idx = pan->color_grid_queue_idx++;
-//         if (grid_idx >= PANORAMA_QUEUE_LEN) {
-//            grid_idx = 0;
-//         }
-//         out_grid = page->frame->color_grid;
-//         build_output_color_dist(pan, out_grid);
+#if PAN_COLOR_GRID == 1
+         ///////////////////////////////////////
+         // update color grid and copy it to output. with no input,
+         //    colors still age
+         if (active_frames > 0) {
+            push_to_color_grid(pan, page);
+         } else {
+            age_color_grid(pan);
+         }
+#endif   // PAN_COLOR_GRID
          ///////////////////////////////////////////////////////////////
          prod_rec->consumed_elements++;   // total elements processed
          // if there were no active frames then this view is empty.
@@ -254,7 +289,9 @@ static void panorama_run(
          }
          compaction_count++;
          //
-         if (pan->data_folder) {
+         if (pan->pan_log) {
+            write_panorama_log(pan, page->frame, t);
+         } else if (pan->data_folder) {
             // export pan image at pyramid level 0
             write_panorama_image(pan, page->frame, t, 0);
          }
@@ -270,9 +307,6 @@ static void panorama_run(
    }
    log_info(pan->log, "PANORAMA exit\n");
 //write_array_image("pan_grid", &pan->master_color_grid);
-//if (out_grid) {
-//   write_array_image("out_grid", out_grid);
-//}
 }
 
 
@@ -281,9 +315,20 @@ static void panorama_post_run(
       /* in out */       datap_desc_type *self
       )
 {
-   (void) self;
 //   printf("%s in post_run\n", self->td->obj_name);
-//   panorama_class_type *pan = (panorama_class_type *) self->local;
+   panorama_class_type *pan = (panorama_class_type *) self->local;
+   if (pan->pan_log) {
+      const pan_log_writer_type *writer = pan->pan_log;
+      if (writer->num_frames > 0) {
+         const double pct = 100.0 * (double) writer->written_bytes /
+               (double) writer->raw_bytes;
+         const double ms = 1000.0 * writer->write_sec / writer->num_frames;
+         log_info(pan->log, "Panorama log: %d frames, %.1f%% of raw size, "
+               "%.3f ms/frame", writer->num_frames, pct, ms);
+      }
+      pan_log_close_writer(pan->pan_log);
+      pan->pan_log = NULL;
+   }
 //   if (pan->log_file) {
 //      fclose(pan->log_file);
 //      free(pan->log_file);
@@ -335,7 +380,7 @@ void * panorama_init(
    pan->camera_forward_position = setup->camera_position_forward;
    pan->camera_starboard_position = setup->camera_position_starboard;
    //
-   if (setup->logging == 1) {
+   if (setup->logging != PAN_LOGGING_NONE) {
       const char *folder = get_log_folder_name();
       const char *name = self->td->obj_name;
       size_t len = strlen(folder) + strlen(name) + 2;
@@ -352,6 +397,22 @@ void * panorama_init(
          log_info(pan->log, "Created output directory %s", pan->data_folder);
       }
    }
+   if ((setup->logging == PAN_LOGGING_INDEXED) && pan->data_folder) {
+      char path[STR_LEN];
+      snprintf(path, STR_LEN, "%s/%s", pan->data_folder, PAN_LOG_FILE_NAME);
+      const image_size_type size = {
+            .width = (uint16_t) WORLD_WIDTH_PIX[0],
+            .height = (uint16_t) WORLD_HEIGHT_PIX[0]
+      };
+      pan->pan_log = pan_log_open_writer(path, size);
+      if (pan->pan_log == NULL) {
+         log_err(pan->log, "Failed to create panorama log '%s'", path);
+      } else {
+         pan->log_planes = malloc(3u * WORLD_WIDTH_PIX[0] *
+               WORLD_HEIGHT_PIX[0]);
+         log_info(pan->log, "Logging panorama to %s", path);
+      }
+   }
    free(module_setup);   // allocated on heap and it's no longer needed
    //
    self->local = pan;
@@ -0,0 +1,310 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+// structure-of-arrays representation of the panorama world view
+//
+// projection of an optical-up frame into the panorama compares the
+//    radius of each incoming pixel against the radius of the existing
+//    foreground pixel and then shuffles fg/bg. with overlap_pixel
+//    records that's a 12-byte read-modify-write per pixel of which only
+//    2 bytes are used for the decision. here each field has its own
+//    plane and the blend is done 16 pixels at a time using gcc vector
+//    extensions, which map to SSE on INTEL and to NEON on RPI/RPI4
+//
+// the blend reads source pixels from the planes optical_up publishes
+//    with OPTICAL_UP_PLANES, so source rows don't need to be split
+//    up here. all pixels in a frame have the same cam_num, which is
+//    read from a constant row
+
+#if PAN_SOA_LAYOUT == 1 && OPTICAL_UP_PLANES != 1
+#error "The SoA panorama layout requires OPTICAL_UP_PLANES"
+#endif   // PAN_SOA_LAYOUT && !OPTICAL_UP_PLANES
+
+// number of pixels processed per vector op
+#define PAN_SOA_LANES      16
+
+// 16-bit lanes span two 128-bit registers on RPI and SSE-only targets
+typedef uint16_t pan_u16x16_type __attribute__ ((vector_size (32)));
+typedef int16_t pan_s16x16_type __attribute__ ((vector_size (32)));
+typedef uint8_t pan_u8x16_type __attribute__ ((vector_size (16)));
+typedef int8_t pan_s8x16_type __attribute__ ((vector_size (16)));
+
+
+// assigns plane pointers for a frame of n_pix pixels, starting at
+//    heap. returns pointer to first byte after the planes
+static uint8_t * assign_soa_planes(
+      /*    out */       pan_soa_frame_type *soa,
+      /* in     */       uint8_t *heap,
+      /* in     */ const uint32_t n_pix
+      )
+{
+   // radius planes first so they stay 2-byte aligned
+   soa->fg_radius = (uint16_t*) heap;
+   heap += n_pix * sizeof *soa->fg_radius;
+   soa->bg_radius = (uint16_t*) heap;
+   heap += n_pix * sizeof *soa->bg_radius;
+   soa->fg_y = heap;
+   heap += n_pix;
+   soa->fg_v = heap;
+   heap += n_pix;
+   soa->fg_border = heap;
+   heap += n_pix;
+   soa->fg_cam = heap;
+   heap += n_pix;
+   soa->bg_y = heap;
+   heap += n_pix;
+   soa->bg_v = heap;
+   heap += n_pix;
+   soa->bg_border = heap;
+   heap += n_pix;
+   soa->bg_cam = heap;
+   heap += n_pix;
+   return heap;
+}
+
+
+// sets all pixels in the plane representation to the same empty
+//    values that clear_world_buffer() uses
+static void clear_soa_frame(
+      /* in out */       pan_soa_frame_type *soa,
+      /* in     */ const uint32_t n_pix
+      )
+{
+   // 0xffff radius is 0xff in each byte
+   memset(soa->fg_radius, 0xff, n_pix * sizeof *soa->fg_radius);
+   memset(soa->bg_radius, 0xff, n_pix * sizeof *soa->bg_radius);
+   memset(soa->fg_y, 0, n_pix);
+   memset(soa->bg_y, 0, n_pix);
+   memset(soa->fg_v, 128, n_pix);
+   memset(soa->bg_v, 128, n_pix);
+   memset(soa->fg_border, 255, n_pix);
+   memset(soa->bg_border, 255, n_pix);
+   memset(soa->fg_cam, 255, n_pix);
+   memset(soa->bg_cam, 255, n_pix);
+}
+
+
+overlap_pixel_type pan_soa_get_pixel(
+      /* in     */ const pan_soa_frame_type *soa,
+      /* in     */ const uint32_t idx
+      )
+{
+   overlap_pixel_type pix;
+   pix.fg.color.y = soa->fg_y[idx];
+   pix.fg.color.v = soa->fg_v[idx];
+   pix.fg.radius = soa->fg_radius[idx];
+   pix.fg.border = soa->fg_border[idx];
+   pix.fg.cam_num = soa->fg_cam[idx];
+   pix.bg.color.y = soa->bg_y[idx];
+   pix.bg.color.v = soa->bg_v[idx];
+   pix.bg.radius = soa->bg_radius[idx];
+   pix.bg.border = soa->bg_border[idx];
+   pix.bg.cam_num = soa->bg_cam[idx];
+   return pix;
+}
+
+
+// selects a where mask is set, b otherwise
+static inline pan_u8x16_type select_u8(
+      /* in     */ const pan_s8x16_type mask,
+      /* in     */ const pan_u8x16_type a,
+      /* in     */ const pan_u8x16_type b
+      )
+{
+   const pan_u8x16_type m = (pan_u8x16_type) mask;
+   return (a & m) | (b & ~m);
+}
+
+static inline pan_u16x16_type select_u16(
+      /* in     */ const pan_s16x16_type mask,
+      /* in     */ const pan_u16x16_type a,
+      /* in     */ const pan_u16x16_type b
+      )
+{
+   const pan_u16x16_type m = (pan_u16x16_type) mask;
+   return (a & m) | (b & ~m);
+}
+
+
+// resolve fg/bg for one 8-bit plane pair. src_mask is set where
+//    source pixel is valid and fg_mask where it replaces foreground
+static inline void blend_u8_planes(
+      /* in     */ const pan_s8x16_type src_mask,
+      /* in     */ const pan_s8x16_type fg_mask,
+      /* in     */ const uint8_t *src,
+      /* in out */       uint8_t *fg,
+      /* in out */       uint8_t *bg
+      )
+{
+   pan_u8x16_type s, f, b;
+   memcpy(&s, src, sizeof s);
+   memcpy(&f, fg, sizeof f);
+   memcpy(&b, bg, sizeof b);
+   // new bg is old fg if src goes to fg, src if src goes to bg,
+   //    otherwise unchanged
+   const pan_u8x16_type new_bg =
+         select_u8(src_mask, select_u8(fg_mask, f, s), b);
+   const pan_u8x16_type new_fg = select_u8(fg_mask, s, f);
+   memcpy(fg, &new_fg, sizeof new_fg);
+   memcpy(bg, &new_bg, sizeof new_bg);
+}
+
+
+// blends n source pixels (starting at src[src_off]) into world pixels
+//    starting at out_idx. cam is the cam_num for each source pixel,
+//    starting at cam[0]. logic is the same as the scalar loop in
+//    project_frame_to_panorama()
+static void blend_soa_span(
+      /* in     */ const optical_up_planes_type *src,
+      /* in     */ const uint8_t *cam,
+      /* in     */ const uint32_t src_off,
+      /* in out */       pan_soa_frame_type *world,
+      /* in     */ const uint32_t out_idx,
+      /* in     */ const uint32_t n
+      )
+{
+   const pan_u16x16_type invalid = {
+         0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff,
+         0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff };
+   uint32_t i = 0;
+   for (; i+PAN_SOA_LANES<=n; i+=PAN_SOA_LANES) {
+      const uint32_t s = src_off + i;
+      const uint32_t w = out_idx + i;
+      pan_u16x16_type src_rad, fg_rad, bg_rad;
+      memcpy(&src_rad, &src->radius[s], sizeof src_rad);
+      memcpy(&fg_rad, &world->fg_radius[w], sizeof fg_rad);
+      memcpy(&bg_rad, &world->bg_radius[w], sizeof bg_rad);
+      const pan_s16x16_type valid_w = src_rad != invalid;
+      const pan_s16x16_type fg_w = valid_w & (src_rad < fg_rad);
+      // skip the remaining planes if nothing lands here
+      uint64_t any[4];
+      memcpy(any, &valid_w, sizeof any);
+      if ((any[0] | any[1] | any[2] | any[3]) == 0) {
+         continue;
+      }
+      const pan_u16x16_type new_bg_rad =
+            select_u16(valid_w, select_u16(fg_w, fg_rad, src_rad), bg_rad);
+      const pan_u16x16_type new_fg_rad = select_u16(fg_w, src_rad, fg_rad);
+      memcpy(&world->fg_radius[w], &new_fg_rad, sizeof new_fg_rad);
+      memcpy(&world->bg_radius[w], &new_bg_rad, sizeof new_bg_rad);
+      // narrow masks for the 8-bit planes
+      const pan_s8x16_type valid_n = __builtin_convertvector(valid_w,
+            pan_s8x16_type);
+      const pan_s8x16_type fg_n = __builtin_convertvector(fg_w, pan_s8x16_type);
+      blend_u8_planes(valid_n, fg_n, &src->channel[Y_CHAN_IDX][s],
+            &world->fg_y[w], &world->bg_y[w]);
+      blend_u8_planes(valid_n, fg_n, &src->channel[V_CHAN_IDX][s],
+            &world->fg_v[w], &world->bg_v[w]);
+      blend_u8_planes(valid_n, fg_n, &src->border[s], &world->fg_border[w],
+            &world->bg_border[w]);
+      blend_u8_planes(valid_n, fg_n, &cam[i], &world->fg_cam[w],
+            &world->bg_cam[w]);
+   }
+   // tail
+   for (; i<n; i++) {
+      const uint32_t s = src_off + i;
+      const uint32_t w = out_idx + i;
+      const uint16_t rad = src->radius[s];
+      if (rad == 0xffff) {
+         continue;
+      }
+      if (rad < world->fg_radius[w]) {
+         world->bg_radius[w] = world->fg_radius[w];
+         world->bg_y[w] = world->fg_y[w];
+         world->bg_v[w] = world->fg_v[w];
+         world->bg_border[w] = world->fg_border[w];
+         world->bg_cam[w] = world->fg_cam[w];
+         world->fg_radius[w] = rad;
+         world->fg_y[w] = src->channel[Y_CHAN_IDX][s];
+         world->fg_v[w] = src->channel[V_CHAN_IDX][s];
+         world->fg_border[w] = src->border[s];
+         world->fg_cam[w] = cam[i];
+      } else {
+         world->bg_radius[w] = rad;
+         world->bg_y[w] = src->channel[Y_CHAN_IDX][s];
+         world->bg_v[w] = src->channel[V_CHAN_IDX][s];
+         world->bg_border[w] = src->border[s];
+         world->bg_cam[w] = cam[i];
+      }
+   }
+}
+
+
+// plane-based equivalent of project_frame_to_panorama(). source pixels
+//    are read from 'planes', which is the planar copy of the frame's
+//    pyramid level. output is written to 'world' instead of
+//    output->world_frame. coverage is updated as well
+static void project_frame_to_panorama_soa(
+      /* in     */ const optical_up_output_type *frame,
+      /* in     */ const optical_up_planes_type *planes,
+      /* in     */ const image_size_type in_sz,
+      /* in out */       panorama_output_type *output,
+      /* in out */       pan_soa_frame_type *world,
+      /* in     */ const image_size_type out_sz,
+      /* in     */ const uint32_t level
+      )
+{
+   ////////////////////////////////////
+   // point of projection in world view. see project_frame_to_panorama()
+   const double ppd = PIX_PER_DEG[level];
+   double lon_deg = (double) frame->world_center.lon.angle32 * BAM32_TO_DEG;
+   int32_t center_x = (int32_t) (ppd * lon_deg);
+   if (center_x < 0)
+      center_x += out_sz.width;
+   else if (center_x >= out_sz.width)
+      center_x -= out_sz.width;
+   double lat_deg = (double) frame->world_center.lat.sangle32 * BAM32_TO_DEG;
+   const int32_t center_y = (int32_t) (ppd *
+         (WORLD_HEIGHT_ABOVE_HORIZ_DEGS + lat_deg));
+   uint32_t origin_x = (uint32_t) (center_x - in_sz.cols/2);
+   if (origin_x >= WORLD_WIDTH_PIX[level]) {
+      origin_x += WORLD_WIDTH_PIX[level];
+   }
+   // scalar loop resets column to zero when it runs off the right edge,
+   //    which for an out-of-range origin means starting at zero
+   if (origin_x >= out_sz.cols) {
+      origin_x = 0;
+   }
+   const uint32_t origin_y = (uint32_t) (center_y - in_sz.rows/2);
+   /////////
+   mark_coverage(frame, output);
+   ///////////////////////////////////////////////////////////////////
+   const uint32_t cols = in_sz.cols;
+   uint8_t cam[cols];
+   memset(cam, planes->cam_num, cols);
+   // source row may wrap around 360 degrees, in which case it's
+   //    written as two spans
+   uint32_t span_0 = out_sz.cols - origin_x;
+   if (span_0 > cols) {
+      span_0 = cols;
+   }
+   const uint32_t span_1 = cols - span_0;
+   uint32_t in_r, out_r;
+   for (in_r=0, out_r=origin_y; in_r<in_sz.rows; in_r++, out_r++) {
+      if (out_r >= out_sz.rows)
+         continue;   // out_r is unsigned so this check covers <0 also
+      const uint32_t in_row_offset = in_r * cols;
+      const uint32_t out_row_offset = out_r * out_sz.cols;
+      blend_soa_span(planes, cam, in_row_offset, world,
+            out_row_offset + origin_x, span_0);
+      if (span_1 > 0) {
+         blend_soa_span(planes, cam, in_row_offset + span_0, world,
+               out_row_offset, span_1);
+      }
+   }
+}
+
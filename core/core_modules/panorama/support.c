@@ -38,6 +38,53 @@ static void clear_world_buffer(
    }
 }
 
+// returns world pixel idx at pyramid level, regardless of layout
+static inline overlap_pixel_type get_world_pixel(
+      /* in     */ const panorama_output_type *output,
+      /* in     */ const uint32_t level,
+      /* in     */ const uint32_t idx
+      )
+{
+#if PAN_SOA_LAYOUT == 1
+   return pan_soa_get_pixel(&output->soa[level], idx);
+#else
+   return output->world_frame[level][idx];
+#endif   // PAN_SOA_LAYOUT
+}
+
+
+// converts world pixel to output color. foreground pix in red. bg pixel
+//    in green or blue depending on cam num (output_type 1), or gray
+//    (output_type 0)
+static inline void world_pixel_to_rgb(
+      /* in     */ const panorama_class_type *pan,
+      /* in     */ const overlap_pixel_type *element,
+      /*    out */       uint8_t *r,
+      /*    out */       uint8_t *g,
+      /*    out */       uint8_t *b
+      )
+{
+   *r = 0;
+   *g = 0;
+   *b = 0;
+   if (element->fg.radius != 0xffff) {
+      *r = element->fg.color.y;
+      if (pan->output_type == 0) {
+         *g = element->fg.color.y;
+         *b = element->fg.color.y;
+      } else {
+         if (element->bg.radius != 0xffff) {
+            if (element->fg.cam_num > element->bg.cam_num) {
+               *g = element->bg.color.y;
+            } else if (element->bg.cam_num < 255) {
+               *b = element->bg.color.y;
+            }
+         }
+      }
+   }
+}
+
+
 // saves 'color' panorama. foreground pix in red. bg pixel in green or
 //    blue depending on cam num
 static void write_panorama_image(
@@ -63,26 +110,13 @@ static void write_panorama_image(
    }
    log_info(pan->log, "Writing %s", path);
    fprintf(fp, "P6\n%d %d\n255\n", sz.cols, sz.rows);
-   overlap_pixel_type *elements = output->world_frame[level];
+   uint32_t idx = 0;
    for (uint32_t y=0; y<sz.rows; y++) {
-      memset(line, 0, N_BYTES);
       for (uint32_t x=0; x<N_BYTES; x+=3) {
-         if (elements->fg.radius != 0xffff) {
-            line[x] = elements->fg.color.y;
-            if (pan->output_type == 0) {
-               line[x+1] = elements->fg.color.y;
-               line[x+2] = elements->fg.color.y;
-            } else {
-               if (elements->bg.radius != 0xffff) {
-                  if (elements->fg.cam_num > elements->bg.cam_num) {
-                     line[x+1] = elements->bg.color.y;
-                  } else if (elements->bg.cam_num < 255) {
-                     line[x+2] = elements->bg.color.y;
-                  }
-               }
-            }
-         }
-         elements++;
+         const overlap_pixel_type element =
+               get_world_pixel(output, level, idx++);
+         world_pixel_to_rgb(pan, &element, &line[x], &line[x+1],
+               &line[x+2]);
       }
       fwrite(line, N_BYTES, 1, fp);
    }
@@ -92,6 +126,41 @@ end:
 }
 
 
+// appends panorama at pyramid level 0 to indexed log
+static void write_panorama_log(
+      /* in out */       panorama_class_type *pan,
+      /* in     */ const panorama_output_type *output,
+      /* in     */ const double t
+      )
+{
+   const uint32_t n_pix = WORLD_WIDTH_PIX[0] * WORLD_HEIGHT_PIX[0];
+   uint8_t *r = pan->log_planes;
+   uint8_t *g = &pan->log_planes[n_pix];
+   uint8_t *b = &pan->log_planes[2 * n_pix];
+   if (pan->output_type == 0) {
+      // gray output. r, g and b are the same, so only build one plane
+      //    and let the log store the others as references to it
+      for (uint32_t i=0; i<n_pix; i++) {
+         const overlap_pixel_type element = get_world_pixel(output, 0, i);
+         r[i] = (element.fg.radius != 0xffff) ? element.fg.color.y : 0;
+      }
+      g = r;
+      b = r;
+   } else {
+      for (uint32_t i=0; i<n_pix; i++) {
+         const overlap_pixel_type element = get_world_pixel(output, 0, i);
+         world_pixel_to_rgb(pan, &element, &r[i], &g[i], &b[i]);
+      }
+   }
+   if (pan_log_write_frame(pan->pan_log, t, r, g, b) != 0) {
+      log_err(pan->log, "Error writing frame %.3f to panorama log. "
+            "Logging disabled", t);
+      pan_log_close_writer(pan->pan_log);
+      pan->pan_log = NULL;
+   }
+}
+
+
 // flag written-to areas in panorama coverage record
 static void mark_coverage(
       /* in     */ const optical_up_output_type *frame,
@@ -0,0 +1,378 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "pinet.h"
+#include "timekeeper.h"
+#include "core_modules/panorama.h"
+#include "core_modules/support/frame_heap.h"
+
+// pushes synthetic panoramas with partial coverage through the color
+//    grid and compares the published distributions to those from a
+//    direct implementation (decay every unit, re-bin, sum each unit's
+//    neighborhood), with every grid row binned each frame. then checks
+//    that with the per-frame row cap a static scene converges to the
+//    same distributions, that the grid is cleared after input stops,
+//    and reports per-frame cost
+
+#include "../layout.c"
+
+#define TEST_PPD           10.0
+#define NUM_TEST_FRAMES    20
+#define BENCH_ITERATIONS   20
+
+// allowed difference in normalized bin value
+#define MAX_BIN_ERR        1.0e-4
+
+
+// grid updated the direct way
+static pan_color_grid_unit_type *ref_master_ = NULL;
+static pan_color_grid_unit_type *ref_out_ = NULL;
+
+
+// fills panorama with pseudo-random colors. a band of columns that
+//    moves with frame number has no content
+static void fill_panorama(
+      /* in out */       panorama_output_type *out,
+      /* in     */ const uint32_t frame_num
+      )
+{
+   uint32_t seed = 17 + frame_num;
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      const image_size_type size = out->frame_size[lev];
+      const uint32_t gap_start = (frame_num * 97u) % size.x;
+      const uint32_t gap_width = size.x / 5;
+      for (uint32_t y=0; y<size.y; y++) {
+         for (uint32_t x=0; x<size.x; x++) {
+            pixel_cam_info_type *pix = &out->world_frame[lev][x + y*size.x].fg;
+            seed = seed * 1103515245u + 12345u;
+            // colors are clustered by region so distributions differ
+            pix->color.y = (uint8_t) ((x / 64) * 8 + ((seed >> 16) & 31));
+            pix->color.v = (uint8_t) (112 + ((seed >> 24) & 31));
+            const uint32_t dx = (x + size.x - gap_start) % size.x;
+            pix->border = (dx < gap_width) ? 255 : 0;
+         }
+      }
+   }
+}
+
+
+static void ref_sum(
+      /* in     */ const pan_color_grid_type *grid,
+      /* in     */ const pan_color_grid_unit_type *master
+      );
+
+
+static void ref_push(
+      /* in     */ const pan_color_grid_type *grid,
+      /* in     */ const panorama_output_type *out
+      )
+{
+   const image_size_type size = grid->size;
+   const uint32_t n_units = (uint32_t) (size.x * size.y);
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      const double dpp = DEG_PER_PIX[lev];
+      for (uint32_t i=0; i<n_units; i++) {
+         pan_color_grid_unit_type *unit = &ref_master_[i];
+         for (uint32_t j=0; j<COLOR_GRID_DIST_SIZE; j++) {
+            unit->color_y[lev][j] *= (float) (1.0 - COLOR_GRID_TAU);
+            unit->color_v[lev][j] *= (float) (1.0 - COLOR_GRID_TAU);
+         }
+         unit->num_samples[lev] *= (float) (1.0 - COLOR_GRID_TAU);
+      }
+      const image_size_type world_size = out->frame_size[lev];
+      for (uint32_t y=0; y<world_size.y; y++) {
+         const uint32_t row = (uint32_t) (dpp *
+               (double) (y + grid->top_buffer[lev]) /
+               (double) COLOR_GRID_UNIT_HEIGHT_DEG);
+         if (row >= size.rows) {
+            break;
+         }
+         for (uint32_t x=0; x<world_size.x; x++) {
+            const pixel_cam_info_type *pix =
+                  &out->world_frame[lev][x + y*world_size.x].fg;
+            if (pix->border != 0) {
+               continue;
+            }
+            uint32_t col = (uint32_t) ((double) x * dpp /
+                  (double) COLOR_GRID_UNIT_WIDTH_DEG);
+            if (col >= size.cols) {
+               col = (uint32_t) (size.cols - 1);
+            }
+            pan_color_grid_unit_type *unit = &ref_master_[col + row*size.cols];
+            unit->color_y[lev][pix->color.y / COLOR_GRID_BIN_WIDTH] += 1.0f;
+            unit->color_v[lev][pix->color.v / COLOR_GRID_BIN_WIDTH] += 1.0f;
+            unit->num_samples[lev] += 1.0f;
+         }
+      }
+   }
+   ref_sum(grid, ref_master_);
+}
+
+
+// sums each unit's neighborhood in master to ref_out_
+static void ref_sum(
+      /* in     */ const pan_color_grid_type *grid,
+      /* in     */ const pan_color_grid_unit_type *master
+      )
+{
+   const image_size_type size = grid->size;
+   const uint32_t n_units = (uint32_t) (size.x * size.y);
+   memset(ref_out_, 0, n_units * sizeof *ref_out_);
+   for (uint32_t r=0; r<size.rows; r++) {
+      for (uint32_t c=0; c<size.cols; c++) {
+         pan_color_grid_unit_type *unit = &ref_out_[c + r*size.cols];
+         for (int32_t dr=-1; dr<=1; dr++) {
+            const int32_t nr = (int32_t) r + dr;
+            if ((nr < 0) || (nr >= size.rows)) {
+               continue;
+            }
+            for (int32_t dc=-1; dc<=1; dc++) {
+               const uint32_t nc =
+                     (uint32_t) ((int32_t) c + dc + size.cols) % size.cols;
+               const pan_color_grid_unit_type *src =
+                     &master[nc + (uint32_t) nr * size.cols];
+               for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+                  for (uint32_t j=0; j<COLOR_GRID_DIST_SIZE; j++) {
+                     unit->color_y[lev][j] += src->color_y[lev][j];
+                     unit->color_v[lev][j] += src->color_v[lev][j];
+                  }
+                  unit->num_samples[lev] += src->num_samples[lev];
+               }
+            }
+         }
+      }
+   }
+}
+
+
+// compares distributions, normalized by sample count
+static uint32_t compare_units(
+      /* in     */ const pan_color_grid_unit_type *units,
+      /* in     */ const pan_color_grid_unit_type *ref_units,
+      /* in     */ const uint32_t n_units
+      )
+{
+   uint32_t errs = 0;
+   for (uint32_t i=0; i<n_units; i++) {
+      const pan_color_grid_unit_type *a = &units[i];
+      const pan_color_grid_unit_type *b = &ref_units[i];
+      for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+         if ((a->num_samples[lev] == 0.0f) || (b->num_samples[lev] == 0.0f)) {
+            if (a->num_samples[lev] != b->num_samples[lev]) {
+               errs++;
+            }
+            continue;
+         }
+         for (uint32_t j=0; j<COLOR_GRID_DIST_SIZE; j++) {
+            const double ay = a->color_y[lev][j] / a->num_samples[lev];
+            const double by = b->color_y[lev][j] / b->num_samples[lev];
+            const double av = a->color_v[lev][j] / a->num_samples[lev];
+            const double bv = b->color_v[lev][j] / b->num_samples[lev];
+            if ((fabs(ay - by) > MAX_BIN_ERR) ||
+                  (fabs(av - bv) > MAX_BIN_ERR)) {
+               if (errs < 10) {
+                  printf("    Unit %d level %d bin %d differs. "
+                        "y %.6f,%.6f  v %.6f,%.6f\n", i, lev, j,
+                        ay, by, av, bv);
+               }
+               errs++;
+            }
+         }
+      }
+   }
+   return errs;
+}
+
+
+// compares grid to reference output
+static uint32_t compare_grids(
+      /* in     */ const pan_color_grid_type *grid
+      )
+{
+   const uint32_t n_units = (uint32_t) (grid->size.x * grid->size.y);
+   return compare_units(grid->grid, ref_out_, n_units);
+}
+
+
+int main(int argc, char** argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_world_height(25.0, 25.0);
+   set_ppd(TEST_PPD);
+   panorama_type *pan = calloc(1, sizeof *pan);
+   // fewer frames are pushed than COLOR_GRID_REPORT_INTERVAL so logger
+   //    isn't needed
+   assert(NUM_TEST_FRAMES + 1 + BENCH_ITERATIONS < COLOR_GRID_REPORT_INTERVAL);
+   init_color_grid(&pan->master_color_grid);
+   init_color_grid_accum(&pan->color_accum, &pan->master_color_grid);
+   pan_color_grid_type out_grid;
+   init_color_grid(&out_grid);
+   const image_size_type grid_size = pan->master_color_grid.size;
+   const uint32_t n_units = (uint32_t) (grid_size.x * grid_size.y);
+   ref_master_ = calloc(n_units, sizeof *ref_master_);
+   ref_out_ = calloc(n_units, sizeof *ref_out_);
+   // panorama
+   uint32_t n_pix = (uint32_t)
+         (3 * WORLD_HEIGHT_PIX[0] * WORLD_WIDTH_PIX[0] / 2);
+   panorama_output_type *out = calloc(1, sizeof *out);
+   out->pyramid_ = calloc(n_pix, sizeof *out->pyramid_);
+   out->world_frame[0] = out->pyramid_;
+   out->world_frame[1] = &out->pyramid_[WORLD_WIDTH_PIX[0] *
+         WORLD_HEIGHT_PIX[0]];
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      out->frame_size[lev].width = (uint16_t) WORLD_WIDTH_PIX[lev];
+      out->frame_size[lev].height = (uint16_t) WORLD_HEIGHT_PIX[lev];
+   }
+   out->color_grid = &out_grid;
+   frame_page_type page = { .frame = out };
+   ////////////////////////////////////////////////////////////
+   printf("Comparing incremental and direct color grid (%dx%d units)\n",
+         grid_size.cols, grid_size.rows);
+   pan->color_accum.max_rows_per_frame = grid_size.rows;
+   for (uint32_t i=0; i<NUM_TEST_FRAMES; i++) {
+      fill_panorama(out, i);
+      push_to_color_grid(pan, &page);
+      ref_push(&pan->master_color_grid, out);
+      uint32_t mismatch = compare_grids(&out_grid);
+      if (mismatch > 0) {
+         printf("  Frame %d: %d bins differ\n", i, mismatch);
+         errs++;
+         break;
+      }
+   }
+   ////////////////////////////////////////////////////////////
+   printf("Checking rescale of stored values\n");
+   // move weight to just under limit, scaling stored values to match
+   const float jump = COLOR_GRID_RENORM_WEIGHT * 0.999999f /
+         pan->color_accum.weight;
+   rescale_color_grid(pan, jump);
+   fill_panorama(out, NUM_TEST_FRAMES);
+   push_to_color_grid(pan, &page);
+   ref_push(&pan->master_color_grid, out);
+   if (pan->color_accum.weight > 2.0f) {
+      printf("  Weight not reset after reaching limit (%.1f)\n",
+            (double) pan->color_accum.weight);
+      errs++;
+   }
+   uint32_t mismatch = compare_grids(&out_grid);
+   if (mismatch > 0) {
+      printf("  %d bins differ after rescale\n", mismatch);
+      errs++;
+   }
+   ////////////////////////////////////////////////////////////
+   // from here on the grid is updated with the default row cap
+   printf("Checking capped update of static scene (%d rows/frame)\n",
+         COLOR_GRID_MAX_ROWS_PER_FRAME);
+   panorama_type *capped = calloc(1, sizeof *capped);
+   init_color_grid(&capped->master_color_grid);
+   init_color_grid_accum(&capped->color_accum, &capped->master_color_grid);
+   pan_color_grid_type capped_grid;
+   init_color_grid(&capped_grid);
+   out->color_grid = &capped_grid;
+   memset(ref_master_, 0, n_units * sizeof *ref_master_);
+   fill_panorama(out, 0);
+   const uint32_t cycle = (uint32_t) (grid_size.rows +
+         COLOR_GRID_MAX_ROWS_PER_FRAME - 1) / COLOR_GRID_MAX_ROWS_PER_FRAME;
+   for (uint32_t i=0; i<cycle; i++) {
+      push_to_color_grid(capped, &page);
+      ref_push(&capped->master_color_grid, out);
+   }
+   // rows are binned on different frames so neighborhoods mix units with
+   //    different total weight, and only master units are expected to
+   //    match the direct version. published sums should be current with
+   //    master
+   mismatch = compare_units(capped->master_color_grid.grid, ref_master_,
+         n_units);
+   if (mismatch > 0) {
+      printf("  %d master bins differ after %d frames\n", mismatch, cycle);
+      errs++;
+   }
+   ref_sum(&capped->master_color_grid, capped->master_color_grid.grid);
+   mismatch = compare_grids(&capped_grid);
+   if (mismatch > 0) {
+      printf("  %d published bins differ from master\n", mismatch);
+      errs++;
+   }
+   ////////////////////////////////////////////////////////////
+   printf("Checking grid is cleared when input stops\n");
+   for (uint32_t i=0; i<COLOR_GRID_STALE_FRAMES-1; i++) {
+      age_color_grid(capped);
+   }
+   if (capped->master_color_grid.grid[n_units/2].num_samples[0] == 0.0f) {
+      printf("  Grid cleared before %d empty frames\n",
+            COLOR_GRID_STALE_FRAMES);
+      errs++;
+   }
+   age_color_grid(capped);
+   push_to_color_grid(capped, &page);
+   // only the rows binned in this frame, and their neighbors, have
+   //    content
+   uint32_t with_content = 0;
+   for (uint32_t i=0; i<n_units; i++) {
+      if (capped_grid.grid[i].num_samples[0] > 0.0f) {
+         with_content++;
+      }
+   }
+   if ((with_content == 0) || (with_content >
+         (COLOR_GRID_MAX_ROWS_PER_FRAME + 2u) * grid_size.cols)) {
+      printf("  %d units have content after clearing\n", with_content);
+      errs++;
+   }
+   ////////////////////////////////////////////////////////////
+   printf("Timing %d iterations on %dx%d panorama\n", BENCH_ITERATIONS,
+         WORLD_WIDTH_PIX[0], WORLD_HEIGHT_PIX[0]);
+   capped->color_accum.max_update_sec = 0.0;
+   double inc_sec = 0.0;
+   double ref_sec = 0.0;
+   for (uint32_t i=0; i<BENCH_ITERATIONS; i++) {
+      fill_panorama(out, i);
+      double t0 = system_now();
+      push_to_color_grid(capped, &page);
+      double t1 = system_now();
+      ref_push(&capped->master_color_grid, out);
+      double t2 = system_now();
+      inc_sec += t1 - t0;
+      ref_sec += t2 - t1;
+   }
+   inc_sec /= BENCH_ITERATIONS;
+   ref_sec /= BENCH_ITERATIONS;
+   printf("  direct       %8.3f ms/frame\n", 1000.0 * ref_sec);
+   printf("  incremental  %8.3f ms/frame (max %.3f ms)\n", 1000.0 * inc_sec,
+         1000.0 * capped->color_accum.max_update_sec);
+   printf("  speedup %.2fx\n", ref_sec / inc_sec);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
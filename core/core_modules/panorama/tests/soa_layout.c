@@ -0,0 +1,231 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timekeeper.h"
+
+#include "pinet.h"
+#include "core_modules/panorama.h"
+#include "core_modules/optical_up.h"
+
+// projects a set of synthetic camera frames into the panorama using
+//    both the interleaved and plane layouts, verifies that the outputs
+//    are identical and reports per-frame projection time and the
+//    effective bandwidth of each. plane layout reads source pixels
+//    from the planar copy optical_up publishes with OPTICAL_UP_PLANES.
+//    that copy is built here outside of the timed loop, as in optical_up
+//    it's written by the blur
+
+#include "../support.c"
+#include "../soa_layout.c"
+
+#define NUM_TEST_CAMS      6
+#define TEST_PPD           10.0
+#define TEST_IMG_COLS      640
+#define TEST_IMG_ROWS      480
+#define BENCH_ITERATIONS   20
+
+static optical_up_output_type frames_[NUM_TEST_CAMS];
+static optical_up_planes_type planes_[NUM_TEST_CAMS];
+
+
+// builds camera frames spaced evenly around the horizon so that each
+//    overlaps its neighbors. radius increases from image center and
+//    the outer ring of pixels is invalid
+static void create_frames(void)
+{
+   const uint32_t n_pix = TEST_IMG_COLS * TEST_IMG_ROWS;
+   uint32_t seed = 1;
+   for (uint32_t cam=0; cam<NUM_TEST_CAMS; cam++) {
+      optical_up_output_type *frame = &frames_[cam];
+      memset(frame, 0, sizeof *frame);
+      frame->pyramid_ = malloc(n_pix * sizeof *frame->pyramid_);
+      frame->size[0].cols = TEST_IMG_COLS;
+      frame->size[0].rows = TEST_IMG_ROWS;
+      frame->frame[0] = frame->pyramid_;
+      // longitude, including one that straddles 0 degrees. tilt each
+      //    camera a bit so rows don't align
+      const double lon = -20.0 + 360.0 * (double) cam / NUM_TEST_CAMS;
+      frame->world_center.lon.angle32 =
+            (uint32_t) (int32_t) (lon * DEG_TO_BAM32_);
+      frame->world_center.lat.sangle32 =
+            (int32_t) (((double) cam - 2.5) * DEG_TO_BAM32_);
+      for (uint32_t r=0; r<TEST_IMG_ROWS; r++) {
+         for (uint32_t c=0; c<TEST_IMG_COLS; c++) {
+            pixel_cam_info_type *pix = &frame->frame[0][c + r*TEST_IMG_COLS];
+            seed = seed * 1103515245u + 12345u;
+            pix->color.y = (uint8_t) (seed >> 16);
+            pix->color.v = (uint8_t) (seed >> 24);
+            pix->cam_num = (uint8_t) cam;
+            pix->border = (uint8_t) ((seed >> 8) & 1);
+            const int32_t dx = (int32_t) c - TEST_IMG_COLS/2;
+            const int32_t dy = (int32_t) r - TEST_IMG_ROWS/2;
+            if ((r < 2) || (c < 2) || (r >= TEST_IMG_ROWS-2) ||
+                  (c >= TEST_IMG_COLS-2)) {
+               pix->radius = 0xffff;
+            } else {
+               pix->radius = (uint16_t) ((dx*dx + dy*dy) >> 4);
+            }
+         }
+      }
+      // planar copy
+      optical_up_planes_type *planes = &planes_[cam];
+      planes->radius = malloc(n_pix * sizeof *planes->radius);
+      planes->border = malloc(n_pix);
+      for (uint32_t i=0; i<NUM_IMAGE_CHANNELS; i++) {
+         planes->channel[i] = malloc(n_pix);
+      }
+      planes->cam_num = (uint8_t) cam;
+      for (uint32_t i=0; i<n_pix; i++) {
+         const pixel_cam_info_type *pix = &frame->frame[0][i];
+         planes->radius[i] = pix->radius;
+         planes->border[i] = pix->border;
+         planes->channel[V_CHAN_IDX][i] = pix->color.v;
+         planes->channel[Y_CHAN_IDX][i] = pix->color.y;
+      }
+   }
+}
+
+
+static uint32_t compare_layouts(
+      /* in     */ const overlap_pixel_type *aos,
+      /* in     */ const pan_soa_frame_type *soa,
+      /* in     */ const uint32_t n_pix
+      )
+{
+   uint32_t errs = 0;
+   for (uint32_t i=0; i<n_pix; i++) {
+      const overlap_pixel_type pix = pan_soa_get_pixel(soa, i);
+      if (memcmp(&pix, &aos[i], sizeof pix) != 0) {
+         if (errs < 10) {
+            printf("    Pixel %d mismatch. fg %d,%d (%d,%d) bg %d,%d "
+                  "(%d,%d)\n", i, pix.fg.radius, pix.fg.cam_num,
+                  aos[i].fg.radius, aos[i].fg.cam_num,
+                  pix.bg.radius, pix.bg.cam_num,
+                  aos[i].bg.radius, aos[i].bg.cam_num);
+         }
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+int main(int argc, char** argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_world_height(30.0, 30.0);
+   set_ppd(TEST_PPD);
+   create_frames();
+   const image_size_type out_sz = {
+         .width = (uint16_t) WORLD_WIDTH_PIX[0],
+         .height = (uint16_t) WORLD_HEIGHT_PIX[0]
+   };
+   const uint32_t n_pix = (uint32_t) (3 * WORLD_HEIGHT_PIX[0] *
+         WORLD_WIDTH_PIX[0] / 2);
+   const uint32_t n_world = out_sz.width * out_sz.height;
+   panorama_output_type *out = calloc(1, sizeof *out);
+   out->pyramid_ = malloc(n_pix * sizeof *out->pyramid_);
+   out->world_frame[0] = out->pyramid_;
+   pan_soa_frame_type soa;
+   uint8_t *heap = malloc(n_world * PAN_SOA_BYTES_PER_PIX);
+   assign_soa_planes(&soa, heap, n_world);
+   ////////////////////////////////////////////////////////////
+   printf("Comparing interleaved and plane layouts\n");
+   clear_world_buffer(out);
+   clear_soa_frame(&soa, n_world);
+   for (uint32_t cam=0; cam<NUM_TEST_CAMS; cam++) {
+      project_frame_to_panorama(&frames_[cam], frames_[cam].size[0], out,
+            out_sz, 0);
+      project_frame_to_panorama_soa(&frames_[cam], &planes_[cam],
+            frames_[cam].size[0], out, &soa, out_sz, 0);
+   }
+   uint32_t mismatch = compare_layouts(out->world_frame[0], &soa, n_world);
+   if (mismatch > 0) {
+      printf("  %d pixels differ between layouts\n", mismatch);
+      errs++;
+   }
+   ////////////////////////////////////////////////////////////
+   // timing. buffer clear is reported separately as it's the same
+   //    number of bytes for both layouts
+   printf("Timing %d iterations of %d %dx%d frames into %dx%d world\n",
+         BENCH_ITERATIONS, NUM_TEST_CAMS, TEST_IMG_COLS, TEST_IMG_ROWS,
+         out_sz.width, out_sz.height);
+   double aos_clear = 0.0;
+   double aos_sec = 0.0;
+   for (uint32_t i=0; i<BENCH_ITERATIONS; i++) {
+      double t0 = system_now();
+      clear_world_buffer(out);
+      double t1 = system_now();
+      for (uint32_t cam=0; cam<NUM_TEST_CAMS; cam++) {
+         project_frame_to_panorama(&frames_[cam], frames_[cam].size[0], out,
+               out_sz, 0);
+      }
+      aos_clear += t1 - t0;
+      aos_sec += system_now() - t1;
+   }
+   double soa_clear = 0.0;
+   double soa_sec = 0.0;
+   for (uint32_t i=0; i<BENCH_ITERATIONS; i++) {
+      double t0 = system_now();
+      clear_soa_frame(&soa, n_world);
+      double t1 = system_now();
+      for (uint32_t cam=0; cam<NUM_TEST_CAMS; cam++) {
+         project_frame_to_panorama_soa(&frames_[cam], &planes_[cam],
+               frames_[cam].size[0], out, &soa, out_sz, 0);
+      }
+      soa_clear += t1 - t0;
+      soa_sec += system_now() - t1;
+   }
+   aos_clear /= BENCH_ITERATIONS;
+   aos_sec /= BENCH_ITERATIONS;
+   soa_clear /= BENCH_ITERATIONS;
+   soa_sec /= BENCH_ITERATIONS;
+   // bytes moved per frame by projection: reading the source plus a
+   //    read and write of the world pixel for each source pixel
+   const double src_pix =
+         (double) (NUM_TEST_CAMS * TEST_IMG_COLS * TEST_IMG_ROWS);
+   const double proj_bytes = src_pix * (double)
+         (sizeof(pixel_cam_info_type) + 2 * sizeof(overlap_pixel_type));
+   printf("                clear (ms)  project (ms)  project GB/s  "
+         "total (ms)\n");
+   printf("  interleaved  %10.3f  %12.3f  %12.2f  %10.3f\n",
+         1000.0 * aos_clear, 1000.0 * aos_sec,
+         1.0e-9 * proj_bytes / aos_sec, 1000.0 * (aos_clear + aos_sec));
+   printf("  planes       %10.3f  %12.3f  %12.2f  %10.3f\n",
+         1000.0 * soa_clear, 1000.0 * soa_sec,
+         1.0e-9 * proj_bytes / soa_sec, 1000.0 * (soa_clear + soa_sec));
+   printf("  per-frame speedup %.2fx (projection only %.2fx)\n",
+         (aos_clear + aos_sec) / (soa_clear + soa_sec), aos_sec / soa_sec);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
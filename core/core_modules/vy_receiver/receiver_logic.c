@@ -15,11 +15,13 @@
 * along with kharon.  If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
 #include "pinet.h"
+#include "pinet_reactor.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -35,6 +37,52 @@
 
 #include "core_modules/vy_receiver.h"
 
+// creates UDP receiver if endpoint file <name>_udp exists. returns -1
+//    on error and 0 otherwise, including when UDP isn't used
+static int32_t init_udp_receiver(
+      /* in out */      struct datap_desc *dp
+      )
+{
+   struct vy_class *vy = (struct vy_class*) dp->local;
+   char name[STR_LEN];
+   char path[STR_LEN];
+   snprintf(name, STR_LEN, "%s_udp", dp->td->obj_name);
+   build_path_string2(NULL, NULL, "endpoints", name, NULL, path, STR_LEN);
+   if (access(path, F_OK) != 0) {
+      return 0;
+   }
+   char buf[STR_LEN];
+   FILE *fp = open_config_file_ro2(NULL, NULL, "endpoints", name, NULL);
+   if (!fp) {
+      log_err(vy->log, "Unable to open UDP endpoint file for '%s'",
+            dp->td->obj_name);
+      return -1;
+   }
+   int32_t rc = config_read_string(fp, buf, STR_LEN);
+   fclose(fp);
+   if (rc != 0) {
+      log_err(vy->log, "Unable to read UDP endpoint for '%s'",
+            dp->td->obj_name);
+      return -1;
+   }
+   const char *port_str = strtok(buf, " \t");
+   const char *group = strtok(NULL, " \t");
+   uint32_t port = port_str ? (uint32_t) atoi(port_str) : 0;
+   if ((port == 0) || (port > 0x00007fff)) {
+      log_err(vy->log, "Bad UDP port for '%s'", dp->td->obj_name);
+      return -1;
+   }
+   vy->udp = create_vy_udp_receiver((uint16_t) port, group,
+         VY_UDP_DEADLINE_SEC);
+   if (vy->udp == NULL) {
+      log_err(vy->log, "Failed to initialize UDP receiver for %s",
+            dp->td->obj_name);
+      return -1;
+   }
+   log_info(vy->log, "%s receiving frames over UDP", dp->td->obj_name);
+   return 0;
+}
+
 static void wait_next_connection(
       /* in out */      struct datap_desc *dp
       )
@@ -137,7 +185,9 @@ err:
 //      struct datap_desc *uvy_dp, int32_t idx)
 static int32_t log_to_pgm_file(
       /* in     */ const struct datap_desc *dp,
-      /* in     */ const uint32_t idx
+      /* in     */ const uint32_t idx,
+      /* in     */ const uint8_t *v_chan,
+      /* in     */ const uint8_t *y_chan
       )
 {
    int32_t rc = -1;
@@ -149,7 +199,7 @@ static int32_t log_to_pgm_file(
    struct vy_class *vy = (struct vy_class*) dp->local;
    char path[STR_LEN];
    snprintf(path, STR_LEN, "%s/%.3f.pgm", vy->data_folder, t);
-   if (write_pgm_file(vy->raw_v, vy->raw_y, path,
+   if (write_pgm_file(v_chan, y_chan, path,
             CAM_ROWS, CAM_COLS) != 0) {
       fprintf(stderr, "Error writing VY output %s\n", path);
       goto err;
@@ -159,8 +209,197 @@ err:
    return rc;
 }
 
-static void pull_data(
-      /* in out */      struct datap_desc *dp
+// logs network i/o per frame. reported every VY_IO_REPORT_SEC, or
+//    at end of connection when 'final' is set
+static void report_io(
+      /* in out */       vy_class_type *vy,
+      /* in     */ const char *name,
+      /* in     */ const uint32_t final
+      )
+{
+   const double t = now();
+   if ((vy->io_frames == 0) ||
+         ((final == 0) && (t - vy->io_report_sec < VY_IO_REPORT_SEC))) {
+      return;
+   }
+   const double frames = (double) vy->io_frames;
+   if (vy->conn != NULL) {
+      // socket is read by network reactor, which reports reads/packet
+      pthread_mutex_lock(&vy->frame_mutex);
+      const uint32_t dropped = vy->frames_dropped;
+      vy->frames_dropped = 0;
+      pthread_mutex_unlock(&vy->frame_mutex);
+      log_info(vy->log, "%s i/o: %d frames, %d dropped, %.1f KB "
+            "received/frame, %.1f KB copied/frame", name, vy->io_frames,
+            dropped, (double) vy->io_bytes / (1024.0 * frames),
+            (double) vy->copy_bytes / (1024.0 * frames));
+   } else {
+      log_info(vy->log, "%s i/o: %d frames, %.2f reads/frame, %.1f KB "
+            "received/frame, %.1f KB copied/frame", name, vy->io_frames,
+            (double) vy->io_calls / frames,
+            (double) vy->io_bytes / (1024.0 * frames),
+            (double) vy->copy_bytes / (1024.0 * frames));
+   }
+   vy->io_calls = 0;
+   vy->io_bytes = 0;
+   vy->copy_bytes = 0;
+   vy->io_frames = 0;
+   vy->io_report_sec = t;
+}
+
+// sets mask of rows on next pyramid level. a downsampled row (row 2r
+//    of this level) is missing only if every row in its blur footprint
+//    was
+static void downsample_row_mask(
+      /* in     */ const uint8_t *row_missing,
+      /* in     */ const uint32_t num_rows,
+      /*    out */       uint8_t *next_missing
+      )
+{
+   for (uint32_t y=0; y<num_rows; y+=2) {
+      uint8_t missing = row_missing[y];
+      if (y > 0) {
+         missing &= row_missing[y-1];
+      }
+      if (y+1 < num_rows) {
+         missing &= row_missing[y+1];
+      }
+      next_missing[y/2] = missing;
+   }
+}
+
+// builds image pyramid from V and Y planes and publishes it. src_v and
+//    src_y can be vy->raw_v and vy->raw_y, which are overwritten.
+//    row_missing flags rows of src planes that were lost in transport,
+//    and is NULL if none were
+static void publish_frame(
+      /* in out */       struct datap_desc *dp,
+      /* in     */ const double frame_request,
+      /* in     */ const double frame_received,
+      /* in     */ const uint8_t *src_v,
+      /* in     */ const uint8_t *src_y,
+      /* in     */ const uint32_t missing_rows,
+      /* in     */ const uint8_t *row_missing
+      )
+{
+   vy_class_type *vy = (vy_class_type *) dp->local;
+   // store timestamp (provided in packet header)
+   uint32_t idx = (uint32_t) (dp->elements_produced % dp->queue_length);
+   vy_receiver_output_type *out = (vy_receiver_output_type*)
+         dp_get_object_at(dp, idx);
+   out->frame_request_time = frame_request;
+   out->missing_rows = missing_rows;
+   if ((missing_rows > 0) && (row_missing != NULL)) {
+      memcpy(out->row_missing[0], row_missing, VY_ROWS);
+   } else {
+      memset(out->row_missing, 0, sizeof out->row_missing);
+   }
+   dp->ts[idx] = frame_received;
+   log_info(vy->log, "Frame request %.4f, received %.4f",
+            frame_request, frame_received);
+   // copy to output, splitting into image pyramid
+   for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
+      image_size_type sz = vy->img_size[lev];
+      uint32_t n_pix = (uint32_t) (sz.x * sz.y);
+      // copy 'raw' data to output
+      const uint32_t offset = out->chan_offset[lev];
+      vy_pixel_type *chan = &out->chans[offset];
+      for (uint32_t i=0; i<n_pix; i++) {
+         vy_pixel_type *pix = &chan[i];
+         // EXPERIMENT
+         // V channel signal gets washed out w/ NIR -- magnify it
+         pix->v = (uint8_t) (128 + 2 * (src_v[i] - 128));
+         //pix->v = src_v[i];
+         pix->y = src_y[i];
+//         // testing -- visualize data change
+//         // alter 'raw' so content output to log
+//         vy->raw_v[i] = pix->v;
+      }
+      // if data logging enabled, write pgm file of (raw) image
+      if ((lev == 0) && (vy->data_folder != NULL)) {
+         log_to_pgm_file(dp, idx, src_v, src_y);
+      }
+      vy->copy_bytes += 2 * n_pix;
+      // blur and downsample to prepare for next round
+      uint32_t src_idx = 0;
+      uint32_t dest_idx = 0;
+      uint8_t *restrict raw_v = vy->raw_v;
+      uint8_t *restrict raw_y = vy->raw_y;
+      unsigned int *restrict img_tmp = vy->img_tmp;
+      if (lev < (NUM_PYRAMID_LEVELS - 1)) {
+         // blur each channel. first level reads from received
+         //    planes, later ones from downsampled raw buffers.
+         //    rows that were lost are left out of their neighbors' blur
+         if (missing_rows > 0) {
+            const uint8_t *skip = out->row_missing[lev];
+            blur_image_r1_skip_rows(src_v, img_tmp, raw_v, sz, skip);
+            blur_image_r1_skip_rows(src_y, img_tmp, raw_y, sz, skip);
+            downsample_row_mask(skip, sz.y, out->row_missing[lev+1]);
+         } else {
+            blur_image_r1(src_v, img_tmp, raw_v, sz);
+            blur_image_r1(src_y, img_tmp, raw_y, sz);
+         }
+         src_v = raw_v;
+         src_y = raw_y;
+         // downsample buffers. work done in-place, as except for first
+         //    copy, src_index > dest_index
+         for (uint32_t y=0; y<sz.y; y+=2) {
+            for (uint32_t x=0; x<sz.x; x+=2) {
+               raw_v[dest_idx] = raw_v[src_idx];
+               raw_y[dest_idx] = raw_y[src_idx];
+               src_idx += 2;
+               dest_idx++;
+            }
+            src_idx += sz.x;
+         }
+      }
+   }
+   //////////////////////////////////
+   // all done. let others know
+   dp->elements_produced++;
+//printf("Posting frame at %.6f. Remote time: %.6f\n", now(), remote_time);
+   log_info(vy->log, "Signaling data available (%ld)",
+         dp->elements_produced);
+   dp_signal_data_available(dp);
+}
+
+// checks that frame header is of a VY packet and of the expected size.
+//    returns 0 if ok, -1 if not
+static int32_t check_frame_header(
+      /* in out */       struct datap_desc *dp,
+      /* in     */       struct sensor_packet_header *header
+      )
+{
+   vy_class_type *vy = (vy_class_type *) dp->local;
+   double frame_request;
+   double frame_received;
+   uint32_t pkt_type;
+   unpack_sensor_header2(header, &pkt_type, &frame_request,
+         &frame_received);
+   if (pkt_type != VY_PACKET_TYPE) {
+      log_err(vy->log, "Packet type error\nExpected 0x%08x, "
+            "received 0x%08x", VY_PACKET_TYPE, pkt_type);
+      return -1;
+   }
+   image_size_type dim;
+   dim.rows = htons((uint16_t) header->custom_16[0]);
+   dim.cols = htons((uint16_t) header->custom_16[1]);
+   if ((dim.rows != CAM_ROWS) || (dim.cols != CAM_COLS)) {
+      log_err(vy->log, "Frame size mismatch in %s", dp->td->obj_name);
+      log_err(vy->log, "Expecting %dx%d, received %d,%d",
+            CAM_COLS, CAM_ROWS, dim.cols, dim.rows);
+      return -1;
+   }
+   return 0;
+}
+
+// publishes frame. header must have passed check_frame_header(). src_v
+//    and src_y are the frame's image planes
+static void handle_frame(
+      /* in out */       struct datap_desc *dp,
+      /* in out */       struct sensor_packet_header *header,
+      /* in     */ const uint8_t *src_v,
+      /* in     */ const uint8_t *src_y
       )
 {
    vy_class_type *vy = (vy_class_type *) dp->local;
@@ -168,135 +407,214 @@ static void pull_data(
    double frame_request;
    double frame_received;
    uint32_t pkt_type;
+   vy->io_bytes += sizeof(*header) + 2 * CAM_N_PIX;
+   log_debug(vy->log, "Unpack packet header");
+   unpack_sensor_header2(header, &pkt_type, &frame_request,
+         &frame_received);
+   // TODO FIXME find out why empty string is not null
+   if (header->log_data[0] != 0) {
+   //if (header->log_data[0] != 0) {
+      header->log_data[SENSOR_PACKET_LOG_DATA-1] = 0;
+      log_info(vy->log, "%s remote log: '%s'", dp->td->obj_name,
+            header->log_data);
+   }
+//printf("receiving frame: %d bytes\n", vy_stream_len);
+   if ((dp->run_state & DP_STATE_PAUSE) != 0) {
+      return;
+   }
+   publish_frame(dp, frame_request, frame_received, src_v, src_y, 0,
+         NULL);
+   vy->io_frames++;
+   report_io(vy, dp->td->obj_name, 0);
+}
+
+// called by network reactor w/ each frame. frame is copied for the
+//    receiver's thread to publish. a bad header is reported to the
+//    reactor, which closes the connection
+static int32_t reactor_frame(
+      /* in out */       void *arg,
+      /* in out */       uint8_t *packet,
+      /* in     */ const double received_sec
+      )
+{
+   (void) received_sec;
+   struct datap_desc *dp = (struct datap_desc*) arg;
+   vy_class_type *vy = (vy_class_type *) dp->local;
+   struct sensor_packet_header header;
+   memcpy(&header, packet, sizeof(header));
+   const int32_t rc = check_frame_header(dp, &header);
+   pthread_mutex_lock(&vy->frame_mutex);
+   if (rc != 0) {
+      vy->frame_error = 1;
+   } else {
+      // if previous frame hasn't been taken yet, newer one replaces it
+      if (vy->frame_pending != 0) {
+         vy->frames_dropped++;
+      }
+      memcpy(vy->pending_frame, packet, VY_PACKET_BYTES);
+      vy->frame_pending = 1;
+      pthread_cond_signal(&vy->frame_cond);
+   }
+   pthread_mutex_unlock(&vy->frame_mutex);
+   return rc;
+}
+
+// waits up to timeout_sec for reactor to deliver a frame. returns 1
+//    when one was moved to vy->frame, 0 on timeout
+static int32_t wait_reactor_frame(
+      /* in out */       vy_class_type *vy,
+      /* in     */ const double timeout_sec
+      )
+{
+   struct timespec deadline;
+   clock_gettime(CLOCK_MONOTONIC, &deadline);
+   const long nsec = deadline.tv_nsec + (long) (timeout_sec * 1.0e9);
+   deadline.tv_sec += nsec / 1000000000l;
+   deadline.tv_nsec = nsec % 1000000000l;
+   int32_t rc = 0;
+   pthread_mutex_lock(&vy->frame_mutex);
+   while (vy->frame_pending == 0) {
+      if (pthread_cond_timedwait(&vy->frame_cond, &vy->frame_mutex,
+            &deadline) == ETIMEDOUT) {
+         break;
+      }
+   }
+   if (vy->frame_pending != 0) {
+      uint8_t *frame = vy->frame;
+      vy->frame = vy->pending_frame;
+      vy->pending_frame = frame;
+      vy->frame_pending = 0;
+      rc = 1;
+   }
+   pthread_mutex_unlock(&vy->frame_mutex);
+   return rc;
+}
+
+// publishes frames delivered by network reactor until done or
+//    connection closes
+static void pull_reactor_data(
+      /* in out */      struct datap_desc *dp
+      )
+{
+   vy_class_type *vy = (vy_class_type *) dp->local;
    struct sensor_packet_header header;
-   // loop until done, or connection broken
    while ((dp->run_state & DP_STATE_DONE) == 0) {
-      // read packet header
-      log_debug(vy->log, "Read packet header");
-      if (recv_block(vy->connfd, &header, sizeof(header)) < 0) {
-         log_err(vy->log, "%s failed to read vy packet header. "
+      if (wait_reactor_frame(vy, PINET_CONN_WAIT_SEC) != 0) {
+         memcpy(&header, vy->frame, sizeof(header));
+         handle_frame(dp, &header, &vy->frame[sizeof(header)],
+               &vy->frame[sizeof(header) + CAM_N_PIX]);
+      } else if (pinet_conn_wait_closed(vy->conn, 0.0) != 0) {
+         log_err(vy->log, "%s failed to read vy packet. "
                "Breaking connection.", dp->td->obj_name);
-         close(vy->connfd);
-         vy->connfd = -1;
          break;
       }
-      //unpack_sensor_header(&header, &pkt_type, &remote_time);
-      log_debug(vy->log, "Unpack packet header");
-      unpack_sensor_header2(&header, &pkt_type, &frame_request,
-            &frame_received);
-      if (pkt_type != VY_PACKET_TYPE) {
-         log_err(vy->log, "Packet type error\nExpected 0x%08x, "
-               "received 0x%08x", VY_PACKET_TYPE, pkt_type);
-         hard_exit(__func__, __LINE__);
+   }
+   report_io(vy, dp->td->obj_name, 1);
+   // reactor closes socket. no frames are delivered after this
+   pinet_reactor_remove(vy->conn);
+   vy->conn = NULL;
+   vy->connfd = -1;
+   pthread_mutex_lock(&vy->frame_mutex);
+   const int32_t frame_error = vy->frame_error;
+   vy->frame_pending = 0;
+   vy->frame_error = 0;
+   pthread_mutex_unlock(&vy->frame_mutex);
+   if (frame_error != 0) {
+      // this is a configuration error that cannot be fixed and
+      //    will otherwise repeat indefinitely
+      hard_exit("vy_receiver::vy_class_run", 1);
+   }
+}
+
+static void pull_data(
+      /* in out */      struct datap_desc *dp
+      )
+{
+   vy_class_type *vy = (vy_class_type *) dp->local;
+   struct sensor_packet_header header;
+   vy->io_calls = 0;
+   vy->io_bytes = 0;
+   vy->copy_bytes = 0;
+   vy->io_frames = 0;
+   vy->frames_dropped = 0;
+   vy->io_report_sec = now();
+   // when network reactor is running, it reads the socket and passes
+   //    complete frames (header plus v and y channels) to
+   //    reactor_frame() on its own thread
+   if (pinet_reactor_enabled() && (vy->connfd >= 0)) {
+      const pinet_conn_handler_type handler = {
+         .packet = reactor_frame,
+         .timer = NULL,
+         .arg = dp
+      };
+      vy->conn = pinet_reactor_add(vy->connfd, dp->td->obj_name,
+            VY_PACKET_BYTES, &handler);
+      if (vy->conn != NULL) {
+         pull_reactor_data(dp);
+         return;
       }
-      // TODO FIXME find out why empty string is not null
-      if (header.log_data[0] != 0) {
-      //if (header.log_data[0] != 0) {
-         header.log_data[SENSOR_PACKET_LOG_DATA-1] = 0;
-         log_info(vy->log, "%s remote log: '%s'", dp->td->obj_name,
-               header.log_data);
+   }
+   // loop until done, or connection broken
+   while ((dp->run_state & DP_STATE_DONE) == 0) {
+      // header, v channel and y channel in as few reads as possible
+      log_debug(vy->log, "Read packet");
+      struct iovec iov[3] = {
+            { .iov_base = &header, .iov_len = sizeof(header) },
+            { .iov_base = vy->raw_v, .iov_len = CAM_N_PIX },
+            { .iov_base = vy->raw_y, .iov_len = CAM_N_PIX }
+      };
+      if (recv_blockv(vy->connfd, iov, 3, &vy->io_calls) < 0) {
+         log_err(vy->log, "%s failed to read vy packet. "
+               "Breaking connection.", dp->td->obj_name);
+         break;
       }
-      // store timestamp (provided in packet header)
-      uint32_t idx = (uint32_t) (dp->elements_produced % dp->queue_length);
-      vy_receiver_output_type *out = (vy_receiver_output_type*)
-            dp_get_object_at(dp, idx);
-      out->frame_request_time = frame_request;
-      dp->ts[idx] = frame_received;
-      log_info(vy->log, "Frame request %.4f, received %.4f",
-               frame_request, frame_received);
-      // decode packet
-//printf("Receiving packet from %.3f\n", remote_time);
-      // check dimension
-      image_size_type dim;
-      dim.rows = htons((uint16_t) header.custom_16[0]);
-      dim.cols = htons((uint16_t) header.custom_16[1]);
-      if ((dim.rows != CAM_ROWS) || (dim.cols != CAM_COLS)) {
-         log_err(vy->log, "Frame size mismatch in %s", dp->td->obj_name);
-         log_err(vy->log, "Expecting %dx%d, received %d,%d",
-               CAM_COLS, CAM_ROWS, dim.cols, dim.rows);
+      if (check_frame_header(dp, &header) != 0) {
          close(vy->connfd);
          vy->connfd = -1;
          // this is a configuration error that cannot be fixed and
          //    will otherwise repeat indefinitely
          hard_exit("vy_receiver::vy_class_run", 1);
       }
-//printf("receiving frame: %d bytes\n", vy_stream_len);
-      //////////////////////////////////
-      // pull image frame from network and copy to output buffer
-      // v channel
-      //if (recv_block(vy->connfd, out->v_chan, CAM_N_PIX) < 0) {
-      if (recv_block(vy->connfd, vy->raw_v, CAM_N_PIX) < 0) {
-         log_err(vy->log, "\n%s read error, v-chan. Breaking connection",
-               dp->td->obj_name);
-         goto end;
-      }
-      // y channel
-      if (recv_block(vy->connfd, vy->raw_y, CAM_N_PIX) < 0) {
-         log_err(vy->log, "\n%s read error, y-chan. Breaking connection",
+      handle_frame(dp, &header, vy->raw_v, vy->raw_y);
+   }
+   if (vy->connfd >= 0) {
+      close(vy->connfd);
+      vy->connfd = -1;
+   }
+   report_io(vy, dp->td->obj_name, 1);
+}
+
+// receives frames over UDP until done
+static void pull_udp_data(
+      /* in out */      struct datap_desc *dp
+      )
+{
+   vy_class_type *vy = (vy_class_type *) dp->local;
+   while ((dp->run_state & DP_STATE_DONE) == 0) {
+      vy_udp_frame_type *frame;
+      int32_t rc = vy_udp_next_frame(vy->udp, PINET_CONN_WAIT_SEC, &frame);
+      vy_udp_report(vy->udp, vy->log, dp->td->obj_name, 0);
+      if (rc > 0) {
+         continue;
+      } else if (rc < 0) {
+         log_err(vy->log, "%s UDP receive failed. Waiting to try again",
                dp->td->obj_name);
-         goto end;
+         sleep(1);
+         continue;
       }
       if ((dp->run_state & DP_STATE_PAUSE) != 0) {
          continue;
       }
-      // copy to output, splitting into image pyramid
-      for (uint32_t lev=0; lev<NUM_PYRAMID_LEVELS; lev++) {
-         image_size_type sz = vy->img_size[lev];
-         uint32_t n_pix = (uint32_t) (sz.x * sz.y);
-         // copy 'raw' data to output
-         const uint32_t offset = out->chan_offset[lev];
-         vy_pixel_type *chan = &out->chans[offset];
-         for (uint32_t i=0; i<n_pix; i++) {
-            vy_pixel_type *pix = &chan[i];
-            // EXPERIMENT
-            // V channel signal gets washed out w/ NIR -- magnify it
-            pix->v = (uint8_t) (128 + 2 * (vy->raw_v[i] - 128));
-            //pix->v = vy->raw_v[i];
-            pix->y = vy->raw_y[i];
-//            // testing -- visualize data change
-//            // alter 'raw' so content output to log
-//            vy->raw_v[i] = pix->v;
-         }
-         // if data logging enabled, write pgm file of (raw) image
-         if ((lev == 0) && (vy->data_folder != NULL)) {
-            log_to_pgm_file(dp, idx);
-         }
-         // blur and downsample to prepare for next round
-         uint32_t src_idx = 0;
-         uint32_t dest_idx = 0;
-         uint8_t *restrict raw_v = vy->raw_v;
-         uint8_t *restrict raw_y = vy->raw_y;
-         unsigned int *restrict img_tmp = vy->img_tmp;
-         if (lev < (NUM_PYRAMID_LEVELS - 1)) {
-            // blur each channel
-            blur_image_r1(raw_v, img_tmp, raw_v, sz);
-            blur_image_r1(raw_y, img_tmp, raw_y, sz);
-            // downsample buffers. work done in-place, as except for first
-            //    copy, src_index > dest_index
-            for (uint32_t y=0; y<sz.y; y+=2) {
-               for (uint32_t x=0; x<sz.x; x+=2) {
-                  raw_v[dest_idx] = raw_v[src_idx];
-                  raw_y[dest_idx] = raw_y[src_idx];
-                  src_idx += 2;
-                  dest_idx++;
-               }
-               src_idx += sz.x;
-            }
-         }
+      if (frame->missing_rows > 0) {
+         log_info(vy->log, "Frame %d missing %d rows", frame->frame_id,
+               frame->missing_rows);
       }
-      //////////////////////////////////
-      // all done. let others know
-      dp->elements_produced++;
-//printf("Posting frame at %.6f. Remote time: %.6f\n", now(), remote_time);
-      log_info(vy->log, "Signaling data available (%ld)",
-            dp->elements_produced);
-      dp_signal_data_available(dp);
-   }
-end:
-   if (vy->connfd >= 0) {
-      close(vy->connfd);
-      vy->connfd = -1;
+      // planes are read in place from reassembly buffers
+      publish_frame(dp, frame->frame_request_time,
+            frame->frame_received_time, frame->v_chan, frame->y_chan,
+            frame->missing_rows, frame->row_missing);
    }
+   vy_udp_report(vy->udp, vy->log, dp->td->obj_name, 1);
 }
 
 
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -78,37 +79,52 @@ static void vy_class_pre_run(
    log_info(vy->log, "in pre_run()");
    /////////////////////////////////////////////////////////////
    // setup networking
-   // get socket port
-   char port_str[STR_LEN];
-   FILE *fp = open_config_file_ro2(NULL, NULL, "endpoints",
-         dp->td->obj_name, NULL);
-   if (!fp) {
-      log_err(vy->log, "Unable to open endpoint file for '%s'",
-            dp->td->obj_name);
+   if (init_udp_receiver(dp) != 0) {
       goto err;
    }
-   if (config_read_string(fp, port_str, STR_LEN) != 0) {
-      log_err(vy->log, "Unable to determine listening port for '%s'",
-            dp->td->obj_name);
-      goto err;
-   }
-   uint32_t port = (uint32_t) atoi(port_str);
-   if (c_assert(port <= 0x00007fff)) {
-      log_err(vy->log,
-            "Configuration error: port size greater than int16 (%d)", port);
-      goto err;
-   }
-   log_info(vy->log, "%s listening on port %d", dp->td->obj_name, port);
-   if ((vy->sockfd = init_server((int16_t) port)) < 0) {
-      log_err(vy->log, "Failed to initialize server for %s", dp->td->obj_name);
-      // treat as fatal error until recovery logic worked out
-      goto err;
+   if (vy->udp == NULL) {
+      // get socket port
+      char port_str[STR_LEN];
+      FILE *fp = open_config_file_ro2(NULL, NULL, "endpoints",
+            dp->td->obj_name, NULL);
+      if (!fp) {
+         log_err(vy->log, "Unable to open endpoint file for '%s'",
+               dp->td->obj_name);
+         goto err;
+      }
+      if (config_read_string(fp, port_str, STR_LEN) != 0) {
+         log_err(vy->log, "Unable to determine listening port for '%s'",
+               dp->td->obj_name);
+         goto err;
+      }
+      uint32_t port = (uint32_t) atoi(port_str);
+      if (c_assert(port <= 0x00007fff)) {
+         log_err(vy->log,
+               "Configuration error: port size greater than int16 (%d)", port);
+         goto err;
+      }
+      log_info(vy->log, "%s listening on port %d", dp->td->obj_name, port);
+      if ((vy->sockfd = init_server((int16_t) port)) < 0) {
+         log_err(vy->log, "Failed to initialize server for %s", dp->td->obj_name);
+         // treat as fatal error until recovery logic worked out
+         goto err;
+      }
    }
    vy->camera_name = calloc(1, STR_LEN);
    /////////////////////////////////////////////////////////////
    vy->raw_v = malloc(CAM_ROWS * CAM_COLS * sizeof vy->raw_v[0]);
    vy->raw_y = malloc(CAM_ROWS * CAM_COLS * sizeof vy->raw_y[0]);
    vy->img_tmp = malloc(CAM_ROWS * CAM_COLS * sizeof vy->img_tmp[0]);
+   // handoff from network reactor. cond uses monotonic clock for
+   //    timed waits
+   vy->frame = malloc(VY_PACKET_BYTES);
+   vy->pending_frame = malloc(VY_PACKET_BYTES);
+   pthread_mutex_init(&vy->frame_mutex, NULL);
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&vy->frame_cond, &attr);
+   pthread_condattr_destroy(&attr);
    /////////////////////////////////////////////////////////////
    uint32_t offsets[NUM_PYRAMID_LEVELS];
    uint32_t tot_pix = 0;
@@ -141,6 +157,12 @@ static void vy_class_run(
 {
    //
 //   set_acquisition_state(1);
+   struct vy_class *vy = (struct vy_class*) dp->local;
+   if (vy->udp != NULL) {
+      // no connection to wait for
+      pull_udp_data(dp);
+      return;
+   }
    while ((dp->run_state & DP_STATE_DONE) == 0) {
       // wait for the next connection. there should only be one
       //    connection, but if client aborts (eg, segfault) then
@@ -188,6 +210,8 @@ static void vy_class_post_run(struct datap_desc *dp)
       close(vy->sockfd);
       vy->sockfd = -1;
    }
+   free_vy_udp_receiver(vy->udp);
+   vy->udp = NULL;
 }
 
 
@@ -214,6 +238,8 @@ void * vy_class_init(void *vy_setup)
    dp->local = vy;
    vy->sockfd = -1;
    vy->connfd = -1;
+   vy->udp = NULL;
+   vy->conn = NULL;
    vy->camera_num = setup->camera_num;
    strcpy(vy->device_name, setup->device_name);
    vy->data_folder = NULL;
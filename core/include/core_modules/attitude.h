@@ -22,6 +22,7 @@
 #include "pinet.h"
 #include "time_lib.h"
 #include "logger.h"
+#include "latency.h"
 
 #include "core_modules/support/imu_streams.h"
 
@@ -79,6 +80,9 @@ heading output now split between magnetic and true. other modules
 //    a sample was received, the channel is assumed to be offline
 #define ACC_MAG_TIMEOUT_USEC  300000
 
+// interval for reporting resample cost and memory
+#define ATTITUDE_RESAMPLE_REPORT_SEC   60.0
+
 /**
 Previous iteration of attitude used a reset system where attitude info
 would be unavailable if a fault was detected in the data stream. While
@@ -198,10 +202,20 @@ struct attitude_class {
    //    interval, so only the most recent acc and mag values are used
    //    in the filters. any artifacts introduced by this simplification
    //    should average out
-   // all gyr streams are resampled at 10ms time boundaries and combined
+   // all gyr streams are resampled at 10ms time boundaries and combined.
+   //    gyr streams are stored in gyr_bank, which is sized to hold
+   //    resample_history_ms of data
    simple_vector_stream_type     *acc_stream[MAX_ATTACHED_PRODUCERS];
    simple_vector_stream_type     *mag_stream[MAX_ATTACHED_PRODUCERS];
    resampled_vector_stream_type  *gyr_stream[MAX_ATTACHED_PRODUCERS];
+   resample_bank_type gyr_bank;
+   uint32_t resample_history_ms;
+   // cost of pushing producer data to streams and of combining gyr
+   //    streams, reset each report
+   latency_stats_type update_cost;
+   latency_stats_type combine_cost;
+   uint64_t update_samples;
+   double resample_report_sec;
    // keep track of how many P1 sources there are for each modality
    uint32_t num_p1_gyr;
    uint32_t num_p1_acc;
@@ -270,6 +284,13 @@ struct attitude_setup {
 };
 typedef struct attitude_setup attitude_setup_type;
 
+// sets duration of gyro data kept in resample queues. must be called
+//    before attitude module starts running
+void set_attitude_history(
+      /* in out */       datap_desc_type *att_dp,
+      /* in     */ const uint32_t history_ms
+      );
+
 
 ////////////////////////////////////////////////////////////////////////
 
@@ -27,6 +27,7 @@
 #include "time_lib.h"
 #include "logger.h"
 #include "sensor_packet.h"
+#include "nmea.h"
 
 // receives and distributes information from networked GPS source
 // GPS data received from network is expected to be NMEA sentences
@@ -44,6 +45,9 @@
 
 #define GPS_RECEIVER_LOG_LEVEL      LOG_LEVEL_DEFAULT
 
+// how often NMEA parse stats are logged
+#define GPS_RECEIVER_REPORT_SEC     60.0
+
 
 // size of data block sent by GPS process, storing the NMEA sentence(s).
 // if content is less than block size then the remaining bytes are zero
@@ -51,7 +55,8 @@
 // format for GPS block
 //       char[]    timestamp
 //       <one or more spaces>
-//       char[]    1 NMEA sentence
+//       char[]    1 NMEA sentence ('$' to checksum. older gps processes
+//                   send it w/o '$' and checksum)
 
 
 // TODO publish data using gps reader's output struct, of vice versa
@@ -91,6 +96,9 @@ struct gps_receiver_class {
    char device_name[MAX_NAME_LEN];
    FILE *logfile;
    log_info_type *log;
+   // parse errors are counted and reported periodically
+   nmea_stats_type nmea_stats;
+   double report_sec;
 };
 typedef struct gps_receiver_class gps_receiver_class_type;
 
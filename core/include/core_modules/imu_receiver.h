@@ -24,13 +24,16 @@
 #include "datap.h"
 #include "time_lib.h"
 #include "logger.h"
+#include "latency.h"
 #include "sensor_packet.h"
 
 // receives and distributes information from primary gyro-acc-mag source
 // publishes gyr, acc and mag data in ship space (z forward (bow), y up,
 //    x left (port))
 // log data is in same form as was reported from sensor, so it can
-//    be re-used as emulated input (ie, to replay an event)
+//    be re-used as emulated input (ie, to replay an event). log is
+//    binary (see imu_log_record in sensor_packet.h) and is written
+//    in batches
 //
 // gyro drift (low-pass) filter implemented at device level
 // interploated sensor values reported -- data is not otherwise
@@ -47,6 +50,15 @@ than during data outages, it should accurately represent what was delivered
 
 Published gyro data is upsampled 10ms intervals.
 
+Upsampled samples are pushed to the queue as soon as they're available
+but subscribers are only woken once per batch. A batch is signaled when
+it holds batch_samples samples or when its first sample has been waiting
+batch_latency_usec. The receiver's wait for the next packet is bounded
+by the latency cap, so the cap holds when the sensor stalls. Pending
+samples are signaled when the connection breaks and at shutdown. Setting
+batch_samples to 0 restores the original signaling, where subscribers
+are woken on every 2nd publication.
+
 TODO see imu_streams.h for comment about merging att and imu resampling
 
 Time is stored as a double, for
@@ -68,6 +80,16 @@ been performed on them (e.g., add 10ms (i.e., +0.01 sec))
 
 #define IMU_LOG_LEVEL      LOG_LEVEL_DEFAULT
 
+// default batch size and latency cap for waking subscribers
+#define IMU_BATCH_SAMPLES        3
+#define IMU_BATCH_LATENCY_USEC   20000
+
+// log records are buffered and written together
+#define IMU_LOG_BATCH_RECORDS    32
+
+// interval for reporting subscriber wakeups and delivery latency
+#define IMU_BATCH_REPORT_SEC     60.0
+
 // pinet.h defines IMU_ACC, IMU_MAG, IMU_GYR, NUM_IMU_CHANNELS
 
 struct imu_output {
@@ -107,6 +129,8 @@ enum { IMU_PRI_1=0, IMU_PRI_2, IMU_PRI_3, IMU_PRI_NULL };
 
 struct imu_class {
    int sockfd, connfd;
+   // elements_produced when next published sample is logged
+   uint64_t report_level;
    char device_name[MAX_NAME_LEN];
    FILE *logfile;
    log_info_type *log;
@@ -129,6 +153,22 @@ struct imu_class {
    microsecond_timestamp_type prev_gyr_data_t;
    // time of previously published sample
    microsecond_timestamp_type prev_publish_t;
+   // batched publication. 0 samples means use original signaling
+   uint32_t batch_samples;
+   uint32_t batch_latency_usec;
+   // elements_produced when subscribers were last signaled and woken
+   uint64_t batch_signaled;
+   uint64_t batch_delivered;
+   // when first sample of pending batch was published (<0 if none)
+   double batch_start_sec;
+   // wakeup and delivery latency stats, reset each report
+   uint32_t wakeups;
+   uint64_t samples_delivered;
+   latency_stats_type delivery;
+   double report_start_sec;
+   // pending log records
+   imu_log_record_type log_batch[IMU_LOG_BATCH_RECORDS];
+   uint32_t log_batch_len;
 };
 typedef struct imu_class imu_class_type;
 
@@ -160,6 +200,14 @@ void set_imu_priority(
       /* in     */ const uint32_t mag_pri
       );
 
+// sets batch size and latency cap for waking subscribers of imu
+//    producer. max_samples of 0 restores original signaling
+void set_imu_batch(
+      /* in out */       datap_desc_type *imu_dp,
+      /* in     */ const uint32_t max_samples,
+      /* in     */ const uint32_t max_latency_ms
+      );
+
 //static microsecond_timestamp_type prev_imu_publish_time(
 //      /* in     */ const uint64_t usec
 //      );
@@ -20,6 +20,7 @@
 #include "logger.h"
 #include "pixel_types.h"
 #include "image.h"
+#include "latency.h"
 
 
 // 'flattens' and rotates acquired images from single camera so top
@@ -57,6 +58,25 @@
 
 #define OPTICAL_UP_LOG_LEVEL     LOG_LEVEL_DEFAULT
 
+// set to 1 to also publish each pyramid level as separate planes of
+//    color, border and radius. planes are written as a side effect of
+//    the blur, which already works on planes, so this is much cheaper
+//    than having a subscriber split up frame[] itself. panorama's
+//    structure-of-arrays layout (PAN_SOA_LAYOUT) requires this
+#define OPTICAL_UP_PLANES     0
+
+// planar copy of one pyramid level of frame[]. each plane has one
+//    element per pixel, in the same order as frame[]
+struct optical_up_planes {
+   // indexed the same as pixel_color_type.channel[]
+   uint8_t *channel[NUM_IMAGE_CHANNELS];
+   uint8_t *border;
+   uint16_t *radius;
+   // cam_num is the same for all pixels in a frame
+   uint8_t cam_num;
+};
+typedef struct optical_up_planes optical_up_planes_type;
+
 struct optical_up_output {
    // camera direction relative to world coordinate frame
    sphere_coordinate32_type world_center;
@@ -73,6 +93,12 @@ struct optical_up_output {
    pixel_cam_info_type   *pyramid_;
    // image data
    pixel_cam_info_type *frame[NUM_PYRAMID_LEVELS];
+#if OPTICAL_UP_PLANES == 1
+   // planar copy of frame[]. planes for all levels point into
+   //    planes_heap_, which should not be accessed directly
+   optical_up_planes_type planes[NUM_PYRAMID_LEVELS];
+   uint8_t *planes_heap_;
+#endif   // OPTICAL_UP_PLANES
 };
 typedef struct optical_up_output optical_up_output_type;
 
@@ -91,12 +117,25 @@ typedef struct optical_up_output optical_up_output_type;
 
 struct vy_accumulator;  // this is defined privately in module
 
-// when blurring images, need to blur border channel as well
-// create struct that represents v and y as well as border.
-struct vy_blur_pixel {
-   uint8_t channel[NUM_IMAGE_CHANNELS+1];
+// when blurring images, need to blur border channel as well. blur is
+//    separable and is done on planes of v, y and border. horizontal
+//    sums for 3 consecutive rows are kept so the vertical pass for a row
+//    can run once the row below it is available. row planes are padded
+//    so vector ops don't need special handling at the end of the row
+#define BLUR_NUM_PLANES    (NUM_IMAGE_CHANNELS+1)
+#define BLUR_NUM_ROWS      3
+struct vy_blur_buf {
+   // number of elements in each row plane
+   uint32_t stride;
+   // horizontal sums of 3 rows, indexed by row % 3
+   uint16_t *hsum[BLUR_NUM_ROWS][BLUR_NUM_PLANES];
+   // source row split into planes, w/ one pixel of padding on each side
+   uint16_t *src_row[BLUR_NUM_PLANES];
+   // blurred output row
+   uint16_t *out_row[BLUR_NUM_PLANES];
+   uint16_t *heap_;
 };
-typedef struct vy_blur_pixel vy_blur_pixel_type;
+typedef struct vy_blur_buf vy_blur_buf_type;
 
 
 struct optical_up_class {
@@ -121,8 +160,14 @@ struct optical_up_class {
    /////////////////////////////////////////////////////////////
    // sizes are same for sphere and intermediate space
    struct vy_accumulator *accum[NUM_PYRAMID_LEVELS];
+   // distance of each output pixel from image center
+   uint16_t *radius_map[NUM_PYRAMID_LEVELS];
    // buffer used to store intermediate blur values
-   vy_blur_pixel_type *blur_buf;
+   vy_blur_buf_type blur_buf;
+   // time spent in blur_output_r1(). summarized in log every
+   //    DP_LATENCY_REPORT_SEC, along w/ kernel's publish-age summary
+   latency_stats_type blur_time;
+   double blur_report_sec;
    //
    image_type *img;
    // host name of device with camera
@@ -22,6 +22,7 @@
 #include "logger.h"
 #include "image.h"
 #include "pixel_types.h"
+#include "pan_log.h"
 #include "core_modules/support/frame_heap.h"
 
 #if INSERT_PHANTOM_IMAGE == 1
@@ -77,8 +78,10 @@ typedef struct panorama_coverage panorama_coverage_type;
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 // color grid
-// OBSOLETE -- heavy hit on performance for little gain
-#if 0
+// running distribution of colors seen in each region of the world view
+//    (the background), for use in association
+// set to 0 to disable
+#define PAN_COLOR_GRID     1
 
 //// number of color grids in world view (ie, over 360 degrees)
 //// note: this value is for reference only. it is hard-coded and things
@@ -102,28 +105,50 @@ typedef struct panorama_coverage panorama_coverage_type;
 // number of bins in color distribution
 // this must be a power of 2
 #define COLOR_GRID_DIST_SIZE     64
-
-//// describes the categorization of a small portion of the field of view.
-////    square contains summary (over time) of what is observed in that
-////    portion of field of view
-//struct pan_color_grid_unit {
-//   // distribution of colors observed recently
-//   // colors are recorded at each level
-//   doulbe color_y[NUM_PYRAMID_LEVELS][COLOR_GRID_DIST_SIZE];
-//// TODO FIXME v range is too narrow to have a meaningful distribution,
-////    as NIR causes most values to be near 128. until this is fixed
-////    at the camera end the color_v distribution shouldn't be used.
-////    when it is, update keypoint/pixel_features.c:calc_pixel_features()
-////    to include it when generating color score
-////    (fix: eg, downsampling full-res image and getting value for v that
-////    doesn't induce discretization artifacts by magnifying small
-////    integral offset from 128)
-//   float color_v[NUM_PYRAMID_LEVELS][COLOR_GRID_DIST_SIZE];
-//   // total area under each distribution (this will be the same for
-//   //    all color channels)
-//   float num_samples[NUM_PYRAMID_LEVELS];
-//};
-//typedef struct pan_color_grid_unit pan_color_grid_unit_type;
+#define COLOR_GRID_BIN_WIDTH     (256 / COLOR_GRID_DIST_SIZE)
+
+// decay isn't applied to stored values. instead, the weight given to
+//    new samples grows each frame by 1/(1-tau), which is equivalent,
+//    and stored values are rescaled when the weight reaches this value
+#define COLOR_GRID_RENORM_WEIGHT    1.0e12f
+
+// how often color grid update cost is reported, in frames
+#define COLOR_GRID_REPORT_INTERVAL  (60 * CAMERA_FPS)
+
+// most grid rows that are re-binned in one frame. rows are visited in
+//    turn and a row's samples are weighted by the number of frames
+//    since it was last visited, so each row is refreshed about every
+//    rows/COLOR_GRID_MAX_ROWS_PER_FRAME frames (~1 sec)
+#define COLOR_GRID_MAX_ROWS_PER_FRAME     8
+
+// if there's no camera input for this many frames then what's in the
+//    grid no longer describes the world and it's cleared
+#define COLOR_GRID_STALE_FRAMES     \
+      ((uint32_t) (CAMERA_FPS * COLOR_GRID_TIME_CONSTANT_SECS))
+
+// describes the categorization of a small portion of the field of view.
+//    square contains summary (over time) of what is observed in that
+//    portion of field of view
+// distribution values are in arbitrary units (see COLOR_GRID_RENORM_WEIGHT)
+//    and are only meaningful relative to num_samples
+struct pan_color_grid_unit {
+   // distribution of colors observed recently
+   // colors are recorded at each level
+   float color_y[NUM_PYRAMID_LEVELS][COLOR_GRID_DIST_SIZE];
+// TODO FIXME v range is too narrow to have a meaningful distribution,
+//    as NIR causes most values to be near 128. until this is fixed
+//    at the camera end the color_v distribution shouldn't be used.
+//    when it is, update keypoint/pixel_features.c:calc_pixel_features()
+//    to include it when generating color score
+//    (fix: eg, downsampling full-res image and getting value for v that
+//    doesn't induce discretization artifacts by magnifying small
+//    integral offset from 128)
+   float color_v[NUM_PYRAMID_LEVELS][COLOR_GRID_DIST_SIZE];
+   // total area under each distribution (this will be the same for
+   //    all color channels)
+   float num_samples[NUM_PYRAMID_LEVELS];
+};
+typedef struct pan_color_grid_unit pan_color_grid_unit_type;
 
 
 // holds an array of color grid units
@@ -163,15 +188,97 @@ struct pan_color_grid {
 //   uint32_t num_grids_horiz;
 //   uint32_t num_grids_vert;
    image_size_type size;
+   // for output grids, the update (see pan_color_grid_accum) that
+   //    grid was last brought up to date with
+   uint32_t sync_gen;
    //
    pan_color_grid_unit_type *grid;
 };
 typedef struct pan_color_grid pan_color_grid_type;
 
-#endif   // 0
+// state for updating master grid. pixels for one grid row are counted
+//    in row buffers, then folded into the master grid units that
+//    received them. neighborhood sums of master are kept in a published
+//    grid that's only updated around units that changed, and output
+//    grids only copy units that changed since they were last written
+struct pan_color_grid_accum {
+   // weight applied to new samples (see COLOR_GRID_RENORM_WEIGHT)
+   float weight;
+   // first panorama pixel column of each grid column, plus one entry
+   //    for the end of the last grid column
+   uint32_t *col_start[NUM_PYRAMID_LEVELS];
+   // first panorama pixel row of each grid row, plus one entry for the
+   //    end of the last grid row
+   uint32_t *row_start[NUM_PYRAMID_LEVELS];
+   // per-column color counts (y then v) for the current grid row. there
+   //    are two sets per column, for even and odd pixels
+   uint16_t *row_counts;
+   // number of samples in each column for current grid row
+   uint32_t *row_samples;
+   // sample weight owed to each grid row since it was last binned
+   float *row_weight;
+   // next grid row to bin, and how many rows to bin per frame
+   uint32_t next_row;
+   uint32_t max_rows_per_frame;
+   // master units that received samples this update (1 if so)
+   uint8_t *dirty;
+   // sum of master over each unit's 3x3 neighborhood
+   pan_color_grid_unit_type *published;
+   // update count, and the update each published unit last changed in
+   uint32_t gen;
+   uint32_t *unit_gen;
+   // consecutive frames without camera input
+   uint32_t empty_frames;
+   // update cost since last report
+   double update_sec;
+   double max_update_sec;
+   uint32_t num_updates;
+};
+typedef struct pan_color_grid_accum pan_color_grid_accum_type;
 // color grid
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
+// structure-of-arrays layout
+
+// set to 1 to have panorama store the world view as separate planes
+//    for each overlap_pixel field instead of interleaved overlap_pixel
+//    records. fg/bg resolution only needs the radius planes to decide
+//    where a pixel goes, so this layout lets the blend be vectorized
+//    and keeps cache lines full of data that's actually used
+// when enabled, world_frame[] is not populated. pixels should be
+//    read from soa[] or through pan_soa_get_pixel()
+// optical_up must publish planes as well (OPTICAL_UP_PLANES)
+#define PAN_SOA_LAYOUT     0
+
+#if PAN_SOA_LAYOUT == 1 && INSERT_PHANTOM_IMAGE == 1
+#error "Phantom images are not supported with the SoA panorama layout"
+#endif   // PAN_SOA_LAYOUT && INSERT_PHANTOM_IMAGE
+
+// one plane per field of the fg and bg pixel_cam_info records. each
+//    plane has one element per world pixel, in the same row-major order
+//    as world_frame
+struct pan_soa_frame {
+   uint8_t *fg_y;
+   uint8_t *fg_v;
+   uint16_t *fg_radius;
+   uint8_t *fg_border;
+   uint8_t *fg_cam;
+   //
+   uint8_t *bg_y;
+   uint8_t *bg_v;
+   uint16_t *bg_radius;
+   uint8_t *bg_border;
+   uint8_t *bg_cam;
+};
+typedef struct pan_soa_frame pan_soa_frame_type;
+
+// bytes per world pixel, summed over all planes
+#define PAN_SOA_BYTES_PER_PIX    \
+      ((uint32_t) (2 * (4 * sizeof(uint8_t) + sizeof(uint16_t))))
+
+// structure-of-arrays layout
+////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
 // panorama output
 
 // WARNING -- panorama publishes data in a non-standard way
@@ -209,6 +316,13 @@ struct panorama_output {
    //    location in the heap for a particular level)
    // it should not be accessed directly
    overlap_pixel_type *pyramid_;
+#if PAN_SOA_LAYOUT == 1
+   // plane-based world view, used in place of world_frame. planes
+   //    for all levels point into soa_heap_, which should not be
+   //    accessed directly
+   pan_soa_frame_type soa[NUM_PYRAMID_LEVELS];
+   uint8_t *soa_heap_;
+#endif   // PAN_SOA_LAYOUT
    // recent history of colors seen at each region of world view
    // this is a pointer into panorama's color grid heap
    // color distribution that is published is actually a sum of
@@ -228,18 +342,14 @@ struct panorama_output {
 typedef struct panorama_output panorama_output_type;
 
 // panorama log output
-// logs are a single binary file, with blocks that contain the timestamp
-//    and a panorama_output struct. specifically:
-//    # frame 0
-//       char[32]
-//       panorama_output
-//    # frame 1
-//       char[32]
-//       panorama_output
-//    # frame...
-#define PAN_LOG_OUTPUT_TIME_SIZE     32u
-#define PAN_LOG_OUTPUT_BLOCK_SIZE    \
-      ((uint32_t) ((PAN_LOG_OUTPUT_TIME_SIZE + sizeof(panorama_output_type))))
+// logging modes (panorama_setup.logging)
+//    PAN_LOGGING_NONE     no output
+//    PAN_LOGGING_PNM      one .pnm file per frame (pyramid level 0)
+//    PAN_LOGGING_INDEXED  single compressed, indexed log file
+//                         (data_folder/PAN_LOG_FILE_NAME). see pan_log.h
+#define PAN_LOGGING_NONE      0
+#define PAN_LOGGING_PNM       1
+#define PAN_LOGGING_INDEXED   2
 
 
 // NOTE: see above regarding how 'queue' is implemented before changing value
@@ -265,6 +375,10 @@ struct panorama_class {
    // 0 is grayscale output
    // 1 is color. red images w/ overlap regions having G & B elements
    uint32_t output_type;
+   // indexed log, when logging is PAN_LOGGING_INDEXED. NULL otherwise
+   pan_log_writer_type *pan_log;
+   // r, g, b planes for building log output
+   uint8_t *log_planes;
    //
    log_info_type *log;
    // camera height above water when ship is level, in meters
@@ -273,12 +387,16 @@ struct panorama_class {
    meter_type camera_forward_position;
    // camera position starboard of centerline, in meters
    meter_type camera_starboard_position;
-//   /////////////////////////////////////////////
-//   // color grid -- part of layout
-//   pan_color_grid_type *color_grid_heap;
-//   uint32_t color_grid_queue_idx;
-//   // master grid is copied onto heap with each frame page update
-//   pan_color_grid_type master_color_grid;
+#if PAN_COLOR_GRID == 1
+   /////////////////////////////////////////////
+   // color grid -- part of layout
+   pan_color_grid_type *color_grid_heap;
+   // master grid has the distribution for each grid unit. the sum of
+   //    master over the 3x3 neighborhood of each unit is written to
+   //    the heap with each frame page update
+   pan_color_grid_type master_color_grid;
+   pan_color_grid_accum_type color_accum;
+#endif   // PAN_COLOR_GRID
 #if INSERT_PHANTOM_IMAGE == 1
    /////////////////////////////////////////////////////////////////////
    // phantom
@@ -300,6 +418,7 @@ void * panorama_init(void *);
 
 // struct to pass config data to thread
 struct panorama_setup {
+   // one of PAN_LOGGING_*
    uint32_t logging;
    // 0 or 1: 0 for normal output, 1 for colored, for aligning cams
    uint32_t output_type;
@@ -315,6 +434,13 @@ const frame_page_type * panorama_get_frame_list(
       /* in     */ const panorama_class_type *pan
       );
 
+// assembles the overlap pixel at idx from the plane representation
+//    of a world frame
+overlap_pixel_type pan_soa_get_pixel(
+      /* in     */ const pan_soa_frame_type *soa,
+      /* in     */ const uint32_t idx
+      );
+
 // see keypoint's pixel_features for code of (v348)
 //uint32_t get_color_grid_unit_idx(
 //      /* in     */ const image_coordinate_type pos,
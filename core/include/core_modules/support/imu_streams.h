@@ -39,10 +39,19 @@ Stream samples are assumed to contain the data values as measured since
 #define SAMPLE_DUR_USEC       (1000000 / SAMPLE_FREQ_HZ)
 #define SAMPLE_DUR_SEC        ((double) SAMPLE_DUR_USEC * 1.0e-6)
 
-// number of samples cached
-// this must be a power of 2. if not, change bitwise AND code to
-//    be integral modulus
-#define RESAMPLE_QUEUE_LEN 2048
+// resampled streams are stored together (see resample_bank below). rows
+//    are padded to a multiple of this many streams so a row can be
+//    processed in fixed-width chunks, which the compiler vectorizes
+#define RESAMPLE_LANES        4
+
+// default duration of data kept in resample queues. queue length is
+//    this rounded up to a power of 2 samples. data only needs to be
+//    kept until it's published, which is normally w/in the attitude
+//    delay window
+#define RESAMPLE_HISTORY_MS   1000
+// bounds for configured history
+#define RESAMPLE_MIN_ROWS     8
+#define RESAMPLE_MAX_ROWS     65536
 
 #define SIMPLE_VECTOR_TIMEOUT_SEC
 
@@ -58,15 +67,20 @@ struct simple_vector_stream {
 typedef struct simple_vector_stream simple_vector_stream_type;
 
 
+struct resample_bank;
+
 // gyro stream is resampled to regular intervals. complementary filter
 //    applied to gyro stream from data in acc/mag streams, which are
 //    simple_vector_stream
+// sample values are stored in the stream's column of a resample bank
 struct resampled_vector_stream {
-   // data stored in queue
-   vector_type resampled[RESAMPLE_QUEUE_LEN];
+   struct resample_bank *bank;
+   uint32_t col;
    // indices of read position in queue, storing next available
    //    sample, and of write position, where next sample is
-   //    being assembled
+   //    being assembled. indices are rows in the bank and are tied to
+   //    sample time, so samples of different streams for the same
+   //    time are in the same row
    uint32_t read_queue_idx;
    uint32_t write_queue_idx;
    // write position duration is the amount of data copied to write
@@ -86,5 +100,28 @@ struct resampled_vector_stream {
 };
 typedef struct resampled_vector_stream resampled_vector_stream_type;
 
+
+// resampled streams are stored in structure-of-arrays form. there's
+//    one array per axis, and each row of an array holds the values of
+//    all streams for one sample interval. combining streams for a
+//    publication time is then a single pass over one row, w/ cost
+//    that's nearly independent of number of streams
+struct resample_bank {
+   uint32_t num_streams;
+   // row width. num_streams rounded up to multiple of RESAMPLE_LANES
+   uint32_t stride;
+   // number of rows. power of 2
+   uint32_t queue_len;
+   // sample values. value of stream s in row r is at [r*stride + s]
+   double *val[3];
+   // weight of each stream when combining a row. entries for padding
+   //    and unused streams are zero
+   double *weight;
+   resampled_vector_stream_type *streams;
+   // total bytes allocated
+   size_t bytes;
+};
+typedef struct resample_bank resample_bank_type;
+
 #endif   // IMU_STREAMS_H
 
@@ -20,7 +20,10 @@
 #error "_GNU_SOURCE should be defined in makefile"
 #endif   // _GNU_SOURCE
 #include "pinet.h"
+#include "pinet_reactor.h"
 #include "logger.h"
+#include <pthread.h>
+#include "vy_udp.h"
 #include "pixel_types.h"
 #include <stdio.h>
 
@@ -50,6 +53,10 @@
 #define  VY_COLS  CAM_COLS
 #define  VY_N_PIX   (VY_ROWS * VY_COLS)
 
+// frame as sent over TCP: header, V plane then Y plane
+#define  VY_PACKET_BYTES   \
+      ((uint32_t) sizeof(struct sensor_packet_header) + 2 * VY_N_PIX)
+
 
 // output data has same format as 'uncorrected' image acquired by camera
 //    (i.e., no perspective transform has been performed). V and Y channels
@@ -57,6 +64,13 @@
 //    determined from image directly (ie, where the borders are)
 struct vy_receiver_output {
    double frame_request_time;
+   // rows of V and Y planes (of 2*CAM_ROWS) that were lost in transport
+   //    and filled from neighboring rows. only happens w/ UDP
+   uint32_t missing_rows;
+   // 1 for each row that was lost in transport and filled (level 0), or
+   //    whose whole blur footprint was lost (higher levels). consumers
+   //    should skip these rows. only set w/ UDP
+   uint8_t row_missing[NUM_PYRAMID_LEVELS][VY_ROWS];
    image_size_type img_size[NUM_PYRAMID_LEVELS];
 //   uint8_t v_chan[NUM_PYRAMID_LEVELS][VY_N_PIX];
 //   uint8_t y_chan[NUM_PYRAMID_LEVELS][VY_N_PIX];
@@ -76,6 +90,16 @@ typedef struct vy_receiver_output vy_receiver_output_type;
 //   wrong)
 #define VY_QUEUE_LEN   24
 
+// interval between reports of network i/o per frame
+#define VY_IO_REPORT_SEC   60.0
+
+// when endpoint file <name>_udp exists, frames are received over UDP
+//    (see vy_udp.h) instead of TCP. file has port and optional
+//    multicast group (eg, "6900 239.255.42.1")
+// frames are handed on this long after their first datagram arrives
+//    even if incomplete. sending a frame takes ~80ms on 100Mb ethernet
+#define VY_UDP_DEADLINE_SEC   0.15
+
 
 ////////////////////////////////////////////////////////////////////////
 
@@ -93,6 +117,28 @@ struct vy_class {
    uint8_t *raw_v;
    uint8_t *raw_y;
    unsigned int *img_tmp;  // temporary buffer used for downsample blurring
+   // non-NULL when frames are received over UDP
+   vy_udp_receiver_type *udp;
+   // non-NULL while network reactor reads the connection. reactor copies
+   //    each packet (header plus V and Y planes) to pending_frame and
+   //    this thread swaps it w/ frame and publishes it, so blurring and
+   //    logging don't hold up the reactor's loop
+   pinet_conn_type *conn;
+   pthread_mutex_t frame_mutex;
+   pthread_cond_t frame_cond;
+   uint8_t *frame;
+   uint8_t *pending_frame;
+   uint32_t frame_pending;
+   // set by reactor handler when a frame header is bad
+   int32_t frame_error;
+   // frames replaced in pending_frame before this thread got to them
+   uint32_t frames_dropped;
+   // network i/o since last report
+   uint64_t io_calls;   // read syscalls (reactor reports its own)
+   uint64_t io_bytes;   // bytes received
+   uint64_t copy_bytes; // bytes copied from received planes to output
+   uint32_t io_frames;
+   double io_report_sec;
    // remaps pixels to intermediate representation on unit sphere. once
    //    on sphere they are rotated to their correct position in world view
    const vector_type *sphere_map[NUM_PYRAMID_LEVELS];
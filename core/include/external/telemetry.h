@@ -0,0 +1,124 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(TELEMETRY_WIRE_H)
+#define TELEMETRY_WIRE_H
+#include <stdint.h>
+
+// message format for telemetry stream. this is in external because it's
+//    read by clients
+// stream is intended for clients on the same host, or at least on a host
+//    w/ the same byte order, so values are sent in host order
+// each message is a telemetry_header followed by payload_bytes of the
+//    type-specific payload. a client can send a telemetry_subscribe at
+//    any time to change the rates it receives each type at
+
+#define TELEMETRY_MAGIC       0x4b54
+#define TELEMETRY_VERSION     1
+
+enum telemetry_type {
+   TELEMETRY_ATTITUDE,
+   TELEMETRY_POSITION,
+   TELEMETRY_ROUTE,
+   TELEMETRY_MODULES,
+   NUM_TELEMETRY_TYPES
+};
+
+struct telemetry_header {
+   uint16_t magic;
+   uint8_t version;
+   uint8_t type;
+   uint32_t payload_bytes;
+   // per-client message counter
+   uint32_t seq;
+   // number of messages of this type that weren't sent to this client
+   //    since the last one that was, because client wasn't reading
+   //    fast enough
+   uint32_t dropped;
+   // sample time of data (server time, from now())
+   double t;
+};
+typedef struct telemetry_header telemetry_header_type;
+
+struct telemetry_attitude {
+   float true_heading_deg;
+   float pitch_deg;
+   float roll_deg;
+   float turn_rate_dps;
+};
+typedef struct telemetry_attitude telemetry_attitude_type;
+
+struct telemetry_position {
+   double lon_deg;
+   double lat_deg;
+   float speed_mps;
+   float track_deg;
+   // GPS_REC_AVAILABLE_* flags of most recent gps message
+   uint32_t available;
+   uint32_t unused;
+};
+typedef struct telemetry_position telemetry_position_type;
+
+// route chosen by driver
+struct telemetry_route {
+   float sug_heading_deg;
+   float autopilot_course_deg;
+   float measured_heading_deg;
+   float path_heading_deg;
+   float present_speed_mps;
+   float turn_rate_dps;
+   double dest_lon_deg;
+   double dest_lat_deg;
+   // route_control flags_all and flags2_persistent
+   uint32_t flags;
+   uint32_t flags_persistent;
+};
+typedef struct telemetry_route telemetry_route_type;
+
+#define TELEMETRY_NAME_LEN    24
+
+// modules payload is a telemetry_modules followed by num_modules
+//    telemetry_module records
+struct telemetry_module {
+   char name[TELEMETRY_NAME_LEN];
+   char class_name[TELEMETRY_NAME_LEN];
+   uint64_t elements_produced;
+   uint32_t queue_length;
+   // largest number of published elements not yet read by a consumer
+   uint32_t max_backlog;
+   // age of data when published, since module's last latency report
+   float publish_age_p50_ms;
+   float publish_age_p99_ms;
+};
+typedef struct telemetry_module telemetry_module_type;
+
+struct telemetry_modules {
+   uint32_t num_modules;
+   uint32_t unused;
+};
+typedef struct telemetry_modules telemetry_modules_type;
+
+// sent by client. rate of 0 stops that type. rates are capped by
+//    server
+struct telemetry_subscribe {
+   uint16_t magic;
+   uint8_t version;
+   uint8_t unused;
+   float rate_hz[NUM_TELEMETRY_TYPES];
+};
+typedef struct telemetry_subscribe telemetry_subscribe_type;
+
+#endif   // TELEMETRY_WIRE_H
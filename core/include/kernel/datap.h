@@ -21,6 +21,7 @@
 #endif   // _GNU_SOURCE
 #include <pthread.h>
 #include "pinet.h"
+#include "latency.h"
 
 void * cb_datap_launch(void *arg);
 
@@ -47,6 +48,9 @@ typedef struct producer_record producer_record_type;
 #define DP_STATE_PAUSE        0x2000
 #define DP_STATE_DONE         0x4000
 
+// how often age of published data is written to kernel log
+#define DP_LATENCY_REPORT_SEC    60.0
+
 struct thread_desc {
    pthread_t thread_id;
    pthread_cond_t    condition;
@@ -110,6 +114,16 @@ struct datap_desc {
    //    own byte alignment of data in queues
    uint8_t *void_queue; // prepend 'void' to remind that there's no type
    double *ts;
+   // ts is the time of the originating sensor sample, and is passed
+   //    from stage to stage. publish_ts is the time that each element
+   //    was published (ie, when consumers were signaled), so the
+   //    difference is the age of the data when leaving this processor.
+   //    publish_ts is allocated with the queue, after pre_run() and
+   //    before any processor runs. it's NULL if there's no queue
+   double *publish_ts;
+   uint64_t elements_stamped;
+   latency_stats_type publish_age;
+   double publish_age_report_sec;
    //
    uint64_t elements_produced;
    uint32_t element_size;
@@ -151,8 +165,16 @@ extern datap_desc_type *processor_list_[MAX_PROCESSORS];
 datap_desc_type * dp_create(void);
 void dp_destroy(datap_desc_type *dp);
 
+// records publish time of new elements and signals consumers
 void dp_signal_data_available(datap_desc_type *producer);
 
+// returns time that element at idx was published, or -1 if that's
+//    not known
+double dp_get_publish_time_at(
+      /* in     */ const datap_desc_type *dp,
+      /* in     */ const uint32_t idx
+      );
+
 void dp_wait(datap_desc_type *dp);
 void dp_wake(datap_desc_type *dp);
 void dp_abort(datap_desc_type *dp);
@@ -20,8 +20,11 @@
 
 // the postmaster exchanges control messages between the kernel and remote
 //    processes (eg, a java control app)
-// communication protocol is client connects, sends request, waits for
-//    response, closes connection
+// communication protocol is client connects, sends request(s) and gets
+//    one response per request, in the order requests were sent. client
+//    can close connection after each response or keep it open and
+//    pipeline requests. commands that change vessel behavior are handled
+//    ahead of other requests
 // there is one postmaster process per app
 
 void * launch_postmaster(void *arg);
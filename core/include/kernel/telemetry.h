@@ -0,0 +1,39 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(TELEMETRY_H)
+#define  TELEMETRY_H
+#include <stdint.h>
+#include "external/telemetry.h"
+
+// telemetry streams attitude, position, route and module status to
+//    local clients (eg, a display), each at a rate the client requests.
+//    message format is in external/telemetry.h
+// data is read from the most recent element in each producer's queue so
+//    processing threads are never blocked. each client has its own
+//    output buffer and messages are dropped for a client that can't keep
+//    up, rather than delaying other clients
+// port is read from config 'endpoints/telemetry'. if that isn't present
+//    then telemetry is disabled
+
+void * launch_telemetry(void *arg);
+
+// sets telemetry quit flag. thread exits w/in one tick
+void telemetry_quit(
+      /* in     */ const int unused
+      );
+
+#endif  // TELEMETRY_H
@@ -35,21 +35,55 @@
 
 #define UDP_SYNC_CLASS_NAME  "udp_cam_sync"
 
-// initial algorithm is to send image request packet every 200ms
-//    (5Hz, like initial acquisition)
-// future approach can vary frequency, eg, send ping immediately after
-//    previous frame processed (when processing helpful) or send less
-//    frequent pings (eg, calm conditions)
+// cameras acquire frames at the interval sent in sync packets. the
+//    interval is adjusted, within configured bounds, according to how
+//    well the vision pipeline (frame_sync, optical_up, panorama) keeps
+//    up. when frames queue at a module or published data gets old, the
+//    frame rate is lowered. after load has been low for a while it's
+//    raised again
 // TODO investigate if camera can change resolution on the fly
 
 #define UDP_BCAST_INTERVAL   (UDP_SYNC_INTERVAL)
 
+// how often pipeline load is checked
+#define UDP_SYNC_LOAD_CHECK_SEC     1.0
+// slow down when this many frames are waiting to be read by a module
+#define UDP_SYNC_BACKLOG_HIGH       2
+// slow down when age of latest output of a module exceeds this
+#define UDP_SYNC_AGE_HIGH_SEC       0.75
+// load considered low when there's no backlog and age is below this
+#define UDP_SYNC_AGE_LOW_SEC        0.40
+// consecutive low-load checks needed before speeding up
+#define UDP_SYNC_RECOVER_CHECKS     5
+// checks to wait after slowing down before slowing down again, to give
+//    queues time to drain
+#define UDP_SYNC_SETTLE_CHECKS      3
+// frame interval is multiplied by SLOWDOWN when overloaded and divided
+//    by SPEEDUP when load is low
+#define UDP_SYNC_SLOWDOWN           1.25
+#define UDP_SYNC_SPEEDUP            1.10
+// how often requested and effective frame rates are logged
+#define UDP_SYNC_RATE_REPORT_SEC    60.0
+
+// default frame rate bounds
+#define UDP_SYNC_MIN_FPS_DEFAULT    ((double) CAMERA_FPS / 2.0)
+#define UDP_SYNC_MAX_FPS_DEFAULT    ((double) CAMERA_FPS)
+
 struct udp_sync_class {
    // networking
    int sockfd;
    struct sockaddr_in sock_addr;
    // used by clock_nanosleep -- stores time of next udp ping
    struct timespec bcast_time;
+   // frame interval presently requested from cameras
+   double frame_interval;
+   // load checks since last slowdown, and number of consecutive checks
+   //    where load was low
+   uint32_t settle_checks;
+   uint32_t calm_checks;
+   // for reporting effective frame rate
+   uint64_t frames_at_report;
+   double rate_report_sec;
 };
 
 // thread entry point
@@ -57,5 +91,13 @@ void * udp_sync_class_init(void *);
 
 void send_sync_packet(uint32_t type);
 
+// sets range that camera frame rate can be adjusted within. returns 0
+//    on success and -1 if bounds are invalid. max cannot exceed
+//    CAMERA_FPS
+int32_t set_udp_sync_frame_rate_bounds(
+      /* in     */ const double min_fps,
+      /* in     */ const double max_fps
+      );
+
 #endif   // UDP_SYNC_H
 
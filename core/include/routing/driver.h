@@ -165,6 +165,8 @@ struct driver_class {
    // maps and planning
    path_map_type *path_map;
    route_map_type *route_map;
+   // sample time of position that path map was last traced from
+   double path_map_position_sec;
    /////////////////////////////////////////////
    // control flags
    union {
@@ -236,6 +238,9 @@ struct driver_class {
    producer_record_type *attitude;
    attitude_output_type attitude_latest;
    double attitude_sec;
+   // when attitude published the latest sample and when driver read it
+   double attitude_publish_sec;
+   double attitude_fetch_sec;
    degree_per_second_type turn_rate;
 };
 typedef struct driver_class driver_class_type;
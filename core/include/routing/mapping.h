@@ -186,6 +186,20 @@ typedef struct target_record_export target_record_export_type;
 //    should take to reach destination
 #define VESSEL_OFFSET_FROM_MAP_CENTER_NM     10.0
 
+// when map center moves by no more than this many nodes on each axis,
+//    existing map content is shifted and only the newly exposed strips
+//    are loaded (see recenter_world_5sec_map())
+#define MAP_RECENTER_MAX_SHIFT_NODES      240
+
+// shifting map content east-west is approximate as the width of a node,
+//    in degrees, varies with latitude. a full load is forced when the
+//    estimated position error at the map's top/bottom edge reaches this
+#define MAP_RECENTER_MAX_DRIFT_NODES      1.0
+
+// declination is reread when map center moves this far from where it
+//    was last read
+#define DECLINATION_RELOAD_DEG      0.25
+
 // if beacon is w/in this distance of vessel, don't include it in map
 // this should be larger than
 #define VESSEL_BEACON_INHIBITION_RING_NM     4.0
@@ -228,6 +242,8 @@ typedef union path_map_index path_map_index_type;
 
 #define PATH_NODE_FLAG_PROCESSED   1
 #define PATH_NODE_FLAG_NO_ACCESS   2
+// node's weight or parent changed during replan
+#define PATH_NODE_FLAG_TOUCHED     4
 
 // each node has a path vector (beyond adjacent parent) indicating its
 //    approximate trajectory
@@ -267,6 +283,22 @@ struct map_beacon_reference {
 typedef struct map_beacon_reference map_beacon_reference_type;
 
 
+// seed location for path trace (destination or beacon) and its weight
+struct path_seed {
+   image_coordinate_type pos;
+   float weight;
+};
+typedef struct path_seed path_seed_type;
+
+// cost of most recent path trace
+struct path_trace_stats {
+   double elapsed_sec;
+   // nodes pulled from stack plus nodes invalidated during replan
+   uint32_t nodes_touched;
+};
+typedef struct path_trace_stats path_trace_stats_type;
+
+
 struct path_map {
    // TODO reformat after path and world map merge
    /////////////////////////////////////////////
@@ -305,9 +337,39 @@ struct path_map {
    // path is updated when vessel has moved more than X nm from
    //    point when map was last updated
    image_coordinate_type   vessel_start_pix;
+   // vessel position when path was last traced or replanned
+   image_coordinate_type   vessel_plan_pix;
    // destination may be outside of map bounds.
    akn_position_type    destination;   // no index and zero weight
    image_coordinate_type    dest_pix;  // display coord in map
+   /////////////////////////////////////////////////////////////////////
+   // map recentering
+   // non-zero once map has been loaded
+   uint32_t map_loaded;
+   // map center when declination was last read
+   world_coordinate_type declination_center;
+   // estimated max position error, in nodes, from map content that's
+   //    been shifted instead of reloaded
+   double recenter_drift_nodes;
+   // incremented whenever feature nodes change (map loaded or moved, or
+   //    costs updated), so that values derived from features and cached
+   //    elsewhere (e.g., route terrain scores) can be refreshed
+   uint32_t feature_generation;
+   /////////////////////////////////////////////////////////////////////
+   // incremental replanning
+   // non-zero when nodes hold a complete trace of the present map
+   //    content. cleared when map is loaded or moved
+   uint32_t trace_valid;
+   // seeds used for the present trace. these are diffed against the
+   //    seeds on replan
+   uint32_t num_seeds;
+   path_seed_type seeds[MAX_PATH_MAP_BEACONS + 1];
+   // nodes invalidated or updated since last trace. course vectors are
+   //    rebuilt for these and their near descendants
+   path_map_index_type *touched;
+   uint32_t num_touched;
+   path_trace_stats_type full_trace_stats;
+   path_trace_stats_type replan_stats;
 };
 typedef struct path_map path_map_type;
 
@@ -477,9 +539,6 @@ struct route_map_node {
    uint32_t world_node_idx;
    //
    double terrain_score;
-   // time required to reach and exit this node
-   double arrival_dt_sec;
-   double exit_dt_sec;
 };
 typedef struct route_map_node route_map_node_type;
 
@@ -605,6 +664,15 @@ void load_world_5sec_map(
       /*    out */       path_map_type *path_map
       );
 
+// moves map so it's centered at map_center. if map is already loaded and
+//    the move is small, existing content is shifted and only newly exposed
+//    strips are loaded. otherwise the full map is loaded. center may be
+//    snapped slightly so map content shifts by whole nodes
+void recenter_world_5sec_map(
+      /* in     */ const world_coordinate_type map_center,
+      /* in out */       path_map_type *path_map
+      );
+
 
 ////////////////////////////////////////////////////////////////////////
 
@@ -681,6 +749,28 @@ void trace_route_simple(
       /* in     */ const world_coordinate_type vessel_pos
       );
 
+// updates existing trace for changes in vessel position (which beacons
+//    are inhibited), beacon list and destination weight, and for node
+//    costs changed by update_path_costs(). only the parts of the trace
+//    that depend on what changed are recomputed. result is the same
+//    as from trace_route_simple(), which is called instead if there's no
+//    valid trace or the destination pixel moved
+// returns number of nodes touched
+uint32_t replan_route(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const world_coordinate_type vessel_pos
+      );
+
+// recomputes traversal cost of nodes in [top_left, bottom_right) after
+//    their feature nodes changed and invalidates the parts of the trace
+//    that depend on them. call replan_route() afterward to repair the
+//    trace
+void update_path_costs(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const image_coordinate_type top_left,
+      /* in     */ const image_coordinate_type bottom_right
+      );
+
 ////////////////////////////////////////////////////////////////////////
 
 // get and set full path to map folder
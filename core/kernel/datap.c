@@ -25,6 +25,7 @@
 #include <bits/syscall.h>
 #include "datap.h"
 #include "logger.h"
+#include "timekeeper.h"
 
 uint32_t num_threads_g = 0;
 
@@ -32,6 +33,24 @@ datap_desc_type *processor_list_g[MAX_PROCESSORS];
 thread_desc_type thread_table_g[MAX_PROCESSORS];
 
 
+// allocates publish time for each queue element, alongside ts[].
+//    processors without a queue don't track publish time
+static void init_publish_times(
+      /* in out */       datap_desc_type *dp
+      )
+{
+   if ((dp->queue_length == 0) || (dp->ts == NULL)) {
+      return;
+   }
+   dp->publish_ts = malloc(dp->queue_length * sizeof *dp->publish_ts);
+   for (uint32_t i=0; i<dp->queue_length; i++) {
+      dp->publish_ts[i] = -1.0;
+   }
+   latency_reset(&dp->publish_age);
+   dp->publish_age_report_sec = now();
+}
+
+
 // thread entry function provided by each data processor
 // each entry function should call dp_execute() when it's done
 //    initializing the processor
@@ -60,6 +79,9 @@ void dp_execute(
    if (dp->pre_run) {
       dp->pre_run(dp);
    }
+   // queue is created by now. publish times are allocated here, before
+   //    the barrier, so consumers never see publish_ts change
+   init_publish_times(dp);
    pthread_barrier_wait(&barrier_g); // --------------------------------
    if (dp->run) {
       dp->run(dp);
@@ -196,8 +218,50 @@ datap_desc_type * dp_create()
    return dp;
 }
 
+// stores publish time of elements produced since last signal and
+//    tallies their age. periodically reports age percentiles
+static void stamp_published_elements(
+      /* in out */       datap_desc_type *dp
+      )
+{
+   if (dp->publish_ts == NULL) {
+      return;
+   }
+   const double t = now();
+   // elements that were overwritten before being signaled are skipped
+   if ((dp->elements_produced - dp->elements_stamped) > dp->queue_length) {
+      dp->elements_stamped = dp->elements_produced - dp->queue_length;
+   }
+   while (dp->elements_stamped < dp->elements_produced) {
+      const uint32_t idx =
+            (uint32_t) (dp->elements_stamped % dp->queue_length);
+      dp->publish_ts[idx] = t;
+      latency_add(&dp->publish_age, t - dp->ts[idx]);
+      dp->elements_stamped++;
+   }
+   if ((t - dp->publish_age_report_sec) >= DP_LATENCY_REPORT_SEC) {
+      char label[STR_LEN];
+      snprintf(label, STR_LEN, "%s publish", dp->td->obj_name);
+      log_latency_summary(get_kernel_log(), &dp->publish_age, label);
+      latency_reset(&dp->publish_age);
+      dp->publish_age_report_sec = t;
+   }
+}
+
+double dp_get_publish_time_at(
+      /* in     */ const datap_desc_type *dp,
+      /* in     */ const uint32_t idx
+      )
+{
+   if (dp->publish_ts == NULL) {
+      return -1.0;
+   }
+   return dp->publish_ts[idx];
+}
+
 void dp_signal_data_available(datap_desc_type *src)
 {
+   stamp_published_elements(src);
    if (src->update_interval >= 0) {
       if (++src->update_ctr >= src->update_interval) {
          src->update_ctr = 0;
@@ -19,6 +19,7 @@
 #include "script_iface.h"
 #include "routing/driver.h"
 #include "dev_info.h"
+#include "pinet_reactor.h"
 
 struct datap_desc * find_source(const char *str)
 {
@@ -182,6 +183,71 @@ static int32_t create_udp_sync(lua_State *L)
    return 0;
 }
 
+// camera frame rate is adjusted within these bounds according to load
+//    on the vision pipeline
+static int32_t set_frame_rate_bounds(lua_State *L)
+{
+   int32_t argc = lua_gettop(L);
+   if (argc != 2)
+   {
+      fprintf(stderr, "Lua syntax error\n");
+      fprintf(stderr, "%s requires 2 arguments\n", __func__);
+      fprintf(stderr, "arg1 is minimum frame rate (fps)\n");
+      fprintf(stderr, "arg2 is maximum frame rate (fps, up to %d)\n",
+            CAMERA_FPS);
+      fprintf(stderr, "encountered: %s(", __func__);
+      for (int32_t i=1; i<=argc; i++)
+         fprintf(stderr, "%s%s", lua_tostring(L, i), i==argc?"":", ");
+      fprintf(stderr, ")\n");
+      errs_++;
+      return 1;
+   }
+   const char * str1 = get_string(L, __func__, 1);
+   const char * str2 = get_string(L, __func__, 2);
+   if (set_udp_sync_frame_rate_bounds(atof(str1), atof(str2)) != 0) {
+      fprintf(stderr, "%s: invalid frame rate bounds %s, %s\n", __func__,
+            str1, str2);
+      errs_++;
+      return 1;
+   }
+   return 0;
+}
+
+// sensor connections (imu, gps, camera) are read by the network reactor
+//    instead of by each receiver thread. must be called before receivers
+//    are created
+static int32_t set_network_reactor(lua_State *L)
+{
+   int32_t argc = lua_gettop(L);
+   if (argc != 1)
+   {
+      fprintf(stderr, "Lua syntax error\n");
+      fprintf(stderr, "%s requires 1 argument\n", __func__);
+      fprintf(stderr, "arg1 is number of reactor threads (1 to %d)\n",
+            PINET_REACTOR_MAX_LOOPS);
+      fprintf(stderr, "encountered: %s(", __func__);
+      for (int32_t i=1; i<=argc; i++)
+         fprintf(stderr, "%s%s", lua_tostring(L, i), i==argc?"":", ");
+      fprintf(stderr, ")\n");
+      errs_++;
+      return 1;
+   }
+   const char * str1 = get_string(L, __func__, 1);
+   int32_t num_loops = atoi(str1);
+   if ((num_loops < 1) || (num_loops > PINET_REACTOR_MAX_LOOPS)) {
+      fprintf(stderr, "%s: number of threads must be between 1 and %d, "
+            "not %s\n", __func__, PINET_REACTOR_MAX_LOOPS, str1);
+      errs_++;
+      return 1;
+   }
+   if (start_pinet_reactor((uint32_t) num_loops) != 0) {
+      fprintf(stderr, "%s: unable to start network reactor\n", __func__);
+      errs_++;
+      return 1;
+   }
+   return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
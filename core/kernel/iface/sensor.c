@@ -52,6 +52,40 @@ static int32_t create_attitude(lua_State *L)
 }
 
 
+static int32_t set_attitude_history_(lua_State *L)
+{
+   int32_t argc = lua_gettop(L);
+   if (argc != 2)
+   {
+      fprintf(stderr, "Lua syntax error\n");
+      fprintf(stderr, "%s requires 2 arguments\n", __func__);
+      fprintf(stderr, "arg1 is attitude module name\n");
+      fprintf(stderr, "arg2 is duration of gyro data to keep (ms)\n");
+      fprintf(stderr, "encountered: %s(", __func__);
+      for (int32_t i=1; i<=argc; i++)
+         fprintf(stderr, "%s%s", lua_tostring(L, i), i==argc?"":", ");
+      fprintf(stderr, ")\n");
+      errs_++;
+      return 1;
+   }
+   const char * att = get_string(L, __func__, 1);
+   datap_desc_type *att_dp = find_source(att);
+   int64_t history_ms = (int64_t) lua_tointeger(L, 2);
+   if (history_ms <= 0) {
+      fprintf(stderr, "Configuration error\n");
+      fprintf(stderr, "History duration must be positive\n");
+      fprintf(stderr, "encountered: %s(", __func__);
+      for (int32_t i=1; i<=argc; i++)
+         fprintf(stderr, "%s%s", lua_tostring(L, i), i==argc?"":", ");
+      fprintf(stderr, ")\n");
+      errs_++;
+      return 1;
+   }
+   set_attitude_history(att_dp, (uint32_t) history_ms);
+   return 0;
+}
+
+
 static int32_t set_imu_priority_(lua_State *L)
 {
    int32_t argc = lua_gettop(L);
@@ -100,6 +134,42 @@ static int32_t set_imu_priority_(lua_State *L)
    return 0;
 }
 
+
+static int32_t set_imu_batch_(lua_State *L)
+{
+   int32_t argc = lua_gettop(L);
+   if (argc != 3)
+   {
+      fprintf(stderr, "Lua syntax error\n");
+      fprintf(stderr, "%s requires 3 arguments\n", __func__);
+      fprintf(stderr, "arg1 is imu module name\n");
+      fprintf(stderr, "arg2 is max samples per batch (0 to disable)\n");
+      fprintf(stderr, "arg3 is max batch latency (ms)\n");
+      fprintf(stderr, "encountered: %s(", __func__);
+      for (int32_t i=1; i<=argc; i++)
+         fprintf(stderr, "%s%s", lua_tostring(L, i), i==argc?"":", ");
+      fprintf(stderr, ")\n");
+      errs_++;
+      return 1;
+   }
+   const char * imu = get_string(L, __func__, 1);
+   datap_desc_type *imu_prod = find_source(imu);
+   int64_t samples = (int64_t) lua_tointeger(L, 2);
+   int64_t latency_ms = (int64_t) lua_tointeger(L, 3);
+   if ((samples < 0) || (latency_ms < 0)) {
+      fprintf(stderr, "Configuration error\n");
+      fprintf(stderr, "Batch size and latency must be non-negative\n");
+      fprintf(stderr, "encountered: %s(", __func__);
+      for (int32_t i=1; i<=argc; i++)
+         fprintf(stderr, "%s%s", lua_tostring(L, i), i==argc?"":", ");
+      fprintf(stderr, ")\n");
+      errs_++;
+      return 1;
+   }
+   set_imu_batch(imu_prod, (uint32_t) samples, (uint32_t) latency_ms);
+   return 0;
+}
+
 // attitude
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -268,7 +338,8 @@ static int32_t create_panorama(lua_State *L)
       fprintf(stderr, "Lua syntax error\n");
       fprintf(stderr, "%s requires 6 arguments\n", __func__);
       fprintf(stderr, "arg1 is object name (e.g., 'panorama')\n");
-      fprintf(stderr, "arg2 is logging indicator ('log', 'no-log')\n");
+      fprintf(stderr, "arg2 is logging indicator ('log', 'no-log', "
+            "'log-indexed')\n");
       fprintf(stderr, "arg3 is output mode ('gray', 'color')\n");
       fprintf(stderr, "arg4 is height of camera above water, in meters\n");
       fprintf(stderr, "arg5 is distance of camera forward of ship's "
@@ -289,7 +360,12 @@ static int32_t create_panorama(lua_State *L)
    const char * str5 = get_string(L, __func__, 5);
    const char * str6 = get_string(L, __func__, 6);
    panorama_setup_type *pan_setup = malloc(sizeof *pan_setup);
-   pan_setup->logging = determine_logging_state(str2);
+   // panorama supports an indexed log in addition to standard logging
+   if (strcmp(str2, "log-indexed") == 0) {
+      pan_setup->logging = PAN_LOGGING_INDEXED;
+   } else {
+      pan_setup->logging = determine_logging_state(str2);
+   }
    pan_setup->output_type = determine_color_state(str3);
    pan_setup->camera_height_meters.meters = atof(str4);
    if (pan_setup->camera_height_meters.meters <= 0.1) {
@@ -27,6 +27,7 @@
 #include "datap.h"
 #include "pinet.h"
 #include "postmaster.h"
+#include "telemetry.h"
 #include "udp_sync.h"
 #include "logger.h"
 
@@ -47,6 +48,7 @@ printf("*** signal_exit\n"); fflush(stdout);
    if (x == SIGALRM)
       printf("\tSIGALRM\n");
    postmaster_quit(0);
+   telemetry_quit(0);
    if (processor_list_ != NULL) {
       // set each thread's quit flag
       for (uint32_t i=0; i<num_threads_g; i++)
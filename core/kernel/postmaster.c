@@ -22,14 +22,17 @@
 #include <assert.h>
 #include <signal.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include "kernel.h"
 #include "logger.h"
 #include "mem.h"
 #include "timekeeper.h"
+#include "latency.h"
 #include "udp_sync.h"
 #include "dev_info.h"
 #include "routing/driver.h"
@@ -42,6 +45,80 @@ static int sockfd_ = -1;
 
 static log_info_type *log_ = NULL;
 
+// clients connect and keep the connection open for as long as they like,
+//    sending requests whenever. requests can be pipelined -- responses
+//    are sent in the order requests were received. all sockets are
+//    non-blocking and serviced from an epoll loop so a slow or stalled
+//    client can't hold up others
+
+// maximum number of simultaneous clients. connections above this are
+//    closed as soon as they're accepted
+#define PM_MAX_CLIENTS           16
+// maximum number of requests from one client waiting to be handled or
+//    to have their response sent. when full, nothing more is read from
+//    that client until responses go out
+#define PM_CLIENT_QUEUE_LEN      8
+// request header is 5 4-byte fields, response is 5 plus 32-byte time
+#define PM_REQUEST_BYTES         20
+#define PM_RESPONSE_BYTES        52
+// clients sending larger requests are disconnected
+#define PM_MAX_PAYLOAD_BYTES     4096
+// status requests handled each pass through event loop, so a burst of
+//    status queries can't delay commands that arrive in the meantime.
+//    commands (heading, destination, autopilot, shutdown) are always
+//    handled first
+#define PM_STATUS_PER_PASS       4
+#define PM_EPOLL_TIMEOUT_MSEC    250
+#define PM_MAX_EVENTS            (PM_MAX_CLIENTS + 1)
+// how often request timing is written to log
+#define PM_TIMING_REPORT_SEC     60.0
+
+// epoll tag for listening socket. clients are tagged by slot index
+#define PM_LISTEN_TAG            0xffffffffu
+
+struct pm_queued_request {
+   struct pm_request req;
+   uint8_t *data;
+   struct pm_response resp;
+   double received_sec;
+   uint8_t handled;
+};
+typedef struct pm_queued_request pm_queued_request_type;
+
+struct pm_client {
+   int fd;     // -1 if slot is unused
+   uint32_t id;   // connection number, for log
+   // request being received
+   uint8_t header[PM_REQUEST_BYTES];
+   uint32_t header_len;
+   struct pm_request req;
+   uint8_t *payload;
+   uint32_t payload_len;
+   // requests in order of arrival. head is oldest
+   pm_queued_request_type queue[PM_CLIENT_QUEUE_LEN];
+   uint32_t queue_head;
+   uint32_t queue_count;
+   // encoded responses waiting to be written
+   uint8_t out[PM_CLIENT_QUEUE_LEN * PM_RESPONSE_BYTES];
+   uint32_t out_len;
+   uint32_t out_sent;
+   // events client is presently registered for
+   uint32_t events;
+};
+typedef struct pm_client pm_client_type;
+
+static pm_client_type clients_[PM_MAX_CLIENTS];
+static uint32_t num_connections_ = 0;
+
+static int epoll_fd_ = -1;
+
+// time from when request is received until it's handled, and until
+//    response is sent, for commands [0] and status requests [1]
+enum { PM_CLASS_COMMAND, PM_CLASS_STATUS, PM_NUM_CLASSES };
+static latency_stats_type request_wait_[PM_NUM_CLASSES];
+static latency_stats_type request_total_[PM_NUM_CLASSES];
+static double timing_report_sec_ = -1.0;
+
 enum postmaster_state get_postmaster_state(void)
 {
    return postmaster_;
@@ -83,10 +160,18 @@ static int setup_networking(void)
    port_num_ = (int16_t) atoi(buf);
 printf("postmaster on localhost port %d\n", port_num_);
    //
-   if ((sockfd_ = init_server_backlog(port_num_, 0)) < 0) {
+   if ((sockfd_ = init_server_backlog(port_num_, PM_MAX_CLIENTS)) < 0) {
       log_err(log_, "Failed to initialize server for postmaster");
       goto err;
    }
+   int flags = fcntl(sockfd_, F_GETFL, 0);
+   if ((flags < 0) || (fcntl(sockfd_, F_SETFL, flags | O_NONBLOCK) < 0)) {
+      log_err(log_, "Failed to make postmaster socket non-blocking: %s",
+            strerror(errno));
+      close(sockfd_);
+      sockfd_ = -1;
+      goto err;
+   }
 //// protocol
 //   if (check_protocol_version(sockfd_, COMMUNICATION_PROTOCOL_MAJOR, COMMUNICATION_PROTOCOL_MINOR) < 0) {
 //      log_err(log_, "Failed to initialize server for postmaster (protocol)");
@@ -104,130 +189,67 @@ int16_t get_postmaster_port(void)
 }
 
 
-// TODO investigate and document -- data field looks to use cached
-//    memory. document how data is used and freed, and if it has to
-//    be cached
-static int read_request(
-      /* in     */ const int connfd,
-      /*    out */       struct pm_request *req,
-      /*    out */       uint8_t **data
+// returns value of 4-byte network-order field at offset
+static uint32_t decode_field(
+      /* in     */ const uint8_t *buf,
+      /* in     */ const uint32_t offset
       )
 {
-printf("Reading request\n");
-   // receive each field from pm_request in the order that it's defined
    uint32_t val;
-   req->request_type = 0;
-   // read fields one-by-one
-   if (recv_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   req->request_type = htonl(val);
-   //
-   if (recv_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   req->header_bytes = htonl(val);
-   //
-   if (recv_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   req->custom_0 = (int32_t) htonl(val);
-   //
-   if (recv_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   req->custom_1 = (int32_t) htonl(val);
-   //
-   if (recv_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   req->custom_2 = (int32_t) htonl(val);
-   //
-   if (req->header_bytes > 0) {
-      *data = cache_malloc(pool_, req->header_bytes);
-      if (recv_block(connfd, *data, req->header_bytes) !=
-            (int32_t) req->header_bytes) {
-         log_err(log_, "Problem reading request data (%d bytes)",
-               req->header_bytes);
-         goto err;
-      }
-   }
-   return 0;
-err:
-   log_err(log_, "Error reading PM request packet (reported type is %d)",
-         req->request_type);
-   return -1;
+   memcpy(&val, &buf[offset], sizeof val);
+   return ntohl(val);
 }
 
-static int send_response(
-      /* in     */ const int connfd,
-      /* in     */ const struct pm_request *req,
+static void encode_field(
+      /*    out */       uint8_t *buf,
+      /* in     */ const uint32_t offset,
+      /* in     */ const uint32_t val
+      )
+{
+   const uint32_t net = htonl(val);
+   memcpy(&buf[offset], &net, sizeof net);
+}
+
+// unpack request header. fields are in the order that they're defined
+//    in pm_request
+static void decode_request(
+      /* in     */ const uint8_t *buf,
+      /*    out */       struct pm_request *req
+      )
+{
+   req->request_type = decode_field(buf, 0);
+   req->header_bytes = decode_field(buf, 4);
+   req->custom_0 = (int32_t) decode_field(buf, 8);
+   req->custom_1 = (int32_t) decode_field(buf, 12);
+   req->custom_2 = (int32_t) decode_field(buf, 16);
+}
+
+// pack response. fields are in the order that they're defined in
+//    pm_response. time is when response is packed
+static void encode_response(
       /* in     */ const struct pm_response *resp,
-      /* in     */ const void * data
+      /*    out */       uint8_t *buf
       )
 {
-   // send each field from pm_response in the order that it's listed
-   uint32_t val;
    uint32_t T_BUF_LEN = 32u;
-   char str[T_BUF_LEN];
-   val = htonl(resp->request_type);
-   if (send_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   //
-   val = htonl(resp->response_bytes);
-   if (send_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   //
+   encode_field(buf, 0, resp->request_type);
+   encode_field(buf, 4, resp->response_bytes);
+   char *str = (char*) &buf[8];
    memset(str, 0, T_BUF_LEN);
    snprintf(str, T_BUF_LEN, "%.20e", now());
-   if (send_block(connfd, str, T_BUF_LEN) < 0) {
-      goto err;
-   }
-   //
-   val = htonl((uint32_t) resp->custom_0);
-   if (send_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   //
-   val = htonl((uint32_t) resp->custom_1);
-   if (send_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   //
-   val = htonl((uint32_t) resp->custom_2);
-   if (send_block(connfd, &val, sizeof(val)) < 0) {
-      goto err;
-   }
-   //
-   if (resp->response_bytes > 0) {
-      if (send_block(connfd, data, resp->response_bytes) !=
-            (int32_t) resp->response_bytes) {
-         log_err(log_, "Problem sending response data (%d bytes)",
-               resp->response_bytes);
-         goto err;
-      }
-   }
-   return 0;
-err:
-   log_err(log_, "Error sending PM response packet (type = %d)",
-         req->request_type);
-   return -1;
+   encode_field(buf, 8 + T_BUF_LEN, (uint32_t) resp->custom_0);
+   encode_field(buf, 12 + T_BUF_LEN, (uint32_t) resp->custom_1);
+   encode_field(buf, 16 + T_BUF_LEN, (uint32_t) resp->custom_2);
 }
 
 static void forward_request(
       /* in     */ const struct pm_request *req,
       /* in     */ const uint8_t *req_data,
-      /* in out */       struct pm_response *resp,
-      /* in out */       uint8_t **content
+      /* in out */       struct pm_response *resp
       )
 {
-   (void) req;
-   (void) resp;
    // assume success
    resp->request_type = req->request_type;
-   *content = NULL;
 printf("Request type: %d\n", req->request_type);
    switch (req->request_type) {
       case PM_CMD_NULL:
@@ -309,47 +331,389 @@ printf("CMD OTTO SET_DESTINATION\n");
    };
 }
 
-static void handle_messages(void)
+// commands that change what the vessel is doing are handled before
+//    status queries
+static uint32_t request_class(
+      /* in     */ const uint32_t request_type
+      )
 {
-   int connfd = -1;;
-   struct pm_request req;
-   struct pm_response resp;
-   memset(&resp, 0, sizeof(resp));
-   uint8_t *req_data, *resp_data;
-   while (postmaster_ == RUNNING) {
-      if ((connfd = wait_for_connection(sockfd_, "postmaster")) < 0) {
-         perror("Connection aborted during postmaster accept");
+   switch (request_type) {
+      case PM_CMD_SHUTDOWN:
+      case PM_CMD_AUTOPILOT_ON:
+      case PM_CMD_AUTOPILOT_OFF:
+      case PM_CMD_SET_HEADING:
+      case PM_CMD_SET_DESTINATION:
+         return PM_CLASS_COMMAND;
+      default:
+         return PM_CLASS_STATUS;
+   }
+}
+
+static void set_client_events(
+      /* in out */       pm_client_type *client,
+      /* in     */ const uint32_t slot
+      )
+{
+   uint32_t events = 0;
+   if (client->queue_count < PM_CLIENT_QUEUE_LEN) {
+      events |= EPOLLIN;
+   }
+   if (client->out_sent < client->out_len) {
+      events |= EPOLLOUT;
+   }
+   if (events != client->events) {
+      struct epoll_event ev = { .events = events, .data.u32 = slot };
+      if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client->fd, &ev) != 0) {
+         log_err(log_, "Postmaster failed to update events for "
+               "connection %d: %s", client->id, strerror(errno));
+      }
+      client->events = events;
+   }
+}
+
+static void close_client(
+      /* in out */       pm_client_type *client
+      )
+{
+   epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client->fd, NULL);
+   close(client->fd);
+   client->fd = -1;
+   if (client->payload) {
+      cache_free(pool_, client->payload);
+      client->payload = NULL;
+   }
+   for (uint32_t i=0; i<client->queue_count; i++) {
+      pm_queued_request_type *q = &client->queue[
+            (client->queue_head + i) % PM_CLIENT_QUEUE_LEN];
+      if (q->data) {
+         cache_free(pool_, q->data);
+         q->data = NULL;
+      }
+   }
+   client->queue_count = 0;
+}
+
+static void accept_clients(
+      /* in     */ const int listen_fd
+      )
+{
+   int connfd;
+   while ((connfd = accept4(listen_fd, NULL, NULL,
+         SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+      uint32_t slot = PM_MAX_CLIENTS;
+      for (uint32_t i=0; i<PM_MAX_CLIENTS; i++) {
+         if (clients_[i].fd < 0) {
+            slot = i;
+            break;
+         }
+      }
+      if (slot == PM_MAX_CLIENTS) {
+         log_err(log_, "Postmaster has too many connections. Dropping "
+               "new one");
+         close(connfd);
          continue;
       }
-      // read request packet
-      req_data = NULL;
-      if (read_request(connfd, &req, &req_data) < 0) {
-         log_err(log_, "Postmaster failed reading request packet");
+      pm_client_type *client = &clients_[slot];
+      memset(client, 0, sizeof *client);
+      client->fd = connfd;
+      client->id = num_connections_++;
+      client->events = EPOLLIN;
+      struct epoll_event ev = { .events = EPOLLIN, .data.u32 = slot };
+      if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, connfd, &ev) != 0) {
+         log_err(log_, "Postmaster failed to add connection: %s",
+               strerror(errno));
          close(connfd);
+         client->fd = -1;
+      }
+   }
+   if ((errno != EAGAIN) && (errno != EINTR)) {
+      log_err(log_, "Postmaster accept failed: %s", strerror(errno));
+   }
+}
+
+// adds completely received request to client's queue
+static void enqueue_request(
+      /* in out */       pm_client_type *client
+      )
+{
+   pm_queued_request_type *q = &client->queue[
+         (client->queue_head + client->queue_count) % PM_CLIENT_QUEUE_LEN];
+   q->req = client->req;
+   q->data = client->payload;
+   q->received_sec = now();
+   q->handled = 0;
+   client->queue_count++;
+   client->payload = NULL;
+   client->payload_len = 0;
+   client->header_len = 0;
+}
+
+// reads as many requests as are available and there's room for
+// returns 0 on success and -1 if connection should be closed
+static int32_t read_requests(
+      /* in out */       pm_client_type *client
+      )
+{
+   while (client->queue_count < PM_CLIENT_QUEUE_LEN) {
+      ssize_t n;
+      if (client->header_len < PM_REQUEST_BYTES) {
+         n = recv(client->fd, &client->header[client->header_len],
+               PM_REQUEST_BYTES - client->header_len, 0);
+      } else {
+         n = recv(client->fd, &client->payload[client->payload_len],
+               client->req.header_bytes - client->payload_len, 0);
+      }
+      if (n == 0) {
+         // client closed connection. this is the normal end of a
+         //    connection, unless part of a request was sent
+         if ((client->header_len > 0) || (client->payload_len > 0)) {
+            log_err(log_, "Connection %d closed mid-request", client->id);
+         }
+         return -1;
+      } else if (n < 0) {
+         if (errno == EAGAIN) {
+            break;
+         } else if (errno == EINTR) {
+            continue;
+         }
+         log_err(log_, "Error reading from connection %d: %s", client->id,
+               strerror(errno));
+         return -1;
+      }
+      if (client->header_len < PM_REQUEST_BYTES) {
+         client->header_len += (uint32_t) n;
+         if (client->header_len < PM_REQUEST_BYTES) {
+            continue;
+         }
+         decode_request(client->header, &client->req);
+         if (client->req.header_bytes > PM_MAX_PAYLOAD_BYTES) {
+            log_err(log_, "Request on connection %d has %d bytes of data "
+                  "(max %d). Closing connection", client->id,
+                  client->req.header_bytes, PM_MAX_PAYLOAD_BYTES);
+            return -1;
+         }
+         if (client->req.header_bytes > 0) {
+            // data is treated as a string by some requests. make sure
+            //    it's terminated
+            client->payload = cache_malloc(pool_,
+                  client->req.header_bytes + 1);
+            client->payload[client->req.header_bytes] = 0;
+            continue;
+         }
+      } else {
+         client->payload_len += (uint32_t) n;
+         if (client->payload_len < client->req.header_bytes) {
+            continue;
+         }
+      }
+      enqueue_request(client);
+   }
+   return 0;
+}
+
+static void handle_request(
+      /* in out */       pm_queued_request_type *q
+      )
+{
+   memset(&q->resp, 0, sizeof q->resp);
+   forward_request(&q->req, q->data, &q->resp);
+   if (q->data) {
+      cache_free(pool_, q->data);
+      q->data = NULL;
+   }
+   q->handled = 1;
+   latency_add(&request_wait_[request_class(q->req.request_type)],
+         now() - q->received_sec);
+}
+
+// handles queued requests of given class, up to max number. returns
+//    number handled
+static uint32_t handle_requests_of_class(
+      /* in     */ const uint32_t req_class,
+      /* in     */ const uint32_t max_requests
+      )
+{
+   uint32_t num_handled = 0;
+   for (uint32_t i=0; i<PM_MAX_CLIENTS; i++) {
+      pm_client_type *client = &clients_[i];
+      if (client->fd < 0) {
          continue;
       }
-      // handle request
-      resp_data = NULL;
-      memset(&resp, 0, sizeof(resp));
-      forward_request(&req, req_data, &resp, &resp_data);
-      if (req_data) {
-         cache_free(pool_, req_data);
+      for (uint32_t j=0; j<client->queue_count; j++) {
+         if (num_handled >= max_requests) {
+            goto end;
+         }
+         pm_queued_request_type *q = &client->queue[
+               (client->queue_head + j) % PM_CLIENT_QUEUE_LEN];
+         if ((q->handled == 0) &&
+               (request_class(q->req.request_type) == req_class)) {
+            handle_request(q);
+            num_handled++;
+         }
+      }
+   }
+end:
+   return num_handled;
+}
+
+// packs responses to handled requests, in order of arrival, and sends
+//    as much as socket will take
+// returns 0 on success and -1 if connection should be closed
+static int32_t send_responses(
+      /* in out */       pm_client_type *client
+      )
+{
+   if (client->out_sent > 0) {
+      memmove(client->out, &client->out[client->out_sent],
+            client->out_len - client->out_sent);
+      client->out_len -= client->out_sent;
+      client->out_sent = 0;
+   }
+   while ((client->queue_count > 0) &&
+         ((client->out_len + PM_RESPONSE_BYTES) <= sizeof client->out)) {
+      pm_queued_request_type *q = &client->queue[client->queue_head];
+      if (q->handled == 0) {
+         break;
+      }
+      encode_response(&q->resp, &client->out[client->out_len]);
+      client->out_len += PM_RESPONSE_BYTES;
+      latency_add(&request_total_[request_class(q->req.request_type)],
+            now() - q->received_sec);
+      client->queue_head = (client->queue_head + 1) % PM_CLIENT_QUEUE_LEN;
+      client->queue_count--;
+   }
+   while (client->out_sent < client->out_len) {
+      ssize_t n = send(client->fd, &client->out[client->out_sent],
+            client->out_len - client->out_sent, MSG_NOSIGNAL);
+      if (n < 0) {
+         if (errno == EAGAIN) {
+            break;
+         } else if (errno == EINTR) {
+            continue;
+         }
+         log_err(log_, "Error sending to connection %d: %s", client->id,
+               strerror(errno));
+         return -1;
       }
-      // send response
-      // don't worry about error code, as we're not going to do anything
-      //    on a send failure other than close the connection, and it's
-      //    going to be closed anyway
-      send_response(connfd, &req, &resp, resp_data);
-      if (resp_data) {
-         cache_free(pool_, resp_data);
+      client->out_sent += (uint32_t) n;
+   }
+   return 0;
+}
+
+static void report_request_timing(void)
+{
+   const double t = now();
+   if (timing_report_sec_ < 0.0) {
+      timing_report_sec_ = t;
+      return;
+   }
+   if ((t - timing_report_sec_) < PM_TIMING_REPORT_SEC) {
+      return;
+   }
+   const char *labels[PM_NUM_CLASSES][2] = {
+      { "pm command wait", "pm command total" },
+      { "pm status wait", "pm status total" }
+   };
+   for (uint32_t i=0; i<PM_NUM_CLASSES; i++) {
+      if (request_total_[i].count > 0) {
+         log_latency_summary(log_, &request_wait_[i], labels[i][0]);
+         log_latency_summary(log_, &request_total_[i], labels[i][1]);
       }
-      //
-      // close connection
-      close(connfd);
+      latency_reset(&request_wait_[i]);
+      latency_reset(&request_total_[i]);
+   }
+   timing_report_sec_ = t;
+}
+
+static void handle_messages(void)
+{
+   const int listen_fd = sockfd_;
+   struct epoll_event events[PM_MAX_EVENTS];
+   for (uint32_t i=0; i<PM_MAX_CLIENTS; i++) {
+      clients_[i].fd = -1;
+   }
+   for (uint32_t i=0; i<PM_NUM_CLASSES; i++) {
+      latency_reset(&request_wait_[i]);
+      latency_reset(&request_total_[i]);
+   }
+   if ((epoll_fd_ = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+      log_err(log_, "Postmaster failed to create epoll: %s",
+            strerror(errno));
+      goto end;
+   }
+   struct epoll_event ev = { .events = EPOLLIN, .data.u32 = PM_LISTEN_TAG };
+   if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+      log_err(log_, "Postmaster failed to add socket to epoll: %s",
+            strerror(errno));
+      goto end;
+   }
+   // don't wait for events if status requests are still queued
+   int timeout_msec = PM_EPOLL_TIMEOUT_MSEC;
+   while (postmaster_ == RUNNING) {
+      // wake periodically to check for exit, as shutting down socket
+      //    doesn't necessarily generate an event
+      int n = epoll_wait(epoll_fd_, events, PM_MAX_EVENTS, timeout_msec);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         log_err(log_, "Postmaster epoll_wait failed: %s", strerror(errno));
+         break;
+      }
+      // read everything that's available before handling any of it so
+      //    that commands can be put ahead of status requests
+      for (int i=0; i<n; i++) {
+         const uint32_t slot = events[i].data.u32;
+         if (slot == PM_LISTEN_TAG) {
+            accept_clients(listen_fd);
+            continue;
+         }
+         pm_client_type *client = &clients_[slot];
+         if (client->fd < 0) {
+            continue;
+         }
+         if (events[i].events & EPOLLIN) {
+            if (read_requests(client) != 0) {
+               close_client(client);
+               continue;
+            }
+         } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            close_client(client);
+         }
+      }
+      // commands first, then some status requests
+      handle_requests_of_class(PM_CLASS_COMMAND, UINT32_MAX);
+      handle_requests_of_class(PM_CLASS_STATUS, PM_STATUS_PER_PASS);
+      timeout_msec = PM_EPOLL_TIMEOUT_MSEC;
+      for (uint32_t i=0; i<PM_MAX_CLIENTS; i++) {
+         pm_client_type *client = &clients_[i];
+         if (client->fd < 0) {
+            continue;
+         }
+         if (send_responses(client) != 0) {
+            close_client(client);
+            continue;
+         }
+         set_client_events(client, i);
+         for (uint32_t j=0; j<client->queue_count; j++) {
+            if (client->queue[(client->queue_head + j) %
+                  PM_CLIENT_QUEUE_LEN].handled == 0) {
+               timeout_msec = 0;
+            }
+         }
+      }
+      report_request_timing();
    };
+end:
    log_info(log_, "Leaving postmaster message handler");
-   if (connfd >= 0) {
-      close(connfd);
+   for (uint32_t i=0; i<PM_MAX_CLIENTS; i++) {
+      if (clients_[i].fd >= 0) {
+         close_client(&clients_[i]);
+      }
+   }
+   if (epoll_fd_ >= 0) {
+      close(epoll_fd_);
+      epoll_fd_ = -1;
    }
 }
 
@@ -30,6 +30,8 @@
 #include "datap.h"
 #include "pinet.h"
 #include "postmaster.h"
+#include "telemetry.h"
+#include "pinet_reactor.h"
 #include "timekeeper.h"
 #include "script_iface.h"
 #include "udp_sync.h"
@@ -41,6 +43,8 @@
 
 
 static pthread_t postmaster_tid_;
+static pthread_t telemetry_tid_;
+static int32_t telemetry_launched_ = 0;
 
 static int32_t init_globals(void)
 {
@@ -77,6 +81,15 @@ static void run_postmaster(void)
    }
 }
 
+static void run_telemetry(void)
+{
+   if (pthread_create(&telemetry_tid_, NULL, launch_telemetry, NULL) != 0) {
+      perror("Error launching telemetry");
+      hard_exit("run_telemetry", 1);
+   }
+   telemetry_launched_ = 1;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // sanity checking
 
@@ -203,6 +216,14 @@ static void shutdown_postmaster(void)
    pthread_join(postmaster_tid_, NULL);
 }
 
+static void shutdown_telemetry(void)
+{
+   printf("Shutdown telemetry\n");
+   if (telemetry_launched_) {
+      pthread_join(telemetry_tid_, NULL);
+   }
+}
+
 static void clean_up_globals(void)
 {
    log_info(get_kernel_log(),
@@ -268,6 +289,8 @@ fprintf(stderr, "Logging data to %s\n", get_log_folder_name());
    //////////////////////////////////////
    // establish interface for external control (via socket)
    run_postmaster();
+   // stream status to local displays
+   run_telemetry();
    // run tests to catch setup errors
    sanity_check();
    // let loose the hounds
@@ -278,6 +301,9 @@ shutdown:
    printf("Shutting down");
    signal_exit(0);
    shutdown_postmaster();
+   shutdown_telemetry();
+   // receivers have exited so their connections are gone
+   stop_pinet_reactor();
    // free global resources
    clean_up_globals();
    // pipe error log to stdout
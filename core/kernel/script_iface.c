@@ -76,6 +76,7 @@ int32_t configure_environment(const char* config_file)
    /////////////////////
    // core modules (sensor)
    lua_register(L, "create_attitude", create_attitude);
+   lua_register(L, "set_attitude_history", set_attitude_history_);
    lua_register(L, "create_frame_sync", create_frame_sync);
    lua_register(L, "create_gps_receiver", create_gps_receiver);
    lua_register(L, "create_imu_receiver", create_imu_receiver);
@@ -95,9 +96,12 @@ int32_t configure_environment(const char* config_file)
    /////////////////////
    // other
    lua_register(L, "create_udp_sync", create_udp_sync);
+   lua_register(L, "set_frame_rate_bounds", set_frame_rate_bounds);
+   lua_register(L, "set_network_reactor", set_network_reactor);
    /////////////////////////////////////////////////////////////////////
    // IMU
    lua_register(L, "set_imu_priority", set_imu_priority_);
+   lua_register(L, "set_imu_batch", set_imu_batch_);
    // panorama
    //lua_register(L, "define_phantom_image", define_phantom_image);
    /////////////////////////////////////////////////////////////////////
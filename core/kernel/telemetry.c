@@ -0,0 +1,714 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "telemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "kernel.h"
+#include "datap.h"
+#include "logger.h"
+#include "pinet.h"
+#include "timekeeper.h"
+#include "latency.h"
+#include "dev_info.h"
+#include "core_modules/attitude.h"
+#include "core_modules/gps_receiver.h"
+#include "routing/driver.h"
+
+static log_info_type *log_ = NULL;
+
+static int sockfd_ = -1;
+static int epoll_fd_ = -1;
+
+static volatile int32_t quit_ = 0;
+
+// maximum number of simultaneous clients. connections above this are
+//    closed as soon as they're accepted
+#define TM_MAX_CLIENTS           16
+// per-client output buffer. messages that don't fit are dropped. this
+//    is several seconds of data at default rates
+#define TM_CLIENT_BUFFER_BYTES   (32 * 1024)
+// data is sampled and sent on this interval, which limits rate of
+//    any one type
+#define TM_TICK_MSEC             10
+#define TM_MAX_RATE_HZ           100.0f
+#define TM_MAX_EVENTS            (TM_MAX_CLIENTS + 1)
+// how often per-client drop counts are written to log
+#define TM_REPORT_SEC            60.0
+
+// epoll tag for listening socket. clients are tagged by slot index
+#define TM_LISTEN_TAG            0xffffffffu
+
+#define TM_MAX_PAYLOAD_BYTES     (sizeof(telemetry_modules_type) + \
+      MAX_PROCESSORS * sizeof(telemetry_module_type))
+
+// rates used until client sends a subscription
+static const float DEFAULT_RATE_HZ[NUM_TELEMETRY_TYPES] = {
+   [TELEMETRY_ATTITUDE] = 10.0f,
+   [TELEMETRY_POSITION] = 1.0f,
+   [TELEMETRY_ROUTE] = 1.0f,
+   [TELEMETRY_MODULES] = 0.2f
+};
+
+static const char *TYPE_NAMES[NUM_TELEMETRY_TYPES] = {
+   "attitude", "position", "route", "modules"
+};
+
+struct tm_client {
+   int fd;     // -1 if slot is unused
+   uint32_t id;   // connection number, for log
+   float rate_hz[NUM_TELEMETRY_TYPES];
+   double next_send_sec[NUM_TELEMETRY_TYPES];
+   // dropped since last message of type was sent, and total
+   uint32_t dropped[NUM_TELEMETRY_TYPES];
+   uint32_t tot_dropped[NUM_TELEMETRY_TYPES];
+   uint32_t seq;
+   // subscription being received
+   uint8_t sub[sizeof(telemetry_subscribe_type)];
+   uint32_t sub_len;
+   // encoded messages waiting to be written
+   uint8_t out[TM_CLIENT_BUFFER_BYTES];
+   uint32_t out_len;
+   uint32_t out_sent;
+   // events client is presently registered for
+   uint32_t events;
+};
+typedef struct tm_client tm_client_type;
+
+static tm_client_type clients_[TM_MAX_CLIENTS];
+static uint32_t num_connections_ = 0;
+
+// producers that telemetry is read from. NULL if not running
+static datap_desc_type *attitude_dp_ = NULL;
+static datap_desc_type *gps_dp_ = NULL;
+static datap_desc_type *driver_dp_ = NULL;
+
+// payload of each type, built at most once per tick and shared among
+//    clients
+struct tm_message {
+   uint8_t payload[TM_MAX_PAYLOAD_BYTES];
+   uint32_t payload_bytes;
+   double t;
+   // set when payload is built this tick. -1 if data not available
+   int32_t state;
+};
+typedef struct tm_message tm_message_type;
+
+static tm_message_type messages_[NUM_TELEMETRY_TYPES];
+
+static double report_sec_ = -1.0;
+
+
+void telemetry_quit(
+      /* in     */ const int unused
+      )
+{
+   (void) unused;
+   quit_ = 1;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// data sources
+
+static datap_desc_type * find_producer(
+      /* in     */ const char *class_name
+      )
+{
+   for (uint32_t i=0; i<num_threads_g; i++) {
+      if (strcmp(thread_table_g[i].class_name, class_name) == 0) {
+         return thread_table_g[i].dp;
+      }
+   }
+   return NULL;
+}
+
+// copies most recent element published by producer. returns sample
+//    time of element, or -1 if nothing's been published
+static double read_latest(
+      /* in     */ const datap_desc_type *dp,
+      /*    out */       void *element,
+      /* in     */ const size_t element_bytes
+      )
+{
+   const uint64_t produced = dp->elements_produced;
+   if ((produced == 0) || (dp->element_size < element_bytes)) {
+      return -1.0;
+   }
+   const uint32_t idx = (uint32_t) ((produced - 1) % dp->queue_length);
+   memcpy(element, &dp->void_queue[idx * dp->element_size], element_bytes);
+   return dp->ts[idx];
+}
+
+static int32_t build_attitude(
+      /*    out */       tm_message_type *msg
+      )
+{
+   attitude_output_type att;
+   if ((attitude_dp_ == NULL) ||
+         ((msg->t = read_latest(attitude_dp_, &att, sizeof att)) < 0.0)) {
+      return -1;
+   }
+   telemetry_attitude_type *out = (telemetry_attitude_type*) msg->payload;
+   out->true_heading_deg = (float) att.true_heading.degrees;
+   out->pitch_deg = (float) att.pitch.degrees;
+   out->roll_deg = (float) att.roll.degrees;
+   out->turn_rate_dps = (float) att.turn_rate.dps;
+   msg->payload_bytes = sizeof *out;
+   return 0;
+}
+
+static int32_t build_position(
+      /*    out */       tm_message_type *msg
+      )
+{
+   gps_receiver_output_type gps;
+   if ((gps_dp_ == NULL) ||
+         ((msg->t = read_latest(gps_dp_, &gps, sizeof gps)) < 0.0)) {
+      return -1;
+   }
+   telemetry_position_type *out = (telemetry_position_type*) msg->payload;
+   out->lon_deg = gps.pos.x_deg;
+   out->lat_deg = gps.pos.y_deg;
+   out->speed_mps = (float) gps.speed.mps;
+   out->track_deg = (float) gps.heading.degrees;
+   out->available = gps.available;
+   out->unused = 0;
+   msg->payload_bytes = sizeof *out;
+   return 0;
+}
+
+static int32_t build_route(
+      /*    out */       tm_message_type *msg
+      )
+{
+   driver_output_type drv;
+   if ((driver_dp_ == NULL) ||
+         ((msg->t = read_latest(driver_dp_, &drv, sizeof drv)) < 0.0)) {
+      return -1;
+   }
+   const route_info_type *route = &drv.route;
+   telemetry_route_type *out = (telemetry_route_type*) msg->payload;
+   out->sug_heading_deg =
+         (float) ((double) route->sug_heading.tru.angle32 * BAM32_TO_DEG);
+   out->autopilot_course_deg =
+         (float) ((double) route->autopilot_course.tru.angle32 * BAM32_TO_DEG);
+   out->measured_heading_deg =
+         (float) ((double) route->measured_heading.tru.angle32 * BAM32_TO_DEG);
+   out->path_heading_deg =
+         (float) ((double) route->true_path_heading.angle16 * BAM16_TO_DEG);
+   out->present_speed_mps = (float) route->present_speed.mps;
+   out->turn_rate_dps = (float) route->turn_rate.dps;
+   out->dest_lon_deg = route->destination.x_deg;
+   out->dest_lat_deg = route->destination.y_deg;
+   out->flags = route->flags_all;
+   out->flags_persistent = route->flags2_persistent;
+   msg->payload_bytes = sizeof *out;
+   return 0;
+}
+
+// largest number of elements that a consumer of this producer has yet
+//    to read
+static uint32_t max_consumer_backlog(
+      /* in     */ const datap_desc_type *dp
+      )
+{
+   uint64_t backlog = 0;
+   for (uint32_t i=0; i<dp->num_attached_consumers; i++) {
+      const datap_desc_type *consumer = dp->consumer_list[i];
+      for (uint32_t j=0; j<consumer->num_attached_producers; j++) {
+         const producer_record_type *pr = &consumer->producer_list[j];
+         if ((pr->producer == dp) &&
+               (dp->elements_produced > pr->consumed_elements) &&
+               (dp->elements_produced - pr->consumed_elements > backlog)) {
+            backlog = dp->elements_produced - pr->consumed_elements;
+         }
+      }
+   }
+   return backlog > UINT32_MAX ? UINT32_MAX : (uint32_t) backlog;
+}
+
+static int32_t build_modules(
+      /*    out */       tm_message_type *msg
+      )
+{
+   telemetry_modules_type *hdr = (telemetry_modules_type*) msg->payload;
+   telemetry_module_type *mods =
+         (telemetry_module_type*) &msg->payload[sizeof *hdr];
+   hdr->num_modules = num_threads_g;
+   hdr->unused = 0;
+   for (uint32_t i=0; i<num_threads_g; i++) {
+      const thread_desc_type *td = &thread_table_g[i];
+      const datap_desc_type *dp = td->dp;
+      telemetry_module_type *mod = &mods[i];
+      memset(mod, 0, sizeof *mod);
+      strncpy(mod->name, td->obj_name, TELEMETRY_NAME_LEN - 1);
+      strncpy(mod->class_name, td->class_name, TELEMETRY_NAME_LEN - 1);
+      mod->elements_produced = dp->elements_produced;
+      mod->queue_length = dp->queue_length;
+      mod->max_backlog = max_consumer_backlog(dp);
+      // stats are updated by module's thread. work from a copy so
+      //    percentiles are at least self-consistent
+      latency_stats_type age;
+      memcpy(&age, &dp->publish_age, sizeof age);
+      mod->publish_age_p50_ms =
+            (float) (1000.0 * latency_percentile(&age, 50.0));
+      mod->publish_age_p99_ms =
+            (float) (1000.0 * latency_percentile(&age, 99.0));
+   }
+   msg->t = now();
+   msg->payload_bytes = (uint32_t) (sizeof *hdr + num_threads_g * sizeof *mods);
+   return 0;
+}
+
+// builds payload of type if it hasn't been built yet this tick. returns
+//    0 if message is available and -1 if not
+static int32_t get_message(
+      /* in     */ const uint32_t type
+      )
+{
+   tm_message_type *msg = &messages_[type];
+   if (msg->state == 0) {
+      int32_t rc = -1;
+      switch (type) {
+         case TELEMETRY_ATTITUDE:
+            rc = build_attitude(msg);
+            break;
+         case TELEMETRY_POSITION:
+            rc = build_position(msg);
+            break;
+         case TELEMETRY_ROUTE:
+            rc = build_route(msg);
+            break;
+         case TELEMETRY_MODULES:
+            rc = build_modules(msg);
+            break;
+      };
+      msg->state = rc == 0 ? 1 : -1;
+   }
+   return msg->state > 0 ? 0 : -1;
+}
+
+// data sources
+////////////////////////////////////////////////////////////////////////
+// clients
+
+static int setup_networking(void)
+{
+   char buf[STR_LEN];
+   FILE *fp = NULL;
+   // telemetry is optional. don't complain if it's not configured
+   build_path_string2(NULL, NULL, "endpoints", "telemetry", NULL, buf,
+         STR_LEN);
+   if (access(buf, R_OK) != 0) {
+      log_info(log_, "Telemetry port not configured ('%s'). Telemetry "
+            "is disabled", buf);
+      goto err;
+   }
+   fp = open_config_file_ro2(NULL, NULL, "endpoints", "telemetry", NULL);
+   if (!fp) {
+      goto err;
+   }
+   if (config_read_string(fp, buf, STR_LEN) != 0) {
+      log_err(log_, "Failed to determine network port for telemetry");
+      goto err;
+   }
+   const int16_t port_num = (int16_t) atoi(buf);
+   log_info(log_, "Telemetry on localhost port %d", port_num);
+   if ((sockfd_ = init_server_backlog(port_num, TM_MAX_CLIENTS)) < 0) {
+      log_err(log_, "Failed to initialize server for telemetry");
+      goto err;
+   }
+   int flags = fcntl(sockfd_, F_GETFL, 0);
+   if ((flags < 0) || (fcntl(sockfd_, F_SETFL, flags | O_NONBLOCK) < 0)) {
+      log_err(log_, "Failed to make telemetry socket non-blocking: %s",
+            strerror(errno));
+      close(sockfd_);
+      sockfd_ = -1;
+      goto err;
+   }
+err:
+   if (fp)
+      fclose(fp);
+   return sockfd_;
+}
+
+static void set_client_events(
+      /* in out */       tm_client_type *client,
+      /* in     */ const uint32_t slot
+      )
+{
+   uint32_t events = EPOLLIN;
+   if (client->out_sent < client->out_len) {
+      events |= EPOLLOUT;
+   }
+   if (events != client->events) {
+      struct epoll_event ev = { .events = events, .data.u32 = slot };
+      if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client->fd, &ev) != 0) {
+         log_err(log_, "Telemetry failed to update events for "
+               "connection %d: %s", client->id, strerror(errno));
+      }
+      client->events = events;
+   }
+}
+
+static void close_client(
+      /* in out */       tm_client_type *client
+      )
+{
+   log_info(log_, "Telemetry connection %d closed. Dropped %d attitude, "
+         "%d position, %d route, %d modules messages", client->id,
+         client->tot_dropped[TELEMETRY_ATTITUDE],
+         client->tot_dropped[TELEMETRY_POSITION],
+         client->tot_dropped[TELEMETRY_ROUTE],
+         client->tot_dropped[TELEMETRY_MODULES]);
+   epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client->fd, NULL);
+   close(client->fd);
+   client->fd = -1;
+}
+
+static void accept_clients(
+      /* in     */ const int listen_fd
+      )
+{
+   int connfd;
+   while ((connfd = accept4(listen_fd, NULL, NULL,
+         SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+      uint32_t slot = TM_MAX_CLIENTS;
+      for (uint32_t i=0; i<TM_MAX_CLIENTS; i++) {
+         if (clients_[i].fd < 0) {
+            slot = i;
+            break;
+         }
+      }
+      if (slot == TM_MAX_CLIENTS) {
+         log_err(log_, "Telemetry has too many connections. Dropping "
+               "new one");
+         close(connfd);
+         continue;
+      }
+      tm_client_type *client = &clients_[slot];
+      memset(client, 0, sizeof *client);
+      client->fd = connfd;
+      client->id = num_connections_++;
+      client->events = EPOLLIN;
+      const double t = now();
+      for (uint32_t i=0; i<NUM_TELEMETRY_TYPES; i++) {
+         client->rate_hz[i] = DEFAULT_RATE_HZ[i];
+         client->next_send_sec[i] = t;
+      }
+      struct epoll_event ev = { .events = EPOLLIN, .data.u32 = slot };
+      if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, connfd, &ev) != 0) {
+         log_err(log_, "Telemetry failed to add connection: %s",
+               strerror(errno));
+         close(connfd);
+         client->fd = -1;
+         continue;
+      }
+      log_info(log_, "Telemetry connection %d opened", client->id);
+   }
+   if ((errno != EAGAIN) && (errno != EINTR)) {
+      log_err(log_, "Telemetry accept failed: %s", strerror(errno));
+   }
+}
+
+static void apply_subscription(
+      /* in out */       tm_client_type *client
+      )
+{
+   telemetry_subscribe_type sub;
+   memcpy(&sub, client->sub, sizeof sub);
+   const double t = now();
+   for (uint32_t i=0; i<NUM_TELEMETRY_TYPES; i++) {
+      float rate = sub.rate_hz[i];
+      // also catches NaN
+      if (!(rate > 0.0f)) {
+         rate = 0.0f;
+      } else if (rate > TM_MAX_RATE_HZ) {
+         rate = TM_MAX_RATE_HZ;
+      }
+      client->rate_hz[i] = rate;
+      client->next_send_sec[i] = t;
+   }
+   client->sub_len = 0;
+}
+
+// reads subscription requests
+// returns 0 on success and -1 if connection should be closed
+static int32_t read_subscriptions(
+      /* in out */       tm_client_type *client
+      )
+{
+   while (1) {
+      ssize_t n = recv(client->fd, &client->sub[client->sub_len],
+            sizeof client->sub - client->sub_len, 0);
+      if (n == 0) {
+         return -1;
+      } else if (n < 0) {
+         if (errno == EAGAIN) {
+            break;
+         } else if (errno == EINTR) {
+            continue;
+         } else if (errno == ECONNRESET) {
+            // client closed w/o reading everything that was sent
+            return -1;
+         }
+         log_err(log_, "Error reading from telemetry connection %d: %s",
+               client->id, strerror(errno));
+         return -1;
+      }
+      client->sub_len += (uint32_t) n;
+      if (client->sub_len < sizeof client->sub) {
+         continue;
+      }
+      telemetry_subscribe_type sub;
+      memcpy(&sub, client->sub, sizeof sub);
+      if ((sub.magic != TELEMETRY_MAGIC) ||
+            (sub.version != TELEMETRY_VERSION)) {
+         log_err(log_, "Telemetry connection %d sent bad subscription "
+               "(magic 0x%04x, version %d). Closing connection",
+               client->id, sub.magic, sub.version);
+         return -1;
+      }
+      apply_subscription(client);
+   }
+   return 0;
+}
+
+// appends message to client's output buffer. if there's no room then
+//    message is dropped
+static void queue_message(
+      /* in out */       tm_client_type *client,
+      /* in     */ const uint32_t type
+      )
+{
+   const tm_message_type *msg = &messages_[type];
+   const uint32_t len =
+         (uint32_t) sizeof(telemetry_header_type) + msg->payload_bytes;
+   if ((client->out_len + len) > TM_CLIENT_BUFFER_BYTES) {
+      if (client->out_sent > 0) {
+         memmove(client->out, &client->out[client->out_sent],
+               client->out_len - client->out_sent);
+         client->out_len -= client->out_sent;
+         client->out_sent = 0;
+      }
+      if ((client->out_len + len) > TM_CLIENT_BUFFER_BYTES) {
+         client->dropped[type]++;
+         client->tot_dropped[type]++;
+         return;
+      }
+   }
+   telemetry_header_type header = {
+      .magic = TELEMETRY_MAGIC,
+      .version = TELEMETRY_VERSION,
+      .type = (uint8_t) type,
+      .payload_bytes = msg->payload_bytes,
+      .seq = client->seq++,
+      .dropped = client->dropped[type],
+      .t = msg->t
+   };
+   memcpy(&client->out[client->out_len], &header, sizeof header);
+   memcpy(&client->out[client->out_len + sizeof header], msg->payload,
+         msg->payload_bytes);
+   client->out_len += len;
+   client->dropped[type] = 0;
+}
+
+// queues messages that are due for client
+static void queue_messages(
+      /* in out */       tm_client_type *client,
+      /* in     */ const double t
+      )
+{
+   for (uint32_t i=0; i<NUM_TELEMETRY_TYPES; i++) {
+      if ((client->rate_hz[i] <= 0.0f) || (t < client->next_send_sec[i])) {
+         continue;
+      }
+      const double interval = 1.0 / (double) client->rate_hz[i];
+      client->next_send_sec[i] += interval;
+      // don't try to catch up if falling behind
+      if (client->next_send_sec[i] < t) {
+         client->next_send_sec[i] = t + interval;
+      }
+      if (get_message(i) == 0) {
+         queue_message(client, i);
+      }
+   }
+}
+
+// sends as much as socket will take
+// returns 0 on success and -1 if connection should be closed
+static int32_t send_messages(
+      /* in out */       tm_client_type *client
+      )
+{
+   while (client->out_sent < client->out_len) {
+      ssize_t n = send(client->fd, &client->out[client->out_sent],
+            client->out_len - client->out_sent, MSG_NOSIGNAL);
+      if (n < 0) {
+         if (errno == EAGAIN) {
+            break;
+         } else if (errno == EINTR) {
+            continue;
+         }
+         log_err(log_, "Error sending to telemetry connection %d: %s",
+               client->id, strerror(errno));
+         return -1;
+      }
+      client->out_sent += (uint32_t) n;
+   }
+   if (client->out_sent == client->out_len) {
+      client->out_sent = 0;
+      client->out_len = 0;
+   }
+   return 0;
+}
+
+static void report_drops(
+      /* in     */ const double t
+      )
+{
+   if ((t - report_sec_) < TM_REPORT_SEC) {
+      return;
+   }
+   for (uint32_t i=0; i<TM_MAX_CLIENTS; i++) {
+      const tm_client_type *client = &clients_[i];
+      if (client->fd < 0) {
+         continue;
+      }
+      for (uint32_t j=0; j<NUM_TELEMETRY_TYPES; j++) {
+         if (client->tot_dropped[j] > 0) {
+            log_info(log_, "Telemetry connection %d has dropped %d %s "
+                  "messages", client->id, client->tot_dropped[j],
+                  TYPE_NAMES[j]);
+         }
+      }
+   }
+   report_sec_ = t;
+}
+
+static void stream_telemetry(void)
+{
+   const int listen_fd = sockfd_;
+   struct epoll_event events[TM_MAX_EVENTS];
+   for (uint32_t i=0; i<TM_MAX_CLIENTS; i++) {
+      clients_[i].fd = -1;
+   }
+   if ((epoll_fd_ = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+      log_err(log_, "Telemetry failed to create epoll: %s",
+            strerror(errno));
+      goto end;
+   }
+   struct epoll_event ev = { .events = EPOLLIN, .data.u32 = TM_LISTEN_TAG };
+   if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+      log_err(log_, "Telemetry failed to add socket to epoll: %s",
+            strerror(errno));
+      goto end;
+   }
+   report_sec_ = now();
+   while (quit_ == 0) {
+      int n = epoll_wait(epoll_fd_, events, TM_MAX_EVENTS, TM_TICK_MSEC);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         log_err(log_, "Telemetry epoll_wait failed: %s", strerror(errno));
+         break;
+      }
+      for (int i=0; i<n; i++) {
+         const uint32_t slot = events[i].data.u32;
+         if (slot == TM_LISTEN_TAG) {
+            accept_clients(listen_fd);
+            continue;
+         }
+         tm_client_type *client = &clients_[slot];
+         if (client->fd < 0) {
+            continue;
+         }
+         if (events[i].events & EPOLLIN) {
+            if (read_subscriptions(client) != 0) {
+               close_client(client);
+               continue;
+            }
+         } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            close_client(client);
+         }
+      }
+      // payloads are built on demand, once per pass
+      for (uint32_t i=0; i<NUM_TELEMETRY_TYPES; i++) {
+         messages_[i].state = 0;
+      }
+      const double t = now();
+      for (uint32_t i=0; i<TM_MAX_CLIENTS; i++) {
+         tm_client_type *client = &clients_[i];
+         if (client->fd < 0) {
+            continue;
+         }
+         queue_messages(client, t);
+         if (send_messages(client) != 0) {
+            close_client(client);
+            continue;
+         }
+         set_client_events(client, i);
+      }
+      report_drops(t);
+   }
+end:
+   log_info(log_, "Leaving telemetry loop");
+   for (uint32_t i=0; i<TM_MAX_CLIENTS; i++) {
+      if (clients_[i].fd >= 0) {
+         close_client(&clients_[i]);
+      }
+   }
+   if (epoll_fd_ >= 0) {
+      close(epoll_fd_);
+      epoll_fd_ = -1;
+   }
+}
+
+// clients
+////////////////////////////////////////////////////////////////////////
+// thread entry point
+
+void * launch_telemetry(void *not_used)
+{
+   (void) not_used;
+   log_ = get_kernel_log();
+   if (setup_networking() < 0) {
+      goto end;
+   }
+   // modules are created before telemetry is launched
+   attitude_dp_ = find_producer(ATTITUDE_CLASS_NAME);
+   gps_dp_ = find_producer(GPS_RECEIVER_CLASS_NAME);
+   driver_dp_ = find_producer(DRIVER_CLASS_NAME);
+   stream_telemetry();
+end:
+   if (sockfd_ >= 0) {
+      close(sockfd_);
+      sockfd_ = -1;
+   }
+   log_info(log_, "Telemetry exiting");
+   return NULL;
+}
+
@@ -24,12 +24,17 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <errno.h>
+#include <math.h>
 
 #include "kernel.h"
 #include "datap.h"
 #include "pinet.h"
+#include "logger.h"
 #include "timekeeper.h"
 #include "udp_sync.h"
+#include "core_modules/frame_sync.h"
+#include "core_modules/optical_up.h"
+#include "core_modules/panorama.h"
 
 // sends broadcast UDP sync packets to synchronize clocks between nodes
 //    and start/stop acquisition
@@ -49,6 +54,19 @@ static pthread_mutex_t s_sync_mutex;
 //    interruption is due termination
 static int32_t s_abort_flag = 0;
 
+// range that frame interval can be adjusted within
+static double s_min_interval = 1.0 / UDP_SYNC_MAX_FPS_DEFAULT;
+static double s_max_interval = 1.0 / UDP_SYNC_MIN_FPS_DEFAULT;
+
+// vision modules whose load determines frame rate
+static const char *s_paced_classes[] = {
+      FRAME_SYNC_CLASS_NAME,
+      OPTICAL_UP_CLASS_NAME,
+      PANORAMA_CLASS_NAME
+};
+#define NUM_PACED_CLASSES  \
+      (sizeof s_paced_classes / sizeof s_paced_classes[0])
+
 // sigusr2 handler -- this is a no-op. the role of sigusr2 is to
 //    wake the thread if it's sleeping
 static void sigusr2_callback(int sig)
@@ -145,6 +163,8 @@ void send_sync_packet(uint32_t type)
    memset(&pack, 0, sizeof(pack));
    assert((type & 0xffff0000) == 0);
    pack.packet_type = (uint16_t) type;
+   pack.frame_interval_ms =
+         (uint16_t) lrint(1000.0 * s_udp->frame_interval);
    //
    pthread_mutex_lock(&s_sync_mutex);
    // set packet timestamp
@@ -179,11 +199,198 @@ printf("nap interruption\n");
 #define RUNNING_INTERVAL   20.0  // interval between time syncs
 #define QUIET_INTERVAL     (2 * CAMERA_FRAME_INTERVAL)
 
+#define LOAD_CHECKS_PER_INTERVAL    \
+      ((uint32_t) (RUNNING_INTERVAL / UDP_SYNC_LOAD_CHECK_SEC))
+
+////////////////////////////////////////////////////////////////////////
+// frame rate adaptation
+
+int32_t set_udp_sync_frame_rate_bounds(
+      /* in     */ const double min_fps,
+      /* in     */ const double max_fps
+      )
+{
+   if ((min_fps <= 0.0) || (min_fps > max_fps) ||
+         (max_fps > (double) CAMERA_FPS)) {
+      log_err(get_kernel_log(), "Invalid frame rate bounds %.2f to %.2f "
+            "(max is %d fps)", min_fps, max_fps, CAMERA_FPS);
+      return -1;
+   }
+   // interval is sent in msec as uint16
+   if (1000.0 / min_fps > (double) UINT16_MAX) {
+      log_err(get_kernel_log(), "Min frame rate %.3f too low", min_fps);
+      return -1;
+   }
+   s_min_interval = 1.0 / max_fps;
+   s_max_interval = 1.0 / min_fps;
+   log_info(get_kernel_log(), "Frame rate bounds %.2f to %.2f fps",
+         min_fps, max_fps);
+   return 0;
+}
+
+// worst load seen at a paced module, with the name of the module
+struct pipeline_load {
+   uint64_t backlog;
+   const char *backlog_name;
+   double age;
+   const char *age_name;
+};
+typedef struct pipeline_load pipeline_load_type;
+
+// number of elements module has yet to read from its busiest input
+static uint64_t input_backlog(
+      /* in     */ const datap_desc_type *dp
+      )
+{
+   uint64_t backlog = 0;
+   for (uint32_t i=0; i<dp->num_attached_producers; i++) {
+      const producer_record_type *pr = &dp->producer_list[i];
+      const uint64_t produced = pr->producer->elements_produced;
+      if ((produced > pr->consumed_elements) &&
+            (produced - pr->consumed_elements > backlog)) {
+         backlog = produced - pr->consumed_elements;
+      }
+   }
+   return backlog;
+}
+
+// age of most recently published element when it was published, or -1
+//    if that's not known
+static double latest_publish_age(
+      /* in     */ const datap_desc_type *dp
+      )
+{
+   const uint64_t produced = dp->elements_produced;
+   if ((produced == 0) || (dp->queue_length == 0)) {
+      return -1.0;
+   }
+   const uint32_t idx = (uint32_t) ((produced - 1) % dp->queue_length);
+   const double published = dp_get_publish_time_at(dp, idx);
+   if (published < 0.0) {
+      return -1.0;
+   }
+   // element may have been overwritten since it was read. that's
+   //    harmless unless it makes age look negative
+   const double age = published - dp->ts[idx];
+   return age >= 0.0 ? age : -1.0;
+}
+
+// stats are updated by the modules' threads. reads are unsynchronized,
+//    which is OK as a stale value only delays adaptation by one check
+static void measure_load(
+      /*    out */       pipeline_load_type *load
+      )
+{
+   memset(load, 0, sizeof *load);
+   for (uint32_t i=0; i<num_threads_g; i++) {
+      const thread_desc_type *td = &thread_table_g[i];
+      for (uint32_t j=0; j<NUM_PACED_CLASSES; j++) {
+         if (strcmp(td->class_name, s_paced_classes[j]) != 0) {
+            continue;
+         }
+         const uint64_t backlog = input_backlog(td->dp);
+         if (backlog > load->backlog) {
+            load->backlog = backlog;
+            load->backlog_name = td->obj_name;
+         }
+         const double age = latest_publish_age(td->dp);
+         if (age > load->age) {
+            load->age = age;
+            load->age_name = td->obj_name;
+         }
+         break;
+      }
+   }
+}
+
+// logs requested frame rate and the rate that synchronized frame sets
+//    are actually produced
+static void report_frame_rate(
+      /* in out */       struct udp_sync_class *udp
+      )
+{
+   const double t = now();
+   if ((t - udp->rate_report_sec) < UDP_SYNC_RATE_REPORT_SEC) {
+      return;
+   }
+   uint64_t frames = 0;
+   for (uint32_t i=0; i<num_threads_g; i++) {
+      if (strcmp(thread_table_g[i].class_name, FRAME_SYNC_CLASS_NAME) == 0) {
+         frames = thread_table_g[i].dp->elements_produced;
+         break;
+      }
+   }
+   const double dt = t - udp->rate_report_sec;
+   log_info(get_kernel_log(), "Frame rate: requested %.2f fps, effective "
+         "%.2f fps", 1.0 / udp->frame_interval,
+         (double) (frames - udp->frames_at_report) / dt);
+   udp->frames_at_report = frames;
+   udp->rate_report_sec = t;
+}
+
+// checks load on vision pipeline and adjusts frame interval if
+//    necessary. cameras are told of changes immediately
+static void adapt_frame_rate(
+      /* in out */       struct udp_sync_class *udp
+      )
+{
+   report_frame_rate(udp);
+   if (!MESSAGE_BOARD.acquiring) {
+      udp->calm_checks = 0;
+      return;
+   }
+   pipeline_load_type load;
+   measure_load(&load);
+   udp->settle_checks++;
+   double interval = udp->frame_interval;
+   char reason[STR_LEN];
+   reason[0] = 0;
+   if ((load.backlog >= UDP_SYNC_BACKLOG_HIGH) ||
+         (load.age >= UDP_SYNC_AGE_HIGH_SEC)) {
+      udp->calm_checks = 0;
+      if (udp->settle_checks >= UDP_SYNC_SETTLE_CHECKS) {
+         interval *= UDP_SYNC_SLOWDOWN;
+         udp->settle_checks = 0;
+         if (load.backlog >= UDP_SYNC_BACKLOG_HIGH) {
+            snprintf(reason, STR_LEN, "%ld frames waiting at %s",
+                  load.backlog, load.backlog_name);
+         } else {
+            snprintf(reason, STR_LEN, "output of %s is %.3f sec old",
+                  load.age_name, load.age);
+         }
+      }
+   } else if ((load.backlog == 0) && (load.age < UDP_SYNC_AGE_LOW_SEC)) {
+      if (++udp->calm_checks >= UDP_SYNC_RECOVER_CHECKS) {
+         interval /= UDP_SYNC_SPEEDUP;
+         udp->calm_checks = 0;
+         snprintf(reason, STR_LEN, "load is low (max age %.3f sec)",
+               load.age);
+      }
+   } else {
+      udp->calm_checks = 0;
+   }
+   if (interval < s_min_interval) {
+      interval = s_min_interval;
+   } else if (interval > s_max_interval) {
+      interval = s_max_interval;
+   }
+   if (fabs(interval - udp->frame_interval) > 1.0e-4) {
+      log_info(get_kernel_log(), "Frame rate %.2f -> %.2f fps: %s",
+            1.0 / udp->frame_interval, 1.0 / interval, reason);
+      udp->frame_interval = interval;
+      send_sync_packet(UDP_SYNC_PACKET_FRAME_RATE);
+   }
+}
+
+// frame rate adaptation
+////////////////////////////////////////////////////////////////////////
+
 static void udp_sync_class_run(struct datap_desc *dp)
 {
 printf("UDP run\n");
    struct udp_sync_class *udp = (struct udp_sync_class*) dp->local;
    clock_gettime(CLOCK_MONOTONIC, &udp->bcast_time);
+   udp->rate_report_sec = now();
    /////////////////////////////////////////////////////////////////////
    // approach:
    //    send time sync packet every X seconds
@@ -200,8 +407,17 @@ printf("UDP run\n");
 printf("Send sync\n");
       send_sync_packet(type);
       //////
-      // run for X seconds, then send pause packet
-      if (sync_sleep(RUNNING_INTERVAL) < 0)
+      // run for X seconds, checking pipeline load periodically, then
+      //    send pause packet
+      int32_t aborted = 0;
+      for (uint32_t i=0; i<LOAD_CHECKS_PER_INTERVAL; i++) {
+         if (sync_sleep(UDP_SYNC_LOAD_CHECK_SEC) < 0) {
+            aborted = 1;
+            break;
+         }
+         adapt_frame_rate(udp);
+      }
+      if (aborted)
          break;
       send_sync_packet(UDP_SYNC_PACKET_PAUSE);
       // wait for a second to make sure network is quiet and then send
@@ -223,6 +439,11 @@ printf("UDP init\n");
    dp->local = udp;
    udp->sockfd = -1;
    memset((char*) &udp->sock_addr, 0, sizeof(udp->sock_addr));
+   udp->frame_interval = s_min_interval;
+   udp->settle_checks = UDP_SYNC_SETTLE_CHECKS;
+   udp->calm_checks = 0;
+   udp->frames_at_report = 0;
+   udp->rate_report_sec = 0.0;
    //
    pthread_mutex_init(&s_sync_mutex, NULL);
    // udp->bcast_time is set in _run
@@ -64,6 +64,40 @@ struct serial_packet_8 {
 };
 typedef struct serial_packet_8 serial_packet_8_type;
 
+// where data behind a heading command came from. sensor sample times
+//    are carried through each processing stage (in datap ts) so these
+//    are the times that data was originally measured. times from now()
+//    and negative when not available
+struct command_source {
+   // heading. when attitude was sampled, when attitude published it,
+   //    when driver read it and when command was ready to send
+   double attitude_sample_sec;
+   double attitude_publish_sec;
+   double attitude_fetch_sec;
+   double ready_sec;
+   // gps sample time of present position and of position that path
+   //    map was traced from
+   double position_sample_sec;
+   double path_map_sample_sec;
+   // camera sample time of traffic data (via panorama and associator)
+   double tracking_sample_sec;
+};
+typedef struct command_source command_source_type;
+
+// stages of command latency. first 5 cover heading data, from sensor
+//    sample to serial write. others are age of data at serial write
+enum command_latency_stage {
+   CMD_LATENCY_TOTAL,         // attitude sample to serial write
+   CMD_LATENCY_ATTITUDE,      // attitude sample to attitude publish
+   CMD_LATENCY_DRIVER_WAIT,   // attitude publish to driver read
+   CMD_LATENCY_ROUTE,         // driver read to command ready
+   CMD_LATENCY_SERIAL,        // command ready to serial write
+   CMD_LATENCY_POSITION,      // age of position
+   CMD_LATENCY_PATH_MAP,      // age of position path map traced from
+   CMD_LATENCY_TRACKING,      // age of traffic data
+   NUM_CMD_LATENCY_STAGES
+};
+
 #if defined(SIMULATE_DRIVER)
 struct datap_desc {
    int32_t run_state;
@@ -136,6 +170,29 @@ static tiller_data_type tiller_data_prev_ = { .all = 0 };
 uint32_t tiller_data_available_ = 0;
 uint32_t heading_data_available_ = 0;
 
+// written by driver along w/ heading data
+static command_source_type command_source_;
+
+#if !defined(SIMULATE_DRIVER)
+
+// how often command latency percentiles are written to log
+#define COMMAND_LATENCY_REPORT_SEC     60.0
+
+#define COMMAND_LATENCY_FILE     "command_latency.txt"
+
+static const char *CMD_LATENCY_LABELS[NUM_CMD_LATENCY_STAGES] = {
+   "command total", "attitude", "driver wait", "route", "serial",
+   "position age", "path map age", "tracking age"
+};
+
+// latency since last report, and for entire run. accessed only by comm
+//    thread, and by driver after comm thread exits
+static latency_stats_type command_latency_[NUM_CMD_LATENCY_STAGES];
+static latency_stats_type command_latency_run_[NUM_CMD_LATENCY_STAGES];
+static double command_latency_report_sec_ = -1.0;
+
+#endif   // SIMULATE_DRIVER
+
 
 ////////////////////////////////////////////////////////////////////////
 // serial setup
@@ -376,11 +433,15 @@ if ((ctr++ & 3) == 0) {
 
 // prepare heading data for serial transfer
 static void convert_heading_to_packet8(
-      /* in out */       serial_packet_8_type *serial_data
+      /* in out */       serial_packet_8_type *serial_data,
+      /*    out */       heading_data_type *sent,
+      /*    out */       command_source_type *sent_src
       )
 {
    // make copy of shared memory to send
    heading_data_type heading = heading_data_;
+   *sent = heading;
+   *sent_src = command_source_;
    //
    serial_data->data_all = 0;
    // take low-order 14 bits from int
@@ -398,6 +459,104 @@ static void convert_heading_to_packet8(
 // conversion
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
+// command latency
+
+#if !defined(SIMULATE_DRIVER)
+
+// measure age of data behind command that was just sent to autopilot,
+//    log it, and periodically log percentiles
+static void record_command_latency(
+      /* in     */ const command_source_type *src,
+      /* in     */ const double sent_sec
+      )
+{
+   double dt[NUM_CMD_LATENCY_STAGES];
+   uint32_t valid[NUM_CMD_LATENCY_STAGES];
+   memset(valid, 0, sizeof valid);
+   if (src->attitude_sample_sec >= 0.0) {
+      dt[CMD_LATENCY_TOTAL] = sent_sec - src->attitude_sample_sec;
+      valid[CMD_LATENCY_TOTAL] = 1;
+      if (src->attitude_publish_sec >= 0.0) {
+         dt[CMD_LATENCY_ATTITUDE] =
+               src->attitude_publish_sec - src->attitude_sample_sec;
+         dt[CMD_LATENCY_DRIVER_WAIT] =
+               src->attitude_fetch_sec - src->attitude_publish_sec;
+         valid[CMD_LATENCY_ATTITUDE] = 1;
+         valid[CMD_LATENCY_DRIVER_WAIT] = 1;
+      }
+      dt[CMD_LATENCY_ROUTE] = src->ready_sec - src->attitude_fetch_sec;
+      valid[CMD_LATENCY_ROUTE] = 1;
+   }
+   dt[CMD_LATENCY_SERIAL] = sent_sec - src->ready_sec;
+   valid[CMD_LATENCY_SERIAL] = 1;
+   const double sample_sec[] = { src->position_sample_sec,
+         src->path_map_sample_sec, src->tracking_sample_sec };
+   for (uint32_t i=0; i<3; i++) {
+      if (sample_sec[i] >= 0.0) {
+         dt[CMD_LATENCY_POSITION + i] = sent_sec - sample_sec[i];
+         valid[CMD_LATENCY_POSITION + i] = 1;
+      }
+   }
+   for (uint32_t i=0; i<NUM_CMD_LATENCY_STAGES; i++) {
+      if (valid[i] != 0) {
+         latency_add(&command_latency_[i], dt[i]);
+      } else {
+         dt[i] = -1.0;
+      }
+   }
+   log_info(driver_->log, "  age %.1fms (attitude %.1f  "
+         "wait %.1f  route %.1f  serial %.1f)  position %.1f  map %.1f  "
+         "tracking %.1f", 1000.0 * dt[CMD_LATENCY_TOTAL], 1000.0 * dt[CMD_LATENCY_ATTITUDE],
+         1000.0 * dt[CMD_LATENCY_DRIVER_WAIT], 1000.0 * dt[CMD_LATENCY_ROUTE],
+         1000.0 * dt[CMD_LATENCY_SERIAL], 1000.0 * dt[CMD_LATENCY_POSITION],
+         1000.0 * dt[CMD_LATENCY_PATH_MAP], 1000.0 * dt[CMD_LATENCY_TRACKING]);
+   /////////////////////////////
+   if (command_latency_report_sec_ < 0.0) {
+      command_latency_report_sec_ = sent_sec;
+   } else if ((sent_sec - command_latency_report_sec_) >=
+         COMMAND_LATENCY_REPORT_SEC) {
+      for (uint32_t i=0; i<NUM_CMD_LATENCY_STAGES; i++) {
+         log_latency_summary(driver_->log, &command_latency_[i],
+               CMD_LATENCY_LABELS[i]);
+         latency_merge(&command_latency_run_[i], &command_latency_[i]);
+         latency_reset(&command_latency_[i]);
+      }
+      command_latency_report_sec_ = sent_sec;
+   }
+}
+
+
+// write percentiles of command latency over entire run to log folder.
+//    must not be called while comm thread is running
+static void write_command_latency_summary(void)
+{
+   char name[STR_LEN];
+   snprintf(name, STR_LEN, "%s%s", get_log_folder_name(),
+         COMMAND_LATENCY_FILE);
+   FILE *fp = fopen(name, "w");
+   if (!fp) {
+      log_err(driver_->log, "Unable to write '%s': %s", name,
+            strerror(errno));
+      return;
+   }
+   fprintf(fp, "# age of data behind commands sent to autopilot\n");
+   for (uint32_t i=0; i<NUM_CMD_LATENCY_STAGES; i++) {
+      latency_merge(&command_latency_run_[i], &command_latency_[i]);
+      latency_reset(&command_latency_[i]);
+      char buf[STR_LEN];
+      latency_summary(&command_latency_run_[i], CMD_LATENCY_LABELS[i],
+            buf, STR_LEN);
+      fprintf(fp, "%s\n", buf);
+      log_info(driver_->log, "Run latency %s", buf);
+   }
+   fclose(fp);
+}
+
+#endif   // SIMULATE_DRIVER
+
+// command latency
+////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
 // main
 
 static void comm_handler_sigusr1(int x)
@@ -445,13 +604,22 @@ if ((ctr++ & 7) == 0) {
       // post updated data if it's available
       if (heading_data_available_ != 0) {
          // heading data's changed. post data to autopilot
-         convert_heading_to_packet8(&out_data);
+         heading_data_type heading;
+         command_source_type src;
+         convert_heading_to_packet8(&out_data, &heading, &src);
          heading_data_available_ = 0;
          post_heading(&out_data);
          //
 #if !defined(SIMULATE_DRIVER)
          log_info(driver_->log, "crs %d  head %d",
-               heading_data_.course, heading_data_.heading);
+               heading.course, heading.heading);
+         // age is only meaningful if command went out on serial port
+         if (serial_fd_ >= 0) {
+            record_command_latency(&src, now());
+         }
+#else
+         (void) heading;
+         (void) src;
 #endif // SIMULATE_DRIVER
       }
       if (serial_fd_ < 0) {
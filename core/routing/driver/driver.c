@@ -25,6 +25,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include "timekeeper.h"
+#include "latency.h"
 
 #include "routing/driver.h"
 #include "routing/mapping.h"
@@ -381,6 +382,7 @@ static void driver_post_run(struct datap_desc *self)
       log_err(driver_->log, "Failed in pthread_join: %s\n", strerror(rc));
       // we're exiting so just continue and treat error as fact of life
    }
+   write_command_latency_summary();
 }
 
 
@@ -444,6 +446,7 @@ void * driver_init(void *driver_setup)
    driver_->path_map = create_path_map(world_map_size);
    meter_type route_node_width = { .meters = ROUTE_NODE_WIDTH_MET };
    driver_->route_map = create_route_map(route_node_width);
+   init_route_geometry(driver_->route_map);
    // set negative position times to flag that position data is invalid
    // this should disable using map for routing info
    driver_->vessel.estimated_pos_time = 0;
@@ -454,6 +457,9 @@ void * driver_init(void *driver_setup)
 #endif   // USE_TRACKING
    driver_->position_sec = -1000.0;
    driver_->attitude_sec = -1000.0;
+   driver_->attitude_publish_sec = -1000.0;
+   driver_->attitude_fetch_sec = -1000.0;
+   driver_->path_map_position_sec = -1000.0;
    // initialize position to somewhere in deep water, far from land
    set_dummy_position();
    // in case default speed was set before driver was created, pull in
@@ -30,98 +30,188 @@ static const double viability_interval_end_[NUM_VIABILITY_INTERVALS] = {
    VIABILITY_INTERVAL_END_4
 };
 
+////////////////////////////////////////////////////////////////////////
+// route map geometry
+
+// which radials each route node covers, and the distance range over
+//    which the vessel is in that node, depend only on the node's position
+//    in the route map. these are computed once, at startup, and stored
+//    in a compact table in the same order as route map nodes
+struct route_node_geometry {
+   // distance from vessel to near and far sides of node
+   float dist_near_m;
+   float dist_far_m;
+   // first radial that crosses node, and number of additional radials
+   //    (node covers radials first_radial to first_radial+num_more_radials,
+   //    mod 256)
+   uint8_t first_radial;
+   uint8_t num_more_radials;
+};
+typedef struct route_node_geometry route_node_geometry_type;
+
+static route_node_geometry_type *route_geometry_ = NULL;
+static uint32_t num_route_geometry_nodes_ = 0;
+
+// time spent in each stage of plot_route, for reporting
+struct route_stage_timing {
+   double reset_sec;
+   double terrain_sec;
+   double radials_sec;
+   double traffic_sec;
+   double select_sec;
+   uint32_t num_cycles;
+   double last_report_sec;
+};
+typedef struct route_stage_timing route_stage_timing_type;
+
+static route_stage_timing_type route_timing_;
+
+// terrain scores, per path map node
+struct terrain_cache {
+   double *score;
+   // epoch when score was set. scores are valid when this equals
+   //    cur_epoch
+   uint32_t *epoch;
+   uint32_t cur_epoch;
+   // path map feature generation that cur_epoch corresponds to
+   uint32_t feature_generation;
+   // path map nodes covered by route map, and nodes that had to be
+   //    scored (ie, that weren't in cache), since last timing report
+   uint32_t nodes_in_window;
+   uint32_t nodes_scored;
+};
+typedef struct terrain_cache terrain_cache_type;
+
+static terrain_cache_type terrain_cache_;
+
+
+// build geometry table from route map. route map node positions must
+//    already be set (ie, route map created)
+static void init_route_geometry(
+      /* in     */ const route_map_type *route_map
+      )
+{
+   image_size_type size = route_map->size;
+   const uint32_t num_nodes = (uint32_t) (size.x * size.y);
+   // 'radius' of routing map (ie, width/2 in meters)
+   const double routing_radius_met =
+         route_map->node_width.meters * size.x / 2;
+   // 'radius' of routing node. radius here is to corners, not sides. this
+   //    will result in overlap between nodes but as we're only looking at
+   //    intersecting paths, that will provide some safety cushion
+   const double route_node_radius_met = route_map->node_width.meters / 1.414;
+   if (route_geometry_ != NULL) {
+      free(route_geometry_);
+   }
+   route_geometry_ = malloc(num_nodes * sizeof *route_geometry_);
+   for (uint32_t idx=0; idx<num_nodes; idx++) {
+      const route_map_node_type *node = &route_map->nodes[idx];
+      route_node_geometry_type *geom = &route_geometry_[idx];
+      // left scoresec
+      uint32_t start = node->radial_left_edge.angle16;
+      // delta between left and right
+      uint32_t delta = (uint16_t) (node->radial_right_edge.angle16 -
+            node->radial_left_edge.angle16);
+      // right scoresec -- unwound in sense can be greater than uint16
+      uint32_t end = (uint32_t) (start + delta);
+      start >>= 8;
+      end >>= 8;
+      assert(end - start < NUM_ROUTE_RADIALS);
+      geom->first_radial = (uint8_t) start;
+      geom->num_more_radials = (uint8_t) (end - start);
+      assert(node->distance.radians >= 0.0);
+      double dist_near_m = node->distance.radians * routing_radius_met
+            - route_node_radius_met;
+      if (dist_near_m < 0.0) {
+         dist_near_m = 0.0;
+      }
+      geom->dist_near_m = (float) dist_near_m;
+      geom->dist_far_m = (float) (node->distance.radians * routing_radius_met
+            + route_node_radius_met);
+   }
+   num_route_geometry_nodes_ = num_nodes;
+}
+
+// route map geometry
+////////////////////////////////////////////////////////////////////////
+
 ////////////////////////////////////////////////////////////////////////
 // land avoidance
 
 // assess path viability as function of terrain
 
 // push viability score of each node to radials that node covers
+// a node affects the viability intervals from when the vessel reaches
+//    the node through when it leaves it. at constant speed these are
+//    distances, so interval ends are converted to distances once per
+//    call rather than converting each node's distance to time
 static void push_node_viabilities_to_radials(
-      /* in out */       route_map_type *route_map
+      /* in out */       route_map_type *route_map,
+      /* in     */ const vessel_position_info_type *vessel_info,
+      /* in     */ const route_info_type *route_info
       )
 {
    radial_viability_type *radials = route_map->radials;
+   // if vessel has no speed then it's possible that the speed
+   //    indicator is broken. use default speed
+   double speed_mps = vessel_info->speed.mps;
+   if (speed_mps <= 0.0) {
+      assert(route_info->default_speed.mps > 0.0);
+      speed_mps = route_info->default_speed.mps;
+   }
+   double ival_end_met[NUM_VIABILITY_INTERVALS];
+   for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+      ival_end_met[ival] = viability_interval_end_[ival] * speed_mps;
+   }
    //////////
    // update radials w/ route node values
-   image_size_type size = route_map->size;
-   uint32_t idx = 0;
-//FILE *fp = fopen("/tmp/path.pnm", "w");
-//fprintf(fp, "P6\n%d %d\n255\n", size.cols, size.rows);
-   for (uint32_t y=0; y<size.y; y++) {
-      for (uint32_t x=0; x<size.x; x++) {
-         route_map_node_type *node = &route_map->nodes[idx++];
-         // left scoresec
-         uint32_t start = node->radial_left_edge.angle16;
-         // delta between left and right
-         uint32_t delta = (uint16_t) (node->radial_right_edge.angle16 -
-               node->radial_left_edge.angle16);
-         // right scoresec -- unwound in sense can be greater than uint16
-         uint32_t end = (uint32_t) (start + delta);
-         start >>= 8;
-         end >>= 8;
-//double vals[5];
-//for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
-//   vals[ival] = node->viability.terrain_score[ival];
-//}
-//double a = vals[0] < vals[1] ? vals[0] : vals[1];
-//double b = vals[2] < vals[3] ? vals[2] : vals[3];
-//double c = vals[4];
-//uint8_t rgb[3];
-//rgb[0] = (uint8_t) (a * 255.0);
-//rgb[1] = (uint8_t) (b * 255.0);
-//rgb[2] = (uint8_t) (c * 255.0);
-//fwrite(rgb, 1, 3, fp);
-         ///////////////////
-         // push viability score for each radial at each time
-         const double terrain_score = node->terrain_score;
-         if (terrain_score < 1.0) {
-            uint32_t start_ival = NUM_VIABILITY_INTERVALS;
-            uint32_t end_ival = NUM_VIABILITY_INTERVALS - 1;
-            // find arrival interval. this is first interval where
-            //    arrival time is before interval end
-            // get departure interval. this is the interval where
-            //    interval_end is after departure time. this covers
-            //    the case where start of interval was still w/in
-            //    route node
-            double arrival_sec = node->arrival_dt_sec;
-            double exit_sec = node->exit_dt_sec;
-            for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
-               double ival_end_sec = viability_interval_end_[ival];
-//printf("  %d ival_end %.3f  arrival %.3f   exit %.3f\n", ival, ival_end_sec, arrival_sec, exit_sec);
-               if (arrival_sec < ival_end_sec) {
-                  if (start_ival == NUM_VIABILITY_INTERVALS) {
-                     start_ival = ival;
-                  }
-                  if (ival_end_sec > exit_sec) {
-                     end_ival = ival;
-                     break;
-                  }
-               }
-            }
-//if (start_ival < 4) {
-//   printf("node %d,%d   score %.5f   ival %d,%d   arc %d,%d (%d)   arr %.3f  exit %.3f\n", x, y, terrain_score, start_ival, end_ival, start, end, delta, arrival_sec, exit_sec);
-//}
-            // push score to all radials that cross through this node
-            //    over relevant intervals
-            for (uint32_t bin=start; bin<=end; bin++) {
-               uint32_t radial = bin & 255;
-               for (uint32_t ival=start_ival; ival<=end_ival; ival++) {
-                  if (terrain_score < radials[radial].terrain_score[ival]) {
-                     radials[radial].terrain_score[ival] = terrain_score;
-                  }
-               }
+   const route_node_geometry_type *geom = route_geometry_;
+   const route_map_node_type *node = route_map->nodes;
+   for (uint32_t idx=0; idx<num_route_geometry_nodes_; idx++) {
+      const double terrain_score = node[idx].terrain_score;
+      if (terrain_score >= 1.0) {
+         continue;
+      }
+      // find arrival interval. this is first interval where
+      //    arrival is before interval end
+      const double dist_near_m = (double) geom[idx].dist_near_m;
+      uint32_t start_ival = 0;
+      while ((start_ival < NUM_VIABILITY_INTERVALS) &&
+            (dist_near_m >= ival_end_met[start_ival])) {
+         start_ival++;
+      }
+      if (start_ival == NUM_VIABILITY_INTERVALS) {
+         continue;
+      }
+      // get departure interval. this is the interval where
+      //    interval_end is after departure. this covers
+      //    the case where start of interval was still w/in
+      //    route node
+      const double dist_far_m = (double) geom[idx].dist_far_m;
+      uint32_t end_ival = start_ival;
+      while ((end_ival < NUM_VIABILITY_INTERVALS - 1) &&
+            (dist_far_m >= ival_end_met[end_ival])) {
+         end_ival++;
+      }
+      ///////////////////
+      // push score to all radials that cross through this node
+      //    over relevant intervals
+      const uint32_t first_radial = geom[idx].first_radial;
+      for (uint32_t n=0; n<=geom[idx].num_more_radials; n++) {
+         radial_viability_type *radial = &radials[(first_radial + n) & 255];
+         for (uint32_t ival=start_ival; ival<=end_ival; ival++) {
+            if (terrain_score < radial->terrain_score[ival]) {
+               radial->terrain_score[ival] = terrain_score;
             }
          }
       }
    }
-//fclose(fp);
 }
 
 
-// sets terrain_score for this route node
-static void update_terrain_viability(
-      /* in     */       map_feature_node_type *feature_node,
-      /* in     */       route_map_node_type *route_node
+// returns terrain score for path map node
+static double calc_terrain_viability(
+      /* in     */ const map_feature_node_type *feature_node
       )
 {
    double score = 1.0f;
@@ -161,28 +251,64 @@ static void update_terrain_viability(
    } else if (feature_node->near_cnt > 0) {
       score *= TERRAIN_PENALTY_SEMI_ADJACENT_NON_PASSABLE;
    }
-   route_node->terrain_score = score;
 //printf("%.5f\n", score);
+   return score;
 }
 
 
 // evaluate world map to determine areas to avoid
+// terrain score depends only on the path map node, and each path map
+//    node spans several route nodes. scores are cached per path map node
+//    and only path map nodes that have entered the route window since
+//    the last cycle, or all of them if map features changed, are scored
 static void assess_terrain_risks(
       /* in     */ const path_map_type *path_map,
       /* in out */       route_map_type *route_map
       )
 {
+   terrain_cache_type *cache = &terrain_cache_;
+   const uint32_t num_map_nodes =
+         (uint32_t) (path_map->size.x * path_map->size.y);
+   if (cache->score == NULL) {
+      cache->score = malloc(num_map_nodes * sizeof *cache->score);
+      cache->epoch = calloc(num_map_nodes, sizeof *cache->epoch);
+   }
+   if ((cache->cur_epoch == 0) ||
+         (cache->feature_generation != path_map->feature_generation)) {
+      // map content changed. start new epoch, which invalidates all
+      //    cached scores
+      cache->cur_epoch++;
+      if (cache->cur_epoch == 0) {
+         // wrapped. clear stamps so old ones can't match
+         memset(cache->epoch, 0, num_map_nodes * sizeof *cache->epoch);
+         cache->cur_epoch = 1;
+      }
+      cache->feature_generation = path_map->feature_generation;
+   }
+   // route map is aligned w/ path map, so path map nodes it covers form
+   //    a rectangle bounded by path map nodes of first and last route nodes
    image_size_type size = route_map->size;
-   uint32_t route_idx = 0;
-   for (uint32_t y=0; y<size.y; y++) {
-      for (uint32_t x=0; x<size.x; x++) {
-//printf("node %d,%d  ", x, y);
-         route_map_node_type *node = &route_map->nodes[route_idx++];
-         map_feature_node_type *feature_node =
-               &path_map->feature_nodes[node->world_node_idx];
-         update_terrain_viability(feature_node, node);
+   const uint32_t num_route_nodes = (uint32_t) (size.x * size.y);
+   const image_coordinate_type top_left = route_map->nodes[0].world_pos;
+   const image_coordinate_type bottom_right =
+         route_map->nodes[num_route_nodes-1].world_pos;
+   for (uint32_t y=top_left.y; y<=bottom_right.y; y++) {
+      uint32_t idx = top_left.x + y * path_map->size.x;
+      for (uint32_t x=top_left.x; x<=bottom_right.x; x++, idx++) {
+         if (cache->epoch[idx] != cache->cur_epoch) {
+            cache->score[idx] =
+                  calc_terrain_viability(&path_map->feature_nodes[idx]);
+            cache->epoch[idx] = cache->cur_epoch;
+            cache->nodes_scored++;
+         }
       }
    }
+   cache->nodes_in_window += (bottom_right.x - top_left.x + 1u) *
+         (bottom_right.y - top_left.y + 1u);
+   for (uint32_t route_idx=0; route_idx<num_route_nodes; route_idx++) {
+      route_map_node_type *node = &route_map->nodes[route_idx];
+      node->terrain_score = cache->score[node->world_node_idx];
+   }
 }
 
 // land avoidance
@@ -335,58 +461,62 @@ static void calc_desired_heading_score(
 // arc score is a measure of the arc width of passage along each radial
 // low score indicates shallow and/or narrow passage; high score indicates
 //    deep water and wide arc for passage
+// for each interval, viability values are copied to contiguous arrays
+//    that are padded on both ends w/ the values that wrap around the
+//    circle. that lets each step outward from the base radial be done
+//    for all base radials at once, which the compiler can vectorize
 static void calculate_arc_scores(
       /* in out */       route_map_type *route_map
 
       )
 {
    enum { TERRAIN, STAND_ON, GIVE_WAY, NUM_VIABILITIES };
-   const int32_t ARC_SIZE = 24;
+   enum { ARC_SIZE = 24 };
    const double scale = 1.0 / (double) ARC_SIZE;
 //printf("Scale: %f\n", (double) scale);
    radial_viability_type *radials = route_map->radials;
+   // viability values, w/ radial N at [ARC_SIZE+N]
+   double value[NUM_VIABILITIES][NUM_ROUTE_RADIALS + 2 * ARC_SIZE];
+   double ceiling[NUM_VIABILITIES][NUM_ROUTE_RADIALS];
+   double score[NUM_VIABILITIES][NUM_ROUTE_RADIALS];
    //
    for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
-      for (uint32_t base=0; base<NUM_ROUTE_RADIALS; base++) {
+      for (uint32_t i=0; i<NUM_ROUTE_RADIALS + 2*ARC_SIZE; i++) {
+         // uint8 wraps around at 256 so we can avoid fancy clock logic
+         const radial_viability_type *radial =
+               &radials[(uint8_t) (i - ARC_SIZE)];
+         value[TERRAIN][i] = radial->terrain_score[ival];
+         value[STAND_ON][i] = radial->stand_on_score[ival];
+         value[GIVE_WAY][i] = radial->give_way_score[ival];
+      }
+      for (uint32_t j=0; j<NUM_VIABILITIES; j++) {
          // get score for traversable arc size on base radial
          // look left and right X radials. define arc as sum of scores
          //    on radial with restriction that score for radial is <=
          //    lowest score of radials closest to base
-         double ceiling[NUM_VIABILITIES];
-         ceiling[TERRAIN] = radials[base].terrain_score[ival];
-         ceiling[STAND_ON] = radials[base].stand_on_score[ival];
-         ceiling[GIVE_WAY] = radials[base].give_way_score[ival];
-         double score[NUM_VIABILITIES];
-         for (uint32_t i=0; i<NUM_VIABILITIES; i++) {
-            score[i] = ceiling[i];
+         const double *center = &value[j][ARC_SIZE];
+         for (uint32_t base=0; base<NUM_ROUTE_RADIALS; base++) {
+            ceiling[j][base] = center[base];
+            score[j][base] = center[base];
          }
-         // uint8 wraps around at 256 so we can avoid fancy clock logic
-         uint8_t left_idx = (uint8_t) (base - 1);
-         uint8_t right_idx = (uint8_t) (base + 1);
          for (int32_t r=1; r<ARC_SIZE; r++) {
             // get values on left and right for distance r
             // score for each viability type is lowest of left and right
             //    values and of previous lowest value
-            double left[NUM_VIABILITIES];
-            left[TERRAIN] = radials[left_idx].terrain_score[ival];
-            left[STAND_ON] = radials[left_idx].stand_on_score[ival];
-            left[GIVE_WAY] = radials[left_idx].give_way_score[ival];
-            double right[NUM_VIABILITIES];
-            right[TERRAIN] = radials[right_idx].terrain_score[ival];
-            right[STAND_ON] = radials[right_idx].stand_on_score[ival];
-            right[GIVE_WAY] = radials[right_idx].give_way_score[ival];
-            for (uint32_t j=0; j<NUM_VIABILITIES; j++) {
-               double low = left[j] < right[j] ? left[j] : right[j];
-               ceiling[j] = low < ceiling[j] ? low : ceiling[j];
-               score[j] += ceiling[j];
+            const double *left = &value[j][ARC_SIZE - r];
+            const double *right = &value[j][ARC_SIZE + r];
+            for (uint32_t base=0; base<NUM_ROUTE_RADIALS; base++) {
+               double low = left[base] < right[base] ? left[base] : right[base];
+               double ceil = low < ceiling[j][base] ? low : ceiling[j][base];
+               ceiling[j][base] = ceil;
+               score[j][base] += ceil;
             }
-            // advance indices
-            left_idx--;
-            right_idx++;
          }
-         radials[base].terrain_arc[ival] = scale * score[TERRAIN];
-         radials[base].stand_on_arc[ival] = scale * score[STAND_ON];
-         radials[base].give_way_arc[ival] = scale * score[GIVE_WAY];
+      }
+      for (uint32_t base=0; base<NUM_ROUTE_RADIALS; base++) {
+         radials[base].terrain_arc[ival] = scale * score[TERRAIN][base];
+         radials[base].stand_on_arc[ival] = scale * score[STAND_ON][base];
+         radials[base].give_way_arc[ival] = scale * score[GIVE_WAY][base];
       }
    }
 }
@@ -521,6 +651,10 @@ double combine_subscores(
 // calculate scores for each radial at each interval
 // score based on agreement between radial and desired direction and
 //    also on width of arc around that's free from obstacles
+// lowest scores are tracked for all radials at once, one interval at a
+//    time, using the same rules as update_subscore() and
+//    combine_subscores(), but w/o branches so the compiler can vectorize
+//    across radials
 static void calc_radial_score(
       /* in out */       route_map_type *route_map
       )
@@ -539,80 +673,80 @@ static void calc_radial_score(
    radial_viability_type *radials = route_map->radials;
    // direction is selected based on radial with highest score, with each
    //    radial score being based on the lowest scores on that radial
-   for (uint32_t rad=0; rad<256; rad++) {
-      radial_viability_type *radial = &radials[rad];
-      // nearby risks are scored fully (short ival) while further
-      //    risks are used more for bias (ie, are given positive offsets)
-//      // take lowest score for all intervals for all modalities
-//      double min_collis = 20.0;
-//double min_stand_on = 2.0;
-//printf("rad %d     direction %.3f\n", rad, (double) radial->direction_score);
-//if ((rad & 7) == 0) {
-//   printf("rad %d (%.1f)    direction %.3f\n", rad, (double) rad * BAM8_TO_DEG, (double) radial->direction_score);
-//}
-      // for each modality, use harmonic average to combine lowest scores
-      // first attempt was to use lowest score on radial for all modalities.
-      //    this failed because if there was a very low score on all
-      //    modalities (e.g., because vessel was in very shallow water)
-      //    then all radials would return that low score, and the first
-      //    radial (ie, north) would be selected
-      // now take into account multiple low scores. this can be done
-      //    by selecting lowest 2 or 3 and combining those in a weighted
-      //    harmonic mean. do this on each modality separately and
-      //    later combine modalities
-      double lowest_terrain[2] = { 1.0, 1.0 };
-      double lowest_stand_on[2] = { 1.0, 1.0 };
-      // how many repeats there are of lowest score
-      int32_t terrain_repeats = 0;
-      int32_t stand_on_repeats = 0;
-      //
-      //    depth
+   // nearby risks are scored fully (short ival) while further
+   //    risks are used more for bias (ie, are given positive offsets)
+   // for each modality, use harmonic average to combine lowest scores
+   // first attempt was to use lowest score on radial for all modalities.
+   //    this failed because if there was a very low score on all
+   //    modalities (e.g., because vessel was in very shallow water)
+   //    then all radials would return that low score, and the first
+   //    radial (ie, north) would be selected
+   // now take into account multiple low scores. this can be done
+   //    by selecting lowest 2 or 3 and combining those in a weighted
+   //    harmonic mean. do this on each modality separately and
+   //    later combine modalities
+   enum { TERRAIN, STAND_ON, NUM_MODALITIES };
+   double value[NUM_MODALITIES][NUM_VIABILITY_INTERVALS][NUM_ROUTE_RADIALS];
+   double lowest[NUM_MODALITIES][2][NUM_ROUTE_RADIALS];
+   // how many repeats there are of lowest score
+   double repeats[NUM_MODALITIES][NUM_ROUTE_RADIALS];
+   double modality_score[NUM_MODALITIES][NUM_ROUTE_RADIALS];
+   double direction_score[NUM_ROUTE_RADIALS];
+   for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+      const radial_viability_type *radial = &radials[rad];
       for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
-         double offset = ival_offset[ival];
-         double scale = 1.0 - offset;
-         //
-         double ter = offset + radial->terrain_score[ival] * scale;
-         double sta = offset + radial->stand_on_score[ival] * scale;
-         update_subscore(lowest_terrain, &terrain_repeats, ter);
-         update_subscore(lowest_stand_on, &stand_on_repeats, sta);
-//if ((rad & 7) == 0) {
-//   printf("  %d   ter: %.4f    col: %.4f   giv: %.4f\n", ival, ter, sta, radial->give_way_score[ival]);
-//   //printf("  %d     %.4f\n", ival, (double) radial->terrain_score[ival]);
-//}
+         value[TERRAIN][ival][rad] = radial->terrain_score[ival];
+         value[STAND_ON][ival][rad] = radial->stand_on_score[ival];
       }
-      double terrain_score =
-            combine_subscores(lowest_terrain, terrain_repeats);
-      double stand_on_score =
-            combine_subscores(lowest_stand_on, stand_on_repeats);
-//if ((rad & 7) == 0) {
-//   printf("      ter: %.4f    col: %.4f\n", terrain_score, stand_on_score);
-//}
-      // also use radial->direction_score
-      assert(terrain_score > 0.0);
-      assert(stand_on_score > 0.0);
-      assert(radial->direction_score > 0.0);
-      //
-      // combine these scores
-      const double terrain_wt = 2.0;
-      const double stand_on_wt = 2.0;
-      const double direction_wt = 1.0;
-      double score = terrain_wt + stand_on_wt + direction_wt;
-      score /= terrain_wt / terrain_score +
-            stand_on_wt / stand_on_score +
-            direction_wt / radial->direction_score;
-      assert(score > 0.0);
-//assert(score > 0.000);
-//if ((rad & 3) == 0) {
-//   printf("%.3d  dir: %.3f  stand_on: %.3f   collis: %.3f   -> %.3f\n", rad, (double) radial->direction_score, (double) min_stand_on, (double) min_collis, (double) score);
-//}
-//printf("%.3d  dir: %.3f  stand_on: %.3f   collis: %.3f  -> %.3f\n", rad, (double) radial->direction_score, (double) min_stand_on, (double) min_collis, (double) score);
-      radial->net_score = score;
-//if ((rad & 7) == 0) {
-//   printf("%d  \t\tdirection score %.4f   net %.4f\n", rad, (double) radial->direction_score, (double) radial->net_score);
-//   //printf("  %d     %.4f\n", ival, (double) radial->terrain_score[ival]);
-//}
+      direction_score[rad] = radial->direction_score;
+   }
+   for (uint32_t m=0; m<NUM_MODALITIES; m++) {
+      double *low_0 = lowest[m][0];
+      double *low_1 = lowest[m][1];
+      double *reps = repeats[m];
+      for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+         low_0[rad] = 1.0;
+         low_1[rad] = 1.0;
+         reps[rad] = 0.0;
+      }
+      for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+         const double offset = ival_offset[ival];
+         const double scale = 1.0 - offset;
+         const double *val = value[m][ival];
+         for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+            const double sub = offset + val[rad] * scale;
+            const double l0 = low_0[rad];
+            const double l1 = low_1[rad];
+            const double next_l1 = sub < l1 ? sub : l1;
+            low_0[rad] = sub < l0 ? sub : l0;
+            low_1[rad] = sub < l0 ? l0 : (sub == l0 ? l1 : next_l1);
+            reps[rad] = sub < l0 ? 0.0 :
+                  (sub == l0 ? reps[rad] + 1.0 : reps[rad]);
+         }
+      }
+      for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+         const double weight = 7.0 + reps[rad] * 3.0;
+         modality_score[m][rad] = (weight + 1.0) /
+               (weight / low_0[rad] + 1.0 / low_1[rad]);
+      }
+   }
+   // combine these scores
+   const double terrain_wt = 2.0;
+   const double stand_on_wt = 2.0;
+   const double direction_wt = 1.0;
+   const double total_wt = terrain_wt + stand_on_wt + direction_wt;
+   for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+      radials[rad].net_score = total_wt /
+            (terrain_wt / modality_score[TERRAIN][rad] +
+            stand_on_wt / modality_score[STAND_ON][rad] +
+            direction_wt / direction_score[rad]);
+   }
+   for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+      assert(modality_score[TERRAIN][rad] > 0.0);
+      assert(modality_score[STAND_ON][rad] > 0.0);
+      assert(direction_score[rad] > 0.0);
+      assert(radials[rad].net_score > 0.0);
    }
-//exit(0);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -730,28 +864,19 @@ static void check_victory_conditions(
 
 // vessel is at center
 // update route node values. includes assigning route nodes to world and
-//    path map nodes. computes time to reach other route nodes, and thus
-//    underlying world nodes
+//    path map nodes. time to reach other route nodes is handled from the
+//    static geometry table when pushing viabilities to radials
 // also resets rest of node's state values
 // TODO interpolate depth in near-shore world nodes, to stay further away
 //    from edges of nodes containing hazards
 static void reset_route_nodes(
       /* in     */ const path_map_type *path_map,
       /* in out */       route_map_type *route_map,
-      /* in     */ const vessel_position_info_type *vessel_info,
-      /* in     */ const route_info_type *route_info
+      /* in     */ const vessel_position_info_type *vessel_info
       )
 {
    const world_coordinate_type vessel_pos = vessel_info->position;
    const meters_per_second_type vessel_speed = vessel_info->speed;
-   // 'radius' of routing map (ie, width/2 in meters)
-   const meter_type routing_radius =
-         { .meters = route_map->node_width.meters * route_map->size.x / 2 };
-   // 'radius' of routing node. radius here is to corners, not sides. this
-   //    will result in overlap between nodes but as we're only looking at
-   //    intersecting paths, that will provide some safety cushion
-   const meter_type route_node_radius =
-         { .meters = route_map->node_width.meters / 1.414 };
 printf(" vessel pos %.6f,%.6f  speed %.2f heading %.1f  xy mps:%.3f,%.3f\n", (double) vessel_pos.x_deg, (double) vessel_pos.y_deg, (double) vessel_speed.mps, (double) vessel_info->true_heading.tru.angle32 * BAM32_TO_DEG, (double) vessel_info->xy_motion.x_mps, (double) vessel_info->xy_motion.y_mps);
 //printf(" routing radius %.1f met    node radius %.1f met\n", (double) routing_radius.meters, (double) route_node_radius.meters);
    /////////////////////////////
@@ -826,29 +951,6 @@ assert(node->world_node_idx < 720 * 720);
          // default to "don't go to this node". that will be overriden
          //    when updating terrain viaiblity
          node->terrain_score = 0.0001;
-         // time to arrive at and leave node
-         double dist_near_m = node->distance.radians * routing_radius.meters
-               - route_node_radius.meters;
-         if (dist_near_m < 0.0) {
-            dist_near_m = 0.0;
-         }
-         double dist_far_m = node->distance.radians * routing_radius.meters
-               + route_node_radius.meters;
-assert(node->distance.radians >= 0.0);
-         if (vessel_speed.mps > 0.0) {
-            node->arrival_dt_sec = dist_near_m / vessel_speed.mps;
-            node->exit_dt_sec = dist_far_m / vessel_speed.mps;
-//printf("    arrive %.3f   exit %.3f    speed %.3f   dist_near %.3f   dist_far %.3f\n", node->arrival_dt_sec, node->exit_dt_sec, vessel_speed.mps, dist_near_m, dist_far_m);
-//printf(  "%d,%d  arrive %.3f   exit %.3f    speed %.3f   dist_near %.3f   dist_far %.3f\n", x, y, node->arrival_dt_sec, node->exit_dt_sec, vessel_speed.mps, dist_near_m, dist_far_m);
-         } else {
-            // if vessel has no speed then it's possible that the speed
-            //    indicator is broken. use default speed
-            assert(route_info->default_speed.mps > 0.0);
-            node->arrival_dt_sec = dist_near_m / route_info->default_speed.mps;
-            node->exit_dt_sec = dist_far_m / route_info->default_speed.mps;
-//printf("    arrive %.3f   exit %.3f    def speed %.3f   dist_near %.3f   dist_far %.3f\n", node->arrival_dt_sec, node->exit_dt_sec, route_info->default_speed.mps, dist_near_m, dist_far_m);
-//printf("  %d,%d  arrive %.3f   exit %.3f    def speed %.3f   dist_near %.3f   dist_far %.3f\n", x, y, node->arrival_dt_sec, node->exit_dt_sec, route_info->default_speed.mps, dist_near_m, dist_far_m);
-         }
       }
 //if (y&1) {
 //   printf("\n");
@@ -867,7 +969,10 @@ static void find_available_routes(
       )
 {
    // route map is rebuilt each time, centered on vessel
-   reset_route_nodes(path_map, route_map, vessel_info, route_info);
+   double t0 = system_now();
+   reset_route_nodes(path_map, route_map, vessel_info);
+   double t1 = system_now();
+   route_timing_.reset_sec += t1 - t0;
 //uint32_t center = (uint32_t) (route_map->size.x/2 + (route_map->size.y/2)*route_map->size.x);
 //printf("route center idx: %d (from %d,%d)\n", center, route_map->size.x, route_map->size.y);
 //route_map_node_type *rnode = &route_map->nodes[center];
@@ -877,7 +982,10 @@ static void find_available_routes(
    // only assess terrain risk if position info available and up to date
    if (route_info->flags2_persistent & ROUTE_INFO_HAVE_POSITION) {
       assess_terrain_risks(path_map, route_map);
-      push_node_viabilities_to_radials(route_map);
+      double t2 = system_now();
+      push_node_viabilities_to_radials(route_map, vessel_info, route_info);
+      route_timing_.terrain_sec += t2 - t1;
+      route_timing_.radials_sec += system_now() - t2;
       route_info->flags_state |= ROUTE_INFO_STATE_CHECK_TERRAIN;
    } else {
       // use last known position to get approximate direction
@@ -909,6 +1017,37 @@ static void clear_viability_radials(
 }
 
 
+// logs average time spent in each stage of plot_route, at the same
+//    cadence that commands are sent to the autopilot
+static void report_route_timing(
+      /* in     */ const double t_sec
+      )
+{
+   route_stage_timing_type *timing = &route_timing_;
+   timing->num_cycles++;
+   if ((t_sec - timing->last_report_sec) < OTTO_COMMAND_INTERVAL_SEC) {
+      return;
+   }
+   const double scale = 1000.0 / (double) timing->num_cycles;
+   log_info(log_, "Route timing (ms/cycle over %d cycles): map %.3f  "
+         "terrain %.3f  radials %.3f  traffic %.3f  select %.3f",
+         timing->num_cycles, timing->reset_sec * scale,
+         timing->terrain_sec * scale, timing->radials_sec * scale,
+         timing->traffic_sec * scale, timing->select_sec * scale);
+   terrain_cache_type *cache = &terrain_cache_;
+   if (cache->nodes_in_window > 0) {
+      log_info(log_, "Terrain cache hit rate %.1f%% (%d of %d map nodes "
+            "scored)", 100.0 * (1.0 - (double) cache->nodes_scored /
+            (double) cache->nodes_in_window), cache->nodes_scored,
+            cache->nodes_in_window);
+   }
+   cache->nodes_in_window = 0;
+   cache->nodes_scored = 0;
+   memset(timing, 0, sizeof *timing);
+   timing->last_report_sec = t_sec;
+}
+
+
 // establish course through local traffic and obstacles
 // follows path map flow as closely as practical, with constraint that
 //    course changes are assumed to be infrequent
@@ -937,12 +1076,14 @@ printf("Plotting route from %.6f,%.6f   dps %f,%f\n", (double) vessel_info->posi
    // identify routes that avoid water hazards (eg, shallowness and land)
    find_available_routes(path_map, route_map, route_info, vessel_info);
    // find routes that reduce collision risk
+   double t0 = system_now();
 #if defined(USE_TRACKING)
    analyze_traffic(ass_out, route_info, vessel_info, route_map, t_sec);
 #else
    (void) ass_out;
-   (void) t_sec;
 #endif   // USE_TRACKING
+   double t1 = system_now();
+   route_timing_.traffic_sec += t1 - t0;
    /////////////////////
    if ((route_info->flags_state & ROUTE_INFO_STATE_CHECK_MASK) != 0) {
 //printf("selecting route\n");
@@ -950,12 +1091,14 @@ printf("Plotting route from %.6f,%.6f   dps %f,%f\n", (double) vessel_info->posi
       //    now, but an alert should signal that something's wrong
       //    w/ the data stream if both aren't present TODO
       select_route(path_map, route_map, route_info, vessel_info);
+      route_timing_.select_sec += system_now() - t1;
       check_victory_conditions(route_info, vessel_info);
    } else {
 printf("RUNNING BLIND\n");
       // terrain and traffic data not available so we're running blind
       route_info->flags_state |= ROUTE_INFO_STATE_RUNNING_BLIND;
    }
+   report_route_timing(t_sec);
 }
 
 #if NUM_ROUTE_RADIALS != 256
@@ -190,6 +190,21 @@ log_debug(log_, "Position %f,%f   pix %d,%d  delta(m) %.1f,%.1f", driver_->vesse
 //log_debug(log_, "Movement %f, limit %f", sqrt((double) mvmt_dist2), sqrt((double) mvmt_limit2));
    if (mvmt_dist2 < mvmt_limit2) {
       // vessel hasn't moved far enough -- no rebuild necessary
+      // if it's moved to a different node then beacons may have
+      //    entered or left the inhibition ring. replan for that. this
+      //    only does work if the set of beacons changed
+      if ((pres_pix.x != path_map->vessel_plan_pix.x) ||
+            (pres_pix.y != path_map->vessel_plan_pix.y)) {
+         if (replan_route(path_map, driver_->vessel.position) > 0) {
+            if (otto_heading_degs_ < 360) {
+               bam16_type heading;
+               CVT_DEG_TO_BAM16((double) otto_heading_degs_, heading);
+               override_active_course_all(path_map, heading);
+            }
+            driver_->path_changed = 1;
+            driver_->path_map_position_sec = driver_->position_sec;
+         }
+      }
       goto end;
    }
    /////////////////////////////////////////////
@@ -277,6 +292,7 @@ log_err(log_, "Updating map");
       }
       driver_->map_current = 1;
       driver_->path_changed = 1;
+      driver_->path_map_position_sec = driver_->position_sec;
 char buf[STR_LEN];
 sprintf(buf, "map-%d.pnm", ctr++);
 write_path_map(driver_->path_map, buf);
@@ -443,6 +459,19 @@ printf("  set pres course (path changed)\n");
       heading_data_.dps = (float) driver_->turn_rate.dps;
       heading_data_.heading = (uint16_t)
             (driver_->attitude_latest.true_heading.degrees + 0.5);
+      // record where data behind command came from, so its age can
+      //    be measured when it's sent
+      command_source_.attitude_sample_sec = driver_->attitude_sec;
+      command_source_.attitude_publish_sec = driver_->attitude_publish_sec;
+      command_source_.attitude_fetch_sec = driver_->attitude_fetch_sec;
+      command_source_.ready_sec = now();
+      command_source_.position_sample_sec = driver_->position_sec;
+      command_source_.path_map_sample_sec = driver_->path_map_position_sec;
+#if defined(USE_TRACKING)
+      command_source_.tracking_sample_sec = driver_->associator_sec;
+#else
+      command_source_.tracking_sample_sec = -1.0;
+#endif   // USE_TRACKING
       heading_data_available_ = 1;
    }
 }
@@ -469,6 +498,8 @@ static int32_t get_latest_attitude_data(void)
             dp_get_object_at(prod, p_idx);
       memcpy(&driver_->attitude_latest, out, sizeof *out);
       driver_->attitude_sec = prod->ts[p_idx];
+      driver_->attitude_publish_sec = dp_get_publish_time_at(prod, p_idx);
+      driver_->attitude_fetch_sec = now();
       driver_->turn_rate = out->turn_rate;
    }  // else, we already have the most recently measured attitude
    // if attitude data isn't available then there's not much we
@@ -0,0 +1,428 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "timekeeper.h"
+#include "logger.h"
+
+// checks that radial scoring gives the same radial values and selects
+//    the same route as the scalar code it replaced, and times both.
+//    route map snapshots are synthetic (terrain, traffic and desired
+//    heading) so no map data is needed
+// traffic analysis isn't exercised, so build w/o tracking
+#undef USE_TRACKING
+
+#include "../../mapping/world_map.c"
+#include "routing/driver.h"
+#include "../route.c"
+
+#define NUM_SNAPSHOTS   12
+
+struct snapshot {
+   // terrain score for each route node
+   double *terrain;
+   double stand_on[NUM_ROUTE_RADIALS][NUM_VIABILITY_INTERVALS];
+   bam16_type path_heading;
+   double speed_mps;
+};
+typedef struct snapshot snapshot_type;
+
+static snapshot_type snapshots_[NUM_SNAPSHOTS];
+
+
+// route map geometry as set by create_route_map()
+static route_map_type * create_test_route_map(void)
+{
+   route_map_type *route_map = calloc(1, sizeof *route_map);
+   route_map->size.x = ROUTE_MAP_WIDTH;
+   route_map->size.y = ROUTE_MAP_WIDTH;
+   route_map->node_width.meters = ROUTE_MAP_NODE_WIDTH_METERS;
+   route_map->nodes = calloc(ROUTE_MAP_WIDTH * ROUTE_MAP_WIDTH,
+         sizeof *route_map->nodes);
+   uint32_t idx = 0;
+   int32_t rad = route_map->size.x / 2;
+   for (int32_t y=-rad; y<=rad; y++) {
+      double dy = (double) abs(y) - 0.5;
+      if (dy < 0.0) {
+         dy = 0.0;
+      }
+      for (int32_t x=-rad; x<=rad; x++) {
+         route_map_node_type *node = &route_map->nodes[idx++];
+         node->pos.x = (int16_t) x;
+         node->pos.y = (int16_t) y;
+         if ((x | y) == 0) {
+            node->radial_right_edge.sangle16 = -1;
+            continue;
+         }
+         node->distance.radians =
+               sqrt((double) (x*x + y*y)) / (double) rad;
+         CVT_DEG_TO_BAM16(R2D * atan2((double) x, (double) -y),
+               node->radial);
+         double dx = (double) abs(x) - 0.5;
+         if (dx < 0.0) {
+            dx = 0.0;
+         }
+         bam16_type half_arc;
+         CVT_DEG_TO_BAM16(R2D * atan(0.5 / sqrt(dx * dx + dy * dy)),
+               half_arc);
+         node->radial_left_edge.angle16 =
+               (uint16_t) (node->radial.angle16 - half_arc.angle16);
+         node->radial_right_edge.angle16 =
+               (uint16_t) (node->radial.angle16 + half_arc.angle16);
+      }
+   }
+   init_route_geometry(route_map);
+   return route_map;
+}
+
+
+// islands and shoals around vessel, some traffic and a desired heading
+static void create_snapshots(void)
+{
+   const uint32_t num_nodes = ROUTE_MAP_WIDTH * ROUTE_MAP_WIDTH;
+   uint32_t seed = 17;
+   for (uint32_t n=0; n<NUM_SNAPSHOTS; n++) {
+      snapshot_type *snap = &snapshots_[n];
+      snap->terrain = malloc(num_nodes * sizeof *snap->terrain);
+      for (uint32_t i=0; i<num_nodes; i++) {
+         snap->terrain[i] = 1.0;
+      }
+      // more islands in later snapshots
+      for (uint32_t k=0; k<4+n*3; k++) {
+         seed = seed * 1103515245u + 12345u;
+         const int32_t cx = (int32_t) ((seed >> 8) % ROUTE_MAP_WIDTH);
+         seed = seed * 1103515245u + 12345u;
+         const int32_t cy = (int32_t) ((seed >> 8) % ROUTE_MAP_WIDTH);
+         const int32_t r = 2 + (int32_t) ((seed >> 4) % 20);
+         for (int32_t y=cy-r-4; y<=cy+r+4; y++) {
+            for (int32_t x=cx-r-4; x<=cx+r+4; x++) {
+               if ((x < 0) || (y < 0) || (x >= ROUTE_MAP_WIDTH) ||
+                     (y >= ROUTE_MAP_WIDTH)) {
+                  continue;
+               }
+               const int32_t d2 = (x-cx)*(x-cx) + (y-cy)*(y-cy);
+               double *score = &snap->terrain[x + y * ROUTE_MAP_WIDTH];
+               if (d2 <= r*r) {
+                  *score = 0.0001;
+               } else if ((d2 <= (r+4)*(r+4)) && (*score > 0.3)) {
+                  // shoal around island
+                  *score = 0.3;
+               }
+            }
+         }
+      }
+      for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+         for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+            snap->stand_on[rad][ival] = 1.0;
+         }
+      }
+      for (uint32_t k=0; k<n%4; k++) {
+         seed = seed * 1103515245u + 12345u;
+         const uint32_t center = (seed >> 8) & 255;
+         const uint32_t ival = (seed >> 16) % NUM_VIABILITY_INTERVALS;
+         for (uint32_t i=0; i<12; i++) {
+            snap->stand_on[(center + i) & 255][ival] = 0.05;
+         }
+      }
+      seed = seed * 1103515245u + 12345u;
+      snap->path_heading.angle16 = (uint16_t) (seed >> 8);
+      snap->speed_mps = 1.0 + (double) n;
+   }
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// scalar scoring, as it was before radial arrays were made contiguous
+
+static void reference_push(
+      /* in out */       route_map_type *route_map,
+      /* in     */ const double speed_mps
+      )
+{
+   radial_viability_type *radials = route_map->radials;
+   for (uint32_t idx=0; idx<num_route_geometry_nodes_; idx++) {
+      const route_node_geometry_type *geom = &route_geometry_[idx];
+      const double terrain_score = route_map->nodes[idx].terrain_score;
+      if (terrain_score >= 1.0) {
+         continue;
+      }
+      const double arrival_sec = (double) geom->dist_near_m / speed_mps;
+      const double exit_sec = (double) geom->dist_far_m / speed_mps;
+      uint32_t start_ival = NUM_VIABILITY_INTERVALS;
+      uint32_t end_ival = NUM_VIABILITY_INTERVALS - 1;
+      for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+         double ival_end_sec = viability_interval_end_[ival];
+         if (arrival_sec < ival_end_sec) {
+            if (start_ival == NUM_VIABILITY_INTERVALS) {
+               start_ival = ival;
+            }
+            if (ival_end_sec > exit_sec) {
+               end_ival = ival;
+               break;
+            }
+         }
+      }
+      uint32_t start = geom->first_radial;
+      uint32_t end = start + geom->num_more_radials;
+      for (uint32_t bin=start; bin<=end; bin++) {
+         uint32_t radial = bin & 255;
+         for (uint32_t ival=start_ival; ival<=end_ival; ival++) {
+            if (terrain_score < radials[radial].terrain_score[ival]) {
+               radials[radial].terrain_score[ival] = terrain_score;
+            }
+         }
+      }
+   }
+}
+
+
+static void reference_arc_scores(
+      /* in out */       route_map_type *route_map
+      )
+{
+   enum { TERRAIN, STAND_ON, GIVE_WAY, NUM_VIABILITIES };
+   const int32_t ARC_SIZE = 24;
+   const double scale = 1.0 / (double) ARC_SIZE;
+   radial_viability_type *radials = route_map->radials;
+   for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+      for (uint32_t base=0; base<NUM_ROUTE_RADIALS; base++) {
+         double ceiling[NUM_VIABILITIES];
+         ceiling[TERRAIN] = radials[base].terrain_score[ival];
+         ceiling[STAND_ON] = radials[base].stand_on_score[ival];
+         ceiling[GIVE_WAY] = radials[base].give_way_score[ival];
+         double score[NUM_VIABILITIES];
+         for (uint32_t i=0; i<NUM_VIABILITIES; i++) {
+            score[i] = ceiling[i];
+         }
+         uint8_t left_idx = (uint8_t) (base - 1);
+         uint8_t right_idx = (uint8_t) (base + 1);
+         for (int32_t r=1; r<ARC_SIZE; r++) {
+            double left[NUM_VIABILITIES];
+            left[TERRAIN] = radials[left_idx].terrain_score[ival];
+            left[STAND_ON] = radials[left_idx].stand_on_score[ival];
+            left[GIVE_WAY] = radials[left_idx].give_way_score[ival];
+            double right[NUM_VIABILITIES];
+            right[TERRAIN] = radials[right_idx].terrain_score[ival];
+            right[STAND_ON] = radials[right_idx].stand_on_score[ival];
+            right[GIVE_WAY] = radials[right_idx].give_way_score[ival];
+            for (uint32_t j=0; j<NUM_VIABILITIES; j++) {
+               double low = left[j] < right[j] ? left[j] : right[j];
+               ceiling[j] = low < ceiling[j] ? low : ceiling[j];
+               score[j] += ceiling[j];
+            }
+            left_idx--;
+            right_idx++;
+         }
+         radials[base].terrain_arc[ival] = scale * score[TERRAIN];
+         radials[base].stand_on_arc[ival] = scale * score[STAND_ON];
+         radials[base].give_way_arc[ival] = scale * score[GIVE_WAY];
+      }
+   }
+}
+
+
+static void reference_radial_score(
+      /* in out */       route_map_type *route_map
+      )
+{
+   const double ival_offset[NUM_VIABILITY_INTERVALS] = {
+      0.0, 0.1, 0.4, 0.8, 0.9
+   };
+   reference_arc_scores(route_map);
+   radial_viability_type *radials = route_map->radials;
+   for (uint32_t rad=0; rad<256; rad++) {
+      radial_viability_type *radial = &radials[rad];
+      double lowest_terrain[2] = { 1.0, 1.0 };
+      double lowest_stand_on[2] = { 1.0, 1.0 };
+      int32_t terrain_repeats = 0;
+      int32_t stand_on_repeats = 0;
+      for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+         double offset = ival_offset[ival];
+         double scale = 1.0 - offset;
+         double ter = offset + radial->terrain_score[ival] * scale;
+         double sta = offset + radial->stand_on_score[ival] * scale;
+         update_subscore(lowest_terrain, &terrain_repeats, ter);
+         update_subscore(lowest_stand_on, &stand_on_repeats, sta);
+      }
+      double terrain_score =
+            combine_subscores(lowest_terrain, terrain_repeats);
+      double stand_on_score =
+            combine_subscores(lowest_stand_on, stand_on_repeats);
+      const double terrain_wt = 2.0;
+      const double stand_on_wt = 2.0;
+      const double direction_wt = 1.0;
+      double score = terrain_wt + stand_on_wt + direction_wt;
+      score /= terrain_wt / terrain_score +
+            stand_on_wt / stand_on_score +
+            direction_wt / radial->direction_score;
+      radial->net_score = score;
+   }
+}
+
+
+// radial that select_route() picks for given net scores
+static uint32_t reference_best_radial(
+      /* in     */ const route_map_type *route_map
+      )
+{
+   double best_score = -1.0;
+   uint32_t best = 0;
+   for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+      if (route_map->radials[rad].net_score > best_score) {
+         best_score = route_map->radials[rad].net_score;
+         best = rad;
+      }
+   }
+   return best;
+}
+
+// scalar scoring
+////////////////////////////////////////////////////////////////////////
+
+
+// loads snapshot into route map, w/ radials cleared
+static void load_snapshot(
+      /* in     */ const snapshot_type *snap,
+      /* in out */       route_map_type *route_map,
+      /*    out */       route_info_type *route_info,
+      /*    out */       vessel_position_info_type *vessel_info
+      )
+{
+   const uint32_t num_nodes = ROUTE_MAP_WIDTH * ROUTE_MAP_WIDTH;
+   for (uint32_t i=0; i<num_nodes; i++) {
+      route_map->nodes[i].terrain_score = snap->terrain[i];
+   }
+   clear_viability_radials(route_map);
+   for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+      for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+         route_map->radials[rad].stand_on_score[ival] =
+               snap->stand_on[rad][ival];
+      }
+   }
+   memset(route_info, 0, sizeof *route_info);
+   route_info->true_path_heading = snap->path_heading;
+   route_info->default_speed.mps = 2.6;
+   memset(vessel_info, 0, sizeof *vessel_info);
+   vessel_info->speed.mps = snap->speed_mps;
+}
+
+
+static uint32_t compare_radials(
+      /* in     */ const radial_viability_type *ref,
+      /* in     */ const radial_viability_type *radials
+      )
+{
+   uint32_t errs = 0;
+   for (uint32_t rad=0; rad<NUM_ROUTE_RADIALS; rad++) {
+      for (uint32_t ival=0; ival<NUM_VIABILITY_INTERVALS; ival++) {
+         if ((ref[rad].terrain_score[ival] !=
+                  radials[rad].terrain_score[ival]) ||
+               (ref[rad].terrain_arc[ival] !=
+                  radials[rad].terrain_arc[ival]) ||
+               (ref[rad].stand_on_arc[ival] !=
+                  radials[rad].stand_on_arc[ival])) {
+            errs++;
+         }
+      }
+      if (fabs(ref[rad].net_score - radials[rad].net_score) > 1.0e-12) {
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   // log_ is shared w/ mapping code
+   log_ = get_logger("route_scoring");
+   route_map_type *route_map = create_test_route_map();
+   create_snapshots();
+   route_info_type route_info;
+   vessel_position_info_type vessel_info;
+   radial_viability_type ref[NUM_ROUTE_RADIALS];
+   printf("Comparing radial scoring with scalar version\n");
+   for (uint32_t n=0; n<NUM_SNAPSHOTS; n++) {
+      load_snapshot(&snapshots_[n], route_map, &route_info, &vessel_info);
+      reference_push(route_map, vessel_info.speed.mps);
+      calc_desired_heading_score(route_map, &route_info);
+      reference_radial_score(route_map);
+      const uint32_t ref_best = reference_best_radial(route_map);
+      memcpy(ref, route_map->radials, sizeof ref);
+      //
+      load_snapshot(&snapshots_[n], route_map, &route_info, &vessel_info);
+      push_node_viabilities_to_radials(route_map, &vessel_info, &route_info);
+      select_route(NULL, route_map, &route_info, &vessel_info);
+      const uint32_t best = route_info.sug_heading.tru.angle32 >> 24;
+      const uint32_t mismatch = compare_radials(ref, route_map->radials);
+      if ((mismatch > 0) || (best != ref_best)) {
+         printf("  snapshot %d: %d radial values differ, route %d "
+               "(expected %d)\n", n, mismatch, best, ref_best);
+         errs++;
+      }
+   }
+   ////////////////////////////////////////////////////////////
+   printf("Timing (per cycle, averaged over snapshots)\n");
+   const uint32_t iterations = 50;
+   double ref_push_sec = 0.0;
+   double ref_score_sec = 0.0;
+   double push_sec = 0.0;
+   double score_sec = 0.0;
+   for (uint32_t i=0; i<iterations; i++) {
+      for (uint32_t n=0; n<NUM_SNAPSHOTS; n++) {
+         load_snapshot(&snapshots_[n], route_map, &route_info, &vessel_info);
+         calc_desired_heading_score(route_map, &route_info);
+         double t0 = system_now();
+         reference_push(route_map, vessel_info.speed.mps);
+         double t1 = system_now();
+         reference_radial_score(route_map);
+         double t2 = system_now();
+         ref_push_sec += t1 - t0;
+         ref_score_sec += t2 - t1;
+         //
+         load_snapshot(&snapshots_[n], route_map, &route_info, &vessel_info);
+         calc_desired_heading_score(route_map, &route_info);
+         t0 = system_now();
+         push_node_viabilities_to_radials(route_map, &vessel_info,
+               &route_info);
+         t1 = system_now();
+         calc_radial_score(route_map);
+         t2 = system_now();
+         push_sec += t1 - t0;
+         score_sec += t2 - t1;
+      }
+   }
+   const double scale = 1000.0 / (double) (iterations * NUM_SNAPSHOTS);
+   printf("  push to radials   scalar %7.4f ms   now %7.4f ms\n",
+         ref_push_sec * scale, push_sec * scale);
+   printf("  radial scores     scalar %7.4f ms   now %7.4f ms\n",
+         ref_score_sec * scale, score_sec * scale);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
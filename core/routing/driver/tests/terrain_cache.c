@@ -0,0 +1,216 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "timekeeper.h"
+#include "logger.h"
+
+// checks that cached terrain scores match scoring every route node
+//    directly, as the vessel moves and when map features change, and
+//    times both. uses a synthetic map so no map data is needed
+// traffic analysis isn't exercised, so build w/o tracking
+#undef USE_TRACKING
+
+#include "../../mapping/world_map.c"
+#include "routing/driver.h"
+#include "../route.c"
+
+#define MAP_SIZE        720
+
+static const world_coordinate_type CENTER = { .lon=237.5, .lat=48.5 };
+
+
+// scattered islands
+static void create_map(
+      /*    out */       map_level3_type *map3
+      )
+{
+   uint32_t seed = 23;
+   for (uint32_t i=0; i<MAP_SIZE*MAP_SIZE; i++) {
+      seed = seed * 1103515245u + 12345u;
+      map3->grid[i].min_depth = (uint8_t) (2 + ((seed >> 16) % 60));
+   }
+   for (uint32_t n=0; n<1500; n++) {
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cx = (int32_t) ((seed >> 8) % MAP_SIZE);
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cy = (int32_t) ((seed >> 8) % MAP_SIZE);
+      const int32_t r = (int32_t) ((seed >> 4) % 9);
+      for (int32_t y=cy-r; y<=cy+r; y++) {
+         for (int32_t x=cx-r; x<=cx+r; x++) {
+            if ((x >= 0) && (y >= 0) && (x < MAP_SIZE) && (y < MAP_SIZE)
+                  && ((x-cx)*(x-cx) + (y-cy)*(y-cy) <= r*r)) {
+               map3->grid[x + y * MAP_SIZE].min_depth = 0;
+            }
+         }
+      }
+   }
+}
+
+
+// assigns route nodes to path map nodes for vessel at x,y meters from
+//    top-left of path map, as reset_route_nodes() does
+static void place_route_map(
+      /* in     */ const path_map_type *path_map,
+      /* in out */       route_map_type *route_map,
+      /* in     */ const double vessel_x_met,
+      /* in     */ const double vessel_y_met
+      )
+{
+   const double left_met = vessel_x_met -
+         (double) (route_map->size.x / 2) * ROUTE_MAP_NODE_WIDTH_METERS;
+   const double top_met = vessel_y_met -
+         (double) (route_map->size.y / 2) * ROUTE_MAP_NODE_WIDTH_METERS;
+   uint32_t route_idx = 0;
+   for (uint32_t y=0; y<route_map->size.y; y++) {
+      const uint32_t map_y = (uint32_t) floor((top_met +
+            y * ROUTE_MAP_NODE_WIDTH_METERS) / path_map->node_height.meters);
+      for (uint32_t x=0; x<route_map->size.x; x++) {
+         const uint32_t map_x = (uint32_t) floor((left_met +
+               x * ROUTE_MAP_NODE_WIDTH_METERS) /
+               path_map->node_width.meters);
+         route_map_node_type *node = &route_map->nodes[route_idx++];
+         node->world_node_idx = map_x + map_y * path_map->size.x;
+         node->world_pos.x = (uint16_t) map_x;
+         node->world_pos.y = (uint16_t) map_y;
+         node->terrain_score = 0.0001;
+      }
+   }
+}
+
+
+// scores every route node from its path map node, as was done before
+//    scores were cached
+static void reference_terrain_risks(
+      /* in     */ const path_map_type *path_map,
+      /* in out */       route_map_type *route_map
+      )
+{
+   const uint32_t num_nodes = (uint32_t) (route_map->size.x *
+         route_map->size.y);
+   for (uint32_t i=0; i<num_nodes; i++) {
+      route_map_node_type *node = &route_map->nodes[i];
+      node->terrain_score = calc_terrain_viability(
+            &path_map->feature_nodes[node->world_node_idx]);
+   }
+}
+
+
+static uint32_t compare_scores(
+      /* in     */ const path_map_type *path_map,
+      /* in     */ const route_map_type *route_map
+      )
+{
+   uint32_t errs = 0;
+   const uint32_t num_nodes = (uint32_t) (route_map->size.x *
+         route_map->size.y);
+   for (uint32_t i=0; i<num_nodes; i++) {
+      const route_map_node_type *node = &route_map->nodes[i];
+      const double expected = calc_terrain_viability(
+            &path_map->feature_nodes[node->world_node_idx]);
+      if (node->terrain_score != expected) {
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   image_size_type size = { .x=MAP_SIZE, .y=MAP_SIZE };
+   path_map_type *path_map = create_path_map(size);
+   map_level3_type *map3 = malloc(sizeof *map3);
+   create_map(map3);
+   set_map_center(CENTER, path_map);
+   for (uint32_t idx=0; idx<MAP_SIZE*MAP_SIZE; idx++) {
+      set_node_depth(path_map, map3, idx);
+   }
+   mark_land_adjacency(path_map);
+   route_map_type *route_map = calloc(1, sizeof *route_map);
+   route_map->size.x = ROUTE_MAP_WIDTH;
+   route_map->size.y = ROUTE_MAP_WIDTH;
+   route_map->node_width.meters = ROUTE_MAP_NODE_WIDTH_METERS;
+   route_map->nodes = calloc(ROUTE_MAP_WIDTH * ROUTE_MAP_WIDTH,
+         sizeof *route_map->nodes);
+   // as driver does at startup
+   init_route_geometry(route_map);
+   printf("Comparing cached and direct terrain scores\n");
+   // vessel moves diagonally across map at ~5 knots, w/ a planning cycle
+   //    every 0.25 sec
+   const uint32_t num_cycles = 2000;
+   const double step_met = 2.6 * OTTO_COMMAND_INTERVAL_SEC;
+   double x_met = 300.0 * path_map->node_width.meters;
+   double y_met = 300.0 * path_map->node_height.meters;
+   double cached_sec = 0.0;
+   double direct_sec = 0.0;
+   uint32_t mismatch = 0;
+   for (uint32_t i=0; i<num_cycles; i++) {
+      x_met += step_met * 0.8;
+      y_met += step_met * 0.6;
+      if (i == num_cycles / 2) {
+         // shoal appears under vessel
+         const uint32_t vx = (uint32_t) (x_met / path_map->node_width.meters);
+         const uint32_t vy = (uint32_t) (y_met / path_map->node_height.meters);
+         const image_coordinate_type top_left =
+               { .x=(uint16_t) (vx - 4), .y=(uint16_t) (vy - 4) };
+         const image_coordinate_type bottom_right =
+               { .x=(uint16_t) (vx + 4), .y=(uint16_t) (vy + 4) };
+         for (uint32_t y=top_left.y; y<bottom_right.y; y++) {
+            for (uint32_t x=top_left.x; x<bottom_right.x; x++) {
+               path_map->feature_nodes[x + y * MAP_SIZE].depth_meters = 1;
+            }
+         }
+         update_path_costs(path_map, top_left, bottom_right);
+      }
+      place_route_map(path_map, route_map, x_met, y_met);
+      double t0 = system_now();
+      reference_terrain_risks(path_map, route_map);
+      double t1 = system_now();
+      assess_terrain_risks(path_map, route_map);
+      double t2 = system_now();
+      direct_sec += t1 - t0;
+      cached_sec += t2 - t1;
+      mismatch += compare_scores(path_map, route_map);
+   }
+   const terrain_cache_type *cache = &terrain_cache_;
+   printf("  %d cycles, %d of %d map nodes scored (hit rate %.1f%%)\n",
+         num_cycles, cache->nodes_scored, cache->nodes_in_window,
+         100.0 * (1.0 - (double) cache->nodes_scored /
+         (double) cache->nodes_in_window));
+   if (mismatch > 0) {
+      printf("    %d route node scores differ\n", mismatch);
+      errs++;
+   }
+   printf("Timing (per cycle)\n");
+   printf("  direct   %7.4f ms\n", 1000.0 * direct_sec / num_cycles);
+   printf("  cached   %7.4f ms\n", 1000.0 * cached_sec / num_cycles);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
@@ -20,9 +20,14 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "beacon.h"
 #include "routing/mapping.h"
 #include "lin_alg.h"
+#include "timekeeper.h"
 
 // storage for beacon path map
 // there should only be one mapping system operating in this memory space
@@ -33,11 +38,48 @@ static beacon_record_type *beacon_list_ = NULL;
 static float *beacon_weights_ = NULL;
 static uint32_t tot_num_beacons_ = 0;
 
+// spatial index (beacons.grid), mapped read-only. if it's not available
+//    then beacons are found by scanning latitude bands in beacons.idx
+static void *beacon_grid_ = NULL;
+static size_t beacon_grid_bytes_ = 0;
+static const uint32_t *beacon_grid_offsets_ = NULL;
+static const beacon_grid_entry_type *beacon_grid_entries_ = NULL;
+
 
 // beacon pathfinding
-static uint32_t beacon_stack_write_idx_ = 0;
-static uint32_t beacon_stack_read_idx_ = 0;
-static uint32_t beacon_index_stack_[BEACON_STACK_SIZE];
+// search is best-first, using an indexed binary heap ordered by beacon
+//    weight plus a lower bound on the weight from beacon to vessel
+static float *beacon_keys_ = NULL;
+// heap entries carry a copy of the key so sifting doesn't need to look
+//    up each beacon's key
+struct beacon_heap_entry {
+   float key;
+   uint32_t idx;
+};
+typedef struct beacon_heap_entry beacon_heap_entry_type;
+static beacon_heap_entry_type *beacon_heap_ = NULL;
+static uint32_t beacon_heap_len_ = 0;
+// position of beacon in heap. -1 if it's not been reached and -2 if
+//    it's been expanded
+static int32_t *beacon_heap_pos_ = NULL;
+#define BEACON_NOT_REACHED    (-1)
+#define BEACON_EXPANDED       (-2)
+// search generation in which beacon's weight, key and heap position
+//    were last set. values from other generations are stale, and the
+//    beacon is treated as not reached (weight -1). this way a search
+//    only touches the beacons it reaches
+static uint32_t *beacon_gen_ = NULL;
+static uint32_t beacon_search_gen_ = 0;
+// vessel position, and cos of its latitude, for beacon_weight_bound()
+static akn_position_type bound_pos_;
+static double bound_cos_lat_ = 1.0;
+
+// beacons in destination map and their weights. these seed the search
+static uint32_t num_beacon_seeds_ = 0;
+static uint32_t beacon_seed_idx_[MAX_PATH_MAP_BEACONS];
+static float beacon_seed_weight_[MAX_PATH_MAP_BEACONS];
+
+static path_trace_stats_type beacon_search_stats_;
 
 ////////////////////////////////////////////////////////////////////////
 
@@ -70,8 +112,97 @@ beacon_record_type * get_beacon_record(
    return &beacon_list_[idx];
 }
 
+uint32_t get_beacon_grid_cell(
+      /* in     */ const double akn_x,
+      /* in     */ const double akn_y
+      )
+{
+   int32_t col = (int32_t) floor(akn_x / BEACON_GRID_CELL_DEG);
+   int32_t row = (int32_t) floor(akn_y / BEACON_GRID_CELL_DEG);
+   // clamp, as akn_x of 360 or akn_y of 180 is on the grid's edge
+   if (col < 0) {
+      col = 0;
+   } else if (col >= BEACON_GRID_COLS) {
+      col = BEACON_GRID_COLS - 1;
+   }
+   if (row < 0) {
+      row = 0;
+   } else if (row >= BEACON_GRID_ROWS) {
+      row = BEACON_GRID_ROWS - 1;
+   }
+   return (uint32_t) (col + row * BEACON_GRID_COLS);
+}
+
 ////////////////////////////////////////////////////////////////////////
 
+// maps beacon grid file into memory. grid is optional -- if it's
+//    missing or doesn't match beacon list then it's not used
+// must be called after beacon list is loaded
+static void load_beacon_grid(void)
+{
+   const uint32_t num_cells = BEACON_GRID_COLS * BEACON_GRID_ROWS;
+   const size_t offsets_bytes = (num_cells + 1) * sizeof(uint32_t);
+   const size_t header_bytes = sizeof(beacon_grid_header_type);
+   char grid_name[STR_LEN];
+   snprintf(grid_name, STR_LEN, "%s%s", get_world_map_folder_name(),
+         BEACON_GRID_FILE);
+   int fd = open(grid_name, O_RDONLY);
+   if (fd < 0) {
+      log_info(log_, "Beacon grid '%s' not available (%s). Using "
+            "latitude bands to find beacons", grid_name, strerror(errno));
+      return;
+   }
+   struct stat st;
+   if ((fstat(fd, &st) != 0) ||
+         ((size_t) st.st_size < header_bytes + offsets_bytes)) {
+      log_err(log_, "Beacon grid '%s' is truncated", grid_name);
+      goto end;
+   }
+   beacon_grid_bytes_ = (size_t) st.st_size;
+   beacon_grid_ = mmap(NULL, beacon_grid_bytes_, PROT_READ, MAP_PRIVATE,
+         fd, 0);
+   if (beacon_grid_ == MAP_FAILED) {
+      log_err(log_, "Failed to map beacon grid '%s': %s", grid_name,
+            strerror(errno));
+      beacon_grid_ = NULL;
+      goto end;
+   }
+   const beacon_grid_header_type *header = beacon_grid_;
+   const size_t expected_bytes = header_bytes + offsets_bytes +
+         header->num_entries * sizeof(beacon_grid_entry_type);
+   const uint32_t *offsets = (const uint32_t *)
+         ((const uint8_t *) beacon_grid_ + header_bytes);
+   if ((header->magic != BEACON_GRID_MAGIC) ||
+         (header->version != BEACON_GRID_VERSION) ||
+         (header->cols != BEACON_GRID_COLS) ||
+         (header->rows != BEACON_GRID_ROWS) ||
+         (beacon_grid_bytes_ != expected_bytes) ||
+         (offsets[num_cells] != header->num_entries)) {
+      log_err(log_, "Beacon grid '%s' has bad format. Using latitude "
+            "bands to find beacons", grid_name);
+      goto unmap;
+   }
+   if (header->num_entries != tot_num_beacons_) {
+      log_err(log_, "Beacon grid '%s' has %d beacons but beacon list has "
+            "%d. Rerun index_beacons. Using latitude bands to find beacons",
+            grid_name, header->num_entries, tot_num_beacons_);
+      goto unmap;
+   }
+   beacon_grid_offsets_ = offsets;
+   beacon_grid_entries_ = (const beacon_grid_entry_type *)
+         ((const uint8_t *) beacon_grid_ + header_bytes + offsets_bytes);
+   log_info(log_, "Mapped beacon grid '%s' (%d beacons)", grid_name,
+         header->num_entries);
+   goto end;
+unmap:
+   munmap(beacon_grid_, beacon_grid_bytes_);
+   beacon_grid_ = NULL;
+   beacon_grid_bytes_ = 0;
+end:
+   close(fd);
+}
+
+
 int init_beacon_list(void)
 {
    if (beacon_list_ != NULL) {
@@ -142,6 +273,11 @@ fprintf(stderr, "Failed read on beacon list\n");
    tot_num_beacons_ = (uint32_t) (num_bytes / BEACON_BIN_RECORD_SIZE_BYTES);
 //printf("NUM BEACONS %d\n", tot_num_beacons_);
    beacon_weights_ = malloc(tot_num_beacons_ * sizeof *beacon_weights_);
+   beacon_keys_ = malloc(tot_num_beacons_ * sizeof *beacon_keys_);
+   beacon_heap_ = malloc(tot_num_beacons_ * sizeof *beacon_heap_);
+   beacon_heap_pos_ = malloc(tot_num_beacons_ * sizeof *beacon_heap_pos_);
+   beacon_gen_ = calloc(tot_num_beacons_, sizeof *beacon_gen_);
+   load_beacon_grid();
    rc = 0;
 end:
    if (idx_fp != NULL) {
@@ -153,75 +289,312 @@ end:
    return rc;
 }
 
+
 // init
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 // beacon pathfinding
 
 
-// move path_map stack contents down, resetting read position to index 0
-// this purges already-read elements
-static void shrink_beacon_path_stack(void)
+// moves entry up from pos until its parent's key is no larger
+static void sift_heap_up(
+      /* in     */       uint32_t pos,
+      /* in     */ const beacon_heap_entry_type entry
+      )
 {
-   uint32_t stack_len =
-         (uint32_t) (beacon_stack_write_idx_ - beacon_stack_read_idx_);
-printf("Shrinking path-map stack. Len=%d. Purging %d elements\n", stack_len, beacon_stack_read_idx_);
-   log_info(log_, "Shrinking beacon path-map stack. Len=%d. Purging %d elements",
-         stack_len, beacon_stack_read_idx_);
-   memmove(beacon_index_stack_, &beacon_index_stack_[beacon_stack_read_idx_],
-         stack_len * sizeof *beacon_index_stack_);
-   beacon_stack_read_idx_ = 0;
-   beacon_stack_write_idx_ = stack_len;
+   while (pos > 0) {
+      uint32_t parent = (pos - 1) / 2;
+      if (beacon_heap_[parent].key <= entry.key) {
+         break;
+      }
+      beacon_heap_[pos] = beacon_heap_[parent];
+      beacon_heap_pos_[beacon_heap_[pos].idx] = (int32_t) pos;
+      pos = parent;
+   }
+   beacon_heap_[pos] = entry;
+   beacon_heap_pos_[entry.idx] = (int32_t) pos;
 }
 
 
-// evaluate neighbor beacon. update it's path weight if necessary and
-//    if so than add to stack so its neighbors can be evaluated
-static void add_beacon_to_stack(
-      /* in     */ const beacon_record_type *root_beacon,
-      /* in     */ const float weight_to_neighbor,
-      /* in     */ const beacon_record_type *neighbor
+// moves entry down from pos until neither child has a smaller key
+static void sift_heap_down(
+      /* in     */       uint32_t pos,
+      /* in     */ const beacon_heap_entry_type entry
       )
 {
-printf("  Check add %d to stack\n", neighbor->index);
-   if (neighbor->num_neighbors <= 0) {
-      // neighbor not initialized or it doesn't recognize that it has
-      //    neighbors. ignore it
-printf("    no neighbors\n");
-      goto end;
+   while (1) {
+      uint32_t child = 2 * pos + 1;
+      if (child >= beacon_heap_len_) {
+         break;
+      }
+      if ((child + 1 < beacon_heap_len_) &&
+            (beacon_heap_[child+1].key < beacon_heap_[child].key)) {
+         child++;
+      }
+      if (entry.key <= beacon_heap_[child].key) {
+         break;
+      }
+      beacon_heap_[pos] = beacon_heap_[child];
+      beacon_heap_pos_[beacon_heap_[pos].idx] = (int32_t) pos;
+      pos = child;
    }
-   float root_weight = beacon_weights_[root_beacon->index];
-   float nbr_weight = beacon_weights_[neighbor->index];
-   float path_weight = root_weight + weight_to_neighbor;
-printf("    weight %.1f  (root %.1f  path %.1f  proposed %.1f\n", (double) nbr_weight, (double) root_weight, (double) weight_to_neighbor, (double) path_weight);
-   if ((nbr_weight < 0.0f) || (nbr_weight > path_weight)) {
-printf("    Weight is now %.1f. Adding %d\n", (double) path_weight, neighbor->index);
-      // update neighbor's path weight and add to stack to re-evaluate
-      //    its neighbors
-      beacon_weights_[neighbor->index] = path_weight;
-      beacon_index_stack_[beacon_stack_write_idx_++] = neighbor->index;
+   beacon_heap_[pos] = entry;
+   beacon_heap_pos_[entry.idx] = (int32_t) pos;
+}
+
+
+// removes and returns beacon with lowest key
+static uint32_t pop_heap(void)
+{
+   assert(beacon_heap_len_ > 0);
+   uint32_t idx = beacon_heap_[0].idx;
+   beacon_heap_len_--;
+   if (beacon_heap_len_ > 0) {
+      sift_heap_down(0, beacon_heap_[beacon_heap_len_]);
    }
-end:
-   ;
+   beacon_heap_pos_[idx] = BEACON_EXPANDED;
+   return idx;
+}
+
+
+// starts a new search generation. all beacons become not reached
+static void start_beacon_search(void)
+{
+   beacon_search_gen_++;
+   if (beacon_search_gen_ == 0) {
+      // counter wrapped. stamps from 2^32 searches ago would look
+      //    current, so clear them
+      memset(beacon_gen_, 0, tot_num_beacons_ * sizeof *beacon_gen_);
+      beacon_search_gen_ = 1;
+   }
+   beacon_heap_len_ = 0;
 }
 
 
-static void process_next_stack_beacon(void)
+// returns beacon's path weight from the most recent search, or -1 if
+//    the search didn't reach it
+static float get_beacon_weight(
+      /* in     */ const uint32_t idx
+      )
 {
-   assert(beacon_stack_read_idx_ < beacon_stack_write_idx_);
-   uint32_t stack_idx = beacon_stack_read_idx_++;
-   uint32_t root_idx = beacon_index_stack_[stack_idx];
-   beacon_record_type *root_beacon = get_beacon_record(root_idx);
-   // signed int32 for i as num_neighbors is signed (neg there
-   //    means unprocessed)
-printf("beacon %d has %d neighbors\n", root_beacon->index, root_beacon->num_neighbors);
-   for (int32_t i=0; i<root_beacon->num_neighbors; i++) {
-      beacon_neighbor_type *nbr = &root_beacon->neighbors[i];
-      beacon_record_type *neighbor = get_beacon_record(nbr->nbr_index);
-      add_beacon_to_stack(root_beacon, nbr->path_weight, neighbor);
+   if (beacon_gen_[idx] != beacon_search_gen_) {
+      return -1.0f;
+   }
+   return beacon_weights_[idx];
+}
+
+
+// lower bound on path weight between beacon and bound_pos_, from
+//    great-circle distance
+static float beacon_weight_bound(
+      /* in     */ const beacon_record_type *beacon
+      )
+{
+   // akn y is degrees from north pole
+   double lat_0 = D2R * (90.0 - (double) beacon->akn_y);
+   double lat_1 = D2R * (90.0 - bound_pos_.akn_y);
+   double dlon = D2R * ((double) beacon->akn_x - bound_pos_.akn_x);
+   double s_lat = sin(0.5 * (lat_1 - lat_0));
+   double s_lon = sin(0.5 * dlon);
+   double a = s_lat * s_lat + cos(lat_0) * bound_cos_lat_ * s_lon * s_lon;
+   double dist_deg = R2D * 2.0 * asin(sqrt(a < 1.0 ? a : 1.0));
+   return (float) (dist_deg * BEACON_SEARCH_MIN_WEIGHT_PER_DEG);
+}
+
+
+// sets beacon's weight, if it's lower than what it has, and puts it
+//    in heap to be expanded
+static void update_beacon_weight(
+      /* in     */ const uint32_t idx,
+      /* in     */ const float weight
+      )
+{
+   if (beacon_gen_[idx] != beacon_search_gen_) {
+      beacon_gen_[idx] = beacon_search_gen_;
+      beacon_weights_[idx] = -1.0f;
+      beacon_heap_pos_[idx] = BEACON_NOT_REACHED;
+   }
+   float prev = beacon_weights_[idx];
+   if ((prev >= 0.0f) && (prev <= weight)) {
+      return;
+   }
+   if (beacon_heap_pos_[idx] == BEACON_NOT_REACHED) {
+      beacon_keys_[idx] = weight +
+            beacon_weight_bound(get_beacon_record(idx));
+   } else {
+      // bound doesn't change, so carry it over
+      beacon_keys_[idx] = weight + (beacon_keys_[idx] - prev);
+   }
+   beacon_weights_[idx] = weight;
+   const beacon_heap_entry_type entry = { .key = beacon_keys_[idx],
+         .idx = idx };
+   if (beacon_heap_pos_[idx] < 0) {
+      // new, or already expanded. if the bound is consistent the latter
+      //    shouldn't happen, but if it does then re-expand so that
+      //    weight propagates
+      sift_heap_up(beacon_heap_len_++, entry);
+   } else {
+      sift_heap_up((uint32_t) beacon_heap_pos_[idx], entry);
    }
 }
 
+
+// returns nonzero if search should pass through beacon. beacons reached
+//    already in this search have been checked
+static int32_t is_searchable(
+      /* in     */ const uint32_t idx
+      )
+{
+   // neighbor not initialized or it doesn't recognize that it has
+   //    neighbors. ignore it
+   return (beacon_gen_[idx] == beacon_search_gen_) ||
+         (get_beacon_record(idx)->num_neighbors > 0);
+}
+
+
+// qsort comparator. orders heap entries by beacon weight
+static int compare_beacon_weight(
+      /* in     */ const void *a,
+      /* in     */ const void *b
+      )
+{
+   const float wa = beacon_weights_[((const beacon_heap_entry_type *) a)->idx];
+   const float wb = beacon_weights_[((const beacon_heap_entry_type *) b)->idx];
+   return (wa > wb) - (wa < wb);
+}
+
+
+// finishes a search by flooding outward from the beacons waiting in the
+//    heap, in FIFO order and with no corridor. beacons already expanded
+//    have their final weights so only the rest of the graph is covered.
+//    waiting beacons are sorted by weight first. in heap order the flood
+//    re-expands most beacons a second time as lower weights arrive
+// heap array is reused as the queue. a beacon is in the queue at most
+//    once (non-negative heap pos) so it can't overflow
+// returns number of beacons expanded
+static uint32_t flood_beacon_graph(void)
+{
+   qsort(beacon_heap_, beacon_heap_len_, sizeof *beacon_heap_,
+         compare_beacon_weight);
+   for (uint32_t i=0; i<beacon_heap_len_; i++) {
+      beacon_heap_pos_[beacon_heap_[i].idx] = (int32_t) i;
+   }
+   uint32_t head = 0;
+   uint32_t len = beacon_heap_len_;
+   uint32_t expanded = 0;
+   while (len > 0) {
+      const uint32_t idx = beacon_heap_[head].idx;
+      if (++head == tot_num_beacons_) {
+         head = 0;
+      }
+      len--;
+      beacon_heap_pos_[idx] = BEACON_EXPANDED;
+      expanded++;
+      const float weight = beacon_weights_[idx];
+      const beacon_record_type *root = get_beacon_record(idx);
+      for (int32_t i=0; i<root->num_neighbors; i++) {
+         const beacon_neighbor_type *nbr = &root->neighbors[i];
+         const uint32_t nbr_idx = nbr->nbr_index;
+         if (!is_searchable(nbr_idx)) {
+            continue;
+         }
+         if (beacon_gen_[nbr_idx] != beacon_search_gen_) {
+            beacon_gen_[nbr_idx] = beacon_search_gen_;
+            beacon_weights_[nbr_idx] = -1.0f;
+            beacon_heap_pos_[nbr_idx] = BEACON_NOT_REACHED;
+         }
+         const float nbr_weight = weight + nbr->path_weight;
+         const float prev = beacon_weights_[nbr_idx];
+         if ((prev >= 0.0f) && (prev <= nbr_weight)) {
+            continue;
+         }
+         beacon_weights_[nbr_idx] = nbr_weight;
+         if (beacon_heap_pos_[nbr_idx] < 0) {
+            uint32_t tail = head + len;
+            if (tail >= tot_num_beacons_) {
+               tail -= tot_num_beacons_;
+            }
+            beacon_heap_[tail].idx = nbr_idx;
+            beacon_heap_pos_[nbr_idx] = (int32_t) tail;
+            len++;
+         }
+      }
+   }
+   beacon_heap_len_ = 0;
+   return expanded;
+}
+
+
+// computes beacon path weights to destination, starting from the
+//    beacon seeds and working toward the vessel. search stops once it's
+//    covered a corridor around the best route, so time and memory used
+//    depend on the route and not on size of beacon set. beacons outside
+//    of corridor have negative weight (see get_beacon_weight())
+// a heap expansion costs several times what a flood's does, so if the
+//    corridor grows past BEACON_SEARCH_MAX_EXPAND_FRAC of all beacons
+//    the rest is done as a flood (see flood_beacon_graph()) and every
+//    reachable beacon gets a weight
+// returns number of beacons expanded
+static uint32_t search_beacon_graph(
+      /* in     */ const world_coordinate_type vessel_pos
+      )
+{
+   const double t0 = system_now();
+   world_coordinate_type pos = vessel_pos;
+   if (pos.lon < 0.0) {
+      pos.lon += 360.0;
+   }
+   start_beacon_search();
+   bound_pos_ = convert_latlon_to_akn(pos);
+   // akn y is degrees from north pole
+   bound_cos_lat_ = cos(D2R * (90.0 - bound_pos_.akn_y));
+   for (uint32_t i=0; i<num_beacon_seeds_; i++) {
+      update_beacon_weight(beacon_seed_idx_[i], beacon_seed_weight_[i]);
+   }
+   const float goal_bound = (float) (BEACON_SEARCH_GOAL_RADIUS_DEG *
+         BEACON_SEARCH_MIN_WEIGHT_PER_DEG);
+   const uint32_t expand_limit = (uint32_t)
+         (BEACON_SEARCH_MAX_EXPAND_FRAC * tot_num_beacons_);
+   float key_limit = -1.0f;
+   uint32_t expanded = 0;
+   while (beacon_heap_len_ > 0) {
+      if ((key_limit >= 0.0f) && (beacon_heap_[0].key > key_limit)) {
+         break;
+      }
+      if (expanded >= expand_limit) {
+         expanded += flood_beacon_graph();
+         break;
+      }
+      uint32_t idx = pop_heap();
+      expanded++;
+      const float weight = beacon_weights_[idx];
+      if ((key_limit < 0.0f) && (beacon_keys_[idx] - weight < goal_bound)) {
+         // first beacon near vessel. set extent of corridor
+         key_limit = beacon_keys_[idx] + (float)
+               (BEACON_CORRIDOR_MARGIN_DEG * BEACON_PATH_NODES_PER_DEG);
+      }
+      const beacon_record_type *root = get_beacon_record(idx);
+      // signed int32 for i as num_neighbors is signed (neg there
+      //    means unprocessed)
+      for (int32_t i=0; i<root->num_neighbors; i++) {
+         const beacon_neighbor_type *nbr = &root->neighbors[i];
+         const uint32_t nbr_idx = nbr->nbr_index;
+         if (!is_searchable(nbr_idx)) {
+            continue;
+         }
+         update_beacon_weight(nbr_idx, weight + nbr->path_weight);
+      }
+   }
+   // beacons still waiting in heap are outside of corridor. their
+   //    weights aren't final. heap is empty if search ended in a flood
+   for (uint32_t i=0; i<beacon_heap_len_; i++) {
+      beacon_weights_[beacon_heap_[i].idx] = -1.0f;
+   }
+   beacon_search_stats_.nodes_touched = expanded;
+   beacon_search_stats_.elapsed_sec = system_now() - t0;
+   return expanded;
+}
+
 // beacon pathfinding
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -430,10 +803,140 @@ static void get_beacon_indices(
 
 
 
+// returns 1 if position is w/in 1/2 degree of map center, in each
+//    dimension, and 0 otherwise. this is the same window that
+//    add_beacon_to_list() applies
+static uint32_t in_map_window(
+      /* in     */ const akn_position_type map_center,
+      /* in     */ const float akn_x,
+      /* in     */ const float akn_y,
+      /* in     */ const double lat_correction
+      )
+{
+   float dx = fabsf(akn_x - (float) map_center.akn_x);
+   float dy = fabsf(akn_y - (float) map_center.akn_y);
+   if (dx > 180.0f) {
+      dx = 360.0f - dx;
+   }
+   dx *= (float) lat_correction;
+   return ((dx < 0.5f) && (dy < 0.5f)) ? 1 : 0;
+}
+
+
+// adds beacons in latitude bands that overlap map to path map
+static void scan_beacon_rows(
+      /* in     */ const akn_position_type map_center,
+      /* in     */ const double lat_scale,
+      /* in out */       path_map_type *path_map,
+      /*    out */       uint32_t *examined,
+      /*    out */       uint32_t *matched
+      )
+{
+   // get index to first beacon record, and number of records to read
+   //    from there
+   uint32_t first_record, num_records;
+   get_beacon_indices(map_center, &first_record, &num_records);
+   const uint32_t end_idx = first_record + num_records;
+   *examined = num_records;
+   *matched = 0;
+   for (uint32_t i=first_record; i<end_idx; i++) {
+      beacon_record_type *beacon_info = &beacon_list_[i];
+//printf("Beacon %d  %f,%f\n", i, beacon_info->akn_x, beacon_info->akn_y);
+      *matched += in_map_window(map_center, beacon_info->akn_x,
+            beacon_info->akn_y, lat_scale);
+      add_beacon_to_list(map_center, beacon_info, i, lat_scale, path_map);
+   }
+}
+
+
+// adds beacons from grid cells that overlap map to path map. only
+//    beacons w/in map window are passed to add_beacon_to_list()
+static void query_beacon_grid(
+      /* in     */ const akn_position_type map_center,
+      /* in     */ const double lat_scale,
+      /* in out */       path_map_type *path_map,
+      /*    out */       uint32_t *examined,
+      /*    out */       uint32_t *matched
+      )
+{
+   *examined = 0;
+   *matched = 0;
+   // bounding box of map. it's 1 degree tall and 1 degree wide at the
+   //    equator, growing wider w/ latitude
+   const double half_width = lat_scale > 0.5 / 180.0 ?
+         0.5 / lat_scale : 180.0;
+   int32_t row_0 = (int32_t) floor((map_center.akn_y - 0.5) /
+         BEACON_GRID_CELL_DEG);
+   int32_t row_1 = (int32_t) floor((map_center.akn_y + 0.5) /
+         BEACON_GRID_CELL_DEG);
+   if (row_0 < 0) {
+      row_0 = 0;
+   }
+   if (row_1 >= BEACON_GRID_ROWS) {
+      row_1 = BEACON_GRID_ROWS - 1;
+   }
+   int32_t col_0 = (int32_t) floor((map_center.akn_x - half_width) /
+         BEACON_GRID_CELL_DEG);
+   int32_t col_1 = (int32_t) floor((map_center.akn_x + half_width) /
+         BEACON_GRID_CELL_DEG);
+   if (col_1 - col_0 >= BEACON_GRID_COLS) {
+      // box goes all the way around
+      col_0 = 0;
+      col_1 = BEACON_GRID_COLS - 1;
+   }
+   // box can extend past 0 or 360 degrees, so columns are split into
+   //    up to 2 contiguous spans
+   int32_t spans[2][2];
+   uint32_t num_spans = 0;
+   if (col_0 < 0) {
+      spans[num_spans][0] = col_0 + BEACON_GRID_COLS;
+      spans[num_spans][1] = BEACON_GRID_COLS - 1;
+      num_spans++;
+      col_0 = 0;
+   }
+   if (col_1 >= BEACON_GRID_COLS) {
+      spans[num_spans][0] = 0;
+      spans[num_spans][1] = col_1 - BEACON_GRID_COLS;
+      num_spans++;
+      col_1 = BEACON_GRID_COLS - 1;
+   }
+   spans[num_spans][0] = col_0;
+   spans[num_spans][1] = col_1;
+   num_spans++;
+   for (int32_t row=row_0; row<=row_1; row++) {
+      for (uint32_t s=0; s<num_spans; s++) {
+         // cells in a row are contiguous, as are their entries
+         const uint32_t first_cell =
+               (uint32_t) (spans[s][0] + row * BEACON_GRID_COLS);
+         const uint32_t last_cell =
+               (uint32_t) (spans[s][1] + row * BEACON_GRID_COLS);
+         const uint32_t start = beacon_grid_offsets_[first_cell];
+         const uint32_t end = beacon_grid_offsets_[last_cell + 1];
+         *examined += end - start;
+         for (uint32_t i=start; i<end; i++) {
+            const beacon_grid_entry_type *entry = &beacon_grid_entries_[i];
+            if (in_map_window(map_center, entry->akn_x, entry->akn_y,
+                  lat_scale) == 0) {
+               continue;
+            }
+            (*matched)++;
+            add_beacon_to_list(map_center, &beacon_list_[entry->index],
+                  entry->index, lat_scale, path_map);
+         }
+      }
+   }
+}
+
+
 // create path map among beacons. returns 0 on success and -1 on failure
+// planning is done at two levels. a path map is traced around the
+//    destination and the weights of beacons in it seed a search over
+//    the beacon graph, toward the vessel. local path maps around the
+//    vessel are then seeded by beacon weights
 static int trace_beacon_paths(
       /* in out */       path_map_type *path_map,
-      /* in     */ const world_coordinate_type destination
+      /* in     */ const world_coordinate_type destination,
+      /* in     */ const world_coordinate_type vessel_pos
       )
 {
 printf("TRACE BEACON\n");
@@ -444,14 +947,15 @@ printf("TRACE BEACON\n");
       dest.lon += 360.0;
    }
    // init beacon path weights to invalid (ie, -1)
-   for (uint32_t i=0; i<tot_num_beacons_; i++) {
-      beacon_weights_[i] = -1.0f;
-   }
+   start_beacon_search();
+   num_beacon_seeds_ = 0;
    // trace paths with destination at center of map
+   const double t0 = system_now();
    load_world_5sec_map(dest, path_map);
    trace_route_simple(path_map, dest);
    calculate_destination_map_position(path_map);
    load_beacons_into_path_map(path_map);
+   const double dest_sec = system_now() - t0;
    if (path_map->num_beacons == 0) {
       // no beacons found near destination. this might be OK if vessel
       //    is close enough and there's a clear route between them,
@@ -465,28 +969,23 @@ fprintf(stderr, "No accessible beacons found near destination. It appears to be
    }
    // for each beacon in path map, pull weight from it's position in
    //    the map and use those for path seeds
-   // add those beacons to the stack so they can be traced outward from
-   beacon_stack_read_idx_ = 0;
-   beacon_stack_write_idx_ = 0;
    for (uint32_t i=0; i<path_map->num_beacons; i++) {
       image_coordinate_type pos = path_map->beacon_ref[i].pos_in_map;
       uint32_t map_idx = (uint32_t) (pos.x + pos.y * MAP_LEVEL3_SIZE);
       float weight = path_map->nodes[map_idx].weight;
       if (weight > 0.0f) {
-         uint32_t beacon_idx = path_map->beacon_ref[i].index;
 //printf("ADD %d   %.3f,%.3f   wt %.1f\n", beacon_idx, path_map->beacon_ref[i].coords.akn_x, path_map->beacon_ref[i].coords.akn_y, (double) weight);
-         beacon_weights_[beacon_idx] = weight;
-         // add beacon to stack
-         beacon_index_stack_[beacon_stack_write_idx_++] = beacon_idx;
+         beacon_seed_idx_[num_beacon_seeds_] = path_map->beacon_ref[i].index;
+         beacon_seed_weight_[num_beacon_seeds_] = weight;
+         num_beacon_seeds_++;
       }
    }
    // trace path
-   while (beacon_stack_read_idx_ < beacon_stack_write_idx_) {
-      if (beacon_stack_write_idx_ >= BEACON_STACK_SIZE) {
-         shrink_beacon_path_stack();
-      }
-      process_next_stack_beacon();
-   }
+   search_beacon_graph(vessel_pos);
+   log_info(log_, "Beacon route: destination map %.1f ms, beacon graph "
+         "%.1f ms (%d of %d beacons expanded)", 1000.0 * dest_sec,
+         1000.0 * beacon_search_stats_.elapsed_sec,
+         beacon_search_stats_.nodes_touched, tot_num_beacons_);
    rc = 0;
 end:
 //printf("end trace beacon\n");
@@ -499,6 +998,23 @@ end:
 }
 
 
+void update_beacon_corridor(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const world_coordinate_type vessel_pos
+      )
+{
+   search_beacon_graph(vessel_pos);
+   log_info(log_, "Beacon corridor moved to %.4f,%.4f in %.1f ms "
+         "(%d beacons expanded)", vessel_pos.lon, vessel_pos.lat,
+         1000.0 * beacon_search_stats_.elapsed_sec,
+         beacon_search_stats_.nodes_touched);
+   for (uint32_t i=0; i<path_map->num_beacons; i++) {
+      map_beacon_reference_type *ref = &path_map->beacon_ref[i];
+      ref->path_weight = get_beacon_weight(ref->index);
+   }
+}
+
+
 // find which beacons are in world/path map. store reference to them
 //    in the path map, including where they appear and what their
 //    weights are
@@ -508,22 +1024,21 @@ void load_beacons_into_path_map(
 {
    path_map->num_beacons = 0; // clean the slate
    akn_position_type map_center = convert_latlon_to_akn(path_map->center);
-   // get index to first beacon record, and number of records to read
-   //    from there
-   uint32_t first_record, num_records;
-   get_beacon_indices(map_center, &first_record, &num_records);
-printf("Search indices %d to %d\n", first_record, first_record+num_records);
-   // add beacons to path map. push all into map -- only the closest ones
-   //    will stick
-   const uint32_t start_idx = first_record;
-   const uint32_t end_idx = first_record + num_records;
    const double lat_scale = sin(D2R * map_center.akn_y);
 //printf("Lat scale %.3f for akn-lat %.4f\n", lat_scale, map_center.akn_y);
-   for (uint32_t i=start_idx; i<end_idx; i++) {
-      beacon_record_type *beacon_info = &beacon_list_[i];
-//printf("Beacon %d  %f,%f\n", i, beacon_info->akn_x, beacon_info->akn_y);
-      add_beacon_to_list(map_center, beacon_info, i, lat_scale, path_map);
+   // add beacons to path map. push all into map -- only the closest ones
+   //    will stick
+   uint32_t examined, matched;
+   if (beacon_grid_entries_ != NULL) {
+      query_beacon_grid(map_center, lat_scale, path_map, &examined,
+            &matched);
+   } else {
+      scan_beacon_rows(map_center, lat_scale, path_map, &examined,
+            &matched);
    }
+   log_info(log_, "Beacons near %.4f,%.4f: examined %d records, %d in "
+         "map window", path_map->center.lon, path_map->center.lat,
+         examined, matched);
    // get beacon display locations
    calculate_destination_map_position(path_map);
    for (uint32_t i=0; i<path_map->num_beacons; i++) {
@@ -535,7 +1050,7 @@ printf("Search indices %d to %d\n", first_record, first_record+num_records);
    for (uint32_t i=0; i<path_map->num_beacons; i++) {
       uint32_t idx = path_map->beacon_ref[i].index;
 //printf("Seeding %d with %.1f\n", idx, (double) beacon_weights_[idx]);
-      path_map->beacon_ref[i].path_weight = beacon_weights_[idx];
+      path_map->beacon_ref[i].path_weight = get_beacon_weight(idx);
    }
    // print weights
    for (uint32_t i=0; i<path_map->num_beacons; i++) {
@@ -20,12 +20,11 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 #include "pinet.h"
 #include "pin_types.h"
 #include "routing/mapping.h"
-
-
-static __thread struct drand48_data path_rand_;
+#include "timekeeper.h"
 
 
 void reset_path_map(
@@ -48,8 +47,9 @@ void reset_path_map(
       }
    }
    memset(path_map->stack, -1, n_elements * sizeof *path_map->stack);
-   //
-   srand48_r(12345, &path_rand_);
+   path_map->num_touched = 0;
+   path_map->num_seeds = 0;
+   path_map->trace_valid = 0;
 }
 
 
@@ -68,6 +68,7 @@ path_map_type * create_path_map(
    uint32_t n_elements = (uint32_t) (size.x * size.y);
    map->nodes = malloc(n_elements * sizeof *map->nodes);
    map->stack = malloc(n_elements * sizeof *map->stack);
+   map->touched = malloc(n_elements * sizeof *map->touched);
    map->feature_nodes = malloc(n_elements * sizeof *map->feature_nodes);
    reset_path_map(map);
    //
@@ -75,6 +76,82 @@ path_map_type * create_path_map(
 }
 
 
+// sets node's passage penalty and access flag from its map features
+// this is done for all nodes before tracing so that the cost of a path
+//    doesn't depend on the order nodes are reached in
+// returns non-zero if penalty or access changed
+static uint32_t set_node_cost(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const uint32_t idx
+      )
+{
+   const map_feature_node_type *feature_node = &path_map->feature_nodes[idx];
+   path_map_node_type *node = &path_map->nodes[idx];
+   // determine penalty for traversing this node
+   float penalty = 0.0f;
+   uint32_t no_access = 0;
+   if (feature_node->land_cnt > 0) {
+      penalty += (float) (PATH_ADJACENT_NON_PASSABLE_PENALTY_BASE +
+            feature_node->land_cnt * PATH_ADJACENT_NON_PASSABLE_PENALTY_INC);
+   } else if (feature_node->near_cnt > 0) {
+      penalty += (float) (feature_node->near_cnt *
+            PATH_SEMI_ADJACENT2_NON_PASSABLE_PENALTY_INC);
+   }
+   if (feature_node->depth_meters <= ABS_MIN_TRAVERSABLE_DEPTH_METERS) {
+      // can't touch this
+      penalty = 1000.0f;
+      no_access = PATH_NODE_FLAG_NO_ACCESS;
+   } else if (feature_node->depth_meters < MIN_TRAVERSABLE_DEPTH_METERS) {
+      // this is below min depth, but technically traversible. add to
+      //    passage weight
+      penalty += (float) (PATH_BELOW_MIN_DEPTH_PENALTY_PER_METER *
+            (MIN_TRAVERSABLE_DEPTH_METERS - feature_node->depth_meters));
+   }
+   uint32_t changed = (node->passage_penalty != penalty) ||
+         ((node->flags & PATH_NODE_FLAG_NO_ACCESS) != no_access);
+   node->passage_penalty = penalty;
+   node->flags = (node->flags & ~(uint32_t) PATH_NODE_FLAG_NO_ACCESS) |
+         no_access;
+   return changed;
+}
+
+
+// path tracing algorithm is deterministic and can follow vert or
+//    horiz path too easily. jitter is added to allow pulling in from
+//    more accurate direction
+// jitter is a hash of the link between nodes, on [-0.05,0.05), so a
+//    node gets the same weight no matter when the search reaches it.
+//    a random draw would make the trace depend on processing order,
+//    and a trace that's repaired would differ from one that's rebuilt
+static float link_jitter(
+      /* in     */ const uint32_t child_idx,
+      /* in     */ const uint32_t root_idx
+      )
+{
+   uint32_t h = child_idx * 0x9e3779b1u + root_idx;
+   h ^= h >> 16;
+   h *= 0x85ebca6bu;
+   h ^= h >> 13;
+   h *= 0xc2b2ae35u;
+   h ^= h >> 16;
+   return 0.1f * ((float) (h >> 8) * (1.0f / 16777216.0f) - 0.5f);
+}
+
+
+// adds node to list of nodes changed by replan, if it's not already there
+static void mark_touched(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const uint32_t idx
+      )
+{
+   path_map_node_type *node = &path_map->nodes[idx];
+   if ((node->flags & PATH_NODE_FLAG_TOUCHED) == 0) {
+      node->flags |= PATH_NODE_FLAG_TOUCHED;
+      path_map->touched[path_map->num_touched++].idx = idx;
+   }
+}
+
+
 // if node at root+offset belongs as part of path, sets node values
 //    (eg, weight and  link to parent)
 // add pixel to stack for future neighbor analysis
@@ -97,46 +174,23 @@ static void add_node_to_stack_(
    /////////////////////////////////////////////////////////////////////
    // point is in the world -- check it
    uint32_t new_idx = (uint32_t) (new_x + new_y * path_map->size.x);
-   map_feature_node_type *feature_node = &path_map->feature_nodes[new_idx];
    path_map_node_type *child_node = &path_map->nodes[new_idx];
    if (child_node->flags & PATH_NODE_FLAG_NO_ACCESS) {
       // not passable. nothing to do here
       goto end;
    }
-   // determine penalty for traversing this node
-   float penalty = 0.0f;
-   if (feature_node->land_cnt > 0) {
-      penalty += (float) (PATH_ADJACENT_NON_PASSABLE_PENALTY_BASE +
-            feature_node->land_cnt * PATH_ADJACENT_NON_PASSABLE_PENALTY_INC);
-   } else if (feature_node->near_cnt > 0) {
-      penalty += (float) (feature_node->near_cnt *
-            PATH_SEMI_ADJACENT2_NON_PASSABLE_PENALTY_INC);
-   }
-   if (feature_node->depth_meters <= ABS_MIN_TRAVERSABLE_DEPTH_METERS) {
-      // can't touch this
-      child_node->weight = -1.0;
-      child_node->passage_penalty = 1000.0;
-      child_node->parent_id.val = -1;
-      child_node->flags |= PATH_NODE_FLAG_NO_ACCESS;
-      goto end;
-   } else if (feature_node->depth_meters < MIN_TRAVERSABLE_DEPTH_METERS) {
-      // this is below min depth, but technically traversible. add to
-      //    passage weight
-      penalty += (float) (PATH_BELOW_MIN_DEPTH_PENALTY_PER_METER *
-            (MIN_TRAVERSABLE_DEPTH_METERS - feature_node->depth_meters));
-   }
-   // path tracing algorithm is deterministic and can follow vert or
-   //    horiz path too easily. add some jitter to allow pulling in
-   //    from more accurate direction
-   double jitter = 0.0;
-   drand48_r(&path_rand_, &jitter);
-   jitter = 0.1 * (jitter - 0.5);
-   float new_weight = root_node->weight + penalty + traverse_wt +
-         (float) jitter;
+   float new_weight = root_node->weight + child_node->passage_penalty +
+         traverse_wt + link_jitter(new_idx, root_idx.idx);
    if (child_node->flags & PATH_NODE_FLAG_PROCESSED) {
       // already-processed node
       // see if this path might provide it a lower weight
-      if (child_node->weight <= new_weight) {
+      if (child_node->weight < new_weight) {
+         goto end;
+      }
+      // weights can tie. keep the parent with the lower index so the
+      //    result doesn't depend on which one was processed first
+      if ((child_node->weight == new_weight) &&
+            (child_node->parent_id.val <= root_idx.val)) {
          goto end;
       }
       // new weight is lower -- allow to be added to stack again to propagate
@@ -147,8 +201,11 @@ static void add_node_to_stack_(
    child_node->parent_id = root_idx;
    child_node->weight = new_weight;
 //printf("    set weight %.3f\n", new_weight);
-   child_node->passage_penalty = penalty;
    child_node->flags |= PATH_NODE_FLAG_PROCESSED;
+   if (path_map->trace_valid != 0) {
+      // replanning. keep track of what changed
+      mark_touched(path_map, new_idx);
+   }
 //printf("Adding %d,%d to root %d,%d, weight %.1f\n", child_node->pos.x, child_node->pos.y, root_node->pos.x,  root_node->pos.y, (double) child_node->weight);
    //
    path_map->stack[path_map->write_idx++].idx = new_idx;
@@ -290,9 +347,166 @@ static void process_next_stack_node(
 }
 
 
-// build vector of approximate course to follow for all nodes in path map.
+// latitude correction for node courses in map row y
+static double course_scale(
+      /* in     */ const path_map_type *path_map,
+      /* in     */ const degree_type center_latitude,
+      /* in     */ const uint32_t y
+      )
+{
+   image_size_type size = path_map->size;
+   double dy_deg = 1.0 / (double) size.y;
+   double y_deg_top = center_latitude.degrees - dy_deg * (double) (size.y / 2);
+   double y_deg = y_deg_top + (double) y * dy_deg;
+   return cos(D2R * y_deg);
+}
+
+
+// course is the direction to an ancestor that's no more than
+//    NUM_ANCESTORS_FOR_DIRECTION nodes away, so there are few possible
+//    offsets. course for each offset is stored in a lookup table, which
+//    is rebuilt when the latitude correction changes appreciably
+#define COURSE_LUT_RADIUS     NUM_ANCESTORS_FOR_DIRECTION
+#define COURSE_LUT_WIDTH      (2 * COURSE_LUT_RADIUS + 1)
+// latitude correction is quantized to this step, so a row's courses
+//    are the same no matter which table was built before it. course
+//    error from this is less than 0.03 degrees for latitudes below 60.
+//    across a map at mid latitudes the table is rebuilt ~10 times
+#define COURSE_LUT_SCALE_STEP    1.0e-3
+
+struct course_lut {
+   int32_t scale_step;
+   bam16_type course[COURSE_LUT_WIDTH * COURSE_LUT_WIDTH];
+};
+typedef struct course_lut course_lut_type;
+
+
+static void init_course_lut(
+      /*    out */       course_lut_type *lut
+      )
+{
+   lut->scale_step = -1;
+}
+
+
+// make sure table is appropriate for latitude correction 'scale'
+static void update_course_lut(
+      /* in out */       course_lut_type *lut,
+      /* in     */ const double scale
+      )
+{
+   const int32_t step = (int32_t) lround(scale / COURSE_LUT_SCALE_STEP);
+   if (step == lut->scale_step) {
+      return;
+   }
+   lut->scale_step = step;
+   const double lut_scale = (double) step * COURSE_LUT_SCALE_STEP;
+   for (int32_t dy=-COURSE_LUT_RADIUS; dy<=COURSE_LUT_RADIUS; dy++) {
+      for (int32_t dx=-COURSE_LUT_RADIUS; dx<=COURSE_LUT_RADIUS; dx++) {
+         uint32_t idx = (uint32_t) ((dx + COURSE_LUT_RADIUS) +
+               (dy + COURSE_LUT_RADIUS) * COURSE_LUT_WIDTH);
+         double theta_deg = R2D * atan2((double) dx * lut_scale, (double) -dy);
+         CVT_DEG_TO_BAM16(theta_deg, lut->course[idx]);
+      }
+   }
+}
+
+
+// sets approximate course to follow for node
 // present algorithm is very simple and is based on direction to 'grandparent'
 //    node, approx. 5 'generations' away
+static void set_node_course(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const uint32_t idx,
+      /* in     */ const course_lut_type *lut
+      )
+{
+   pixel_offset_bitfield_type base_direction, next_direction;
+   path_map_node_type *root = &path_map->nodes[idx];
+   path_map_node_type *ggp = root;
+   // find direction to ancestor
+   for (uint32_t gen=0; gen<NUM_ANCESTORS_FOR_DIRECTION; gen++) {
+      if (ggp->parent_id.val >= 0) {
+         path_map_node_type *next_ggp =
+               &path_map->nodes[ggp->parent_id.idx];
+         if (gen == 0) {
+            // get base direction. this returns bitfield indicating
+            //    direction of next node relative to this one
+            base_direction = get_offset_mask(next_ggp->pos, ggp->pos);
+         } else {
+            // make sure offset is consistent w/ base direction
+            //    (ie, w/in 45deg)
+            // get new direction. this returns bitfield indicating
+            //    direction of next node relative to this one,
+            //    plus adjacent bits. ANDing this to base direction
+            //    will indicate if it's w/in +/-45deg of base
+            next_direction =
+                  get_offset_mask_wide(next_ggp->pos, ggp->pos);
+            if ((next_direction.mask & base_direction.mask) == 0) {
+               // latest direction is too different from original
+               //    offset. halt search
+               break;
+            }
+         }
+         ggp = next_ggp;
+//printf("  ->%d,%d  %.3f\n", ggp->pos.x, ggp->pos.y, ggp->passage_penalty);
+      } else {
+         break;
+      }
+   }
+   // each generation moves at most one node in x and y, so offset is
+   //    always in table
+   const int32_t dx = ggp->pos.x - root->pos.x;
+   const int32_t dy = ggp->pos.y - root->pos.y;
+   assert((dx >= -COURSE_LUT_RADIUS) && (dx <= COURSE_LUT_RADIUS));
+   assert((dy >= -COURSE_LUT_RADIUS) && (dy <= COURSE_LUT_RADIUS));
+   root->true_course = lut->course[(dx + COURSE_LUT_RADIUS) +
+         (dy + COURSE_LUT_RADIUS) * COURSE_LUT_WIDTH];
+//printf("  = %d,%d for %.3f (wt=%.3f)\n", dx, dy, (double) root->true_course.angle16 * BAM16_TO_DEG, ggp->weight);
+   // don't need to reset active course -- it's set when smoothing
+   //    out course
+   // active course is reset when smoothing course, but not for all
+   //    all nodes (ie, boundary nodes). take care of those cases here
+   root->active_course = root->true_course;
+}
+
+
+// rows of path map are split between this many threads when building
+//    course vectors. nodes only write their own course so rows can be
+//    processed independently
+#define COURSE_VECTOR_THREADS    4
+
+struct course_vector_rows {
+   path_map_type *path_map;
+   degree_type center_latitude;
+   uint32_t first_row;
+   uint32_t end_row;
+};
+typedef struct course_vector_rows course_vector_rows_type;
+
+
+static void * build_course_vector_rows(
+      /* in out */       void *arg
+      )
+{
+   const course_vector_rows_type *rows = arg;
+   path_map_type *path_map = rows->path_map;
+   const uint32_t width = path_map->size.x;
+   course_lut_type lut;
+   init_course_lut(&lut);
+   for (uint32_t y=rows->first_row; y<rows->end_row; y++) {
+      // apply correction for latitude distortion
+      update_course_lut(&lut,
+            course_scale(path_map, rows->center_latitude, y));
+      for (uint32_t x=0; x<width; x++) {
+         set_node_course(path_map, x + y * width, &lut);
+      }
+   }
+   return NULL;
+}
+
+
+// build vector of approximate course to follow for all nodes in path map.
 // TODO present implementation gives very poor angular accuracy and misses
 //    turns, potentially aiming it toward land or across shallow water.
 //    route calculation should compensate for this but it should be fixed
@@ -307,62 +521,30 @@ static void build_course_vectors(
       )
 {
    image_size_type size = path_map->size;
-   // build direction vector for each node
-   double dy_deg = 1.0 / (double) size.y;
-   double y_deg_top = center_latitude.degrees - dy_deg * (double) (size.y / 2);
-   pixel_offset_bitfield_type base_direction, next_direction;
-   //
-   for (uint32_t y=0; y<size.y; y++) {
-      double y_deg = y_deg_top + (double) y * dy_deg;
-      // apply correction for latitude distortion
-      double scale = cos(D2R * y_deg);
-      for (uint32_t x=0; x<size.x; x++) {
-         uint32_t idx = x + y * size.x;
-         path_map_node_type *root = &path_map->nodes[idx];
-         path_map_node_type *ggp = root;
-//printf("%d,%d   scale=%.4f\n", root->pos.x, root->pos.y, scale);
-         // find direction to ancestor
-         for (uint32_t gen=0; gen<NUM_ANCESTORS_FOR_DIRECTION; gen++) {
-            if (ggp->parent_id.val >= 0) {
-               path_map_node_type *next_ggp =
-                     &path_map->nodes[ggp->parent_id.idx];
-               if (gen == 0) {
-                  // get base direction. this returns bitfield indicating
-                  //    direction of next node relative to this one
-                  base_direction = get_offset_mask(next_ggp->pos, ggp->pos);
-               } else {
-                  // make sure offset is consistent w/ base direction
-                  //    (ie, w/in 45deg)
-                  // get new direction. this returns bitfield indicating
-                  //    direction of next node relative to this one,
-                  //    plus adjacent bits. ANDing this to base direction
-                  //    will indicate if it's w/in +/-45deg of base
-                  next_direction =
-                        get_offset_mask_wide(next_ggp->pos, ggp->pos);
-                  if ((next_direction.mask & base_direction.mask) == 0) {
-                     // latest direction is too different from original
-                     //    offset. halt search
-                     break;
-                  }
-               }
-               ggp = next_ggp;
-//printf("  ->%d,%d  %.3f\n", ggp->pos.x, ggp->pos.y, ggp->passage_penalty);
-            } else {
-               break;
-            }
-         }
-         path_offset_type dir;
-         dir.dx = (int16_t) (ggp->pos.x - root->pos.x);
-         dir.dy = (int16_t) (ggp->pos.y - root->pos.y);
-         double theta_deg = R2D * atan2((double) dir.dx * scale, (double) -dir.dy);
-//printf("  = %d,%d for %.3f (x-scale= %.3f, wt=%.3f)\n", dir.dx, dir.dy, theta_deg, scale, ggp->weight);
-         CVT_DEG_TO_BAM16(theta_deg, root->true_course);
-         // don't need to reset active course -- it's set when smoothing
-         //    out course
-         // active course is reset when smoothing course, but not for all
-         //    all nodes (ie, boundary nodes). take care of those cases here
-         root->active_course = root->true_course;
-//printf("INIT %d   %d,%d [%d]  dir %d,%d  %.2f  (active %.2f)\n", idx, x, y, root->parent_id.val, dir.dx, dir.dy, (double) root->true_course.angle16 * BAM16_TO_DEG, root->active_course.angle16 * BAM16_TO_DEG);
+   course_vector_rows_type rows[COURSE_VECTOR_THREADS];
+   pthread_t tids[COURSE_VECTOR_THREADS];
+   uint32_t started[COURSE_VECTOR_THREADS];
+   // split rows into bands. last band is done in this thread
+   for (uint32_t i=0; i<COURSE_VECTOR_THREADS; i++) {
+      rows[i].path_map = path_map;
+      rows[i].center_latitude = center_latitude;
+      rows[i].first_row = i * size.y / COURSE_VECTOR_THREADS;
+      rows[i].end_row = (i + 1) * size.y / COURSE_VECTOR_THREADS;
+      started[i] = 0;
+   }
+   for (uint32_t i=0; i<COURSE_VECTOR_THREADS-1; i++) {
+      if (pthread_create(&tids[i], NULL, build_course_vector_rows,
+            &rows[i]) == 0) {
+         started[i] = 1;
+      } else {
+         // do it here if thread can't be started
+         build_course_vector_rows(&rows[i]);
+      }
+   }
+   build_course_vector_rows(&rows[COURSE_VECTOR_THREADS-1]);
+   for (uint32_t i=0; i<COURSE_VECTOR_THREADS-1; i++) {
+      if (started[i] != 0) {
+         pthread_join(tids[i], NULL);
       }
    }
 }
@@ -410,8 +592,35 @@ void set_default_active_course(
 }
 
 
+// pixel neighbors, in the order process_next_stack_node() visits them
+static const pixel_offset_type NEIGHBORS_8[8] = {
+      { .dx= 1, .dy= 0 }, { .dx=-1, .dy= 0 },
+      { .dx= 0, .dy=-1 }, { .dx= 0, .dy= 1 },
+      { .dx= 1, .dy=-1 }, { .dx=-1, .dy=-1 },
+      { .dx= 1, .dy= 1 }, { .dx=-1, .dy= 1 }
+};
+
+// returns index of node at pos+offset, or -1 if that's off the map
+static int32_t get_neighbor_idx(
+      /* in     */ const path_map_type *path_map,
+      /* in     */ const image_coordinate_type pos,
+      /* in     */ const pixel_offset_type offset
+      )
+{
+   int32_t x = (int32_t) pos.x + offset.dx;
+   int32_t y = (int32_t) pos.y + offset.dy;
+   if ((x < 0) || (x >= path_map->size.x) || (y < 0) ||
+         (y >= path_map->size.y)) {
+      return -1;
+   }
+   return x + y * path_map->size.x;
+}
+
+
 // adds point (ie, destination or beacon) to path map, using specified
 //    path weight
+// if a lower-weight seed was already placed on the same node then that
+//    one is kept
 static void add_point_to_path_stack(
       /* in out */       path_map_type *path_map,
       /* in     */ const image_coordinate_type pos,
@@ -419,54 +628,59 @@ static void add_point_to_path_stack(
       )
 {
    // make sure pixel is in map
-   if ((pos.x < MAP_LEVEL3_SIZE) || (pos.y < MAP_LEVEL3_SIZE)) {
+   if ((pos.x < MAP_LEVEL3_SIZE) && (pos.y < MAP_LEVEL3_SIZE)) {
       uint32_t idx = (uint32_t) (pos.x + pos.y * MAP_LEVEL3_SIZE);
       path_map_node_type *path_node = &path_map->nodes[idx];
+      if ((path_node->flags & PATH_NODE_FLAG_PROCESSED) &&
+            (path_node->weight <= path_weight)) {
+         return;
+      }
       path_node->weight = path_weight;
       path_node->parent_id.val = -1;
       path_map->stack[path_map->write_idx++].idx = (uint32_t) idx;
-      path_node->flags = PATH_NODE_FLAG_PROCESSED;
+      path_node->flags |= PATH_NODE_FLAG_PROCESSED;
+      if (path_map->trace_valid != 0) {
+         mark_touched(path_map, idx);
+      }
 //fprintf(stderr, "Seeded %d,%d with %.1f\n", pos.x, pos.y, (double) path_weight);
    }
 }
 
-// use D* approach to find all routes to destination
-// path traced on existing depth map, using beacons and destination as
-//    seed locations
-// TODO FIXME This will break when close to north pole, as when w/in 1/2
-//    degree the top of map will shift into opposite hemisphere. this isn't
-//    the only thing that will break in arctic ocean. logic must be added
-//    to handle arctic navigation
-void trace_route_simple(
-      /*    out */       path_map_type *path_map,
-      /* in     */ const world_coordinate_type vessel_pos
+
+// builds list of seeds for trace: destination with 0 weight plus beacons
+//    that aren't too close to the vessel. seeds outside of the map are
+//    skipped
+// returns number of seeds
+static uint32_t collect_path_seeds(
+      /* in     */ const path_map_type *path_map,
+      /* in     */ const world_coordinate_type vessel_pos,
+      /*    out */       path_seed_type *seeds
       )
 {
-//printf("TRACE SIMPLE  %d beacons\n", path_map->num_beacons);
-   reset_path_map(path_map);
-//   path_map->destination = convert_latlon_to_akn(path_map->center);
-   // add beacon and dest weights to map, as able
-   path_map->read_idx = 0;
-   path_map->write_idx = 0;
+   uint32_t n = 0;
    // add destination as primary seed with 0 weight
-   // if destination is beyond visible map then it will be filtered and
-   //    not actually added stack
-   calculate_destination_map_position(path_map);
-   add_point_to_path_stack(path_map, path_map->dest_pix, 0.0f);
+   // if destination is beyond visible map then it's filtered
+   if ((path_map->dest_pix.x < MAP_LEVEL3_SIZE) &&
+         (path_map->dest_pix.y < MAP_LEVEL3_SIZE)) {
+      seeds[n].pos = path_map->dest_pix;
+      seeds[n].weight = 0.0f;
+      n++;
+   }
    // add beacons with seeds of their computed path weights to destination
    for (uint32_t i=0; i<path_map->num_beacons; i++) {
-      // TODO don't add beacon if w/in X distance of vessel. that's too
-      //    close and likely to result in artifacts
-      map_beacon_reference_type *ref = &path_map->beacon_ref[i];
+      const map_beacon_reference_type *ref = &path_map->beacon_ref[i];
+      if ((ref->pos_in_map.x >= MAP_LEVEL3_SIZE) ||
+            (ref->pos_in_map.y >= MAP_LEVEL3_SIZE)) {
+         continue;
+      }
       world_coordinate_type beac_pos = convert_akn_to_world(ref->coords);
       meter_type dist = calc_distance(vessel_pos, beac_pos, __func__);
       if (dist.meters < VESSEL_BEACON_INHIBITION_RING_NM * NM_TO_METERS) {
          // beacon is too close to vessel. inhibit its placement in map
          continue;
       }
-      float weight = path_map->beacon_ref[i].path_weight;
+      float weight = ref->path_weight;
       if (weight > 0.0f) {
-//printf("  adding beacon %d to stack (wt=%.1f)\n", path_map->beacon_ref[i].index, (double) weight);
          // if using beacon weights directly, variations in paths can
          //    result in a beacon being a local minimum that the path
          //    cannot escape from. to fix this problem, multiply all
@@ -478,16 +692,25 @@ void trace_route_simple(
          //    logic that determines the best beacon to drive toward, and
          //    which are of lower priority (ie, are closer) while covering
          //    for all terrain variations
-         add_point_to_path_stack(path_map,
-               path_map->beacon_ref[i].pos_in_map, 2.0f * weight);
+         seeds[n].pos = ref->pos_in_map;
+         seeds[n].weight = 2.0f * weight;
+         n++;
       }
-//else { printf("  beacon %d has wt=%.1f\n", path_map->beacon_ref[i].index, weight); }
    }
-   // update path weight between nodes until stack is empty
-   uint32_t num_nodes = MAP_LEVEL3_SIZE * MAP_LEVEL3_SIZE;
-//uint32_t cnt = 0;
+   return n;
+}
+
+
+// update path weight between nodes until stack is empty
+// returns number of nodes processed
+static uint32_t propagate_path_weights(
+      /* in out */       path_map_type *path_map
+      )
+{
+   uint32_t num_nodes = (uint32_t) (path_map->size.x * path_map->size.y);
+   uint32_t cnt = 0;
    while (path_map->read_idx < path_map->write_idx) {
-//cnt++;
+      cnt++;
       // because nodes can be added to the stack multiple times it's
       //    possible for stack to grow beyond initial size (which is
       //    number of nodes). if stack overflows, purge used contents
@@ -497,9 +720,275 @@ void trace_route_simple(
       }
       process_next_stack_node(path_map);
    }
+   return cnt;
+}
+
+
+// use D* approach to find all routes to destination
+// path traced on existing depth map, using beacons and destination as
+//    seed locations
+// TODO FIXME This will break when close to north pole, as when w/in 1/2
+//    degree the top of map will shift into opposite hemisphere. this isn't
+//    the only thing that will break in arctic ocean. logic must be added
+//    to handle arctic navigation
+void trace_route_simple(
+      /*    out */       path_map_type *path_map,
+      /* in     */ const world_coordinate_type vessel_pos
+      )
+{
+//printf("TRACE SIMPLE  %d beacons\n", path_map->num_beacons);
+   const double t0 = system_now();
+   reset_path_map(path_map);
+   uint32_t num_nodes = (uint32_t) (path_map->size.x * path_map->size.y);
+   for (uint32_t idx=0; idx<num_nodes; idx++) {
+      set_node_cost(path_map, idx);
+   }
+//   path_map->destination = convert_latlon_to_akn(path_map->center);
+   // add beacon and dest weights to map, as able
+   path_map->read_idx = 0;
+   path_map->write_idx = 0;
+   calculate_destination_map_position(path_map);
+   path_map->num_seeds =
+         collect_path_seeds(path_map, vessel_pos, path_map->seeds);
+   for (uint32_t i=0; i<path_map->num_seeds; i++) {
+      const path_seed_type *seed = &path_map->seeds[i];
+      add_point_to_path_stack(path_map, seed->pos, seed->weight);
+   }
+   uint32_t cnt = propagate_path_weights(path_map);
 //printf("Processed %d nodes\n", cnt);
    degree_type center_latitude = { .degrees = path_map->center.latitude };
    build_course_vectors(path_map, center_latitude);
+   path_map->trace_valid = 1;
+   path_map->vessel_plan_pix = get_pix_position_in_map(path_map, vessel_pos);
+   path_map->full_trace_stats.nodes_touched = cnt;
+   path_map->full_trace_stats.elapsed_sec = system_now() - t0;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// incremental replanning
+//
+// the trace is a shortest-path field from all seeds, with every node
+//    linked to its parent. when something changes, nodes whose weight
+//    depended on it (ie, the subtrees below changed nodes or removed
+//    seeds) are invalidated. the invalidated region is then refilled
+//    from its valid border, and from any new or lowered seeds, and
+//    weight decreases propagate out from there as in a full trace.
+//    nodes whose weights don't change are never visited, which is
+//    most of the map for a local change
+// link costs are fixed (node penalties are set before tracing and
+//    jitter is a function of the link) so the repaired trace matches
+//    what a full trace would produce
+
+// clears path info from node at idx and all nodes that descend from it
+//    (ie, that have it as an ancestor). cleared nodes are added to the
+//    touched list
+static void invalidate_subtree(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const uint32_t idx
+      )
+{
+   path_map_node_type *node = &path_map->nodes[idx];
+   if ((node->flags & PATH_NODE_FLAG_PROCESSED) == 0) {
+      // no path info so nothing can depend on it
+      return;
+   }
+   // touched list is used as the queue for the subtree walk. descendants
+   //    are found by looking for neighbors that have the node as parent
+   uint32_t head = path_map->num_touched;
+   node->weight = -1.0f;
+   node->parent_id.val = -1;
+   node->flags &= ~(uint32_t) PATH_NODE_FLAG_PROCESSED;
+   mark_touched(path_map, idx);
+   while (head < path_map->num_touched) {
+      const uint32_t root_idx = path_map->touched[head++].idx;
+      const image_coordinate_type pos = path_map->nodes[root_idx].pos;
+      for (uint32_t i=0; i<8; i++) {
+         int32_t nbr_idx = get_neighbor_idx(path_map, pos, NEIGHBORS_8[i]);
+         if (nbr_idx < 0) {
+            continue;
+         }
+         path_map_node_type *nbr = &path_map->nodes[nbr_idx];
+         if ((nbr->parent_id.val == (int32_t) root_idx) &&
+               (nbr->flags & PATH_NODE_FLAG_PROCESSED)) {
+            nbr->weight = -1.0f;
+            nbr->parent_id.val = -1;
+            nbr->flags &= ~(uint32_t) PATH_NODE_FLAG_PROCESSED;
+            mark_touched(path_map, (uint32_t) nbr_idx);
+         }
+      }
+   }
+}
+
+
+void update_path_costs(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const image_coordinate_type top_left,
+      /* in     */ const image_coordinate_type bottom_right
+      )
+{
+   path_map->feature_generation++;
+   if (path_map->trace_valid == 0) {
+      // nothing to repair. costs are set on the next trace
+      return;
+   }
+   uint32_t x_end = bottom_right.x < path_map->size.x ?
+         bottom_right.x : path_map->size.x;
+   uint32_t y_end = bottom_right.y < path_map->size.y ?
+         bottom_right.y : path_map->size.y;
+   for (uint32_t y=top_left.y; y<y_end; y++) {
+      for (uint32_t x=top_left.x; x<x_end; x++) {
+         uint32_t idx = x + y * path_map->size.x;
+         if (set_node_cost(path_map, idx) == 0) {
+            continue;
+         }
+         // cost to enter node changed, so its weight and that of its
+         //    descendants is stale. cost of diagonal links past the node
+         //    also changed, and those end at its 4-connected neighbors
+         image_coordinate_type pos = path_map->nodes[idx].pos;
+         invalidate_subtree(path_map, idx);
+         for (uint32_t i=0; i<4; i++) {
+            int32_t nbr_idx =
+                  get_neighbor_idx(path_map, pos, NEIGHBORS_8[i]);
+            if (nbr_idx >= 0) {
+               invalidate_subtree(path_map, (uint32_t) nbr_idx);
+            }
+         }
+         // node may have become passable, in which case it has no path
+         //    info yet. make sure it's refilled from its neighbors
+         mark_touched(path_map, idx);
+      }
+   }
+}
+
+
+// rebuilds course vectors for touched nodes and for nodes whose course
+//    depends on them (ie, descendants w/in NUM_ANCESTORS_FOR_DIRECTION
+//    generations). clears touched list
+static void update_course_vectors(
+      /* in out */       path_map_type *path_map
+      )
+{
+   // extend touched list, one generation at a time
+   uint32_t gen_start = 0;
+   for (uint32_t gen=1; gen<NUM_ANCESTORS_FOR_DIRECTION; gen++) {
+      uint32_t gen_end = path_map->num_touched;
+      for (uint32_t i=gen_start; i<gen_end; i++) {
+         const uint32_t root_idx = path_map->touched[i].idx;
+         const image_coordinate_type pos = path_map->nodes[root_idx].pos;
+         for (uint32_t j=0; j<8; j++) {
+            int32_t nbr_idx =
+                  get_neighbor_idx(path_map, pos, NEIGHBORS_8[j]);
+            if ((nbr_idx >= 0) && (path_map->nodes[nbr_idx].parent_id.val
+                  == (int32_t) root_idx)) {
+               mark_touched(path_map, (uint32_t) nbr_idx);
+            }
+         }
+      }
+      gen_start = gen_end;
+   }
+   degree_type center_latitude = { .degrees = path_map->center.latitude };
+   course_lut_type lut;
+   init_course_lut(&lut);
+   for (uint32_t i=0; i<path_map->num_touched; i++) {
+      const uint32_t idx = path_map->touched[i].idx;
+      path_map_node_type *node = &path_map->nodes[idx];
+      update_course_lut(&lut,
+            course_scale(path_map, center_latitude, node->pos.y));
+      set_node_course(path_map, idx, &lut);
+      node->flags &= ~(uint32_t) PATH_NODE_FLAG_TOUCHED;
+   }
+   path_map->num_touched = 0;
+}
+
+
+uint32_t replan_route(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const world_coordinate_type vessel_pos
+      )
+{
+   const double t0 = system_now();
+   image_coordinate_type prev_dest = path_map->dest_pix;
+   calculate_destination_map_position(path_map);
+   if ((path_map->trace_valid == 0) ||
+         (prev_dest.x != path_map->dest_pix.x) ||
+         (prev_dest.y != path_map->dest_pix.y)) {
+      trace_route_simple(path_map, vessel_pos);
+      return path_map->full_trace_stats.nodes_touched;
+   }
+   /////////////////////////////////////////////
+   // remove seeds that are no longer present
+   path_seed_type seeds[MAX_PATH_MAP_BEACONS + 1];
+   uint32_t num_seeds = collect_path_seeds(path_map, vessel_pos, seeds);
+   uint32_t matched[MAX_PATH_MAP_BEACONS + 1] = { 0 };
+   for (uint32_t i=0; i<path_map->num_seeds; i++) {
+      const path_seed_type *old_seed = &path_map->seeds[i];
+      uint32_t found = 0;
+      for (uint32_t j=0; j<num_seeds; j++) {
+         if ((matched[j] == 0) && (seeds[j].pos.x == old_seed->pos.x) &&
+               (seeds[j].pos.y == old_seed->pos.y) &&
+               (seeds[j].weight == old_seed->weight)) {
+            matched[j] = 1;
+            found = 1;
+            break;
+         }
+      }
+      if (found != 0) {
+         continue;
+      }
+      // if seed is still the root of its node then everything below it
+      //    is stale. if a lower weight reached the node then nothing
+      //    depends on the seed
+      uint32_t idx = (uint32_t) (old_seed->pos.x +
+            old_seed->pos.y * path_map->size.x);
+      const path_map_node_type *node = &path_map->nodes[idx];
+      if ((node->parent_id.val < 0) && (node->weight == old_seed->weight)) {
+         invalidate_subtree(path_map, idx);
+      }
+   }
+   /////////////////////////////////////////////
+   // refill invalidated nodes from their valid neighbors
+   // touched list presently holds invalidated nodes, both from here and
+   //    from update_path_costs()
+   uint32_t num_invalid = path_map->num_touched;
+   uint32_t num_nodes = (uint32_t) (path_map->size.x * path_map->size.y);
+   if (8u * num_invalid + num_seeds >= num_nodes) {
+      // too much to repair. it's faster (and stack won't overflow) to
+      //    start over
+      trace_route_simple(path_map, vessel_pos);
+      return path_map->full_trace_stats.nodes_touched;
+   }
+   path_map->read_idx = 0;
+   path_map->write_idx = 0;
+   for (uint32_t i=0; i<num_invalid; i++) {
+      const image_coordinate_type pos =
+            path_map->nodes[path_map->touched[i].idx].pos;
+      for (uint32_t j=0; j<8; j++) {
+         int32_t nbr_idx = get_neighbor_idx(path_map, pos, NEIGHBORS_8[j]);
+         if ((nbr_idx >= 0) && (path_map->nodes[nbr_idx].flags &
+               PATH_NODE_FLAG_PROCESSED)) {
+            path_map->stack[path_map->write_idx++].idx = (uint32_t) nbr_idx;
+         }
+      }
+   }
+   // (re)apply all seeds. ones that are new, or were invalidated, or
+   //    that have a lower weight than their node are pushed to stack
+   for (uint32_t i=0; i<num_seeds; i++) {
+      add_point_to_path_stack(path_map, seeds[i].pos, seeds[i].weight);
+   }
+   memcpy(path_map->seeds, seeds, num_seeds * sizeof *seeds);
+   path_map->num_seeds = num_seeds;
+   path_map->vessel_plan_pix = get_pix_position_in_map(path_map, vessel_pos);
+   uint32_t cnt = num_invalid + propagate_path_weights(path_map);
+   update_course_vectors(path_map);
+   path_map->replan_stats.nodes_touched = cnt;
+   path_map->replan_stats.elapsed_sec = system_now() - t0;
+   log_info(log_, "Replanned route in %.2f ms, %d nodes touched (full "
+         "trace %.2f ms, %d nodes)",
+         1000.0 * path_map->replan_stats.elapsed_sec, cnt,
+         1000.0 * path_map->full_trace_stats.elapsed_sec,
+         path_map->full_trace_stats.nodes_touched);
+   return cnt;
 }
 
 
@@ -527,7 +1016,7 @@ fprintf(stderr, "Generating offset map, but vessel pix %d,%d in old map has no p
             vessel_pix.x, vessel_pix.y, vessel_pos.lon, vessel_pos.lat);
       //
 printf("  (no path info)\n");
-      load_world_5sec_map(vessel_pos, path_map);
+      recenter_world_5sec_map(vessel_pos, path_map);
    } else {
       // get direction vessel should be moving and build map based on that
       // direction to head to reach destination
@@ -538,10 +1027,27 @@ printf("  (no path info)\n");
             { .meters = VESSEL_OFFSET_FROM_MAP_CENTER_NM * NM_TO_METERS };
       world_coordinate_type new_center =
             calc_offset_position(vessel_pos, course, dist);
-      // load map
-      load_world_5sec_map(new_center, path_map);
+      // move map. if it's a short distance from where it was, only
+      //    the newly exposed parts of the map are loaded
+      recenter_world_5sec_map(new_center, path_map);
    }
    load_beacons_into_path_map(path_map);
+   if ((path_map->dest_pix.x >= MAP_LEVEL3_SIZE) ||
+         (path_map->dest_pix.y >= MAP_LEVEL3_SIZE)) {
+      // destination isn't in map so beacons are needed to pull vessel
+      //    toward it. if none of them have weights then vessel is
+      //    outside of the corridor that beacon search covered
+      uint32_t have_weights = 0;
+      for (uint32_t i=0; i<path_map->num_beacons; i++) {
+         if (path_map->beacon_ref[i].path_weight > 0.0f) {
+            have_weights = 1;
+            break;
+         }
+      }
+      if (have_weights == 0) {
+         update_beacon_corridor(path_map, vessel_pos);
+      }
+   }
 //write_depth_map(path_map, "c.pnm");
    trace_route_simple(path_map, vessel_pos);
    path_map->vessel_start_pix = get_pix_position_in_map(path_map,
@@ -583,7 +1089,7 @@ int trace_route_initial(
    check_world_coordinate(ves_pos, __func__);
    path_map->destination = convert_latlon_to_akn(destination);
    // construct beacon path map
-   if (trace_beacon_paths(path_map, dest) != 0) {
+   if (trace_beacon_paths(path_map, dest, ves_pos) != 0) {
       // something bad happened. error should have been reported from
       //    w/in function itself
       goto end;
@@ -603,6 +1109,9 @@ printf("Route initial -- map center\n");
    image_coordinate_type center =
          { .x = MAP_LEVEL3_SIZE/2, .y = MAP_LEVEL3_SIZE/2 };
    rebuild_map_by_vessel_offset(path_map, center, ves_pos);
+   log_info(log_, "Route planned. local map trace %.1f ms (%d nodes)",
+         1000.0 * path_map->full_trace_stats.elapsed_sec,
+         path_map->full_trace_stats.nodes_touched);
    rc = 0;
 end:
    return rc;
@@ -164,6 +164,34 @@ static void shrink_path_stack(
 }
 
 
+// bitfields for get_offset_mask() and get_offset_mask_wide(), indexed
+//    by (dx+1) + 3*(dy+1). these are called for every node when
+//    building course vectors so they're table driven
+static const uint8_t OFFSET_MASK_LUT_[9] = {
+      0b00000001,    // NW
+      0b10000000,    // N
+      0b01000000,    // NE
+      0b00000010,    // W
+      0,             // no offset
+      0b00100000,    // E
+      0b00000100,    // SW
+      0b00001000,    // S
+      0b00010000     // SE
+};
+
+static const uint8_t OFFSET_MASK_WIDE_LUT_[9] = {
+      0b10000011,    // NW
+      0b11000001,    // N
+      0b11100000,    // NE
+      0b00000111,    // W
+      0,             // no offset
+      0b01110000,    // E
+      0b00001110,    // SW
+      0b00011100,    // S
+      0b00111000     // SE
+};
+
+
 // given two adjacent pixels, generate bitfield indicating which direction
 //    b is from a. one bit is set for either of the 8 possibile offsets
 static pixel_offset_bitfield_type get_offset_mask(
@@ -171,50 +199,12 @@ static pixel_offset_bitfield_type get_offset_mask(
       /* in     */ const image_coordinate_type b
       )
 {
-   pixel_offset_bitfield_type offset;
    int32_t dx = a.x - b.x + 1;
    int32_t dy = a.y - b.y + 1;
-   assert(dx <= 2);
-   assert(dy <= 2);
-   uint32_t idx = (uint32_t) (dx + dy * 3);
-   switch (idx) {
-      case 1:     // N
-         offset.mask = 0b10000000;
-         //offset.mask = 0x80;
-         break;
-      case 2:     // NE
-         offset.mask = 0b01000000;
-         //offset.mask = 0x40;
-         break;
-      case 5:     // E
-         offset.mask = 0b00100000;
-         //offset.mask = 0x20;
-         break;
-      case 8:     // SE
-         offset.mask = 0b00010000;
-         //offset.mask = 0x10;
-         break;
-      case 7:     // S
-         offset.mask = 0b00001000;
-         //offset.mask = 0x08;
-         break;
-      case 6:     // SW
-         offset.mask = 0b00000100;
-         //offset.mask = 0x04;
-         break;
-      case 3:     // W
-         offset.mask = 0b00000010;
-         //offset.mask = 0x02;
-         break;
-      case 0:     // NW
-         offset.mask = 0b00000001;
-         //offset.mask = 0x01;
-         break;
-      case 4:     // no offset -- fall through
-      default:    // not reachable (no legal default)
-         offset.mask = 0;
-         break;
-   }
+   assert((dx >= 0) && (dx <= 2));
+   assert((dy >= 0) && (dy <= 2));
+   pixel_offset_bitfield_type offset = {
+         .mask = OFFSET_MASK_LUT_[dx + dy * 3] };
    return offset;
 }
 
@@ -227,50 +217,12 @@ static pixel_offset_bitfield_type get_offset_mask_wide(
       /* in     */ const image_coordinate_type b
       )
 {
-   pixel_offset_bitfield_type offset;
    int32_t dx = a.x - b.x + 1;
    int32_t dy = a.y - b.y + 1;
-   assert(dx <= 2);
-   assert(dy <= 2);
-   uint32_t idx = (uint32_t) (dx + dy * 3);
-   switch (idx) {
-      case 1:     // N
-         offset.mask = 0b11000001;
-         //offset.mask = BIN(1100, 0001);
-         break;
-      case 2:     // NE
-         offset.mask = 0b11100000;
-         //offset.mask = BIN(1110, 0000);
-         break;
-      case 5:     // E
-         offset.mask = 0b01110000;
-         //offset.mask = BIN(0111, 0000);
-         break;
-      case 8:     // SE
-         offset.mask = 0b00111000;
-         //offset.mask = BIN(0011, 1000);
-         break;
-      case 7:     // S
-         offset.mask = 0b00011100;
-         //offset.mask = BIN(0001, 1100);
-         break;
-      case 6:     // SW
-         offset.mask = 0b00001110;
-         //offset.mask = BIN(0000, 1110);
-         break;
-      case 3:     // W
-         offset.mask = 0b00000111;
-         //offset.mask = BIN(0000, 0111);
-         break;
-      case 0:     // NW
-         offset.mask = 0b10000011;
-         //offset.mask = BIN(1000, 0011);
-         break;
-      case 4:     // no offset -- fall through
-      default:    // not reachable (no legal default)
-         offset.mask = 0;
-         break;
-   }
+   assert((dx >= 0) && (dx <= 2));
+   assert((dy >= 0) && (dy <= 2));
+   pixel_offset_bitfield_type offset = {
+         .mask = OFFSET_MASK_WIDE_LUT_[dx + dy * 3] };
    return offset;
 }
 
@@ -0,0 +1,233 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "timekeeper.h"
+#include "logger.h"
+
+// checks that the corridor search over the beacon graph gives the same
+//    weights as an exhaustive search, for the beacons it reaches. uses
+//    a synthetic beacon grid so no map data is needed
+
+#include "../world_map.c"
+
+// grid of beacons spanning 30 degrees latitude and 80 longitude
+#define GRID_ROWS    100
+#define GRID_COLS    267
+#define GRID_STEP_DEG      0.3
+#define GRID_TOP_AKN_Y     30.0
+#define GRID_LEFT_AKN_X    180.0
+
+static float *reference_;
+
+
+static uint32_t grid_idx(
+      /* in     */ const int32_t col,
+      /* in     */ const int32_t row
+      )
+{
+   return (uint32_t) (col + row * GRID_COLS);
+}
+
+
+// beacons have 8-connected neighbors, with weights that are 0-15% above
+//    1 per path-map node (1/720 degree). walls of missing beacons force
+//    detours
+static void create_beacons(void)
+{
+   tot_num_beacons_ = GRID_ROWS * GRID_COLS;
+   beacon_list_ = calloc(tot_num_beacons_, sizeof *beacon_list_);
+   beacon_weights_ = malloc(tot_num_beacons_ * sizeof *beacon_weights_);
+   beacon_keys_ = malloc(tot_num_beacons_ * sizeof *beacon_keys_);
+   beacon_heap_ = malloc(tot_num_beacons_ * sizeof *beacon_heap_);
+   beacon_heap_pos_ = malloc(tot_num_beacons_ * sizeof *beacon_heap_pos_);
+   beacon_gen_ = calloc(tot_num_beacons_, sizeof *beacon_gen_);
+   for (int32_t row=0; row<GRID_ROWS; row++) {
+      for (int32_t col=0; col<GRID_COLS; col++) {
+         beacon_record_type *rec = &beacon_list_[grid_idx(col, row)];
+         rec->akn_x = (float) (GRID_LEFT_AKN_X + col * GRID_STEP_DEG);
+         rec->akn_y = (float) (GRID_TOP_AKN_Y + row * GRID_STEP_DEG);
+         rec->index = grid_idx(col, row);
+         // walls with gaps
+         const int32_t wall = col % 40;
+         if ((col > 20) && (wall == 0) && (((col / 40) & 1) ?
+               (row > 40) : (row < GRID_ROWS - 40))) {
+            rec->num_neighbors = -1;
+         }
+      }
+   }
+   uint32_t seed = 3;
+   for (int32_t row=0; row<GRID_ROWS; row++) {
+      for (int32_t col=0; col<GRID_COLS; col++) {
+         beacon_record_type *rec = &beacon_list_[grid_idx(col, row)];
+         if (rec->num_neighbors < 0) {
+            continue;
+         }
+         for (int32_t dy=-1; dy<=1; dy++) {
+            for (int32_t dx=-1; dx<=1; dx++) {
+               const int32_t c = col + dx;
+               const int32_t r = row + dy;
+               if (((dx == 0) && (dy == 0)) || (c < 0) || (r < 0) ||
+                     (c >= GRID_COLS) || (r >= GRID_ROWS)) {
+                  continue;
+               }
+               const beacon_record_type *nbr = &beacon_list_[grid_idx(c, r)];
+               if (nbr->num_neighbors < 0) {
+                  continue;
+               }
+               bound_pos_.akn_x = nbr->akn_x;
+               bound_pos_.akn_y = nbr->akn_y;
+               bound_cos_lat_ = cos(D2R * (90.0 - bound_pos_.akn_y));
+               seed = seed * 1103515245u + 12345u;
+               const float extra = 1.0f + 0.15f *
+                     (float) ((seed >> 16) & 1023) / 1024.0f;
+               beacon_neighbor_type *link =
+                     &rec->neighbors[rec->num_neighbors++];
+               link->nbr_index = grid_idx(c, r);
+               link->path_weight = beacon_weight_bound(rec) * extra *
+                     (float) (BEACON_PATH_NODES_PER_DEG /
+                     BEACON_SEARCH_MIN_WEIGHT_PER_DEG);
+            }
+         }
+      }
+   }
+}
+
+
+// exhaustive search for reference weights
+static void search_all(void)
+{
+   uint32_t *queue = malloc(16 * tot_num_beacons_ * sizeof *queue);
+   uint32_t head = 0;
+   uint32_t tail = 0;
+   for (uint32_t i=0; i<tot_num_beacons_; i++) {
+      reference_[i] = -1.0f;
+   }
+   for (uint32_t i=0; i<num_beacon_seeds_; i++) {
+      reference_[beacon_seed_idx_[i]] = beacon_seed_weight_[i];
+      queue[tail++] = beacon_seed_idx_[i];
+   }
+   while (head < tail) {
+      const beacon_record_type *rec = &beacon_list_[queue[head++]];
+      for (int32_t i=0; i<rec->num_neighbors; i++) {
+         const beacon_neighbor_type *link = &rec->neighbors[i];
+         const float w = reference_[rec->index] + link->path_weight;
+         float *nbr_wt = &reference_[link->nbr_index];
+         if ((*nbr_wt < 0.0f) || (w < *nbr_wt)) {
+            *nbr_wt = w;
+            queue[tail++] = link->nbr_index;
+         }
+      }
+      if (tail >= 16 * tot_num_beacons_) {
+         memmove(queue, &queue[head], (tail - head) * sizeof *queue);
+         tail -= head;
+         head = 0;
+      }
+   }
+   free(queue);
+}
+
+
+// world position of beacon grid position (akn x is 180 + longitude)
+static world_coordinate_type grid_pos(
+      /* in     */ const double col,
+      /* in     */ const double row
+      )
+{
+   world_coordinate_type pos = {
+         .lon = GRID_LEFT_AKN_X - 180.0 + col * GRID_STEP_DEG,
+         .lat = 90.0 - (GRID_TOP_AKN_Y + row * GRID_STEP_DEG) };
+   return pos;
+}
+
+
+static uint32_t check_corridor(
+      /* in     */ const world_coordinate_type vessel_pos,
+      /* in     */ const uint32_t nearest_beacon,
+      /* in     */ const char *label
+      )
+{
+   uint32_t errs = 0;
+   uint32_t expanded = search_beacon_graph(vessel_pos);
+   uint32_t with_weight = 0;
+   uint32_t mismatch = 0;
+   for (uint32_t i=0; i<tot_num_beacons_; i++) {
+      const float weight = get_beacon_weight(i);
+      if (weight < 0.0f) {
+         continue;
+      }
+      with_weight++;
+      if (fabsf(weight - reference_[i]) > 1.0e-3f) {
+         if (mismatch < 5) {
+            printf("    beacon %d has weight %.3f, expected %.3f\n", i,
+                  (double) weight, (double) reference_[i]);
+         }
+         mismatch++;
+      }
+   }
+   printf("  %-20s %5d of %d beacons expanded, %5d with weights, "
+         "%.2f ms\n", label, expanded, tot_num_beacons_, with_weight,
+         1000.0 * beacon_search_stats_.elapsed_sec);
+   if (mismatch > 0) {
+      printf("    %d beacons differ from full search\n", mismatch);
+      errs++;
+   }
+   if (get_beacon_weight(nearest_beacon) < 0.0f) {
+      printf("    beacon next to vessel has no weight\n");
+      errs++;
+   }
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   create_beacons();
+   reference_ = malloc(tot_num_beacons_ * sizeof *reference_);
+   // destination at east end of grid
+   num_beacon_seeds_ = 2;
+   beacon_seed_idx_[0] = grid_idx(GRID_COLS - 3, GRID_ROWS / 2);
+   beacon_seed_weight_[0] = 20.0f;
+   beacon_seed_idx_[1] = grid_idx(GRID_COLS - 2, GRID_ROWS / 2 + 1);
+   beacon_seed_weight_[1] = 35.0f;
+   double t0 = system_now();
+   search_all();
+   double full_sec = system_now() - t0;
+   printf("Comparing corridor and full beacon searches\n");
+   printf("  %-20s %5d beacons, %.2f ms\n", "full search",
+         tot_num_beacons_, 1000.0 * full_sec);
+   errs += check_corridor(grid_pos(5.2, 50.1), grid_idx(5, 50),
+         "vessel far");
+   errs += check_corridor(grid_pos(130.2, 55.1), grid_idx(130, 55),
+         "vessel midway");
+   errs += check_corridor(grid_pos(241.2, 43.1), grid_idx(241, 43),
+         "vessel past wall");
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
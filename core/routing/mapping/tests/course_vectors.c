@@ -0,0 +1,198 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "timekeeper.h"
+#include "logger.h"
+
+// checks that table-driven course vectors match those from calling
+//    atan2 for each node, to w/in one heading bin (1/256 of circle),
+//    and times both. uses a synthetic map so no map data is needed
+
+#include "../world_map.c"
+
+#define MAP_SIZE        720
+
+// one heading bin, in bam16
+#define HEADING_BIN     256
+
+
+// scattered islands
+static void create_map(
+      /*    out */       map_level3_type *map3
+      )
+{
+   uint32_t seed = 11;
+   for (uint32_t i=0; i<MAP_SIZE*MAP_SIZE; i++) {
+      seed = seed * 1103515245u + 12345u;
+      map3->grid[i].min_depth = (uint8_t) (20 + ((seed >> 16) % 80));
+   }
+   for (uint32_t n=0; n<1500; n++) {
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cx = (int32_t) ((seed >> 8) % MAP_SIZE);
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cy = (int32_t) ((seed >> 8) % MAP_SIZE);
+      const int32_t r = (int32_t) ((seed >> 4) % 9);
+      for (int32_t y=cy-r; y<=cy+r; y++) {
+         for (int32_t x=cx-r; x<=cx+r; x++) {
+            if ((x >= 0) && (y >= 0) && (x < MAP_SIZE) && (y < MAP_SIZE)
+                  && ((x-cx)*(x-cx) + (y-cy)*(y-cy) <= r*r)) {
+               map3->grid[x + y * MAP_SIZE].min_depth = 0;
+            }
+         }
+      }
+   }
+   // keep center open, for destination
+   for (uint32_t y=355; y<=365; y++) {
+      for (uint32_t x=355; x<=365; x++) {
+         map3->grid[x + y * MAP_SIZE].min_depth = 50;
+      }
+   }
+}
+
+
+// course for node computed as it was before lookup tables, w/ atan2
+//    for each node
+static bam16_type reference_course(
+      /* in     */ const path_map_type *path_map,
+      /* in     */ const uint32_t idx,
+      /* in     */ const double scale
+      )
+{
+   pixel_offset_bitfield_type base_direction, next_direction;
+   const path_map_node_type *root = &path_map->nodes[idx];
+   const path_map_node_type *ggp = root;
+   for (uint32_t gen=0; gen<NUM_ANCESTORS_FOR_DIRECTION; gen++) {
+      if (ggp->parent_id.val < 0) {
+         break;
+      }
+      const path_map_node_type *next_ggp =
+            &path_map->nodes[ggp->parent_id.idx];
+      if (gen == 0) {
+         base_direction = get_offset_mask(next_ggp->pos, ggp->pos);
+      } else {
+         next_direction = get_offset_mask_wide(next_ggp->pos, ggp->pos);
+         if ((next_direction.mask & base_direction.mask) == 0) {
+            break;
+         }
+      }
+      ggp = next_ggp;
+   }
+   const int32_t dx = ggp->pos.x - root->pos.x;
+   const int32_t dy = ggp->pos.y - root->pos.y;
+   bam16_type course;
+   CVT_DEG_TO_BAM16(R2D * atan2((double) dx * scale, (double) -dy), course);
+   return course;
+}
+
+
+static void reference_course_vectors(
+      /* in     */ const path_map_type *path_map,
+      /*    out */       bam16_type *courses
+      )
+{
+   degree_type center_latitude = { .degrees = path_map->center.latitude };
+   for (uint32_t y=0; y<MAP_SIZE; y++) {
+      double scale = course_scale(path_map, center_latitude, y);
+      for (uint32_t x=0; x<MAP_SIZE; x++) {
+         const uint32_t idx = x + y * MAP_SIZE;
+         courses[idx] = reference_course(path_map, idx, scale);
+      }
+   }
+}
+
+
+static uint32_t check_latitude(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const map_level3_type *map3,
+      /* in     */ const double latitude,
+      /* in out */       bam16_type *reference
+      )
+{
+   const world_coordinate_type center = { .lon=237.5, .lat=latitude };
+   set_map_center(center, path_map);
+   for (uint32_t idx=0; idx<MAP_SIZE*MAP_SIZE; idx++) {
+      set_node_depth(path_map, map3, idx);
+   }
+   mark_land_adjacency(path_map);
+   path_map->destination = convert_latlon_to_akn(center);
+   path_map->num_beacons = 0;
+   trace_route_simple(path_map, center);
+   degree_type center_latitude = { .degrees = path_map->center.latitude };
+   const uint32_t iterations = 10;
+   double ref_sec = 0.0;
+   double lut_sec = 0.0;
+   for (uint32_t i=0; i<iterations; i++) {
+      double t0 = system_now();
+      reference_course_vectors(path_map, reference);
+      ref_sec += system_now() - t0;
+      t0 = system_now();
+      build_course_vectors(path_map, center_latitude);
+      lut_sec += system_now() - t0;
+   }
+   uint32_t max_diff = 0;
+   uint32_t num_diff = 0;
+   for (uint32_t idx=0; idx<MAP_SIZE*MAP_SIZE; idx++) {
+      const bam16_type delta = { .angle16 = (uint16_t)
+            (path_map->nodes[idx].true_course.angle16 -
+            reference[idx].angle16) };
+      const uint32_t diff = (uint32_t) abs(delta.sangle16);
+      if (diff > 0) {
+         num_diff++;
+      }
+      if (diff > max_diff) {
+         max_diff = diff;
+      }
+   }
+   printf("  lat %4.1f  atan2 %6.2f ms  table %6.2f ms  "
+         "%6d nodes differ, max %d bam16\n", latitude,
+         1000.0 * ref_sec / iterations, 1000.0 * lut_sec / iterations,
+         num_diff, max_diff);
+   if (max_diff > HEADING_BIN) {
+      printf("    courses differ by more than one heading bin\n");
+      return 1;
+   }
+   return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   image_size_type size = { .x=MAP_SIZE, .y=MAP_SIZE };
+   path_map_type *path_map = create_path_map(size);
+   map_level3_type *map3 = malloc(sizeof *map3);
+   bam16_type *reference = malloc(MAP_SIZE * MAP_SIZE * sizeof *reference);
+   create_map(map3);
+   printf("Comparing course vectors from lookup table and atan2\n");
+   errs += check_latitude(path_map, map3, 0.5, reference);
+   errs += check_latitude(path_map, map3, 48.5, reference);
+   errs += check_latitude(path_map, map3, 71.5, reference);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
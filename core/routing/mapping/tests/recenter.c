@@ -0,0 +1,186 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "timekeeper.h"
+#include "logger.h"
+
+// checks that shifting map content and updating adjacency near the
+//    seams gives the same feature nodes as loading the shifted map
+//    from scratch. uses a synthetic world so no map data is needed
+
+#include "../world_map.c"
+
+// synthetic world is larger than map so it can be shifted around in it
+#define WORLD_SIZE      1200
+#define MAP_SIZE        720
+
+static uint8_t world_[WORLD_SIZE * WORLD_SIZE];
+
+// scattered islands of various sizes, plus a coastline along one edge
+static void create_world(void)
+{
+   uint32_t seed = 1;
+   for (uint32_t i=0; i<WORLD_SIZE*WORLD_SIZE; i++) {
+      seed = seed * 1103515245u + 12345u;
+      world_[i] = (uint8_t) (20 + ((seed >> 16) % 80));
+   }
+   for (uint32_t n=0; n<3000; n++) {
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cx = (int32_t) ((seed >> 8) % WORLD_SIZE);
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cy = (int32_t) ((seed >> 8) % WORLD_SIZE);
+      const int32_t r = (int32_t) ((seed >> 4) % 6);
+      for (int32_t y=cy-r; y<=cy+r; y++) {
+         for (int32_t x=cx-r; x<=cx+r; x++) {
+            if ((x >= 0) && (y >= 0) && (x < WORLD_SIZE) && (y < WORLD_SIZE)
+                  && ((x-cx)*(x-cx) + (y-cy)*(y-cy) <= r*r)) {
+               world_[x + y * WORLD_SIZE] = 0;
+            }
+         }
+      }
+   }
+   for (uint32_t y=0; y<WORLD_SIZE; y++) {
+      for (uint32_t x=0; x<(y % 17) + 5; x++) {
+         world_[x + y * WORLD_SIZE] = 0;
+      }
+   }
+}
+
+
+// copies part of world, with top-left at left,top, to level-3 map
+static void extract_map(
+      /* in     */ const int32_t left,
+      /* in     */ const int32_t top,
+      /*    out */       map_level3_type *map3
+      )
+{
+   for (int32_t y=0; y<MAP_SIZE; y++) {
+      memcpy(&map3->grid[y * MAP_SIZE],
+            &world_[left + (y + top) * WORLD_SIZE], MAP_SIZE);
+   }
+}
+
+
+// fills path map from level-3 map as load_world_5sec_map() does
+static void load_full(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const map_level3_type *map3
+      )
+{
+   for (uint32_t idx=0; idx<MAP_SIZE*MAP_SIZE; idx++) {
+      set_node_depth(path_map, map3, idx);
+   }
+   mark_land_adjacency(path_map);
+}
+
+
+static uint32_t compare_maps(
+      /* in     */ const path_map_type *a,
+      /* in     */ const path_map_type *b
+      )
+{
+   uint32_t errs = 0;
+   for (uint32_t idx=0; idx<MAP_SIZE*MAP_SIZE; idx++) {
+      const map_feature_node_type *na = &a->feature_nodes[idx];
+      const map_feature_node_type *nb = &b->feature_nodes[idx];
+      if (na->features_all != nb->features_all) {
+         if (errs < 5) {
+            printf("    node %d,%d: depth %d/%d land %d/%d near %d/%d\n",
+                  idx % MAP_SIZE, idx / MAP_SIZE,
+                  na->depth_meters, nb->depth_meters,
+                  na->land_cnt, nb->land_cnt, na->near_cnt, nb->near_cnt);
+         }
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   image_size_type size = { .x=MAP_SIZE, .y=MAP_SIZE };
+   path_map_type *shifted = create_path_map(size);
+   path_map_type *reloaded = create_path_map(size);
+   map_level3_type *map3 = malloc(sizeof *map3);
+   create_world();
+   printf("Comparing shifted and reloaded maps\n");
+   // series of moves, including diagonal, single node, max shift
+   //    and moves that return to earlier positions
+   const int32_t moves[][2] = {
+         { 12, 0 }, { 0, 12 }, { -12, -12 }, { 7, -3 }, { -1, 1 },
+         { 0, -240 }, { 240, 240 }, { -200, 13 }, { 0, 0 }, { 30, -30 }
+   };
+   const uint32_t num_moves = sizeof moves / sizeof moves[0];
+   int32_t left = 200;
+   int32_t top = 300;
+   extract_map(left, top, map3);
+   load_full(shifted, map3);
+   for (uint32_t i=0; i<num_moves; i++) {
+      // moving map center by +dx moves content by -dx
+      const int32_t dx = moves[i][0];
+      const int32_t dy = moves[i][1];
+      left += dx;
+      top += dy;
+      extract_map(left, top, map3);
+      shift_map_nodes(shifted, -dx, -dy, map3);
+      load_full(reloaded, map3);
+      uint32_t mismatch = compare_maps(shifted, reloaded);
+      if (mismatch > 0) {
+         printf("  move %d (%d,%d): %d nodes differ\n", i, dx, dy, mismatch);
+         errs++;
+      }
+   }
+   ////////////////////////////////////////////////////////////
+   printf("Timing node update (map data not included)\n");
+   const uint32_t iterations = 20;
+   double full_sec = 0.0;
+   for (uint32_t i=0; i<iterations; i++) {
+      double t0 = system_now();
+      load_full(reloaded, map3);
+      full_sec += system_now() - t0;
+   }
+   printf("  full load        %7.3f ms\n", 1000.0 * full_sec / iterations);
+   const int32_t shifts[] = { 1, 12, 60, 240 };
+   for (uint32_t s=0; s<sizeof shifts / sizeof shifts[0]; s++) {
+      double shift_sec = 0.0;
+      for (uint32_t i=0; i<iterations; i++) {
+         // alternate direction so map stays in the same place
+         const int32_t d = (i & 1) ? -shifts[s] : shifts[s];
+         double t0 = system_now();
+         shift_map_nodes(shifted, d, d, map3);
+         shift_sec += system_now() - t0;
+      }
+      printf("  shift %3d,%3d    %7.3f ms\n", shifts[s], shifts[s],
+            1000.0 * shift_sec / iterations);
+   }
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
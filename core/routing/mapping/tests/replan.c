@@ -0,0 +1,294 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "timekeeper.h"
+#include "logger.h"
+
+// checks that replanning gives the same path map as a full trace when
+//    the vessel moves (changing which beacons are inhibited), when a
+//    beacon is added and when node costs change. uses a synthetic map
+//    so no map data is needed
+
+#include "../world_map.c"
+
+#define MAP_SIZE        720
+
+static const world_coordinate_type CENTER = { .lon=237.5, .lat=48.5 };
+
+// beacon positions, in map pixels
+static const uint32_t BEACONS[][2] = {
+      { 100, 120 }, { 200, 640 }, { 360, 330 }, { 420, 380 },
+      { 520, 200 }, { 610, 560 }, { 300, 500 }, { 150, 300 }
+};
+#define NUM_BEACONS  (sizeof BEACONS / sizeof BEACONS[0])
+
+static const uint32_t DEST[2] = { 650, 80 };
+
+// beacon that's added after initial trace
+static const uint32_t NEW_BEACON[2] = { 270, 230 };
+
+
+static world_coordinate_type pix_to_world(
+      /* in     */ const path_map_type *path_map,
+      /* in     */ const uint32_t x,
+      /* in     */ const uint32_t y
+      )
+{
+   // aim for center of node
+   const double dx = ((double) x - 360.0 + 0.5) *
+         path_map->node_width.meters;
+   const double dy = (360.0 - (double) y - 0.5) *
+         path_map->node_height.meters;
+   world_coordinate_type pos = {
+         .lon = CENTER.lon + dx * METER_TO_DEG_LAT / cos(D2R * CENTER.lat),
+         .lat = CENTER.lat + dy * METER_TO_DEG_LAT };
+   return pos;
+}
+
+
+// clears land from around node
+static void open_water(
+      /* in out */       map_level3_type *map3,
+      /* in     */ const uint32_t x,
+      /* in     */ const uint32_t y
+      )
+{
+   for (uint32_t yy=y-3; yy<=y+3; yy++) {
+      for (uint32_t xx=x-3; xx<=x+3; xx++) {
+         map3->grid[xx + yy * MAP_SIZE].min_depth = 50;
+      }
+   }
+}
+
+
+// scattered islands, with water kept open around beacons and destination
+static void create_map(
+      /*    out */       map_level3_type *map3
+      )
+{
+   uint32_t seed = 7;
+   for (uint32_t i=0; i<MAP_SIZE*MAP_SIZE; i++) {
+      seed = seed * 1103515245u + 12345u;
+      map3->grid[i].min_depth = (uint8_t) (20 + ((seed >> 16) % 80));
+   }
+   for (uint32_t n=0; n<1500; n++) {
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cx = (int32_t) ((seed >> 8) % MAP_SIZE);
+      seed = seed * 1103515245u + 12345u;
+      const int32_t cy = (int32_t) ((seed >> 8) % MAP_SIZE);
+      const int32_t r = (int32_t) ((seed >> 4) % 9);
+      for (int32_t y=cy-r; y<=cy+r; y++) {
+         for (int32_t x=cx-r; x<=cx+r; x++) {
+            if ((x >= 0) && (y >= 0) && (x < MAP_SIZE) && (y < MAP_SIZE)
+                  && ((x-cx)*(x-cx) + (y-cy)*(y-cy) <= r*r)) {
+               map3->grid[x + y * MAP_SIZE].min_depth = 0;
+            }
+         }
+      }
+   }
+   for (uint32_t i=0; i<NUM_BEACONS; i++) {
+      open_water(map3, BEACONS[i][0], BEACONS[i][1]);
+   }
+   open_water(map3, NEW_BEACON[0], NEW_BEACON[1]);
+   open_water(map3, DEST[0], DEST[1]);
+}
+
+
+static void init_map(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const map_level3_type *map3
+      )
+{
+   set_map_center(CENTER, path_map);
+   for (uint32_t idx=0; idx<MAP_SIZE*MAP_SIZE; idx++) {
+      set_node_depth(path_map, map3, idx);
+   }
+   mark_land_adjacency(path_map);
+   // destination and beacons
+   path_map->destination = convert_latlon_to_akn(
+         pix_to_world(path_map, DEST[0], DEST[1]));
+   path_map->num_beacons = 0;
+   for (uint32_t i=0; i<NUM_BEACONS; i++) {
+      map_beacon_reference_type *ref = &path_map->beacon_ref[i];
+      ref->coords = convert_latlon_to_akn(
+            pix_to_world(path_map, BEACONS[i][0], BEACONS[i][1]));
+      ref->index = i;
+      ref->pos_in_map.x = (uint16_t) BEACONS[i][0];
+      ref->pos_in_map.y = (uint16_t) BEACONS[i][1];
+      const double dx = (double) BEACONS[i][0] - (double) DEST[0];
+      const double dy = (double) BEACONS[i][1] - (double) DEST[1];
+      // beacon-level weights are lower than what the path map traces
+      //    so that beacons act as seeds
+      ref->path_weight = (float) (0.45 * sqrt(dx*dx + dy*dy));
+      path_map->num_beacons++;
+   }
+}
+
+
+// sets nodes in rect to land, or to deep water
+static void set_rect_depth(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const image_coordinate_type top_left,
+      /* in     */ const image_coordinate_type bottom_right,
+      /* in     */ const int16_t depth
+      )
+{
+   for (uint32_t y=top_left.y; y<bottom_right.y; y++) {
+      for (uint32_t x=top_left.x; x<bottom_right.x; x++) {
+         path_map->feature_nodes[x + y * MAP_SIZE].depth_meters = depth;
+      }
+   }
+}
+
+
+static uint32_t compare_traces(
+      /* in     */ const path_map_type *a,
+      /* in     */ const path_map_type *b
+      )
+{
+   uint32_t errs = 0;
+   for (uint32_t idx=0; idx<MAP_SIZE*MAP_SIZE; idx++) {
+      const path_map_node_type *na = &a->nodes[idx];
+      const path_map_node_type *nb = &b->nodes[idx];
+      if ((fabsf(na->weight - nb->weight) > 1.0e-3f) ||
+            (na->true_course.angle16 != nb->true_course.angle16)) {
+         if (errs < 5) {
+            printf("    node %d,%d: weight %.3f/%.3f  parent %d/%d  "
+                  "course %d/%d\n", idx % MAP_SIZE, idx / MAP_SIZE,
+                  (double) na->weight, (double) nb->weight,
+                  na->parent_id.val, nb->parent_id.val,
+                  na->true_course.angle16, nb->true_course.angle16);
+         }
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+// replans one map and does full trace on other, then compares them
+static uint32_t check_replan(
+      /* in out */       path_map_type *replanned,
+      /* in out */       path_map_type *traced,
+      /* in     */ const uint32_t vessel_x,
+      /* in     */ const uint32_t vessel_y,
+      /* in     */ const char *label
+      )
+{
+   const world_coordinate_type vessel_pos =
+         pix_to_world(traced, vessel_x, vessel_y);
+   uint32_t touched = replan_route(replanned, vessel_pos);
+   trace_route_simple(traced, vessel_pos);
+   uint32_t mismatch = compare_traces(replanned, traced);
+   printf("  %-24s %7d nodes touched (full %d)\n", label, touched,
+         traced->full_trace_stats.nodes_touched);
+   if (mismatch > 0) {
+      printf("    %d nodes differ\n", mismatch);
+      return 1;
+   }
+   return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   image_size_type size = { .x=MAP_SIZE, .y=MAP_SIZE };
+   path_map_type *replanned = create_path_map(size);
+   path_map_type *traced = create_path_map(size);
+   map_level3_type *map3 = malloc(sizeof *map3);
+   create_map(map3);
+   init_map(replanned, map3);
+   init_map(traced, map3);
+   printf("Comparing replanned and full traces\n");
+   // initial trace. vessel far from beacons
+   trace_route_simple(replanned, pix_to_world(traced, 40, 700));
+   // move vessel so beacons 2 and 3 are inhibited, then move on so
+   //    only 3 is
+   errs += check_replan(replanned, traced, 390, 350, "vessel near 2 beacons");
+   errs += check_replan(replanned, traced, 460, 400, "vessel near 1 beacon");
+   errs += check_replan(replanned, traced, 461, 400, "vessel moves 1 node");
+   // add beacon
+   for (uint32_t i=0; i<2; i++) {
+      path_map_type *pm = i == 0 ? replanned : traced;
+      map_beacon_reference_type *ref = &pm->beacon_ref[pm->num_beacons++];
+      ref->coords = convert_latlon_to_akn(pix_to_world(pm, NEW_BEACON[0], NEW_BEACON[1]));
+      ref->index = NUM_BEACONS;
+      ref->pos_in_map.x = (uint16_t) NEW_BEACON[0];
+      ref->pos_in_map.y = (uint16_t) NEW_BEACON[1];
+      ref->path_weight = 100.0f;
+   }
+   errs += check_replan(replanned, traced, 461, 400, "beacon added");
+   // put new island across the route, then take it away
+   const image_coordinate_type top_left = { .x=470, .y=250 };
+   const image_coordinate_type bottom_right = { .x=520, .y=265 };
+   set_rect_depth(replanned, top_left, bottom_right, 0);
+   set_rect_depth(traced, top_left, bottom_right, 0);
+   update_path_costs(replanned, top_left, bottom_right);
+   errs += check_replan(replanned, traced, 461, 400, "island added");
+   set_rect_depth(replanned, top_left, bottom_right, 50);
+   set_rect_depth(traced, top_left, bottom_right, 50);
+   update_path_costs(replanned, top_left, bottom_right);
+   errs += check_replan(replanned, traced, 461, 400, "island removed");
+   // vessel moves away from beacons again
+   errs += check_replan(replanned, traced, 40, 700, "vessel away");
+   ////////////////////////////////////////////////////////////
+   printf("Timing\n");
+   const uint32_t iterations = 20;
+   const world_coordinate_type pos_a = pix_to_world(traced, 40, 700);
+   const world_coordinate_type pos_b = pix_to_world(traced, 460, 400);
+   const world_coordinate_type pos_c = pix_to_world(traced, 461, 400);
+   double full_sec = 0.0;
+   double toggle_sec = 0.0;
+   double step_sec = 0.0;
+   uint32_t toggle_nodes = 0;
+   for (uint32_t i=0; i<iterations; i++) {
+      double t0 = system_now();
+      trace_route_simple(traced, pos_a);
+      full_sec += system_now() - t0;
+      // vessel moves next to beacon, inhibiting it
+      replan_route(replanned, pos_a);
+      t0 = system_now();
+      toggle_nodes += replan_route(replanned, pos_b);
+      toggle_sec += system_now() - t0;
+      // vessel moves w/o changing anything
+      t0 = system_now();
+      replan_route(replanned, pos_c);
+      step_sec += system_now() - t0;
+   }
+   printf("  full trace             %7.3f ms  %7d nodes\n",
+         1000.0 * full_sec / iterations,
+         traced->full_trace_stats.nodes_touched);
+   printf("  replan, beacon change  %7.3f ms  %7d nodes\n",
+         1000.0 * toggle_sec / iterations, toggle_nodes / iterations);
+   printf("  replan, no change      %7.3f ms\n",
+         1000.0 * step_sec / iterations);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
@@ -24,6 +24,7 @@
 #include "pin_types.h"
 #include "lin_alg.h"
 #include "logger.h"
+#include "timekeeper.h"
 #include "routing/mapping.h"
 // from mapping/include/
 #include "world_map.h"
@@ -138,27 +139,130 @@ static void mark_land_adjacency(
 }
 
 
-// loads depth map and sets path_map->center
-void load_world_5sec_map(
-      /* in     */ const world_coordinate_type map_center,
-      /* in out */       path_map_type *path_map
+// adjacency marking for part of map, for when map is shifted and only
+//    nodes near seams need updating. result is the same as from
+//    mark_land_adjacency() for nodes in the region
+
+struct adjacency_offset {
+   int8_t dx;
+   int8_t dy;
+};
+typedef struct adjacency_offset adjacency_offset_type;
+
+// nodes marked by a land node, for each ring of adjacency (see
+//    mark_land_adjacency())
+static const adjacency_offset_type ADJACENT_RING_1[] = {
+   {-1,-1}, { 0,-1}, { 1,-1},
+   {-1, 0}, { 0, 0}, { 1, 0},
+   {-1, 1}, { 0, 1}, { 1, 1}
+};
+
+static const adjacency_offset_type ADJACENT_RING_2[] = {
+   {-1,-2}, { 0,-2}, { 1,-2},
+   {-2,-1}, { 2,-1},
+   {-2, 0}, { 2, 0},
+   {-2, 1}, { 2, 1},
+   {-1, 2}, { 0, 2}, { 1, 2}
+};
+
+static const adjacency_offset_type ADJACENT_RING_3[] = {
+   {-2,-3}, {-1,-3}, { 0,-3}, { 1,-3}, { 2,-3},
+   {-3,-2}, {-2,-2}, { 2,-2}, { 3,-2},
+   {-3,-1}, { 3,-1},
+   {-3, 0}, { 3, 0},
+   {-3, 1}, { 3, 1},
+   {-3, 2}, {-2, 2}, { 2, 2}, { 3, 2},
+   {-2, 3}, {-1, 3}, { 0, 3}, { 1, 3}, { 2, 3}
+};
+
+#define NUM_RING_1   (sizeof ADJACENT_RING_1 / sizeof ADJACENT_RING_1[0])
+#define NUM_RING_2   (sizeof ADJACENT_RING_2 / sizeof ADJACENT_RING_2[0])
+#define NUM_RING_3   (sizeof ADJACENT_RING_3 / sizeof ADJACENT_RING_3[0])
+
+// furthest a land node's marks reach
+#define ADJACENCY_RADIUS      3
+
+// recomputes land_cnt and near_cnt for nodes in [x0,x1) x [y0,y1)
+static void mark_land_adjacency_region(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const int32_t x0,
+      /* in     */ const int32_t y0,
+      /* in     */ const int32_t x1,
+      /* in     */ const int32_t y1
       )
 {
-   // make sure map is properly created
-   world_coordinate_type center = map_center;
-   if (center.lon < 0) {
-      center.lon += 360.0;
+   const int32_t w = (int32_t) path_map->size.x;
+   const int32_t h = (int32_t) path_map->size.y;
+   if ((x0 >= x1) || (y0 >= y1)) {
+      return;
    }
-akn_position_type apos = convert_latlon_to_akn(center);
-printf("Loading 5-sec map at %.5f,%.5f  (%.5f,%.5f)\n", center.x_deg, center.y_deg, apos.akn_x, apos.akn_y);
-   check_world_coordinate(center, __func__);
-   assert(path_map->size.x == 720);
-   assert(path_map->size.y == 720);
-   // any old beacons are stale on map load. at best it's confusing to
-   //    let them stay around
-   path_map->num_beacons = 0;
-   /////////////////////////////////////////////
-   // (re)set variables
+   assert((x0 >= 0) && (y0 >= 0) && (x1 <= w) && (y1 <= h));
+   map_feature_node_type *nodes = path_map->feature_nodes;
+   for (int32_t y=y0; y<y1; y++) {
+      for (int32_t x=x0; x<x1; x++) {
+         nodes[x + y * w].cnt_all = 0;
+      }
+   }
+   // land nodes that can mark the region
+   const int32_t lx0 = (x0 > ADJACENCY_RADIUS) ? x0 - ADJACENCY_RADIUS : 0;
+   const int32_t ly0 = (y0 > ADJACENCY_RADIUS) ? y0 - ADJACENCY_RADIUS : 0;
+   const int32_t lx1 = (x1 + ADJACENCY_RADIUS < w) ?
+         x1 + ADJACENCY_RADIUS : w;
+   const int32_t ly1 = (y1 + ADJACENCY_RADIUS < h) ?
+         y1 + ADJACENCY_RADIUS : h;
+   for (int32_t y=ly0; y<ly1; y++) {
+      for (int32_t x=lx0; x<lx1; x++) {
+         if (nodes[x + y * w].depth_meters > MIN_TRAVERSABLE_DEPTH_METERS) {
+            continue;
+         }
+         // land node only marks neighbors for ring R if it's at least R
+         //    nodes from map edge
+         int32_t edge_dist = (x < w-1-x) ? x : w-1-x;
+         const int32_t edge_dist_y = (y < h-1-y) ? y : h-1-y;
+         if (edge_dist_y < edge_dist) {
+            edge_dist = edge_dist_y;
+         }
+         for (uint32_t ring=1; ring<=ADJACENCY_RADIUS; ring++) {
+            if (edge_dist < (int32_t) ring) {
+               break;
+            }
+            const adjacency_offset_type *offsets;
+            uint32_t num_offsets;
+            if (ring == 1) {
+               offsets = ADJACENT_RING_1;
+               num_offsets = NUM_RING_1;
+            } else if (ring == 2) {
+               offsets = ADJACENT_RING_2;
+               num_offsets = NUM_RING_2;
+            } else {
+               offsets = ADJACENT_RING_3;
+               num_offsets = NUM_RING_3;
+            }
+            for (uint32_t i=0; i<num_offsets; i++) {
+               const int32_t tx = x + offsets[i].dx;
+               const int32_t ty = y + offsets[i].dy;
+               if ((tx < x0) || (tx >= x1) || (ty < y0) || (ty >= y1)) {
+                  continue;
+               }
+               map_feature_node_type *node = &nodes[tx + ty * w];
+               if (ring == 1) {
+                  node->land_cnt++;
+               } else {
+                  node->near_cnt++;
+               }
+            }
+         }
+      }
+   }
+}
+
+
+// sets map geometry for map centered at 'center'
+static void set_map_center(
+      /* in     */ const world_coordinate_type center,
+      /* in out */       path_map_type *path_map
+      )
+{
    path_map->center.x_deg = center.x_deg;
    path_map->center.y_deg = center.y_deg;
 //   path_map->node_height.degrees = 1.0f / 720.0f;
@@ -167,13 +271,21 @@ printf("Loading 5-sec map at %.5f,%.5f  (%.5f,%.5f)\n", center.x_deg, center.y_d
    path_map->map_height.meters = (float) (60.0 * NM_TO_METERS);
    path_map->node_width.meters = path_map->map_width.meters / 720.0;
    path_map->node_height.meters = path_map->map_height.meters / 720.0;
+   // nodes no longer hold a trace of the map content, so replanning
+   //    can't build on them
+   path_map->trace_valid = 0;
+   path_map->feature_generation++;
    // nodes are 'square' in the sense of degrees so no latitude correction
    //    is necessary. this is OK up to Anchorage latitude, but perhaps
    //    starts to fail above Prudoe
-   /////////////////////////////////////////////
-   // fetch map from database
-   map_level3_type map3;
-   build_60x60_map(world_map_folder_, center, &map3);
+}
+
+
+static void read_map_declination(
+      /* in     */ const world_coordinate_type center,
+      /* in out */       path_map_type *path_map
+      )
+{
    double decl, incl;
    char declination_fname[STR_LEN];
    snprintf(declination_fname, STR_LEN, "%s%s",
@@ -187,24 +299,241 @@ printf("Loading 5-sec map at %.5f,%.5f  (%.5f,%.5f)\n", center.x_deg, center.y_d
    }
    path_map->declination.degrees = decl;
    path_map->inclination.degrees = incl;
+   path_map->declination_center = center;
    log_info(log_, "Declination of %.1f,%.1f read at %.2f degrees",
          center.lon, center.lat, path_map->declination.degrees);
-//   uint32_t n_squares = 720 * 720;
-   uint32_t idx = 0;
-   for (uint32_t y=0; y<720; y++) {
-      for (uint32_t x=0; x<720; x++) {
-         uint8_t code = map3.grid[idx].min_depth;
-         map_feature_node_type *square = &path_map->feature_nodes[idx];
-         square->depth_meters = (int16_t) decode_submap_depth(code);
+}
+
+
+// sets depth of map node from level-3 map
+static void set_node_depth(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const map_level3_type *map3,
+      /* in     */ const uint32_t idx
+      )
+{
+   uint8_t code = map3->grid[idx].min_depth;
+   map_feature_node_type *square = &path_map->feature_nodes[idx];
+   square->depth_meters = (int16_t) decode_submap_depth(code);
 //if (square->depth_meters > 10000) {
 //   printf("%d,%d has excessive depth. code %d, depth %d\n", x, y, code, square->depth_meters);
 //}
-         square->cnt_all = 0;
-         idx++;
-      }
+   square->cnt_all = 0;
+}
+
+
+// loads depth map and sets path_map->center
+void load_world_5sec_map(
+      /* in     */ const world_coordinate_type map_center,
+      /* in out */       path_map_type *path_map
+      )
+{
+   const double t0 = system_now();
+   // make sure map is properly created
+   world_coordinate_type center = map_center;
+   if (center.lon < 0) {
+      center.lon += 360.0;
+   }
+akn_position_type apos = convert_latlon_to_akn(center);
+printf("Loading 5-sec map at %.5f,%.5f  (%.5f,%.5f)\n", center.x_deg, center.y_deg, apos.akn_x, apos.akn_y);
+   check_world_coordinate(center, __func__);
+   assert(path_map->size.x == 720);
+   assert(path_map->size.y == 720);
+   // any old beacons are stale on map load. at best it's confusing to
+   //    let them stay around
+   path_map->num_beacons = 0;
+   /////////////////////////////////////////////
+   // (re)set variables
+   set_map_center(center, path_map);
+   /////////////////////////////////////////////
+   // fetch map from database
+   map_level3_type map3;
+   build_60x60_map(world_map_folder_, center, &map3);
+   read_map_declination(center, path_map);
+//   uint32_t n_squares = 720 * 720;
+   for (uint32_t idx=0; idx<720*720; idx++) {
+      set_node_depth(path_map, &map3, idx);
    }
    //
    mark_land_adjacency(path_map);
+   path_map->map_loaded = 1;
+   path_map->recenter_drift_nodes = 0.0;
+   log_info(log_, "Loaded map at %.5f,%.5f in %.1f ms", center.lon,
+         center.lat, 1000.0 * (system_now() - t0));
+}
+
+
+// returns part of map that's exposed when map content is shifted by
+//    dx,dy nodes
+static map_level3_region_type get_exposed_region(
+      /* in     */ const image_size_type size,
+      /* in     */ const int32_t dx,
+      /* in     */ const int32_t dy
+      )
+{
+   map_level3_region_type region = { 0, 0, 0, 0 };
+   if (dy > 0) {
+      region.row_end = (uint16_t) dy;
+   } else if (dy < 0) {
+      region.row_start = (uint16_t) (size.y + dy);
+      region.row_end = (uint16_t) size.y;
+   }
+   if (dx > 0) {
+      region.col_end = (uint16_t) dx;
+   } else if (dx < 0) {
+      region.col_start = (uint16_t) (size.x + dx);
+      region.col_end = (uint16_t) size.x;
+   }
+   return region;
+}
+
+
+// shifts map content by dx,dy nodes (content at x,y moves to x+dx,y+dy),
+//    sets depth of newly exposed nodes from map3 and updates adjacency
+//    counts near the seams. map3 only needs to be valid in the
+//    exposed region
+static void shift_map_nodes(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const int32_t dx,
+      /* in     */ const int32_t dy,
+      /* in     */ const map_level3_type *map3
+      )
+{
+   const int32_t w = (int32_t) path_map->size.x;
+   const int32_t h = (int32_t) path_map->size.y;
+   assert((abs(dx) < w) && (abs(dy) < h));
+   map_feature_node_type *nodes = path_map->feature_nodes;
+   // copy rows in an order that doesn't overwrite rows not yet copied
+   const size_t row_bytes = (size_t) (w - abs(dx)) * sizeof *nodes;
+   for (int32_t i=0; i<h; i++) {
+      const int32_t y = (dy > 0) ? h - 1 - i : i;
+      const int32_t src_y = y - dy;
+      if ((src_y < 0) || (src_y >= h)) {
+         continue;
+      }
+      map_feature_node_type *dest_row = &nodes[y * w];
+      const map_feature_node_type *src_row = &nodes[src_y * w];
+      if (dx >= 0) {
+         memmove(&dest_row[dx], src_row, row_bytes);
+      } else {
+         memmove(dest_row, &src_row[-dx], row_bytes);
+      }
+   }
+   // fill exposed strips
+   const map_level3_region_type region =
+         get_exposed_region(path_map->size, dx, dy);
+   for (int32_t y=0; y<h; y++) {
+      if ((y >= region.row_start) && (y < region.row_end)) {
+         for (int32_t x=0; x<w; x++) {
+            set_node_depth(path_map, map3, (uint32_t) (x + y * w));
+         }
+      } else {
+         for (int32_t x=region.col_start; x<region.col_end; x++) {
+            set_node_depth(path_map, map3, (uint32_t) (x + y * w));
+         }
+      }
+   }
+   // adjacency counts change for nodes close enough to the exposed
+   //    strips to be marked by land there, and for nodes close enough
+   //    to the seam that land on the other side of it used to be too
+   //    close to the old map edge to mark anything. likewise for nodes
+   //    near the map edge that content was shifted toward
+   const int32_t margin = 2 * ADJACENCY_RADIUS;
+   if (dy > 0) {
+      const int32_t end = (dy + margin < h) ? dy + margin : h;
+      mark_land_adjacency_region(path_map, 0, 0, w, end);
+      mark_land_adjacency_region(path_map, 0, h - margin, w, h);
+   } else if (dy < 0) {
+      const int32_t start = (h + dy > margin) ? h + dy - margin : 0;
+      mark_land_adjacency_region(path_map, 0, start, w, h);
+      mark_land_adjacency_region(path_map, 0, 0, w, margin);
+   }
+   if (dx > 0) {
+      const int32_t end = (dx + margin < w) ? dx + margin : w;
+      mark_land_adjacency_region(path_map, 0, 0, end, h);
+      mark_land_adjacency_region(path_map, w - margin, 0, w, h);
+   } else if (dx < 0) {
+      const int32_t start = (w + dx > margin) ? w + dx - margin : 0;
+      mark_land_adjacency_region(path_map, start, 0, w, h);
+      mark_land_adjacency_region(path_map, 0, 0, margin, h);
+   }
+}
+
+
+void recenter_world_5sec_map(
+      /* in     */ const world_coordinate_type map_center,
+      /* in out */       path_map_type *path_map
+      )
+{
+   const double t0 = system_now();
+   world_coordinate_type center = map_center;
+   if (center.lon < 0) {
+      center.lon += 360.0;
+   }
+   check_world_coordinate(center, __func__);
+   if (path_map->map_loaded == 0) {
+      goto full_load;
+   }
+   /////////////////////////////////////////////
+   // get shift, in nodes. rows are 1/720 degree, so snap latitude to
+   //    an integral number of rows. columns are 1/720 degree scaled by
+   //    cos(latitude). snap longitude using scale at map center
+   const world_coordinate_type prev = path_map->center;
+   const int32_t dy = (int32_t) round((center.lat - prev.lat) * 720.0);
+   center.lat = prev.lat + (double) dy / 720.0;
+   const double scale = cos(D2R * center.lat);
+   double dlon = center.lon - prev.lon;
+   if (dlon > 180.0) {
+      dlon -= 360.0;
+   } else if (dlon <= -180.0) {
+      dlon += 360.0;
+   }
+   const int32_t dx = -(int32_t) round(dlon * 720.0 * scale);
+   center.lon = prev.lon - (double) dx / (720.0 * scale);
+   if (center.lon < 0.0) {
+      center.lon += 360.0;
+   } else if (center.lon >= 360.0) {
+      center.lon -= 360.0;
+   }
+   // scale at map top/bottom edge differs from scale at center by about
+   //    tan(lat) * 0.5 deg (in radians), so that's the fraction of the
+   //    horizontal shift that's misplaced there
+   const double drift = path_map->recenter_drift_nodes + fabs((double) dx) *
+         tan(D2R * (fabs(center.lat) + 0.5)) * 0.5 * D2R;
+   if ((abs(dx) > MAP_RECENTER_MAX_SHIFT_NODES) ||
+         (abs(dy) > MAP_RECENTER_MAX_SHIFT_NODES) ||
+         (drift >= MAP_RECENTER_MAX_DRIFT_NODES)) {
+      goto full_load;
+   }
+   /////////////////////////////////////////////
+   // fetch exposed part of map from database
+   map_level3_type map3;
+   const map_level3_region_type region =
+         get_exposed_region(path_map->size, dx, dy);
+   if (update_60x60_map_region(world_map_folder_, center, &region,
+         &map3) == NULL) {
+      goto full_load;
+   }
+   shift_map_nodes(path_map, dx, dy, &map3);
+   // any old beacons are stale on map load. at best it's confusing to
+   //    let them stay around
+   path_map->num_beacons = 0;
+   set_map_center(center, path_map);
+   path_map->recenter_drift_nodes = drift;
+   const world_coordinate_type decl_pos = path_map->declination_center;
+   double decl_dlon = fabs(center.lon - decl_pos.lon);
+   if (decl_dlon > 180.0) {
+      decl_dlon = 360.0 - decl_dlon;
+   }
+   if ((fabs(center.lat - decl_pos.lat) > DECLINATION_RELOAD_DEG) ||
+         (decl_dlon * scale > DECLINATION_RELOAD_DEG)) {
+      read_map_declination(center, path_map);
+   }
+   log_info(log_, "Recentered map to %.5f,%.5f by %d,%d nodes in %.1f ms",
+         center.lon, center.lat, dx, dy, 1000.0 * (system_now() - t0));
+   return;
+full_load:
+   load_world_5sec_map(map_center, path_map);
 }
 
 
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
 #include <assert.h>
 #include <errno.h>
 #include <unistd.h>
@@ -25,6 +26,7 @@
 #include <sys/stat.h>
 #include "image.h"
 #include "dev_info.h"
+#include "pan_log.h"
 
 // examines content of log directory. places targets and associator
 //    output on panorama view
@@ -56,6 +58,10 @@ static const char * log_dir_ = NULL;
 
 static image_type *pan_in_ = NULL;
 
+// indexed panorama log, if present. otherwise individual pnm files
+//    are read
+static pan_log_reader_type *pan_log_ = NULL;
+
 enum {
    STREAM_TRACKER_0,
    STREAM_TRACKER_1,
@@ -450,6 +456,13 @@ static int32_t open_log_files(void)
    if (open_target_log(buf, &ass_stream_, "associator", 2) != 0) {
       goto end;
    }
+   // panorama log is optional
+   sprintf(buf, "%s/%s%s", log_dir_, PAN_DIR, PAN_LOG_FILE_NAME);
+   pan_log_ = pan_log_open_reader(buf);
+   if (pan_log_ != NULL) {
+      printf("Using panorama log %s (%d frames)\n", buf,
+            pan_log_->num_frames);
+   }
    rc = 0;
 end:
    return rc;
@@ -467,6 +480,8 @@ static void close_log_files(void)
    if (ass_stream_.fp != NULL) {
       fclose(ass_stream_.fp);
    }
+   pan_log_close_reader(pan_log_);
+   pan_log_ = NULL;
 }
 
 
@@ -553,7 +568,27 @@ static void load_panorama(
 //printf("Looking for %s\n", fname);
    // see if pan file exists
    struct stat st = { 0 };
-   if (stat(fname, &st) == 0) {
+   int32_t log_idx = -1;
+   if (pan_log_ != NULL) {
+      // frame must match to the precision used in pnm file names
+      log_idx = pan_log_find_nearest(pan_log_, t);
+      if ((log_idx >= 0) && (fabs(pan_log_frame_time(pan_log_,
+            (uint32_t) log_idx) - t) >= 0.0005)) {
+         log_idx = -1;
+      }
+   }
+   if (log_idx >= 0) {
+printf("  Loading %.3f from panorama log\n", t);
+      if (pan_in_ == NULL) {
+         pan_in_ = raw_create_image(pan_log_->size);
+      }
+      if (pan_log_read_image(pan_log_, (uint32_t) log_idx, pan_in_) != 0) {
+         fprintf(stderr, "Error reading frame %d from panorama log\n",
+               log_idx);
+      }
+      ppd_ = (double) pan_in_->size.width / 360.0;
+      assert(pan_in_->size.width == IMAGE_WIDTH);
+   } else if (stat(fname, &st) == 0) {
 printf("  Loading %s\n", fname);
       // it does. load it
       // free old pan if it exists
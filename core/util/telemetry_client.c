@@ -0,0 +1,319 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "external/telemetry.h"
+
+// connects to bob's telemetry stream and prints decoded messages
+// this is a reference for writing display clients -- it does nothing
+//    beyond printing what it receives
+
+#define DEFAULT_HOST    "127.0.0.1"
+
+static char host_[256] = { DEFAULT_HOST };
+static int32_t port_ = -1;
+
+// rates to request. negative means use server default
+static float rate_hz_[NUM_TELEMETRY_TYPES] = { -1.0f, -1.0f, -1.0f, -1.0f };
+static int32_t subscribe_ = 0;
+
+// payload buffer, large enough for module list
+#define MAX_PAYLOAD_BYTES     (1024 * 1024)
+static uint8_t payload_[MAX_PAYLOAD_BYTES];
+
+
+// reads exactly len bytes. returns 0 on success, -1 on error or if
+//    server closed connection
+static int32_t read_all(
+      /* in     */ const int fd,
+      /*    out */       void *buf,
+      /* in     */ const size_t len
+      )
+{
+   size_t got = 0;
+   while (got < len) {
+      ssize_t n = recv(fd, &((uint8_t*) buf)[got], len - got, 0);
+      if (n == 0) {
+         fprintf(stderr, "Server closed connection\n");
+         return -1;
+      } else if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         fprintf(stderr, "Error reading from server: %s\n", strerror(errno));
+         return -1;
+      }
+      got += (size_t) n;
+   }
+   return 0;
+}
+
+static int connect_to_telemetry(void)
+{
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   if (fd < 0) {
+      fprintf(stderr, "Unable to create socket: %s\n", strerror(errno));
+      return -1;
+   }
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof addr);
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((uint16_t) port_);
+   if (inet_pton(AF_INET, host_, &addr.sin_addr) != 1) {
+      fprintf(stderr, "Bad host address '%s'\n", host_);
+      goto err;
+   }
+   if (connect(fd, (struct sockaddr*) &addr, sizeof addr) != 0) {
+      fprintf(stderr, "Unable to connect to %s:%d: %s\n", host_, port_,
+            strerror(errno));
+      goto err;
+   }
+   return fd;
+err:
+   close(fd);
+   return -1;
+}
+
+static int32_t send_subscription(
+      /* in     */ const int fd
+      )
+{
+   telemetry_subscribe_type sub = {
+      .magic = TELEMETRY_MAGIC,
+      .version = TELEMETRY_VERSION,
+      .unused = 0
+   };
+   memcpy(sub.rate_hz, rate_hz_, sizeof sub.rate_hz);
+   if (send(fd, &sub, sizeof sub, 0) != (ssize_t) sizeof sub) {
+      fprintf(stderr, "Failed to send subscription: %s\n", strerror(errno));
+      return -1;
+   }
+   return 0;
+}
+
+static void print_attitude(
+      /* in     */ const telemetry_header_type *header
+      )
+{
+   telemetry_attitude_type att;
+   memcpy(&att, payload_, sizeof att);
+   printf("%10.3f ATT  heading %6.1f  pitch %5.1f  roll %5.1f  "
+         "turn %6.2f dps\n", header->t, (double) att.true_heading_deg,
+         (double) att.pitch_deg, (double) att.roll_deg,
+         (double) att.turn_rate_dps);
+}
+
+static void print_position(
+      /* in     */ const telemetry_header_type *header
+      )
+{
+   telemetry_position_type pos;
+   memcpy(&pos, payload_, sizeof pos);
+   printf("%10.3f POS  %.6f,%.6f  speed %5.2f m/s  track %6.1f  "
+         "(avail 0x%02x)\n", header->t, pos.lon_deg, pos.lat_deg,
+         (double) pos.speed_mps, (double) pos.track_deg, pos.available);
+}
+
+static void print_route(
+      /* in     */ const telemetry_header_type *header
+      )
+{
+   telemetry_route_type route;
+   memcpy(&route, payload_, sizeof route);
+   printf("%10.3f RTE  suggest %6.1f  course %6.1f  measured %6.1f  "
+         "path %6.1f  speed %5.2f  dest %.4f,%.4f  flags 0x%08x 0x%08x\n",
+         header->t, (double) route.sug_heading_deg,
+         (double) route.autopilot_course_deg,
+         (double) route.measured_heading_deg,
+         (double) route.path_heading_deg,
+         (double) route.present_speed_mps,
+         route.dest_lon_deg, route.dest_lat_deg,
+         route.flags, route.flags_persistent);
+}
+
+static void print_modules(
+      /* in     */ const telemetry_header_type *header
+      )
+{
+   telemetry_modules_type hdr;
+   memcpy(&hdr, payload_, sizeof hdr);
+   const uint32_t max_modules = (uint32_t) ((header->payload_bytes -
+         sizeof hdr) / sizeof(telemetry_module_type));
+   if (hdr.num_modules > max_modules) {
+      hdr.num_modules = max_modules;
+   }
+   printf("%10.3f MODULES (%d)\n", header->t, hdr.num_modules);
+   for (uint32_t i=0; i<hdr.num_modules; i++) {
+      telemetry_module_type mod;
+      memcpy(&mod, &payload_[sizeof hdr + i * sizeof mod], sizeof mod);
+      mod.name[TELEMETRY_NAME_LEN-1] = 0;
+      mod.class_name[TELEMETRY_NAME_LEN-1] = 0;
+      printf("      %-23s %-23s %10lu  backlog %4d/%-4d  age p50 %7.2f  "
+            "p99 %7.2f ms\n", mod.name, mod.class_name,
+            (unsigned long) mod.elements_produced, mod.max_backlog,
+            mod.queue_length, (double) mod.publish_age_p50_ms,
+            (double) mod.publish_age_p99_ms);
+   }
+}
+
+static int32_t stream(
+      /* in     */ const int fd
+      )
+{
+   uint32_t expected_seq = 0;
+   while (1) {
+      telemetry_header_type header;
+      if (read_all(fd, &header, sizeof header) != 0) {
+         return -1;
+      }
+      if ((header.magic != TELEMETRY_MAGIC) ||
+            (header.version != TELEMETRY_VERSION)) {
+         fprintf(stderr, "Bad message header (magic 0x%04x, version %d)\n",
+               header.magic, header.version);
+         return -1;
+      }
+      if (header.payload_bytes > MAX_PAYLOAD_BYTES) {
+         fprintf(stderr, "Message payload too large (%d bytes)\n",
+               header.payload_bytes);
+         return -1;
+      }
+      if (read_all(fd, payload_, header.payload_bytes) != 0) {
+         return -1;
+      }
+      if (header.seq != expected_seq) {
+         printf("  (sequence jumped from %d to %d)\n", expected_seq,
+               header.seq);
+      }
+      expected_seq = header.seq + 1;
+      if (header.dropped > 0) {
+         printf("  (%d messages of type %d dropped)\n", header.dropped,
+               header.type);
+      }
+      switch (header.type) {
+         case TELEMETRY_ATTITUDE:
+            print_attitude(&header);
+            break;
+         case TELEMETRY_POSITION:
+            print_position(&header);
+            break;
+         case TELEMETRY_ROUTE:
+            print_route(&header);
+            break;
+         case TELEMETRY_MODULES:
+            print_modules(&header);
+            break;
+         default:
+            printf("%10.3f unrecognized type %d (%d bytes)\n", header.t,
+                  header.type, header.payload_bytes);
+            break;
+      };
+      fflush(stdout);
+   }
+   return 0;
+}
+
+static void parse_command_line(int argc, char *argv[])
+{
+   int opt;
+   while ((opt = getopt(argc, argv, "a:p:r:m:s:h")) != -1) {
+      switch (opt) {
+         case 'a':
+            strncpy(host_, optarg, sizeof host_ - 1);
+            break;
+         case 'p':
+            port_ = atoi(optarg);
+            break;
+         case 'r':
+            rate_hz_[TELEMETRY_ATTITUDE] = (float) atof(optarg);
+            subscribe_ = 1;
+            break;
+         case 's':
+            rate_hz_[TELEMETRY_POSITION] = (float) atof(optarg);
+            rate_hz_[TELEMETRY_ROUTE] = (float) atof(optarg);
+            subscribe_ = 1;
+            break;
+         case 'm':
+            rate_hz_[TELEMETRY_MODULES] = (float) atof(optarg);
+            subscribe_ = 1;
+            break;
+         case 'h':
+            goto usage;
+         default:
+            goto usage;
+      };
+   };
+   if ((optind < argc) || (port_ <= 0)) {
+      goto usage;
+   }
+   return;
+   /////////////////////////////////////////////
+usage:
+   printf("Prints telemetry streamed by bob\n");
+   printf("\n");
+   printf("Usage: %s -p <port> [-a <address>] [-r <hz>] [-s <hz>] "
+         "[-m <hz>] [-h]\n", argv[0]);
+   printf("\n");
+   printf("where:\n");
+   printf("   p   telemetry port (see config endpoints/telemetry)\n");
+   printf("   a   IP address of bob (default: %s)\n", DEFAULT_HOST);
+   printf("   r   attitude rate\n");
+   printf("   s   position and route rate\n");
+   printf("   m   module status rate\n");
+   printf("   h   prints this output (ie, help)\n");
+   printf("\n");
+   printf("Rates are in Hz. 0 turns a type off. If no rate is given then "
+         "server defaults\nare used for all types\n");
+   exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+   int rc = -1;
+   parse_command_line(argc, argv);
+   int fd = connect_to_telemetry();
+   if (fd < 0) {
+      goto end;
+   }
+   if (subscribe_) {
+      // types w/o a rate on the command line keep their default
+      const float defaults[NUM_TELEMETRY_TYPES] = { 10.0f, 1.0f, 1.0f, 0.2f };
+      for (uint32_t i=0; i<NUM_TELEMETRY_TYPES; i++) {
+         if (rate_hz_[i] < 0.0f) {
+            rate_hz_[i] = defaults[i];
+         }
+      }
+      if (send_subscription(fd) != 0) {
+         goto end;
+      }
+   }
+   rc = stream(fd);
+end:
+   if (fd >= 0) {
+      close(fd);
+   }
+   return rc;
+}
+
@@ -0,0 +1,34 @@
+#!/usr/bin/env python3
+""" converts binary IMU log, as written by imu_receiver, to the text
+format used by older logs (time, gyr (3), acc (3), mag (3), temp).
+record layout is imu_log_record in sensor_packet.h
+"""
+import struct
+import sys
+
+MAGIC = b"IMULOG1\n"
+RECORD = struct.Struct("=d10f")
+
+def usage():
+   print("Usage: {} <binary imu log> <text output>".format(sys.argv[0]))
+   sys.exit(1)
+
+if len(sys.argv) != 3:
+   usage()
+
+with open(sys.argv[1], 'rb') as f:
+   data = f.read()
+if not data.startswith(MAGIC):
+   print("'{}' is not a binary IMU log".format(sys.argv[1]))
+   sys.exit(1)
+
+count = 0
+with open(sys.argv[2], 'w') as out:
+   pos = len(MAGIC)
+   while pos + RECORD.size <= len(data):
+      v = RECORD.unpack_from(data, pos)
+      out.write("%.3f  %7.4f %7.4f %7.4f  %7.4f %7.4f %7.4f  "
+            "%7.4f %7.4f %7.4f  %5.1f\n" % v)
+      pos += RECORD.size
+      count += 1
+print("Converted {} records".format(count))
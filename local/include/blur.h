@@ -44,5 +44,18 @@ void blur_image_r1(
       /* in     */ const image_size_type size
       );
 
+// radius 1 gaussian blur where rows with nonzero skip_row[y] don't
+//    contribute to the vertical pass. weights of the remaining rows are
+//    renormalized. a skipped row with no usable neighbor keeps its
+//    horizontal blur. with no rows skipped output is same as
+//    blur_image_r1()
+void blur_image_r1_skip_rows(
+      /* in     */ const uint8_t * restrict src,
+      /*    out */       unsigned int * restrict tmp,
+      /*    out */       uint8_t * restrict dest,
+      /* in     */ const image_size_type size,
+      /* in     */ const uint8_t * restrict skip_row
+      );
+
 #endif   // BLUR_H
 
@@ -0,0 +1,84 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(LATENCY_H)
+#define  LATENCY_H
+#include <stdio.h>
+#include <stdint.h>
+#include "logger.h"
+
+// histogram of latencies (or data age) for computing percentiles w/o
+//    storing individual samples. bins are log-linear: each power of 2
+//    of microseconds is split into LATENCY_SUB_BINS bins, so bin width
+//    is w/in ~6% of value. storage is fixed so samples can be added
+//    from time-critical threads
+
+#define LATENCY_SUB_BIN_BITS     4
+#define LATENCY_SUB_BINS         (1u << LATENCY_SUB_BIN_BITS)
+// covers up to 2^32 usec (~70 minutes). larger values go in top bin
+#define LATENCY_NUM_BINS         ((32u - LATENCY_SUB_BIN_BITS + 1u) * \
+      LATENCY_SUB_BINS)
+
+struct latency_stats {
+   uint32_t bins[LATENCY_NUM_BINS];
+   uint32_t count;
+   // negative values indicate clock problems (eg, unsynchronized remote
+   //    node). they're counted as zero latency and tallied here
+   uint32_t negative;
+   double sum_sec;
+   double max_sec;
+};
+typedef struct latency_stats latency_stats_type;
+
+void latency_reset(
+      /*    out */       latency_stats_type *stats
+      );
+
+void latency_add(
+      /* in out */       latency_stats_type *stats,
+      /* in     */ const double dt_sec
+      );
+
+// merges src into dest
+void latency_merge(
+      /* in out */       latency_stats_type *dest,
+      /* in     */ const latency_stats_type *src
+      );
+
+// returns latency (sec) that pct percent of samples are at or below.
+//    value is midpoint of bin that percentile falls in. returns 0 if
+//    there are no samples
+double latency_percentile(
+      /* in     */ const latency_stats_type *stats,
+      /* in     */ const double pct
+      );
+
+// writes one-line summary (count, mean, p50, p90, p99, max, in ms)
+void latency_summary(
+      /* in     */ const latency_stats_type *stats,
+      /* in     */ const char *label,
+      /*    out */       char *buf,
+      /* in     */ const size_t buf_len
+      );
+
+// writes summary line to log
+void log_latency_summary(
+      /* in out */       log_info_type *log,
+      /* in     */ const latency_stats_type *stats,
+      /* in     */ const char *label
+      );
+
+#endif  // LATENCY_H
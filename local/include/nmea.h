@@ -0,0 +1,139 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(NMEA_H)
+#define  NMEA_H
+#include <stdint.h>
+
+// single-pass NMEA 0183 parsing w/o copying or allocation. the checksum
+//    is accumulated while the sentence is tokenized. sentences of types
+//    that aren't used are identified from their address field and
+//    skipped w/o being parsed. errors are counted, not printed
+//
+// a sentence looks like
+//    $GPRMC,161229.487,A,3723.2475,N,12158.3416,W,0.13,309.62,120598,,*10
+// where the checksum (hex, after '*') is the XOR of all chars between
+//    '$' and '*'
+
+// NMEA sentences are at most 82 chars, including '$' and CR/LF. allow
+//    slack for receivers that exceed that
+#define NMEA_MAX_SENTENCE     128
+#define NMEA_MAX_FIELDS       32
+
+// sentence types that are parsed
+#define NMEA_GGA        0
+#define NMEA_RMC        1
+#define NMEA_NUM_TYPES  2
+// returned for sentences of all other types
+#define NMEA_IGNORED    NMEA_NUM_TYPES
+
+struct nmea_stats {
+   uint64_t bytes;
+   // valid sentences of a parsed type
+   uint64_t sentences;
+   // sentences of types that aren't parsed
+   uint64_t ignored;
+   uint64_t bad_checksum;
+   // invalid chars, overlong or truncated sentences, missing checksum
+   uint64_t bad_format;
+   // fields w/ malformed content. tallied by caller from return
+   //    values of nmea_read_*()
+   uint64_t bad_fields;
+};
+typedef struct nmea_stats nmea_stats_type;
+
+// fields of a tokenized sentence. field 0 is the address (eg, GPGGA).
+//    fields point into the buffer that the sentence was tokenized from,
+//    which must stay valid while fields are used
+struct nmea_fields {
+   int32_t type;
+   uint32_t num_fields;
+   const char *field[NMEA_MAX_FIELDS];
+   uint8_t len[NMEA_MAX_FIELDS];
+};
+typedef struct nmea_fields nmea_fields_type;
+
+// tokenizes sentence of up to len chars, validating checksum in the
+//    same pass. sentence ends at the checksum or at CR, LF or NUL.
+//    a sentence that doesn't start with '$' is accepted w/o a checksum,
+//    as older gps processes forwarded sentences that way after checking
+//    the checksum themselves
+// returns sentence type (NMEA_GGA, NMEA_RMC), NMEA_IGNORED if type
+//    isn't parsed (fields aren't set), or -1 if sentence is invalid.
+//    stats are updated
+int32_t nmea_tokenize(
+      /* in     */ const char *sentence,
+      /* in     */ const uint32_t len,
+      /*    out */       nmea_fields_type *fields,
+      /* in out */       nmea_stats_type *stats
+      );
+
+// field readers return 0 on success, 1 if field is empty or absent and
+//    -1 if field content is malformed
+
+// reads decimal value, eg, "-12.345"
+int32_t nmea_read_decimal(
+      /* in     */ const nmea_fields_type *fields,
+      /* in     */ const uint32_t idx,
+      /*    out */       double *val
+      );
+
+// reads unsigned int, eg, date "120598"
+int32_t nmea_read_uint(
+      /* in     */ const nmea_fields_type *fields,
+      /* in     */ const uint32_t idx,
+      /*    out */       uint32_t *val
+      );
+
+// reads latitude (ddmm.mmmm) or longitude (dddmm.mmmm) at idx and
+//    hemisphere (N/S/E/W) at idx+1, returning signed degrees
+int32_t nmea_read_latlon(
+      /* in     */ const nmea_fields_type *fields,
+      /* in     */ const uint32_t idx,
+      /*    out */       double *deg
+      );
+
+////////////////////////////////////////////////////////////////////////
+// scanner for extracting sentences from serial stream
+
+struct nmea_scanner {
+   // sentence being assembled, from '$' to checksum
+   char sentence[NMEA_MAX_SENTENCE + 1];
+   uint32_t len;
+   uint32_t state;
+   uint8_t checksum;
+   uint8_t reported_checksum;
+   nmea_stats_type stats;
+};
+typedef struct nmea_scanner nmea_scanner_type;
+
+void nmea_scanner_init(
+      /*    out */       nmea_scanner_type *scanner
+      );
+
+// consumes bytes from data until a sentence of a parsed type w/ valid
+//    checksum is complete or data is exhausted. returns number of
+//    bytes consumed. when a sentence is complete, *sentence points to
+//    it (NUL terminated, in scanner) and stays valid until the next
+//    call. otherwise *sentence is NULL. sentences may span calls
+uint32_t nmea_scan(
+      /* in out */       nmea_scanner_type *scanner,
+      /* in     */ const uint8_t *data,
+      /* in     */ const uint32_t n,
+      /*    out */       const char **sentence
+      );
+
+#endif   // NMEA_H
@@ -0,0 +1,201 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(PAN_LOG_H)
+#define  PAN_LOG_H
+#include "pin_types.h"
+#include <stdio.h>
+#include "image.h"
+
+// indexed panorama frame log
+//
+// panorama images are written to a single file, one compressed frame
+//    per block, followed by a timestamp index when the log is closed.
+//    readers mmap the file and can fetch frame N, or the frame nearest
+//    time T (binary search over the index), without scanning the file
+//
+// file layout (all values in host byte order)
+//    pan_log_file_header
+//    frame 0
+//       pan_log_frame_header
+//       plane 0 (r), plane 1 (g), plane 2 (b)
+//          each plane is a uint8 encoding flag, a uint32 payload size,
+//          then the payload
+//    frame 1
+//    ...
+//    index: pan_log_index_entry[num_frames]
+//    pan_log_file_footer
+//
+// if the writer doesn't close cleanly (e.g., crash or kill -9) there's
+//    no index. the reader then rebuilds it by walking frame headers,
+//    which is a sequential scan but one that doesn't touch pixel data
+//
+// compression is byte-oriented run-length encoding (packbits) of each
+//    color plane. the uncovered parts of the panorama are zero and gray
+//    output has identical r, g and b planes, so this gets most of the
+//    available gain at a fraction of the cost of a general compressor.
+//    a plane identical to plane 0 is stored as a reference to it
+
+#define PAN_LOG_MAGIC         0x474c504bu    // "KPLG"
+#define PAN_LOG_FRAME_MAGIC   0x4d52464bu    // "KFRM"
+#define PAN_LOG_INDEX_MAGIC   0x5844494bu    // "KIDX"
+#define PAN_LOG_VERSION       1u
+
+#define PAN_LOG_NUM_PLANES    3
+
+// plane encodings
+#define PAN_LOG_PLANE_RLE        0
+#define PAN_LOG_PLANE_RAW        1
+#define PAN_LOG_PLANE_COPY_0     2     // same content as plane 0
+
+// default name of log file in panorama log directory
+#define PAN_LOG_FILE_NAME     "pan_log.bin"
+
+struct pan_log_file_header {
+   uint32_t magic;
+   uint32_t version;
+   uint16_t width;
+   uint16_t height;
+   uint32_t reserved;
+};
+typedef struct pan_log_file_header pan_log_file_header_type;
+
+struct pan_log_frame_header {
+   uint32_t magic;
+   // total bytes in the frame block that follow this header
+   uint32_t payload_bytes;
+   double t;
+};
+typedef struct pan_log_frame_header pan_log_frame_header_type;
+
+struct pan_log_index_entry {
+   double t;
+   // offset of frame header from start of file
+   uint64_t offset;
+};
+typedef struct pan_log_index_entry pan_log_index_entry_type;
+
+struct pan_log_file_footer {
+   uint64_t index_offset;
+   uint32_t num_frames;
+   uint32_t magic;
+};
+typedef struct pan_log_file_footer pan_log_file_footer_type;
+
+
+////////////////////////////////////////////////////////////////////////
+// writer
+
+struct pan_log_writer {
+   FILE *fp;
+   image_size_type size;
+   uint64_t offset;
+   // compression buffer
+   uint8_t *buf;
+   size_t buf_size;
+   // index, grown as needed
+   pan_log_index_entry_type *index;
+   uint32_t num_frames;
+   uint32_t index_capacity;
+   // cumulative stats
+   uint64_t raw_bytes;
+   uint64_t written_bytes;
+   double write_sec;
+};
+typedef struct pan_log_writer pan_log_writer_type;
+
+// creates log file. returns NULL on error
+pan_log_writer_type * pan_log_open_writer(
+      /* in     */ const char *path,
+      /* in     */ const image_size_type size
+      );
+
+// compresses and appends a frame. planes are width*height bytes each.
+//    if g or b point to the same buffer as r they're stored as a
+//    reference to r
+// returns 0 on success, -1 on error
+int32_t pan_log_write_frame(
+      /* in out */       pan_log_writer_type *writer,
+      /* in     */ const double t,
+      /* in     */ const uint8_t *r,
+      /* in     */ const uint8_t *g,
+      /* in     */ const uint8_t *b
+      );
+
+// writes index and closes file. frees writer
+void pan_log_close_writer(
+      /* in out */       pan_log_writer_type *writer
+      );
+
+
+////////////////////////////////////////////////////////////////////////
+// reader
+
+struct pan_log_reader {
+   // mapping is read-only
+   uint8_t *map;
+   size_t map_size;
+   image_size_type size;
+   // points into map if file has an index, otherwise it's allocated
+   //    from a scan of frame headers
+   const pan_log_index_entry_type *index;
+   pan_log_index_entry_type *scanned_index_;
+   uint32_t num_frames;
+};
+typedef struct pan_log_reader pan_log_reader_type;
+
+// maps log file. returns NULL on error
+pan_log_reader_type * pan_log_open_reader(
+      /* in     */ const char *path
+      );
+
+void pan_log_close_reader(
+      /* in out */       pan_log_reader_type *reader
+      );
+
+// returns index of frame with timestamp closest to t, or -1 if
+//    log is empty
+int32_t pan_log_find_nearest(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const double t
+      );
+
+// returns timestamp of frame idx
+double pan_log_frame_time(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const uint32_t idx
+      );
+
+// decompresses frame idx into planes (width*height bytes each)
+// returns 0 on success, -1 on error
+int32_t pan_log_read_frame(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const uint32_t idx,
+      /*    out */       uint8_t *r,
+      /*    out */       uint8_t *g,
+      /*    out */       uint8_t *b
+      );
+
+// decompresses frame idx into image, which must be the same size as
+//    the log. gray channel is set as in create_image_pnm()
+// returns 0 on success, -1 on error
+int32_t pan_log_read_image(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const uint32_t idx,
+      /*    out */       image_type *img
+      );
+
+#endif   // PAN_LOG_H
@@ -20,6 +20,7 @@
 #define _GNU_SOURCE
 #endif   // _GNU_SOURCE
 #include <stdint.h>
+#include <stddef.h>
 #include <math.h>
 
 
@@ -108,12 +109,27 @@ struct network_id {
 };
 typedef struct network_id network_id_type;
 
+// binary header times (header version 2). times are nanoseconds since
+//    epoch, signed, split into high and low words. the version word
+//    starts with 0xff so it can't be confused with a version 1 (text)
+//    timestamp. words are uint32 so header alignment and size are the
+//    same as version 1
+#define SENSOR_HEADER_VERSION_MASK     0xffffff00
+#define SENSOR_HEADER_VERSION_TAG      0xff5e4800
+#define SENSOR_HEADER_VERSION          2
+struct sensor_header_times {
+   uint32_t version;
+   uint32_t timestamp_ns[2];
+   uint32_t timestamp_2_ns[2];
+};
+
 // header that is to precede sensor data sent over the network
 // dt is the amount of time, in seconds, since the previous packet
 //    was sent. negative value indicates no previous packet
 // custom fields are for use by sensor streams
-// all ints are stored in network byte order, and floats are
-//    stored as text strings
+// all ints are stored in network byte order. header times are binary
+//    in version 2 and text strings (%.4f) in version 1. readers
+//    accept both
 #define SENSOR_PACKET_LOG_DATA   64
 struct sensor_packet_header {
    uint32_t sensor_type;
@@ -122,11 +138,17 @@ struct sensor_packet_header {
       int32_t custom_32[2];
    };
    //
-   char timestamp[TIMESTAMP_STR_LEN];
-   // optional 2nd time. for camera, this is when frame was delivered to
-   //    the application, with regular timestamp being approximate
-   //    time of acquisition start
-   char timestamp_2[TIMESTAMP_STR_LEN];
+   union {
+      struct sensor_header_times times;
+      // version 1
+      struct {
+         char timestamp[TIMESTAMP_STR_LEN];
+         // optional 2nd time. for camera, this is when frame was
+         //    delivered to the application, with regular timestamp
+         //    being approximate time of acquisition start
+         char timestamp_2[TIMESTAMP_STR_LEN];
+      };
+   };
    // consider moving sync service to pi node, as part of pi_super,
    //    with hub being receiver. possibly split frame sync from time sync
    char log_data[SENSOR_PACKET_LOG_DATA];
@@ -167,10 +189,20 @@ typedef struct sensor_packet_header sensor_packet_header_type;
 //
 // packet to both synchronize all nodes on the network and also
 //    send commands (e.g., request frame capture from camera)
+// new fields go at the end so packets stay readable by nodes that
+//    predate them
 struct udp_sync_packet {
    uint16_t  packet_type;
    char  timestamp[TIMESTAMP_STR_LEN]; // time stored as %.4f
+   // interval between camera frames requested by the hub, in msec. this
+   //    is sent in every packet so late-starting cameras pick it up. 0
+   //    means use CAMERA_FRAME_INTERVAL. packets from older hubs end
+   //    before this field, and are treated as 0
+   uint16_t  frame_interval_ms;
 };
+// size of packet sent by hubs that predate frame_interval_ms
+#define UDP_SYNC_PACKET_MIN_LEN     \
+      (offsetof(struct udp_sync_packet, frame_interval_ms))
 
 // update system time based on contents of this packet
 #define UDP_SYNC_PACKET_TIME              0x0001
@@ -186,6 +218,8 @@ struct udp_sync_packet {
 #define UDP_SYNC_PACKET_START_ACQ         0x0010
 // stop data acquisition streams (packet initiated by external process)
 #define UDP_SYNC_PACKET_STOP_ACQ          0x0020
+// announces change in frame interval (frame_interval_ms)
+#define UDP_SYNC_PACKET_FRAME_RATE        0x0040
 // tell listening processes to shutdown
 #define UDP_SYNC_PACKET_EXIT              0x8000
 // NOTE: receipt of any UDP packet cannot be assumed to occur
@@ -21,6 +21,7 @@
 #endif   // _GNU_SOURCE
 #include <math.h>
 #include <time.h>
+#include <sys/uio.h>
 #include "pin_types.h"
 
 // TODO make this configurable. the obvious way to do this is to set it
@@ -188,6 +189,16 @@ int check_protocol_version(int sockfd, uint32_t major, uint32_t minor);
 int send_block(int sockfd, const void *data, uint32_t len);
 int recv_block(int sockfd, void *data, uint32_t len);
 
+// vectored versions of send_block/recv_block, for sending or receiving
+//    several buffers (eg, header and image planes) in one syscall
+//    when the socket allows. entries in iov are modified as data moves.
+//    if num_calls is not NULL, the number of syscalls used is added to it
+// procedures return number of bytes sent/received, or -1 on error
+int send_blockv(int sockfd, struct iovec *iov, uint32_t iov_cnt,
+      uint64_t *num_calls);
+int recv_blockv(int sockfd, struct iovec *iov, uint32_t iov_cnt,
+      uint64_t *num_calls);
+
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 //
@@ -0,0 +1,108 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(PINET_REACTOR_H)
+#define  PINET_REACTOR_H
+#include <stdint.h>
+
+// optional shared reader for sensor connections. receivers normally
+//    block in recv_block() on their own socket. when the reactor is
+//    running, a receiver accepts its connection as before and then
+//    hands the socket to the reactor, which reads all registered
+//    sockets from one or two epoll loops. each complete fixed-size
+//    packet is passed straight to the receiver's handler on the loop's
+//    thread, so there's no handoff or wakeup of the receiver's thread
+//    per packet. the receiver's thread only waits for the connection
+//    to close (eg, to accept the next one)
+// the socket isn't read while a handler runs, so a slow receiver pushes
+//    back on its sender through TCP as it did when it read the socket
+//    itself. a slow handler also delays other connections on the same
+//    loop, so handlers that do much work should hand packets to the
+//    receiver's thread
+// a handler that finds a packet it can't use returns an error, and the
+//    reactor closes the connection. the receiver sees it closed as it
+//    would on a read error. handlers never close the socket themselves
+// bytes/sec, packets/sec, reads/packet, time to assemble each packet (ie, time
+//    waiting on the network once a packet has started to arrive) and
+//    time spent in the handler are written to the kernel log for each
+//    connection every PINET_REACTOR_REPORT_SEC
+
+#define PINET_REACTOR_MAX_LOOPS     2
+#define PINET_REACTOR_MAX_CONNS     32
+#define PINET_REACTOR_REPORT_SEC    60.0
+
+#define PINET_CONN_NAME_LEN         64
+
+// how long receivers wait for their connection to close before
+//    checking their quit flag
+#define PINET_CONN_WAIT_SEC         0.25
+
+struct pinet_conn;
+typedef struct pinet_conn pinet_conn_type;
+
+// receiver callbacks. these are called on the reactor's thread, and
+//    never concurrently for the same connection
+struct pinet_conn_handler {
+   // called w/ each complete packet. packet is only valid during call.
+   //    returns 0 on success. on error, connection is closed
+   int32_t (*packet)(void *arg, uint8_t *packet, double received_sec);
+   // optional. called after packets are delivered and when the delay
+   //    it last returned has elapsed. returns seconds until it should
+   //    be called again, or <0 if no timer is needed
+   double (*timer)(void *arg);
+   void *arg;
+};
+typedef struct pinet_conn_handler pinet_conn_handler_type;
+
+// starts reactor w/ num_loops event loops (each its own thread).
+//    connections are spread across loops. returns 0 on success
+int32_t start_pinet_reactor(
+      /* in     */ const uint32_t num_loops
+      );
+
+// stops event loops. connections should be removed first
+void stop_pinet_reactor(void);
+
+// returns 1 if reactor is running, 0 otherwise
+int32_t pinet_reactor_enabled(void);
+
+// hands connected socket to reactor. complete packets of packet_bytes
+//    are passed to handler. returns NULL on error, in which case socket
+//    is not modified
+// the reactor owns the socket from here on and closes it when the
+//    connection is removed
+pinet_conn_type * pinet_reactor_add(
+      /* in     */ const int fd,
+      /* in     */ const char *name,
+      /* in     */ const uint32_t packet_bytes,
+      /* in     */ const pinet_conn_handler_type *handler
+      );
+
+// removes connection from reactor and closes its socket. if a handler
+//    is running, this waits for it to finish. no handler is called
+//    after this returns
+void pinet_reactor_remove(
+      /* in out */       pinet_conn_type *conn
+      );
+
+// waits up to timeout_sec for connection to be closed (by remote or on
+//    error). returns 1 if closed, 0 on timeout
+int32_t pinet_conn_wait_closed(
+      /* in out */       pinet_conn_type *conn,
+      /* in     */ const double timeout_sec
+      );
+
+#endif   // PINET_REACTOR_H
@@ -17,6 +17,7 @@
 #if !defined(SENSOR_PACKET_H)
 #define SENSOR_PACKET_H
 #include "pinet.h"
+#include <stdio.h>
 #include <stdint.h>
 #include "lin_alg.h"
 
@@ -45,6 +46,33 @@ struct imu_data {
 };
 typedef struct imu_data imu_data_type;
 
+// binary IMU log, as written by imu_receiver. file starts with
+//    IMU_LOG_MAGIC and is followed by fixed-size records in host byte
+//    order. values are as reported from the sensor (ie, device space)
+#define IMU_LOG_MAGIC      "IMULOG1\n"
+#define IMU_LOG_MAGIC_LEN  8
+
+struct imu_log_record {
+   double t;
+   float gyr[3];
+   float acc[3];
+   float mag[3];
+   float temp;
+};
+typedef struct imu_log_record imu_log_record_type;
+
+// writes binary log header. returns 0 on success, -1 on error
+int imu_log_write_header(
+      /* in out */       FILE *fp
+      );
+
+// checks if fp is at the start of a binary IMU log. if so the header
+//    is consumed and 1 is returned. otherwise fp is rewound and 0
+//    is returned (eg, for text logs)
+int imu_log_check_header(
+      /* in out */       FILE *fp
+      );
+
 // print sensor data to stdout
 void print_sensor_data(
       /* in     */ const struct imu_sensor_packet *s
@@ -0,0 +1,193 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(VY_UDP_H)
+#define  VY_UDP_H
+#include <stdint.h>
+#include "pin_types.h"
+#include "latency.h"
+#include "logger.h"
+
+// optional UDP transport for camera frames. over TCP, a retransmission
+//    on one camera's link delays that frame and so the whole frame_sync
+//    set. over UDP, each frame is sent as a series of row-band
+//    datagrams, which can go to a multicast group so several consumers
+//    (eg, core and a recorder) get the same stream
+// the receiver reassembles frames and hands a frame on when all rows
+//    have arrived or when its deadline passes, whichever comes first.
+//    rows that don't arrive in time are filled from the nearest row
+//    that did, are counted in the frame's missing_rows and are flagged
+//    in its row_missing. datagrams
+//    that arrive after their frame was handed on are counted as late
+//    and dropped
+
+#define VY_UDP_MAGIC          0x56595544
+
+#define VY_UDP_PLANE_V        0
+#define VY_UDP_PLANE_Y        1
+
+// rows of one plane per datagram. one camera row (820 bytes) plus
+//    header fits in a standard ethernet frame, so datagrams aren't
+//    fragmented
+#define VY_UDP_BAND_ROWS      1
+
+#define VY_UDP_ROWS_PER_FRAME    (2 * CAM_ROWS)
+
+// datagrams sent/received per sendmmsg/recvmmsg call
+#define VY_UDP_BATCH          64
+
+// frames that can be assembled at once (including one held by caller)
+#define VY_UDP_NUM_FRAMES     4
+
+// frames missing more than this fraction of rows are dropped
+#define VY_UDP_MAX_MISSING_FRAC     0.5
+
+// datagrams this far behind newest frame handed on mean the sender
+//    restarted its frame count
+#define VY_UDP_RESYNC_FRAMES  64
+
+#define VY_UDP_REPORT_SEC     60.0
+
+// ints are in network byte order. timestamps are in host byte order,
+//    as camera and core are both little-endian
+struct vy_udp_header {
+   uint32_t magic;
+   uint32_t frame_id;
+   uint16_t plane;
+   uint16_t first_row;
+   uint16_t num_rows;
+   uint16_t row_bytes;
+   double frame_request_time;
+   double frame_received_time;
+};
+typedef struct vy_udp_header vy_udp_header_type;
+
+#define VY_UDP_MAX_DATAGRAM   \
+      (sizeof(vy_udp_header_type) + VY_UDP_BAND_ROWS * CAM_COLS)
+
+////////////////////////////////////////////////////////////////////////
+// sender
+
+// creates socket that sends to target, which can be a multicast group.
+//    returns socket, or -1 on error
+int vy_udp_open_sender(
+      /* in     */ const network_id_type *target
+      );
+
+// sends V and Y planes (each CAM_ROWS x CAM_COLS) of frame. if
+//    num_calls is not NULL, number of syscalls used is added to it.
+//    returns 0 on success and -1 on error
+int32_t vy_udp_send_frame(
+      /* in     */ const int sockfd,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const double frame_request_time,
+      /* in     */ const double frame_received_time,
+      /* in     */ const uint8_t *v_chan,
+      /* in     */ const uint8_t *y_chan,
+      /* in out */       uint64_t *num_calls
+      );
+
+////////////////////////////////////////////////////////////////////////
+// receiver
+
+#define VY_UDP_FRAME_FREE           0
+#define VY_UDP_FRAME_ASSEMBLING     1
+#define VY_UDP_FRAME_READY          2
+#define VY_UDP_FRAME_HELD           3
+
+struct vy_udp_frame {
+   uint32_t state;
+   uint32_t frame_id;
+   double frame_request_time;
+   double frame_received_time;
+   // arrival of first datagram. deadline is measured from this
+   double first_sec;
+   uint32_t rows_received;
+   // rows that didn't arrive and were filled from neighboring rows
+   uint32_t missing_rows;
+   uint8_t row_ok[VY_UDP_ROWS_PER_FRAME];
+   // 1 for each camera row where V or Y was missing. set when frame is
+   //    finished
+   uint8_t row_missing[CAM_ROWS];
+   // order frames were finished in. ready frames are handed on in this
+   //    order, which is frame order except when sender restarts
+   uint32_t finish_seq;
+   uint8_t *v_chan;
+   uint8_t *y_chan;
+};
+typedef struct vy_udp_frame vy_udp_frame_type;
+
+struct vy_udp_stats {
+   uint32_t complete_frames;
+   uint32_t partial_frames;
+   uint32_t dropped_frames;
+   uint32_t missing_rows;
+   uint32_t datagrams;
+   uint32_t late_datagrams;
+   uint32_t bad_datagrams;
+   uint64_t recv_calls;
+   // first datagram to frame handed on
+   latency_stats_type assembly;
+};
+typedef struct vy_udp_stats vy_udp_stats_type;
+
+struct vy_udp_receiver {
+   int sockfd;
+   double deadline_sec;
+   vy_udp_frame_type frames[VY_UDP_NUM_FRAMES];
+   // newest frame handed on
+   uint32_t last_frame_id;
+   uint32_t have_last_frame;
+   uint32_t finish_seq;
+   // datagram buffers for recvmmsg
+   uint8_t *buf;
+   vy_udp_stats_type stats;
+   double report_sec;
+};
+typedef struct vy_udp_receiver vy_udp_receiver_type;
+
+// binds receiver to port, joining multicast group if group is not NULL.
+//    frames are handed on no later than deadline_sec after their first
+//    datagram arrives. returns NULL on error
+vy_udp_receiver_type * create_vy_udp_receiver(
+      /* in     */ const uint16_t port,
+      /* in     */ const char *group,
+      /* in     */ const double deadline_sec
+      );
+
+void free_vy_udp_receiver(
+      /* in out */       vy_udp_receiver_type *rcv
+      );
+
+// waits up to timeout_sec for next frame. frame remains valid until
+//    next call. returns 0 when frame is available, 1 on timeout and
+//    -1 on error
+int32_t vy_udp_next_frame(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const double timeout_sec,
+      /*    out */       vy_udp_frame_type **frame
+      );
+
+// writes frame and datagram statistics to log every VY_UDP_REPORT_SEC,
+//    or now if 'final' is set, and resets them
+void vy_udp_report(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in out */       log_info_type *log,
+      /* in     */ const char *name,
+      /* in     */ const uint32_t final
+      );
+
+#endif   // VY_UDP_H
@@ -195,15 +195,13 @@ void blur_image_r2(
    }
 }
 
-void blur_image_r1(
+// horizontal pass of blur_image_r1
+static void blur_horiz_r1(
       /* in     */ const uint8_t * restrict src,
       /*    out */       unsigned int * restrict tmp,
-      /*    out */       uint8_t * restrict dest,
       /* in     */ const image_size_type size
       )
 {
-   /////////////////////////////////////////////////////////////////////
-   // horizontal blur
    {
       unsigned int left0, center, right0;
       for (unsigned int y=0; y<size.height; y++) {
@@ -219,9 +217,9 @@ void blur_image_r1(
          for (int x=1; x<size.width-1; x++) {
             left0 = center;
             center = right0;
+            right0 = src[ctr_idx+1];
             tmp[ctr_idx] = ((left0 + 2*center + right0) >> 2);
             ++ctr_idx;
-            right0 = src[ctr_idx];
          }
          ////////////////////////////////////////////////
          // right col
@@ -230,6 +228,18 @@ void blur_image_r1(
          tmp[ctr_idx] = (left0 + center) >> 1;
       }
    }
+}
+
+void blur_image_r1(
+      /* in     */ const uint8_t * restrict src,
+      /*    out */       unsigned int * restrict tmp,
+      /*    out */       uint8_t * restrict dest,
+      /* in     */ const image_size_type size
+      )
+{
+   /////////////////////////////////////////////////////////////////////
+   // horizontal blur
+   blur_horiz_r1(src, tmp, size);
    /////////////////////////////////////////////////////////////////////
    // vertical blur
    {
@@ -247,9 +257,9 @@ void blur_image_r1(
          for (int y=1; y<size.height-1; y++) {
             top0 = center;
             center = bot0;
+            bot0 = tmp[ctr_idx+size.width];
             dest[ctr_idx] = (uint8_t) ((top0 + 2*center + bot0) >> 2);
             ctr_idx += size.width;
-            bot0 = tmp[ctr_idx];
          }
          ////////////////////////////////////////////////
          // bottom row
@@ -261,6 +271,50 @@ void blur_image_r1(
 }
 
 
+void blur_image_r1_skip_rows(
+      /* in     */ const uint8_t * restrict src,
+      /*    out */       unsigned int * restrict tmp,
+      /*    out */       uint8_t * restrict dest,
+      /* in     */ const image_size_type size,
+      /* in     */ const uint8_t * restrict skip_row
+      )
+{
+   /////////////////////////////////////////////////////////////////////
+   // horizontal blur
+   blur_horiz_r1(src, tmp, size);
+   /////////////////////////////////////////////////////////////////////
+   // vertical blur. weights are the same for a whole row. edge rows
+   //    have center weight 1, as in blur_image_r1()
+   const uint32_t width = size.width;
+   const uint32_t height = size.height;
+   for (uint32_t y=0; y<height; y++) {
+      const unsigned int *center = &tmp[y * width];
+      const unsigned int *top = (y > 0) ? center - width : center;
+      const unsigned int *bot = (y < height - 1) ? center + width : center;
+      const unsigned int w_top = ((y > 0) && !skip_row[y-1]) ? 1 : 0;
+      const unsigned int w_bot =
+            ((y < height - 1) && !skip_row[y+1]) ? 1 : 0;
+      unsigned int w_center = 0;
+      if (!skip_row[y]) {
+         w_center = ((y == 0) || (y == height - 1)) ? 1 : 2;
+      }
+      const unsigned int total = w_top + w_center + w_bot;
+      uint8_t *out = &dest[y * width];
+      if (total == 0) {
+         // nothing usable here. keep horizontal result
+         for (uint32_t x=0; x<width; x++) {
+            out[x] = (uint8_t) center[x];
+         }
+         continue;
+      }
+      for (uint32_t x=0; x<width; x++) {
+         out[x] = (uint8_t) ((w_top * top[x] + w_center * center[x] +
+               w_bot * bot[x]) / total);
+      }
+   }
+}
+
+
 // downsample 2D array 'orig' to 'down'
 // each downsmple pixel is weighed average of pixels in original
 //    array equivalent to if original array was convolved with
@@ -473,11 +527,66 @@ for (uint32_t i=0; i<256; i++) {
    return errs;
 }
 
+static uint32_t test_blur_r1_skip_rows(void)
+{
+   uint32_t errs = 0;
+   printf("Testing blur_image_r1_skip_rows\n");
+   const image_size_type sz = { .x=16, .y=16 };
+   unsigned int tmp[256];
+   uint8_t expected[256];
+   uint8_t out[256];
+   uint8_t skip[16];
+   // nothing skipped is same as blur_image_r1
+   memset(skip, 0, sizeof skip);
+   blur_image_r1(ORIG, tmp, expected, sz);
+   blur_image_r1_skip_rows(ORIG, tmp, out, sz, skip);
+   if (memcmp(expected, out, sizeof out) != 0) {
+      printf("  output differs from blur_image_r1\n");
+      errs++;
+   }
+   // flat image with garbage in skipped rows. garbage shouldn't reach
+   //    other rows
+   uint8_t img[256];
+   memset(img, 100, sizeof img);
+   memset(&img[0], 255, 16);
+   memset(&img[5 * 16], 255, 32);
+   skip[0] = 1;
+   skip[5] = 1;
+   skip[6] = 1;
+   blur_image_r1_skip_rows(img, tmp, out, sz, skip);
+   for (uint32_t y=0; y<16; y++) {
+      if (skip[y]) {
+         continue;
+      }
+      for (uint32_t x=0; x<16; x++) {
+         if (out[x + y*16] != 100) {
+            printf("  pixel %d,%d is %d, expected 100\n", x, y,
+                  out[x + y*16]);
+            errs++;
+            break;
+         }
+      }
+   }
+   // skipped row with usable neighbor is blurred from neighbor
+   if (out[5 * 16] != 100) {
+      printf("  skipped row 5 is %d, expected 100\n", out[5 * 16]);
+      errs++;
+   }
+   //
+   if (errs == 0) {
+      printf("    passed\n");
+   } else {
+      printf("    %d errors\n", errs);
+   }
+   return errs;
+}
+
 int main(int argc, char** argv) {
    (void) argc;
    (void) argv;
    uint32_t errs = 0;
    errs += test_blur_5x5();
+   errs += test_blur_r1_skip_rows();
    //////////////////
    printf("\n");
    if (errs == 0) {
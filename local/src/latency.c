@@ -0,0 +1,265 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "latency.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// bin for latency, in microseconds
+static uint32_t latency_bin(
+      /* in     */ const uint64_t usec
+      )
+{
+   if (usec < LATENCY_SUB_BINS) {
+      return (uint32_t) usec;
+   }
+   if (usec >= (1ul << 32)) {
+      return LATENCY_NUM_BINS - 1;
+   }
+   const uint32_t msb = (uint32_t) (63 - __builtin_clzl(usec));
+   const uint32_t group = msb - LATENCY_SUB_BIN_BITS + 1;
+   const uint32_t sub = (uint32_t) (usec >> (msb - LATENCY_SUB_BIN_BITS)) &
+         (LATENCY_SUB_BINS - 1);
+   return group * LATENCY_SUB_BINS + sub;
+}
+
+// midpoint of bin, in seconds. bin holds whole numbers of microseconds
+//    on [lower, lower+width)
+static double latency_bin_center(
+      /* in     */ const uint32_t bin
+      )
+{
+   const uint32_t group = bin / LATENCY_SUB_BINS;
+   const uint32_t sub = bin % LATENCY_SUB_BINS;
+   if (group == 0) {
+      return 1.0e-6 * (double) sub;
+   }
+   const double width = (double) (1ul << (group - 1));
+   const double lower = (double) (LATENCY_SUB_BINS + sub) * width;
+   return 1.0e-6 * (lower + 0.5 * (width - 1.0));
+}
+
+
+void latency_reset(
+      /*    out */       latency_stats_type *stats
+      )
+{
+   memset(stats, 0, sizeof *stats);
+}
+
+
+void latency_add(
+      /* in out */       latency_stats_type *stats,
+      /* in     */ const double dt_sec
+      )
+{
+   double dt = dt_sec;
+   if (dt < 0.0) {
+      stats->negative++;
+      dt = 0.0;
+   }
+   stats->bins[latency_bin((uint64_t) (dt * 1.0e6 + 0.5))]++;
+   stats->count++;
+   stats->sum_sec += dt;
+   if (dt > stats->max_sec) {
+      stats->max_sec = dt;
+   }
+}
+
+
+void latency_merge(
+      /* in out */       latency_stats_type *dest,
+      /* in     */ const latency_stats_type *src
+      )
+{
+   for (uint32_t i=0; i<LATENCY_NUM_BINS; i++) {
+      dest->bins[i] += src->bins[i];
+   }
+   dest->count += src->count;
+   dest->negative += src->negative;
+   dest->sum_sec += src->sum_sec;
+   if (src->max_sec > dest->max_sec) {
+      dest->max_sec = src->max_sec;
+   }
+}
+
+
+double latency_percentile(
+      /* in     */ const latency_stats_type *stats,
+      /* in     */ const double pct
+      )
+{
+   if (stats->count == 0) {
+      return 0.0;
+   }
+   uint32_t rank = (uint32_t) ceil(0.01 * pct * (double) stats->count);
+   if (rank < 1) {
+      rank = 1;
+   }
+   uint32_t total = 0;
+   for (uint32_t i=0; i<LATENCY_NUM_BINS; i++) {
+      total += stats->bins[i];
+      if (total >= rank) {
+         // top bin's midpoint can be above largest sample
+         const double t = latency_bin_center(i);
+         return t < stats->max_sec ? t : stats->max_sec;
+      }
+   }
+   return stats->max_sec;
+}
+
+
+void latency_summary(
+      /* in     */ const latency_stats_type *stats,
+      /* in     */ const char *label,
+      /*    out */       char *buf,
+      /* in     */ const size_t buf_len
+      )
+{
+   const double mean = stats->count > 0 ?
+         stats->sum_sec / (double) stats->count : 0.0;
+   snprintf(buf, buf_len, "%-20s n %6d  mean %8.2f  p50 %8.2f  p90 %8.2f  "
+         "p99 %8.2f  max %8.2f ms", label, stats->count, 1000.0 * mean,
+         1000.0 * latency_percentile(stats, 50.0),
+         1000.0 * latency_percentile(stats, 90.0),
+         1000.0 * latency_percentile(stats, 99.0),
+         1000.0 * stats->max_sec);
+   if (stats->negative > 0) {
+      size_t len = strlen(buf);
+      snprintf(&buf[len], buf_len - len, "  (%d negative)", stats->negative);
+   }
+}
+
+
+void log_latency_summary(
+      /* in out */       log_info_type *log,
+      /* in     */ const latency_stats_type *stats,
+      /* in     */ const char *label
+      )
+{
+   char buf[STR_LEN];
+   latency_summary(stats, label, buf, STR_LEN);
+   log_info(log, "Latency %s", buf);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+#if defined(TEST_LATENCY)
+
+static uint32_t test_bins(void)
+{
+   uint32_t errs = 0;
+   // every bin's center should map back to that bin, and bins should
+   //    increase w/ latency
+   uint32_t prev = 0;
+   for (uint32_t i=0; i<LATENCY_NUM_BINS; i++) {
+      const double t = latency_bin_center(i);
+      const uint32_t bin = latency_bin((uint64_t) (t * 1.0e6 + 0.5));
+      if (bin != i) {
+         fprintf(stderr, "Bin %d center %.6f maps to bin %d\n", i, t, bin);
+         errs++;
+      }
+      if ((i > 0) && (bin < prev)) {
+         fprintf(stderr, "Bin %d is out of order\n", i);
+         errs++;
+      }
+      prev = bin;
+   }
+   // bin width should be w/in ~6% of value
+   for (uint64_t usec=20; usec<4000000000ul; usec=usec*3/2) {
+      const double t = latency_bin_center(latency_bin(usec));
+      const double err = fabs(t - 1.0e-6 * (double) usec) /
+            (1.0e-6 * (double) usec);
+      if (err > 0.0625) {
+         fprintf(stderr, "Latency %ld usec in bin w/ center %.6f\n",
+               usec, t);
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+static uint32_t test_percentiles(void)
+{
+   uint32_t errs = 0;
+   latency_stats_type *stats = malloc(sizeof *stats);
+   latency_stats_type *half = malloc(sizeof *half);
+   latency_reset(stats);
+   latency_reset(half);
+   // 1 to 1000 ms, evenly spread. second half goes through merge
+   for (uint32_t i=1; i<=1000; i++) {
+      latency_add(i <= 500 ? stats : half, 0.001 * (double) i);
+   }
+   latency_merge(stats, half);
+   const double pcts[] = { 50.0, 90.0, 99.0, 100.0 };
+   for (uint32_t i=0; i<4; i++) {
+      const double expected = 0.01 * pcts[i];
+      const double t = latency_percentile(stats, pcts[i]);
+      if (fabs(t - expected) > 0.0625 * expected) {
+         fprintf(stderr, "p%.0f is %.4f, expected %.4f\n", pcts[i],
+               t, expected);
+         errs++;
+      }
+   }
+   if ((stats->count != 1000) || (fabs(stats->max_sec - 1.0) > 1.0e-9)) {
+      fprintf(stderr, "Count %d and max %.4f, expected 1000 and 1.0\n",
+            stats->count, stats->max_sec);
+      errs++;
+   }
+   latency_add(stats, -0.01);
+   if ((stats->negative != 1) || (stats->bins[0] != 1)) {
+      fprintf(stderr, "Negative latency not counted as zero\n");
+      errs++;
+   }
+   char buf[STR_LEN];
+   latency_summary(stats, "test", buf, STR_LEN);
+   printf("%s\n", buf);
+   latency_reset(stats);
+   if (latency_percentile(stats, 50.0) != 0.0) {
+      fprintf(stderr, "Empty stats have non-zero median\n");
+      errs++;
+   }
+   free(stats);
+   free(half);
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   errs += test_bins();
+   errs += test_percentiles();
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
+#endif   // TEST_LATENCY
@@ -0,0 +1,938 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "nmea.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// char classes
+#define NMEA_CHAR_FIELD    0x01     // may appear in a field
+#define NMEA_CHAR_HEX      0x02
+#define NMEA_CHAR_ADDRESS  0x04     // may appear in address field
+
+#define FIELD_ADDR   (NMEA_CHAR_FIELD | NMEA_CHAR_ADDRESS)
+#define FIELD_HEX    (NMEA_CHAR_FIELD | NMEA_CHAR_HEX)
+#define FIELD_ALL    (NMEA_CHAR_FIELD | NMEA_CHAR_HEX | NMEA_CHAR_ADDRESS)
+
+static const uint8_t char_class_[256] = {
+   [ '0' ... '9' ] = FIELD_ALL,
+   [ 'A' ... 'F' ] = FIELD_ALL,
+   [ 'G' ... 'Z' ] = FIELD_ADDR,
+   [ 'a' ... 'f' ] = FIELD_HEX,
+   [ 'g' ... 'z' ] = NMEA_CHAR_FIELD,
+   [ '.' ] = NMEA_CHAR_FIELD,
+   [ '-' ] = NMEA_CHAR_FIELD,
+   [ '+' ] = NMEA_CHAR_FIELD,
+};
+
+// powers of 10 for converting fractional digits
+static const double pow10_[19] = {
+   1.0e0, 1.0e1, 1.0e2, 1.0e3, 1.0e4, 1.0e5, 1.0e6, 1.0e7, 1.0e8, 1.0e9,
+   1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15, 1.0e16, 1.0e17, 1.0e18
+};
+#define MAX_DIGITS   18
+
+// talkers that are accepted (2nd char of address -- first is 'G')
+static const char talkers_[] = "ABILNPQ";
+
+
+static uint8_t dehex(
+      /* in     */ const char c
+      )
+{
+   if (c <= '9') {
+      return (uint8_t) (c - '0');
+   } else if (c <= 'F') {
+      return (uint8_t) (10 + c - 'A');
+   }
+   return (uint8_t) (10 + c - 'a');
+}
+
+
+// returns type of sentence w/ 5-char address (eg, "GPGGA"). address
+//    chars are assumed to have been validated
+static int32_t sentence_type(
+      /* in     */ const char *addr
+      )
+{
+   if ((addr[0] != 'G') || (strchr(talkers_, addr[1]) == NULL)) {
+      return NMEA_IGNORED;
+   }
+   const uint32_t code = ((uint32_t) (uint8_t) addr[2] << 16) |
+         ((uint32_t) (uint8_t) addr[3] << 8) | (uint32_t) (uint8_t) addr[4];
+   switch (code) {
+      case ('G' << 16) | ('G' << 8) | 'A':
+         return NMEA_GGA;
+      case ('R' << 16) | ('M' << 8) | 'C':
+         return NMEA_RMC;
+      default:
+         return NMEA_IGNORED;
+   };
+}
+
+
+int32_t nmea_tokenize(
+      /* in     */ const char *sentence,
+      /* in     */ const uint32_t len,
+      /*    out */       nmea_fields_type *fields,
+      /* in out */       nmea_stats_type *stats
+      )
+{
+   uint32_t i = 0;
+   const uint32_t has_checksum = (len > 0) && (sentence[0] == '$');
+   if (has_checksum) {
+      i = 1;
+   }
+   const uint32_t end = len < NMEA_MAX_SENTENCE ? len : NMEA_MAX_SENTENCE;
+   stats->bytes += end;
+   /////////////////////////////////////////////
+   // address
+   if (end < i + 6) {
+      goto bad_format;
+   }
+   const char *addr = &sentence[i];
+   for (uint32_t j=0; j<5; j++) {
+      if ((char_class_[(uint8_t) addr[j]] & NMEA_CHAR_ADDRESS) == 0) {
+         goto bad_format;
+      }
+   }
+   if (addr[5] != ',') {
+      goto bad_format;
+   }
+   const int32_t type = sentence_type(addr);
+   if (type == NMEA_IGNORED) {
+      stats->ignored++;
+      return type;
+   }
+   /////////////////////////////////////////////
+   // fields
+   fields->type = type;
+   fields->field[0] = addr;
+   uint32_t num_fields = 0;
+   uint32_t field_start = i;
+   uint8_t checksum = 0;
+   for (; i<end; i++) {
+      const char c = sentence[i];
+      if (char_class_[(uint8_t) c] & NMEA_CHAR_FIELD) {
+         checksum ^= (uint8_t) c;
+      } else if (c == ',') {
+         checksum ^= (uint8_t) c;
+         fields->len[num_fields] = (uint8_t) (i - field_start);
+         if (++num_fields >= NMEA_MAX_FIELDS) {
+            goto bad_format;
+         }
+         field_start = i + 1;
+         fields->field[num_fields] = &sentence[field_start];
+      } else {
+         break;
+      }
+   }
+   fields->len[num_fields] = (uint8_t) (i - field_start);
+   fields->num_fields = num_fields + 1;
+   /////////////////////////////////////////////
+   // checksum
+   if ((i < end) && (sentence[i] == '*')) {
+      if ((i + 2 >= end) ||
+            ((char_class_[(uint8_t) sentence[i+1]] & NMEA_CHAR_HEX) == 0) ||
+            ((char_class_[(uint8_t) sentence[i+2]] & NMEA_CHAR_HEX) == 0)) {
+         goto bad_format;
+      }
+      const uint8_t reported = (uint8_t) ((dehex(sentence[i+1]) << 4) |
+            dehex(sentence[i+2]));
+      if (reported != checksum) {
+         stats->bad_checksum++;
+         return -1;
+      }
+   } else if (has_checksum) {
+      goto bad_format;
+   } else if ((i < end) && (sentence[i] != '\r') && (sentence[i] != '\n')
+         && (sentence[i] != 0)) {
+      goto bad_format;
+   }
+   stats->sentences++;
+   return type;
+bad_format:
+   stats->bad_format++;
+   return -1;
+}
+
+
+// parses [+-]ddd[.ddd]. returns 0 on success, 1 if empty and -1 if
+//    malformed
+static int32_t parse_decimal(
+      /* in     */ const char *str,
+      /* in     */ const uint32_t len,
+      /*    out */       double *val
+      )
+{
+   if (len == 0) {
+      return 1;
+   }
+   uint32_t i = 0;
+   uint32_t negative = 0;
+   if ((str[0] == '-') || (str[0] == '+')) {
+      negative = str[0] == '-';
+      i = 1;
+   }
+   uint64_t mantissa = 0;
+   uint32_t digits = 0;
+   uint32_t frac_digits = 0;
+   uint32_t have_point = 0;
+   for (; i<len; i++) {
+      const char c = str[i];
+      if ((c >= '0') && (c <= '9')) {
+         if (digits < MAX_DIGITS) {
+            mantissa = mantissa * 10 + (uint64_t) (c - '0');
+            digits++;
+            if (have_point) {
+               frac_digits++;
+            }
+         } else if (!have_point) {
+            return -1;  // too large
+         }
+         // excess fractional digits are dropped
+      } else if ((c == '.') && !have_point) {
+         have_point = 1;
+      } else {
+         return -1;
+      }
+   }
+   if (digits == 0) {
+      return -1;
+   }
+   const double v = (double) mantissa / pow10_[frac_digits];
+   *val = negative ? -v : v;
+   return 0;
+}
+
+
+int32_t nmea_read_decimal(
+      /* in     */ const nmea_fields_type *fields,
+      /* in     */ const uint32_t idx,
+      /*    out */       double *val
+      )
+{
+   if (idx >= fields->num_fields) {
+      return 1;
+   }
+   return parse_decimal(fields->field[idx], fields->len[idx], val);
+}
+
+
+int32_t nmea_read_uint(
+      /* in     */ const nmea_fields_type *fields,
+      /* in     */ const uint32_t idx,
+      /*    out */       uint32_t *val
+      )
+{
+   if ((idx >= fields->num_fields) || (fields->len[idx] == 0)) {
+      return 1;
+   }
+   const char *str = fields->field[idx];
+   const uint32_t len = fields->len[idx];
+   if (len > 9) {
+      return -1;
+   }
+   uint32_t v = 0;
+   for (uint32_t i=0; i<len; i++) {
+      if ((str[i] < '0') || (str[i] > '9')) {
+         return -1;
+      }
+      v = v * 10 + (uint32_t) (str[i] - '0');
+   }
+   *val = v;
+   return 0;
+}
+
+
+int32_t nmea_read_latlon(
+      /* in     */ const nmea_fields_type *fields,
+      /* in     */ const uint32_t idx,
+      /*    out */       double *deg
+      )
+{
+   double raw;
+   int32_t rc = nmea_read_decimal(fields, idx, &raw);
+   if (rc != 0) {
+      // position w/o hemisphere is malformed. empty position is OK
+      if ((rc > 0) && (idx + 1 < fields->num_fields) &&
+            (fields->len[idx+1] != 0)) {
+         return -1;
+      }
+      return rc;
+   }
+   if ((raw < 0.0) || (idx + 1 >= fields->num_fields) ||
+         (fields->len[idx+1] != 1)) {
+      return -1;
+   }
+   // ddmm.mmmm -> dd + mm.mmmm / 60
+   const double whole = floor(raw / 100.0);
+   const double minutes = raw - 100.0 * whole;
+   if (minutes >= 60.0) {
+      return -1;
+   }
+   double val = whole + minutes / 60.0;
+   switch (fields->field[idx+1][0]) {
+      case 'N':
+      case 'E':
+         break;
+      case 'S':
+      case 'W':
+         val = -val;
+         break;
+      default:
+         return -1;
+   };
+   *deg = val;
+   return 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// scanner
+
+enum scan_state {
+   SCAN_SEARCHING,   // looking for '$'
+   SCAN_ADDRESS,     // reading address field
+   SCAN_BODY,        // reading fields of a sentence that's used
+   SCAN_CHECKSUM_0,
+   SCAN_CHECKSUM_1,
+   SCAN_SKIPPING     // sentence isn't used. wait for next '$'
+};
+
+
+void nmea_scanner_init(
+      /*    out */       nmea_scanner_type *scanner
+      )
+{
+   memset(scanner, 0, sizeof *scanner);
+   scanner->state = SCAN_SEARCHING;
+}
+
+
+uint32_t nmea_scan(
+      /* in out */       nmea_scanner_type *scanner,
+      /* in     */ const uint8_t *data,
+      /* in     */ const uint32_t n,
+      /*    out */       const char **sentence
+      )
+{
+   *sentence = NULL;
+   uint32_t i;
+   for (i=0; i<n; i++) {
+      const char c = (char) data[i];
+      const uint8_t cls = char_class_[data[i]];
+      if (c == '$') {
+         // new sentence. if one was being read, it was truncated
+         if ((scanner->state != SCAN_SEARCHING) &&
+               (scanner->state != SCAN_SKIPPING)) {
+            scanner->stats.bad_format++;
+         }
+         scanner->sentence[0] = c;
+         scanner->len = 1;
+         scanner->checksum = 0;
+         scanner->state = SCAN_ADDRESS;
+         continue;
+      }
+      switch (scanner->state) {
+         case SCAN_SEARCHING:
+         case SCAN_SKIPPING:
+            break;
+         case SCAN_ADDRESS:
+            scanner->checksum ^= (uint8_t) c;
+            scanner->sentence[scanner->len++] = c;
+            if (scanner->len < 7) {
+               if ((cls & NMEA_CHAR_ADDRESS) == 0) {
+                  scanner->stats.bad_format++;
+                  scanner->state = SCAN_SEARCHING;
+               }
+            } else if (c != ',') {
+               scanner->stats.bad_format++;
+               scanner->state = SCAN_SEARCHING;
+            } else if (sentence_type(&scanner->sentence[1]) ==
+                  NMEA_IGNORED) {
+               scanner->stats.ignored++;
+               scanner->state = SCAN_SKIPPING;
+            } else {
+               scanner->state = SCAN_BODY;
+            }
+            break;
+         case SCAN_BODY:
+            if (c == '*') {
+               scanner->sentence[scanner->len++] = c;
+               scanner->state = SCAN_CHECKSUM_0;
+            } else if (((cls & NMEA_CHAR_FIELD) == 0) && (c != ',')) {
+               scanner->stats.bad_format++;
+               scanner->state = SCAN_SEARCHING;
+            } else if (scanner->len >= NMEA_MAX_SENTENCE - 3) {
+               // no room for checksum
+               scanner->stats.bad_format++;
+               scanner->state = SCAN_SEARCHING;
+            } else {
+               scanner->checksum ^= (uint8_t) c;
+               scanner->sentence[scanner->len++] = c;
+            }
+            break;
+         case SCAN_CHECKSUM_0:
+            if (cls & NMEA_CHAR_HEX) {
+               scanner->reported_checksum = (uint8_t) (dehex(c) << 4);
+               scanner->sentence[scanner->len++] = c;
+               scanner->state = SCAN_CHECKSUM_1;
+            } else {
+               scanner->stats.bad_format++;
+               scanner->state = SCAN_SEARCHING;
+            }
+            break;
+         case SCAN_CHECKSUM_1:
+            scanner->state = SCAN_SEARCHING;
+            if ((cls & NMEA_CHAR_HEX) == 0) {
+               scanner->stats.bad_format++;
+               break;
+            }
+            scanner->reported_checksum |= dehex(c);
+            if (scanner->reported_checksum != scanner->checksum) {
+               scanner->stats.bad_checksum++;
+               break;
+            }
+            scanner->sentence[scanner->len++] = c;
+            scanner->sentence[scanner->len] = 0;
+            scanner->stats.sentences++;
+            scanner->stats.bytes += i + 1;
+            *sentence = scanner->sentence;
+            return i + 1;
+         default:
+            scanner->state = SCAN_SEARCHING;
+      };
+   }
+   scanner->stats.bytes += n;
+   return n;
+}
+
+// scanner
+////////////////////////////////////////////////////////////////////////
+
+
+#if defined(TEST_NMEA)
+#include "timekeeper.h"
+
+// appends checksum to sentence that starts w/ '$'
+static void add_checksum(
+      /* in out */       char *sentence
+      )
+{
+   uint8_t checksum = 0;
+   for (uint32_t i=1; sentence[i]!=0; i++) {
+      checksum ^= (uint8_t) sentence[i];
+   }
+   sprintf(&sentence[strlen(sentence)], "*%02X", checksum);
+}
+
+
+static uint32_t check_value(
+      /* in     */ const char *label,
+      /* in     */ const double val,
+      /* in     */ const double expected
+      )
+{
+   if (fabs(val - expected) > 1.0e-7) {
+      fprintf(stderr, "%s is %.8f, expected %.8f\n", label, val, expected);
+      return 1;
+   }
+   return 0;
+}
+
+
+static uint32_t test_tokenize(void)
+{
+   uint32_t errs = 0;
+   nmea_stats_type stats;
+   memset(&stats, 0, sizeof stats);
+   nmea_fields_type fields;
+   char buf[NMEA_MAX_SENTENCE];
+   /////////////////////////////////////////////
+   // RMC
+   strcpy(buf, "$GPRMC,161229.487,A,3723.2475,N,12158.3416,W,0.13,"
+         "309.62,120598,,");
+   add_checksum(buf);
+   strcat(buf, "\r\n");
+   if (nmea_tokenize(buf, (uint32_t) strlen(buf), &fields, &stats) !=
+         NMEA_RMC) {
+      fprintf(stderr, "RMC not recognized\n");
+      errs++;
+   } else {
+      double val;
+      uint32_t date;
+      if (fields.num_fields != 12) {
+         fprintf(stderr, "RMC has %d fields, expected 12\n",
+               fields.num_fields);
+         errs++;
+      }
+      nmea_read_decimal(&fields, 1, &val);
+      errs += check_value("RMC time", val, 161229.487);
+      nmea_read_latlon(&fields, 3, &val);
+      errs += check_value("RMC lat", val, 37.0 + 23.2475 / 60.0);
+      nmea_read_latlon(&fields, 5, &val);
+      errs += check_value("RMC lon", val, -(121.0 + 58.3416 / 60.0));
+      nmea_read_decimal(&fields, 8, &val);
+      errs += check_value("RMC cog", val, 309.62);
+      if ((nmea_read_uint(&fields, 9, &date) != 0) || (date != 120598)) {
+         fprintf(stderr, "RMC date not read\n");
+         errs++;
+      }
+      if (nmea_read_decimal(&fields, 10, &val) != 1) {
+         fprintf(stderr, "Empty field not reported as empty\n");
+         errs++;
+      }
+      if (nmea_read_decimal(&fields, 20, &val) != 1) {
+         fprintf(stderr, "Missing field not reported as empty\n");
+         errs++;
+      }
+   }
+   /////////////////////////////////////////////
+   // GGA w/o fix, from multi-system receiver
+   strcpy(buf, "$GNGGA,002153.000,,,,,0,00,99.9,,M,,M,,");
+   add_checksum(buf);
+   if (nmea_tokenize(buf, (uint32_t) strlen(buf), &fields, &stats) !=
+         NMEA_GGA) {
+      fprintf(stderr, "GGA not recognized\n");
+      errs++;
+   } else {
+      double val;
+      if (nmea_read_latlon(&fields, 2, &val) != 1) {
+         fprintf(stderr, "Empty latitude not reported as empty\n");
+         errs++;
+      }
+   }
+   /////////////////////////////////////////////
+   // legacy forwarding (no '$' or checksum), as sent by older gps
+   //    processes
+   strcpy(buf, "GPGGA,161229.487,3723.2475,N,12158.3416,W,1,07,1.0,"
+         "9.0,M,,,,0000");
+   if (nmea_tokenize(buf, sizeof buf, &fields, &stats) != NMEA_GGA) {
+      fprintf(stderr, "Legacy GGA not recognized\n");
+      errs++;
+   }
+   /////////////////////////////////////////////
+   // errors
+   memset(&stats, 0, sizeof stats);
+   strcpy(buf, "$GPRMC,161229.487,A,3723.2475,N,12158.3416,W,0.13,"
+         "309.62,120598,,*11");
+   if ((nmea_tokenize(buf, (uint32_t) strlen(buf), &fields, &stats) != -1)
+         || (stats.bad_checksum != 1)) {
+      fprintf(stderr, "Bad checksum not detected\n");
+      errs++;
+   }
+   strcpy(buf, "$GPRMC,161229.487,A,3723.2475,N,12158.3416,W,0.13,"
+         "309.62,120598,,");
+   if ((nmea_tokenize(buf, (uint32_t) strlen(buf), &fields, &stats) != -1)
+         || (stats.bad_format != 1)) {
+      fprintf(stderr, "Missing checksum not detected\n");
+      errs++;
+   }
+   strcpy(buf, "$GPGGA,1612 29.487,3723.2475,N");
+   add_checksum(buf);
+   if ((nmea_tokenize(buf, (uint32_t) strlen(buf), &fields, &stats) != -1)
+         || (stats.bad_format != 2)) {
+      fprintf(stderr, "Invalid character not detected\n");
+      errs++;
+   }
+   strcpy(buf, "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,"
+         "13,06,292,00*74");
+   if ((nmea_tokenize(buf, (uint32_t) strlen(buf), &fields, &stats) !=
+         NMEA_IGNORED) || (stats.ignored != 1)) {
+      fprintf(stderr, "GSV not ignored\n");
+      errs++;
+   }
+   strcpy(buf, "$GPGGA,161229.487,37x3.2475,N,12158.3416,Q,1");
+   add_checksum(buf);
+   if (nmea_tokenize(buf, (uint32_t) strlen(buf), &fields, &stats) !=
+         NMEA_GGA) {
+      fprintf(stderr, "GGA w/ bad fields not tokenized\n");
+      errs++;
+   } else {
+      double val;
+      if ((nmea_read_latlon(&fields, 2, &val) != -1) ||
+            (nmea_read_latlon(&fields, 4, &val) != -1)) {
+         fprintf(stderr, "Malformed lat/lon not detected\n");
+         errs++;
+      }
+   }
+   return errs;
+}
+
+////////////////////////////////////////////////////////////////////////
+
+// synthetic log of the mix of sentences a receiver sends each fix,
+//    w/ occasional corruption
+static char * build_log(
+      /* in     */ const uint32_t num_fixes,
+      /*    out */       uint32_t *log_len,
+      /*    out */       uint32_t *num_wanted
+      )
+{
+   char *log = malloc((size_t) num_fixes * 6 * NMEA_MAX_SENTENCE);
+   uint32_t len = 0;
+   uint32_t wanted = 0;
+   uint32_t seed = 5;
+   char buf[NMEA_MAX_SENTENCE];
+   for (uint32_t i=0; i<num_fixes; i++) {
+      const double t = 161229.0 + 0.1 * (double) i;
+      seed = seed * 1103515245u + 12345u;
+      const double lat = 3723.2475 + (double) ((seed >> 16) % 1000) * 0.001;
+      const double lon = 12158.3416 + (double) ((seed >> 8) % 1000) * 0.001;
+      for (uint32_t j=0; j<6; j++) {
+         switch (j) {
+            case 0:
+               sprintf(buf, "$GNGGA,%.3f,%.4f,N,%.4f,W,1,07,1.0,9.0,M,"
+                     "-25.7,M,,", t, lat, lon);
+               wanted++;
+               break;
+            case 1:
+               sprintf(buf, "$GNRMC,%.3f,A,%.4f,N,%.4f,W,5.13,309.62,"
+                     "120598,,,A", t, lat, lon);
+               wanted++;
+               break;
+            case 2:
+               sprintf(buf, "$GNGSA,A,3,03,04,06,13,17,19,,,,,,,1.9,1.0,1.6");
+               break;
+            case 3:
+               sprintf(buf, "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,"
+                     "01,010,00,13,06,292,00");
+               break;
+            case 4:
+               sprintf(buf, "$GLGSV,2,1,07,65,24,041,28,66,62,338,32,72,"
+                     "38,101,29,73,21,213,26");
+               break;
+            case 5:
+               sprintf(buf, "$GNVTG,309.62,T,,M,5.13,N,9.50,K,A");
+               break;
+         };
+         add_checksum(buf);
+         // corrupt one sentence in 1000
+         if ((j < 2) && (((seed >> 4) % 1000) == 0)) {
+            buf[10] = (char) (buf[10] ^ 0x01);
+            wanted--;
+         }
+         len += (uint32_t) sprintf(&log[len], "%s\r\n", buf);
+      }
+   }
+   *log_len = len;
+   *num_wanted = wanted;
+   return log;
+}
+
+
+// reads log file. lines may be raw NMEA or "<time> <sentence>", as
+//    written by gps_receiver. older gps processes forwarded sentences
+//    w/o '$' and checksum. those are restored so log can be used as a
+//    serial stream
+static char * read_log(
+      /* in     */ const char *path,
+      /*    out */       uint32_t *log_len
+      )
+{
+   FILE *fp = fopen(path, "r");
+   if (!fp) {
+      fprintf(stderr, "Unable to open '%s'\n", path);
+      return NULL;
+   }
+   fseek(fp, 0, SEEK_END);
+   const size_t size = (size_t) ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+   // each line grows by at most 4 chars ('$', checksum)
+   char *log = malloc(2 * size + 16);
+   char line[1024];
+   uint32_t len = 0;
+   while (fgets(line, sizeof line, fp) != NULL) {
+      line[strcspn(line, "\r\n")] = 0;
+      char *sentence = strchr(line, '$');
+      if (sentence == NULL) {
+         char *space = strchr(line, ' ');
+         if ((space == NULL) || (strlen(space + 1) + 5 >= NMEA_MAX_SENTENCE)) {
+            continue;
+         }
+         // restore '$' and checksum
+         sentence = space;
+         sentence[0] = '$';
+         add_checksum(sentence);
+      }
+      len += (uint32_t) sprintf(&log[len], "%s\n", sentence);
+      if (len > 2 * size) {
+         break;
+      }
+   }
+   fclose(fp);
+   *log_len = len;
+   return log;
+}
+
+
+// parses sentence as gps_receiver does: position, time and, for RMC,
+//    sog, cog and date. returns number of fields read
+static uint32_t read_fields(
+      /* in     */ const nmea_fields_type *fields,
+      /* in out */       double *sum
+      )
+{
+   double val;
+   uint32_t date;
+   uint32_t n = 0;
+   const uint32_t pos = fields->type == NMEA_RMC ? 3 : 2;
+   if (nmea_read_decimal(fields, 1, &val) == 0) { *sum += val; n++; }
+   if (nmea_read_latlon(fields, pos, &val) == 0) { *sum += val; n++; }
+   if (nmea_read_latlon(fields, pos + 2, &val) == 0) { *sum += val; n++; }
+   if (fields->type == NMEA_RMC) {
+      if (nmea_read_decimal(fields, 7, &val) == 0) { *sum += val; n++; }
+      if (nmea_read_decimal(fields, 8, &val) == 0) { *sum += val; n++; }
+      if (nmea_read_uint(fields, 9, &date) == 0) { *sum += date; n++; }
+   }
+   return n;
+}
+
+
+// string-copy, tokenize and strtod, checksumming separately, as
+//    parsing was done before. for comparison
+static uint32_t reference_parse(
+      /* in     */ const char *sentence,
+      /* in     */ const uint32_t len,
+      /* in out */       double *sum
+      )
+{
+   char copy[NMEA_MAX_SENTENCE + 1];
+   if (len > NMEA_MAX_SENTENCE) {
+      return 0;
+   }
+   memcpy(copy, sentence, len);
+   copy[len] = 0;
+   char *star = strchr(copy, '*');
+   if ((copy[0] != '$') || (star == NULL)) {
+      return 0;
+   }
+   uint8_t checksum = 0;
+   for (char *c=&copy[1]; c<star; c++) {
+      checksum ^= (uint8_t) *c;
+   }
+   if (checksum != (uint8_t) strtol(star + 1, NULL, 16)) {
+      return 0;
+   }
+   *star = 0;
+   if ((strncmp(&copy[3], "GGA,", 4) != 0) &&
+         (strncmp(&copy[3], "RMC,", 4) != 0)) {
+      return 0;
+   }
+   uint32_t n = 0;
+   char *save_ptr = NULL;
+   char *tok = strtok_r(copy, ",", &save_ptr);
+   while ((tok = strtok_r(NULL, ",", &save_ptr)) != NULL) {
+      char *endptr;
+      const double val = strtod(tok, &endptr);
+      if (endptr != tok) {
+         *sum += val;
+         n++;
+      }
+   }
+   return n;
+}
+
+
+static uint32_t run_benchmark(
+      /* in     */ const char *log,
+      /* in     */ const uint32_t log_len,
+      /* in     */ const int64_t expected
+      )
+{
+   uint32_t errs = 0;
+   const uint32_t iterations = 10;
+   double sum = 0.0;
+   /////////////////////////////////////////////
+   // scanner, as used by gps process
+   nmea_scanner_type scanner;
+   nmea_scanner_init(&scanner);
+   double t0 = system_now();
+   for (uint32_t iter=0; iter<iterations; iter++) {
+      uint32_t pos = 0;
+      while (pos < log_len) {
+         const char *sentence;
+         pos += nmea_scan(&scanner, (const uint8_t*) &log[pos],
+               log_len - pos, &sentence);
+         if (sentence) {
+            sum += (double) scanner.len;
+         }
+      }
+   }
+   const double scan_sec = (system_now() - t0) / iterations;
+   const uint64_t scanned = scanner.stats.sentences / iterations;
+   /////////////////////////////////////////////
+   // tokenizer and field readers, as used by gps_receiver
+   nmea_stats_type stats;
+   memset(&stats, 0, sizeof stats);
+   nmea_fields_type fields;
+   uint64_t num_lines = 0;
+   uint64_t num_fields = 0;
+   t0 = system_now();
+   for (uint32_t iter=0; iter<iterations; iter++) {
+      const char *line = log;
+      const char *end = log + log_len;
+      while (line < end) {
+         const char *eol = memchr(line, '\n', (size_t) (end - line));
+         if (eol == NULL) {
+            eol = end;
+         }
+         const int32_t type = nmea_tokenize(line, (uint32_t) (eol - line),
+               &fields, &stats);
+         if ((type >= 0) && (type < NMEA_NUM_TYPES)) {
+            num_fields += read_fields(&fields, &sum);
+         }
+         num_lines++;
+         line = eol + 1;
+      }
+   }
+   const double tok_sec = (system_now() - t0) / iterations;
+   const uint64_t tokenized = stats.sentences / iterations;
+   /////////////////////////////////////////////
+   // reference
+   uint64_t ref_fields = 0;
+   t0 = system_now();
+   for (uint32_t iter=0; iter<iterations; iter++) {
+      const char *line = log;
+      const char *end = log + log_len;
+      while (line < end) {
+         const char *eol = memchr(line, '\n', (size_t) (end - line));
+         if (eol == NULL) {
+            eol = end;
+         }
+         ref_fields += reference_parse(line, (uint32_t) (eol - line), &sum);
+         line = eol + 1;
+      }
+   }
+   const double ref_sec = (system_now() - t0) / iterations;
+   /////////////////////////////////////////////
+   num_lines /= iterations;
+   const double mb = (double) log_len / (1024.0 * 1024.0);
+   printf("  %ld sentences, %.2f MB. %ld GGA/RMC accepted, %ld bad checksum\n",
+         num_lines, mb, tokenized, stats.bad_checksum / iterations);
+   printf("  scanner            %7.2f ms  %7.1f MB/s  %10.0f sentences/s\n",
+         1000.0 * scan_sec, mb / scan_sec, (double) num_lines / scan_sec);
+   printf("  tokenize + fields  %7.2f ms  %7.1f MB/s  %10.0f sentences/s\n",
+         1000.0 * tok_sec, mb / tok_sec, (double) num_lines / tok_sec);
+   printf("  copy+strtok+strtod %7.2f ms  %7.1f MB/s  %10.0f sentences/s\n",
+         1000.0 * ref_sec, mb / ref_sec, (double) num_lines / ref_sec);
+   // a 20Hz receiver sending ~6 sentences per fix needs 120 sentences/s
+   printf("  tokenizer headroom at 20 Hz: %.0fx\n",
+         (double) num_lines / tok_sec / 120.0);
+   if (scanned != tokenized) {
+      fprintf(stderr, "Scanner found %ld sentences, tokenizer %ld\n",
+            scanned, tokenized);
+      errs++;
+   }
+   if ((expected >= 0) && (tokenized != (uint64_t) expected)) {
+      fprintf(stderr, "Tokenizer found %ld sentences, expected %ld\n",
+            tokenized, expected);
+      errs++;
+   }
+   if (sum == 0.0) {
+      errs++;  // keep parsing from being optimized away
+   }
+   return errs;
+}
+
+
+// feeds stream to scanner in chunks of all sizes to make sure sentences
+//    that span reads are handled
+static uint32_t test_scanner(
+      /* in     */ const char *log,
+      /* in     */ const uint32_t log_len,
+      /* in     */ const uint32_t expected
+      )
+{
+   uint32_t errs = 0;
+   for (uint32_t chunk=1; chunk<=64; chunk++) {
+      nmea_scanner_type scanner;
+      nmea_scanner_init(&scanner);
+      uint32_t found = 0;
+      uint32_t pos = 0;
+      while (pos < log_len) {
+         const uint32_t end = pos + chunk < log_len ? pos + chunk : log_len;
+         while (pos < end) {
+            const char *sentence;
+            pos += nmea_scan(&scanner, (const uint8_t*) &log[pos],
+                  end - pos, &sentence);
+            if (sentence) {
+               if (sentence[scanner.len - 3] != '*') {
+                  fprintf(stderr, "Scanned sentence '%s' malformed\n",
+                        sentence);
+                  errs++;
+               }
+               found++;
+            }
+         }
+      }
+      if (found != expected) {
+         fprintf(stderr, "Chunk size %d: %d sentences found, expected %d\n",
+               chunk, found, expected);
+         errs++;
+         break;
+      }
+   }
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   uint32_t errs = 0;
+   errs += test_tokenize();
+   /////////////////////////////////////////////
+   uint32_t log_len;
+   uint32_t wanted;
+   char *log = build_log(100, &log_len, &wanted);
+   errs += test_scanner(log, log_len, wanted);
+   free(log);
+   /////////////////////////////////////////////
+   // benchmark. use recorded log if provided
+   if (argc > 1) {
+      printf("Parsing '%s'\n", argv[1]);
+      log = read_log(argv[1], &log_len);
+      if (log == NULL) {
+         errs++;
+      } else {
+         errs += run_benchmark(log, log_len, -1);
+         free(log);
+      }
+   } else {
+      printf("Parsing synthetic log (pass recorded NMEA log as argument "
+            "to use that instead)\n");
+      log = build_log(50000, &log_len, &wanted);
+      errs += run_benchmark(log, log_len, wanted);
+      free(log);
+   }
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
+#endif   // TEST_NMEA
@@ -0,0 +1,707 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "pan_log.h"
+#include "timekeeper.h"
+
+// frame blocks and the index are padded to this boundary so that
+//    doubles in headers can be read in place from the mmap'd file
+//    (unaligned double access faults on some ARM configurations)
+#define PAN_LOG_ALIGN      8u
+
+// max length of a literal or repeat run in the rle stream
+#define RLE_MAX_LITERAL    128u
+#define RLE_MIN_REPEAT     3u
+#define RLE_MAX_REPEAT     (RLE_MIN_REPEAT + 127u)
+
+// size of per-plane header in frame payload (encoding + size)
+#define PLANE_HEADER_BYTES    (1u + sizeof(uint32_t))
+
+////////////////////////////////////////////////////////////////////////
+// run-length encoding
+// control byte c
+//    c < 128     c+1 literal bytes follow
+//    c >= 128    next byte is repeated (c - 128 + RLE_MIN_REPEAT) times
+
+// returns number of bytes written to dest. dest must have space for
+//    n + n/RLE_MAX_LITERAL + 1 bytes
+static size_t rle_encode(
+      /* in     */ const uint8_t *src,
+      /* in     */ const size_t n,
+      /*    out */       uint8_t *dest
+      )
+{
+   size_t in = 0;
+   size_t out = 0;
+   while (in < n) {
+      const uint8_t val = src[in];
+      size_t run = 1;
+      while ((in + run < n) && (run < RLE_MAX_REPEAT) &&
+            (src[in + run] == val)) {
+         run++;
+      }
+      if (run >= RLE_MIN_REPEAT) {
+         dest[out++] = (uint8_t) (128u + run - RLE_MIN_REPEAT);
+         dest[out++] = val;
+         in += run;
+      } else {
+         // literal. extend until a repeat run starts
+         const size_t start = in;
+         size_t len = 0;
+         while ((in < n) && (len < RLE_MAX_LITERAL)) {
+            if ((in + 2 < n) && (src[in] == src[in+1]) &&
+                  (src[in] == src[in+2])) {
+               break;
+            }
+            in++;
+            len++;
+         }
+         dest[out++] = (uint8_t) (len - 1);
+         memcpy(&dest[out], &src[start], len);
+         out += len;
+      }
+   }
+   return out;
+}
+
+
+// returns 0 on success, -1 if stream is malformed
+static int32_t rle_decode(
+      /* in     */ const uint8_t *src,
+      /* in     */ const size_t n_src,
+      /*    out */       uint8_t *dest,
+      /* in     */ const size_t n_dest
+      )
+{
+   size_t in = 0;
+   size_t out = 0;
+   while (in < n_src) {
+      const uint8_t c = src[in++];
+      if (c < 128u) {
+         const size_t len = (size_t) c + 1u;
+         if ((in + len > n_src) || (out + len > n_dest)) {
+            return -1;
+         }
+         memcpy(&dest[out], &src[in], len);
+         in += len;
+         out += len;
+      } else {
+         const size_t len = (size_t) c - 128u + RLE_MIN_REPEAT;
+         if ((in >= n_src) || (out + len > n_dest)) {
+            return -1;
+         }
+         memset(&dest[out], src[in++], len);
+         out += len;
+      }
+   }
+   return (out == n_dest) ? 0 : -1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// writer
+
+pan_log_writer_type * pan_log_open_writer(
+      /* in     */ const char *path,
+      /* in     */ const image_size_type size
+      )
+{
+   pan_log_writer_type *writer = NULL;
+   FILE *fp = fopen(path, "wb");
+   if (fp == NULL) {
+      fprintf(stderr, "Unable to create panorama log '%s': %s\n", path,
+            strerror(errno));
+      goto end;
+   }
+   const pan_log_file_header_type header = {
+      .magic = PAN_LOG_MAGIC,
+      .version = PAN_LOG_VERSION,
+      .width = size.width,
+      .height = size.height,
+      .reserved = 0
+   };
+   if (fwrite(&header, sizeof header, 1, fp) != 1) {
+      fprintf(stderr, "Unable to write panorama log header to '%s'\n", path);
+      fclose(fp);
+      goto end;
+   }
+   writer = calloc(1, sizeof *writer);
+   writer->fp = fp;
+   writer->size = size;
+   writer->offset = sizeof header;
+   // worst case for all planes, plus headers and padding
+   const size_t n_pix = (size_t) (size.width * size.height);
+   writer->buf_size = PAN_LOG_NUM_PLANES *
+         (PLANE_HEADER_BYTES + n_pix + n_pix / RLE_MAX_LITERAL + 1) +
+         PAN_LOG_ALIGN;
+   writer->buf = malloc(writer->buf_size);
+   writer->index_capacity = 256;
+   writer->index = malloc(writer->index_capacity * sizeof *writer->index);
+end:
+   return writer;
+}
+
+
+// encodes plane to dest, with plane header. returns bytes written
+static size_t encode_plane(
+      /* in     */ const uint8_t *plane,
+      /* in     */ const uint8_t *plane_0,
+      /* in     */ const size_t n_pix,
+      /*    out */       uint8_t *dest
+      )
+{
+   uint8_t enc;
+   uint32_t bytes;
+   if ((plane_0 != NULL) && (plane == plane_0)) {
+      enc = PAN_LOG_PLANE_COPY_0;
+      bytes = 0;
+   } else {
+      bytes = (uint32_t) rle_encode(plane, n_pix,
+            &dest[PLANE_HEADER_BYTES]);
+      enc = PAN_LOG_PLANE_RLE;
+      if (bytes >= n_pix) {
+         // incompressible. store raw
+         enc = PAN_LOG_PLANE_RAW;
+         bytes = (uint32_t) n_pix;
+         memcpy(&dest[PLANE_HEADER_BYTES], plane, n_pix);
+      }
+   }
+   dest[0] = enc;
+   memcpy(&dest[1], &bytes, sizeof bytes);
+   return PLANE_HEADER_BYTES + bytes;
+}
+
+
+int32_t pan_log_write_frame(
+      /* in out */       pan_log_writer_type *writer,
+      /* in     */ const double t,
+      /* in     */ const uint8_t *r,
+      /* in     */ const uint8_t *g,
+      /* in     */ const uint8_t *b
+      )
+{
+   int32_t rc = -1;
+   const double t0 = system_now();
+   const size_t n_pix = (size_t) (writer->size.width * writer->size.height);
+   size_t len = 0;
+   len += encode_plane(r, NULL, n_pix, &writer->buf[len]);
+   len += encode_plane(g, r, n_pix, &writer->buf[len]);
+   len += encode_plane(b, r, n_pix, &writer->buf[len]);
+   // pad so next frame header is aligned
+   const size_t header_bytes = sizeof(pan_log_frame_header_type);
+   while (((header_bytes + len) % PAN_LOG_ALIGN) != 0) {
+      writer->buf[len++] = 0;
+   }
+   const pan_log_frame_header_type header = {
+      .magic = PAN_LOG_FRAME_MAGIC,
+      .payload_bytes = (uint32_t) len,
+      .t = t
+   };
+   if ((fwrite(&header, sizeof header, 1, writer->fp) != 1) ||
+         (fwrite(writer->buf, len, 1, writer->fp) != 1)) {
+      fprintf(stderr, "Error writing panorama log frame: %s\n",
+            strerror(errno));
+      goto end;
+   }
+   // update index
+   if (writer->num_frames >= writer->index_capacity) {
+      writer->index_capacity *= 2;
+      writer->index = realloc(writer->index,
+            writer->index_capacity * sizeof *writer->index);
+   }
+   pan_log_index_entry_type *entry = &writer->index[writer->num_frames++];
+   entry->t = t;
+   entry->offset = writer->offset;
+   writer->offset += sizeof header + len;
+   writer->raw_bytes += PAN_LOG_NUM_PLANES * n_pix;
+   writer->written_bytes += sizeof header + len;
+   rc = 0;
+end:
+   writer->write_sec += system_now() - t0;
+   return rc;
+}
+
+
+void pan_log_close_writer(
+      /* in out */       pan_log_writer_type *writer
+      )
+{
+   if (writer == NULL) {
+      return;
+   }
+   // frame blocks are aligned so offset is aligned for index too
+   const pan_log_file_footer_type footer = {
+      .index_offset = writer->offset,
+      .num_frames = writer->num_frames,
+      .magic = PAN_LOG_INDEX_MAGIC
+   };
+   if ((writer->num_frames > 0) && (fwrite(writer->index,
+         writer->num_frames * sizeof *writer->index, 1, writer->fp) != 1)) {
+      fprintf(stderr, "Error writing panorama log index\n");
+   } else if (fwrite(&footer, sizeof footer, 1, writer->fp) != 1) {
+      fprintf(stderr, "Error writing panorama log footer\n");
+   }
+   fclose(writer->fp);
+   free(writer->buf);
+   free(writer->index);
+   free(writer);
+}
+
+////////////////////////////////////////////////////////////////////////
+// reader
+
+// walks frame headers to build index when log wasn't closed cleanly
+static void scan_frames(
+      /* in out */       pan_log_reader_type *reader
+      )
+{
+   uint32_t capacity = 256;
+   pan_log_index_entry_type *index = malloc(capacity * sizeof *index);
+   uint32_t n = 0;
+   size_t offset = sizeof(pan_log_file_header_type);
+   while (offset + sizeof(pan_log_frame_header_type) <= reader->map_size) {
+      const pan_log_frame_header_type *header =
+            (const pan_log_frame_header_type*) &reader->map[offset];
+      const size_t block = sizeof *header + header->payload_bytes;
+      if ((header->magic != PAN_LOG_FRAME_MAGIC) ||
+            (offset + block > reader->map_size)) {
+         break;
+      }
+      if (n >= capacity) {
+         capacity *= 2;
+         index = realloc(index, capacity * sizeof *index);
+      }
+      index[n].t = header->t;
+      index[n].offset = offset;
+      n++;
+      offset += block;
+   }
+   reader->scanned_index_ = index;
+   reader->index = index;
+   reader->num_frames = n;
+}
+
+
+pan_log_reader_type * pan_log_open_reader(
+      /* in     */ const char *path
+      )
+{
+   pan_log_reader_type *reader = NULL;
+   int fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      goto end;
+   }
+   struct stat st;
+   if ((fstat(fd, &st) != 0) ||
+         ((size_t) st.st_size < sizeof(pan_log_file_header_type))) {
+      fprintf(stderr, "Panorama log '%s' is empty or unreadable\n", path);
+      goto end;
+   }
+   const size_t map_size = (size_t) st.st_size;
+   void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == MAP_FAILED) {
+      fprintf(stderr, "Unable to map panorama log '%s': %s\n", path,
+            strerror(errno));
+      goto end;
+   }
+   const pan_log_file_header_type *header =
+         (const pan_log_file_header_type*) map;
+   if ((header->magic != PAN_LOG_MAGIC) ||
+         (header->version != PAN_LOG_VERSION)) {
+      fprintf(stderr, "'%s' is not a panorama log (or has unsupported "
+            "version)\n", path);
+      munmap(map, map_size);
+      goto end;
+   }
+   reader = calloc(1, sizeof *reader);
+   reader->map = map;
+   reader->map_size = map_size;
+   reader->size.width = header->width;
+   reader->size.height = header->height;
+   // use index if it's present and consistent
+   uint32_t have_index = 0;
+   if (map_size >= sizeof *header + sizeof(pan_log_file_footer_type)) {
+      const pan_log_file_footer_type *footer =
+            (const pan_log_file_footer_type*)
+            &reader->map[map_size - sizeof *footer];
+      const size_t index_bytes =
+            footer->num_frames * sizeof(pan_log_index_entry_type);
+      if ((footer->magic == PAN_LOG_INDEX_MAGIC) &&
+            ((footer->index_offset % PAN_LOG_ALIGN) == 0) &&
+            (footer->index_offset + index_bytes + sizeof *footer ==
+                  map_size)) {
+         reader->index = (const pan_log_index_entry_type*)
+               &reader->map[footer->index_offset];
+         reader->num_frames = footer->num_frames;
+         have_index = 1;
+      }
+   }
+   if (have_index == 0) {
+      fprintf(stderr, "Panorama log '%s' has no index. Rebuilding\n", path);
+      scan_frames(reader);
+   }
+end:
+   if (fd >= 0) {
+      close(fd);
+   }
+   return reader;
+}
+
+
+void pan_log_close_reader(
+      /* in out */       pan_log_reader_type *reader
+      )
+{
+   if (reader == NULL) {
+      return;
+   }
+   munmap(reader->map, reader->map_size);
+   free(reader->scanned_index_);
+   free(reader);
+}
+
+
+int32_t pan_log_find_nearest(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const double t
+      )
+{
+   if (reader->num_frames == 0) {
+      return -1;
+   }
+   // find first frame at or after t
+   uint32_t lo = 0;
+   uint32_t hi = reader->num_frames;
+   while (lo < hi) {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      if (reader->index[mid].t < t) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   if (lo == reader->num_frames) {
+      return (int32_t) (lo - 1);
+   }
+   if ((lo > 0) &&
+         ((t - reader->index[lo-1].t) <= (reader->index[lo].t - t))) {
+      return (int32_t) (lo - 1);
+   }
+   return (int32_t) lo;
+}
+
+
+double pan_log_frame_time(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const uint32_t idx
+      )
+{
+   return reader->index[idx].t;
+}
+
+
+int32_t pan_log_read_frame(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const uint32_t idx,
+      /*    out */       uint8_t *r,
+      /*    out */       uint8_t *g,
+      /*    out */       uint8_t *b
+      )
+{
+   if (idx >= reader->num_frames) {
+      return -1;
+   }
+   const size_t n_pix = (size_t) (reader->size.width * reader->size.height);
+   const uint64_t offset = reader->index[idx].offset;
+   const pan_log_frame_header_type *header =
+         (const pan_log_frame_header_type*) &reader->map[offset];
+   if ((header->magic != PAN_LOG_FRAME_MAGIC) || (offset + sizeof *header +
+         header->payload_bytes > reader->map_size)) {
+      return -1;
+   }
+   const uint8_t *payload = &reader->map[offset + sizeof *header];
+   const size_t end = header->payload_bytes;
+   size_t pos = 0;
+   uint8_t *planes[PAN_LOG_NUM_PLANES] = { r, g, b };
+   for (uint32_t i=0; i<PAN_LOG_NUM_PLANES; i++) {
+      if (pos + PLANE_HEADER_BYTES > end) {
+         return -1;
+      }
+      const uint8_t enc = payload[pos];
+      uint32_t bytes;
+      memcpy(&bytes, &payload[pos+1], sizeof bytes);
+      pos += PLANE_HEADER_BYTES;
+      if (pos + bytes > end) {
+         return -1;
+      }
+      switch (enc) {
+         case PAN_LOG_PLANE_RLE:
+            if (rle_decode(&payload[pos], bytes, planes[i], n_pix) != 0) {
+               return -1;
+            }
+            break;
+         case PAN_LOG_PLANE_RAW:
+            if (bytes != n_pix) {
+               return -1;
+            }
+            memcpy(planes[i], &payload[pos], n_pix);
+            break;
+         case PAN_LOG_PLANE_COPY_0:
+            if (i == 0) {
+               return -1;
+            }
+            if (planes[i] != planes[0]) {
+               memcpy(planes[i], planes[0], n_pix);
+            }
+            break;
+         default:
+            return -1;
+      };
+      pos += bytes;
+   }
+   return 0;
+}
+
+
+int32_t pan_log_read_image(
+      /* in     */ const pan_log_reader_type *reader,
+      /* in     */ const uint32_t idx,
+      /*    out */       image_type *img
+      )
+{
+   int32_t rc = -1;
+   if (img->size.all != reader->size.all) {
+      fprintf(stderr, "Image size doesn't match panorama log\n");
+      return -1;
+   }
+   const size_t n_pix = (size_t) (reader->size.width * reader->size.height);
+   uint8_t *buf = malloc(PAN_LOG_NUM_PLANES * n_pix);
+   uint8_t *r = buf;
+   uint8_t *g = &buf[n_pix];
+   uint8_t *b = &buf[2 * n_pix];
+   if (pan_log_read_frame(reader, idx, r, g, b) != 0) {
+      goto end;
+   }
+   for (size_t i=0; i<n_pix; i++) {
+      img->rgb[i].r = r[i];
+      img->rgb[i].g = g[i];
+      img->rgb[i].b = b[i];
+      img->gray[i] = (uint8_t) (0.3*r[i] + 0.5*g[i] + 0.2*g[i] + 0.5/255.0);
+   }
+   rc = 0;
+end:
+   free(buf);
+   return rc;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+#if defined(PAN_LOG_TEST)
+
+#define TEST_WIDTH      3600
+#define TEST_HEIGHT     600
+#define TEST_FRAMES     20
+#define TEST_LOG        "/tmp/_test_pan_log.bin"
+#define TEST_PNM        "/tmp/_test_pan_log.pnm"
+
+// gray panorama with image content over part of the horizon. content
+//    shifts with each frame
+static void make_frame(
+      /* in     */ const uint32_t frame,
+      /*    out */       uint8_t *plane
+      )
+{
+   uint32_t seed = frame + 1;
+   memset(plane, 0, TEST_WIDTH * TEST_HEIGHT);
+   for (uint32_t y=100; y<500; y++) {
+      for (uint32_t x=0; x<2400; x++) {
+         seed = seed * 1103515245u + 12345u;
+         uint32_t col = (x + 37 * frame) % TEST_WIDTH;
+         plane[col + y * TEST_WIDTH] = (uint8_t) (64 + (y & 63) +
+               ((seed >> 16) & 15));
+      }
+   }
+}
+
+
+// same write path as panorama's write_panorama_image()
+static double write_pnm(
+      /* in     */ const uint8_t *plane
+      )
+{
+   const double t0 = system_now();
+   uint8_t line[3 * TEST_WIDTH];
+   FILE *fp = fopen(TEST_PNM, "w");
+   fprintf(fp, "P6\n%d %d\n255\n", TEST_WIDTH, TEST_HEIGHT);
+   for (uint32_t y=0; y<TEST_HEIGHT; y++) {
+      for (uint32_t x=0; x<TEST_WIDTH; x++) {
+         const uint8_t val = plane[x + y * TEST_WIDTH];
+         line[3*x] = val;
+         line[3*x+1] = val;
+         line[3*x+2] = val;
+      }
+      fwrite(line, sizeof line, 1, fp);
+   }
+   fclose(fp);
+   return system_now() - t0;
+}
+
+
+static uint32_t test_round_trip(void)
+{
+   uint32_t errs = 0;
+   printf("Testing write and read of panorama log\n");
+   const size_t n_pix = TEST_WIDTH * TEST_HEIGHT;
+   uint8_t *plane = malloc(n_pix);
+   uint8_t *r = malloc(n_pix);
+   uint8_t *g = malloc(n_pix);
+   uint8_t *b = malloc(n_pix);
+   const image_size_type size = { .width=TEST_WIDTH, .height=TEST_HEIGHT };
+   pan_log_writer_type *writer = pan_log_open_writer(TEST_LOG, size);
+   if (writer == NULL) {
+      printf("  Failed to create log\n");
+      errs++;
+      goto end;
+   }
+   double pnm_sec = 0.0;
+   for (uint32_t i=0; i<TEST_FRAMES; i++) {
+      make_frame(i, plane);
+      pnm_sec += write_pnm(plane);
+      pan_log_write_frame(writer, 100.0 + 0.2 * i, plane, plane, plane);
+   }
+   printf("  pnm write      %.3f ms/frame\n", 1000.0 * pnm_sec / TEST_FRAMES);
+   printf("  pan_log write  %.3f ms/frame (%.1f%% of raw size)\n",
+         1000.0 * writer->write_sec / TEST_FRAMES,
+         100.0 * (double) writer->written_bytes / (double) writer->raw_bytes);
+   if (writer->write_sec > pnm_sec) {
+      printf("  Log write is slower than raw write\n");
+      errs++;
+   }
+   pan_log_close_writer(writer);
+   //
+   pan_log_reader_type *reader = pan_log_open_reader(TEST_LOG);
+   if ((reader == NULL) || (reader->num_frames != TEST_FRAMES) ||
+         (reader->scanned_index_ != NULL)) {
+      printf("  Failed to open log with index\n");
+      errs++;
+      goto end;
+   }
+   for (uint32_t i=0; i<TEST_FRAMES; i++) {
+      make_frame(i, plane);
+      if ((pan_log_read_frame(reader, i, r, g, b) != 0) ||
+            (memcmp(plane, r, n_pix) != 0) || (memcmp(plane, g, n_pix) != 0) ||
+            (memcmp(plane, b, n_pix) != 0)) {
+         printf("  Frame %d doesn't match\n", i);
+         errs++;
+      }
+   }
+   if ((pan_log_find_nearest(reader, 0.0) != 0) ||
+         (pan_log_find_nearest(reader, 100.29) != 1) ||
+         (pan_log_find_nearest(reader, 100.31) != 2) ||
+         (pan_log_find_nearest(reader, 1000.0) != TEST_FRAMES-1)) {
+      printf("  Nearest-time lookup failed\n");
+      errs++;
+   }
+   pan_log_close_reader(reader);
+   if (errs == 0) {
+      printf("    passed\n");
+   } else {
+      printf("    %d errors\n", errs);
+   }
+end:
+   free(plane);
+   free(r);
+   free(g);
+   free(b);
+   return errs;
+}
+
+
+// log that isn't closed has no index. make sure reader recovers frames
+static uint32_t test_missing_index(void)
+{
+   uint32_t errs = 0;
+   printf("Testing panorama log without index\n");
+   const size_t n_pix = TEST_WIDTH * TEST_HEIGHT;
+   uint8_t *plane = malloc(n_pix);
+   uint8_t *r = malloc(n_pix);
+   const image_size_type size = { .width=TEST_WIDTH, .height=TEST_HEIGHT };
+   pan_log_writer_type *writer = pan_log_open_writer(TEST_LOG, size);
+   for (uint32_t i=0; i<3; i++) {
+      make_frame(i, plane);
+      pan_log_write_frame(writer, 10.0 + i, plane, plane, plane);
+   }
+   // simulate crash
+   fclose(writer->fp);
+   pan_log_reader_type *reader = pan_log_open_reader(TEST_LOG);
+   if ((reader == NULL) || (reader->num_frames != 3)) {
+      printf("  Failed to rebuild index\n");
+      errs++;
+   } else {
+      if ((pan_log_find_nearest(reader, 11.4) != 1) ||
+            (pan_log_read_frame(reader, 2, r, r, r) != 0) ||
+            (memcmp(r, plane, n_pix) != 0)) {
+         printf("  Failed to read from rebuilt index\n");
+         errs++;
+      }
+   }
+   pan_log_close_reader(reader);
+   free(writer->buf);
+   free(writer->index);
+   free(writer);
+   free(plane);
+   free(r);
+   unlink(TEST_LOG);
+   unlink(TEST_PNM);
+   if (errs == 0) {
+      printf("    passed\n");
+   } else {
+      printf("    %d errors\n", errs);
+   }
+   return errs;
+}
+
+
+int main(int argc, char** argv) {
+   (void) argc;
+   uint32_t errs = 0;
+   errs += test_round_trip();
+   errs += test_missing_index();
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
+#endif   // PAN_LOG_TEST
@@ -576,6 +576,129 @@ int send_block(int sockfd, const void *data, uint32_t len)
    return (int) bytes_written;
 }
 
+// advances iov past n bytes. returns index of first entry that still
+//    has data to move
+static uint32_t advance_iov(
+      /* in out */       struct iovec *iov,
+      /* in     */ const uint32_t iov_cnt,
+      /* in     */       uint32_t first,
+      /* in     */       size_t n
+      )
+{
+   while (first < iov_cnt) {
+      if (n < iov[first].iov_len) {
+         iov[first].iov_base = &((char*) iov[first].iov_base)[n];
+         iov[first].iov_len -= n;
+         break;
+      }
+      n -= iov[first].iov_len;
+      first++;
+   }
+   return first;
+}
+
+static size_t iov_bytes(
+      /* in     */ const struct iovec *iov,
+      /* in     */ const uint32_t iov_cnt
+      )
+{
+   size_t len = 0;
+   for (uint32_t i=0; i<iov_cnt; i++) {
+      len += iov[i].iov_len;
+   }
+   return len;
+}
+
+int recv_blockv(int sockfd, struct iovec *iov, uint32_t iov_cnt,
+      uint64_t *num_calls)
+{
+   size_t bytes_read = 0;
+   const size_t len = iov_bytes(iov, iov_cnt);
+   uint32_t first = advance_iov(iov, iov_cnt, 0, 0);
+   while (first < iov_cnt) {
+      ssize_t n = readv(sockfd, &iov[first], (int) (iov_cnt - first));
+      if (num_calls) {
+         (*num_calls)++;
+      }
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         log_info_type *log = get_kernel_log();
+         log_err(log, "Socket read error: %s", strerror(errno));
+         return -1;
+      } else if (n == 0) {
+         log_info_type *log = get_kernel_log();
+         log_err(log, "Failure reading socket data. Aborting");
+         return -1;
+      }
+      bytes_read += (size_t) n;
+      first = advance_iov(iov, iov_cnt, first, (size_t) n);
+   }
+   assert(bytes_read == len);
+   return (int) bytes_read;
+}
+
+int send_blockv(int sockfd, struct iovec *iov, uint32_t iov_cnt,
+      uint64_t *num_calls)
+{
+   size_t bytes_written = 0;
+   const size_t len = iov_bytes(iov, iov_cnt);
+   uint32_t first = advance_iov(iov, iov_cnt, 0, 0);
+   while (first < iov_cnt) {
+      ssize_t n = writev(sockfd, &iov[first], (int) (iov_cnt - first));
+      if (num_calls) {
+         (*num_calls)++;
+      }
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         log_info_type *log = get_kernel_log();
+         log_err(log, "Socket write error: %s", strerror(errno));
+         return -1;
+      } else if (n == 0) {
+         log_info_type *log = get_kernel_log();
+         log_err(log, "Failure sending socket data. Aborting");
+         return -1;
+      }
+      bytes_written += (size_t) n;
+      first = advance_iov(iov, iov_cnt, first, (size_t) n);
+   }
+   assert(bytes_written == len);
+   return (int) bytes_written;
+}
+
+static void pack_header_time(
+      /* in     */ const double t,
+      /*    out */       uint32_t ns[2]
+      )
+{
+   const uint64_t val = (uint64_t) llrint(t * 1.0e9);
+   ns[0] = htonl((uint32_t) (val >> 32));
+   ns[1] = htonl((uint32_t) val);
+}
+
+static double unpack_header_time(
+      /* in     */ const uint32_t ns[2]
+      )
+{
+   const uint64_t val = ((uint64_t) ntohl(ns[0]) << 32) | ntohl(ns[1]);
+   return (double) (int64_t) val * 1.0e-9;
+}
+
+// returns header version (1 for text timestamps)
+static uint32_t header_version(
+      /* in     */ const struct sensor_packet_header *pkt
+      )
+{
+   const uint32_t version = ntohl(pkt->times.version);
+   if ((version & SENSOR_HEADER_VERSION_MASK) == SENSOR_HEADER_VERSION_TAG) {
+      return version & ~SENSOR_HEADER_VERSION_MASK;
+   }
+   return 1;
+}
+
 // creates sensor packet header structure
 void serialize_sensor_header(
       /* in     */ uint32_t type,
@@ -584,7 +707,9 @@ void serialize_sensor_header(
 {
    memset(pkt, 0, sizeof(*pkt));
    pkt->sensor_type = htonl(type);
-   sprintf(pkt->timestamp, "%.4f", timestamp);
+   pkt->times.version =
+         htonl(SENSOR_HEADER_VERSION_TAG | SENSOR_HEADER_VERSION);
+   pack_header_time(timestamp, pkt->times.timestamp_ns);
 }
 
 void serialize_sensor_header2(
@@ -593,10 +718,8 @@ void serialize_sensor_header2(
       /* in     */ double timestamp_2,
       /*    out */ struct sensor_packet_header *pkt)
 {
-   memset(pkt, 0, sizeof(*pkt));
-   pkt->sensor_type = htonl(type);
-   sprintf(pkt->timestamp, "%.4f", timestamp);
-   sprintf(pkt->timestamp_2, "%.4f", timestamp_2);
+   serialize_sensor_header(type, timestamp, pkt);
+   pack_header_time(timestamp_2, pkt->times.timestamp_2_ns);
 }
 
 // extracts data from sensor packet header
@@ -606,7 +729,11 @@ void unpack_sensor_header(
       /*    out */ double *timestamp)
 {
    *type = htonl((uint32_t) pkt->sensor_type);
-   *timestamp = atof(pkt->timestamp);
+   if (header_version(pkt) >= 2) {
+      *timestamp = unpack_header_time(pkt->times.timestamp_ns);
+   } else {
+      *timestamp = atof(pkt->timestamp);
+   }
 }
 
 // extracts data from sensor packet header
@@ -618,8 +745,13 @@ void unpack_sensor_header2(
       )
 {
    *type = htonl((uint32_t) pkt->sensor_type);
-   *t_request = atof(pkt->timestamp);
-   *t_received = atof(pkt->timestamp_2);
+   if (header_version(pkt) >= 2) {
+      *t_request = unpack_header_time(pkt->times.timestamp_ns);
+      *t_received = unpack_header_time(pkt->times.timestamp_2_ns);
+   } else {
+      *t_request = atof(pkt->timestamp);
+      *t_received = atof(pkt->timestamp_2);
+   }
 }
 
 // set all fields in sensor packet to 0
@@ -696,18 +828,6 @@ char *trim_leading_whitespace(char *str)
    return str;
 }
 
-#if defined UNIT_TEST_PINET
-static uint32_t test_trim_whitespace(void)
-{
-   char buf[256];
-   strcpy(buf, "  this is a house  ");
-   assert(trim_whitespace(buf) == buf);
-   assert(strcmp(buf, "this is a house") == 0);
-   strcpy(buf, "  \t\n ");
-   assert(trim_whitespace(buf) == NULL);
-}
-#endif   // UNIT_TEST_PINET
-
 ///////////////////////////////////////////////////////////////////////
 // exit, signal handlers and stack tracing
 
@@ -802,3 +922,159 @@ void flush_to_zero()
 #endif   // INTEL | RPI
 }
 
+////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#if defined(TEST_PINET)
+
+static uint32_t check_time(
+      /* in     */ const char *label,
+      /* in     */ const double val,
+      /* in     */ const double expected,
+      /* in     */ const double tolerance
+      )
+{
+   if (fabs(val - expected) > tolerance) {
+      fprintf(stderr, "%s is %.9f, expected %.9f\n", label, val, expected);
+      return 1;
+   }
+   return 0;
+}
+
+
+static uint32_t test_trim_whitespace(void)
+{
+   uint32_t errs = 0;
+   char buf[256];
+   strcpy(buf, "  this is a house  ");
+   if ((trim_whitespace(buf) != buf) ||
+         (strcmp(buf, "this is a house") != 0)) {
+      fprintf(stderr, "trim_whitespace produced '%s'\n", buf);
+      errs++;
+   }
+   strcpy(buf, "  \t\n ");
+   if (trim_whitespace(buf) != NULL) {
+      fprintf(stderr, "trim_whitespace didn't return NULL for WS string\n");
+      errs++;
+   }
+   return errs;
+}
+
+
+// version 2 (binary) headers, written and read by current code
+static uint32_t test_header_v2(void)
+{
+   uint32_t errs = 0;
+   const double times[] = { 0.0, 1.5, -1.25, 1792345678.123456789 };
+   const uint32_t n_times = sizeof(times) / sizeof(times[0]);
+   sensor_packet_header_type pkt;
+   for (uint32_t i=0; i<n_times; i++) {
+      const double t = times[i];
+      const double t2 = t + 0.000000250;
+      uint32_t type;
+      double t_out, t2_out;
+      serialize_sensor_header(IMU_PACKET_TYPE, t, &pkt);
+      if (header_version(&pkt) != SENSOR_HEADER_VERSION) {
+         fprintf(stderr, "v2 header reports version %d\n",
+               header_version(&pkt));
+         errs++;
+      }
+      // version word overlays the text timestamp. its first byte must
+      //    be one that no text timestamp can start with
+      if ((uint8_t) pkt.timestamp[0] != 0xff) {
+         fprintf(stderr, "v2 header starts with 0x%02x, not 0xff\n",
+               (uint8_t) pkt.timestamp[0]);
+         errs++;
+      }
+      unpack_sensor_header(&pkt, &type, &t_out);
+      if (type != IMU_PACKET_TYPE) {
+         fprintf(stderr, "v2 type is 0x%08x, expected 0x%08x\n", type,
+               IMU_PACKET_TYPE);
+         errs++;
+      }
+      // 1usec tolerance -- double itself is only good to ~0.25usec
+      //    at current epoch times
+      errs += check_time("v2 timestamp", t_out, t, 1.0e-6);
+      //
+      serialize_sensor_header2(IMU_PACKET_TYPE, t, t2, &pkt);
+      unpack_sensor_header2(&pkt, &type, &t_out, &t2_out);
+      errs += check_time("v2 t_request", t_out, t, 1.0e-6);
+      errs += check_time("v2 t_received", t2_out, t2, 1.0e-6);
+      // sub-microsecond spacing must survive transport
+      if (t2_out <= t_out) {
+         fprintf(stderr, "v2 lost sub-usec spacing at %.9f\n", t);
+         errs++;
+      }
+   }
+   return errs;
+}
+
+
+// version 1 (text) headers, as built by senders that predate binary
+//    times, read by current code
+static uint32_t test_header_v1_sender(void)
+{
+   uint32_t errs = 0;
+   const double times[] = { 0.0, 1.5, 1792345678.1234 };
+   const uint32_t n_times = sizeof(times) / sizeof(times[0]);
+   sensor_packet_header_type pkt;
+   for (uint32_t i=0; i<n_times; i++) {
+      const double t = times[i];
+      const double t2 = t + 0.0125;
+      uint32_t type;
+      double t_out, t2_out;
+      // this is what serialize_sensor_header2() did in version 1
+      memset(&pkt, 0, sizeof(pkt));
+      pkt.sensor_type = htonl(IMU_PACKET_TYPE);
+      sprintf(pkt.timestamp, "%.4f", t);
+      sprintf(pkt.timestamp_2, "%.4f", t2);
+      if (header_version(&pkt) != 1) {
+         fprintf(stderr, "v1 header '%s' reports version %d\n",
+               pkt.timestamp, header_version(&pkt));
+         errs++;
+      }
+      unpack_sensor_header(&pkt, &type, &t_out);
+      if (type != IMU_PACKET_TYPE) {
+         fprintf(stderr, "v1 type is 0x%08x, expected 0x%08x\n", type,
+               IMU_PACKET_TYPE);
+         errs++;
+      }
+      // text is %.4f so allow for rounding in last digit
+      errs += check_time("v1 timestamp", t_out, t, 0.5e-4 + 1.0e-6);
+      unpack_sensor_header2(&pkt, &type, &t_out, &t2_out);
+      errs += check_time("v1 t_request", t_out, t, 0.5e-4 + 1.0e-6);
+      errs += check_time("v1 t_received", t2_out, t2, 0.5e-4 + 1.0e-6);
+   }
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   // header size must not change between versions
+   if (sizeof(sensor_packet_header_type) != 116) {
+      fprintf(stderr, "Sensor packet header is %ld bytes, expected 116\n",
+            sizeof(sensor_packet_header_type));
+      errs++;
+   }
+   errs += test_trim_whitespace();
+   errs += test_header_v2();
+   errs += test_header_v1_sender();
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
+#endif   // TEST_PINET
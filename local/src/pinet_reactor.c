@@ -0,0 +1,803 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "pinet_reactor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include "logger.h"
+#include "timekeeper.h"
+#include "latency.h"
+
+// how long event loops wait before checking quit flag and whether
+//    it's time to report
+#define PINET_REACTOR_TICK_MSEC     250
+#define PINET_REACTOR_MAX_EVENTS    PINET_REACTOR_MAX_CONNS
+// packets delivered per read event before moving to the next
+//    connection, so a busy connection doesn't starve others on the
+//    same loop. epoll is level-triggered so the rest is read next pass
+#define PINET_REACTOR_PACKETS_PER_EVENT   4
+
+struct pinet_conn {
+   pthread_mutex_t mutex;
+   // signaled when connection closes
+   pthread_cond_t cond;
+   int fd;
+   uint32_t in_use;
+   // incremented each time slot is reused so stale epoll events for a
+   //    previous connection are ignored
+   uint32_t generation;
+   uint32_t loop;
+   char name[PINET_CONN_NAME_LEN];
+   pinet_conn_handler_type handler;
+   // when handler's timer should next be called (<0 if none)
+   double timer_sec;
+   //
+   uint32_t packet_bytes;
+   uint8_t *packet;
+   // bytes received of packet being assembled
+   uint32_t fill;
+   double first_byte_sec;
+   int32_t closed;
+   // stats since last report
+   uint64_t bytes;
+   uint64_t reads;
+   uint32_t packets;
+   double busy_tot_sec;
+   latency_stats_type assembly;
+   double report_sec;
+};
+
+struct pinet_loop {
+   pthread_t thread_id;
+   int epoll_fd;
+   uint32_t num_conns;
+};
+typedef struct pinet_loop pinet_loop_type;
+
+static pinet_conn_type conns_[PINET_REACTOR_MAX_CONNS];
+static pinet_loop_type loops_[PINET_REACTOR_MAX_LOOPS];
+static uint32_t num_loops_ = 0;
+
+// protects connection table and loop assignment
+static pthread_mutex_t table_mutex_ = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile int32_t quit_ = 0;
+
+
+int32_t pinet_reactor_enabled(void)
+{
+   return num_loops_ > 0 ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// event loop
+
+static uint64_t event_tag(
+      /* in     */ const uint32_t slot,
+      /* in     */ const uint32_t generation
+      )
+{
+   return (uint64_t) slot | ((uint64_t) generation << 32);
+}
+
+static void close_conn(
+      /* in out */       pinet_conn_type *conn
+      )
+{
+   if (conn->closed == 0) {
+      epoll_ctl(loops_[conn->loop].epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+      conn->closed = 1;
+      conn->timer_sec = -1.0;
+      pthread_cond_broadcast(&conn->cond);
+   }
+}
+
+// calls handler's timer and stores when it's next due
+// conn mutex must be held
+static void run_timer(
+      /* in out */       pinet_conn_type *conn
+      )
+{
+   if ((conn->handler.timer == NULL) || (conn->closed != 0)) {
+      conn->timer_sec = -1.0;
+      return;
+   }
+   const double delay = (*conn->handler.timer)(conn->handler.arg);
+   conn->timer_sec = delay >= 0.0 ? now() + delay : -1.0;
+}
+
+// reads what's available, passing complete packets to the handler
+// conn mutex must be held
+static void read_conn(
+      /* in out */       pinet_conn_type *conn
+      )
+{
+   uint32_t completed = 0;
+   while (completed < PINET_REACTOR_PACKETS_PER_EVENT) {
+      ssize_t n = recv(conn->fd, &conn->packet[conn->fill],
+            conn->packet_bytes - conn->fill, 0);
+      conn->reads++;
+      if (n == 0) {
+         log_info(get_kernel_log(), "Reactor: %s closed by remote",
+               conn->name);
+         close_conn(conn);
+         break;
+      } else if (n < 0) {
+         if (errno == EAGAIN) {
+            break;
+         } else if (errno == EINTR) {
+            continue;
+         }
+         log_err(get_kernel_log(), "Reactor: %s read error: %s", conn->name,
+               strerror(errno));
+         close_conn(conn);
+         break;
+      }
+      const double t = now();
+      if (conn->fill == 0) {
+         conn->first_byte_sec = t;
+      }
+      conn->fill += (uint32_t) n;
+      conn->bytes += (uint64_t) n;
+      if (conn->fill == conn->packet_bytes) {
+         latency_add(&conn->assembly, t - conn->first_byte_sec);
+         conn->fill = 0;
+         conn->packets++;
+         completed++;
+         const int32_t rc =
+               (*conn->handler.packet)(conn->handler.arg, conn->packet, t);
+         conn->busy_tot_sec += now() - t;
+         if (rc != 0) {
+            log_err(get_kernel_log(), "Reactor: %s rejected packet. "
+                  "Closing connection", conn->name);
+            close_conn(conn);
+            break;
+         }
+      }
+   }
+   if (completed > 0) {
+      run_timer(conn);
+   }
+}
+
+static void handle_event(
+      /* in     */ const uint64_t tag
+      )
+{
+   const uint32_t slot = (uint32_t) (tag & 0xffffffffu);
+   const uint32_t generation = (uint32_t) (tag >> 32);
+   if (slot >= PINET_REACTOR_MAX_CONNS) {
+      return;
+   }
+   pinet_conn_type *conn = &conns_[slot];
+   pthread_mutex_lock(&conn->mutex);
+   if ((conn->in_use != 0) && (conn->generation == generation) &&
+         (conn->closed == 0)) {
+      read_conn(conn);
+   }
+   pthread_mutex_unlock(&conn->mutex);
+}
+
+static void report_conn(
+      /* in out */       pinet_conn_type *conn,
+      /* in     */ const double t
+      )
+{
+   const double dt = t - conn->report_sec;
+   if (dt < PINET_REACTOR_REPORT_SEC) {
+      return;
+   }
+   log_info_type *log = get_kernel_log();
+   const double reads_per_packet = conn->packets > 0 ?
+         (double) conn->reads / (double) conn->packets : 0.0;
+   log_info(log, "Reactor: %s %.1f KB/s, %.1f packets/s, %.2f reads/packet, "
+         "handler busy %.1f%%", conn->name,
+         (double) conn->bytes / (1024.0 * dt), (double) conn->packets / dt,
+         reads_per_packet, 100.0 * conn->busy_tot_sec / dt);
+   char label[STR_LEN];
+   snprintf(label, STR_LEN, "%s assembly", conn->name);
+   log_latency_summary(log, &conn->assembly, label);
+   conn->bytes = 0;
+   conn->reads = 0;
+   conn->packets = 0;
+   conn->busy_tot_sec = 0.0;
+   latency_reset(&conn->assembly);
+   conn->report_sec = t;
+}
+
+// runs due timers and reports for loop's connections. returns how long
+//    to wait, in msec, before next timer is due
+static int service_conns(
+      /* in     */ const uint32_t loop_idx
+      )
+{
+   double wait_sec = (double) PINET_REACTOR_TICK_MSEC * 1.0e-3;
+   for (uint32_t i=0; i<PINET_REACTOR_MAX_CONNS; i++) {
+      pinet_conn_type *conn = &conns_[i];
+      pthread_mutex_lock(&conn->mutex);
+      if ((conn->in_use != 0) && (conn->loop == loop_idx)) {
+         const double t = now();
+         if ((conn->timer_sec >= 0.0) && (conn->timer_sec <= t)) {
+            run_timer(conn);
+         }
+         if ((conn->timer_sec >= 0.0) && (conn->timer_sec - t < wait_sec)) {
+            wait_sec = conn->timer_sec - t;
+         }
+         report_conn(conn, t);
+      }
+      pthread_mutex_unlock(&conn->mutex);
+   }
+   // round up so timer is due when loop wakes
+   return wait_sec > 0.0 ? (int) (wait_sec * 1000.0) + 1 : 0;
+}
+
+static void * run_loop(
+      /* in     */       void *arg
+      )
+{
+   pinet_loop_type *loop = (pinet_loop_type*) arg;
+   const uint32_t loop_idx = (uint32_t) (loop - loops_);
+   struct epoll_event events[PINET_REACTOR_MAX_EVENTS];
+   int timeout_msec = PINET_REACTOR_TICK_MSEC;
+   while (quit_ == 0) {
+      int n = epoll_wait(loop->epoll_fd, events, PINET_REACTOR_MAX_EVENTS,
+            timeout_msec);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         log_err(get_kernel_log(), "Reactor epoll_wait failed: %s",
+               strerror(errno));
+         break;
+      }
+      for (int i=0; i<n; i++) {
+         handle_event(events[i].data.u64);
+      }
+      timeout_msec = service_conns(loop_idx);
+   }
+   return NULL;
+}
+
+// event loop
+////////////////////////////////////////////////////////////////////////
+// reactor control
+
+int32_t start_pinet_reactor(
+      /* in     */ const uint32_t num_loops
+      )
+{
+   log_info_type *log = get_kernel_log();
+   if (num_loops_ > 0) {
+      log_err(log, "Network reactor already started");
+      return -1;
+   }
+   if ((num_loops == 0) || (num_loops > PINET_REACTOR_MAX_LOOPS)) {
+      log_err(log, "Network reactor needs 1 to %d loops (requested %d)",
+            PINET_REACTOR_MAX_LOOPS, num_loops);
+      return -1;
+   }
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   for (uint32_t i=0; i<PINET_REACTOR_MAX_CONNS; i++) {
+      pinet_conn_type *conn = &conns_[i];
+      memset(conn, 0, sizeof *conn);
+      conn->fd = -1;
+      conn->timer_sec = -1.0;
+      pthread_mutex_init(&conn->mutex, NULL);
+      pthread_cond_init(&conn->cond, &attr);
+   }
+   pthread_condattr_destroy(&attr);
+   quit_ = 0;
+   for (uint32_t i=0; i<num_loops; i++) {
+      pinet_loop_type *loop = &loops_[i];
+      loop->num_conns = 0;
+      if ((loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+         log_err(log, "Network reactor failed to create epoll: %s",
+               strerror(errno));
+         goto err;
+      }
+      if (pthread_create(&loop->thread_id, NULL, run_loop, loop) != 0) {
+         log_err(log, "Network reactor failed to launch thread");
+         close(loop->epoll_fd);
+         goto err;
+      }
+      num_loops_++;
+   }
+   log_info(log, "Network reactor started w/ %d loop(s)", num_loops_);
+   return 0;
+err:
+   stop_pinet_reactor();
+   return -1;
+}
+
+void stop_pinet_reactor(void)
+{
+   if (num_loops_ == 0) {
+      return;
+   }
+   quit_ = 1;
+   for (uint32_t i=0; i<num_loops_; i++) {
+      pthread_join(loops_[i].thread_id, NULL);
+      close(loops_[i].epoll_fd);
+      loops_[i].epoll_fd = -1;
+   }
+   num_loops_ = 0;
+}
+
+pinet_conn_type * pinet_reactor_add(
+      /* in     */ const int fd,
+      /* in     */ const char *name,
+      /* in     */ const uint32_t packet_bytes,
+      /* in     */ const pinet_conn_handler_type *handler
+      )
+{
+   log_info_type *log = get_kernel_log();
+   pinet_conn_type *conn = NULL;
+   if ((num_loops_ == 0) || (packet_bytes == 0) || (handler == NULL) ||
+         (handler->packet == NULL)) {
+      log_err(log, "Network reactor not running or bad packet layout "
+            "for %s", name);
+      return NULL;
+   }
+   pthread_mutex_lock(&table_mutex_);
+   for (uint32_t i=0; i<PINET_REACTOR_MAX_CONNS; i++) {
+      if (conns_[i].in_use == 0) {
+         conn = &conns_[i];
+         break;
+      }
+   }
+   if (conn == NULL) {
+      log_err(log, "Network reactor has too many connections. Can't "
+            "add %s", name);
+      goto err;
+   }
+   uint32_t loop = 0;
+   for (uint32_t i=1; i<num_loops_; i++) {
+      if (loops_[i].num_conns < loops_[loop].num_conns) {
+         loop = i;
+      }
+   }
+   uint8_t *packet = malloc(packet_bytes);
+   int flags = fcntl(fd, F_GETFL, 0);
+   if ((packet == NULL) || (flags < 0) ||
+         (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+      log_err(log, "Network reactor failed to set up %s", name);
+      free(packet);
+      conn = NULL;
+      goto err;
+   }
+   pthread_mutex_lock(&conn->mutex);
+   conn->fd = fd;
+   conn->generation++;
+   conn->loop = loop;
+   strncpy(conn->name, name, PINET_CONN_NAME_LEN - 1);
+   conn->name[PINET_CONN_NAME_LEN - 1] = 0;
+   conn->handler = *handler;
+   conn->timer_sec = -1.0;
+   conn->packet_bytes = packet_bytes;
+   conn->packet = packet;
+   conn->fill = 0;
+   conn->closed = 0;
+   conn->bytes = 0;
+   conn->reads = 0;
+   conn->packets = 0;
+   conn->busy_tot_sec = 0.0;
+   latency_reset(&conn->assembly);
+   conn->report_sec = now();
+   conn->in_use = 1;
+   struct epoll_event ev = {
+      .events = EPOLLIN,
+      .data.u64 = event_tag((uint32_t) (conn - conns_), conn->generation)
+   };
+   if (epoll_ctl(loops_[loop].epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      log_err(log, "Network reactor failed to add %s: %s", name,
+            strerror(errno));
+      fcntl(fd, F_SETFL, flags);
+      free(packet);
+      conn->packet = NULL;
+      conn->fd = -1;
+      conn->in_use = 0;
+      pthread_mutex_unlock(&conn->mutex);
+      conn = NULL;
+      goto err;
+   }
+   loops_[loop].num_conns++;
+   pthread_mutex_unlock(&conn->mutex);
+   log_info(log, "Network reactor reading %s (%d-byte packets) on loop %d",
+         conn->name, packet_bytes, loop);
+err:
+   pthread_mutex_unlock(&table_mutex_);
+   return conn;
+}
+
+void pinet_reactor_remove(
+      /* in out */       pinet_conn_type *conn
+      )
+{
+   pthread_mutex_lock(&table_mutex_);
+   // handlers run w/ conn mutex held, so once it's acquired no handler
+   //    is running and none will be called again
+   pthread_mutex_lock(&conn->mutex);
+   if (conn->in_use != 0) {
+      close_conn(conn);
+      close(conn->fd);
+      conn->fd = -1;
+      free(conn->packet);
+      conn->packet = NULL;
+      conn->in_use = 0;
+      loops_[conn->loop].num_conns--;
+   }
+   pthread_mutex_unlock(&conn->mutex);
+   pthread_mutex_unlock(&table_mutex_);
+}
+
+int32_t pinet_conn_wait_closed(
+      /* in out */       pinet_conn_type *conn,
+      /* in     */ const double timeout_sec
+      )
+{
+   struct timespec deadline;
+   clock_gettime(CLOCK_MONOTONIC, &deadline);
+   const long nsec = deadline.tv_nsec + (long) (timeout_sec * 1.0e9);
+   deadline.tv_sec += nsec / 1000000000l;
+   deadline.tv_nsec = nsec % 1000000000l;
+   pthread_mutex_lock(&conn->mutex);
+   while ((conn->closed == 0) && (conn->in_use != 0)) {
+      if (pthread_cond_timedwait(&conn->cond, &conn->mutex,
+            &deadline) == ETIMEDOUT) {
+         break;
+      }
+   }
+   const int32_t rc = ((conn->closed != 0) || (conn->in_use == 0)) ? 1 : 0;
+   pthread_mutex_unlock(&conn->mutex);
+   return rc;
+}
+
+// reactor control
+////////////////////////////////////////////////////////////////////////
+
+#if defined(TEST_PINET_REACTOR)
+#include <dirent.h>
+#include <sys/syscall.h>
+
+#define TEST_PACKET_BYTES     1000
+#define TEST_NUM_PACKETS      200
+
+struct test_writer {
+   int fd;
+   // bytes per write. doesn't line up w/ packets
+   uint32_t chunk;
+   // pause between writes
+   uint32_t usec;
+   pid_t tid;
+};
+
+struct test_reader {
+   uint32_t num_packets;
+   uint32_t bad_packets;
+   // if set, handler takes time w/ some packets so socket backs up
+   uint32_t slow;
+   uint32_t timer_calls;
+   // if non-zero, handler rejects this packet (counting from 1)
+   uint32_t reject;
+};
+
+static void * write_packets(void *arg)
+{
+   struct test_writer *w = (struct test_writer*) arg;
+   w->tid = (pid_t) syscall(SYS_gettid);
+   const uint32_t tot = TEST_PACKET_BYTES * TEST_NUM_PACKETS;
+   uint8_t *buf = malloc(tot);
+   for (uint32_t i=0; i<tot; i++) {
+      buf[i] = (uint8_t) ((i / TEST_PACKET_BYTES) + i);
+   }
+   uint32_t sent = 0;
+   while (sent < tot) {
+      uint32_t len = tot - sent < w->chunk ? tot - sent : w->chunk;
+      ssize_t n = send(w->fd, &buf[sent], len, MSG_NOSIGNAL);
+      if (n < 0) {
+         break;
+      }
+      sent += (uint32_t) n;
+      if (w->usec > 0) {
+         usleep(w->usec);
+      }
+   }
+   close(w->fd);
+   free(buf);
+   return NULL;
+}
+
+static int32_t check_packet(void *arg, uint8_t *packet,
+      double received_sec)
+{
+   (void) received_sec;
+   struct test_reader *r = (struct test_reader*) arg;
+   for (uint32_t i=0; i<TEST_PACKET_BYTES; i++) {
+      const uint32_t pos = r->num_packets * TEST_PACKET_BYTES + i;
+      if (packet[i] != (uint8_t) (r->num_packets + pos)) {
+         r->bad_packets++;
+         break;
+      }
+   }
+   if (r->slow && ((r->num_packets % 20) == 0)) {
+      usleep(20000);
+   }
+   r->num_packets++;
+   return r->num_packets == r->reject ? -1 : 0;
+}
+
+static double count_timer(void *arg)
+{
+   struct test_reader *r = (struct test_reader*) arg;
+   r->timer_calls++;
+   return 0.01;
+}
+
+// sums context switches of this process's threads, except 'skip'.
+//    thread count is stored in num_threads
+static uint64_t count_context_switches(
+      /* in     */ const pid_t skip,
+      /*    out */       uint32_t *num_threads
+      )
+{
+   uint64_t tot = 0;
+   *num_threads = 0;
+   DIR *dir = opendir("/proc/self/task");
+   if (dir == NULL) {
+      return 0;
+   }
+   struct dirent *ent;
+   while ((ent = readdir(dir)) != NULL) {
+      if ((ent->d_name[0] == '.') || (atoi(ent->d_name) == skip)) {
+         continue;
+      }
+      char path[2*STR_LEN];
+      snprintf(path, sizeof path, "/proc/self/task/%s/status",
+            ent->d_name);
+      FILE *fp = fopen(path, "r");
+      if (fp == NULL) {
+         continue;
+      }
+      (*num_threads)++;
+      char line[STR_LEN];
+      while (fgets(line, STR_LEN, fp) != NULL) {
+         unsigned long n;
+         if ((sscanf(line, "voluntary_ctxt_switches: %lu", &n) == 1) ||
+               (sscanf(line, "nonvoluntary_ctxt_switches: %lu", &n) == 1)) {
+            tot += n;
+         }
+      }
+      fclose(fp);
+   }
+   closedir(dir);
+   return tot;
+}
+
+// streams packets to reactor and checks content. writer sends chunk
+//    bytes every usec. if slow is set, handler takes time w/ some
+//    packets so socket backs up. if report is set, context switches
+//    in receiver and reactor threads are reported per packet
+static uint32_t check_stream(
+      /* in     */ const uint32_t chunk,
+      /* in     */ const uint32_t usec,
+      /* in     */ const uint32_t slow,
+      /* in     */ const uint32_t report
+      )
+{
+   uint32_t errs = 0;
+   int sv[2];
+   if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+      printf("  socketpair failed\n");
+      return 1;
+   }
+   // keep socket buffer small so a slow handler pushes back on writer
+   int sz = 4096;
+   setsockopt(sv[0], SOL_SOCKET, SO_RCVBUF, &sz, sizeof sz);
+   setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &sz, sizeof sz);
+   struct test_reader r = { .num_packets = 0, .bad_packets = 0,
+         .slow = slow, .timer_calls = 0, .reject = 0 };
+   pinet_conn_handler_type handler = { .packet = check_packet,
+         .timer = NULL, .arg = &r };
+   pinet_conn_type *conn =
+         pinet_reactor_add(sv[0], "test", TEST_PACKET_BYTES, &handler);
+   if (conn == NULL) {
+      printf("  failed to add connection\n");
+      return 1;
+   }
+   uint32_t num_threads;
+   const uint64_t switches = count_context_switches(0, &num_threads);
+   struct test_writer w = { .fd = sv[1], .chunk = chunk, .usec = usec,
+         .tid = 0 };
+   pthread_t tid;
+   pthread_create(&tid, NULL, write_packets, &w);
+   // this thread only waits for connection to close, as receivers do
+   uint32_t waits = 0;
+   while (pinet_conn_wait_closed(conn, PINET_CONN_WAIT_SEC) == 0) {
+      if (++waits > 40) {
+         printf("  timed out waiting for connection to close\n");
+         errs++;
+         break;
+      }
+   }
+   pthread_join(tid, NULL);
+   if (report) {
+      // writer has exited so it's not counted
+      const uint64_t dn = count_context_switches(w.tid, &num_threads) -
+            switches;
+      printf("  %d threads (reactor + receiver), %.2f context switches "
+            "per packet\n", num_threads,
+            (double) dn / (double) r.num_packets);
+   }
+   pinet_reactor_remove(conn);
+   if (r.num_packets != TEST_NUM_PACKETS) {
+      printf("  received %d packets, expected %d\n", r.num_packets,
+            TEST_NUM_PACKETS);
+      errs++;
+   }
+   if (r.bad_packets > 0) {
+      printf("  %d packets had wrong content\n", r.bad_packets);
+      errs++;
+   }
+   return errs;
+}
+
+// handler timer must be called after packets arrive and again while
+//    connection is idle
+static uint32_t check_timer(void)
+{
+   uint32_t errs = 0;
+   int sv[2];
+   if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+      printf("  socketpair failed\n");
+      return 1;
+   }
+   struct test_reader r = { .num_packets = 0, .bad_packets = 0,
+         .slow = 0, .timer_calls = 0, .reject = 0 };
+   pinet_conn_handler_type handler = { .packet = check_packet,
+         .timer = count_timer, .arg = &r };
+   pinet_conn_type *conn =
+         pinet_reactor_add(sv[0], "timer", TEST_PACKET_BYTES, &handler);
+   if (conn == NULL) {
+      printf("  failed to add connection\n");
+      return 1;
+   }
+   uint8_t buf[TEST_PACKET_BYTES];
+   for (uint32_t i=0; i<TEST_PACKET_BYTES; i++) {
+      buf[i] = (uint8_t) i;
+   }
+   send(sv[1], buf, TEST_PACKET_BYTES, MSG_NOSIGNAL);
+   // timer is every 10ms once a packet is delivered
+   usleep(200000);
+   pinet_reactor_remove(conn);
+   close(sv[1]);
+   if (r.num_packets != 1) {
+      printf("  received %d packets, expected 1\n", r.num_packets);
+      errs++;
+   }
+   if (r.timer_calls < 10) {
+      printf("  timer called %d times in 200ms, expected ~20\n",
+            r.timer_calls);
+      errs++;
+   }
+   return errs;
+}
+
+// connection must be closed by reactor when handler rejects a packet,
+//    and no packets delivered after that
+static uint32_t check_reject(void)
+{
+   uint32_t errs = 0;
+   int sv[2];
+   if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+      printf("  socketpair failed\n");
+      return 1;
+   }
+   struct test_reader r = { .num_packets = 0, .bad_packets = 0,
+         .slow = 0, .timer_calls = 0, .reject = 3 };
+   pinet_conn_handler_type handler = { .packet = check_packet,
+         .timer = NULL, .arg = &r };
+   pinet_conn_type *conn =
+         pinet_reactor_add(sv[0], "reject", TEST_PACKET_BYTES, &handler);
+   if (conn == NULL) {
+      printf("  failed to add connection\n");
+      return 1;
+   }
+   // send packets w/o closing, so only the rejection closes connection
+   uint8_t buf[TEST_PACKET_BYTES];
+   for (uint32_t n=0; n<5; n++) {
+      for (uint32_t i=0; i<TEST_PACKET_BYTES; i++) {
+         const uint32_t pos = n * TEST_PACKET_BYTES + i;
+         buf[i] = (uint8_t) (n + pos);
+      }
+      send(sv[1], buf, TEST_PACKET_BYTES, MSG_NOSIGNAL);
+   }
+   if (pinet_conn_wait_closed(conn, 1.0) == 0) {
+      printf("  connection not closed after packet rejected\n");
+      errs++;
+   }
+   pinet_reactor_remove(conn);
+   close(sv[1]);
+   if (r.num_packets != 3) {
+      printf("  received %d packets, expected 3\n", r.num_packets);
+      errs++;
+   }
+   if (r.bad_packets > 0) {
+      printf("  %d packets had wrong content\n", r.bad_packets);
+      errs++;
+   }
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   init_timekeeper();
+   if (start_pinet_reactor(2) != 0) {
+      printf("Failed to start reactor\n");
+      return 1;
+   }
+   printf("Checking packet assembly\n");
+   // writes smaller than, larger than and not aligned w/ packets
+   errs += check_stream(37, 0, 0, 0);
+   errs += check_stream(TEST_PACKET_BYTES, 0, 0, 0);
+   errs += check_stream(2500, 0, 0, 0);
+   printf("Checking backpressure from slow handler\n");
+   errs += check_stream(4096, 0, 1, 0);
+   printf("Checking handler timer\n");
+   errs += check_timer();
+   printf("Checking rejected packet\n");
+   errs += check_reject();
+   stop_pinet_reactor();
+   // one packet every 2ms, like a sensor stream. use one loop so an
+   //    idle loop's thread isn't counted
+   printf("Checking sensor-rate stream\n");
+   if (start_pinet_reactor(1) != 0) {
+      printf("Failed to restart reactor\n");
+      return 1;
+   }
+   errs += check_stream(TEST_PACKET_BYTES, 2000, 0, 1);
+   stop_pinet_reactor();
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
+#endif   // TEST_PINET_REACTOR
@@ -228,3 +228,29 @@ void restore_sensor_packet(
          &s->state);
 }
 
+
+////////////////////////////////////////////////////////////////////////
+// binary IMU log
+
+int imu_log_write_header(
+      /* in out */       FILE *fp
+      )
+{
+   if (fwrite(IMU_LOG_MAGIC, IMU_LOG_MAGIC_LEN, 1, fp) != 1) {
+      return -1;
+   }
+   return 0;
+}
+
+int imu_log_check_header(
+      /* in out */       FILE *fp
+      )
+{
+   char buf[IMU_LOG_MAGIC_LEN];
+   if ((fread(buf, IMU_LOG_MAGIC_LEN, 1, fp) == 1) &&
+         (memcmp(buf, IMU_LOG_MAGIC, IMU_LOG_MAGIC_LEN) == 0)) {
+      return 1;
+   }
+   rewind(fp);
+   return 0;
+}
@@ -69,6 +69,10 @@ static pthread_t s_heartbeat_tid;
 static pthread_t s_camera_tid;
 static int s_camera_registered = 0;
 
+// interval between frame-capture signals. hub can change this to slow
+//    acquisition when it's overloaded
+static double s_frame_interval = CAMERA_FRAME_INTERVAL;
+
 // sigusr2 handler -- this is a no-op. the role of sigusr2 is to
 //    wake the thread if it's sleeping. callback does nothing
 static void sigusr2_callback(int sig)
@@ -113,7 +117,7 @@ static void * heartbeat_entry(void * not_used)
             }
          }
          // wait for next frame
-         increment_timef(&ts, CAMERA_FRAME_INTERVAL);
+         increment_timef(&ts, s_frame_interval);
          while ((rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
                      &ts, NULL)) != 0) {
             if (rc != EINTR) {
@@ -160,6 +164,28 @@ void register_camera()
    }
 }
 
+// applies frame interval requested by hub. out-of-range values are
+//    ignored
+static void set_frame_interval(
+      /* in     */ const uint16_t interval_ms
+      )
+{
+   if (interval_ms == 0) {
+      return;
+   }
+   const double interval = 0.001 * (double) interval_ms;
+   // hub shouldn't ask for faster than the camera can deliver, but
+   //    allow for rounding to msec
+   if (interval < CAMERA_FRAME_INTERVAL - 0.001) {
+      return;
+   }
+   if (interval != s_frame_interval) {
+      printf("Frame interval changed to %.3f sec (%.2f fps)\n",
+            interval, 1.0 / interval);
+      s_frame_interval = interval;
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////
 
 static void create_udp_socket()
@@ -202,29 +228,27 @@ void * udp_receiver_main(void *not_used)
    // main body
    //
    // loop forever receiving packets, or at least until told to stop
-   int running = 1;
    unsigned int sz=sizeof(s_sock_addr);
    const size_t packet_len = sizeof(struct udp_sync_packet);
    struct udp_sync_packet packet;
-   uint8_t *bpacket = (uint8_t*) &packet;
    ssize_t n;
-   ssize_t bytes_read;
    // loop while listening
-   while (running) {
-      // wait for next packet
-      bytes_read = 0;
-      while ((size_t) bytes_read < packet_len) {
-         n = recvfrom(s_sockfd, &bpacket[bytes_read], packet_len, MSG_WAITALL,
-               (struct sockaddr*) &s_sock_addr, &sz);
-         if (n < 0) {
-            perror("UDP sync receiver interrupted while listening");
-            running = 0;
-            break;
-         }
-         bytes_read += n;
-      }
-      if (!running)
+   while (1) {
+      // wait for next packet. each packet is one datagram. packets from
+      //    hubs that predate frame_interval_ms are shorter, so clear
+      //    the packet first and accept anything w/ a timestamp
+      memset(&packet, 0, packet_len);
+      n = recvfrom(s_sockfd, &packet, packet_len, 0,
+            (struct sockaddr*) &s_sock_addr, &sz);
+      if (n < 0) {
+         perror("UDP sync receiver interrupted while listening");
          break;
+      }
+      if ((size_t) n < UDP_SYNC_PACKET_MIN_LEN) {
+         fprintf(stderr, "Ignoring short sync packet (%ld bytes)\n",
+               (long) n);
+         continue;
+      }
 //printf("Inbound sync packet (%08x) at %f\n", packet.packet_type, now());
       if (packet.packet_type & UDP_SYNC_PACKET_EXIT) {
          MESSAGE_BOARD.exit = 1;
@@ -236,6 +260,7 @@ void * udp_receiver_main(void *not_used)
          break;
       } else {
          // exit not requested so process rest of packet
+         set_frame_interval(packet.frame_interval_ms);
          if (packet.packet_type & UDP_SYNC_PACKET_TIME) {
             timekeeper_set_time(packet.timestamp);
          }
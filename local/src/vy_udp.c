@@ -0,0 +1,949 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "vy_udp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "timekeeper.h"
+
+// frames arrive in bursts. socket buffers should hold a couple frames
+//    (kernel limits this to net.core.rmem_max/wmem_max)
+#define VY_UDP_SOCKET_BUF     (4 * 1024 * 1024)
+
+////////////////////////////////////////////////////////////////////////
+// sender
+
+int vy_udp_open_sender(
+      /* in     */ const network_id_type *target
+      )
+{
+   log_info_type *log = get_kernel_log();
+   int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+   if (sockfd < 0) {
+      log_err(log, "Unable to create UDP socket: %s", strerror(errno));
+      goto err;
+   }
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof addr);
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((uint16_t) target->port);
+   if (inet_pton(AF_INET, target->ip, &addr.sin_addr) != 1) {
+      log_err(log, "Bad UDP target address '%s'", target->ip);
+      goto err;
+   }
+   if (IN_MULTICAST(ntohl(addr.sin_addr.s_addr))) {
+      // keep stream on local network, and let consumers on this host
+      //    receive it too
+      uint8_t ttl = 1;
+      uint8_t loop = 1;
+      setsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof ttl);
+      setsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof loop);
+   }
+   int sz = VY_UDP_SOCKET_BUF;
+   setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof sz);
+   if (connect(sockfd, (struct sockaddr*) &addr, sizeof addr) != 0) {
+      log_err(log, "Unable to set UDP target %s:%d: %s", target->ip,
+            target->port, strerror(errno));
+      goto err;
+   }
+   log_info(log, "Sending UDP frames to %s:%d", target->ip, target->port);
+   return sockfd;
+err:
+   if (sockfd >= 0) {
+      close(sockfd);
+   }
+   return -1;
+}
+
+static void fill_header(
+      /*    out */       vy_udp_header_type *header,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const uint32_t plane,
+      /* in     */ const uint32_t first_row,
+      /* in     */ const uint32_t num_rows,
+      /* in     */ const double frame_request_time,
+      /* in     */ const double frame_received_time
+      )
+{
+   header->magic = htonl(VY_UDP_MAGIC);
+   header->frame_id = htonl(frame_id);
+   header->plane = htons((uint16_t) plane);
+   header->first_row = htons((uint16_t) first_row);
+   header->num_rows = htons((uint16_t) num_rows);
+   header->row_bytes = htons((uint16_t) CAM_COLS);
+   header->frame_request_time = frame_request_time;
+   header->frame_received_time = frame_received_time;
+}
+
+static int32_t send_datagrams(
+      /* in     */ const int sockfd,
+      /* in out */       struct mmsghdr *msgs,
+      /* in     */ const uint32_t num_msgs,
+      /* in out */       uint64_t *num_calls
+      )
+{
+   uint32_t sent = 0;
+   while (sent < num_msgs) {
+      int rc = sendmmsg(sockfd, &msgs[sent], num_msgs - sent, 0);
+      if (num_calls) {
+         (*num_calls)++;
+      }
+      if (rc < 0) {
+         if (errno == EINTR) {
+            continue;
+         } else if (errno == ECONNREFUSED) {
+            // nobody listening at unicast target. datagram is lost, as
+            //    it could be on the network
+            sent++;
+            continue;
+         }
+         log_err(get_kernel_log(), "UDP send error: %s", strerror(errno));
+         return -1;
+      }
+      sent += (uint32_t) rc;
+   }
+   return 0;
+}
+
+int32_t vy_udp_send_frame(
+      /* in     */ const int sockfd,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const double frame_request_time,
+      /* in     */ const double frame_received_time,
+      /* in     */ const uint8_t *v_chan,
+      /* in     */ const uint8_t *y_chan,
+      /* in out */       uint64_t *num_calls
+      )
+{
+   vy_udp_header_type headers[VY_UDP_BATCH];
+   struct iovec iov[VY_UDP_BATCH][2];
+   struct mmsghdr msgs[VY_UDP_BATCH];
+   memset(msgs, 0, sizeof msgs);
+   uint32_t n = 0;
+   for (uint32_t plane=0; plane<2; plane++) {
+      const uint8_t *chan = (plane == VY_UDP_PLANE_V) ? v_chan : y_chan;
+      for (uint32_t row=0; row<CAM_ROWS; row+=VY_UDP_BAND_ROWS) {
+         const uint32_t num_rows = (CAM_ROWS - row) < VY_UDP_BAND_ROWS ?
+               CAM_ROWS - row : VY_UDP_BAND_ROWS;
+         fill_header(&headers[n], frame_id, plane, row, num_rows,
+               frame_request_time, frame_received_time);
+         // rows are sent from where they are. iovec isn't const but
+         //    isn't written to when sending
+         iov[n][0].iov_base = &headers[n];
+         iov[n][0].iov_len = sizeof headers[n];
+         iov[n][1].iov_base = (void *) (uintptr_t) &chan[row * CAM_COLS];
+         iov[n][1].iov_len = num_rows * CAM_COLS;
+         msgs[n].msg_hdr.msg_iov = iov[n];
+         msgs[n].msg_hdr.msg_iovlen = 2;
+         if (++n == VY_UDP_BATCH) {
+            if (send_datagrams(sockfd, msgs, n, num_calls) != 0) {
+               return -1;
+            }
+            n = 0;
+         }
+      }
+   }
+   if (n > 0) {
+      if (send_datagrams(sockfd, msgs, n, num_calls) != 0) {
+         return -1;
+      }
+   }
+   return 0;
+}
+
+// sender
+////////////////////////////////////////////////////////////////////////
+// receiver
+
+vy_udp_receiver_type * create_vy_udp_receiver(
+      /* in     */ const uint16_t port,
+      /* in     */ const char *group,
+      /* in     */ const double deadline_sec
+      )
+{
+   log_info_type *log = get_kernel_log();
+   vy_udp_receiver_type *rcv = calloc(1, sizeof *rcv);
+   rcv->deadline_sec = deadline_sec;
+   rcv->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+   if (rcv->sockfd < 0) {
+      log_err(log, "Unable to create UDP socket: %s", strerror(errno));
+      goto err;
+   }
+   // several consumers on one host can listen to the same group
+   int one = 1;
+   setsockopt(rcv->sockfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+   int sz = VY_UDP_SOCKET_BUF;
+   setsockopt(rcv->sockfd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof sz);
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof addr);
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(port);
+   addr.sin_addr.s_addr = htonl(INADDR_ANY);
+   if (bind(rcv->sockfd, (struct sockaddr*) &addr, sizeof addr) != 0) {
+      log_err(log, "Unable to bind UDP port %d: %s", port, strerror(errno));
+      goto err;
+   }
+   if (group != NULL) {
+      struct ip_mreq mreq;
+      memset(&mreq, 0, sizeof mreq);
+      if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1) {
+         log_err(log, "Bad multicast group '%s'", group);
+         goto err;
+      }
+      mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+      if (setsockopt(rcv->sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+            sizeof mreq) != 0) {
+         log_err(log, "Unable to join multicast group %s: %s", group,
+               strerror(errno));
+         goto err;
+      }
+   }
+   rcv->buf = malloc(VY_UDP_BATCH * VY_UDP_MAX_DATAGRAM);
+   for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+      vy_udp_frame_type *frame = &rcv->frames[i];
+      frame->state = VY_UDP_FRAME_FREE;
+      frame->v_chan = malloc(CAM_N_PIX);
+      frame->y_chan = malloc(CAM_N_PIX);
+   }
+   latency_reset(&rcv->stats.assembly);
+   rcv->report_sec = now();
+   log_info(log, "Receiving UDP frames on port %d%s%s", port,
+         group ? ", group " : "", group ? group : "");
+   return rcv;
+err:
+   free_vy_udp_receiver(rcv);
+   return NULL;
+}
+
+void free_vy_udp_receiver(
+      /* in out */       vy_udp_receiver_type *rcv
+      )
+{
+   if (rcv == NULL) {
+      return;
+   }
+   if (rcv->sockfd >= 0) {
+      close(rcv->sockfd);
+   }
+   for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+      free(rcv->frames[i].v_chan);
+      free(rcv->frames[i].y_chan);
+   }
+   free(rcv->buf);
+   free(rcv);
+}
+
+// returns oldest frame in given state, or NULL if there are none
+static vy_udp_frame_type * oldest_frame(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const uint32_t state
+      )
+{
+   vy_udp_frame_type *oldest = NULL;
+   for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+      vy_udp_frame_type *frame = &rcv->frames[i];
+      if ((frame->state == state) && ((oldest == NULL) ||
+            ((int32_t) (frame->frame_id - oldest->frame_id) < 0))) {
+         oldest = frame;
+      }
+   }
+   return oldest;
+}
+
+// returns frame that's been ready longest, or NULL if there are none
+static vy_udp_frame_type * first_ready_frame(
+      /* in out */       vy_udp_receiver_type *rcv
+      )
+{
+   vy_udp_frame_type *first = NULL;
+   for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+      vy_udp_frame_type *frame = &rcv->frames[i];
+      if ((frame->state == VY_UDP_FRAME_READY) && ((first == NULL) ||
+            ((int32_t) (frame->finish_seq - first->finish_seq) < 0))) {
+         first = frame;
+      }
+   }
+   return first;
+}
+
+// fills missing rows from nearest received row above, or below for
+//    rows at the top. returns -1 if a plane has no rows at all
+static int32_t fill_missing_rows(
+      /* in out */       vy_udp_frame_type *frame
+      )
+{
+   for (uint32_t plane=0; plane<2; plane++) {
+      uint8_t *chan = (plane == VY_UDP_PLANE_V) ?
+            frame->v_chan : frame->y_chan;
+      const uint8_t *ok = &frame->row_ok[plane * CAM_ROWS];
+      int32_t first = -1;
+      int32_t prev = -1;
+      for (uint32_t r=0; r<CAM_ROWS; r++) {
+         if (ok[r]) {
+            if (first < 0) {
+               first = (int32_t) r;
+            }
+            prev = (int32_t) r;
+         } else if (prev >= 0) {
+            memcpy(&chan[r * CAM_COLS], &chan[(uint32_t) prev * CAM_COLS],
+                  CAM_COLS);
+         }
+      }
+      if (first < 0) {
+         return -1;
+      }
+      for (uint32_t r=0; r<(uint32_t) first; r++) {
+         memcpy(&chan[r * CAM_COLS], &chan[(uint32_t) first * CAM_COLS],
+               CAM_COLS);
+      }
+   }
+   return 0;
+}
+
+// flags camera rows where either plane is missing
+static void set_row_missing(
+      /* in out */       vy_udp_frame_type *frame
+      )
+{
+   const uint8_t *ok_v = &frame->row_ok[VY_UDP_PLANE_V * CAM_ROWS];
+   const uint8_t *ok_y = &frame->row_ok[VY_UDP_PLANE_Y * CAM_ROWS];
+   for (uint32_t r=0; r<CAM_ROWS; r++) {
+      frame->row_missing[r] = (ok_v[r] && ok_y[r]) ? 0 : 1;
+   }
+}
+
+// stops waiting for more of frame. it's ready to hand on unless too
+//    much is missing
+static void finish_frame(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in out */       vy_udp_frame_type *frame,
+      /* in     */ const double t
+      )
+{
+   vy_udp_stats_type *stats = &rcv->stats;
+   const uint32_t missing = VY_UDP_ROWS_PER_FRAME - frame->rows_received;
+   latency_add(&stats->assembly, t - frame->first_sec);
+   if (((double) missing > VY_UDP_MAX_MISSING_FRAC * VY_UDP_ROWS_PER_FRAME)
+         || (fill_missing_rows(frame) != 0)) {
+      stats->dropped_frames++;
+      frame->state = VY_UDP_FRAME_FREE;
+   } else {
+      frame->missing_rows = missing;
+      set_row_missing(frame);
+      stats->missing_rows += missing;
+      if (missing == 0) {
+         stats->complete_frames++;
+      } else {
+         stats->partial_frames++;
+      }
+      frame->finish_seq = rcv->finish_seq++;
+      frame->state = VY_UDP_FRAME_READY;
+   }
+   if ((rcv->have_last_frame == 0) ||
+         ((int32_t) (frame->frame_id - rcv->last_frame_id) > 0)) {
+      rcv->last_frame_id = frame->frame_id;
+      rcv->have_last_frame = 1;
+   }
+}
+
+// finishes frames being assembled up through frame_id, oldest first.
+//    frames are handed on in order, so once a frame is done there's no
+//    point waiting for older ones
+static void finish_frames_through(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const double t
+      )
+{
+   while (1) {
+      vy_udp_frame_type *oldest =
+            oldest_frame(rcv, VY_UDP_FRAME_ASSEMBLING);
+      if ((oldest == NULL) ||
+            ((int32_t) (oldest->frame_id - frame_id) > 0)) {
+         break;
+      }
+      finish_frame(rcv, oldest, t);
+   }
+}
+
+static void expire_frames(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const double t
+      )
+{
+   for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+      vy_udp_frame_type *frame = &rcv->frames[i];
+      if ((frame->state == VY_UDP_FRAME_ASSEMBLING) &&
+            (t - frame->first_sec >= rcv->deadline_sec)) {
+         finish_frames_through(rcv, frame->frame_id, t);
+      }
+   }
+}
+
+// returns frame to store datagram for frame_id in, or NULL if datagram
+//    is late
+static vy_udp_frame_type * get_frame(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const double t
+      )
+{
+   for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+      vy_udp_frame_type *frame = &rcv->frames[i];
+      if ((frame->state == VY_UDP_FRAME_ASSEMBLING) &&
+            (frame->frame_id == frame_id)) {
+         return frame;
+      }
+   }
+   if (rcv->have_last_frame) {
+      const int32_t behind = (int32_t) (rcv->last_frame_id - frame_id);
+      if (behind >= VY_UDP_RESYNC_FRAMES) {
+         log_info(get_kernel_log(), "UDP frame count jumped from %d to %d. "
+               "Assuming sender restarted", rcv->last_frame_id, frame_id);
+         for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+            if (rcv->frames[i].state == VY_UDP_FRAME_ASSEMBLING) {
+               rcv->frames[i].state = VY_UDP_FRAME_FREE;
+            }
+         }
+         rcv->have_last_frame = 0;
+      } else if (behind >= 0) {
+         return NULL;
+      }
+   }
+   vy_udp_frame_type *frame = oldest_frame(rcv, VY_UDP_FRAME_FREE);
+   if (frame == NULL) {
+      // make room by ending wait for oldest frame
+      vy_udp_frame_type *oldest =
+            oldest_frame(rcv, VY_UDP_FRAME_ASSEMBLING);
+      if (oldest != NULL) {
+         finish_frames_through(rcv, oldest->frame_id, t);
+         if ((int32_t) (rcv->last_frame_id - frame_id) >= 0) {
+            // datagram is for a frame older than one just finished
+            return NULL;
+         }
+         frame = oldest_frame(rcv, VY_UDP_FRAME_FREE);
+      }
+   }
+   if (frame == NULL) {
+      // consumer isn't keeping up. drop oldest frame it hasn't taken
+      frame = first_ready_frame(rcv);
+      if (frame == NULL) {
+         return NULL;
+      }
+      rcv->stats.dropped_frames++;
+   }
+   frame->state = VY_UDP_FRAME_ASSEMBLING;
+   frame->frame_id = frame_id;
+   frame->first_sec = t;
+   frame->rows_received = 0;
+   frame->missing_rows = 0;
+   memset(frame->row_ok, 0, sizeof frame->row_ok);
+   return frame;
+}
+
+static void process_datagram(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const uint8_t *buf,
+      /* in     */ const uint32_t len,
+      /* in     */ const double t
+      )
+{
+   vy_udp_stats_type *stats = &rcv->stats;
+   stats->datagrams++;
+   vy_udp_header_type header;
+   if (len < sizeof header) {
+      stats->bad_datagrams++;
+      return;
+   }
+   memcpy(&header, buf, sizeof header);
+   const uint32_t plane = ntohs(header.plane);
+   const uint32_t first_row = ntohs(header.first_row);
+   const uint32_t num_rows = ntohs(header.num_rows);
+   if ((ntohl(header.magic) != VY_UDP_MAGIC) || (plane > VY_UDP_PLANE_Y)
+         || (ntohs(header.row_bytes) != CAM_COLS)
+         || (first_row + num_rows > CAM_ROWS)
+         || (len != sizeof header + num_rows * CAM_COLS)) {
+      stats->bad_datagrams++;
+      return;
+   }
+   const uint32_t frame_id = ntohl(header.frame_id);
+   vy_udp_frame_type *frame = get_frame(rcv, frame_id, t);
+   if (frame == NULL) {
+      stats->late_datagrams++;
+      return;
+   }
+   frame->frame_request_time = header.frame_request_time;
+   frame->frame_received_time = header.frame_received_time;
+   uint8_t *chan = (plane == VY_UDP_PLANE_V) ? frame->v_chan : frame->y_chan;
+   memcpy(&chan[first_row * CAM_COLS], &buf[sizeof header],
+         num_rows * CAM_COLS);
+   uint8_t *ok = &frame->row_ok[plane * CAM_ROWS + first_row];
+   for (uint32_t r=0; r<num_rows; r++) {
+      if (ok[r] == 0) {
+         ok[r] = 1;
+         frame->rows_received++;
+      }
+   }
+   if (frame->rows_received == VY_UDP_ROWS_PER_FRAME) {
+      finish_frames_through(rcv, frame_id, t);
+   }
+}
+
+// reads available datagrams, up to VY_UDP_BATCH
+static int32_t receive_batch(
+      /* in out */       vy_udp_receiver_type *rcv
+      )
+{
+   struct mmsghdr msgs[VY_UDP_BATCH];
+   struct iovec iov[VY_UDP_BATCH];
+   memset(msgs, 0, sizeof msgs);
+   for (uint32_t i=0; i<VY_UDP_BATCH; i++) {
+      iov[i].iov_base = &rcv->buf[i * VY_UDP_MAX_DATAGRAM];
+      iov[i].iov_len = VY_UDP_MAX_DATAGRAM;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+   int n = recvmmsg(rcv->sockfd, msgs, VY_UDP_BATCH, MSG_DONTWAIT, NULL);
+   rcv->stats.recv_calls++;
+   if (n < 0) {
+      if ((errno == EAGAIN) || (errno == EINTR)) {
+         return 0;
+      }
+      log_err(get_kernel_log(), "UDP receive error: %s", strerror(errno));
+      return -1;
+   }
+   const double t = now();
+   for (uint32_t i=0; i<(uint32_t) n; i++) {
+      if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+         rcv->stats.datagrams++;
+         rcv->stats.bad_datagrams++;
+         continue;
+      }
+      process_datagram(rcv, &rcv->buf[i * VY_UDP_MAX_DATAGRAM],
+            msgs[i].msg_len, t);
+   }
+   return 0;
+}
+
+int32_t vy_udp_next_frame(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const double timeout_sec,
+      /*    out */       vy_udp_frame_type **frame
+      )
+{
+   // frame handed on in previous call is no longer used
+   for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+      if (rcv->frames[i].state == VY_UDP_FRAME_HELD) {
+         rcv->frames[i].state = VY_UDP_FRAME_FREE;
+      }
+   }
+   const double end_sec = now() + timeout_sec;
+   while (1) {
+      const double t = now();
+      expire_frames(rcv, t);
+      vy_udp_frame_type *ready = first_ready_frame(rcv);
+      if (ready != NULL) {
+         ready->state = VY_UDP_FRAME_HELD;
+         *frame = ready;
+         return 0;
+      }
+      if (t >= end_sec) {
+         return 1;
+      }
+      // wait for datagrams, or until next frame deadline
+      double wait_sec = end_sec - t;
+      for (uint32_t i=0; i<VY_UDP_NUM_FRAMES; i++) {
+         const vy_udp_frame_type *f = &rcv->frames[i];
+         if (f->state == VY_UDP_FRAME_ASSEMBLING) {
+            const double dt = f->first_sec + rcv->deadline_sec - t;
+            if (dt < wait_sec) {
+               wait_sec = dt;
+            }
+         }
+      }
+      struct pollfd pfd = { .fd = rcv->sockfd, .events = POLLIN };
+      const int msec = wait_sec > 0.0 ? (int) ceil(wait_sec * 1000.0) : 0;
+      const int rc = poll(&pfd, 1, msec);
+      if (rc < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         log_err(get_kernel_log(), "UDP poll error: %s", strerror(errno));
+         return -1;
+      } else if (rc > 0) {
+         if (receive_batch(rcv) != 0) {
+            return -1;
+         }
+      }
+   }
+}
+
+void vy_udp_report(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in out */       log_info_type *log,
+      /* in     */ const char *name,
+      /* in     */ const uint32_t final
+      )
+{
+   const double t = now();
+   if ((final == 0) && (t - rcv->report_sec < VY_UDP_REPORT_SEC)) {
+      return;
+   }
+   vy_udp_stats_type *stats = &rcv->stats;
+   const uint32_t handed_on = stats->complete_frames + stats->partial_frames;
+   if ((handed_on + stats->dropped_frames + stats->datagrams) > 0) {
+      const double missing_pct = handed_on == 0 ? 0.0 :
+            100.0 * stats->missing_rows /
+            ((double) handed_on * VY_UDP_ROWS_PER_FRAME);
+      log_info(log, "%s udp: %d frames complete, %d partial, %d dropped, "
+            "%.3f%% rows missing. %d datagrams (%d late, %d bad), "
+            "%.1f per read", name, stats->complete_frames,
+            stats->partial_frames, stats->dropped_frames, missing_pct,
+            stats->datagrams, stats->late_datagrams, stats->bad_datagrams,
+            stats->recv_calls == 0 ? 0.0 :
+            (double) stats->datagrams / (double) stats->recv_calls);
+      char label[STR_LEN];
+      snprintf(label, STR_LEN, "%s reassembly", name);
+      log_latency_summary(log, &stats->assembly, label);
+   }
+   memset(stats, 0, sizeof *stats);
+   latency_reset(&stats->assembly);
+   rcv->report_sec = t;
+}
+
+// receiver
+////////////////////////////////////////////////////////////////////////
+
+#if defined(TEST_VY_UDP)
+
+#include <pthread.h>
+
+#define TEST_PORT          6871
+#define TEST_GROUP         "239.255.71.1"
+#define TEST_NUM_FRAMES    20
+
+static uint8_t pixel_value(
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const uint32_t plane,
+      /* in     */ const uint32_t row,
+      /* in     */ const uint32_t col
+      )
+{
+   return (uint8_t) (frame_id * 7 + plane * 101 + row * 3 + col);
+}
+
+static void fill_plane(
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const uint32_t plane,
+      /*    out */       uint8_t *chan
+      )
+{
+   for (uint32_t r=0; r<CAM_ROWS; r++) {
+      for (uint32_t c=0; c<CAM_COLS; c++) {
+         chan[c + r * CAM_COLS] = pixel_value(frame_id, plane, r, c);
+      }
+   }
+}
+
+// feeds datagram for one row directly to reassembly
+static void feed_row(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const uint32_t plane,
+      /* in     */ const uint32_t row
+      )
+{
+   uint8_t buf[VY_UDP_MAX_DATAGRAM];
+   vy_udp_header_type header;
+   fill_header(&header, frame_id, plane, row, 1, (double) frame_id,
+         (double) frame_id + 0.5);
+   memcpy(buf, &header, sizeof header);
+   for (uint32_t c=0; c<CAM_COLS; c++) {
+      buf[sizeof header + c] = pixel_value(frame_id, plane, row, c);
+   }
+   process_datagram(rcv, buf, (uint32_t) (sizeof header + CAM_COLS), now());
+}
+
+// feeds all rows of frame except those in skip_{v,y}, which are
+//    lists terminated by CAM_ROWS
+static void feed_frame(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const uint32_t *skip_v,
+      /* in     */ const uint32_t *skip_y
+      )
+{
+   for (uint32_t plane=0; plane<2; plane++) {
+      const uint32_t *skip = plane == VY_UDP_PLANE_V ? skip_v : skip_y;
+      // send rows in reverse order to check that order doesn't matter
+      for (int32_t r=CAM_ROWS-1; r>=0; r--) {
+         uint32_t skipped = 0;
+         for (uint32_t i=0; skip && (skip[i] < CAM_ROWS); i++) {
+            if (skip[i] == (uint32_t) r) {
+               skipped = 1;
+            }
+         }
+         if (skipped == 0) {
+            feed_row(rcv, frame_id, plane, (uint32_t) r);
+         }
+      }
+   }
+}
+
+// checks that row of frame has content of given source row
+static uint32_t check_row(
+      /* in     */ const vy_udp_frame_type *frame,
+      /* in     */ const uint32_t plane,
+      /* in     */ const uint32_t row,
+      /* in     */ const uint32_t src_row
+      )
+{
+   const uint8_t *chan = plane == VY_UDP_PLANE_V ?
+         frame->v_chan : frame->y_chan;
+   for (uint32_t c=0; c<CAM_COLS; c++) {
+      if (chan[c + row * CAM_COLS] !=
+            pixel_value(frame->frame_id, plane, src_row, c)) {
+         printf("    frame %d plane %d row %d doesn't match row %d\n",
+               frame->frame_id, plane, row, src_row);
+         return 1;
+      }
+   }
+   return 0;
+}
+
+static uint32_t check_next(
+      /* in out */       vy_udp_receiver_type *rcv,
+      /* in     */ const uint32_t frame_id,
+      /* in     */ const uint32_t missing_rows,
+      /*    out */       vy_udp_frame_type **frame
+      )
+{
+   if (vy_udp_next_frame(rcv, 0.5, frame) != 0) {
+      printf("    no frame when frame %d expected\n", frame_id);
+      return 1;
+   }
+   if (((*frame)->frame_id != frame_id) ||
+         ((*frame)->missing_rows != missing_rows)) {
+      printf("    got frame %d w/ %d missing rows, expected %d w/ %d\n",
+            (*frame)->frame_id, (*frame)->missing_rows, frame_id,
+            missing_rows);
+      return 1;
+   }
+   return 0;
+}
+
+static uint32_t test_reassembly(void)
+{
+   uint32_t errs = 0;
+   printf("Checking reassembly\n");
+   vy_udp_receiver_type *rcv = create_vy_udp_receiver(TEST_PORT, NULL, 0.1);
+   if (rcv == NULL) {
+      printf("  unable to create receiver\n");
+      return 1;
+   }
+   vy_udp_frame_type *frame;
+   // complete frame
+   feed_frame(rcv, 1, NULL, NULL);
+   errs += check_next(rcv, 1, 0, &frame);
+   errs += check_row(frame, VY_UDP_PLANE_V, 0, 0);
+   errs += check_row(frame, VY_UDP_PLANE_Y, CAM_ROWS-1, CAM_ROWS-1);
+   if ((frame->frame_request_time != 1.0) ||
+         (frame->frame_received_time != 1.5)) {
+      printf("    timestamps not passed through\n");
+      errs++;
+   }
+   // missing rows are filled from neighbors, after deadline
+   const uint32_t skip_v[] = { 10, 11, CAM_ROWS };
+   const uint32_t skip_y[] = { 0, CAM_ROWS };
+   feed_frame(rcv, 2, skip_v, skip_y);
+   const double t0 = now();
+   errs += check_next(rcv, 2, 3, &frame);
+   if (now() - t0 < 0.05) {
+      printf("    partial frame handed on before deadline\n");
+      errs++;
+   }
+   errs += check_row(frame, VY_UDP_PLANE_V, 11, 9);
+   errs += check_row(frame, VY_UDP_PLANE_Y, 0, 1);
+   // camera rows 0, 10 and 11 are missing a plane
+   for (uint32_t r=0; r<CAM_ROWS; r++) {
+      const uint8_t expected = ((r == 0) || (r == 10) || (r == 11)) ? 1 : 0;
+      if (frame->row_missing[r] != expected) {
+         printf("    row %d missing flag is %d, expected %d\n", r,
+               frame->row_missing[r], expected);
+         errs++;
+         break;
+      }
+   }
+   // datagram for frame that was handed on is late
+   feed_row(rcv, 2, VY_UDP_PLANE_V, 10);
+   if (rcv->stats.late_datagrams != 1) {
+      printf("    late datagram not detected\n");
+      errs++;
+   }
+   // finishing newer frame ends wait for older one
+   feed_frame(rcv, 3, skip_v, NULL);
+   feed_frame(rcv, 4, NULL, NULL);
+   errs += check_next(rcv, 3, 2, &frame);
+   errs += check_next(rcv, 4, 0, &frame);
+   // frame missing most rows is dropped
+   for (uint32_t r=0; r<CAM_ROWS/3; r++) {
+      feed_row(rcv, 5, VY_UDP_PLANE_V, r);
+      feed_row(rcv, 5, VY_UDP_PLANE_Y, r);
+   }
+   if (vy_udp_next_frame(rcv, 0.3, &frame) != 1) {
+      printf("    frame w/ most rows missing wasn't dropped\n");
+      errs++;
+   }
+   if ((rcv->stats.complete_frames != 2) || (rcv->stats.partial_frames != 2)
+         || (rcv->stats.dropped_frames != 1)) {
+      printf("    stats: %d complete, %d partial, %d dropped. expected "
+            "2, 2, 1\n", rcv->stats.complete_frames,
+            rcv->stats.partial_frames, rcv->stats.dropped_frames);
+      errs++;
+   }
+   // sender restarts its count
+   feed_frame(rcv, 900, NULL, NULL);
+   feed_frame(rcv, 0, NULL, NULL);
+   errs += check_next(rcv, 900, 0, &frame);
+   errs += check_next(rcv, 0, 0, &frame);
+   free_vy_udp_receiver(rcv);
+   return errs;
+}
+
+struct test_sender {
+   const char *ip;
+   uint64_t calls;
+   int32_t rc;
+};
+
+static void * send_frames(void *arg)
+{
+   struct test_sender *ts = (struct test_sender*) arg;
+   network_id_type target;
+   strcpy(target.ip, ts->ip);
+   target.port = TEST_PORT;
+   ts->rc = -1;
+   int sockfd = vy_udp_open_sender(&target);
+   if (sockfd < 0) {
+      return NULL;
+   }
+   uint8_t *v = malloc(CAM_N_PIX);
+   uint8_t *y = malloc(CAM_N_PIX);
+   // give receiver time to start
+   usleep(20000);
+   for (uint32_t i=0; i<TEST_NUM_FRAMES; i++) {
+      fill_plane(i, VY_UDP_PLANE_V, v);
+      fill_plane(i, VY_UDP_PLANE_Y, y);
+      if (vy_udp_send_frame(sockfd, i, (double) i, (double) i + 0.5, v, y,
+            &ts->calls) != 0) {
+         goto end;
+      }
+      usleep(30000);
+   }
+   ts->rc = 0;
+end:
+   close(sockfd);
+   free(v);
+   free(y);
+   return NULL;
+}
+
+static uint32_t test_stream(
+      /* in     */ const char *ip,
+      /* in     */ const char *group
+      )
+{
+   uint32_t errs = 0;
+   vy_udp_receiver_type *rcv =
+         create_vy_udp_receiver(TEST_PORT, group, 0.1);
+   if (rcv == NULL) {
+      if (group != NULL) {
+         printf("  multicast not available. skipping\n");
+         return 0;
+      }
+      printf("  unable to create receiver\n");
+      return 1;
+   }
+   struct test_sender ts = { .ip = ip, .calls = 0, .rc = 0 };
+   pthread_t tid;
+   pthread_create(&tid, NULL, send_frames, &ts);
+   uint32_t num_frames = 0;
+   vy_udp_frame_type *frame;
+   while (vy_udp_next_frame(rcv, 0.5, &frame) == 0) {
+      if (frame->missing_rows == 0) {
+         errs += check_row(frame, VY_UDP_PLANE_V, 0, 0);
+         errs += check_row(frame, VY_UDP_PLANE_Y, CAM_ROWS/2, CAM_ROWS/2);
+      }
+      num_frames++;
+   }
+   pthread_join(tid, NULL);
+   if (ts.rc != 0) {
+      printf("  sender failed\n");
+      errs++;
+   }
+   printf("  %d of %d frames, %d complete. %.1f datagrams per send, "
+         "%.1f per read\n", num_frames, TEST_NUM_FRAMES,
+         rcv->stats.complete_frames, ts.calls == 0 ? 0.0 :
+         (double) TEST_NUM_FRAMES * VY_UDP_ROWS_PER_FRAME / (double) ts.calls,
+         rcv->stats.recv_calls == 0 ? 0.0 : (double) rcv->stats.datagrams /
+         (double) rcv->stats.recv_calls);
+   // loopback shouldn't lose anything
+   if (rcv->stats.complete_frames != TEST_NUM_FRAMES) {
+      errs++;
+   }
+   vy_udp_report(rcv, get_kernel_log(), "test", 1);
+   free_vy_udp_receiver(rcv);
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   set_log_dir_string("/tmp/");
+   init_timekeeper();
+   errs += test_reassembly();
+   printf("Checking loopback stream\n");
+   errs += test_stream("127.0.0.1", NULL);
+   printf("Checking multicast stream\n");
+   errs += test_stream(TEST_GROUP, TEST_GROUP);
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}
+
+#endif   // TEST_VY_UDP
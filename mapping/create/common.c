@@ -603,6 +603,154 @@ static double get_deg_per_nm(
 }
 
 
+// returns 1 if map row or column is in band, 0 otherwise
+static int32_t in_map_band(
+      /* in     */ const uint32_t pos,
+      /* in     */ const uint16_t start,
+      /* in     */ const uint16_t end
+      )
+{
+   return ((pos >= start) && (pos < end)) ? 1 : 0;
+}
+
+
+// copies content from loaded map buffers (ie, for grid map_x,map_y)
+//    to output map. if region is non-NULL, only output squares in the
+//    region are written
+static void project_grid_to_60x60_map(
+      /* in     */ const akn_position_type center,
+      /* in     */ const int32_t map_x,
+      /* in     */ const int32_t map_y,
+      /* in     */ const map_level3_region_type *region,
+      /* in out */       map_level3_type *map
+      )
+{
+   for (uint32_t y=0; y<720; y++) {
+      // get latitude -- this is the top of the input map grid
+      //    plus 1/720 for each row, as 1-deg grid is 720 rows high
+      //    and akn_deg value is increasing going down
+      akn_position_type in_akn_deg;
+      in_akn_deg.akn_y = (double) map_y + (double) y / 720.0;
+      // offset from this akn-lat to input grid top
+      double dy_deg = in_akn_deg.akn_y - center.akn_lat;
+      if (fabs(dy_deg) >= 0.5) {
+         // row is outside of output map (output map is 1.0 deg tall)
+         if (dy_deg >= 0.5) {
+            // below the bottom -- nothing left to do
+            break;
+         }
+         continue;
+      }
+      // get output map row
+      map_coordinate_type out_map_pos;
+      if (convert_akn_to_map_row(in_akn_deg, center,
+            &out_map_pos.y) != 0) {
+         continue;
+      }
+      assert(out_map_pos.y < 720);  // y is unsigned, so no neg check
+      // get adjustment scale for converting lon degs to lat degs
+      //    at this latitude
+      double scale = cos(D2R * (in_akn_deg.akn_y - 90.0));
+//printf(" in_akn_y_deg %.6f  out_y_row %d\n", in_akn_deg.akn_y, out_map_pos.y);
+      // if only some columns of this row are being updated, start at
+      //    the input column just left of the first one of those
+      int32_t full_row = 1;
+      uint32_t x_start = 0;
+      if ((region != NULL) && (in_map_band(out_map_pos.y,
+            region->row_start, region->row_end) == 0)) {
+         if (region->col_start >= region->col_end) {
+            continue;
+         }
+         full_row = 0;
+         // column is rounded from position, so back off one column
+         double dx_nm = ((double) region->col_start - 1.0) /
+               (double) (MAP_LEVEL3_SIZE / 60) - 30.0;
+         double start_deg = center.akn_lon + dx_nm / (scale * 60.0);
+         double start_x = floor((start_deg - (double) map_x) * 720.0) - 1.0;
+         if (start_x >= 720.0) {
+            continue;
+         } else if (start_x > 0.0) {
+            x_start = (uint32_t) start_x;
+         }
+      }
+      //
+      for (uint32_t x=x_start; x<720; x++) {
+         in_akn_deg.akn_x = (double) map_x + (double) x / 720.0;
+//printf("  in %.3f,%.3f   left %.3f   x %d\n", in_akn_deg.akn_x, in_akn_deg.akn_y, left_akn_deg, x);
+         // measure horizontal offet from input grid square to present
+         //    location
+         // left_akn_deg and in_x_akn_deg are in AKN coords
+         double dx_deg = in_akn_deg.akn_x - center.akn_lon;
+         // convert deg offset to NMs by converting to equivalent lat
+         //    and *60 from lat degs to NM
+         double dx_nm = scale * dx_deg * 60.0;
+//printf("    dx_deg %.4f    dx_nm %.6f\n", dx_deg, dx_nm);
+         if (fabs(dx_nm) < 30.0) {
+            // position is in output map. push depth value to map
+            if (convert_akn_to_map_column(in_akn_deg, center,
+                  scale, &out_map_pos.x) != 0) {
+//printf("      out of bounds  in_deg %.4f  ctr_deg %.4f\n", in_akn_deg.akn_lon, center.akn_lon);
+               continue;
+            }
+            assert(out_map_pos.x < 720);
+            if (full_row == 0) {
+               if (out_map_pos.x < region->col_start) {
+                  continue;
+               } else if (out_map_pos.x >= region->col_end) {
+                  break;
+               }
+            }
+//printf("      pos %d\n", out_map_pos.x);
+            uint32_t out_idx =
+                  (uint32_t) (out_map_pos.x + out_map_pos.y * 720);
+            // if output map point is unknown, set it to depth from this
+            //    input map point. otherwise, select higher value from
+            //    both to store in output map
+            uint8_t depth = get_depth_from_buffers(x, y);
+            uint8_t existing_depth = map->grid[out_idx].min_depth;
+//printf("    out %d,%d (%d)  exist %d   depth %d\n", out_map_pos.x, out_map_pos.y, out_idx, existing_depth, depth);
+
+
+            // if existing depth unknown, or this is shallower
+            //    than previous min depth, update depth
+            if ((existing_depth == 255) || (depth < existing_depth)) {
+               map->grid[out_idx].min_depth = depth;
+            }
+         } else if (dx_nm >= 30.0) {
+            // to right of output map. nothing more to do this row
+//printf("    dx_nm = %.3f\n", dx_nm);
+            break;
+         }
+      }
+   }
+}
+
+
+// loads map buffers for grid map_x,map_y (akn degrees, map_x unwrapped)
+static void load_grid_buffers(
+      /* in     */ const char *root_dir,
+      /* in     */ const int32_t map_x,
+      /* in     */ const int32_t map_y
+      )
+{
+   map_grid_num_type pos_akn;
+   pos_akn.akn_y = (uint16_t) map_y;
+   if (map_x < 0) {
+      pos_akn.akn_x = (uint16_t) (map_x + 360);
+   } else if (map_x >= 360) {
+      pos_akn.akn_x = (uint16_t) (map_x - 360);
+   } else {
+      pos_akn.akn_x = (uint16_t) map_x;
+   }
+   if (load_map_buffers(root_dir, pos_akn) != 0) {
+      fprintf(stderr, "Failed to load map buffers\n");
+      // TODO handle error better -- this is an internal error
+      //    and ought to be fatal
+      assert(1 == 0);
+   }
+}
+
+
 // builds 60x60nm map w/ data from all map levels, centered at latlon
 // data stored in 'map' (which cannot be NULL). if an error occurs during
 //    loading, return value is NULL, otherwise it's 'map'
@@ -646,98 +794,95 @@ map_level3_type * build_60x60_map(
    //    to grid's left/top bounds
    for (int32_t map_y=top_akn_deg_int; map_y<=top_akn_deg_int+1; map_y++) {
 //printf("MAP Y %d\n", map_y);
-      map_grid_num_type pos_akn;
-      pos_akn.akn_y = (uint16_t) map_y;
       for (int32_t map_x=left_akn_deg_int; map_x<=right_akn_deg_int; map_x++) {
 //printf("  MAP X %d\n", map_x);
-         if (map_x < 0) {
-            pos_akn.akn_x = (uint16_t) (map_x + 360);
-         } else if (map_x >= 360) {
-            pos_akn.akn_x = (uint16_t) (map_x - 360);
-         } else {
-            pos_akn.akn_x = (uint16_t) map_x;
-         }
-         if (load_map_buffers(root_dir, pos_akn) != 0) {
-            fprintf(stderr, "Failed to load map buffers\n");
-            // TODO handle error better -- this is an internal error
-            //    and ought to be fatal
-            assert(1 == 0);
-         }
+         load_grid_buffers(root_dir, map_x, map_y);
          // copy content from input map buffers to output map
-         for (uint32_t y=0; y<720; y++) {
-            // get latitude -- this is the top of the input map grid
-            //    plus 1/720 for each row, as 1-deg grid is 720 rows high
-            //    and akn_deg value is increasing going down
-            akn_position_type in_akn_deg;
-            in_akn_deg.akn_y = (double) map_y + (double) y / 720.0;
-            // offset from this akn-lat to input grid top
-            double dy_deg = in_akn_deg.akn_y - center.akn_lat;
-            if (fabs(dy_deg) >= 0.5) {
-               // row is outside of output map (output map is 1.0 deg tall)
-               if (dy_deg >= 0.5) {
-                  // below the bottom -- nothing left to do
-                  break;
-               }
-               continue;
-            }
-            // get output map row
-            map_coordinate_type out_map_pos;
-            if (convert_akn_to_map_row(in_akn_deg, center,
-                  &out_map_pos.y) != 0) {
-               continue;
-            }
-            assert(out_map_pos.y < 720);  // y is unsigned, so no neg check
-            // get adjustment scale for converting lon degs to lat degs
-            //    at this latitude
-            double scale = cos(D2R * (in_akn_deg.akn_y - 90.0));
-//printf(" in_akn_y_deg %.6f  out_y_row %d\n", in_akn_deg.akn_y, out_map_pos.y);
-            //
-            for (uint32_t x=0; x<720; x++) {
-               in_akn_deg.akn_x = (double) map_x + (double) x / 720.0;
-//printf("  in %.3f,%.3f   left %.3f   x %d\n", in_akn_deg.akn_x, in_akn_deg.akn_y, left_akn_deg, x);
-               // measure horizontal offet from input grid square to present
-               //    location
-               // left_akn_deg and in_x_akn_deg are in AKN coords
-               double dx_deg = in_akn_deg.akn_x - center.akn_lon;
-               // convert deg offset to NMs by converting to equivalent lat
-               //    and *60 from lat degs to NM
-               double dx_nm = scale * dx_deg * 60.0;
-//printf("    dx_deg %.4f    dx_nm %.6f\n", dx_deg, dx_nm);
-               if (fabs(dx_nm) < 30.0) {
-                  // position is in output map. push depth value to map
-                  if (convert_akn_to_map_column(in_akn_deg, center,
-                        scale, &out_map_pos.x) != 0) {
-//printf("      out of bounds  in_deg %.4f  ctr_deg %.4f\n", in_akn_deg.akn_lon, center.akn_lon);
-                     continue;
-                  }
-                  assert(out_map_pos.x < 720);
-//printf("      pos %d\n", out_map_pos.x);
-                  uint32_t out_idx =
-                        (uint32_t) (out_map_pos.x + out_map_pos.y * 720);
-                  // if output map point is unknown, set it to depth from this
-                  //    input map point. otherwise, select higher value from
-                  //    both to store in output map
-                  uint8_t depth = get_depth_from_buffers(x, y);
-                  uint8_t existing_depth = map->grid[out_idx].min_depth;
-//printf("    out %d,%d (%d)  exist %d   depth %d\n", out_map_pos.x, out_map_pos.y, out_idx, existing_depth, depth);
+         project_grid_to_60x60_map(center, map_x, map_y, NULL, map);
+      }
+   }
+   /////////////////////////////////////////////////////////////////////
+end:
+   return map;
+}
 
 
-                  // if existing depth unknown, or this is shallower
-                  //    than previous min depth, update depth
-                  if ((existing_depth == 255) || (depth < existing_depth)) {
-                     map->grid[out_idx].min_depth = depth;
-                  }
-               } else if (dx_nm >= 30.0) {
-                  // to right of output map. nothing more to do this row
-//printf("    dx_nm = %.3f\n", dx_nm);
-                  break;
-               }
-            }
-         }
+// reloads region of 60x60nm map centered at latlon. squares in the
+//    region are set to unknown depth and then filled from map levels,
+//    as in build_60x60_map(). squares outside of region are untouched
+// returns 'map', or NULL if map is near a pole (use build_60x60_map()
+//    there as the whole map has a fixed value)
+map_level3_type * update_60x60_map_region(
+      /* in     */ const char *root_dir,
+      /* in     */ const world_coordinate_type latlon,
+      /* in     */ const map_level3_region_type *region,
+      /* in out */       map_level3_type *map
+      )
+{
+   if ((latlon.lat > 87.0) || (latlon.lat < -84.0)) {
+      return NULL;
+   }
+   const int32_t full_rows = region->row_start < region->row_end;
+   const int32_t full_cols = region->col_start < region->col_end;
+   // reset region to unknown depth
+   for (uint32_t y=0; y<720; y++) {
+      map_level3_square_type *row = &map->grid[y * 720];
+      if (full_rows && in_map_band(y, region->row_start, region->row_end)) {
+         memset(row, 255, 720 * sizeof *row);
+      } else if (full_cols) {
+         memset(&row[region->col_start], 255,
+               (uint32_t) (region->col_end - region->col_start) *
+               sizeof *row);
       }
    }
    /////////////////////////////////////////////////////////////////////
-end:
+   // grid bounds are the same as for the full map. grids that don't
+   //    contribute to the region aren't loaded
+   double deg_per_nm = get_deg_per_nm(latlon);
+   const akn_position_type center = convert_latlon_to_akn(latlon);
+   // lateral extent of column band. degrees per NM is largest at the
+   //    map's far edge (from equator) and smallest at its near edge, so
+   //    take the union of both. add a column/row of margin to each
+   //    band as output position is rounded
+   double near_lat = fabs(latlon.lat) - 0.5;
+   if (near_lat < 0.0) {
+      near_lat = 0.0;
+   }
+   const double near_deg_per_nm = 1.0 / (60.0 * cos(D2R * near_lat));
+   const double band_left_nm = ((double) region->col_start - 1.0) /
+         (double) (MAP_LEVEL3_SIZE / 60) - 30.0;
+   const double band_right_nm = ((double) region->col_end + 1.0) /
+         (double) (MAP_LEVEL3_SIZE / 60) - 30.0;
+   const double band_left_deg = center.akn_lon +
+         fmin(band_left_nm * deg_per_nm, band_left_nm * near_deg_per_nm);
+   const double band_right_deg = center.akn_lon +
+         fmax(band_right_nm * deg_per_nm, band_right_nm * near_deg_per_nm);
+   // vertical extent of row band
+   const double band_top_deg = center.akn_lat - 0.5 +
+         ((double) region->row_start - 1.0) / (double) MAP_LEVEL3_SIZE;
+   const double band_bottom_deg = center.akn_lat - 0.5 +
+         ((double) region->row_end + 1.0) / (double) MAP_LEVEL3_SIZE;
+   const int32_t left_akn_deg_int =
+         (int32_t) floor(center.akn_lon - deg_per_nm * 30.0);
+   const int32_t right_akn_deg_int =
+         (int32_t) ceil(center.akn_lon + deg_per_nm * 30.0);
+   const int32_t top_akn_deg_int = (int32_t) floor(center.akn_lat - 0.5);
+   for (int32_t map_y=top_akn_deg_int; map_y<=top_akn_deg_int+1; map_y++) {
+      // rows in grid that are in row band
+      const int32_t rows_hit = full_rows &&
+            (band_top_deg < (double) (map_y + 1)) &&
+            (band_bottom_deg > (double) map_y);
+      for (int32_t map_x=left_akn_deg_int; map_x<=right_akn_deg_int; map_x++) {
+         const int32_t cols_hit = full_cols &&
+               (band_left_deg < (double) (map_x + 1)) &&
+               (band_right_deg > (double) map_x);
+         if (!rows_hit && !cols_hit) {
+            continue;
+         }
+         load_grid_buffers(root_dir, map_x, map_y);
+         project_grid_to_60x60_map(center, map_x, map_y, region, map);
+      }
+   }
    return map;
 }
 
@@ -94,7 +94,32 @@ typedef struct beacon_record beacon_record_type;
 _Static_assert(sizeof(beacon_record_type) == BEACON_BIN_RECORD_SIZE_BYTES,
       "Beacon record size is wrong. Reading beacon.bin should fail");
 
-#define BEACON_STACK_SIZE        16384
+// path-map nodes per degree. path weight is ~1 per node
+#define BEACON_PATH_NODES_PER_DEG            720.0
+
+// beacon graph search is directed toward the vessel, using as a lower
+//    bound on path weight the great-circle distance times this value.
+//    path weight is ~1 per path-map node and less along diagonals
+//    (1.25 per 1.41 nodes), minus up to 0.05 jitter per link, so
+//    it's never less than ~0.85 per node. the closer this is to the
+//    real weight, the fewer beacons off the route get expanded
+#define BEACON_SEARCH_MIN_WEIGHT_PER_DEG     \
+      (0.84 * BEACON_PATH_NODES_PER_DEG)
+
+// beacons w/in this distance of the vessel are goals for the search,
+//    as they're what will appear in a path map around it
+#define BEACON_SEARCH_GOAL_RADIUS_DEG        0.5
+
+// after a goal is reached, search continues until the best remaining
+//    estimate of route weight exceeds the goal's by the weight of this
+//    distance. beacons reached by then form a corridor around the route.
+//    others get no weight
+#define BEACON_CORRIDOR_MARGIN_DEG           2.0
+
+// a heap expansion costs ~3 times what a FIFO flood's does. if the
+//    corridor search expands more than this fraction of all beacons, it
+//    finishes as a flood over the whole graph instead
+#define BEACON_SEARCH_MAX_EXPAND_FRAC        0.05
 
 
 // the index file holds the offset for the first record in each row
@@ -110,6 +135,46 @@ _Static_assert(sizeof(beacon_index_record_type) ==
       BEACON_IDX_RECORD_SIZE_BYTES,
       "Beacon idx record size is wrong. Reading beacon.idx should fail");
 
+////////////////////////////////////////////////////////////////////////
+// beacon grid file
+
+// spatial index over beacon.bin records. world is divided into cells
+//    that are BEACON_GRID_CELL_DEG on a side in akn coordinates.
+//    a bounding-box query only reads entries from cells that overlap
+//    the box
+// file layout (host byte order)
+//    beacon_grid_header
+//    uint32 offset of first entry of each cell, row-major, plus one
+//       extra holding the total number of entries
+//    beacon_grid_entry[num_entries], sorted by cell
+// entries store beacon position so a query can be filtered w/o reading
+//    the 80-byte beacon records
+#define BEACON_GRID_MAGIC     0x4449524bu    // "KRID"
+#define BEACON_GRID_VERSION   1u
+
+#define BEACON_GRID_CELL_DEG  0.5
+#define BEACON_GRID_COLS      720
+#define BEACON_GRID_ROWS      360
+
+struct beacon_grid_header {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t cols;
+   uint32_t rows;
+   // number of beacons in beacon.bin. index is stale if this doesn't
+   //    match
+   uint32_t num_entries;
+   uint32_t reserved;
+};
+typedef struct beacon_grid_header beacon_grid_header_type;
+
+struct beacon_grid_entry {
+   uint32_t index;   // record number in beacon.bin
+   float akn_x;
+   float akn_y;
+};
+typedef struct beacon_grid_entry beacon_grid_entry_type;
+
 ////////////////////////////////////////////////////////////////////////
 
 struct world_map;
@@ -136,6 +201,13 @@ beacon_record_type * get_beacon_record(
       /* in     */ const uint32_t idx
       );
 
+// returns index of beacon grid cell that position is in, with rows
+//    running north to south
+uint32_t get_beacon_grid_cell(
+      /* in     */ const double akn_x,
+      /* in     */ const double akn_y
+      );
+
 // find which beacons are in world/path map. store reference to them
 //    in the path map, including where they appear and what their
 //    weights are
@@ -143,5 +215,14 @@ void load_beacons_into_path_map(
       /* in out */       path_map_type *path_map
       );
 
+// reruns beacon graph search toward vessel's present position, using
+//    the beacon seeds from the destination trace, and updates weights
+//    of beacons in the path map. for when the vessel has left the
+//    corridor of beacons that have weights
+void update_beacon_corridor(
+      /* in out */       path_map_type *path_map,
+      /* in     */ const world_coordinate_type vessel_pos
+      );
+
 #endif   // BEACON_H
 
@@ -41,6 +41,8 @@ extern const char GEBCO_FILES[8][128];
 
 #define BEACON_FILE        "beacons.bin"
 #define BEACON_IDX_FILE    "beacons.idx"
+// spatial index of beacons.bin, built by pharos/index_beacons
+#define BEACON_GRID_FILE   "beacons.grid"
 
 // top-left coordinates of each section file
 extern const uint32_t GEBCO_TOP[8];
@@ -204,6 +206,17 @@ struct map_level3 {
 };
 typedef struct map_level3 map_level3_type;
 
+// part of a level-3 map that's reloaded when map is recentered: all
+//    columns of rows [row_start,row_end) and all rows of columns
+//    [col_start,col_end). a band is empty when start >= end
+struct map_level3_region {
+   uint16_t row_start;
+   uint16_t row_end;
+   uint16_t col_start;
+   uint16_t col_end;
+};
+typedef struct map_level3_region map_level3_region_type;
+
 //
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -296,6 +309,16 @@ map_level3_type * build_60x60_map(
       /* in out */       map_level3_type *map
       );
 
+// reloads region of 60x60nm map centered at latlon, leaving rest of
+//    map untouched. returns NULL if map is near a pole, in which case
+//    build_60x60_map() should be used
+map_level3_type * update_60x60_map_region(
+      /* in     */ const char *root_dir,
+      /* in     */ const world_coordinate_type latlon,
+      /* in     */ const map_level3_region_type *region,
+      /* in out */       map_level3_type *map
+      );
+
 
 // convert depth, in meters, to value stored in submaps, and convert
 //    back again
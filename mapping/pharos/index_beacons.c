@@ -0,0 +1,177 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "routing/mapping.h"
+#include "world_map.h"
+#include "beacon.h"
+#include "logger.h"
+
+// builds beacons.grid, the spatial index that the path map uses to find
+//    beacons near the map center. must be rerun whenever beacons.bin
+//    changes
+
+#define DEFAULT_MAP_FOLDER    "/opt/kharon/mapping/master/"
+
+static char map_folder_[STR_LEN] = { DEFAULT_MAP_FOLDER };
+
+
+static void verify_setup(void)
+{
+   // make sure folder name ends with '/'
+   size_t len = strlen(map_folder_);
+   if (len > 200) {
+      fprintf(stderr, "Folder name is too long\n");
+      goto err;
+   }
+   if (len == 0) {
+      fprintf(stderr, "Folder name is missing\n");
+      goto err;
+   }
+   if (map_folder_[len-1] != '/') {
+      map_folder_[len] = '/';
+      map_folder_[len+1] = 0;
+   }
+   set_world_map_folder_name(map_folder_);
+   return;
+err:
+   exit(1);
+}
+
+static void parse_command_line(int argc, char *argv[])
+{
+   int opt;
+   while ((opt = getopt(argc, argv, "f:h")) != -1) {
+      switch (opt) {
+         case 'f':
+         {
+            const char *name = optarg;
+            strncpy(map_folder_, name, STR_LEN);
+            break;
+         }
+         case 'h':
+            goto usage;
+         default:
+            goto usage;
+      };
+   };
+   // check extra arguments -- there should be none
+   if (optind < argc) {
+      goto usage;
+   }
+   verify_setup();
+   return;
+   /////////////////////////////////////////////
+usage:
+   printf("Builds spatial index of beacons in %s, storing it in %s in "
+         "the same folder\n", BEACON_FILE, BEACON_GRID_FILE);
+   printf("\n");
+   printf("Usage: %s [-f <map folder>] [-h]\n", argv[0]);
+   printf("\n");
+   printf("where:\n");
+   printf("   f   folder where beacon data is stored (default: %s)\n",
+         DEFAULT_MAP_FOLDER);
+   printf("   h   prints this output (ie, help)\n");
+   exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+   int rc = -1;
+   set_log_dir_string("/tmp/");
+   parse_command_line(argc, argv);
+   uint32_t *offsets = NULL;
+   uint32_t *fill = NULL;
+   beacon_grid_entry_type *entries = NULL;
+   FILE *ofp = NULL;
+   if (init_beacon_list() != 0) {
+      fprintf(stderr, "Unable to load beacons from '%s'\n", map_folder_);
+      goto end;
+   }
+   const uint32_t num_beacons = get_tot_num_beacons();
+   const uint32_t num_cells = BEACON_GRID_COLS * BEACON_GRID_ROWS;
+   offsets = calloc(num_cells + 1, sizeof *offsets);
+   fill = calloc(num_cells, sizeof *fill);
+   entries = malloc(num_beacons * sizeof *entries);
+   /////////////////////////////////////////////
+   // counting sort of beacons into cells
+   for (uint32_t i=0; i<num_beacons; i++) {
+      const beacon_record_type *rec = get_beacon_record(i);
+      offsets[get_beacon_grid_cell(rec->akn_x, rec->akn_y) + 1]++;
+   }
+   for (uint32_t i=0; i<num_cells; i++) {
+      offsets[i+1] += offsets[i];
+   }
+   for (uint32_t i=0; i<num_beacons; i++) {
+      const beacon_record_type *rec = get_beacon_record(i);
+      uint32_t cell = get_beacon_grid_cell(rec->akn_x, rec->akn_y);
+      beacon_grid_entry_type *entry = &entries[offsets[cell] + fill[cell]];
+      entry->index = i;
+      entry->akn_x = rec->akn_x;
+      entry->akn_y = rec->akn_y;
+      fill[cell]++;
+   }
+   /////////////////////////////////////////////
+   char grid_name[STR_LEN];
+   snprintf(grid_name, STR_LEN, "%s%s", map_folder_, BEACON_GRID_FILE);
+   ofp = fopen(grid_name, "wb");
+   if (!ofp) {
+      fprintf(stderr, "Unable to open '%s': %s\n", grid_name,
+            strerror(errno));
+      goto end;
+   }
+   beacon_grid_header_type header = {
+         .magic = BEACON_GRID_MAGIC,
+         .version = BEACON_GRID_VERSION,
+         .cols = BEACON_GRID_COLS,
+         .rows = BEACON_GRID_ROWS,
+         .num_entries = num_beacons,
+         .reserved = 0
+   };
+   if ((fwrite(&header, sizeof header, 1, ofp) != 1) ||
+         (fwrite(offsets, (num_cells + 1) * sizeof *offsets, 1, ofp) != 1) ||
+         ((num_beacons > 0) &&
+         (fwrite(entries, num_beacons * sizeof *entries, 1, ofp) != 1))) {
+      fprintf(stderr, "Error writing '%s': %s\n", grid_name,
+            strerror(errno));
+      goto end;
+   }
+   uint32_t occupied = 0;
+   uint32_t max_per_cell = 0;
+   for (uint32_t i=0; i<num_cells; i++) {
+      if (fill[i] > 0) {
+         occupied++;
+      }
+      if (fill[i] > max_per_cell) {
+         max_per_cell = fill[i];
+      }
+   }
+   printf("Indexed %d beacons in %d cells (max %d per cell) to '%s'\n",
+         num_beacons, occupied, max_per_cell, grid_name);
+   rc = 0;
+end:
+   if (ofp)       { fclose(ofp);       }
+   if (offsets)   { free(offsets);     }
+   if (fill)      { free(fill);        }
+   if (entries)   { free(entries);     }
+   return rc;
+}
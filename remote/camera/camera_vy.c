@@ -101,6 +101,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "RaspiGPS.h"
 
 #include "pinet.h"
+#include "vy_udp.h"
 #include "lin_alg.h"
 #include "dev_info.h"
 #include "mem.h"
@@ -291,7 +292,12 @@ static int s_buffer_avail = 0;
 
 static int s_shutdown = 0; // flag to indicate if comm thread should eit
 static int s_connfd = -1;  // socket connection descriptor
+static int s_use_udp = 0;  // 1 if s_connfd is UDP socket (see vy_udp.h)
 static int s_comm_error = 0;  // local equiv of errno
+// frames sent and syscalls used to send them
+static uint32_t s_frames_sent = 0;
+static uint64_t s_send_calls = 0;
+#define COMM_REPORT_FRAMES    300
 
 MMAL_PORT_T *s_camera_video_port = NULL;
 
@@ -364,9 +370,7 @@ static void comm_set_socket(int connfd)
 // thread main
 // on communication error, s_comm_error is set
 //    0 is no error
-//    1 means error occurred when sending header
-//    2 means error occurred when sending body, part 1
-//    3 means error occurred when sending body, part 2
+//    -1 means error occurred when sending frame
 static void * communication_main(void * not_used)
 {
    pthread_mutex_init(&s_frame_mutex, NULL);
@@ -400,25 +404,34 @@ static void * communication_main(void * not_used)
 //printf("sending %dx%d yv data at %.4f (%.4f)\n", VY_COLS_NET_TOT, VY_ROWS_NET_TOT, now(), s_frame_timestamp);
 double t1 = now();
 //printf(".. %ld bytes\n", sizeof(header));
-      if (send_block(s_connfd, &header, sizeof(header)) < 0) {
-         fprintf(stderr, "Network error sending header packet\n");
-         s_comm_error = -1;
-         s_shutdown = 1;
-         break;
-      }
-      // send body, part 1 (ie, V channel)
-      if (send_block(s_connfd, s_v_frame_buffer, CAM_N_PIX) < 0) {
-         fprintf(stderr, "Error sending part 1 of VY image frame\n");
-         s_comm_error = -2;
-         s_shutdown = 1;
-         break;
+      if (s_use_udp) {
+         // frame count is frame ID. receiver uses it to reassemble
+         if (vy_udp_send_frame(s_connfd, s_frames_sent, s_frame_start_copy,
+               s_frame_timestamp, s_v_frame_buffer, s_y_frame_buffer,
+               &s_send_calls) != 0) {
+            fprintf(stderr, "Network error sending VY image frame\n");
+            s_comm_error = -1;
+            s_shutdown = 1;
+            break;
+         }
+      } else {
+         // send header, V channel and Y channel together
+         struct iovec iov[3] = {
+               { .iov_base = &header, .iov_len = sizeof(header) },
+               { .iov_base = s_v_frame_buffer, .iov_len = CAM_N_PIX },
+               { .iov_base = s_y_frame_buffer, .iov_len = CAM_N_PIX }
+         };
+         if (send_blockv(s_connfd, iov, 3, &s_send_calls) < 0) {
+            fprintf(stderr, "Network error sending VY image frame\n");
+            s_comm_error = -1;
+            s_shutdown = 1;
+            break;
+         }
       }
-      // send Y
-      if (send_block(s_connfd, s_y_frame_buffer, CAM_N_PIX) < 0) {
-         fprintf(stderr, "Error sending part 2 of VY image frame\n");
-         s_comm_error = -3;
-         s_shutdown = 1;
-         break;
+      s_frames_sent++;
+      if ((s_frames_sent % COMM_REPORT_FRAMES) == 0) {
+         printf("Sent %d frames, %.2f syscalls per frame\n", s_frames_sent,
+               (double) s_send_calls / (double) s_frames_sent);
       }
       // signal frame broadcast is complete
       // this doesn't have to be protected by mutex as variable can't
@@ -1223,6 +1236,88 @@ static int wait_for_next_change(RASPIVIDYUV_STATE *state)
 /**
  * main
  */
+// connects to receiver and does handshake. returns socket, or -1 on
+//    error
+static int open_tcp_stream(void)
+{
+   struct network_id net_id;
+   int connfd;
+   if (resolve_sensor_endpoint("camera_endpoint", &net_id) != 0) {
+      fprintf(stderr, "Unable to find network target\n");
+      return -1;
+   }
+   printf("Network target is %s:%d\n", net_id.ip, net_id.port);
+   connfd = connect_to_server(&net_id);
+//printf("connected to server\n");
+   if (connfd < 0) {
+      vcos_log_error("%s: Error opening network connection for "
+            "camera\n", __func__);
+      vcos_log_error("Tried to connect to %s::%d\n",
+            net_id.ip, net_id.port);
+      return -1;
+   }
+   // send connection type, to make sure that receiver is OK with
+   //    this data source
+   {
+      int32_t magic = htonl(VY_STREAM_ID);
+      int32_t response;
+      if (send_block(connfd, &magic, sizeof(magic)) < 0) {
+         fprintf(stderr, "Error sending magic connection number");
+         goto err;
+      }
+      if (recv_block(connfd, &response, sizeof(response)) < 0) {
+         fprintf(stderr, "Error receiving connection handshake\n");
+         goto err;
+      }
+      response = htonl(response);
+      if (response != HANDSHAKE_OK) {
+         fprintf(stderr, "Failed communication handshake\n");
+         fprintf(stderr, "Received 0x%08x\n", response);
+         goto err;
+      }
+   }
+   return connfd;
+err:
+   close(connfd);
+   return -1;
+}
+
+// if camera_udp_target is in sensors config, frames are sent over UDP
+//    to the address and port it has (eg, "239.255.42.1 6900" for
+//    multicast). returns 0 if UDP is configured, -1 if not
+static int resolve_udp_target(
+      /*    out */       network_id_type *target
+      )
+{
+   char path[STR_LEN];
+   build_path_string2(NULL, NULL, "sensors", "camera_udp_target", NULL,
+         path, STR_LEN);
+   if (access(path, F_OK) != 0) {
+      return -1;
+   }
+   char buf[STR_LEN];
+   FILE *fp = open_config_file_ro2(NULL, NULL, "sensors",
+         "camera_udp_target", NULL);
+   if (!fp) {
+      return -1;
+   }
+   int rc = config_read_string(fp, buf, STR_LEN);
+   fclose(fp);
+   if (rc != 0) {
+      return -1;
+   }
+   char *addr = strtok(buf, " \t");
+   char *port = strtok(NULL, " \t");
+   if ((addr == NULL) || (port == NULL) || (strlen(addr) >= MAX_IP_LEN)) {
+      fprintf(stderr, "Bad camera_udp_target. Expected "
+            "'<address> <port>'\n");
+      return -1;
+   }
+   strcpy(target->ip, addr);
+   target->port = (uint32_t) atoi(port);
+   return 0;
+}
+
 int main(int argc, const char **argv)
 {
    // Our main data storage vessel..
@@ -1330,39 +1425,16 @@ int main(int argc, const char **argv)
          printf("Establishing connection for image stream\n");
          struct network_id net_id;
          int connfd;
-         if (resolve_sensor_endpoint("camera_endpoint", &net_id) != 0) {
-            fprintf(stderr, "Unable to find network target\n");
-            goto error;
-         }
-         printf("Network target is %s:%d\n", net_id.ip, net_id.port);
-         connfd = connect_to_server(&net_id);
-//printf("connected to server\n");
-         if (connfd < 0) {
-            vcos_log_error("%s: Error opening network connection for "
-                  "camera\n", __func__);
-            vcos_log_error("Tried to connect to %s::%d\n",
-                  net_id.ip, net_id.port);
-            goto error;
-         }
-         // send connection type, to make sure that receiver is OK with
-         //    this data source
-         {
-            int32_t magic = htonl(VY_STREAM_ID);
-            int32_t response;
-            if (send_block(connfd, &magic, sizeof(magic)) < 0) {
-               fprintf(stderr, "Error sending magic connection number");
-               goto error;
-            }
-            if (recv_block(connfd, &response, sizeof(response)) < 0) {
-               fprintf(stderr, "Error receiving connection handshake\n");
-               goto error;
-            }
-            response = htonl(response);
-            if (response != HANDSHAKE_OK) {
-               fprintf(stderr, "Failed communication handshake\n");
-               fprintf(stderr, "Received 0x%08x\n", response);
+         if (resolve_udp_target(&net_id) == 0) {
+            // frames go out as datagrams. there's no connection or
+            //    handshake
+            printf("UDP target is %s:%d\n", net_id.ip, net_id.port);
+            if ((connfd = vy_udp_open_sender(&net_id)) < 0) {
                goto error;
             }
+            s_use_udp = 1;
+         } else if ((connfd = open_tcp_stream()) < 0) {
+            goto error;
          }
          comm_set_socket(connfd);
          printf("Comm socket set\n");
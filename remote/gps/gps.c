@@ -27,20 +27,22 @@
 #include "logger.h"
 #include "timekeeper.h"
 #include "dev_info.h"
+#include "nmea.h"
 #include "build_version_gps.h"
 
 
 // read GPS data over serial line and forward to gps_receiver
 
-// TODO when parsing data, advance to "$" and read until *nn. verify
-//    checksum and do basic error checking. if it's OK, send to receiver.
-// basic error checking. all chars in [a-Z0-9,.-+]. if encounter '$' then
-//    abort check on first and restart with new '$'
+// serial stream is scanned for sentences ('$' to '*hh'). those w/ a valid
+//    checksum and of a type that the receiver parses are forwarded, w/
+//    a timestamp. everything else is dropped and counted
 
 #define DEFAULT_TTY_DEV_NAME     "/dev/ttyUSB0"
 
 #define GPS_BLOCK_SIZE  256
 
+#define STATS_REPORT_SEC   60.0
+
 static int quit_ = 0;
 
 static int serial_fd_ = -1;
@@ -51,6 +53,9 @@ static const char * endpoint_name_ = NULL;
 
 static log_info_type *log_ = NULL;
 
+static nmea_scanner_type scanner_;
+static double report_sec_ = 0.0;
+
 ////////////////////////////////////////////////////////////////////////
 // serial interface
 
@@ -138,126 +143,14 @@ static void open_serial_device(void)
 // serial interface
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
-// nmea
-
-// nmea's "checksum" -- very weak, but that's what we have
-static uint8_t nmea_checksum(
-      /* in     */ const char *sentence,
-      /* in     */ const uint32_t len
-      )
-{
-   uint8_t cksum = 0;
-   for (size_t i=0; i<len; i++) {
-      cksum ^= (uint8_t) sentence[i];
-   }
-   return cksum;
-}
-
-
-static void handle_sentence(
-      /* in     */ const char *sentence,
-      /* in     */ const uint32_t sentence_len,
-      /* in     */ const uint8_t reported_checksum
-      )
-{
-   // validate checksum
-   uint8_t measured_checksum = nmea_checksum(sentence, sentence_len);
-   if (measured_checksum == reported_checksum) {
-      printf("Received: '%s'\n", sentence);
-      // form output packet
-      char buf[GPS_BLOCK_SIZE];
-      sprintf(buf, "%.3f %s", now(), sentence);
-      send_block(sock_fd_, buf, sizeof(buf));
-   } else {
-      // ignore sentence as corrupt
-      //
-      printf("CORRUPT: '%s'\n", sentence);
-   }
-}
-
-
-// nmea
-////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////
 // content parsing
 
-static uint8_t parse_table_[128];
-#define NMEA_CHAR_CONTENT     0x01
-#define NMEA_CHAR_START       0x02
-#define NMEA_CHAR_END         0x04
-#define NMEA_CHAR_HEX         0x08
-#define NMEA_CHAR_NUMBER      0x10
-#define NMEA_CHAR_INVALID     0x80
-
-
-// TODO write parse algorithm
-static void prepare_parser(void)
+static void report_stats(void)
 {
-   // mark all chars (lower ascii) as invalid to start. this flag will be
-   //    removed on chars deemed to be useful
-   memset(parse_table_, NMEA_CHAR_INVALID, sizeof(parse_table_));
-   // set flags for being viable content
-   // [a-Z0-9] and "$*,.-+" are considered viable
-   // numbers are content, numeric and hex
-   for (uint32_t i=0; i<10; i++) {
-      parse_table_['0' + i] =
-            NMEA_CHAR_HEX | NMEA_CHAR_NUMBER | NMEA_CHAR_CONTENT;
-   }
-   // alpha are content, <='f' are hex
-   for (uint32_t i=0; i<26; i++) {
-      parse_table_[(uint8_t) (i + 'A')] = NMEA_CHAR_CONTENT;
-      parse_table_[(uint8_t) (i + 'a')] = NMEA_CHAR_CONTENT;
-      if (i < 6) {
-         parse_table_[(uint8_t) (i + 'A')] |= NMEA_CHAR_HEX;
-         parse_table_[(uint8_t) (i + 'a')] |= NMEA_CHAR_HEX;
-      }
-   }
-   // remaining characters
-   parse_table_['$'] = NMEA_CHAR_CONTENT | NMEA_CHAR_START;
-   parse_table_['*'] = NMEA_CHAR_CONTENT | NMEA_CHAR_END;
-   parse_table_['.'] = NMEA_CHAR_CONTENT;
-   parse_table_[','] = NMEA_CHAR_CONTENT;
-   parse_table_['+'] = NMEA_CHAR_CONTENT;
-   parse_table_['-'] = NMEA_CHAR_CONTENT;
-}
-
-
-static uint8_t dehex(
-      /* in     */ const char c
-      )
-{
-   uint8_t val = 0;
-   if (c <= '9') {
-      val = (uint8_t) (c - '0');
-   } else if (c <= 'F') {
-      val = (uint8_t) (10 + c - 'A');
-   } else if (c <= 'f') {
-      val = (uint8_t) (10 + c - 'f');
-   } else {
-      fprintf(stderr, "Internal error -- '%c' not recognized as hex\n", c);
-   }
-   return val;
-}
-
-
-enum parse_states { SEARCHING, READING, CHECKSUM_0, CHECKSUM_1 };
-
-static void parse_error(
-      /* in     */ const uint8_t *block,
-      /* in     */ const char *sentence
-      )
-{
-   printf("Failed while parsing '%s'\n", sentence);
-   // print block content
-   for (uint32_t i=0; i<GPS_BLOCK_SIZE; i++) {
-      printf(" %02x", block[i]);
-      if ((i & 0x001f) == 0x001f) {
-         printf("\n");
-      } else if ((i & 0x0007) == 0x0007) {
-         printf(" ");
-      }
-   }
-   printf("\n");
+   const nmea_stats_type *stats = &scanner_.stats;
+   printf("NMEA: %ld bytes, %ld sentences forwarded, %ld ignored, %ld bad "
+         "checksum, %ld bad format\n", stats->bytes, stats->sentences,
+         stats->ignored, stats->bad_checksum, stats->bad_format);
 }
 
 
@@ -266,62 +159,24 @@ static void parse_buffer(
       /* in     */ const uint32_t n
       )
 {
-   char sentence[GPS_BLOCK_SIZE];
-   uint32_t sentence_len;
-   uint8_t checksum;
-   enum parse_states state = SEARCHING;
-   for (uint32_t i=0; i<n; i++) {
-      // parse stream. process sentence when one is identified and extracted
-      char c = (char) buf[i];
-      uint8_t code = parse_table_[c & 0x7f];
-//printf("%c -> 0x%02x\n", c, code);
-      switch (state) {
-         case SEARCHING:
-            if (code & NMEA_CHAR_START) {
-               state = READING;
-            }
-            break;
-         case READING:
-            if (code & NMEA_CHAR_END) {
-               sentence[sentence_len] = 0;
-               state = CHECKSUM_0;
-            } else if ((code & NMEA_CHAR_CONTENT) == 0) {
-printf("Fail sentence\n");
-               parse_error(buf, sentence);
-               sentence_len = 0;
-               state = SEARCHING;
-            } else {
-               sentence[sentence_len++] = c;
-            }
-            break;
-         case CHECKSUM_0:
-            if (code & NMEA_CHAR_HEX) {
-               checksum = dehex(c);
-               state = CHECKSUM_1;
-            } else {
-printf("Fail cksum0\n");
-               parse_error(buf, sentence);
-               sentence_len = 0;
-               state = SEARCHING;
-            }
-            break;
-         case CHECKSUM_1:
-            if (code & NMEA_CHAR_HEX) {
-               checksum = (uint8_t) (checksum * 16 + dehex(c));
-               handle_sentence(sentence, sentence_len, checksum);
-            } else {
-printf("Fail cksum1\n");
-               parse_error(buf, sentence);
-            }
-            sentence_len = 0;
-            state = SEARCHING;
-            break;
-         default:
-            fprintf(stderr, "Internal error -- broke on '%s' + '%c'\n",
-                  sentence, c);
-            sentence_len = 0;
-            state = SEARCHING;
-      };
+   uint32_t pos = 0;
+   while (pos < n) {
+      const char *sentence = NULL;
+      pos += nmea_scan(&scanner_, &buf[pos], n - pos, &sentence);
+      if (sentence != NULL) {
+         // form output packet
+         char block[GPS_BLOCK_SIZE];
+         memset(block, 0, sizeof(block));
+         snprintf(block, sizeof(block), "%.3f %s", now(), sentence);
+         send_block(sock_fd_, block, sizeof(block));
+      }
+   }
+   double t = now();
+   if ((t - report_sec_) >= STATS_REPORT_SEC) {
+      if (report_sec_ > 0.0) {
+         report_stats();
+      }
+      report_sec_ = t;
    }
 }
 
@@ -395,7 +250,7 @@ int main(int argc, const char **argv)
       printf("Connecting to %s:%d\n", net_id.ip, net_id.port);
    }
    /////////////////////////////////////////////
-   prepare_parser();
+   nmea_scanner_init(&scanner_);
    /////////////////////////////////////////////////////////////////////
    // loop until quit signal (this is triggered via SIGUSR1)
    while (quit_ == 0) {
@@ -432,6 +287,7 @@ printf("Connected to %s:%d\n", net_id.ip, net_id.port);
          sleep(2);
       }
    }
+   report_stats();
    shutdown_connections();
    rc = 0;
 end:
@@ -27,6 +27,7 @@
 #include <dirent.h>
 #include "pinet.h"
 #include "time_lib.h"
+#include "sensor_packet.h"
 #include "sens_net.h"
 #include "sens_db.h"
 #include "dev_info.h"
@@ -50,6 +51,8 @@ int cam_sock_fd_ = -1;
 int gps_sock_fd_ = -1;
 
 FILE * imu_log_fp_ = NULL;
+// set when imu log is binary (see imu_log_record in sensor_packet.h)
+static int imu_log_binary_ = 0;
 FILE * gps_log_fp_ = NULL;
 
 // quite flag -- program exits when quit signal received
@@ -426,19 +429,14 @@ static int32_t send_image(double t)
    serialize_sensor_header2(VY_PACKET_TYPE, t, t, &header);
    header.custom_16[0] = (int16_t) htons(CAM_ROWS);
    header.custom_16[1] = (int16_t) htons(CAM_COLS);
-   // send header
-   if (send_block(cam_sock_fd_, &header, sizeof(header)) < 0) {
-      fprintf(stderr, "Network error sending header packet\n");
-      goto err;
-   }
-   // send V channel -- this should be first 1/2 of buffer
-   if (send_block(cam_sock_fd_, frame_image_->gray, n_pix/2) < 0) {
-      fprintf(stderr, "Error sending part 1 of VY image frame\n");
-      goto err;
-   }
-   // send Y channel -- this should be 2nd half of buffer
-   if (send_block(cam_sock_fd_, &frame_image_->gray[n_pix/2], n_pix/2) < 0) {
-      fprintf(stderr, "Error sending part 2 of VY image frame\n");
+   // send header and image. V channel is first 1/2 of buffer and Y
+   //    channel is 2nd half
+   struct iovec iov[2] = {
+         { .iov_base = &header, .iov_len = sizeof(header) },
+         { .iov_base = frame_image_->gray, .iov_len = n_pix }
+   };
+   if (send_blockv(cam_sock_fd_, iov, 2, NULL) < 0) {
+      fprintf(stderr, "Network error sending VY image frame\n");
       goto err;
    }
    rc = 0;
@@ -468,10 +466,25 @@ static double load_next_imu_sample(
       imu_log_fp_ = fopen(imu_log_, "r");
       if (!imu_log_fp_) {
          printf("Failed to open input log file\n");
+      } else {
+         imu_log_binary_ = imu_log_check_header(imu_log_fp_);
       }
       imu_log_[0] = 0;
    }
-   if (imu_log_fp_) {
+   if (imu_log_fp_ && imu_log_binary_) {
+      imu_log_record_type rec;
+      if (fread(&rec, sizeof rec, 1, imu_log_fp_) != 1) {
+         goto err;   // error or end of file -- either way, we're done
+      }
+      line_num++;
+      t = rec.t;
+      for (uint32_t i=0; i<3; i++) {
+         consensus->gyr_axis.v[i] = (double) rec.gyr[i];
+         consensus->acc.v[i] = (double) rec.acc[i];
+         consensus->mag.v[i] = (double) rec.mag[i];
+      }
+      consensus->temp = (double) rec.temp;
+   } else if (imu_log_fp_) {
       // some logs have empty lines -- loop until actual data read
       while (t <= 0.0) {
          // read next line and parse it
@@ -526,7 +539,8 @@ static double load_next_imu_sample(
    goto done;
    print_consensus(consensus);   // unreachable (avoids compile warning)
 err:
-   printf("Read %d lines from the IMU log\n", line_num);
+   printf("Read %d %s from the IMU log\n", line_num,
+         imu_log_binary_ ? "records" : "lines");
    fclose(imu_log_fp_);
    imu_log_fp_ = NULL;
    t = -1.0;
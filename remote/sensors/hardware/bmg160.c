@@ -26,8 +26,7 @@
 #include "sens_lib.h"
 #include "sens_db.h"
 #include "timekeeper.h"
-
-#include "timekeeper.h"
+#include "sens_sim.h"
 
 #include "bmg160.h"
 #include "bmg160_registers.h"
@@ -45,6 +44,16 @@
 #define DRIFT_LOG_INTERVAL    (5.0 * 60.0)
 static double log_timer_ = 0.0;
 
+// gyro output data rate is 200Hz. samples are queued in a 100-deep FIFO
+#define GYR_PERIOD_SEC     (1.0 / 200.0)
+#define GYR_FIFO_DEPTH     100u
+
+#define GYR_GAIN     (1.0 / 131.2)
+
+// set once FIFO has been switched to stream mode. writing FIFO_CONFIG_1
+//    clears the FIFO so this is only done once
+#define STATE_FIFO_STREAMING     0x0001
+
 
 static void write_gyr_register(
       /* in out */       sensor_runtime_type *dev,
@@ -53,7 +62,7 @@ static void write_gyr_register(
       )
 {
    select_device(dev, dev->gyro.gyro_addr);
-   if (i2c_smbus_write_byte_data(dev->hw_device, reg, value) < 0) {
+   if (bus_write_byte(dev, reg, value) < 0) {
       device_error(dev, __FILE__, __LINE__, reg, SENSOR_FLAG_GYRO);
    }
 }
@@ -61,88 +70,73 @@ static void write_gyr_register(
 ////////////////////////////////////////////////////////////////////////
 
 
-static void read_temp_data(
-      /* in out */       sensor_runtime_type *dev,
-      /*    out */       int16_t data[1]
-      )
-{
-   uint8_t raw[1];
-   const uint8_t cmd = TEMP_ADDR;
-   select_device(dev, dev->temp.temp_addr);
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, sizeof(raw), raw) < 0) {
-      device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_TEMP);
-   }
-   data[0] = (int16_t) ((int8_t) raw[0]);
-}
-
-////////////////////////////////////////////////////////////////////////
-//
+// temp is on the gyro device, and TEMP_ADDR through FIFO_STAT_ADDR are
+//    contiguous (interrupt status
+//    registers are between them, and are unused), so temperature
+//    and FIFO level are read in one transfer. all queued samples are then
+//    read from FIFO_DATA_ADDR in a second
+#define TEMP_FIFO_STAT_SIZE   (FIFO_STAT_ADDR - TEMP_ADDR + 1)
 
-// querying avaiable data and pulling data were merged when investigating
-//    performance problems (turned out it was i2c baud rate)
-// should make style of gyro data consistent with acc and mag
-static void pull_gyro_data(
+static void pull_gyro_temp_data(
       /* in out */       sensor_runtime_type *dev
       )
 {
-   // fetch amount of data available
+   dev->gyro.sample_time = 0.0;
+   // fetch temp and amount of data available
    select_device(dev, dev->gyro.gyro_addr);
-   const int hw = dev->hw_device;
-   uint8_t fifo[1];
-   const uint8_t cmd =  FIFO_STAT_ADDR;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, 1, fifo) < 0) {
-      device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_GYRO);
+   const double t = now();
+   uint8_t stat[TEMP_FIFO_STAT_SIZE];
+   if (bus_read(dev, TEMP_ADDR, sizeof(stat), stat) < 0) {
+      device_error(dev, __FILE__, __LINE__, TEMP_ADDR, SENSOR_FLAG_GYRO);
+      return;
+   }
+   // a reading of 0 is 23C
+   dev->temp.celcius = 23.0 + dev->temp.gain * ((double) ((int8_t) stat[0]));
+   // frame counter is in bits 0-6. bit 7 indicates overrun, in which
+   //    case samples were lost and period estimate restarts
+   const uint8_t fifo = stat[FIFO_STAT_ADDR - TEMP_ADDR];
+   uint32_t cnt = (uint32_t) (fifo & 0x7f);
+   if (fifo & 0x80) {
+      dev->gyro.clock.window_start_sec = 0.0;
+   }
+   if (cnt > GYR_FIFO_DEPTH) {
+      cnt = GYR_FIFO_DEPTH;
    }
-   uint32_t cnt = (uint32_t) (fifo[0] & 0x7f);
 //printf("count: %d\n", cnt);
    // process data if it's available
    if (cnt > 0) {
       // data transfered as bytes in little endian order. have
       //    data be written directly to int16 memory
       union {
-         uint8_t raw[6];
-         int16_t vals[3];
+         uint8_t raw[GYR_FIFO_DEPTH * FIFO_FRAME_BYTES];
+         int16_t vals[GYR_FIFO_DEPTH * 3];
       } bucket;
-      //
+      if (bus_read(dev, FIFO_DATA_ADDR, cnt * FIFO_FRAME_BYTES,
+               bucket.raw) < 0) {
+         device_error(dev, __FILE__, __LINE__, FIFO_DATA_ADDR,
+               SENSOR_FLAG_GYRO);
+         return;
+      }
       int32_t accum[3];
       for (uint32_t i=0; i<3; i++)
          accum[i] = 0;
       for (uint32_t i=0; i<cnt; i++) {
-         if (i2c_smbus_read_i2c_block_data(hw, FIFO_DATA_ADDR,
-                  sizeof(bucket.raw), bucket.raw) < 0) {
-            device_error(dev, __FILE__, __LINE__, FIFO_DATA_ADDR,
-                  SENSOR_FLAG_GYRO);
-         }
-         accum[0] += (int32_t) bucket.vals[0];
-         accum[1] += (int32_t) bucket.vals[1];
-         accum[2] += (int32_t) bucket.vals[2];
-//printf("    %d,%d,%d (%.3f,%.3f,%.3f\n", accum[0], accum[1],accum[2],accum[0]/131.2,accum[1]/131.2,accum[2]/131.2);
-//printf("    %4d  %4d  %4d\n", bucket.vals[0], bucket.vals[1], bucket.vals[2]);
+         accum[0] += (int32_t) bucket.vals[3*i];
+         accum[1] += (int32_t) bucket.vals[3*i+1];
+         accum[2] += (int32_t) bucket.vals[3*i+2];
       }
       for (uint32_t i=0; i<3; i++)
          accum[i] /= (int32_t) cnt;
       // average rotation data over measured period
       update_gyro_drift(dev, accum, DRIFT_TAU);
+      dev->gyro.sample_time = fifo_sample_times(&dev->gyro.clock, t, cnt,
+            NULL);
+      dev->bus.samples += cnt;
+   }
+   if ((dev->state & STATE_FIFO_STREAMING) == 0) {
+      write_gyr_register(dev, FIFO_CONFIG_1_ADDR, 0b10000000);
+      dev->state |= STATE_FIFO_STREAMING;
    }
-   write_gyr_register(dev, FIFO_CONFIG_1_ADDR, 0b10000000);
-}
-
-
-
-////////////////////////////////////////////////////////////////////////
-// mag
-
-
-static void pull_temp_data(
-      /* in out */       sensor_runtime_type *dev
-      )
-{
-   // pull temp data too
-   int16_t raw_temp[1];
-   read_temp_data(dev, raw_temp);
-   // a reading of 0 is 23C
-   dev->temp.celcius = 23.0 + dev->temp.gain * ((double) raw_temp[0]);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -167,14 +161,26 @@ static void initialize_device(
    // start out in bypass mode. after first data read, switch to stream
    write_gyr_register(device, FIFO_CONFIG_1_ADDR, 0b00000000);
    //
-   const double gyr_gain = 1.0 / 131.2;
    for (uint32_t i=0; i<3; i++)
-      gyr->gain.v[i] = gyr_gain;
+      gyr->gain.v[i] = GYR_GAIN;
    //
    temp->gain = 0.5;
 }
 
 
+// register content for running on simulated bus: a stationary device
+//    at 23C
+static void configure_simulator(
+      /* in out */       sensor_runtime_type *dev
+      )
+{
+   const sim_fifo_type fifo = {
+         .status_reg = FIFO_STAT_ADDR, .count_mask = 0x7f,
+         .overrun_bit = 0x80, .data_reg = FIFO_DATA_ADDR,
+         .depth = GYR_FIFO_DEPTH, .period_sec = GYR_PERIOD_SEC };
+   sim_i2c_set_fifo(dev->sim, dev->gyro.gyro_addr, &fifo);
+}
+
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 // External facing code
@@ -192,6 +198,11 @@ int32_t bmg160_setup(
    // get config data (eg, offsets, i2c addresses, etc)
    fetch_gyro_config(dev);
    fetch_temp_config(dev);
+   init_fifo_clock(&dev->gyro.clock, GYR_PERIOD_SEC);
+   dev->state = 0;
+   if (dev->sim) {
+      configure_simulator(dev);
+   }
    // on failure, initialize device will disable subsensors or
    //    will disable the entire device -> no need to check for errors
    initialize_device(dev);
@@ -220,8 +231,7 @@ void bmg160_update(
             "drift dps: %.3f, %.3f, %.3f", (double) drift_dps->v[0],
             (double) drift_dps->v[1], (double) drift_dps->v[2]);
    }
-   pull_gyro_data(dev);
-   pull_temp_data(dev);
+   pull_gyro_temp_data(dev);
    // update timer
    timeadd(&dev->waketime, 0, UPDATE_INTERVAL_US * TIME_ADD_1US);
    *data_available = 1;
@@ -29,6 +29,7 @@
 #include "sens_db.h"
 
 #include "timekeeper.h"
+#include "sens_sim.h"
 
 #include "lis3mdl.h"
 #include "lis3mdl_registers.h"
@@ -40,6 +41,8 @@
 
 #define WARMUP_INTERVAL       (WARMUP_INTERVAL_BASE)
 
+#define MAG_GAIN     (1.0 / 6842.0)
+
 
 static int32_t write_register(
       /* in out */       sensor_runtime_type *dev,
@@ -47,7 +50,7 @@ static int32_t write_register(
       /* in     */ const uint8_t value
       )
 {
-   if (i2c_smbus_write_byte_data(dev->hw_device, reg, value) < 0) {
+   if (bus_write_byte(dev, reg, value) < 0) {
       fprintf(stderr, "%s: write_register() error. reg=%d, value=%d\n",
             __FILE__, reg, value);
       device_error(dev, __FILE__, __LINE__, reg, dev->flags);
@@ -58,47 +61,37 @@ static int32_t write_register(
 
 ////////////////////////////////////////////////////////////////////////
 
-static void mag_data_available(
-      /* in     */       sensor_runtime_type *dev,
-      /*    out */       uint8_t *data
-      )
-{
-   uint8_t cmd = 0x80 | STATUS_REG;
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, 1, data) < 0)
-   {
-      device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAGS_MAG_TEMP);
-   }
-}
+// STATUS_REG, OUT_X_L..OUT_Z_H and TEMP_OUT_L..TEMP_OUT_H are contiguous,
+//    so availability, mag and temp data are read in one transfer.
+//    returns 1 if new data was available, 0 if not and -1 on error
+#define STATUS_MAG_TEMP_SIZE     (TEMP_OUT_H - STATUS_REG + 1)
 
 static int32_t read_mag_data(
       /* in out */       sensor_runtime_type *dev
       )
 {
-   uint8_t raw[8];
+   uint8_t raw[STATUS_MAG_TEMP_SIZE];
    int16_t data[4];
-   uint8_t cmd = 0x80 | OUT_X_L;
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, 6, raw) < 0) {
+   const uint8_t cmd = 0x80 | STATUS_REG;
+   if (bus_read(dev, cmd, sizeof(raw), raw) < 0) {
       device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAGS_MAG_TEMP);
       return -1;
    }
-   cmd = 0x80 | TEMP_OUT_L;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, 2, &raw[6]) < 0) {
-      device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAGS_MAG_TEMP);
-      return -1;
+   if ((raw[0] & 0x08) == 0) {
+      return 0;
    }
    // mag data order X Y Z Temp, little endian
-   data[0] = (int16_t) (raw[0] | raw[1] << 8);
-   data[1] = (int16_t) (raw[2] | raw[3] << 8);
-   data[2] = (int16_t) (raw[4] | raw[5] << 8);
-   data[3] = (int16_t) (raw[6] | raw[7] << 8);
+   data[0] = (int16_t) (raw[1] | raw[2] << 8);
+   data[1] = (int16_t) (raw[3] | raw[4] << 8);
+   data[2] = (int16_t) (raw[5] | raw[6] << 8);
+   data[3] = (int16_t) (raw[7] | raw[8] << 8);
    apply_gain(data, &dev->mag.gain, &dev->mag.mag);
 //   apply_gain_scale_offset(data, &dev->mag.gain,
 //         &dev->mag.scale, &dev->mag.offset, &dev->mag.mag);
    dev->temp.celcius = 25.0 + dev->temp.gain * ((double) data[3]);
+   dev->bus.samples++;
 //printf("TEMP %04x  (%.3f  %.3f)  gain: %.3f\n", (uint16_t) data[3], dev->temp.celcius, (double) data[3], dev->temp.gain);
-   return 0;
+   return 1;
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -122,13 +115,27 @@ static void initialize_device(
    write_register(device, CTRL_REG5, 0b01000000);
    //
    sensor_mag_type *mag = &device->mag;
-   const double mag_gain = 1.0 / 6842.0;
    for (uint32_t i=0; i<3; i++) {
-      mag->gain.v[i] = mag_gain;
+      mag->gain.v[i] = MAG_GAIN;
    }
    device->temp.gain = 1.0 / 8.0;
 }
 
+// register content for running on simulated bus: new data always
+//    available, w/ north on X
+static void configure_simulator(
+      /* in out */       sensor_runtime_type *dev
+      )
+{
+   sim_i2c_type *sim = dev->sim;
+   const uint8_t addr = dev->mag.mag_addr;
+   const uint16_t mag_x = (uint16_t) (0.25 / MAG_GAIN);
+   sim_i2c_set_register(sim, addr, WHO_AM_I, WHO_AM_I_VALUE);
+   sim_i2c_set_register(sim, addr, STATUS_REG, 0x08);
+   sim_i2c_set_register(sim, addr, OUT_X_L, (uint8_t) (mag_x & 0xff));
+   sim_i2c_set_register(sim, addr, OUT_X_H, (uint8_t) (mag_x >> 8));
+}
+
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 // External facing code
@@ -144,6 +151,9 @@ int32_t lis3mdl_setup(
    init_sensor_temp(&dev->temp, NULL, 1.0);
    //
    fetch_mag_config(dev);
+   if (dev->sim) {
+      configure_simulator(dev);
+   }
    //
    initialize_device(dev);
    // run in default mode, so no initializtion necessary
@@ -165,9 +175,8 @@ int32_t lis3mdl_check_whoami(
 {
    // check WHO_AM_I
    uint8_t cmd = 0x80 | WHO_AM_I;
-   int hw = dev->hw_device;
    uint8_t data;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, 1, &data) < 0)
+   if (bus_read(dev, cmd, 1, &data) < 0)
    {
       device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAGS_MAG_TEMP);
       goto err;
@@ -188,15 +197,8 @@ void lis3mdl_update(
       /*    out */       int32_t *data_available
       )
 {
-   uint8_t avail = 0;
-   *data_available = 0;
-   // see if there's data available
-   mag_data_available(dev, &avail);
-   if (avail & 0x08) {
-      // pull data
-      read_mag_data(dev);
-      *data_available = 1;
-   }
+   // pull data if it's available
+   *data_available = read_mag_data(dev) > 0 ? 1 : 0;
    timeadd(&dev->waketime, 0, UPDATE_INTERVAL_US * TIME_ADD_1US);
 }
 
@@ -26,6 +26,7 @@
 #include "sens_lib.h"
 #include "sens_db.h"
 #include "timekeeper.h"
+#include "sens_sim.h"
 
 #include "lsm9ds0.h"
 #include "lsm9ds0_registers.h"
@@ -43,6 +44,13 @@
 #define DRIFT_LOG_INTERVAL    (5.0 * 60.0)
 static double log_timer_ = 0.0;
 
+// gyro output data rate is 95Hz. samples are queued in a 32-deep FIFO
+#define GYR_PERIOD_SEC     (1.0 / 95.0)
+#define GYR_FIFO_DEPTH     32u
+
+#define ACC_GAIN     0.000122    // == 0.122 mg/LSB
+#define MAG_GAIN     0.00008
+
 
 static void write_acc_register(
       /* in out */       sensor_runtime_type *dev,
@@ -51,7 +59,7 @@ static void write_acc_register(
       )
 {
    select_device(dev, dev->accel.accel_addr);
-   if (i2c_smbus_write_byte_data(dev->hw_device, reg, value) < 0) {
+   if (bus_write_byte(dev, reg, value) < 0) {
       device_error(dev, __FILE__, __LINE__, reg, SENSOR_FLAG_ACC);
    }
 }
@@ -63,7 +71,7 @@ static void write_mag_register(
       )
 {
    select_device(dev, dev->mag.mag_addr);
-   if (i2c_smbus_write_byte_data(dev->hw_device, reg, value) < 0) {
+   if (bus_write_byte(dev, reg, value) < 0) {
       device_error(dev, __FILE__, __LINE__, reg, SENSOR_FLAG_MAG);
    }
 }
@@ -75,47 +83,13 @@ static void write_gyr_register(
       )
 {
    select_device(dev, dev->gyro.gyro_addr);
-   if (i2c_smbus_write_byte_data(dev->hw_device, reg, value) < 0) {
+   if (bus_write_byte(dev, reg, value) < 0) {
       device_error(dev, __FILE__, __LINE__, reg, SENSOR_FLAG_GYRO);
    }
 }
 
 ////////////////////////////////////////////////////////////////////////
 
-static void read_acc_data(
-      /* in out */       sensor_runtime_type *dev,
-      /*    out */       int16_t data[3]
-      )
-{
-   uint8_t raw[6];
-   uint8_t cmd = 0x80 | OUT_X_L_A;
-   select_device(dev, dev->accel.accel_addr);
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, sizeof(raw), raw) < 0) {
-      device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_ACC);
-   }
-   data[0] = (int16_t) (raw[0] | raw[1] << 8);
-   data[1] = (int16_t) (raw[2] | raw[3] << 8);
-   data[2] = (int16_t) (raw[4] | raw[5] << 8);
-}
-
-static void read_mag_data(
-      /* in out */       sensor_runtime_type *dev,
-      /*    out */       int16_t data[3]
-      )
-{
-   uint8_t raw[6];
-   uint8_t cmd = 0x80 | OUT_X_L_M;
-   select_device(dev, dev->mag.mag_addr);
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, sizeof(raw), raw) < 0) {
-      device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_MAG);
-   }
-   data[0] = (int16_t) (raw[0] | raw[1] << 8);
-   data[1] = (int16_t) (raw[2] | raw[3] << 8);
-   data[2] = (int16_t) (raw[4] | raw[5] << 8);
-}
-
 //static void read_gyr_data(
 //      /* in out */       sensor_runtime_type *dev,
 //      /*    out */       int16_t data[3]
@@ -133,21 +107,6 @@ static void read_mag_data(
 //   data[2] = (int16_t) (raw[4] | raw[5] << 8);
 //}
 
-static void read_temp_data(
-      /* in out */       sensor_runtime_type *dev,
-      /*    out */       int16_t data[1]
-      )
-{
-   uint8_t raw[2];
-   uint8_t cmd = 0x80 | OUT_TEMP_L_XM;
-   select_device(dev, dev->temp.temp_addr);
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, sizeof(raw), raw) < 0) {
-      device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_TEMP);
-   }
-   data[0] = (int16_t) (raw[0] | raw[1] << 8);
-}
-
 ////////////////////////////////////////////////////////////////////////
 //
 
@@ -175,86 +134,87 @@ static void read_temp_data(
 //   }
 //}
 
-// querying avaiable data and pulling data were merged when investigating
-//    performance problems (turned out it was i2c baud rate)
-// should make style of gyro data consistent with acc and mag
+// FIFO level is read, then all queued samples are read in one transfer.
+//    in FIFO mode the register pointer wraps from OUT_Z_H_G back to
+//    OUT_X_L_G, so successive frames come out of the same burst
 static void pull_gyro_data(
       /* in out */       sensor_runtime_type *dev
       )
 {
+   dev->gyro.sample_time = 0.0;
    // fetch amount of data available
    select_device(dev, dev->gyro.gyro_addr);
-   const int hw = dev->hw_device;
+   const double t = now();
    uint8_t fifo[1];
-   uint8_t cmd = 0x80 | FIFO_SRC_REG_G;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, 1, fifo) < 0) {
+   const uint8_t cmd = 0x80 | FIFO_SRC_REG_G;
+   if (bus_read(dev, cmd, 1, fifo) < 0) {
       device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_GYRO);
+      return;
+   }
+   // FSS4-0 holds FIFO level. OVRN is set when FIFO is full, in which
+   //    case samples were lost and period estimate restarts
+   uint32_t cnt = (uint32_t) (fifo[0] & 0x1f);
+   if (fifo[0] & 0x40) {
+      cnt = GYR_FIFO_DEPTH;
+      dev->gyro.clock.window_start_sec = 0.0;
    }
-   const uint32_t cnt = (uint32_t) (fifo[0] & 0x0f);
 //printf("GYRO FIFO has %d elements\n", cnt);
    // process data if it's available
    if (cnt > 0) {
       // data transfered as bytes in little endian order. have
       //    data be written directly to int16 memory
       union {
-         uint8_t raw[6];
-         int16_t vals[3];
+         uint8_t raw[GYR_FIFO_DEPTH * FIFO_FRAME_BYTES];
+         int16_t vals[GYR_FIFO_DEPTH * 3];
       } bucket;
-      //
+      const uint8_t data_cmd = 0x80 | OUT_X_L_G;
+      if (bus_read(dev, data_cmd, cnt * FIFO_FRAME_BYTES, bucket.raw) < 0) {
+         device_error(dev, __FILE__, __LINE__, data_cmd, SENSOR_FLAG_GYRO);
+         return;
+      }
       int32_t accum[3];
       for (uint32_t i=0; i<3; i++)
          accum[i] = 0;
       for (uint32_t i=0; i<cnt; i++) {
-         if (i2c_smbus_read_i2c_block_data(hw, (0x80 | OUT_X_L_G),
-                  sizeof(bucket.raw), bucket.raw) < 0) {
-            device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_GYRO);
-         }
-         accum[0] += (int32_t) bucket.vals[0];
-         accum[1] += (int32_t) bucket.vals[1];
-         accum[2] += (int32_t) bucket.vals[2];
+         accum[0] += (int32_t) bucket.vals[3*i];
+         accum[1] += (int32_t) bucket.vals[3*i+1];
+         accum[2] += (int32_t) bucket.vals[3*i+2];
       }
       for (uint32_t i=0; i<3; i++)
          accum[i] /= (int32_t) cnt;
       // average rotation data over measured period
       update_gyro_drift(dev, accum, DRIFT_TAU);
+      dev->gyro.sample_time = fifo_sample_times(&dev->gyro.clock, t, cnt,
+            NULL);
+      dev->bus.samples += cnt;
 //print_vec(&dev->gyro.axis_dps, "gyro");
    }
 }
 
 
-#define ACC_DATA_AVAILABLE_SIZE     1
+// STATUS_REG_A is followed by OUT_X_L_A..OUT_Z_H_A, so status and data
+//    are read in one transfer
+#define ACC_STATUS_DATA_SIZE     7
 
-static void acc_data_available(
-      /* in     */       sensor_runtime_type *dev,
-      /*    out */       uint8_t data[ACC_DATA_AVAILABLE_SIZE]
+static void pull_acc_data(
+      /* in out */       sensor_runtime_type *dev
       )
 {
-   uint8_t cmd = 0x80 | STATUS_REG_A;
+   uint8_t raw[ACC_STATUS_DATA_SIZE];
+   const uint8_t cmd = 0x80 | STATUS_REG_A;
    select_device(dev, dev->accel.accel_addr);
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, ACC_DATA_AVAILABLE_SIZE,
-         data) < 0)
-   {
+   if (bus_read(dev, cmd, sizeof(raw), raw) < 0) {
       device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_ACC);
+      return;
    }
-}
-
-
-static void pull_acc_data(
-      /* in out */       sensor_runtime_type *dev
-      )
-{
-   uint8_t avail[1];
-   // fetch amount of data available
-   acc_data_available(dev, avail);
-   if (avail[0] & 0x08) {
+   if (raw[0] & 0x08) {
 //printf("ACC data available\n");
-      // pull data
       int16_t data[3];
-      read_acc_data(dev, data);
+      data[0] = (int16_t) (raw[1] | raw[2] << 8);
+      data[1] = (int16_t) (raw[3] | raw[4] << 8);
+      data[2] = (int16_t) (raw[5] | raw[6] << 8);
       apply_gain(data, &dev->accel.gain, &dev->accel.up);
-//      apply_gain_scale_offset(data, &dev->accel.gain,
-//            &dev->accel.scale, &dev->accel.offset, &dev->accel.up);
+      dev->bus.samples++;
 //print_vec(&dev->accel.up, "ACC data");
 //printf("ACC: %d, %d, %d  \n", data[0], data[1], data[2]);
    }
@@ -263,45 +223,33 @@ static void pull_acc_data(
 ////////////////////////////////////////////////////////////////////////
 // mag
 
-#define MAG_DATA_AVAILABLE_SIZE     1
+// temp is on the same device as mag, and OUT_TEMP_L_XM, OUT_TEMP_H_XM,
+//    STATUS_REG_M and OUT_X_L_M..OUT_Z_H_M are contiguous. all are read
+//    in one transfer
+#define MAG_TEMP_DATA_SIZE    9
 
-static void mag_data_available(
-      /* in     */       sensor_runtime_type *dev,
-      /*    out */       uint8_t data[MAG_DATA_AVAILABLE_SIZE]
+static void pull_mag_temp_data(
+      /* in out */       sensor_runtime_type *dev
       )
 {
-   uint8_t cmd = 0x80 | STATUS_REG_M;
+   uint8_t raw[MAG_TEMP_DATA_SIZE];
+   const uint8_t cmd = 0x80 | OUT_TEMP_L_XM;
    select_device(dev, dev->mag.mag_addr);
-   int hw = dev->hw_device;
-   if (i2c_smbus_read_i2c_block_data(hw, cmd, MAG_DATA_AVAILABLE_SIZE,
-         data) < 0)
-   {
+   if (bus_read(dev, cmd, sizeof(raw), raw) < 0) {
       device_error(dev, __FILE__, __LINE__, cmd, SENSOR_FLAG_MAG);
+      return;
    }
-}
-
-static void pull_mag_temp_data(
-      /* in out */       sensor_runtime_type *dev
-      )
-{
-   uint8_t avail[1];
-   // fetch amount of data available
-   mag_data_available(dev, avail);
-   if (avail[0] & 0x08) {
+   if (raw[2] & 0x08) {
 //printf("MAG data available\n");
-      // pull data
       int16_t data[3];
-      read_mag_data(dev, data);
+      data[0] = (int16_t) (raw[3] | raw[4] << 8);
+      data[1] = (int16_t) (raw[5] | raw[6] << 8);
+      data[2] = (int16_t) (raw[7] | raw[8] << 8);
       apply_gain(data, &dev->mag.gain, &dev->mag.mag);
-//      apply_gain_scale_offset(data, &dev->mag.gain,
-//            &dev->mag.scale, &dev->mag.offset, &dev->mag.mag);
-      // pull temp data too
-      int16_t raw_temp[1];
-      read_temp_data(dev, raw_temp);
-      dev->temp.celcius = dev->temp.gain * ((double) raw_temp[0]);
-//printf("MAG: %d, %d, %d    TEMP: %d\n", data[0], data[1], data[2], raw_temp[0]);
-//print_vec(&dev->accel.mag, "MAG data");
-//printf("    temp=%f\n", (double) dev->temp.celcius);
+      const int16_t raw_temp = (int16_t) (raw[0] | raw[1] << 8);
+      dev->temp.celcius = dev->temp.gain * ((double) raw_temp);
+      dev->bus.samples++;
+//printf("MAG: %d, %d, %d    TEMP: %d\n", data[0], data[1], data[2], raw_temp);
    }
 }
 
@@ -328,9 +276,8 @@ static void initialize_device(
    // REG2 +/- 4G
 	write_acc_register(device, CTRL_REG2_XM, 0b00001000);
    //
-   const double acc_gain = 0.000122; // == 0.122 mg/LSB
    for (uint32_t i=0; i<3; i++)
-      acc->gain.v[i] = acc_gain;
+      acc->gain.v[i] = ACC_GAIN;
    // magnetometer
    // REG5 TEMP on, high res, 12.5Hz
    write_mag_register(device, CTRL_REG5_XM, 0b11101000);
@@ -339,9 +286,8 @@ static void initialize_device(
    // REG7 filter off, mag on
    write_mag_register(device, CTRL_REG7_XM, 0b00000000);
    //
-   const double mag_gain = 0.00008;
    for (uint32_t i=0; i<3; i++)
-      mag->gain.v[i] = mag_gain;
+      mag->gain.v[i] = MAG_GAIN;
    temp->gain = 1.0 / 8.0;
    /////////////////////////////////////////////////////////////////////
    // gyro
@@ -400,6 +346,32 @@ static void initialize_device(
 //   return errs;
 //}
 
+// register content for running on simulated bus: a stationary device,
+//    level, w/ north on X
+static void configure_simulator(
+      /* in out */       sensor_runtime_type *dev
+      )
+{
+   sim_i2c_type *sim = dev->sim;
+   const sim_fifo_type fifo = {
+         .status_reg = FIFO_SRC_REG_G, .count_mask = 0x1f,
+         .overrun_bit = 0x40, .data_reg = OUT_X_L_G,
+         .depth = GYR_FIFO_DEPTH, .period_sec = GYR_PERIOD_SEC };
+   sim_i2c_set_fifo(sim, dev->gyro.gyro_addr, &fifo);
+   const uint16_t acc_z = (uint16_t) (1.0 / ACC_GAIN);
+   sim_i2c_set_register(sim, dev->accel.accel_addr, STATUS_REG_A, 0x08);
+   sim_i2c_set_register(sim, dev->accel.accel_addr, OUT_Z_L_A,
+         (uint8_t) (acc_z & 0xff));
+   sim_i2c_set_register(sim, dev->accel.accel_addr, OUT_Z_H_A,
+         (uint8_t) (acc_z >> 8));
+   const uint16_t mag_x = (uint16_t) (0.25 / MAG_GAIN);
+   sim_i2c_set_register(sim, dev->mag.mag_addr, STATUS_REG_M, 0x08);
+   sim_i2c_set_register(sim, dev->mag.mag_addr, OUT_X_L_M,
+         (uint8_t) (mag_x & 0xff));
+   sim_i2c_set_register(sim, dev->mag.mag_addr, OUT_X_H_M,
+         (uint8_t) (mag_x >> 8));
+}
+
 ////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 // External facing code
@@ -421,6 +393,10 @@ int32_t lsm9ds0_setup(
    fetch_accel_config(dev);
    fetch_mag_config(dev);
    fetch_temp_config(dev);
+   init_fifo_clock(&dev->gyro.clock, GYR_PERIOD_SEC);
+   if (dev->sim) {
+      configure_simulator(dev);
+   }
    // on failure, initialize device will disable subsensors or
    //    will disable the entire device -> no need to check for errors
 printf("initializing device\n");
@@ -166,6 +166,35 @@ static void report_timing_error(
 }
 
 
+// logs acquisition rate and bus use of each sensor every
+//    SENSOR_BUS_REPORT_SEC
+static void report_bus_stats(void)
+{
+   const double t = now();
+   for (uint32_t i=0; i<MAX_SENSORS; i++) {
+      sensor_runtime_type *sensor = &sensor_stack_[i];
+      const uint32_t flags = sensor->flags;
+      if (flags & SENSOR_FLAG_INACTIVE)
+         break;
+      if (flags & SENSOR_FLAG_DISABLED)
+         continue;
+      sensor_bus_stats_type *bus = &sensor->bus;
+      const double dt = t - bus->start_sec;
+      if (dt < SENSOR_BUS_REPORT_SEC)
+         continue;
+      const double usec_per_sample = bus->samples > 0 ?
+            1.0e6 * bus->bus_sec / (double) bus->samples : 0.0;
+      log_info(log_, "%s (%s): %.1f samples/sec, %.1f transfers/sec, "
+            "%.0f bytes/sec, %.1f usec bus per sample", sensor->name,
+            sensor->type_name, (double) bus->samples / dt,
+            (double) bus->transactions / dt, (double) bus->bytes / dt,
+            usec_per_sample);
+      memset(bus, 0, sizeof *bus);
+      bus->start_sec = t;
+   }
+}
+
+
 static void print_consensus(
       /* in     */ const consensus_sensor_type *cons
       )
@@ -520,6 +549,7 @@ static void initialize_consensus(
    SET_VEC(&cons->acc, 0.0f);
    SET_VEC(&cons->mag, 0.0f);
    SET_VEC(&cons->gyr_axis, 0.0f);
+   cons->gyr_time = 0.0;
    SET_VEC(&cons->latlon, 0.0f);
    cons->temp = 0.0f;
    cons->baro = 0.0f;
@@ -631,6 +661,9 @@ static int32_t acquisition_loop(
       if (flags & SENSOR_FLAG_DISABLED)
          continue;
       timeadd(&sensor->waketime, start_time.tv_sec, start_time.tv_nsec);
+      // don't count setup traffic in bus stats
+      memset(&sensor->bus, 0, sizeof sensor->bus);
+      sensor->bus.start_sec = now();
 //printf("Process %d has waketime of %f\n", i, timespec_to_double(&sensor->waketime));
    }
    // structure where sensor data is collected for broadcast ('consensus
@@ -763,7 +796,9 @@ static int32_t acquisition_loop(
             }
          }
          memset(&consensus.log_data, 0, SENSOR_PACKET_LOG_DATA);
+         consensus.gyr_time = 0.0;
       }
+      report_bus_stats();
    }
    return error_state;
 }
@@ -56,6 +56,33 @@
 
 #define SAMPLING_RATE_BASE_US    12500
 
+////////////////////////////////////////////////////////////////
+// FIFO timing
+
+// max number of samples drained from a hardware FIFO in one transfer
+#define FIFO_MAX_FRAMES    128u
+
+// bytes per FIFO frame (X, Y, Z as int16)
+#define FIFO_FRAME_BYTES   6u
+
+// interval over which sample period is estimated
+#define FIFO_CLOCK_WINDOW_SEC    10.0
+
+// reconstructs acquisition times of samples drained from a hardware
+//    FIFO. the device samples on its own clock, which can differ from
+//    its nominal rate by a few percent, so the sample period is
+//    estimated from the number of samples drained over time. the newest
+//    sample in the FIFO was taken within one period before the read,
+//    and earlier samples are spaced back from it by the period
+struct fifo_clock {
+   double period_sec;      // estimated sample period
+   double newest_sec;      // time of newest sample drained so far
+   double window_start_sec;
+   uint64_t window_samples;
+};
+typedef struct fifo_clock fifo_clock_type;
+
+
 ////////////////////////////////////////////////////////////////
 // gyro
 
@@ -70,6 +97,9 @@ struct sensor_gyro {
    //
 //   double dt;  // interval between samples
    vector_type axis_dps; // gyro signal in axis-angle representation
+   // mean acquisition time of samples in axis_dps. 0 if no new samples
+   double sample_time;
+   fifo_clock_type clock;
    //
    uint8_t gyro_addr;  // i2c address
 };
@@ -209,7 +239,21 @@ typedef struct sensor_gps sensor_gps_type;
 extern const char *HARDWARE_LIST[];
 
 
+// i2c traffic for a sensor over a reporting interval
+struct sensor_bus_stats {
+   uint64_t samples;       // samples acquired
+   uint64_t transactions;  // i2c transfers
+   uint64_t bytes;         // bytes transferred
+   double bus_sec;         // time spent in i2c transfers
+   double start_sec;       // start of reporting interval
+};
+typedef struct sensor_bus_stats sensor_bus_stats_type;
+
+// how often bus stats are reported
+#define SENSOR_BUS_REPORT_SEC    60.0
+
 struct sensor_runtime;
+struct sim_i2c;
 
 // function that's called to initialize a sensor
 // initial value of waketime should be the desired delay after
@@ -259,6 +303,7 @@ struct sensor_runtime {
    struct timespec   waketime;
    struct timespec   last_update;
    int hw_device;
+   int bus_addr;     // i2c address of most recent select_device()
    // callback functions for setup and regular updates
    sensor_update_callback update;
    sensor_whoami_callback self_test;   // nullified after passing
@@ -267,6 +312,10 @@ struct sensor_runtime {
    //
    uint32_t flags;   // control flags for managing hardware
    uint32_t state;   // flags for managing transitions
+   sensor_bus_stats_type bus;
+   // simulated bus, used in place of hardware when device_addr is
+   //    SIM_DEVICE_NAME. NULL otherwise
+   struct sim_i2c *sim;
    ////////////////////////////////////////////
    // don't implement inheritance -- keep data from all sensor types here
    // keep data compartmentalized so that the same object can be
@@ -297,6 +346,8 @@ struct consensus_sensor {
    vector_type acc;
    vector_type mag;
    vector_type gyr_axis;   // degrees per second
+   // mean acquisition time of gyro samples. 0 if unknown
+   double gyr_time;
    //
    double temp;
    double baro;
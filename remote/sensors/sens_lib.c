@@ -21,10 +21,16 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
+#if !defined(I2C_M_RD)
+// older i2c-dev.h defines i2c_msg itself
+#include <linux/i2c.h>
+#endif   // I2C_M_RD
 #include <fcntl.h>
 #include "lin_alg.h"
 #include "pinet.h"
 #include "softiron.h"
+#include "timekeeper.h"
+#include "sens_sim.h"
 
 // when fast drift detection enabled, the time constant for the
 //    high-pass filter is increased by the below multiplier, greatly
@@ -74,11 +80,16 @@ int i2c_smbus_read_i2c_block_data(int device, uint8_t cmd, size_t sz, void *raw)
 // if device failure fails, the subsequent attempt to use the device
 //    will fail.
 void select_device(
-      /* in     */ const sensor_runtime_type *dev,
+      /* in out */       sensor_runtime_type *dev,
       /* in     */ const int addr
       )
 {
-   if (ioctl(dev->hw_device, I2C_SLAVE, addr) < 0) {
+   dev->bus_addr = addr;
+   if (dev->sim) {
+      if (sim_i2c_select(dev->sim, (uint8_t) addr) != 0) {
+         fprintf(stderr, "No simulated device at address 0x%02x\n", addr);
+      }
+   } else if (ioctl(dev->hw_device, I2C_SLAVE, addr) < 0) {
       perror("Failure selecting device");
       fprintf(stderr, "device address: 0x%02x\n", addr);
    }
@@ -96,6 +107,12 @@ int32_t enable_device(
             dev->type_name);
       goto err;
    }
+   if (strcmp(dev->device_addr, SIM_DEVICE_NAME) == 0) {
+      printf("Using simulated bus for %s\n", dev->name);
+      dev->sim = sim_i2c_create(NULL);
+      dev->hw_device = -1;
+      return 0;
+   }
    if ((dev->hw_device = open(dev->device_addr, O_RDWR)) < 0) {
       fprintf(stderr, "Failure accessing %s\n", hw_name);
       fprintf(stderr, "    %s\n", dev->device_addr);
@@ -139,6 +156,118 @@ void device_error(
 }
 
 
+////////////////////////////////////////////////////////////////////////
+// bus access
+
+int32_t bus_write_byte(
+      /* in out */       sensor_runtime_type *dev,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint8_t value
+      )
+{
+   const double t = now();
+   int32_t rc;
+   if (dev->sim) {
+      rc = sim_i2c_write(dev->sim, reg, value);
+   } else {
+      rc = i2c_smbus_write_byte_data(dev->hw_device, reg, value);
+   }
+   sensor_bus_stats_type *bus = &dev->bus;
+   bus->transactions++;
+   bus->bytes += 2;
+   bus->bus_sec += now() - t;
+   return rc;
+}
+
+
+int32_t bus_read(
+      /* in out */       sensor_runtime_type *dev,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint32_t len,
+      /*    out */       uint8_t *buf
+      )
+{
+   const double t = now();
+   int32_t rc;
+   if (dev->sim) {
+      rc = sim_i2c_read(dev->sim, reg, len, buf);
+   } else {
+      uint8_t cmd = reg;
+      struct i2c_msg msgs[2] = {
+         { .addr = (uint16_t) dev->bus_addr, .flags = 0, .len = 1,
+               .buf = &cmd },
+         { .addr = (uint16_t) dev->bus_addr, .flags = I2C_M_RD,
+               .len = (uint16_t) len, .buf = buf }
+      };
+      struct i2c_rdwr_ioctl_data xfer = { .msgs = msgs, .nmsgs = 2 };
+      rc = ioctl(dev->hw_device, I2C_RDWR, &xfer) < 0 ? -1 : 0;
+   }
+   sensor_bus_stats_type *bus = &dev->bus;
+   bus->transactions++;
+   bus->bytes += 1 + len;
+   bus->bus_sec += now() - t;
+   return rc;
+}
+
+////////////////////////////////////////////////////////////////////////
+// FIFO timing
+
+void init_fifo_clock(
+      /*    out */       fifo_clock_type *clk,
+      /* in     */ const double nominal_period_sec
+      )
+{
+   clk->period_sec = nominal_period_sec;
+   clk->newest_sec = 0.0;
+   clk->window_start_sec = 0.0;
+   clk->window_samples = 0;
+}
+
+
+double fifo_sample_times(
+      /* in out */       fifo_clock_type *clk,
+      /* in     */ const double t,
+      /* in     */ const uint32_t n,
+      /*    out */       double *times
+      )
+{
+   if (n == 0) {
+      return 0.0;
+   }
+   // refine period estimate from samples drained over the window.
+   //    timing error at either end of the window is at most one
+   //    period, which is small relative to the window
+   if (clk->window_start_sec <= 0.0) {
+      clk->window_start_sec = t;
+   } else {
+      clk->window_samples += n;
+      const double dt = t - clk->window_start_sec;
+      if (dt >= FIFO_CLOCK_WINDOW_SEC) {
+         const double period = dt / (double) clk->window_samples;
+         clk->period_sec = 0.5 * (clk->period_sec + period);
+         clk->window_start_sec = t;
+         clk->window_samples = 0;
+      }
+   }
+   const double period = clk->period_sec;
+   // extrapolate from previous newest sample. the newest sample was
+   //    acquired during the period before t, so pull the estimate into
+   //    that range when it drifts outside (or on the first read)
+   double newest = clk->newest_sec + (double) n * period;
+   if (newest > t) {
+      newest = t;
+   } else if (newest < t - period) {
+      newest = t - period;
+   }
+   clk->newest_sec = newest;
+   if (times) {
+      for (uint32_t i=0; i<n; i++) {
+         times[i] = newest - (double) (n - 1 - i) * period;
+      }
+   }
+   return newest - 0.5 * (double) (n - 1) * period;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // sensor block initialization
 
@@ -156,6 +285,7 @@ void init_sensor_gyro(
    gyro->confidence = confidence;
    SET_VEC(&gyro->axis_dps, 0.0);
    identity_matrix(&gyro->axis_alignment);
+   gyro->sample_time = 0.0;
 }
 
 void init_sensor_gyro_null(
@@ -167,6 +297,7 @@ void init_sensor_gyro_null(
    SET_VEC(&gyro->drift_dps, 0.0);
    SET_VEC(&gyro->axis_dps, 0.0);
    identity_matrix(&gyro->axis_alignment);
+   gyro->sample_time = 0.0;
 }
 
 void update_gyro_drift(
@@ -515,6 +646,8 @@ void update_gyr(
    double confidence = 0.0;
    vector_type axis_dps;
    zero_vector(&axis_dps);
+   double time_confidence = 0.0;
+   double sample_time = 0.0;
    // sum weighted signals from all accel sensors
    for (uint32_t i=0; i<MAX_SENSORS; i++) {
       sensor_runtime_type *sensor = &sensor_stack[i];
@@ -532,6 +665,10 @@ void update_gyr(
          axis_dps.v[0] += conf * vec.v[0];
          axis_dps.v[1] += conf * vec.v[1];
          axis_dps.v[2] += conf * vec.v[2];
+         if (gyro->sample_time > 0.0) {
+            time_confidence += conf;
+            sample_time += conf * gyro->sample_time;
+         }
          if ((sensor->log_data[0] != 0) && (consensus->log_data[0] == 0)) {
             // if this sensor has data to log, and log slot is open
             //    in consensus object, send it
@@ -546,6 +683,8 @@ void update_gyr(
    consensus->gyr_axis.v[0] = axis_dps.v[0] * confidence;
    consensus->gyr_axis.v[1] = axis_dps.v[1] * confidence;
    consensus->gyr_axis.v[2] = axis_dps.v[2] * confidence;
+   consensus->gyr_time = time_confidence > 0.0 ?
+         sample_time / time_confidence : 0.0;
 }
 
 // combining sensors
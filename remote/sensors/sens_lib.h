@@ -39,11 +39,12 @@ int i2c_smbus_read_i2c_block_data(int device, uint8_t cmd, size_t sz, void *raw)
 
 // prepares device for subsequent command
 void select_device(
-      /* in     */ const sensor_runtime_type *dev,
+      /* in out */       sensor_runtime_type *dev,
       /* in     */ const int addr
       );
 
-// opens pipe with device
+// opens pipe with device. if device address is SIM_DEVICE_NAME then
+//    a simulated bus is attached instead (see sens_sim.h)
 int32_t enable_device(
       /* in out */       sensor_runtime_type *dev,
       /* in     */ const char *hw_name
@@ -66,6 +67,46 @@ void device_error(
       );
 
 
+////////////////////////////////////////////////////////////////////////
+// bus access
+// transfers go to the selected device, on the i2c bus or simulated bus.
+//    both return <0 on error. transfer counts and time are accumulated
+//    in dev->bus
+
+int32_t bus_write_byte(
+      /* in out */       sensor_runtime_type *dev,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint8_t value
+      );
+
+// reads len bytes starting at reg in a single transfer (register write
+//    then repeated-start read). unlike i2c_smbus_read_i2c_block_data,
+//    len isn't limited to 32 bytes, so a FIFO can be drained at once
+int32_t bus_read(
+      /* in out */       sensor_runtime_type *dev,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint32_t len,
+      /*    out */       uint8_t *buf
+      );
+
+////////////////////////////////////////////////////////////////////////
+// FIFO timing
+
+void init_fifo_clock(
+      /*    out */       fifo_clock_type *clk,
+      /* in     */ const double nominal_period_sec
+      );
+
+// n samples were drained from FIFO, w/ FIFO level read at time t.
+//    stores sample acquisition times in times (if not NULL), oldest
+//    first, and returns their mean. returns 0 if n is 0
+double fifo_sample_times(
+      /* in out */       fifo_clock_type *clk,
+      /* in     */ const double t,
+      /* in     */ const uint32_t n,
+      /*    out */       double *times
+      );
+
 ////////////////////////////////////////////////////////////////////////
 // initialize sensor blocks
 
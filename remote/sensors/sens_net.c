@@ -89,8 +89,9 @@ int32_t send_broadcast(
    // window is 1/2 the sampling interval
    static const double WINDOW = (double) SAMPLING_RATE_BASE_US * 0.5e-6;
    static double prev_when_ = 0.0;
-   //
-   double when = now();
+   // use acquisition time of gyro samples when it's known. otherwise
+   //    the present is the best available estimate
+   double when = consensus->gyr_time > 0.0 ? consensus->gyr_time : now();
    if (when < prev_when_ - WINDOW) {
       when = prev_when_ + WINDOW;
    }
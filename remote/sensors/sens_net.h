@@ -28,7 +28,8 @@ int32_t send_broadcast_timestamp(
       );
 
 // send sensor packet to brain
-// this is a wrapper for send_broadcast_timestamp, using t=now()
+// this is a wrapper for send_broadcast_timestamp, using t=gyr_time when
+//    it's available and now() otherwise
 // returns 0 on success, -1 on error
 int32_t send_broadcast(
       /* in     */ const int sockfd,
@@ -0,0 +1,183 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include "sens_sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timekeeper.h"
+
+sim_i2c_type * sim_i2c_create(
+      /* in     */       sim_clock_fn clock
+      )
+{
+   sim_i2c_type *sim = calloc(1, sizeof *sim);
+   sim->selected = -1;
+   sim->clock = clock ? clock : now;
+   return sim;
+}
+
+
+void sim_i2c_free(
+      /* in out */       sim_i2c_type *sim
+      )
+{
+   free(sim);
+}
+
+
+static sim_i2c_device_type * get_device(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t addr
+      )
+{
+   for (uint32_t i=0; i<sim->num_devices; i++) {
+      if (sim->devices[i].addr == addr) {
+         return &sim->devices[i];
+      }
+   }
+   if (sim->num_devices >= SIM_MAX_DEVICES) {
+      fprintf(stderr, "Too many simulated i2c devices (max=%d)\n",
+            SIM_MAX_DEVICES);
+      return NULL;
+   }
+   sim_i2c_device_type *device = &sim->devices[sim->num_devices++];
+   memset(device, 0, sizeof *device);
+   device->addr = addr;
+   return device;
+}
+
+
+void sim_i2c_set_register(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t addr,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint8_t value
+      )
+{
+   sim_i2c_device_type *device = get_device(sim, addr);
+   if (device) {
+      device->regs[reg % SIM_NUM_REGISTERS] = value;
+   }
+}
+
+
+void sim_i2c_set_fifo(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t addr,
+      /* in     */ const sim_fifo_type *fifo
+      )
+{
+   sim_i2c_device_type *device = get_device(sim, addr);
+   if (device) {
+      device->fifo = *fifo;
+      device->fifo.start_sec = sim->clock();
+      device->fifo.consumed = 0;
+      device->has_fifo = 1;
+   }
+}
+
+
+int32_t sim_i2c_select(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t addr
+      )
+{
+   sim->selected = -1;
+   for (uint32_t i=0; i<sim->num_devices; i++) {
+      if (sim->devices[i].addr == addr) {
+         sim->selected = (int32_t) i;
+         return 0;
+      }
+   }
+   return -1;
+}
+
+
+int32_t sim_i2c_write(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint8_t value
+      )
+{
+   if (sim->selected < 0) {
+      return -1;
+   }
+   sim->devices[sim->selected].regs[reg % SIM_NUM_REGISTERS] = value;
+   return 0;
+}
+
+
+// number of frames in FIFO. frames that don't fit are lost
+static uint32_t fifo_level(
+      /* in out */       sim_fifo_type *fifo,
+      /* in     */ const double t
+      )
+{
+   const uint64_t produced = (uint64_t) ((t - fifo->start_sec) /
+         fifo->period_sec);
+   if (produced <= fifo->consumed) {
+      return 0;
+   }
+   if (produced - fifo->consumed > fifo->depth) {
+      fifo->consumed = produced - fifo->depth;
+   }
+   return (uint32_t) (produced - fifo->consumed);
+}
+
+
+int32_t sim_i2c_read(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint32_t len,
+      /*    out */       uint8_t *buf
+      )
+{
+   if (sim->selected < 0) {
+      return -1;
+   }
+   sim_i2c_device_type *device = &sim->devices[sim->selected];
+   sim_fifo_type *fifo = device->has_fifo ? &device->fifo : NULL;
+   const uint8_t base = (uint8_t) (reg & 0x7f);
+   if (fifo && (base == fifo->data_reg)) {
+      // frames are copied out until FIFO is empty. reading past that
+      //    returns zeros
+      uint32_t level = fifo_level(fifo, sim->clock());
+      memset(buf, 0, len);
+      const uint32_t frame_bytes = sizeof fifo->frame;
+      for (uint32_t i=0; (i+frame_bytes<=len) && (level>0);
+            i+=frame_bytes) {
+         memcpy(&buf[i], fifo->frame, frame_bytes);
+         fifo->consumed++;
+         level--;
+      }
+      return 0;
+   }
+   for (uint32_t i=0; i<len; i++) {
+      const uint32_t idx = (base + i) % SIM_NUM_REGISTERS;
+      if (fifo && (idx == fifo->status_reg)) {
+         const uint32_t level = fifo_level(fifo, sim->clock());
+         uint8_t status = (uint8_t) (level & fifo->count_mask);
+         if (level >= fifo->depth) {
+            status = (uint8_t) (status | fifo->overrun_bit);
+         }
+         buf[i] = status;
+      } else {
+         buf[i] = device->regs[idx];
+      }
+   }
+   return 0;
+}
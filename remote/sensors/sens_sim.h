@@ -0,0 +1,112 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#if !defined(SENS_SIM_H)
+#define  SENS_SIM_H
+#include <stdint.h>
+
+// simulated i2c bus, for exercising sensor drivers without hardware.
+//    a sensor whose dev_addr is SIM_DEVICE_NAME is attached to a
+//    simulated bus instead of an i2c device. each simulated device
+//    is a flat register map, optionally w/ a FIFO that fills at a
+//    fixed sample rate and is drained through a data register
+
+#define SIM_DEVICE_NAME    "sim"
+
+#define SIM_MAX_DEVICES    4u
+#define SIM_NUM_REGISTERS  128u
+
+// returns time in seconds. used to fill FIFO
+typedef double (*sim_clock_fn)(void);
+
+struct sim_fifo {
+   uint8_t status_reg;     // reports number of frames available
+   uint8_t count_mask;     // bits in status_reg that hold count
+   uint8_t overrun_bit;    // set in status_reg when FIFO is full
+   uint8_t data_reg;       // frames are read from here
+   uint32_t depth;         // max number of frames held
+   double period_sec;      // sample period
+   double start_sec;
+   uint64_t consumed;      // number of frames read or lost
+   int16_t frame[3];       // content of each frame
+};
+typedef struct sim_fifo sim_fifo_type;
+
+struct sim_i2c_device {
+   uint8_t addr;
+   uint8_t has_fifo;
+   uint8_t regs[SIM_NUM_REGISTERS];
+   sim_fifo_type fifo;
+};
+typedef struct sim_i2c_device sim_i2c_device_type;
+
+struct sim_i2c {
+   sim_i2c_device_type devices[SIM_MAX_DEVICES];
+   uint32_t num_devices;
+   int32_t selected;       // index of selected device, -1 if none
+   sim_clock_fn clock;
+};
+typedef struct sim_i2c sim_i2c_type;
+
+// if clock is NULL, now() is used
+sim_i2c_type * sim_i2c_create(
+      /* in     */       sim_clock_fn clock
+      );
+
+void sim_i2c_free(
+      /* in out */       sim_i2c_type *sim
+      );
+
+// sets register value, adding device at addr if it isn't present
+void sim_i2c_set_register(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t addr,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint8_t value
+      );
+
+// adds FIFO to device at addr (adding device if necessary). FIFO
+//    starts filling immediately
+void sim_i2c_set_fifo(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t addr,
+      /* in     */ const sim_fifo_type *fifo
+      );
+
+// these return 0 on success and -1 if the addressed device doesn't
+//    exist (i.e., a NACK)
+int32_t sim_i2c_select(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t addr
+      );
+
+int32_t sim_i2c_write(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint8_t value
+      );
+
+// reads len bytes from reg. register address auto-increments (and
+//    the auto-increment bit 0x80 is ignored), except for a FIFO data
+//    register, from which successive frames are read
+int32_t sim_i2c_read(
+      /* in out */       sim_i2c_type *sim,
+      /* in     */ const uint8_t reg,
+      /* in     */ const uint32_t len,
+      /*    out */       uint8_t *buf
+      );
+
+#endif   // SENS_SIM_H
@@ -0,0 +1,171 @@
+/***********************************************************************
+* This file is part of kharon <https://github.com/ancient-mariner/kharon>.
+* Copyright (C) 2019-2022 Keith Godfrey
+*
+* kharon is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, version 3.
+*
+* kharon is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with kharon.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "s2.h"
+#include "sens_lib.h"
+#include "sens_sim.h"
+
+// drains a simulated FIFO, at the polling interval of s2, and checks that
+//    reconstructed sample times follow those of the simulated device,
+//    whose clock runs slow relative to its nominal rate
+
+#define ADDR         0x68
+#define STATUS_REG   0x0e
+#define DATA_REG     0x3f
+#define DEPTH        100u
+
+#define NOMINAL_PERIOD     (1.0 / 200.0)
+#define ACTUAL_PERIOD      (1.0 / 197.0)
+#define POLL_INTERVAL      0.0125
+
+static double clock_ = 1000.0;
+
+static double fake_clock(void)
+{
+   return clock_;
+}
+
+
+static uint32_t drain(
+      /* in out */       sensor_runtime_type *dev,
+      /*    out */       uint8_t *overrun
+      )
+{
+   uint8_t status[1];
+   if (bus_read(dev, STATUS_REG, 1, status) < 0) {
+      return 0;
+   }
+   *overrun = (uint8_t) (status[0] & 0x80);
+   uint32_t cnt = status[0] & 0x7f;
+   if (cnt > 0) {
+      uint8_t raw[DEPTH * FIFO_FRAME_BYTES];
+      if (bus_read(dev, DATA_REG, cnt * FIFO_FRAME_BYTES, raw) < 0) {
+         return 0;
+      }
+   }
+   return cnt;
+}
+
+
+static uint32_t test_fifo_timing(void)
+{
+   uint32_t errs = 0;
+   printf("Testing FIFO drain and sample timing\n");
+   sensor_runtime_type dev;
+   memset(&dev, 0, sizeof dev);
+   dev.sim = sim_i2c_create(fake_clock);
+   const double start = clock_;
+   const sim_fifo_type fifo = {
+         .status_reg = STATUS_REG, .count_mask = 0x7f, .overrun_bit = 0x80,
+         .data_reg = DATA_REG, .depth = DEPTH, .period_sec = ACTUAL_PERIOD };
+   sim_i2c_set_fifo(dev.sim, ADDR, &fifo);
+   select_device(&dev, ADDR);
+   fifo_clock_type clk;
+   init_fifo_clock(&clk, NOMINAL_PERIOD);
+   /////////////////////////////////////////////
+   // steady state. poll w/ some jitter
+   uint64_t drained = 0;
+   double max_err = 0.0;
+   const uint32_t num_polls = 4000;   // 50 seconds
+   for (uint32_t i=0; i<num_polls; i++) {
+      clock_ += POLL_INTERVAL + 0.002 * sin((double) i);
+      uint8_t overrun = 0;
+      const uint32_t cnt = drain(&dev, &overrun);
+      if (overrun) {
+         printf("  Unexpected overrun at poll %d\n", i);
+         errs++;
+      }
+      double times[DEPTH];
+      fifo_sample_times(&clk, clock_, cnt, times);
+      for (uint32_t j=0; j<cnt; j++) {
+         const double actual = start + (double) (drained + j + 1) *
+               ACTUAL_PERIOD;
+         const double err = fabs(times[j] - actual);
+         // ignore convergence of period estimate
+         if ((clock_ - start > 20.0) && (err > max_err)) {
+            max_err = err;
+         }
+      }
+      drained += cnt;
+   }
+   const uint64_t expected = (uint64_t) ((clock_ - start) / ACTUAL_PERIOD);
+   if (drained != expected) {
+      printf("  Drained %ld samples, expected %ld\n", drained, expected);
+      errs++;
+   }
+   if (dev.bus.transactions > 2 * num_polls) {
+      printf("  Used %ld transfers for %d polls\n", dev.bus.transactions,
+            num_polls);
+      errs++;
+   }
+   const double period_err = fabs(clk.period_sec - ACTUAL_PERIOD) /
+         ACTUAL_PERIOD;
+   if (period_err > 0.002) {
+      printf("  Period estimate %.6f, expected %.6f\n", clk.period_sec,
+            ACTUAL_PERIOD);
+      errs++;
+   }
+   if (max_err > 0.5 * ACTUAL_PERIOD) {
+      printf("  Sample time error %.2fms exceeds half period\n",
+            1000.0 * max_err);
+      errs++;
+   }
+   printf("  %ld samples in %d polls, max time error %.2fms\n", drained,
+         num_polls, 1000.0 * max_err);
+   /////////////////////////////////////////////
+   // stall for a second. FIFO should be full and report overrun
+   clock_ += 1.0;
+   uint8_t overrun = 0;
+   const uint32_t cnt = drain(&dev, &overrun);
+   if ((cnt != DEPTH) || (overrun == 0)) {
+      printf("  Overrun not reported (%d samples, overrun=%d)\n", cnt,
+            overrun);
+      errs++;
+   }
+   // reading an absent device fails
+   select_device(&dev, ADDR + 1);
+   uint8_t status[1];
+   if (bus_read(&dev, STATUS_REG, 1, status) >= 0) {
+      printf("  Read from missing device succeeded\n");
+      errs++;
+   }
+   sim_i2c_free(dev.sim);
+   return errs;
+}
+
+
+int main(int argc, char **argv)
+{
+   (void) argc;
+   uint32_t errs = 0;
+   errs += test_fifo_timing();
+   //////////////////
+   printf("\n");
+   if (errs == 0) {
+      printf("--------------------\n");
+      printf("--  Tests passed  --\n");
+      printf("--------------------\n");
+   } else {
+      printf("**********************************\n");
+      printf("**** ONE OR MORE TESTS FAILED ****\n");
+      printf("**********************************\n");
+      fprintf(stderr, "%s failed\n", argv[0]);
+   }
+   return (int) errs;
+}